@@ -82,6 +82,7 @@ local memory_kind = {
   disk = c.DISK_MEM,
   hdf = c.HDF_MEM,
   file = c.FILE_MEM,
+  mfile = c.FILE_MAPPED_MEM,
   l1cache = c.LEVEL1_CACHE,
   l2cache = c.LEVEL2_CACHE,
   l3cache = c.LEVEL3_CACHE,
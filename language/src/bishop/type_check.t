@@ -68,7 +68,7 @@ keyword_type_assignment:assign_type({ "x86", "cuda", "arm", "ptx", "lua",
 keyword_type_assignment:assign_type({ "loc", "toc", "io", "openmp", "util",
                                        "group", "set" }, std.processor_kind_type)
 keyword_type_assignment:assign_type({ "global", "sysmem", "regmem", "fbmem",
-                                      "zcmem", "disk", "hdf", "file",
+                                      "zcmem", "disk", "hdf", "file", "mfile",
                                       "l1cache", "l2cache", "l3cache" },
                                       std.memory_kind_type)
 
@@ -2094,7 +2094,13 @@ namespace Legion {
           impl->subscribe() : impl->get_ready_event();
         // Always subscribe to the Realm event to know when it triggers
         ready.subscribe();
-        return ready.has_triggered();
+        if (ready.has_triggered())
+          return true;
+        // If we're polling then make sure the producer isn't being
+        // held back waiting to see if it's part of a repeated trace
+        if (Internal::implicit_context != NULL)
+          Internal::implicit_context->flush_auto_trace();
+        return false;
       }
       return true; // Empty futures are always ready
     }
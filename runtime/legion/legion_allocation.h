@@ -30,6 +30,9 @@
 #include "legion/legion_config.h"
 #include "legion/legion_template_help.h" // StaticAssert
 #include <utility>
+#ifdef LEGION_SLAB_ALLOCATION
+#include "legion/legion_types.h" // LocalLock, AutoLock
+#endif
 
 namespace Legion {
   namespace Internal {
@@ -313,6 +316,187 @@ namespace Legion {
       free(ptr);
     }
 
+#ifdef LEGION_SLAB_ALLOCATION
+    /**
+     * \class LegionSlabAllocator
+     * An opt-in (build with -DLEGION_SLAB_ALLOCATION) pool allocator for
+     * objects of type T that are allocated through LegionHeapify. Objects
+     * are carved out of large slabs and recycled through a per-thread
+     * cache. Frees always go to the freeing thread's cache and full
+     * batches are handed back to a shared depot, so objects created on
+     * one thread and deleted on another are returned in bulk rather than
+     * one lock acquisition at a time. Slabs are never returned to the
+     * system, so live and peak bytes reported by TRACE_ALLOCATION are the
+     * best guide to the pool's footprint. There is no hook for running code
+     * when a thread exits, so the objects in an exiting thread's cache are
+     * leaked: up to 2*BATCH_SIZE-1 objects of each type per thread. The
+     * runtime's own threads live as long as the runtime, but applications
+     * that free Legion objects from many short-lived external threads
+     * (e.g. implicit top-level tasks) will leak that much per thread.
+     */
+    template<typename T>
+    class LegionSlabAllocator {
+    public:
+      static const size_t ALIGNMENT = 
+        (alignof(T) > sizeof(void*)) ? alignof(T) : sizeof(void*);
+      static const size_t OBJECT_SIZE =
+        ((sizeof(T) + ALIGNMENT - 1) / ALIGNMENT) * ALIGNMENT;
+      static const size_t SLAB_BYTES = 64 << 10;
+      static const size_t OBJECTS_PER_SLAB = (OBJECT_SIZE < SLAB_BYTES) ?
+        (SLAB_BYTES / OBJECT_SIZE) : 1;
+      // number of objects moved between a thread cache and the depot
+      static const size_t BATCH_SIZE = 
+        (OBJECTS_PER_SLAB < 64) ? OBJECTS_PER_SLAB : 64;
+    public:
+      static inline void* allocate(void);
+      static inline void deallocate(void *ptr);
+    protected:
+      struct FreeObject {
+        FreeObject *next;
+      };
+      struct Batch {
+        FreeObject *head;
+        size_t count;
+      };
+      struct Depot {
+        LocalLock depot_lock;
+        std::vector<Batch> batches;
+      };
+      // plain old data so it can be thread local, zero means empty
+      struct ThreadCache {
+        FreeObject *head;
+        size_t count;
+      };
+    protected:
+      static inline Depot& get_depot(void);
+      static inline ThreadCache& get_cache(void);
+      static inline Batch take_batch(FreeObject *&head, size_t &count);
+      static inline void refill(ThreadCache &cache);
+    };
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    /*static*/ inline typename LegionSlabAllocator<T>::Depot& 
+                                        LegionSlabAllocator<T>::get_depot(void)
+    //--------------------------------------------------------------------------
+    {
+      // leaked intentionally so that objects freed during static
+      // destruction can still be returned to it
+      static Depot *depot = new Depot();
+      return *depot;
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    /*static*/ inline typename LegionSlabAllocator<T>::ThreadCache&
+                                        LegionSlabAllocator<T>::get_cache(void)
+    //--------------------------------------------------------------------------
+    {
+      static REALM_THREAD_LOCAL ThreadCache cache;
+      return cache;
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    /*static*/ inline typename LegionSlabAllocator<T>::Batch
+        LegionSlabAllocator<T>::take_batch(FreeObject *&head, size_t &count)
+    //--------------------------------------------------------------------------
+    {
+      Batch batch;
+      batch.head = head;
+      batch.count = 0;
+      FreeObject *last = NULL;
+      while ((batch.count < BATCH_SIZE) && (head != NULL))
+      {
+        last = head;
+        head = head->next;
+        batch.count++;
+      }
+      if (last != NULL)
+        last->next = NULL;
+      count -= batch.count;
+      return batch;
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    /*static*/ inline void LegionSlabAllocator<T>::refill(ThreadCache &cache)
+    //--------------------------------------------------------------------------
+    {
+      Depot &depot = get_depot();
+      {
+        AutoLock d_lock(depot.depot_lock);
+        if (!depot.batches.empty())
+        {
+          const Batch &batch = depot.batches.back();
+          cache.head = batch.head;
+          cache.count = batch.count;
+          depot.batches.pop_back();
+          return;
+        }
+      }
+      // depot is empty, carve up a new slab - this thread keeps the first
+      // batch and the rest go to the depot for everyone else
+      char *slab = (char*)legion_alloc_aligned<OBJECT_SIZE,ALIGNMENT,false>(
+                                                            OBJECTS_PER_SLAB);
+      FreeObject *head = NULL;
+      for (size_t idx = OBJECTS_PER_SLAB; idx > 0; idx--)
+      {
+        FreeObject *obj = reinterpret_cast<FreeObject*>(
+                                        slab + (idx - 1) * OBJECT_SIZE);
+        obj->next = head;
+        head = obj;
+      }
+      size_t count = OBJECTS_PER_SLAB;
+      const Batch first = take_batch(head, count);
+      cache.head = first.head;
+      cache.count = first.count;
+      if (count > 0)
+      {
+        AutoLock d_lock(depot.depot_lock);
+        while (count > 0)
+          depot.batches.push_back(take_batch(head, count));
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    /*static*/ inline void* LegionSlabAllocator<T>::allocate(void)
+    //--------------------------------------------------------------------------
+    {
+      ThreadCache &cache = get_cache();
+      if (cache.head == NULL)
+        refill(cache);
+#ifdef DEBUG_LEGION
+      assert(cache.head != NULL);
+#endif
+      FreeObject *result = cache.head;
+      cache.head = result->next;
+      cache.count--;
+      return result;
+    }
+
+    //--------------------------------------------------------------------------
+    template<typename T>
+    /*static*/ inline void LegionSlabAllocator<T>::deallocate(void *ptr)
+    //--------------------------------------------------------------------------
+    {
+      ThreadCache &cache = get_cache();
+      FreeObject *obj = static_cast<FreeObject*>(ptr);
+      obj->next = cache.head;
+      cache.head = obj;
+      cache.count++;
+      // keep at most two batches locally, return one to the depot
+      if (cache.count >= (2 * BATCH_SIZE))
+      {
+        const Batch batch = take_batch(cache.head, cache.count);
+        Depot &depot = get_depot();
+        AutoLock d_lock(depot.depot_lock);
+        depot.batches.push_back(batch);
+      }
+    }
+#endif // LEGION_SLAB_ALLOCATION
+
     // A class for Legion objects to inherit from to have their dynamic
     // memory allocations managed for alignment and tracing
     template<typename T>
@@ -324,7 +508,12 @@ namespace Legion {
       static inline void* operator new(size_t count, void *ptr);
       static inline void* operator new[](size_t count, void *ptr);
     public:
+#ifdef LEGION_SLAB_ALLOCATION
+      // sized so we can tell whether the object came from the slab pool
+      static inline void operator delete(void *ptr, size_t size);
+#else
       static inline void operator delete(void *ptr);
+#endif
       static inline void operator delete[](void *ptr);
     public:
       static inline void operator delete(void *ptr, void *place);
@@ -338,6 +527,11 @@ namespace Legion {
     {
 #ifdef TRACE_ALLOCATION
       HandleAllocation<T,HasAllocType<T>::value>::trace_allocation();
+#endif
+#ifdef LEGION_SLAB_ALLOCATION
+      // derived classes that are larger than T use the normal heap
+      if (count == sizeof(T))
+        return LegionSlabAllocator<T>::allocate();
 #endif
       return legion_alloc_aligned<T,true/*bytes*/>(count);  
     }
@@ -377,6 +571,22 @@ namespace Legion {
       return ptr;
     }
 
+#ifdef LEGION_SLAB_ALLOCATION
+    //--------------------------------------------------------------------------
+    template<typename T>
+    /*static*/ inline void LegionHeapify<T>::operator delete(void *ptr,
+                                                             size_t size)
+    //--------------------------------------------------------------------------
+    {
+#ifdef TRACE_ALLOCATION
+      HandleAllocation<T,HasAllocType<T>::value>::trace_free();
+#endif
+      if (size == sizeof(T))
+        LegionSlabAllocator<T>::deallocate(ptr);
+      else
+        free(ptr);
+    }
+#else
     //--------------------------------------------------------------------------
     template<typename T>
     /*static*/ inline void LegionHeapify<T>::operator delete(void *ptr)
@@ -387,6 +597,7 @@ namespace Legion {
 #endif
       free(ptr);
     }
+#endif
 
     //--------------------------------------------------------------------------
     template<typename T>
@@ -3226,6 +3226,19 @@ namespace Legion {
       users.push_back(close_user);
     }
 
+    /////////////////////////////////////////////////////////////
+    // KDTree
+    /////////////////////////////////////////////////////////////
+
+    //--------------------------------------------------------------------------
+    /*static*/ void KDTree::handle_deferred_refine(const void *args)
+    //--------------------------------------------------------------------------
+    {
+      const DeferRefineArgs *dargs = (const DeferRefineArgs*)args;
+      *(dargs->changed) = dargs->node->refine(*(dargs->subsets), 
+                                              *(dargs->mask), dargs->max_depth);
+    }
+
     /////////////////////////////////////////////////////////////
     // KDNode
     /////////////////////////////////////////////////////////////
@@ -3303,6 +3316,7 @@ namespace Legion {
                            const FieldMask &refinement_mask, unsigned max_depth)
     //--------------------------------------------------------------------------
     {
+      DETAILED_PROFILER(runtime, KD_NODE_REFINE_CALL);
 #ifdef DEBUG_LEGION
       assert(subsets.size() > LEGION_MAX_BVH_FANOUT);
 #endif
@@ -3385,28 +3399,44 @@ namespace Legion {
         return false;
       // Recurse down the tree
       const int next_dim = (refinement_dim + 1) % DIM;
+      const bool refine_left = 
+        (left_set.size() > LEGION_MAX_BVH_FANOUT) && (max_depth > 0);
+      const bool refine_right =
+        (right_set.size() > LEGION_MAX_BVH_FANOUT) && (max_depth > 0);
+      // If all the subsets span our splitting plane then we need
+      // to either start tracking the last changed dimension or 
+      // continue propagating the current one
+      const int left_last_dim = (left_set.size() == subsets.size()) ? 
+        ((last_changed_dim != -1) ? last_changed_dim : refinement_dim) : -1;
+      const int right_last_dim = (right_set.size() == subsets.size()) ? 
+        ((last_changed_dim != -1) ? last_changed_dim : refinement_dim) : -1;
+      KDNode<DIM> left(left_bounds, runtime, next_dim, left_last_dim);
+      KDNode<DIM> right(right_bounds, runtime, next_dim, right_last_dim);
       bool left_changed = false;
-      if ((left_set.size() > LEGION_MAX_BVH_FANOUT) && (max_depth > 0))
-      {
-        // If all the subsets span our splitting plane then we need
-        // to either start tracking the last changed dimension or 
-        // continue propagating the current one
-        const int left_last_dim = (left_set.size() == subsets.size()) ? 
-          ((last_changed_dim != -1) ? last_changed_dim : refinement_dim) : -1;
-        KDNode<DIM> left(left_bounds, runtime, next_dim, left_last_dim);
-        left_changed = left.refine(left_set, refinement_mask, max_depth - 1);
+      RtEvent left_refined;
+      if (refine_left)
+      {
+        // If both sides need refining and the left side is big enough
+        // then refine it in a meta-task on another utility processor 
+        // while we do the right side here. The two sides only touch 
+        // their own vectors so the result is the same as doing them
+        // one after the other.
+        if (refine_right && (runtime->parallel_refinement_threshold > 0) &&
+            (left_set.size() >= runtime->parallel_refinement_threshold))
+        {
+          KDTree::DeferRefineArgs args(&left, &left_set, &refinement_mask,
+                                       max_depth - 1, &left_changed);
+          left_refined = 
+            runtime->issue_runtime_meta_task(args, LG_LATENCY_WORK_PRIORITY);
+        }
+        else
+          left_changed = left.refine(left_set, refinement_mask, max_depth - 1);
       }
       bool right_changed = false;
-      if ((right_set.size() > LEGION_MAX_BVH_FANOUT) && (max_depth > 0))
-      {
-        // If all the subsets span our splitting plane then we need
-        // to either start tracking the last changed dimension or 
-        // continue propagating the current one
-        const int right_last_dim = (right_set.size() == subsets.size()) ? 
-          ((last_changed_dim != -1) ? last_changed_dim : refinement_dim) : -1;
-        KDNode<DIM> right(right_bounds, runtime, next_dim, right_last_dim);
+      if (refine_right)
         right_changed = right.refine(right_set, refinement_mask, max_depth - 1);
-      }
+      if (left_refined.exists() && !left_refined.has_triggered())
+        left_refined.wait();
       // If the sum of the left and right equivalence sets 
       // are too big then build intermediate nodes for each one
       if (((left_set.size() + right_set.size()) > LEGION_MAX_BVH_FANOUT) &&
@@ -12877,7 +12907,15 @@ namespace Legion {
 #else
               unsigned max_depth = new_subsets.size();
 #endif
-              if (tree->refine(new_subsets, fit->set_mask, max_depth))
+              // The tree only touches its own vectors and may wait for
+              // a side refined in parallel, so don't hold the lock while
+              // it works. Nobody else changes our subsets while we are
+              // in the refining state.
+              eq.release();
+              const bool refined =
+                tree->refine(new_subsets, fit->set_mask, max_depth);
+              eq.reacquire();
+              if (refined)
               {
                 // Remove old references
                 for (std::set<EquivalenceSet*>::const_iterator it = 
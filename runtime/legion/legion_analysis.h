@@ -896,10 +896,28 @@ namespace Legion {
     };
 
     class KDTree {
+    public:
+      struct DeferRefineArgs : public LgTaskArgs<DeferRefineArgs> {
+      public:
+        static const LgTaskID TASK_ID = LG_DEFER_KD_TREE_REFINE_TASK_ID;
+      public:
+        DeferRefineArgs(KDTree *n, std::vector<EquivalenceSet*> *s,
+                        const FieldMask *m, unsigned d, bool *c)
+          : LgTaskArgs<DeferRefineArgs>(implicit_provenance),
+            node(n), subsets(s), mask(m), max_depth(d), changed(c) { }
+      public:
+        KDTree *const node;
+        std::vector<EquivalenceSet*> *const subsets;
+        const FieldMask *const mask;
+        const unsigned max_depth;
+        bool *const changed;
+      };
     public:
       virtual ~KDTree(void) { }
       virtual bool refine(std::vector<EquivalenceSet*> &subsets,
           const FieldMask &refinement_mask, unsigned max_depth) = 0;
+    public:
+      static void handle_deferred_refine(const void *args);
     };
 
     /**
@@ -333,6 +333,20 @@
 #define LEGION_DEFAULT_MAX_REPLAY_PARALLELISM  (DEFAULT_MAX_REPLAY_PARALLELISM)
 #endif
 #endif
+// Bounds on the length of the repeated operation sequences that
+// automatic tracing (-lg:auto_trace) will look for
+#ifndef LEGION_DEFAULT_AUTO_TRACE_MIN_LENGTH
+#define LEGION_DEFAULT_AUTO_TRACE_MIN_LENGTH   2
+#endif
+#ifndef LEGION_DEFAULT_AUTO_TRACE_MAX_LENGTH
+#define LEGION_DEFAULT_AUTO_TRACE_MAX_LENGTH   128
+#endif
+// KD tree refinements of equivalence sets with at least this many
+// subsets will refine one of their subtrees in a separate meta-task
+// (-lg:parallel_refine, 0 disables)
+#ifndef LEGION_DEFAULT_PARALLEL_REFINEMENT_THRESHOLD
+#define LEGION_DEFAULT_PARALLEL_REFINEMENT_THRESHOLD  1024
+#endif
 // The maximum size of active messages sent by the runtime in bytes
 // Note this value was picked based on making a tradeoff between
 // latency and bandwidth numbers on both Cray and Infiniband
@@ -2444,6 +2444,8 @@ namespace Legion {
     void TaskContext::yield(void)
     //--------------------------------------------------------------------------
     {
+      // Don't keep anything held back for auto tracing while we wait
+      flush_auto_trace();
       YieldArgs args(owner_task->get_unique_id());
       // Run this task with minimum priority to allow other things to run
       const RtEvent wait_for = 
@@ -2699,8 +2701,16 @@ namespace Legion {
         outstanding_children_count(0), outstanding_prepipeline(0),
         outstanding_dependence(false),
         post_task_comp_queue(CompletionQueue::NO_QUEUE), 
-        current_trace(NULL), previous_trace(NULL), valid_wait_event(false), 
-        outstanding_subtasks(0), pending_subtasks(0), pending_frames(0), 
+        current_trace(NULL), previous_trace(NULL),
+        auto_trace_enabled(rt->auto_trace && !rt->no_tracing &&
+            !rt->program_order_execution && !rt->legion_spy_enabled &&
+            (rt->auto_trace_min_length > 0) &&
+            (rt->auto_trace_min_length <= rt->auto_trace_max_length)),
+        auto_trace_issuing(false), auto_trace_epoch(0), 
+        auto_trace_operations(0),
+        auto_trace_hits(0), auto_trace_misses(0), auto_trace_replayed_ops(0),
+        valid_wait_event(false), outstanding_subtasks(0), pending_subtasks(0),
+        pending_frames(0), 
         currently_active_context(false), current_mapping_fence(NULL), 
         mapping_fence_gen(0), current_mapping_fence_index(0), 
         current_execution_fence_event(exec_fence),
@@ -2720,6 +2730,8 @@ namespace Legion {
       context_configuration.meta_task_vector_width = 
         runtime->initial_meta_task_vector_width;
       context_configuration.mutable_priority = false;
+      if (auto_trace_enabled)
+        auto_trace_runs.resize(runtime->auto_trace_max_length + 1, 0);
 #ifdef DEBUG_LEGION
       assert(tree_context.exists());
       runtime->forest->check_context_state(tree_context);
@@ -2751,7 +2763,7 @@ namespace Legion {
       : TaskContext(NULL, NULL, 0, rhs.regions), tree_context(rhs.tree_context),
         context_uid(0), remote_context(false), full_inner_context(false),
         parent_req_indexes(rhs.parent_req_indexes), 
-        virtual_mapped(rhs.virtual_mapped)
+        virtual_mapped(rhs.virtual_mapped), auto_trace_enabled(false)
     //--------------------------------------------------------------------------
     {
       // should never be called
@@ -6678,7 +6690,12 @@ namespace Legion {
       if ((context_configuration.min_frames_to_schedule == 0) && 
           (context_configuration.max_window_size > 0) && 
             (outstanding_count > context_configuration.max_window_size))
+      {
+        // Operations held back for auto tracing count against the
+        // window so they need to be issued before we can wait
+        flush_auto_trace();
         perform_window_wait();
+      }
       if (runtime->legion_spy_enabled)
         LegionSpy::log_child_operation_index(get_context_uid(), result, 
                                              op->get_unique_op_id()); 
@@ -6856,6 +6873,24 @@ namespace Legion {
     //--------------------------------------------------------------------------
     void InnerContext::add_to_dependence_queue(Operation *op, bool unordered)
     //--------------------------------------------------------------------------
+    {
+      // Operations from the application might be held back until we
+      // know whether they are part of a repeated sequence we can trace
+      if (auto_trace_enabled && !unordered && !auto_trace_issuing &&
+          (current_trace == NULL))
+      {
+        AutoLock a_lock(auto_trace_lock);
+        if (record_auto_trace_operation(op))
+          return;
+        // Nothing is held back now so nothing can be issued ahead of this
+        auto_trace_last_issued = op->get_completion_event();
+      }
+      enqueue_child_operation(op, unordered);
+    }
+
+    //--------------------------------------------------------------------------
+    void InnerContext::enqueue_child_operation(Operation *op, bool unordered)
+    //--------------------------------------------------------------------------
     {
       // Launch the task to perform the prepipeline stage for the operation
       if (op->has_prepipeline_stage())
@@ -7803,10 +7838,398 @@ namespace Legion {
     void InnerContext::record_blocking_call(void)
     //--------------------------------------------------------------------------
     {
+      // Whatever we're waiting on might be held back for auto tracing
+      if (auto_trace_enabled)
+        flush_auto_trace();
       if (current_trace != NULL)
         current_trace->record_blocking_call();
     }
 
+    //--------------------------------------------------------------------------
+    void InnerContext::flush_auto_trace(void)
+    //--------------------------------------------------------------------------
+    {
+      if (!auto_trace_enabled || auto_trace_issuing)
+        return;
+      AutoLock a_lock(auto_trace_lock);
+      if (!auto_trace_buffer.empty())
+      {
+        issue_auto_trace(false/*traced*/);
+        auto_trace_misses++;
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    void InnerContext::flush_stalled_auto_trace(unsigned long long epoch)
+    //--------------------------------------------------------------------------
+    {
+      AutoLock a_lock(auto_trace_lock);
+      // If the operations we were called for have already been issued
+      // then the application got to the end of the sequence in time
+      if ((epoch != auto_trace_epoch) || auto_trace_buffer.empty())
+        return;
+      // Everything issued before the held back operations is done, so 
+      // holding them any longer would just leave the machine idle while 
+      // the application is busy doing something else (or even blocked 
+      // outside of Legion waiting on these operations)
+      log_tracing.debug("Issuing %zd operations held back for auto tracing "
+          "in task %s (UID %lld) because the work before them finished",
+          auto_trace_buffer.size(), get_task_name(), get_unique_id());
+      issue_auto_trace(false/*traced*/);
+      auto_trace_misses++;
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ void InnerContext::handle_auto_trace_flush(const void *args)
+    //--------------------------------------------------------------------------
+    {
+      const AutoTraceFlushArgs *fargs = (const AutoTraceFlushArgs*)args;
+      fargs->context->flush_stalled_auto_trace(fargs->epoch);
+      if (fargs->context->remove_reference())
+        delete fargs->context;
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ uint64_t InnerContext::hash_auto_trace_operation(Operation *op)
+    //--------------------------------------------------------------------------
+    {
+      // Only tasks, copies, and fills are traced automatically and they
+      // have to match exactly for it to be safe to replay the trace
+      const Operation::OpKind kind = op->get_operation_kind();
+      if ((kind != Operation::TASK_OP_KIND) && 
+          (kind != Operation::COPY_OP_KIND) && 
+          (kind != Operation::FILL_OP_KIND))
+        return 0;
+      // Predicated operations might not be issued the same way each time
+      if (op->is_predicated_op())
+        return 0;
+      // Fills whose value comes from a future might get a different value
+      // each time, but the template would bake in the first one
+      if ((kind == Operation::FILL_OP_KIND) &&
+          (static_cast<FillOp*>(op)->future.impl != NULL))
+        return 0;
+      struct Hasher {
+        static inline void mix(uint64_t &h, uint64_t value)
+          { h = (h ^ value) * 1099511628211ULL; }
+        static inline void mix(uint64_t &h, const Domain &d)
+        {
+          mix(h, d.is_id);
+          mix(h, d.get_dim());
+          for (int i = 0; i < 2*d.get_dim(); i++)
+            mix(h, d.rect_data[i]);
+        }
+        static inline void mix(uint64_t &h, const RegionRequirement &req)
+        {
+          mix(h, req.handle_type);
+          if (req.handle_type == LEGION_PARTITION_PROJECTION)
+          {
+            mix(h, req.partition.get_tree_id());
+            mix(h, req.partition.get_index_partition().get_id());
+          }
+          else
+          {
+            mix(h, req.region.get_tree_id());
+            mix(h, req.region.get_index_space().get_id());
+          }
+          mix(h, req.region.get_field_space().get_id());
+          mix(h, req.parent.get_index_space().get_id());
+          mix(h, req.projection);
+          mix(h, req.privilege);
+          mix(h, req.prop);
+          mix(h, req.redop);
+          mix(h, req.tag);
+          mix(h, req.flags);
+          mix(h, req.privilege_fields.size());
+          for (std::set<FieldID>::const_iterator it = 
+                req.privilege_fields.begin(); it != 
+                req.privilege_fields.end(); it++)
+            mix(h, *it);
+        }
+        static inline void mix(uint64_t &h, 
+                               const std::vector<RegionRequirement> &reqs)
+        {
+          mix(h, reqs.size());
+          for (unsigned idx = 0; idx < reqs.size(); idx++)
+            mix(h, reqs[idx]);
+        }
+      };
+      uint64_t hash = 14695981039346656037ULL;
+      Hasher::mix(hash, kind);
+      const Mappable *mappable = op->get_mappable();
+      switch (kind)
+      {
+        case Operation::TASK_OP_KIND:
+          {
+            const Task *task = mappable->as_task();
+            // Phase barriers usually synchronize with something outside
+            // of this context so operations using them are never held
+            if (!task->wait_barriers.empty() || 
+                !task->arrive_barriers.empty())
+              return 0;
+            Hasher::mix(hash, task->task_id);
+            Hasher::mix(hash, task->is_index_space);
+            if (task->is_index_space)
+              Hasher::mix(hash, task->index_domain);
+            Hasher::mix(hash, task->regions);
+            Hasher::mix(hash, task->futures.size());
+            break;
+          }
+        case Operation::COPY_OP_KIND:
+          {
+            const Copy *copy = mappable->as_copy();
+            if (!copy->wait_barriers.empty() || 
+                !copy->arrive_barriers.empty())
+              return 0;
+            Hasher::mix(hash, copy->is_index_space);
+            if (copy->is_index_space)
+              Hasher::mix(hash, copy->index_domain);
+            Hasher::mix(hash, copy->src_requirements);
+            Hasher::mix(hash, copy->dst_requirements);
+            Hasher::mix(hash, copy->src_indirect_requirements);
+            Hasher::mix(hash, copy->dst_indirect_requirements);
+            break;
+          }
+        case Operation::FILL_OP_KIND:
+          {
+            const Fill *fill = mappable->as_fill();
+            if (!fill->wait_barriers.empty() || 
+                !fill->arrive_barriers.empty())
+              return 0;
+            Hasher::mix(hash, fill->is_index_space);
+            if (fill->is_index_space)
+              Hasher::mix(hash, fill->index_domain);
+            Hasher::mix(hash, fill->requirement);
+            // The fill value is baked into the template so it must match
+            const FillOp *fill_op = static_cast<const FillOp*>(op);
+            Hasher::mix(hash, fill_op->value_size);
+            const unsigned char *bytes = 
+              static_cast<const unsigned char*>(fill_op->value);
+            for (size_t idx = 0; idx < fill_op->value_size; idx++)
+              Hasher::mix(hash, bytes[idx]);
+            break;
+          }
+        default:
+          assert(false);
+      }
+      Hasher::mix(hash, mappable->map_id);
+      Hasher::mix(hash, mappable->tag);
+      // Keep the top bit set so these never look like the
+      // markers we use for operations that can't be traced
+      return (hash | (1ULL << 63));
+    }
+
+    //--------------------------------------------------------------------------
+    bool InnerContext::record_auto_trace_operation(Operation *op)
+    //--------------------------------------------------------------------------
+    {
+      const uint64_t hash = hash_auto_trace_operation(op);
+      if (hash == 0)
+      {
+        // Can't trace this, so issue anything we were holding back
+        // and leave a marker for its kind in the history
+        if (!auto_trace_buffer.empty())
+        {
+          issue_auto_trace(false/*traced*/);
+          auto_trace_misses++;
+        }
+        auto_trace_candidate.clear();
+        update_auto_trace_candidate(op->get_operation_kind() + 1);
+        return false;
+      }
+      auto_trace_operations++;
+      update_auto_trace_candidate(hash);
+      if (!auto_trace_buffer.empty())
+      {
+        if (auto_trace_candidate[auto_trace_buffer.size()] == hash)
+        {
+          auto_trace_buffer.push_back(op);
+          if (auto_trace_buffer.size() == auto_trace_candidate.size())
+            issue_auto_trace(true/*traced*/);
+          return true;
+        }
+        // The sequence diverged, issue what we have and start looking
+        // for a new candidate from here on
+        issue_auto_trace(false/*traced*/);
+        auto_trace_misses++;
+        auto_trace_candidate.clear();
+      }
+      if (!auto_trace_candidate.empty())
+      {
+        if (auto_trace_candidate.front() != hash)
+          return false;
+        auto_trace_buffer.push_back(op);
+        if (auto_trace_buffer.size() == auto_trace_candidate.size())
+          issue_auto_trace(true/*traced*/);
+        else
+        {
+          // The application might not get around to issuing the rest of
+          // the sequence for a while, so make sure these operations get 
+          // issued anyway once the work issued before them is done
+          add_reference();
+          AutoTraceFlushArgs args(this, auto_trace_epoch);
+          runtime->issue_runtime_meta_task(args, LG_LOW_PRIORITY,
+              Runtime::protect_event(auto_trace_last_issued));
+        }
+        return true;
+      }
+      // See if the operations up to and including this one repeat, 
+      // if so we'll start watching for the next instance of them
+      const unsigned min_length = runtime->auto_trace_min_length;
+      const unsigned max_length = runtime->auto_trace_max_length;
+      for (unsigned length = min_length; length <= max_length; length++)
+      {
+        if (auto_trace_runs[length] < length)
+          continue;
+        const std::vector<uint64_t>::const_iterator last = 
+          auto_trace_history.end();
+        std::vector<uint64_t> sequence(last - length, last);
+        // Markers for untraceable operations can't be part of a trace,
+        // so pick the longest run between markers (wrapping around 
+        // since the sequence is periodic)
+        unsigned first_marker = length;
+        for (unsigned idx = 0; idx < length; idx++)
+        {
+          if ((sequence[idx] >> 63) == 0)
+          {
+            first_marker = idx;
+            break;
+          }
+        }
+        if (first_marker < length)
+        {
+          std::vector<uint64_t> best, current;
+          for (unsigned off = 1; off <= length; off++)
+          {
+            const uint64_t next = sequence[(first_marker + off) % length];
+            if ((next >> 63) == 0)
+            {
+              if (current.size() > best.size())
+                best.swap(current);
+              current.clear();
+            }
+            else
+              current.push_back(next);
+          }
+          sequence.swap(best);
+        }
+        if (sequence.size() < min_length)
+          continue;
+        auto_trace_candidate.swap(sequence);
+        break;
+      }
+      return false;
+    }
+
+    //--------------------------------------------------------------------------
+    void InnerContext::update_auto_trace_candidate(uint64_t hash)
+    //--------------------------------------------------------------------------
+    {
+      const unsigned max_length = runtime->auto_trace_max_length;
+      // We only need a couple of periods of history so trim it once
+      // in a while rather than paying to shift it on every operation
+      if (auto_trace_history.size() >= (4 * max_length))
+        auto_trace_history.erase(auto_trace_history.begin(),
+            auto_trace_history.begin() + 2 * max_length);
+      // runs[p] counts how many operations in a row have matched
+      // the operation p before them in the stream
+      const size_t size = auto_trace_history.size();
+      for (unsigned length = 1; length <= max_length; length++)
+      {
+        if ((length <= size) && (auto_trace_history[size - length] == hash))
+          auto_trace_runs[length]++;
+        else
+          auto_trace_runs[length] = 0;
+      }
+      auto_trace_history.push_back(hash);
+    }
+
+    //--------------------------------------------------------------------------
+    void InnerContext::issue_auto_trace(bool traced)
+    //--------------------------------------------------------------------------
+    {
+      std::vector<Operation*> to_issue;
+      to_issue.swap(auto_trace_buffer);
+      auto_trace_epoch++;
+      auto_trace_last_issued = to_issue.back()->get_completion_event();
+      // The held back operations were given the most recent context
+      // indices when they were registered and the trace operations
+      // have to come before them in the stream of child operations 
+      // (fences find the operations before them by context index). We 
+      // can only make room for them if nothing else has been registered 
+      // since then, which should only happen for unordered operations, 
+      // so in that case don't trace this time around.
+      const size_t first_index = to_issue.front()->get_ctx_index();
+      if (traced && ((first_index + to_issue.size()) != total_children_count))
+      {
+        traced = false;
+        auto_trace_misses++;
+      }
+      if (traced)
+      {
+        TraceID tid;
+        std::map<std::vector<uint64_t>,TraceID>::const_iterator finder =
+          auto_trace_ids.find(auto_trace_candidate);
+        if (finder == auto_trace_ids.end())
+        {
+          tid = generate_dynamic_trace_id();
+          auto_trace_ids[auto_trace_candidate] = tid;
+          log_tracing.info("Automatically tracing a sequence of %zd "
+              "operations as trace %d in task %s (UID %lld)", 
+              auto_trace_candidate.size(), tid, get_task_name(), 
+              get_unique_id());
+        }
+        else
+          tid = finder->second;
+        // Hand the first of the held back indices to the begin trace
+        // operation and renumber the held back operations after it
+        // so the context indices stay dense
+        total_children_count = first_index;
+        // The operations for beginning and ending the trace go through 
+        // add_to_dependence_queue and must not be considered for tracing
+        auto_trace_issuing = true;
+        begin_trace(tid, false/*logical only*/, false/*static*/,
+                    NULL/*managed*/, false/*deprecated*/);
+        const bool replaying = current_trace->is_fixed();
+        for (std::vector<Operation*>::const_iterator it = 
+              to_issue.begin(); it != to_issue.end(); it++)
+        {
+          (*it)->update_context_index(total_children_count++);
+          // It is safe to attach the trace this late: a dynamic trace 
+          // keeps no state about an operation until the operation 
+          // registers with it at the start of its dependence analysis,
+          // which can't happen before it is enqueued below
+          (*it)->set_trace(current_trace, NULL/*dependences*/);
+          enqueue_child_operation(*it, false/*unordered*/);
+        }
+        end_trace(tid, false/*deprecated*/);
+        auto_trace_issuing = false;
+        auto_trace_hits++;
+        if (replaying)
+          auto_trace_replayed_ops += to_issue.size();
+      }
+      else
+      {
+        for (std::vector<Operation*>::const_iterator it = 
+              to_issue.begin(); it != to_issue.end(); it++)
+          enqueue_child_operation(*it, false/*unordered*/);
+      }
+    }
+
+    //--------------------------------------------------------------------------
+    void InnerContext::report_auto_trace_statistics(void)
+    //--------------------------------------------------------------------------
+    {
+      if ((auto_trace_hits == 0) && (auto_trace_misses == 0))
+        return;
+      log_tracing.print("Auto tracing in task %s (UID %lld): %lld of %lld "
+          "sequences traced (%.1f%% hit rate), %lld of %lld operations "
+          "replayed, %zd traces", get_task_name(), get_unique_id(),
+          auto_trace_hits, auto_trace_hits + auto_trace_misses,
+          100.0 * auto_trace_hits / (auto_trace_hits + auto_trace_misses),
+          auto_trace_replayed_ops, auto_trace_operations, 
+          auto_trace_ids.size());
+    }
+
     //--------------------------------------------------------------------------
     void InnerContext::issue_frame(FrameOp *frame, ApEvent frame_termination)
     //--------------------------------------------------------------------------
@@ -8717,6 +9140,11 @@ namespace Legion {
      PhysicalInstance deferred_result_instance, FutureFunctor *callback_functor)
     //--------------------------------------------------------------------------
     {
+      if (auto_trace_enabled)
+      {
+        flush_auto_trace();
+        report_auto_trace_statistics();
+      }
       // See if we have any local regions or fields that need to be deallocated
       std::vector<LogicalRegion> local_regions_to_delete;
       std::map<FieldSpace,std::set<FieldID> > local_fields_to_delete;
@@ -9098,6 +9526,8 @@ namespace Legion {
     //--------------------------------------------------------------------------
     {
       DETAILED_PROFILER(runtime, INLINE_CHILD_TASK_CALL);
+      // Anything held back for auto tracing has to be issued first
+      flush_auto_trace();
       if (runtime->legion_spy_enabled)
         LegionSpy::log_inline_task(child->get_unique_id());
       // Remove this child from our context
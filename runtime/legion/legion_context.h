@@ -409,6 +409,8 @@ namespace Legion {
       virtual void invalidate_trace_cache(LegionTrace *trace,
                                           Operation *invalidator) = 0;
       virtual void record_blocking_call(void) = 0;
+      // Issue any operations being held back for automatic tracing
+      virtual void flush_auto_trace(void) { }
     public:
       virtual void issue_frame(FrameOp *frame, ApEvent frame_termination) = 0;
       virtual void perform_frame_issue(FrameOp *frame, 
@@ -763,6 +765,19 @@ namespace Legion {
         const PartitionKind kind;
         const char *const func;
       };
+      // Issues operations held back for auto tracing if they are still
+      // waiting once the work issued before them has finished
+      struct AutoTraceFlushArgs : public LgTaskArgs<AutoTraceFlushArgs> {
+      public:
+        static const LgTaskID TASK_ID = LG_DEFER_AUTO_TRACE_FLUSH_TASK_ID;
+      public:
+        AutoTraceFlushArgs(InnerContext *ctx, unsigned long long e)
+          : LgTaskArgs<AutoTraceFlushArgs>(ctx->get_unique_id()),
+            context(ctx), epoch(e) { }
+      public:
+        InnerContext *const context;
+        const unsigned long long epoch;
+      };
       struct LocalFieldInfo {
       public:
         LocalFieldInfo(void)
@@ -1127,6 +1142,7 @@ namespace Legion {
       virtual void invalidate_trace_cache(LegionTrace *trace,
                                           Operation *invalidator);
       virtual void record_blocking_call(void);
+      virtual void flush_auto_trace(void);
     public:
       virtual void issue_frame(FrameOp *frame, ApEvent frame_termination);
       virtual void perform_frame_issue(FrameOp *frame, 
@@ -1193,6 +1209,7 @@ namespace Legion {
       static void handle_prepipeline_stage(const void *args);
       static void handle_dependence_stage(const void *args);
       static void handle_post_end_task(const void *args);
+      static void handle_auto_trace_flush(const void *args);
     public:
       void free_remote_contexts(void);
       void send_remote_context(AddressSpaceID remote_instance, 
@@ -1209,6 +1226,18 @@ namespace Legion {
                                bool silence_warnings, bool inlining_enabled);
       // Must be called while holding the dependence lock
       void insert_unordered_ops(AutoLock &d_lock);
+    protected:
+      // Automatic trace detection, returns true if the operation
+      // is being held back until we know if it starts or continues
+      // a repeated sequence of operations
+      bool record_auto_trace_operation(Operation *op);
+      void update_auto_trace_candidate(uint64_t hash);
+      // Must be called while holding the auto trace lock
+      void issue_auto_trace(bool traced);
+      void flush_stalled_auto_trace(unsigned long long epoch);
+      void enqueue_child_operation(Operation *op, bool unordered);
+      void report_auto_trace_statistics(void);
+      static uint64_t hash_auto_trace_operation(Operation *op);
     public:
       void clone_local_fields(
           std::map<FieldSpace,std::vector<LocalFieldInfo> > &child_local) const;
@@ -1276,6 +1305,30 @@ namespace Legion {
       LegionMap<TraceID,LegionTrace*,TASK_TRACES_ALLOC>::tracked traces;
       LegionTrace *current_trace;
       LegionTrace *previous_trace;
+    protected:
+      // Automatic tracing of repeated operation sequences, the history
+      // holds hashes of recently issued operations and the runs count
+      // how many consecutive operations have matched the operation one
+      // period back for each candidate period length
+      const bool auto_trace_enabled;
+      // Only touched by the application thread
+      bool auto_trace_issuing;
+      // Protects the held back operations since a meta-task can issue
+      // them if they stall while the application is busy elsewhere
+      mutable LocalLock auto_trace_lock;
+      // Bumped every time the held back operations are issued
+      unsigned long long auto_trace_epoch;
+      // Completion of the last operation issued before anything was held
+      ApEvent auto_trace_last_issued;
+      std::vector<uint64_t> auto_trace_history;
+      std::vector<unsigned> auto_trace_runs;
+      std::vector<uint64_t> auto_trace_candidate;
+      std::vector<Operation*> auto_trace_buffer;
+      std::map<std::vector<uint64_t>,TraceID> auto_trace_ids;
+      unsigned long long auto_trace_operations;
+      unsigned long long auto_trace_hits, auto_trace_misses;
+      unsigned long long auto_trace_replayed_ops;
+    protected:
       bool valid_wait_event;
       RtUserEvent window_wait;
       std::deque<ApEvent> frame_events;
@@ -225,6 +225,17 @@ namespace Legion {
       context_index = index;
     }
 
+    //--------------------------------------------------------------------------
+    void Operation::update_context_index(size_t index)
+    //--------------------------------------------------------------------------
+    {
+#ifdef DEBUG_LEGION
+      assert(track_parent);
+      assert(context_index < index);
+#endif
+      context_index = index;
+    }
+
     //--------------------------------------------------------------------------
     void Operation::set_trace(LegionTrace *t,
                               const std::vector<StaticDependence> *dependences,
@@ -17869,11 +17880,12 @@ namespace Legion {
 
     //--------------------------------------------------------------------------
     Future AllReduceOp::initialize(InnerContext *ctx, const FutureMap &fm, 
-                                   ReductionOpID redop_id,bool is_deterministic)
+                                  ReductionOpID redop_id_,bool is_deterministic)
     //--------------------------------------------------------------------------
     {
       initialize_operation(ctx, true/*track*/);
       future_map = fm;
+      redop_id = redop_id_;
       redop = runtime->get_reduction(redop_id);
       result = Future(new FutureImpl(runtime, true/*register*/,
                   runtime->get_available_distributed_id(),
@@ -17903,6 +17915,9 @@ namespace Legion {
       deactivate_operation();
       future_map = FutureMap();
       result = Future();
+#ifdef DEBUG_LEGION
+      assert(remote_futures.empty());
+#endif
       runtime->free_all_reduce_op(this);
     }
 
@@ -17950,6 +17965,53 @@ namespace Legion {
     {
       std::map<DomainPoint,Future> futures;
       future_map.impl->get_all_futures(futures);
+      if (runtime->legion_spy_enabled)
+      {
+        for (std::map<DomainPoint,Future>::const_iterator it = 
+              futures.begin(); it != futures.end(); it++)
+        {
+          FutureImpl *impl = it->second.impl;
+          const ApEvent ready_event = impl->get_ready_event();
+          if (ready_event.exists())
+            LegionSpy::log_future_use(unique_op_id, ready_event);
+        }
+      }
+      // Without a need for determinism, fold the values on the nodes 
+      // where the point tasks left them and combine the partial results 
+      // up a tree of address spaces instead of pulling every value here.
+      // The order of the folds then depends on where the points ran.
+      if (!deterministic && (runtime->total_address_spaces > 1))
+      {
+        AllReduceCollective *root = 
+          new AllReduceCollective(runtime, this, redop_id, unique_op_id);
+        std::map<AddressSpaceID,std::vector<DistributedID> > remote_groups;
+        for (std::map<DomainPoint,Future>::const_iterator it = 
+              futures.begin(); it != futures.end(); it++)
+        {
+          FutureImpl *impl = it->second.impl;
+          const AddressSpaceID space = impl->acquire_reduction_space();
+          if (space != runtime->address_space)
+          {
+            remote_groups[space].push_back(impl->did);
+            remote_futures.push_back(impl);
+          }
+          else
+            root->add_local_future(impl);
+        }
+        std::vector<AllReduceCollective::FutureGroup> groups;
+        groups.reserve(remote_groups.size());
+        for (std::map<AddressSpaceID,std::vector<DistributedID> >::
+              iterator it = remote_groups.begin(); 
+              it != remote_groups.end(); it++)
+        {
+          groups.resize(groups.size() + 1);
+          groups.back().first = it->first;
+          groups.back().second.swap(it->second);
+        }
+        // This will call finish_all_reduce when it is done
+        root->perform(groups, 0, groups.size());
+        return;
+      }
       void *result_buffer = malloc(redop->sizeof_rhs);
       redop->init(result_buffer, 1/*count*/);
       for (std::map<DomainPoint,Future>::const_iterator it = 
@@ -17967,17 +18029,18 @@ namespace Legion {
         const void *data = impl->get_untyped_result(true,NULL,true/*internal*/);
         redop->fold(result_buffer, data, 1/*count*/, true/*exclusive*/);
       }
-      if (runtime->legion_spy_enabled)
-      {
-        for (std::map<DomainPoint,Future>::const_iterator it = 
-              futures.begin(); it != futures.end(); it++)
-        {
-          FutureImpl *impl = it->second.impl;
-          const ApEvent ready_event = impl->get_ready_event();
-          if (ready_event.exists())
-            LegionSpy::log_future_use(unique_op_id, ready_event);
-        }
-      }
+      finish_all_reduce(result_buffer);
+    }
+
+    //--------------------------------------------------------------------------
+    void AllReduceOp::finish_all_reduce(void *result_buffer)
+    //--------------------------------------------------------------------------
+    {
+      // Let the remote copies of the values go now that we're done
+      for (std::vector<FutureImpl*>::const_iterator it = 
+            remote_futures.begin(); it != remote_futures.end(); it++)
+        (*it)->release_reduction_space();
+      remote_futures.clear();
       // Tell the future about the final result which it will own
       result.impl->set_result(result_buffer, redop->sizeof_rhs, true/*own*/);
 #ifdef LEGION_SPY
@@ -17990,6 +18053,276 @@ namespace Legion {
       complete_execution();
     }
 
+    ///////////////////////////////////////////////////////////// 
+    // All Reduce Collective 
+    /////////////////////////////////////////////////////////////
+
+    //--------------------------------------------------------------------------
+    AllReduceCollective::AllReduceCollective(Runtime *rt, AllReduceOp *o,
+                                             ReductionOpID id, UniqueID uid)
+      : runtime(rt), op(o), redop_id(id), redop(rt->get_reduction(id)),
+        op_uid(uid), parent_space(rt->address_space), parent(NULL),
+        value(malloc(redop->sizeof_rhs)), remaining(0)
+    //--------------------------------------------------------------------------
+    {
+      redop->init(value, 1/*count*/);
+    }
+
+    //--------------------------------------------------------------------------
+    AllReduceCollective::AllReduceCollective(Runtime *rt, ReductionOpID id,
+                                    UniqueID uid, AddressSpaceID parent_sp,
+                                    AllReduceCollective *par)
+      : runtime(rt), op(NULL), redop_id(id), redop(rt->get_reduction(id)),
+        op_uid(uid), parent_space(parent_sp), parent(par),
+        value(malloc(redop->sizeof_rhs)), remaining(0)
+    //--------------------------------------------------------------------------
+    {
+      redop->init(value, 1/*count*/);
+    }
+
+    //--------------------------------------------------------------------------
+    AllReduceCollective::AllReduceCollective(const AllReduceCollective &rhs)
+      : runtime(NULL), op(NULL), redop_id(0), redop(NULL), op_uid(0),
+        parent_space(0), parent(NULL)
+    //--------------------------------------------------------------------------
+    {
+      // should never be called
+      assert(false);
+    }
+
+    //--------------------------------------------------------------------------
+    AllReduceCollective::~AllReduceCollective(void)
+    //--------------------------------------------------------------------------
+    {
+      // The root hands its value off to the op
+      if (value != NULL)
+        free(value);
+    }
+
+    //--------------------------------------------------------------------------
+    AllReduceCollective& AllReduceCollective::operator=(
+                                                const AllReduceCollective &rhs)
+    //--------------------------------------------------------------------------
+    {
+      // should never be called
+      assert(false);
+      return *this;
+    }
+
+    //--------------------------------------------------------------------------
+    void AllReduceCollective::add_local_future(FutureImpl *future)
+    //--------------------------------------------------------------------------
+    {
+      local_futures.push_back(future);
+    }
+
+    //--------------------------------------------------------------------------
+    void AllReduceCollective::perform(const std::vector<FutureGroup> &groups,
+                                      size_t start, size_t stop)
+    //--------------------------------------------------------------------------
+    {
+      // Split the groups into at most radix slices, each of which is sent
+      // to the space of its first group to fold and pass on the rest
+      const size_t total = stop - start;
+      const size_t slices = 
+        std::min<size_t>(std::max(runtime->legion_collective_radix, 1), total);
+      // One contribution from each child and one for our local futures
+      remaining = slices + 1;
+      for (unsigned idx = 0; idx < slices; idx++)
+      {
+        const size_t first = start + (idx * total) / slices;
+        const size_t last = start + ((idx + 1) * total) / slices;
+        Serializer rez;
+        {
+          RezCheck z(rez);
+          rez.serialize(redop_id);
+          rez.serialize(op_uid);
+          rez.serialize(this);
+          rez.serialize<size_t>(last - first);
+          for (unsigned idx2 = first; idx2 < last; idx2++)
+          {
+            const FutureGroup &group = groups[idx2];
+            rez.serialize(group.first);
+            rez.serialize<size_t>(group.second.size());
+            for (std::vector<DistributedID>::const_iterator it = 
+                  group.second.begin(); it != group.second.end(); it++)
+              rez.serialize(*it);
+          }
+        }
+        runtime->send_all_reduce_request(groups[first].first, rez);
+      }
+      // Fold our local futures once their values are ready here
+      std::set<ApEvent> ready_events;
+      for (std::vector<FutureImpl*>::const_iterator it = 
+            local_futures.begin(); it != local_futures.end(); it++)
+      {
+        const ApEvent ready = (*it)->subscribe();
+        if (ready.exists())
+          ready_events.insert(ready);
+      }
+      const RtEvent ready = Runtime::protect_merge_events(ready_events);
+      if (ready.exists() && !ready.has_triggered())
+      {
+        DeferFoldArgs args(this);
+        runtime->issue_runtime_meta_task(args, 
+            LG_THROUGHPUT_DEFERRED_PRIORITY, ready);
+      }
+      else
+        fold_local_futures();
+    }
+
+    //--------------------------------------------------------------------------
+    void AllReduceCollective::fold_local_futures(void)
+    //--------------------------------------------------------------------------
+    {
+      if (!local_futures.empty())
+      {
+        void *local_value = malloc(redop->sizeof_rhs);
+        redop->init(local_value, 1/*count*/);
+        for (std::vector<FutureImpl*>::const_iterator it = 
+              local_futures.begin(); it != local_futures.end(); it++)
+        {
+          const size_t future_size = 
+            (*it)->get_untyped_size(true/*internal*/);
+          if (future_size != redop->sizeof_rhs)
+            REPORT_LEGION_ERROR(ERROR_FUTURE_MAP_REDOP_TYPE_MISMATCH,
+                "Future in future map reduction for operation (UID %lld) "
+                "does not have the right input size for the given reduction "
+                "operator. Future has size %zd bytes but reduction operator "
+                "expects RHS inputs of %zd bytes.", op_uid, future_size,
+                redop->sizeof_rhs)
+          const void *data = 
+            (*it)->get_untyped_result(true, NULL, true/*internal*/);
+          redop->fold(local_value, data, 1/*count*/, true/*exclusive*/);
+        }
+        local_futures.clear();
+        fold_partial(local_value, redop->sizeof_rhs);
+        free(local_value);
+      }
+      else
+        fold_partial(NULL, 0);
+    }
+
+    //--------------------------------------------------------------------------
+    void AllReduceCollective::fold_partial(const void *partial, 
+                                           size_t partial_size)
+    //--------------------------------------------------------------------------
+    {
+      {
+        AutoLock c_lock(collective_lock);
+        if (partial_size > 0)
+        {
+#ifdef DEBUG_LEGION
+          assert(partial_size == redop->sizeof_rhs);
+#endif
+          redop->fold(value, partial, 1/*count*/, true/*exclusive*/);
+        }
+#ifdef DEBUG_LEGION
+        assert(remaining > 0);
+#endif
+        if (--remaining > 0)
+          return;
+      }
+      finish();
+    }
+
+    //--------------------------------------------------------------------------
+    void AllReduceCollective::finish(void)
+    //--------------------------------------------------------------------------
+    {
+      if (op != NULL)
+      {
+        // The op takes ownership of the value
+        void *result = value;
+        value = NULL;
+        op->finish_all_reduce(result);
+      }
+      else
+      {
+        Serializer rez;
+        {
+          RezCheck z(rez);
+          rez.serialize(parent);
+          rez.serialize<size_t>(redop->sizeof_rhs);
+          rez.serialize(value, redop->sizeof_rhs);
+        }
+        runtime->send_all_reduce_response(parent_space, rez);
+      }
+      delete this;
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ void AllReduceCollective::handle_deferred_fold(const void *args)
+    //--------------------------------------------------------------------------
+    {
+      const DeferFoldArgs *dargs = (const DeferFoldArgs*)args;
+      dargs->collective->fold_local_futures();
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ void AllReduceCollective::handle_request(Deserializer &derez,
+                                  Runtime *runtime, AddressSpaceID source)
+    //--------------------------------------------------------------------------
+    {
+      DerezCheck z(derez);
+      ReductionOpID redop_id;
+      derez.deserialize(redop_id);
+      UniqueID op_uid;
+      derez.deserialize(op_uid);
+      AllReduceCollective *parent;
+      derez.deserialize(parent);
+      size_t num_groups;
+      derez.deserialize(num_groups);
+#ifdef DEBUG_LEGION
+      assert(num_groups > 0);
+#endif
+      std::vector<FutureGroup> groups(num_groups);
+      for (unsigned idx = 0; idx < num_groups; idx++)
+      {
+        FutureGroup &group = groups[idx];
+        derez.deserialize(group.first);
+        size_t num_futures;
+        derez.deserialize(num_futures);
+        group.second.resize(num_futures);
+        for (unsigned idx2 = 0; idx2 < num_futures; idx2++)
+          derez.deserialize(group.second[idx2]);
+      }
+      AllReduceCollective *collective = 
+        new AllReduceCollective(runtime, redop_id, op_uid, source, parent);
+      // The first group is the one that lives here, the owners of these
+      // futures are keeping our copies alive until the reduction is done
+#ifdef DEBUG_LEGION
+      assert(groups[0].first == runtime->address_space);
+#endif
+      for (std::vector<DistributedID>::const_iterator it = 
+            groups[0].second.begin(); it != groups[0].second.end(); it++)
+      {
+        DistributedCollectable *dc = runtime->find_distributed_collectable(*it);
+#ifdef DEBUG_LEGION
+        FutureImpl *future = dynamic_cast<FutureImpl*>(dc);
+        assert(future != NULL);
+#else
+        FutureImpl *future = static_cast<FutureImpl*>(dc);
+#endif
+        collective->add_local_future(future);
+      }
+      collective->perform(groups, 1, num_groups);
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ void AllReduceCollective::handle_response(Deserializer &derez)
+    //--------------------------------------------------------------------------
+    {
+      DerezCheck z(derez);
+      AllReduceCollective *collective;
+      derez.deserialize(collective);
+      size_t partial_size;
+      derez.deserialize(partial_size);
+      const void *partial = derez.get_current_pointer();
+      derez.advance_pointer(partial_size);
+      collective->fold_partial(partial, partial_size);
+    }
+
     ///////////////////////////////////////////////////////////// 
     // Remote Op 
     /////////////////////////////////////////////////////////////
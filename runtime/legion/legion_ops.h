@@ -314,6 +314,7 @@ namespace Legion {
                                    const RegionRequirement &req,
                                    LogicalPartition start_node);
       void set_tracking_parent(size_t index);
+      void update_context_index(size_t index);
       void set_trace(LegionTrace *trace,
                      const std::vector<StaticDependence> *dependences,
                      const LogicalTraceInfo *trace_info = NULL);
@@ -3558,11 +3559,79 @@ namespace Legion {
       virtual void trigger_dependence_analysis(void);
       virtual void trigger_mapping(void);
       virtual void deferred_execute(void);
+    public:
+      // Called with the final value which the result future will own
+      void finish_all_reduce(void *result_buffer);
     protected:
       FutureMap future_map;
+      ReductionOpID redop_id;
       const ReductionOp *redop; 
       Future result;
       bool deterministic;
+      // Futures whose values are being folded on remote nodes
+      std::vector<FutureImpl*> remote_futures;
+    };
+
+    /**
+     * \class AllReduceCollective
+     * One node in the tree of address spaces that an AllReduceOp 
+     * uses to fold the futures of a future map where their values
+     * live. Each node folds its local futures together with the
+     * partial results of its children and then passes the partial
+     * result on to its parent. The root node belongs to the op.
+     */
+    class AllReduceCollective {
+    public:
+      struct DeferFoldArgs : public LgTaskArgs<DeferFoldArgs> {
+      public:
+        static const LgTaskID TASK_ID = LG_DEFER_ALL_REDUCE_FOLD_TASK_ID;
+      public:
+        DeferFoldArgs(AllReduceCollective *c)
+          : LgTaskArgs<DeferFoldArgs>(implicit_provenance), collective(c) { }
+      public:
+        AllReduceCollective *const collective;
+      };
+      // The futures of a future map that live in one address space
+      typedef std::pair<AddressSpaceID,
+                        std::vector<DistributedID> > FutureGroup;
+    public:
+      AllReduceCollective(Runtime *rt, AllReduceOp *op, ReductionOpID redop,
+                          UniqueID op_uid);
+      AllReduceCollective(Runtime *rt, ReductionOpID redop, UniqueID op_uid,
+                          AddressSpaceID parent_space, 
+                          AllReduceCollective *parent);
+      AllReduceCollective(const AllReduceCollective &rhs);
+      ~AllReduceCollective(void);
+    public:
+      AllReduceCollective& operator=(const AllReduceCollective &rhs);
+    public:
+      void add_local_future(FutureImpl *future);
+      // Sends the groups in [start,stop) to our children and folds our
+      // local futures, the node deletes itself once it is done
+      void perform(const std::vector<FutureGroup> &groups, 
+                   size_t start, size_t stop);
+    protected:
+      void fold_local_futures(void);
+      void fold_partial(const void *partial, size_t partial_size);
+      void finish(void);
+    public:
+      static void handle_deferred_fold(const void *args);
+      static void handle_request(Deserializer &derez, Runtime *runtime,
+                                 AddressSpaceID source);
+      static void handle_response(Deserializer &derez);
+    public:
+      Runtime *const runtime;
+      AllReduceOp *const op;
+      const ReductionOpID redop_id;
+      const ReductionOp *const redop;
+      const UniqueID op_uid;
+      const AddressSpaceID parent_space;
+      AllReduceCollective *const parent;
+    protected:
+      mutable LocalLock collective_lock;
+      std::vector<FutureImpl*> local_futures;
+      void *value;
+      unsigned remaining;
     };
 
     /**
@@ -22,6 +22,15 @@
 #endif
 
 #include "u_atomic.h"
+#include "realm/redop.h"
+
+#if !defined(__CUDACC__) && !defined(__HIPCC__)
+#if defined(__AVX__) || defined(__AVX512F__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#endif
 
 namespace Legion {
 
@@ -7388,8 +7397,222 @@ namespace Legion {
 #endif
   }
 
+  namespace Internal {
+
+    // Bulk kernels for the exclusive paths of the built-in sum, product,
+    //  max, and min reductions on float, double, int32_t, and int64_t.
+    //  Each kernel covers as much of the range as it can with the widest
+    //  vectors the compiler has been told it may use and then finishes
+    //  the tail with the scalar reduction.  Max and min select with the
+    //  same comparison as the scalar code so NaNs and signed zeros behave
+    //  identically in both paths.
+    enum BuiltinRedopKind {
+      BUILTIN_REDOP_SUM,
+      BUILTIN_REDOP_PROD,
+      BUILTIN_REDOP_MAX,
+      BUILTIN_REDOP_MIN
+    };
+
+    // lanes == 0 means there is no vector implementation for this
+    //  type/operator pair on the current target
+    template<typename T, int KIND>
+    struct BuiltinRedopSIMD {
+      static const size_t lanes = 0;
+      static inline void step(T *lhs, const T *rhs) { }
+    };
+
+#define LEGION_REDOP_SIMD_STEP(T, KIND, LANES, VEC, LOAD, STORE, EXPR) \
+    template<> \
+    struct BuiltinRedopSIMD<T, KIND> { \
+      static const size_t lanes = LANES; \
+      static inline void step(T *lhs, const T *rhs) \
+      { \
+        const VEC l = LOAD(lhs); \
+        const VEC r = LOAD(rhs); \
+        STORE(lhs, EXPR); \
+      } \
+    };
+
+#if !defined(__CUDACC__) && !defined(__HIPCC__)
+#if defined(__AVX512F__)
+#define LEGION_REDOP_SIMD_LOADI(p) \
+    _mm512_loadu_si512(reinterpret_cast<const void*>(p))
+#define LEGION_REDOP_SIMD_STOREI(p, v) \
+    _mm512_storeu_si512(reinterpret_cast<void*>(p), v)
+    LEGION_REDOP_SIMD_STEP(float, BUILTIN_REDOP_SUM, 16, __m512,
+        _mm512_loadu_ps, _mm512_storeu_ps, _mm512_add_ps(l, r))
+    LEGION_REDOP_SIMD_STEP(float, BUILTIN_REDOP_PROD, 16, __m512,
+        _mm512_loadu_ps, _mm512_storeu_ps, _mm512_mul_ps(l, r))
+    LEGION_REDOP_SIMD_STEP(float, BUILTIN_REDOP_MAX, 16, __m512,
+        _mm512_loadu_ps, _mm512_storeu_ps, _mm512_max_ps(r, l))
+    LEGION_REDOP_SIMD_STEP(float, BUILTIN_REDOP_MIN, 16, __m512,
+        _mm512_loadu_ps, _mm512_storeu_ps, _mm512_min_ps(r, l))
+    LEGION_REDOP_SIMD_STEP(double, BUILTIN_REDOP_SUM, 8, __m512d,
+        _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd(l, r))
+    LEGION_REDOP_SIMD_STEP(double, BUILTIN_REDOP_PROD, 8, __m512d,
+        _mm512_loadu_pd, _mm512_storeu_pd, _mm512_mul_pd(l, r))
+    LEGION_REDOP_SIMD_STEP(double, BUILTIN_REDOP_MAX, 8, __m512d,
+        _mm512_loadu_pd, _mm512_storeu_pd, _mm512_max_pd(r, l))
+    LEGION_REDOP_SIMD_STEP(double, BUILTIN_REDOP_MIN, 8, __m512d,
+        _mm512_loadu_pd, _mm512_storeu_pd, _mm512_min_pd(r, l))
+    LEGION_REDOP_SIMD_STEP(int32_t, BUILTIN_REDOP_SUM, 16, __m512i,
+        LEGION_REDOP_SIMD_LOADI, LEGION_REDOP_SIMD_STOREI,
+        _mm512_add_epi32(l, r))
+    LEGION_REDOP_SIMD_STEP(int32_t, BUILTIN_REDOP_PROD, 16, __m512i,
+        LEGION_REDOP_SIMD_LOADI, LEGION_REDOP_SIMD_STOREI,
+        _mm512_mullo_epi32(l, r))
+    LEGION_REDOP_SIMD_STEP(int32_t, BUILTIN_REDOP_MAX, 16, __m512i,
+        LEGION_REDOP_SIMD_LOADI, LEGION_REDOP_SIMD_STOREI,
+        _mm512_max_epi32(l, r))
+    LEGION_REDOP_SIMD_STEP(int32_t, BUILTIN_REDOP_MIN, 16, __m512i,
+        LEGION_REDOP_SIMD_LOADI, LEGION_REDOP_SIMD_STOREI,
+        _mm512_min_epi32(l, r))
+    LEGION_REDOP_SIMD_STEP(int64_t, BUILTIN_REDOP_SUM, 8, __m512i,
+        LEGION_REDOP_SIMD_LOADI, LEGION_REDOP_SIMD_STOREI,
+        _mm512_add_epi64(l, r))
+    LEGION_REDOP_SIMD_STEP(int64_t, BUILTIN_REDOP_MAX, 8, __m512i,
+        LEGION_REDOP_SIMD_LOADI, LEGION_REDOP_SIMD_STOREI,
+        _mm512_max_epi64(l, r))
+    LEGION_REDOP_SIMD_STEP(int64_t, BUILTIN_REDOP_MIN, 8, __m512i,
+        LEGION_REDOP_SIMD_LOADI, LEGION_REDOP_SIMD_STOREI,
+        _mm512_min_epi64(l, r))
+#undef LEGION_REDOP_SIMD_LOADI
+#undef LEGION_REDOP_SIMD_STOREI
+#elif defined(__AVX__)
+    LEGION_REDOP_SIMD_STEP(float, BUILTIN_REDOP_SUM, 8, __m256,
+        _mm256_loadu_ps, _mm256_storeu_ps, _mm256_add_ps(l, r))
+    LEGION_REDOP_SIMD_STEP(float, BUILTIN_REDOP_PROD, 8, __m256,
+        _mm256_loadu_ps, _mm256_storeu_ps, _mm256_mul_ps(l, r))
+    LEGION_REDOP_SIMD_STEP(float, BUILTIN_REDOP_MAX, 8, __m256,
+        _mm256_loadu_ps, _mm256_storeu_ps, _mm256_max_ps(r, l))
+    LEGION_REDOP_SIMD_STEP(float, BUILTIN_REDOP_MIN, 8, __m256,
+        _mm256_loadu_ps, _mm256_storeu_ps, _mm256_min_ps(r, l))
+    LEGION_REDOP_SIMD_STEP(double, BUILTIN_REDOP_SUM, 4, __m256d,
+        _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd(l, r))
+    LEGION_REDOP_SIMD_STEP(double, BUILTIN_REDOP_PROD, 4, __m256d,
+        _mm256_loadu_pd, _mm256_storeu_pd, _mm256_mul_pd(l, r))
+    LEGION_REDOP_SIMD_STEP(double, BUILTIN_REDOP_MAX, 4, __m256d,
+        _mm256_loadu_pd, _mm256_storeu_pd, _mm256_max_pd(r, l))
+    LEGION_REDOP_SIMD_STEP(double, BUILTIN_REDOP_MIN, 4, __m256d,
+        _mm256_loadu_pd, _mm256_storeu_pd, _mm256_min_pd(r, l))
+#ifdef __AVX2__
+#define LEGION_REDOP_SIMD_LOADI(p) \
+    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))
+#define LEGION_REDOP_SIMD_STOREI(p, v) \
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v)
+    LEGION_REDOP_SIMD_STEP(int32_t, BUILTIN_REDOP_SUM, 8, __m256i,
+        LEGION_REDOP_SIMD_LOADI, LEGION_REDOP_SIMD_STOREI,
+        _mm256_add_epi32(l, r))
+    LEGION_REDOP_SIMD_STEP(int32_t, BUILTIN_REDOP_PROD, 8, __m256i,
+        LEGION_REDOP_SIMD_LOADI, LEGION_REDOP_SIMD_STOREI,
+        _mm256_mullo_epi32(l, r))
+    LEGION_REDOP_SIMD_STEP(int32_t, BUILTIN_REDOP_MAX, 8, __m256i,
+        LEGION_REDOP_SIMD_LOADI, LEGION_REDOP_SIMD_STOREI,
+        _mm256_max_epi32(l, r))
+    LEGION_REDOP_SIMD_STEP(int32_t, BUILTIN_REDOP_MIN, 8, __m256i,
+        LEGION_REDOP_SIMD_LOADI, LEGION_REDOP_SIMD_STOREI,
+        _mm256_min_epi32(l, r))
+    LEGION_REDOP_SIMD_STEP(int64_t, BUILTIN_REDOP_SUM, 4, __m256i,
+        LEGION_REDOP_SIMD_LOADI, LEGION_REDOP_SIMD_STOREI,
+        _mm256_add_epi64(l, r))
+#undef LEGION_REDOP_SIMD_LOADI
+#undef LEGION_REDOP_SIMD_STOREI
+#endif // __AVX2__
+#elif defined(__ARM_NEON)
+    LEGION_REDOP_SIMD_STEP(float, BUILTIN_REDOP_SUM, 4, float32x4_t,
+        vld1q_f32, vst1q_f32, vaddq_f32(l, r))
+    LEGION_REDOP_SIMD_STEP(float, BUILTIN_REDOP_PROD, 4, float32x4_t,
+        vld1q_f32, vst1q_f32, vmulq_f32(l, r))
+    LEGION_REDOP_SIMD_STEP(float, BUILTIN_REDOP_MAX, 4, float32x4_t,
+        vld1q_f32, vst1q_f32, vbslq_f32(vcgtq_f32(r, l), r, l))
+    LEGION_REDOP_SIMD_STEP(float, BUILTIN_REDOP_MIN, 4, float32x4_t,
+        vld1q_f32, vst1q_f32, vbslq_f32(vcltq_f32(r, l), r, l))
+#ifdef __aarch64__
+    LEGION_REDOP_SIMD_STEP(double, BUILTIN_REDOP_SUM, 2, float64x2_t,
+        vld1q_f64, vst1q_f64, vaddq_f64(l, r))
+    LEGION_REDOP_SIMD_STEP(double, BUILTIN_REDOP_PROD, 2, float64x2_t,
+        vld1q_f64, vst1q_f64, vmulq_f64(l, r))
+    LEGION_REDOP_SIMD_STEP(double, BUILTIN_REDOP_MAX, 2, float64x2_t,
+        vld1q_f64, vst1q_f64, vbslq_f64(vcgtq_f64(r, l), r, l))
+    LEGION_REDOP_SIMD_STEP(double, BUILTIN_REDOP_MIN, 2, float64x2_t,
+        vld1q_f64, vst1q_f64, vbslq_f64(vcltq_f64(r, l), r, l))
+#endif
+    LEGION_REDOP_SIMD_STEP(int32_t, BUILTIN_REDOP_SUM, 4, int32x4_t,
+        vld1q_s32, vst1q_s32, vaddq_s32(l, r))
+    LEGION_REDOP_SIMD_STEP(int32_t, BUILTIN_REDOP_PROD, 4, int32x4_t,
+        vld1q_s32, vst1q_s32, vmulq_s32(l, r))
+    LEGION_REDOP_SIMD_STEP(int32_t, BUILTIN_REDOP_MAX, 4, int32x4_t,
+        vld1q_s32, vst1q_s32, vmaxq_s32(l, r))
+    LEGION_REDOP_SIMD_STEP(int32_t, BUILTIN_REDOP_MIN, 4, int32x4_t,
+        vld1q_s32, vst1q_s32, vminq_s32(l, r))
+    LEGION_REDOP_SIMD_STEP(int64_t, BUILTIN_REDOP_SUM, 2, int64x2_t,
+        vld1q_s64, vst1q_s64, vaddq_s64(l, r))
+#endif
+#endif // !__CUDACC__ && !__HIPCC__
+
+#undef LEGION_REDOP_SIMD_STEP
+
+    template<typename REDOP, int KIND>
+    struct BuiltinRedopKernels {
+      typedef typename REDOP::RHS T;
+      typedef BuiltinRedopSIMD<T, KIND> SIMD;
+
+      static void apply_exclusive(T *lhs, const T *rhs, size_t count)
+      {
+        size_t i = 0;
+        if (SIMD::lanes > 0)
+          for ( ; (i + SIMD::lanes) <= count; i += SIMD::lanes)
+            SIMD::step(lhs + i, rhs + i);
+        for ( ; i < count; i++)
+          REDOP::template apply<true>(lhs[i], rhs[i]);
+      }
+
+      static void fold_exclusive(T *rhs1, const T *rhs2, size_t count)
+      {
+        size_t i = 0;
+        if (SIMD::lanes > 0)
+          for ( ; (i + SIMD::lanes) <= count; i += SIMD::lanes)
+            SIMD::step(rhs1 + i, rhs2 + i);
+        for ( ; i < count; i++)
+          REDOP::template fold<true>(rhs1[i], rhs2[i]);
+      }
+    };
+
+  }; // namespace Internal
+
 }; // namespace Legion
 
+namespace Realm {
+
+  // route Realm's untyped bulk apply/fold for the built-in reductions
+  //  through the kernels above
+#define LEGION_BUILTIN_REDOP_KERNELS(REDOP, T, KIND) \
+  template<> \
+  struct ReductionKernels<Legion::REDOP<T> > \
+    : public Legion::Internal::BuiltinRedopKernels<Legion::REDOP<T>, \
+                                       Legion::Internal::KIND> { };
+
+  LEGION_BUILTIN_REDOP_KERNELS(SumReduction, float, BUILTIN_REDOP_SUM)
+  LEGION_BUILTIN_REDOP_KERNELS(SumReduction, double, BUILTIN_REDOP_SUM)
+  LEGION_BUILTIN_REDOP_KERNELS(SumReduction, int32_t, BUILTIN_REDOP_SUM)
+  LEGION_BUILTIN_REDOP_KERNELS(SumReduction, int64_t, BUILTIN_REDOP_SUM)
+  LEGION_BUILTIN_REDOP_KERNELS(ProdReduction, float, BUILTIN_REDOP_PROD)
+  LEGION_BUILTIN_REDOP_KERNELS(ProdReduction, double, BUILTIN_REDOP_PROD)
+  LEGION_BUILTIN_REDOP_KERNELS(ProdReduction, int32_t, BUILTIN_REDOP_PROD)
+  LEGION_BUILTIN_REDOP_KERNELS(ProdReduction, int64_t, BUILTIN_REDOP_PROD)
+  LEGION_BUILTIN_REDOP_KERNELS(MaxReduction, float, BUILTIN_REDOP_MAX)
+  LEGION_BUILTIN_REDOP_KERNELS(MaxReduction, double, BUILTIN_REDOP_MAX)
+  LEGION_BUILTIN_REDOP_KERNELS(MaxReduction, int32_t, BUILTIN_REDOP_MAX)
+  LEGION_BUILTIN_REDOP_KERNELS(MaxReduction, int64_t, BUILTIN_REDOP_MAX)
+  LEGION_BUILTIN_REDOP_KERNELS(MinReduction, float, BUILTIN_REDOP_MIN)
+  LEGION_BUILTIN_REDOP_KERNELS(MinReduction, double, BUILTIN_REDOP_MIN)
+  LEGION_BUILTIN_REDOP_KERNELS(MinReduction, int32_t, BUILTIN_REDOP_MIN)
+  LEGION_BUILTIN_REDOP_KERNELS(MinReduction, int64_t, BUILTIN_REDOP_MIN)
+
+#undef LEGION_BUILTIN_REDOP_KERNELS
+
+}; // namespace Realm
+
 #undef __MAX__
 #undef __MIN__
 
@@ -2335,6 +2335,8 @@ namespace Legion {
         replay_parallelism(t->runtime->max_replay_parallelism),
         has_virtual_mapping(false), last_fence(NULL),
         recording_done(Runtime::create_rt_user_event()),
+        replay_count(0), lowering_attempted(false),
+        subgraph(Realm::Subgraph::NO_SUBGRAPH),
         pre(t->runtime->forest), post(t->runtime->forest),
         pre_reductions(t->runtime->forest), post_reductions(t->runtime->forest),
         consumed_reductions(t->runtime->forest)
@@ -2392,6 +2394,10 @@ namespace Legion {
         if (!remote_memos.empty())
           release_remote_memos();
       }
+      // Instantiations from different replays can still be running so
+      // we can only destroy the subgraph once all of them are done
+      if (subgraph.exists())
+        subgraph.destroy(Runtime::merge_events(NULL, subgraph_completions));
     }
 
     //--------------------------------------------------------------------------
@@ -2415,6 +2421,10 @@ namespace Legion {
 
       events[fence_completion_id] = fence_completion;
 
+      if (!lowering_attempted && (runtime->subgraph_replay_threshold > 0) &&
+          (++replay_count >= runtime->subgraph_replay_threshold))
+        lower_to_subgraph();
+
       for (std::map<unsigned, unsigned>::iterator it = crossing_events.begin();
            it != crossing_events.end(); ++it)
       {
@@ -2423,6 +2433,36 @@ namespace Legion {
         user_events[it->second] = ev;
       }
 
+      if (subgraph.exists())
+      {
+        // Launch all the lowered instructions at once, the preconditions
+        // are either known already or are user events triggered by the
+        // slices, and the postconditions are filled in before any of the
+        // slices can look at them
+        std::vector<Realm::Event> preconditions(subgraph_preconditions.size());
+        for (unsigned idx = 0; idx < subgraph_preconditions.size(); idx++)
+          preconditions[idx] = events[subgraph_preconditions[idx]];
+        std::vector<Realm::Event> postconditions(
+            subgraph_postconditions.size());
+        const ApEvent completion(subgraph.instantiate(NULL, 0,
+              Realm::ProfilingRequestSet(), preconditions, postconditions));
+        // Prune instantiations that are already done so this stays small
+        for (std::set<ApEvent>::iterator it = subgraph_completions.begin();
+              it != subgraph_completions.end(); /*nothing*/)
+        {
+          if (it->has_triggered())
+          {
+            std::set<ApEvent>::iterator to_delete = it++;
+            subgraph_completions.erase(to_delete);
+          }
+          else
+            it++;
+        }
+        subgraph_completions.insert(completion);
+        for (unsigned idx = 0; idx < subgraph_postconditions.size(); idx++)
+          events[subgraph_postconditions[idx]] = ApEvent(postconditions[idx]);
+      }
+
       replay_ready = Runtime::create_rt_user_event();
       std::set<RtEvent> replay_done_events;
       const std::vector<Processor> &replay_targets =
@@ -2678,6 +2718,9 @@ namespace Legion {
       }
       prepare_parallel_replay(gen);
       push_complete_replays();
+      // Save the generators in case we lower the template later
+      if (trace->runtime->subgraph_replay_threshold > 0)
+        event_generators.swap(gen);
     }
 
     //--------------------------------------------------------------------------
@@ -3776,6 +3819,297 @@ namespace Legion {
       }
     }
 
+    //--------------------------------------------------------------------------
+    void PhysicalTemplate::lower_to_subgraph(void)
+    //--------------------------------------------------------------------------
+    {
+      lowering_attempted = true;
+#ifdef LEGION_SPY
+      // Legion Spy needs to see all the copies and fills that we issue
+      return;
+#endif
+      // Same thing for the profiler
+      if (trace->runtime->profiler != NULL)
+        return;
+#ifdef DEBUG_LEGION
+      assert(!event_generators.empty());
+#endif
+      typedef std::pair<Realm::SubgraphDefinition::OpKind,unsigned> 
+        SubgraphSource;
+      // Map the crossing events back to the events that they forward
+      std::map<unsigned,unsigned> crossing_sources;
+      for (std::map<unsigned,unsigned>::const_iterator it = 
+            crossing_events.begin(); it != crossing_events.end(); it++)
+        crossing_sources[it->second] = it->first;
+      Realm::SubgraphDefinition defn;
+      // Replays of a template can overlap so be conservative
+      defn.concurrency_mode = Realm::SubgraphDefinition::CONCURRENT;
+      // The subgraph operations that each lowered event depends on
+      std::map<unsigned,std::set<SubgraphSource> > lowered_sources;
+      // External preconditions of the subgraph indexed by event
+      std::map<unsigned,unsigned> precondition_ports;
+      std::set<Instruction*> lowered;
+      // Triggers for external preconditions that need to go after
+      // the instructions that generate them
+      std::map<Instruction*,std::vector<Instruction*> > new_triggers;
+      for (unsigned idx = 1; idx < instructions.size(); idx++)
+      {
+        Instruction *inst = instructions[idx];
+        std::vector<unsigned> inputs;
+        unsigned lhs = 0;
+        switch (inst->get_kind())
+        {
+          case ISSUE_COPY:
+            {
+              IssueCopy *copy = inst->as_issue_copy();
+              bool indirect = false;
+              for (unsigned fidx = 0; fidx < copy->src_fields.size(); fidx++)
+                if (copy->src_fields[fidx].indirect_index >= 0)
+                  indirect = true;
+              for (unsigned fidx = 0; fidx < copy->dst_fields.size(); fidx++)
+                if (copy->dst_fields[fidx].indirect_index >= 0)
+                  indirect = true;
+              if (indirect)
+                continue;
+              inputs.push_back(copy->precondition_idx);
+              lhs = copy->lhs;
+              break;
+            }
+          case ISSUE_FILL:
+            {
+              IssueFill *fill = inst->as_issue_fill();
+              bool indirect = false;
+              for (unsigned fidx = 0; fidx < fill->fields.size(); fidx++)
+                if (fill->fields[fidx].indirect_index >= 0)
+                  indirect = true;
+              if (indirect)
+                continue;
+              inputs.push_back(fill->precondition_idx);
+              lhs = fill->lhs;
+              break;
+            }
+          case MERGE_EVENT:
+            {
+              // Only lower merges of events produced in the subgraph
+              MergeEvent *merge = inst->as_merge_event();
+              bool internal = false;
+              for (std::set<unsigned>::const_iterator it = 
+                    merge->rhs.begin(); it != merge->rhs.end(); it++)
+              {
+                std::map<unsigned,unsigned>::const_iterator finder =
+                  crossing_sources.find(*it);
+                const unsigned source = (finder != crossing_sources.end()) ?
+                  finder->second : *it;
+                if (lowered_sources.find(source) != lowered_sources.end())
+                {
+                  internal = true;
+                  break;
+                }
+              }
+              if (!internal)
+                continue;
+              inputs.insert(inputs.end(), merge->rhs.begin(), merge->rhs.end());
+              lhs = merge->lhs;
+              break;
+            }
+          default:
+            continue;
+        }
+        // Figure out which subgraph operations or external preconditions
+        // each of the inputs come from
+        std::set<SubgraphSource> sources;
+        for (std::vector<unsigned>::const_iterator it = 
+              inputs.begin(); it != inputs.end(); it++)
+        {
+          std::map<unsigned,unsigned>::const_iterator crossing_finder =
+            crossing_sources.find(*it);
+          const unsigned source = (crossing_finder != crossing_sources.end()) ?
+            crossing_finder->second : *it;
+          std::map<unsigned,std::set<SubgraphSource> >::const_iterator
+            lowered_finder = lowered_sources.find(source);
+          if (lowered_finder != lowered_sources.end())
+          {
+            sources.insert(lowered_finder->second.begin(),
+                           lowered_finder->second.end());
+            continue;
+          }
+          std::map<unsigned,unsigned>::const_iterator port_finder =
+            precondition_ports.find(source);
+          if (port_finder != precondition_ports.end())
+          {
+            sources.insert(SubgraphSource(
+                  Realm::SubgraphDefinition::OPKIND_EXT_PRECOND,
+                  port_finder->second));
+            continue;
+          }
+          const unsigned port = subgraph_preconditions.size();
+          precondition_ports[source] = port;
+          sources.insert(SubgraphSource(
+                Realm::SubgraphDefinition::OPKIND_EXT_PRECOND, port));
+          const unsigned generator = (source < event_generators.size()) ?
+            event_generators[source] : 0;
+          if (generator == 0)
+          {
+            // Known before any of the slices run
+            subgraph_preconditions.push_back(source);
+            continue;
+          }
+          // Otherwise we need a user event that the slice generating the
+          // event will trigger, reuse the crossing event if there is one
+          std::map<unsigned,unsigned>::const_iterator finder =
+            crossing_events.find(source);
+          if (finder != crossing_events.end())
+          {
+            subgraph_preconditions.push_back(finder->second);
+            continue;
+          }
+          const unsigned crossing_event = events.size();
+          events.resize(events.size() + 1);
+          crossing_events[source] = crossing_event;
+          crossing_sources[crossing_event] = source;
+          subgraph_preconditions.push_back(crossing_event);
+          Instruction *generator_inst = instructions[generator];
+          new_triggers[generator_inst].push_back(new TriggerEvent(*this,
+                crossing_event, source, generator_inst->owner));
+        }
+        if (inst->get_kind() == MERGE_EVENT)
+        {
+          lowered_sources[lhs] = sources;
+          lowered.insert(inst);
+          continue;
+        }
+        const unsigned copy_index = defn.copies.size();
+        defn.copies.resize(copy_index + 1);
+        Realm::SubgraphDefinition::CopyDesc &desc = defn.copies.back();
+        if (inst->get_kind() == ISSUE_COPY)
+        {
+          IssueCopy *copy = inst->as_issue_copy();
+          SubgraphSpaceHelper helper(copy->expr, desc.space);
+          NT_TemplateHelper::demux<SubgraphSpaceHelper>(
+              copy->expr->type_tag, &helper);
+          desc.srcs.resize(copy->src_fields.size());
+          for (unsigned fidx = 0; fidx < copy->src_fields.size(); fidx++)
+            desc.srcs[fidx] = copy->src_fields[fidx];
+          desc.dsts.resize(copy->dst_fields.size());
+          for (unsigned fidx = 0; fidx < copy->dst_fields.size(); fidx++)
+          {
+            desc.dsts[fidx] = copy->dst_fields[fidx];
+            if (copy->redop != 0)
+              desc.dsts[fidx].set_redop(copy->redop, copy->reduction_fold);
+          }
+          desc.redop_id = copy->redop;
+          desc.red_fold = copy->reduction_fold;
+        }
+        else
+        {
+          IssueFill *fill = inst->as_issue_fill();
+          SubgraphSpaceHelper helper(fill->expr, desc.space);
+          NT_TemplateHelper::demux<SubgraphSpaceHelper>(
+              fill->expr->type_tag, &helper);
+          // The fill value is laid out in one of two ways: either it is
+          // the value of a single field and every field is filled with
+          // the same bytes (what fills from Legion always look like), or
+          // it is the values of all the fields packed back-to-back in
+          // field order with no padding between them
+          desc.srcs.resize(fill->fields.size());
+          desc.dsts.resize(fill->fields.size());
+          bool replicated = true;
+          for (unsigned fidx = 0; fidx < fill->fields.size(); fidx++)
+            if (fill->fields[fidx].size != fill->fill_size)
+              replicated = false;
+          size_t offset = 0;
+          for (unsigned fidx = 0; fidx < fill->fields.size(); fidx++)
+          {
+            const size_t field_size = fill->fields[fidx].size;
+#ifdef DEBUG_LEGION
+            assert(replicated || ((offset + field_size) <= fill->fill_size));
+#endif
+            desc.srcs[fidx].set_fill(
+                static_cast<const char*>(fill->fill_value) + offset,
+                field_size);
+            desc.dsts[fidx] = fill->fields[fidx];
+            if (!replicated)
+              offset += field_size;
+          }
+#ifdef DEBUG_LEGION
+          assert(replicated || (offset == fill->fill_size));
+#endif
+        }
+        for (std::set<SubgraphSource>::const_iterator it = 
+              sources.begin(); it != sources.end(); it++)
+        {
+          Realm::SubgraphDefinition::Dependency dep;
+          dep.src_op_kind = it->first;
+          dep.src_op_index = it->second;
+          dep.tgt_op_kind = Realm::SubgraphDefinition::OPKIND_COPY;
+          dep.tgt_op_index = copy_index;
+          defn.dependencies.push_back(dep);
+        }
+        lowered_sources[lhs].insert(SubgraphSource(
+              Realm::SubgraphDefinition::OPKIND_COPY, copy_index));
+        lowered.insert(inst);
+      }
+      if (defn.copies.empty())
+      {
+#ifdef DEBUG_LEGION
+        assert(new_triggers.empty());
+#endif
+        subgraph_preconditions.clear();
+        return;
+      }
+      // Every lowered event becomes a postcondition since anything in the
+      // slices, the frontiers, or the completion event might look at it
+      for (std::map<unsigned,std::set<SubgraphSource> >::const_iterator lit =
+            lowered_sources.begin(); lit != lowered_sources.end(); lit++)
+      {
+        const unsigned port = subgraph_postconditions.size();
+        subgraph_postconditions.push_back(lit->first);
+        for (std::set<SubgraphSource>::const_iterator it = 
+              lit->second.begin(); it != lit->second.end(); it++)
+        {
+          Realm::SubgraphDefinition::Dependency dep;
+          dep.src_op_kind = it->first;
+          dep.src_op_index = it->second;
+          dep.tgt_op_kind = Realm::SubgraphDefinition::OPKIND_EXT_POSTCOND;
+          dep.tgt_op_index = port;
+          defn.dependencies.push_back(dep);
+        }
+      }
+      const RtEvent ready(Realm::Subgraph::create_subgraph(subgraph, defn,
+                                              Realm::ProfilingRequestSet()));
+      if (ready.exists() && !ready.has_triggered())
+        ready.wait();
+      // Remove the lowered instructions from the slices and add the
+      // triggers for any external preconditions of the subgraph
+      for (unsigned sidx = 0; sidx < slices.size(); sidx++)
+      {
+        std::vector<Instruction*> new_instructions;
+        new_instructions.reserve(slices[sidx].size());
+        for (std::vector<Instruction*>::const_iterator it = 
+              slices[sidx].begin(); it != slices[sidx].end(); it++)
+        {
+          if (lowered.find(*it) != lowered.end())
+            continue;
+          new_instructions.push_back(*it);
+          std::map<Instruction*,std::vector<Instruction*> >::const_iterator
+            finder = new_triggers.find(*it);
+          if (finder != new_triggers.end())
+            new_instructions.insert(new_instructions.end(),
+                finder->second.begin(), finder->second.end());
+        }
+        slices[sidx].swap(new_instructions);
+      }
+      if (trace->runtime->dump_physical_traces)
+        log_tracing.info() << "Lowered " << lowered.size() 
+                           << " instructions of template " << this
+                           << " into subgraph " << std::hex << subgraph.id
+                           << std::dec << " with " 
+                           << subgraph_preconditions.size() 
+                           << " preconditions and "
+                           << subgraph_postconditions.size() 
+                           << " postconditions";
+    }
+
     //--------------------------------------------------------------------------
     void PhysicalTemplate::dump_template(void)
     //--------------------------------------------------------------------------
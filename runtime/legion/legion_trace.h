@@ -622,6 +622,29 @@ namespace Legion {
         std::deque<InstanceSet> physical_instances;
       };
       typedef LegionMap<TraceLocalID,CachedMapping>::aligned CachedMappings;
+    private:
+      // Helper for getting a type-erased Realm index space for the
+      // copies and fills that we put in a subgraph
+      struct SubgraphSpaceHelper {
+      public:
+        SubgraphSpaceHelper(IndexSpaceExpression *e, 
+                            Realm::IndexSpaceGeneric &s)
+          : expr(e), space(s) { }
+      public:
+        template<typename N, typename T>
+        static inline void demux(SubgraphSpaceHelper *helper)
+        {
+          Realm::IndexSpace<N::N,T> realm_space;
+          const ApEvent ready = helper->expr->get_expr_index_space(
+              &realm_space, helper->expr->type_tag, true/*tight*/);
+          if (ready.exists() && !ready.has_triggered())
+            ready.wait();
+          helper->space = realm_space;
+        }
+      public:
+        IndexSpaceExpression *const expr;
+        Realm::IndexSpaceGeneric &space;
+      };
     private:
       typedef LegionMap<InstanceView*,
                         FieldMaskSet<IndexSpaceExpression> >::aligned ViewExprs;
@@ -672,6 +695,7 @@ namespace Legion {
       void eliminate_dead_code(std::vector<unsigned> &gen);
       void prepare_parallel_replay(const std::vector<unsigned> &gen);
       void push_complete_replays(void);
+      void lower_to_subgraph(void);
     public:
       bool check_preconditions(TraceReplayOp *op,
                                std::set<RtEvent> &applied_events);
@@ -891,6 +915,20 @@ namespace Legion {
     private:
       RtUserEvent replay_ready;
       RtEvent     replay_done;
+    private:
+      // Once a template has been replayed enough times its copies, fills,
+      // and the merges between them are lowered into a Realm subgraph
+      // which is launched with a single instantiation for each replay
+      unsigned                replay_count;
+      bool                    lowering_attempted;
+      std::vector<unsigned>   event_generators;
+      Realm::Subgraph         subgraph;
+      // Events passed to the subgraph as preconditions and the events
+      // that are assigned from its postconditions for each replay
+      std::vector<unsigned>   subgraph_preconditions;
+      std::vector<unsigned>   subgraph_postconditions;
+      // Completion events of instantiations that might still be running
+      std::set<ApEvent>       subgraph_completions;
 #ifdef LEGION_SPY
       UniqueID prev_fence_uid;
 #endif
@@ -388,6 +388,9 @@ namespace Legion {
       LG_DEFER_COLLECTIVE_MANAGER_TASK_ID,
       LG_DEFER_VERIFY_PARTITION_TASK_ID,
       LG_DEFER_RELEASE_ACQUIRED_TASK_ID,
+      LG_DEFER_KD_TREE_REFINE_TASK_ID,
+      LG_DEFER_ALL_REDUCE_FOLD_TASK_ID,
+      LG_DEFER_AUTO_TRACE_FLUSH_TASK_ID,
       LG_MALLOC_INSTANCE_TASK_ID,
       LG_FREE_INSTANCE_TASK_ID,
       LG_YIELD_TASK_ID,
@@ -501,6 +504,9 @@ namespace Legion {
         "Defer Reduction Manager Registration",                   \
         "Defer Verify Partition",                                 \
         "Defer Release Acquired Instances",                       \
+        "Defer KD Tree Refinement",                               \
+        "Defer All Reduce Fold",                                  \
+        "Defer Auto Trace Flush",                                 \
         "Malloc Instance",                                        \
         "Free Instance",                                          \
         "Yield",                                                  \
@@ -761,6 +767,8 @@ namespace Legion {
       SEND_FUTURE_BROADCAST,
       SEND_FUTURE_MAP_REQUEST,
       SEND_FUTURE_MAP_RESPONSE,
+      SEND_ALL_REDUCE_REQUEST,
+      SEND_ALL_REDUCE_RESPONSE,
       SEND_MAPPER_MESSAGE,
       SEND_MAPPER_BROADCAST,
       SEND_TASK_IMPL_SEMANTIC_REQ,
@@ -944,6 +952,8 @@ namespace Legion {
         "Send Future Broadcast",                                      \
         "Send Future Map Future Request",                             \
         "Send Future Map Future Response",                            \
+        "Send All Reduce Request",                                    \
+        "Send All Reduce Response",                                   \
         "Send Mapper Message",                                        \
         "Send Mapper Broadcast",                                      \
         "Send Task Impl Semantic Req",                                \
@@ -1191,6 +1201,7 @@ namespace Legion {
       PHYSICAL_TRACE_EXECUTE_CALL,
       PHYSICAL_TRACE_PRECONDITION_CHECK_CALL,
       PHYSICAL_TRACE_OPTIMIZE_CALL,
+      KD_NODE_REFINE_CALL,
       LAST_RUNTIME_CALL_KIND, // This one must be last
     };
 
@@ -1340,6 +1351,7 @@ namespace Legion {
       "Physical Trace Execute",                                       \
       "Physical Trace Precondition Check",                            \
       "Physical Trace Optimize",                                      \
+      "KD Node Refine",                                               \
     };
 
     enum SemanticInfoKind {
@@ -1443,6 +1455,7 @@ namespace Legion {
     class DetachOp;
     class TimingOp;
     class AllReduceOp;
+    class AllReduceCollective;
     class ExternalMappable;
     class RemoteOp;
     class RemoteMapOp;
@@ -455,7 +455,8 @@ namespace Legion {
         producer_uid((o == NULL) ? 0 : o->get_unique_op_id()),
 #endif
         future_complete(complete), result(NULL), result_size(0), 
-        result_set_space(local_space), callback_functor(NULL),
+        result_set_space(local_space), remote_reductions(0),
+        pending_remote_removal(false), callback_functor(NULL),
         own_callback_functor(false), empty(true), sampled(false)
     //--------------------------------------------------------------------------
     {
@@ -486,18 +487,11 @@ namespace Legion {
     {
 #ifdef DEBUG_LEGION
       assert(!subscription_event.exists());
+      assert(remote_reductions == 0);
 #endif
       // Remove the extra reference on a remote set future if there is one
       if (empty && (result_set_space != local_space))
-      {
-        Serializer rez;
-        {
-          RezCheck z(rez);
-          rez.serialize(did);
-          rez.serialize<size_t>(0);
-        }
-        runtime->send_future_broadcast(result_set_space, rez);
-      }
+        send_remote_removal();
       if (result != NULL)
       {
         free(result);
@@ -828,6 +822,16 @@ namespace Legion {
       empty = false;
       ApEvent complete;
       derez.deserialize(complete);
+      // We might also be responsible for passing the result on
+      size_t num_forwards;
+      derez.deserialize(num_forwards);
+      if (num_forwards > 0)
+      {
+        std::vector<AddressSpaceID> forwards(num_forwards);
+        for (unsigned idx = 0; idx < num_forwards; idx++)
+          derez.deserialize(forwards[idx]);
+        forward_result(forwards, complete);
+      }
       Runtime::trigger_event(NULL, subscription_event, complete);
       subscription_event = ApUserEvent::NO_AP_USER_EVENT;
       if (is_owner())
@@ -836,17 +840,28 @@ namespace Legion {
         assert(result_set_space != local_space);
 #endif
         // Send a message to the result set space future to remove its
-        // reference now that we no longer need it
-        Serializer rez;
-        {
-          RezCheck z2(rez);
-          rez.serialize(did);
-          rez.serialize<size_t>(0);
-        }
-        runtime->send_future_broadcast(result_set_space, rez);
+        // reference now that we no longer need it, unless a future map
+        // reduction is still reading the value there
+        if (remote_reductions > 0)
+          pending_remote_removal = true;
+        else
+          send_remote_removal();
       }
     }
 
+    //--------------------------------------------------------------------------
+    void FutureImpl::send_remote_removal(void)
+    //--------------------------------------------------------------------------
+    {
+      Serializer rez;
+      {
+        RezCheck z(rez);
+        rez.serialize(did);
+        rez.serialize<size_t>(0);
+      }
+      runtime->send_future_broadcast(result_set_space, rez);
+    }
+
     //--------------------------------------------------------------------------
     bool FutureImpl::reset_future(void)
     //--------------------------------------------------------------------------
@@ -1020,11 +1035,37 @@ namespace Legion {
         }
         return;
       }
+      std::vector<AddressSpaceID> remote_targets;
+      remote_targets.reserve(targets.size());
       for (std::set<AddressSpaceID>::const_iterator it = 
             targets.begin(); it != targets.end(); it++)
-      {
-        if ((*it) == local_space)
-          continue;
+        if ((*it) != local_space)
+          remote_targets.push_back(*it);
+      if (!remote_targets.empty())
+        forward_result(remote_targets, complete);
+      targets.clear();
+    }
+
+    //--------------------------------------------------------------------------
+    void FutureImpl::forward_result(const std::vector<AddressSpaceID> &targets,
+                                    ApEvent complete)
+    //--------------------------------------------------------------------------
+    {
+#ifdef DEBUG_LEGION
+      assert(!empty);
+      assert(callback_functor == NULL);
+#endif
+      // Split the targets into at most radix slices and send the result
+      // to the first space in each slice, which forwards it on to the 
+      // rest of its slice, so large broadcasts fan out as a tree instead
+      // of serializing all the sends on this node
+      const size_t total = targets.size();
+      const size_t slices = 
+        std::min<size_t>(std::max(runtime->legion_collective_radix, 1), total);
+      for (unsigned idx = 0; idx < slices; idx++)
+      {
+        const size_t start = (idx * total) / slices;
+        const size_t stop = ((idx + 1) * total) / slices;
         Serializer rez;
         {
           rez.serialize(did);
@@ -1033,10 +1074,12 @@ namespace Legion {
           if (result_size > 0)
             rez.serialize(result,result_size);
           rez.serialize(complete);
+          rez.serialize<size_t>(stop - start - 1);
+          for (unsigned idx2 = start + 1; idx2 < stop; idx2++)
+            rez.serialize(targets[idx2]);
         }
-        runtime->send_future_result(*it, rez);
+        runtime->send_future_result(targets[start], rez);
       }
-      targets.clear();
     }
 
     //--------------------------------------------------------------------------
@@ -1099,11 +1142,41 @@ namespace Legion {
           if (result_size > 0)
             rez.serialize(result,result_size);
           rez.serialize(future_complete);
+          rez.serialize<size_t>(0); // no forwarding
         }
         runtime->send_future_result(subscriber, rez);
       }
     }
 
+    //--------------------------------------------------------------------------
+    AddressSpaceID FutureImpl::acquire_reduction_space(void)
+    //--------------------------------------------------------------------------
+    {
+      AutoLock f_lock(future_lock);
+      // Anything other than an owner that is still waiting for a value
+      // that it knows lives on exactly one remote node gets read here
+      if (!is_owner() || !empty || subscription_event.exists() ||
+          (result_set_space == local_space))
+        return local_space;
+      remote_reductions++;
+      return result_set_space;
+    }
+
+    //--------------------------------------------------------------------------
+    void FutureImpl::release_reduction_space(void)
+    //--------------------------------------------------------------------------
+    {
+      AutoLock f_lock(future_lock);
+#ifdef DEBUG_LEGION
+      assert(remote_reductions > 0);
+#endif
+      if ((--remote_reductions == 0) && pending_remote_removal)
+      {
+        pending_remote_removal = false;
+        send_remote_removal();
+      }
+    }
+
     //--------------------------------------------------------------------------
     void FutureImpl::notify_remote_set(AddressSpaceID remote_space)
     //--------------------------------------------------------------------------
@@ -4192,6 +4265,7 @@ namespace Legion {
             assert(finder != current_instances.end());
 #endif
             finder->second.erase(*it);
+            unindex_instance(*it);
             if (finder->second.empty())
               current_instances.erase(finder);
           }
@@ -4248,6 +4322,7 @@ namespace Legion {
       // that we were made valid to begin with
       InstanceInfo &info = insts[manager];
       info.instance_size = inst_size;
+      index_instance(manager);
     }
 
     //--------------------------------------------------------------------------
@@ -4262,6 +4337,7 @@ namespace Legion {
       assert(finder->second.find(manager) != finder->second.end());
 #endif     
       finder->second.erase(manager);
+      unindex_instance(manager);
       if (finder->second.empty())
         current_instances.erase(finder);
     }
@@ -4341,6 +4417,7 @@ namespace Legion {
 #endif
           // Now we can delete our entry because it has been deleted
           tree_finder->second.erase(finder);
+          unindex_instance(manager);
           if (tree_finder->second.empty())
             current_instances.erase(tree_finder);
           remove_reference = true;
@@ -5036,7 +5113,10 @@ namespace Legion {
         {
           for (std::vector<PhysicalManager*>::const_iterator it = 
                 to_remove.begin(); it != to_remove.end(); it++)
+          {
             finder->second.erase(*it);
+            unindex_instance(*it);
+          }
           if (finder->second.empty())
             current_instances.erase(finder);
         }
@@ -5912,10 +5992,16 @@ namespace Legion {
               TreeInstances::const_iterator finder = 
                 tree_finder->second.find(manager);
             if (finder == tree_finder->second.end())
+            {
               tree_finder->second[manager] = InstanceInfo();  
+              index_instance(manager);
+            }
             }
             else
+            {
               current_instances[manager->tree_id][manager] = InstanceInfo();
+              index_instance(manager);
+            }
             if (created && min_priority)
             {
               std::pair<MapperID,Processor> key(mapper_id,processor);
@@ -5956,10 +6042,16 @@ namespace Legion {
               TreeInstances::const_iterator finder = 
                 tree_finder->second.find(manager);
             if (finder == tree_finder->second.end())
+            {
               tree_finder->second[manager] = InstanceInfo();  
+              index_instance(manager);
+            }
             }
             else
+            {
               current_instances[manager->tree_id][manager] = InstanceInfo();
+              index_instance(manager);
+            }
             if (min_priority)
             {
               InstanceInfo &info = current_instances[manager->tree_id][manager];
@@ -6248,62 +6340,31 @@ namespace Legion {
       if (regions.empty())
         return false;
       std::deque<PhysicalManager*> candidates;
-      const RegionTreeID tree_id = regions[0].get_tree_id(); 
-      do 
-      {
-        // Hold the lock while iterating here
-        AutoLock m_lock(manager_lock, 1, false/*exclusive*/);
-        std::map<RegionTreeID,TreeInstances>::const_iterator finder = 
-          current_instances.find(tree_id);
-        if (finder == current_instances.end())
-          break;
-        for (TreeInstances::const_iterator it = 
-              finder->second.begin(); it != finder->second.end(); it++)
-        {
-          // Skip it if has already been collected
-          if (it->second.current_state == PENDING_COLLECTED_STATE)
-            continue;
-          it->first->add_base_resource_ref(MEMORY_MANAGER_REF);
-          candidates.push_back(it->first);
-        }
-      } while (false);
-      // If we have any candidates check their constraints
+      IndexSpaceExpression *space_expr = NULL;
+      if (!find_candidate_instances(regions, constraints.field_constraint,
+                            tight_region_bounds, candidates, space_expr))
+        return false;
+      // Check the constraints of the candidates that survived pruning
       bool found = false;
-      if (!candidates.empty())
+      for (std::deque<PhysicalManager*>::const_iterator it = 
+            candidates.begin(); it != candidates.end(); it++)
       {
-        std::set<IndexSpaceExpression*> region_exprs;
-        RegionTreeForest *forest = runtime->forest;
-        for (std::vector<LogicalRegion>::const_iterator it = 
-              regions.begin(); it != regions.end(); it++)
-        {
-          // If the region tree IDs don't match that is bad
-          if (tree_id != it->get_tree_id())
-            return false;
-          RegionNode *node = forest->get_node(*it);
-          region_exprs.insert(node->row_source);
-        }
-        IndexSpaceExpression *space_expr = (region_exprs.size() == 1) ?
-          *(region_exprs.begin()) : forest->union_index_spaces(region_exprs);
-        for (std::deque<PhysicalManager*>::const_iterator it = 
-              candidates.begin(); it != candidates.end(); it++)
+        if (!(*it)->meets_expression(space_expr, tight_region_bounds))
+          continue;
+        if ((*it)->entails(constraints, DomainPoint(), NULL))
         {
-          if (!(*it)->meets_expression(space_expr, tight_region_bounds))
+          // Check to see if we need to acquire
+          // If we fail to acquire then keep going
+          if (acquire && !(*it)->acquire_instance(
+                remote ? REMOTE_DID_REF : MAPPING_ACQUIRE_REF, NULL))
             continue;
-          if ((*it)->entails(constraints, DomainPoint(), NULL))
-          {
-            // Check to see if we need to acquire
-            // If we fail to acquire then keep going
-            if (acquire && !(*it)->acquire_instance(
-                    remote ? REMOTE_DID_REF : MAPPING_ACQUIRE_REF, NULL))
-              continue;
-            // If we make it here, we succeeded
-            result = MappingInstance(*it);
-            found = true;
-            break;
-          }
+          // If we make it here, we succeeded
+          result = MappingInstance(*it);
+          found = true;
+          break;
         }
-        release_candidate_references(candidates);
       }
+      release_candidate_references(candidates);
       return found;
     }
 
@@ -6317,62 +6378,31 @@ namespace Legion {
       if (regions.empty())
         return false;
       std::deque<PhysicalManager*> candidates;
-      const RegionTreeID tree_id = regions[0].get_tree_id();
-      do
-      {
-        // Hold the lock while iterating here
-        AutoLock m_lock(manager_lock, 1, false/*exclusive*/);
-        std::map<RegionTreeID,TreeInstances>::const_iterator finder = 
-          current_instances.find(tree_id);
-        if (finder == current_instances.end())
-          break;
-        for (TreeInstances::const_iterator it = 
-              finder->second.begin(); it != finder->second.end(); it++)
-        {
-          // Skip it if has already been collected
-          if (it->second.current_state == PENDING_COLLECTED_STATE)
-            continue;
-          it->first->add_base_resource_ref(MEMORY_MANAGER_REF);
-          candidates.push_back(it->first);
-        }
-      } while (false);
-      // If we have any candidates check their constraints
+      IndexSpaceExpression *space_expr = NULL;
+      if (!find_candidate_instances(regions, constraints->field_constraint,
+                            tight_region_bounds, candidates, space_expr))
+        return false;
+      // Check the constraints of the candidates that survived pruning
       bool found = false;
-      if (!candidates.empty())
+      for (std::deque<PhysicalManager*>::const_iterator it = 
+            candidates.begin(); it != candidates.end(); it++)
       {
-        std::set<IndexSpaceExpression*> region_exprs;
-        RegionTreeForest *forest = runtime->forest;
-        for (std::vector<LogicalRegion>::const_iterator it = 
-              regions.begin(); it != regions.end(); it++)
-        {
-          // If the region tree IDs don't match that is bad
-          if (tree_id != it->get_tree_id())
-            return false;
-          RegionNode *node = forest->get_node(*it);
-          region_exprs.insert(node->row_source);
-        }
-        IndexSpaceExpression *space_expr = (region_exprs.size() == 1) ?
-          *(region_exprs.begin()) : forest->union_index_spaces(region_exprs);
-        for (std::deque<PhysicalManager*>::const_iterator it = 
-              candidates.begin(); it != candidates.end(); it++)
+        if (!(*it)->meets_expression(space_expr, tight_region_bounds))
+          continue;
+        if ((*it)->entails(constraints, DomainPoint(), NULL))
         {
-          if (!(*it)->meets_expression(space_expr, tight_region_bounds))
+          // Check to see if we need to acquire
+          // If we fail to acquire then keep going
+          if (acquire && !(*it)->acquire_instance(
+                remote ? REMOTE_DID_REF : MAPPING_ACQUIRE_REF, NULL))
             continue;
-          if ((*it)->entails(constraints, DomainPoint(), NULL))
-          {
-            // Check to see if we need to acquire
-            // If we fail to acquire then keep going
-            if (acquire && !(*it)->acquire_instance(
-                    remote ? REMOTE_DID_REF : MAPPING_ACQUIRE_REF, NULL))
-              continue;
-            // If we make it here, we succeeded
-            result = MappingInstance(*it);
-            found = true;
-            break;
-          }
+          // If we make it here, we succeeded
+          result = MappingInstance(*it);
+          found = true;
+          break;
         }
-        release_candidate_references(candidates);
       }
+      release_candidate_references(candidates);
       return found;
     }
 
@@ -6387,59 +6417,28 @@ namespace Legion {
       if (regions.empty())
         return;
       std::deque<PhysicalManager*> candidates;
-      const RegionTreeID tree_id = regions[0].get_tree_id(); 
-      do 
-      {
-        // Hold the lock while iterating here
-        AutoLock m_lock(manager_lock, 1, false/*exclusive*/);
-        std::map<RegionTreeID,TreeInstances>::const_iterator finder = 
-          current_instances.find(tree_id);
-        if (finder == current_instances.end())
-          break;
-        for (TreeInstances::const_iterator it = 
-              finder->second.begin(); it != finder->second.end(); it++)
-        {
-          // Skip it if has already been collected
-          if (it->second.current_state == PENDING_COLLECTED_STATE)
-            continue;
-          it->first->add_base_resource_ref(MEMORY_MANAGER_REF);
-          candidates.push_back(it->first);
-        }
-      } while (false);
-      // If we have any candidates check their constraints
-      if (!candidates.empty())
+      IndexSpaceExpression *space_expr = NULL;
+      if (!find_candidate_instances(regions, constraints.field_constraint,
+                            tight_region_bounds, candidates, space_expr))
+        return;
+      // Check the constraints of the candidates that survived pruning
+      for (std::deque<PhysicalManager*>::const_iterator it = 
+            candidates.begin(); it != candidates.end(); it++)
       {
-        std::set<IndexSpaceExpression*> region_exprs;
-        RegionTreeForest *forest = runtime->forest;
-        for (std::vector<LogicalRegion>::const_iterator it = 
-              regions.begin(); it != regions.end(); it++)
-        {
-          // If the region tree IDs don't match that is bad
-          if (tree_id != it->get_tree_id())
-            return;
-          RegionNode *node = forest->get_node(*it);
-          region_exprs.insert(node->row_source);
-        }
-        IndexSpaceExpression *space_expr = (region_exprs.size() == 1) ?
-          *(region_exprs.begin()) : forest->union_index_spaces(region_exprs);
-        for (std::deque<PhysicalManager*>::const_iterator it = 
-              candidates.begin(); it != candidates.end(); it++)
+        if (!(*it)->meets_expression(space_expr, tight_region_bounds))
+          continue;
+        if ((*it)->entails(constraints, DomainPoint(), NULL))
         {
-          if (!(*it)->meets_expression(space_expr, tight_region_bounds))
+          // Check to see if we need to acquire
+          // If we fail to acquire then keep going
+          if (acquire && !(*it)->acquire_instance(
+                remote ? REMOTE_DID_REF : MAPPING_ACQUIRE_REF, NULL))
             continue;
-          if ((*it)->entails(constraints, DomainPoint(), NULL))
-          {
-            // Check to see if we need to acquire
-            // If we fail to acquire then keep going
-            if (acquire && !(*it)->acquire_instance(
-                    remote ? REMOTE_DID_REF : MAPPING_ACQUIRE_REF, NULL))
-              continue;
-            // If we make it here, we succeeded
-            results.push_back(MappingInstance(*it));
-          }
+          // If we make it here, we succeeded
+          results.push_back(MappingInstance(*it));
         }
-        release_candidate_references(candidates);
       }
+      release_candidate_references(candidates);
     }
 
     //--------------------------------------------------------------------------
@@ -6453,59 +6452,28 @@ namespace Legion {
       if (regions.empty())
         return;
       std::deque<PhysicalManager*> candidates;
-      const RegionTreeID tree_id = regions[0].get_tree_id();
-      do
+      IndexSpaceExpression *space_expr = NULL;
+      if (!find_candidate_instances(regions, constraints->field_constraint,
+                            tight_region_bounds, candidates, space_expr))
+        return;
+      // Check the constraints of the candidates that survived pruning
+      for (std::deque<PhysicalManager*>::const_iterator it = 
+            candidates.begin(); it != candidates.end(); it++)
       {
-        // Hold the lock while iterating here
-        AutoLock m_lock(manager_lock, 1, false/*exclusive*/);
-        std::map<RegionTreeID,TreeInstances>::const_iterator finder = 
-          current_instances.find(tree_id);
-        if (finder == current_instances.end())
-          break;
-        for (TreeInstances::const_iterator it = 
-              finder->second.begin(); it != finder->second.end(); it++)
+        if (!(*it)->meets_expression(space_expr, tight_region_bounds))
+          continue;
+        if ((*it)->entails(constraints, DomainPoint(), NULL))
         {
-          // Skip it if has already been collected
-          if (it->second.current_state == PENDING_COLLECTED_STATE)
+          // Check to see if we need to acquire
+          // If we fail to acquire then keep going
+          if (acquire && !(*it)->acquire_instance(
+                remote ? REMOTE_DID_REF : MAPPING_ACQUIRE_REF, NULL))
             continue;
-          it->first->add_base_resource_ref(MEMORY_MANAGER_REF);
-          candidates.push_back(it->first);
-        }
-      } while (false);
-      // If we have any candidates check their constraints
-      if (!candidates.empty())
-      {
-        std::set<IndexSpaceExpression*> region_exprs;
-        RegionTreeForest *forest = runtime->forest;
-        for (std::vector<LogicalRegion>::const_iterator it = 
-              regions.begin(); it != regions.end(); it++)
-        {
-          // If the region tree IDs don't match that is bad
-          if (tree_id != it->get_tree_id())
-            return;
-          RegionNode *node = forest->get_node(*it);
-          region_exprs.insert(node->row_source);
+          // If we make it here, we succeeded
+          results.push_back(MappingInstance(*it));
         }
-        IndexSpaceExpression *space_expr = (region_exprs.size() == 1) ?
-          *(region_exprs.begin()) : forest->union_index_spaces(region_exprs);
-        for (std::deque<PhysicalManager*>::const_iterator it = 
-              candidates.begin(); it != candidates.end(); it++)
-        {
-          if (!(*it)->meets_expression(space_expr, tight_region_bounds))
-            continue;
-          if ((*it)->entails(constraints, DomainPoint(), NULL))
-          {
-            // Check to see if we need to acquire
-            // If we fail to acquire then keep going
-            if (acquire && !(*it)->acquire_instance(
-                    remote ? REMOTE_DID_REF : MAPPING_ACQUIRE_REF, NULL))
-              continue;
-            // If we make it here, we succeeded
-            results.push_back(MappingInstance(*it));
-          }
-        }
-        release_candidate_references(candidates);
       }
+      release_candidate_references(candidates);
     }
 
     //--------------------------------------------------------------------------
@@ -6662,6 +6630,292 @@ namespace Legion {
       }
     }
 
+    //--------------------------------------------------------------------------
+    bool MemoryManager::find_candidate_instances(
+                                      const std::vector<LogicalRegion> &regions,
+                                      const FieldConstraint &field_constraint,
+                                      bool tight_region_bounds,
+                                      std::deque<PhysicalManager*> &candidates,
+                                      IndexSpaceExpression *&space_expr)
+    //--------------------------------------------------------------------------
+    {
+      const RegionTreeID tree_id = regions[0].get_tree_id();
+      {
+        // Quick check to see if there is anything to look at
+        AutoLock m_lock(manager_lock, 1, false/*exclusive*/);
+        if (current_instances.find(tree_id) == current_instances.end())
+          return false;
+      }
+      std::set<IndexSpaceExpression*> region_exprs;
+      RegionTreeForest *forest = runtime->forest;
+      for (std::vector<LogicalRegion>::const_iterator it = 
+            regions.begin(); it != regions.end(); it++)
+      {
+        // If the region tree IDs don't match that is bad
+        if (tree_id != it->get_tree_id())
+          return false;
+        RegionNode *node = forest->get_node(*it);
+        region_exprs.insert(node->row_source);
+      }
+      space_expr = (region_exprs.size() == 1) ?
+        *(region_exprs.begin()) : forest->union_index_spaces(region_exprs);
+      // Compute the keys for the query, an instance can only cover the
+      // expression if it has at least as many points (exactly as many if
+      // the bounds are tight), its bounding box contains the bounding box
+      // of the expression, and it has all the fields that we need
+      const size_t volume = space_expr->get_volume();
+      Domain bounds;
+      bool has_bounds = false;
+      if (volume > 0)
+      {
+        // If the tight bounds aren't ready yet we skip the bounding box
+        // tests rather than waiting, they are only used for pruning
+        ApEvent ready;
+        bounds = space_expr->get_domain(ready, true/*tight*/);
+        has_bounds = (!ready.exists() || ready.has_triggered()) &&
+                      (bounds.get_dim() > 0);
+      }
+      const uint64_t signature = 
+        compute_field_signature(field_constraint.field_set);
+      std::vector<PhysicalManager*> to_index;
+      {
+        // Hold the lock while iterating here
+        AutoLock m_lock(manager_lock, 1, false/*exclusive*/);
+        std::map<RegionTreeID,TreeInstances>::const_iterator tree_finder = 
+          current_instances.find(tree_id);
+        if (tree_finder == current_instances.end())
+          return false;
+        std::map<RegionTreeID,InstanceIndex>::const_iterator index_finder =
+          instance_indexes.find(tree_id);
+        if (index_finder != instance_indexes.end())
+        {
+          const InstanceIndex &index = index_finder->second;
+          std::vector<const InstanceKeys*> matches;
+          if (volume == 0)
+          {
+            // Every instance covers the empty expression
+            for (std::multimap<size_t,InstanceKeys>::const_iterator it =
+                  index.by_volume.begin(); it != index.by_volume.end(); it++)
+              matches.push_back(&it->second);
+          }
+          else if (tight_region_bounds)
+          {
+            std::pair<std::multimap<size_t,InstanceKeys>::const_iterator,
+                      std::multimap<size_t,InstanceKeys>::const_iterator>
+                        range = index.by_volume.equal_range(volume);
+            for (std::multimap<size_t,InstanceKeys>::const_iterator it =
+                  range.first; it != range.second; it++)
+              matches.push_back(&it->second);
+          }
+          else
+          {
+            // A covering instance has at least as many points and its
+            // bounding box starts at or before ours in the first dimension,
+            // so walk both of those ranges together and only filter the
+            // one that turns out to be shorter
+            std::multimap<size_t,InstanceKeys>::const_iterator
+              vol_first = index.by_volume.lower_bound(volume),
+              vol_last = index.by_volume.end(), vol_it = vol_first;
+            typedef std::multimap<coord_t,
+                      std::multimap<size_t,InstanceKeys>::iterator> LoIndex;
+            LoIndex::const_iterator lo_first = index.by_lo.begin(),
+              lo_last = has_bounds ?
+                index.by_lo.upper_bound(bounds.lo()[0]) : index.by_lo.end(),
+              lo_it = lo_first;
+            while (has_bounds && (vol_it != vol_last) && (lo_it != lo_last))
+            {
+              vol_it++;
+              lo_it++;
+            }
+            if (has_bounds && (lo_it == lo_last))
+            {
+              for (LoIndex::const_iterator it = lo_first; it != lo_last; it++)
+                if (it->second->first >= volume)
+                  matches.push_back(&it->second->second);
+            }
+            else
+            {
+              for (std::multimap<size_t,InstanceKeys>::const_iterator it =
+                    vol_first; it != vol_last; it++)
+                matches.push_back(&it->second);
+            }
+          }
+          for (std::vector<const InstanceKeys*>::const_iterator it = 
+                matches.begin(); it != matches.end(); it++)
+          {
+            const InstanceKeys &keys = **it;
+            if ((signature & ~keys.field_signature) != 0)
+              continue;
+            if (has_bounds && !keys.contains(bounds))
+              continue;
+            TreeInstances::const_iterator finder = 
+              tree_finder->second.find(keys.manager);
+#ifdef DEBUG_LEGION
+            assert(finder != tree_finder->second.end());
+#endif
+            // Skip it if has already been collected
+            if (finder->second.current_state == PENDING_COLLECTED_STATE)
+              continue;
+            keys.manager->add_base_resource_ref(MEMORY_MANAGER_REF);
+            candidates.push_back(keys.manager);
+          }
+          // Anything we haven't computed keys for yet is a candidate
+          for (std::set<PhysicalManager*>::const_iterator it = 
+                index.unindexed.begin(); it != index.unindexed.end(); it++)
+          {
+            TreeInstances::const_iterator finder = 
+              tree_finder->second.find(*it);
+#ifdef DEBUG_LEGION
+            assert(finder != tree_finder->second.end());
+#endif
+            if (finder->second.current_state == PENDING_COLLECTED_STATE)
+              continue;
+            (*it)->add_base_resource_ref(MEMORY_MANAGER_REF);
+            candidates.push_back(*it);
+            to_index.push_back(*it);
+          }
+        }
+        else
+        {
+          // No index so fall back to testing all the instances
+          for (TreeInstances::const_iterator it = 
+                tree_finder->second.begin(); it != 
+                tree_finder->second.end(); it++)
+          {
+            // Skip it if has already been collected
+            if (it->second.current_state == PENDING_COLLECTED_STATE)
+              continue;
+            it->first->add_base_resource_ref(MEMORY_MANAGER_REF);
+            candidates.push_back(it->first);
+          }
+        }
+      }
+      if (!to_index.empty())
+      {
+        // Compute the keys for the new instances without holding the lock,
+        // we're holding references to all of them from above
+        std::vector<std::pair<size_t,InstanceKeys> > new_keys;
+        new_keys.reserve(to_index.size());
+        for (unsigned idx = 0; idx < to_index.size(); idx++)
+        {
+          // Instances whose index spaces aren't ready yet stay unindexed
+          // and we'll try them again on a later query
+          std::pair<size_t,InstanceKeys> next;
+          if (compute_instance_keys(to_index[idx], next.first, next.second))
+            new_keys.push_back(next);
+        }
+        AutoLock m_lock(manager_lock);
+        std::map<RegionTreeID,InstanceIndex>::iterator index_finder =
+          instance_indexes.find(tree_id);
+        if (index_finder != instance_indexes.end())
+        {
+          InstanceIndex &index = index_finder->second;
+          for (unsigned idx = 0; idx < new_keys.size(); idx++)
+          {
+            // Someone else might have indexed or removed it already
+            if (index.unindexed.erase(new_keys[idx].second.manager) == 0)
+              continue;
+            std::multimap<size_t,InstanceKeys>::iterator inserted =
+              index.by_volume.insert(new_keys[idx]);
+            index.indexed[new_keys[idx].second.manager] = inserted;
+            if (inserted->second.lo.get_dim() > 0)
+              index.by_lo.insert(std::make_pair(inserted->second.lo[0],
+                                                inserted));
+          }
+        }
+      }
+      return !candidates.empty();
+    }
+
+    //--------------------------------------------------------------------------
+    void MemoryManager::index_instance(PhysicalManager *manager)
+    //--------------------------------------------------------------------------
+    {
+      // Should be holding the manager lock in exclusive mode
+      // Keys are computed lazily the first time the instance is a candidate
+      instance_indexes[manager->tree_id].unindexed.insert(manager);
+    }
+
+    //--------------------------------------------------------------------------
+    void MemoryManager::unindex_instance(PhysicalManager *manager)
+    //--------------------------------------------------------------------------
+    {
+      // Should be holding the manager lock in exclusive mode
+      std::map<RegionTreeID,InstanceIndex>::iterator index_finder =
+        instance_indexes.find(manager->tree_id);
+      if (index_finder == instance_indexes.end())
+        return;
+      InstanceIndex &index = index_finder->second;
+      std::map<PhysicalManager*,
+               std::multimap<size_t,InstanceKeys>::iterator>::iterator finder =
+        index.indexed.find(manager);
+      if (finder != index.indexed.end())
+      {
+        const DomainPoint &lo = finder->second->second.lo;
+        if (lo.get_dim() > 0)
+        {
+          std::pair<std::multimap<coord_t,
+                      std::multimap<size_t,InstanceKeys>::iterator>::iterator,
+                    std::multimap<coord_t,
+                      std::multimap<size_t,InstanceKeys>::iterator>::iterator>
+                        range = index.by_lo.equal_range(lo[0]);
+          for (std::multimap<coord_t,
+                std::multimap<size_t,InstanceKeys>::iterator>::iterator it =
+                range.first; it != range.second; it++)
+          {
+            if (it->second != finder->second)
+              continue;
+            index.by_lo.erase(it);
+            break;
+          }
+        }
+        index.by_volume.erase(finder->second);
+        index.indexed.erase(finder);
+      }
+      else
+        index.unindexed.erase(manager);
+      if (index.indexed.empty() && index.unindexed.empty())
+        instance_indexes.erase(index_finder);
+    }
+
+    //--------------------------------------------------------------------------
+    bool MemoryManager::compute_instance_keys(PhysicalManager *manager,
+                                   size_t &volume, InstanceKeys &keys) const
+    //--------------------------------------------------------------------------
+    {
+      keys.manager = manager;
+      volume = manager->instance_domain->get_volume();
+      if (volume > 0)
+      {
+        ApEvent ready;
+        const Domain bounds = 
+          manager->instance_domain->get_domain(ready, true/*tight*/);
+        if (ready.exists() && !ready.has_triggered())
+          return false;
+        keys.lo = bounds.lo();
+        keys.hi = bounds.hi();
+      }
+      if (manager->layout != NULL)
+        keys.field_signature = compute_field_signature(
+            manager->layout->constraints->field_constraint.field_set);
+      else
+        keys.field_signature = ~uint64_t(0);
+      return true;
+    }
+
+    //--------------------------------------------------------------------------
+    /*static*/ uint64_t MemoryManager::compute_field_signature(
+                                             const std::vector<FieldID> &fields)
+    //--------------------------------------------------------------------------
+    {
+      uint64_t signature = 0;
+      for (std::vector<FieldID>::const_iterator it = 
+            fields.begin(); it != fields.end(); it++)
+        signature |= (uint64_t(1) << 
+            ((uint64_t(*it) * 0x9E3779B97F4A7C15ULL) >> 58));
+      return signature;
+    }
+
     //--------------------------------------------------------------------------
     PhysicalManager* MemoryManager::create_shadow_instance(
                                                        InstanceBuilder &builder)
@@ -6806,6 +7060,7 @@ namespace Legion {
         assert(insts.find(manager) == insts.end());
 #endif
         InstanceInfo &info = insts[manager];
+        index_instance(manager);
         if (early_valid)
           info.current_state = VALID_STATE;
         info.min_priority = priority;
@@ -6863,6 +7118,7 @@ namespace Legion {
 #endif
         InstanceInfo &info = insts[manager];
         info.instance_size = instance_size;
+        index_instance(manager);
       }
       return RtEvent::NO_RT_EVENT;
     }
@@ -6915,6 +7171,7 @@ namespace Legion {
               assert(finder != current_instances.end());
 #endif
               finder->second.erase(it->first);
+              unindex_instance(it->first);
               if (finder->second.empty())
                 current_instances.erase(finder);
             }
@@ -7030,6 +7287,7 @@ namespace Legion {
         else // Reference will flow out
         {
           tree_finder->second.erase(finder);
+          unindex_instance(manager);
           if (tree_finder->second.empty())
             current_instances.erase(tree_finder);
         }
@@ -8384,6 +8642,16 @@ namespace Legion {
               runtime->handle_future_map_future_response(derez);
               break;
             }
+          case SEND_ALL_REDUCE_REQUEST:
+            {
+              runtime->handle_all_reduce_request(derez, remote_address_space);
+              break;
+            }
+          case SEND_ALL_REDUCE_RESPONSE:
+            {
+              runtime->handle_all_reduce_response(derez);
+              break;
+            }
           case SEND_MAPPER_MESSAGE:
             {
               runtime->handle_mapper_message(derez);
@@ -11281,10 +11549,15 @@ namespace Legion {
         gc_epoch_size(config.gc_epoch_size),
         max_local_fields(config.max_local_fields),
         max_replay_parallelism(config.max_replay_parallelism),
+        subgraph_replay_threshold(config.subgraph_replay_threshold),
+        auto_trace_min_length(config.auto_trace_min_length),
+        auto_trace_max_length(config.auto_trace_max_length),
+        parallel_refinement_threshold(config.parallel_refinement_threshold),
         program_order_execution(config.program_order_execution),
         dump_physical_traces(config.dump_physical_traces),
         no_tracing(config.no_tracing),
         no_physical_tracing(config.no_physical_tracing),
+        auto_trace(config.auto_trace),
         no_trace_optimization(config.no_trace_optimization),
         no_fence_elision(config.no_fence_elision),
         replay_on_cpus(config.replay_on_cpus),
@@ -11489,10 +11762,15 @@ namespace Legion {
         gc_epoch_size(rhs.gc_epoch_size), 
         max_local_fields(rhs.max_local_fields),
         max_replay_parallelism(rhs.max_replay_parallelism),
+        subgraph_replay_threshold(rhs.subgraph_replay_threshold),
+        auto_trace_min_length(rhs.auto_trace_min_length),
+        auto_trace_max_length(rhs.auto_trace_max_length),
+        parallel_refinement_threshold(rhs.parallel_refinement_threshold),
         program_order_execution(rhs.program_order_execution),
         dump_physical_traces(rhs.dump_physical_traces),
         no_tracing(rhs.no_tracing),
         no_physical_tracing(rhs.no_physical_tracing),
+        auto_trace(rhs.auto_trace),
         no_trace_optimization(rhs.no_trace_optimization),
         no_fence_elision(rhs.no_fence_elision),
         replay_on_cpus(rhs.replay_on_cpus),
@@ -12157,6 +12435,11 @@ namespace Legion {
                 LegionSpy::log_memory_kind(kind, "L1");
                 break;
               }
+	    case Memory::FILE_MAPPED_MEM:
+              {
+                LegionSpy::log_memory_kind(kind, "Mapped File");
+                break;
+              }
             default:
               assert(false); // unknown memory kind
           }
@@ -16929,6 +17212,24 @@ namespace Legion {
                   DEFAULT_VIRTUAL_CHANNEL, true/*flush*/, true/*response*/);
     }
 
+    //--------------------------------------------------------------------------
+    void Runtime::send_all_reduce_request(AddressSpaceID target, 
+                                          Serializer &rez)
+    //--------------------------------------------------------------------------
+    {
+      find_messenger(target)->send_message(rez, SEND_ALL_REDUCE_REQUEST,
+                                        DEFAULT_VIRTUAL_CHANNEL, true/*flush*/);
+    }
+
+    //--------------------------------------------------------------------------
+    void Runtime::send_all_reduce_response(AddressSpaceID target,
+                                           Serializer &rez)
+    //--------------------------------------------------------------------------
+    {
+      find_messenger(target)->send_message(rez, SEND_ALL_REDUCE_RESPONSE,
+                  DEFAULT_VIRTUAL_CHANNEL, true/*flush*/, true/*response*/);
+    }
+
     //--------------------------------------------------------------------------
     void Runtime::send_mapper_message(AddressSpaceID target, Serializer &rez)
     //--------------------------------------------------------------------------
@@ -18602,6 +18903,21 @@ namespace Legion {
       FutureMapImpl::handle_future_map_future_response(derez, this);
     }
 
+    //--------------------------------------------------------------------------
+    void Runtime::handle_all_reduce_request(Deserializer &derez,
+                                            AddressSpaceID source)
+    //--------------------------------------------------------------------------
+    {
+      AllReduceCollective::handle_request(derez, this, source);
+    }
+
+    //--------------------------------------------------------------------------
+    void Runtime::handle_all_reduce_response(Deserializer &derez)
+    //--------------------------------------------------------------------------
+    {
+      AllReduceCollective::handle_response(derez);
+    }
+
     //--------------------------------------------------------------------------
     void Runtime::handle_mapper_message(Deserializer &derez)
     //--------------------------------------------------------------------------
@@ -21868,6 +22184,8 @@ namespace Legion {
       size_t alloc_size = size * elems;
       finder->second.total_allocations += elems;
       finder->second.total_bytes += alloc_size;
+      if (finder->second.total_bytes > finder->second.peak_bytes)
+        finder->second.peak_bytes = finder->second.total_bytes;
       finder->second.diff_allocations += elems;
       finder->second.diff_bytes += alloc_size;
     }
@@ -21903,9 +22221,10 @@ namespace Legion {
         if (it->second.diff_allocations == 0)
           continue;
         log_allocation.info("%s on %d: "
-            "total=%d total_bytes=%ld diff=%d diff_bytes=%lld",
+            "total=%d total_bytes=%ld peak_bytes=%ld diff=%d diff_bytes=%lld",
             get_allocation_name(it->first), address_space,
             it->second.total_allocations, it->second.total_bytes,
+            it->second.peak_bytes,
             it->second.diff_allocations, (long long int)it->second.diff_bytes);
         it->second.diff_allocations = 0;
         it->second.diff_bytes = 0;
@@ -22729,6 +23048,13 @@ namespace Legion {
         .add_option_bool("-lg:no_tracing",config.no_tracing, !filter)
         .add_option_bool("-lg:no_physical_tracing",
                          config.no_physical_tracing, !filter)
+        .add_option_bool("-lg:auto_trace", config.auto_trace, !filter)
+        .add_option_int("-lg:auto_trace_min",
+                        config.auto_trace_min_length, !filter)
+        .add_option_int("-lg:auto_trace_max",
+                        config.auto_trace_max_length, !filter)
+        .add_option_int("-lg:parallel_refine",
+                        config.parallel_refinement_threshold, !filter)
         .add_option_bool("-lg:no_trace_optimization",
                          config.no_trace_optimization, !filter)
         .add_option_bool("-lg:no_fence_elision",
@@ -22751,6 +23077,8 @@ namespace Legion {
         .add_option_int("-lg:local", config.max_local_fields, !filter)
         .add_option_int("-lg:parallel_replay", 
                         config.max_replay_parallelism, !filter)
+        .add_option_int("-lg:subgraph_replay",
+                        config.subgraph_replay_threshold, !filter)
         .add_option_bool("-lg:no_dyn",config.disable_independence_tests,!filter)
         .add_option_bool("-lg:spy",config.legion_spy_enabled, !filter)
         .add_option_bool("-lg:test",config.enable_test_mapper, !filter)
@@ -24816,6 +25144,16 @@ namespace Legion {
             RemoteOp::handle_deferred_deletion(args);
             break;
           }
+        case LG_DEFER_ALL_REDUCE_FOLD_TASK_ID:
+          {
+            AllReduceCollective::handle_deferred_fold(args);
+            break;
+          }
+        case LG_DEFER_AUTO_TRACE_FLUSH_TASK_ID:
+          {
+            InnerContext::handle_auto_trace_flush(args);
+            break;
+          }
         case LG_DEFER_PERFORM_TRAVERSAL_TASK_ID:
           {
             PhysicalAnalysis::handle_deferred_traversal(args);
@@ -24856,6 +25194,11 @@ namespace Legion {
             Operation::handle_deferred_release(args);
             break;
           }
+        case LG_DEFER_KD_TREE_REFINE_TASK_ID:
+          {
+            KDTree::handle_deferred_refine(args);
+            break;
+          }
 #ifdef LEGION_MALLOC_INSTANCES
         // LG_MALLOC_INSTANCE_TASK_ID should always run app processor
         case LG_FREE_INSTANCE_TASK_ID:
@@ -241,6 +241,12 @@ namespace Legion {
       bool get_boolean_value(bool &valid);
       // Request that the value be made ready on this node
       ApEvent subscribe(bool need_local_data = true);
+      // For reducing future maps where the values live: on the owner
+      // node this returns the space that holds the only copy of the value 
+      // and keeps that copy alive until release_reduction_space is called,
+      // otherwise it returns the local space
+      AddressSpaceID acquire_reduction_space(void);
+      void release_reduction_space(void);
     public:
       virtual void notify_active(ReferenceMutator *mutator);
       virtual void notify_valid(ReferenceMutator *mutator);
@@ -254,6 +260,9 @@ namespace Legion {
       void mark_sampled(void);
       void broadcast_result(std::set<AddressSpaceID> &targets,
                             ApEvent complete, const bool need_lock);
+      void forward_result(const std::vector<AddressSpaceID> &targets,
+                          ApEvent complete); // must be holding lock
+      void send_remote_removal(void);
       void record_subscription(AddressSpaceID subscriber, bool need_lock);
       void notify_remote_set(AddressSpaceID remote_space);
     protected:
@@ -290,6 +299,9 @@ namespace Legion {
       void *result; 
       size_t result_size;
       AddressSpaceID result_set_space; // space on which the result was set
+      // Reductions still reading the value on the result set space
+      unsigned remote_reductions;
+      bool pending_remote_removal;
     private:
       ApUserEvent callback_ready;
       Processor callback_proc;
@@ -791,6 +803,45 @@ namespace Legion {
         GCPriority min_priority;
         std::map<std::pair<MapperID,Processor>,GCPriority> mapper_priorities;
       };
+      // Cheap summary of an instance that lets us prune candidates
+      // before doing the expensive expression and constraint tests
+      struct InstanceKeys {
+      public:
+        InstanceKeys(void) : manager(NULL), field_signature(0) { }
+      public:
+        inline bool contains(const Domain &bounds) const
+        {
+          // Only a necessary condition, so if we can't compare
+          // the bounds then we can't prune the instance
+          if (bounds.get_dim() != lo.get_dim())
+            return true;
+          for (int d = 0; d < lo.get_dim(); d++)
+            if ((bounds.lo()[d] < lo[d]) || (hi[d] < bounds.hi()[d]))
+              return false;
+          return true;
+        }
+      public:
+        PhysicalManager *manager;
+        // Bounding box of the instance's index space
+        DomainPoint lo, hi;
+        // Bloom filter of the field IDs in the instance
+        uint64_t field_signature;
+      };
+      struct InstanceIndex {
+      public:
+        // Instances ordered by the volume of their index space
+        std::multimap<size_t,InstanceKeys> by_volume;
+        // Non-empty instances ordered by the low coordinate of their
+        // bounding box in the first dimension
+        std::multimap<coord_t,
+                 std::multimap<size_t,InstanceKeys>::iterator> by_lo;
+        std::map<PhysicalManager*,
+                 std::multimap<size_t,InstanceKeys>::iterator> indexed;
+        // Instances whose keys we haven't computed yet (or whose index
+        // spaces weren't ready when we tried), these are always handed
+        // back as candidates
+        std::set<PhysicalManager*> unindexed;
+      };
 #ifdef LEGION_MALLOC_INSTANCES
     public:
       struct MallocInstanceArgs : public LgTaskArgs<MallocInstanceArgs> {
@@ -943,6 +994,17 @@ namespace Legion {
                                     bool tight_region_bounds, bool remote);
       void release_candidate_references(const std::deque<PhysicalManager*>
                                                         &candidates) const;
+      bool find_candidate_instances(const std::vector<LogicalRegion> &regions,
+                                    const FieldConstraint &field_constraint,
+                                    bool tight_region_bounds,
+                                    std::deque<PhysicalManager*> &candidates,
+                                    IndexSpaceExpression *&space_expr);
+      void index_instance(PhysicalManager *manager);
+      void unindex_instance(PhysicalManager *manager);
+      bool compute_instance_keys(PhysicalManager *manager, size_t &volume,
+                                 InstanceKeys &keys) const;
+      static uint64_t compute_field_signature(
+                                        const std::vector<FieldID> &fields);
     public:
       PhysicalManager* create_shadow_instance(InstanceBuilder &builder);
     protected:
@@ -996,6 +1058,9 @@ namespace Legion {
       typedef LegionMap<PhysicalManager*,InstanceInfo,
                         MEMORY_INSTANCES_ALLOC>::tracked TreeInstances;
       std::map<RegionTreeID,TreeInstances> current_instances;
+      // Index over the current instances of each tree used to prune
+      // the candidates for find_satisfying_instance(s)
+      std::map<RegionTreeID,InstanceIndex> instance_indexes;
       // Keep track of outstanding requuests for allocations which 
       // will be tried in the order that they arrive
       std::deque<RtUserEvent> pending_allocation_attempts;
@@ -1594,10 +1659,16 @@ namespace Legion {
             gc_epoch_size(LEGION_DEFAULT_GC_EPOCH_SIZE),
             max_local_fields(LEGION_DEFAULT_LOCAL_FIELDS),
             max_replay_parallelism(LEGION_DEFAULT_MAX_REPLAY_PARALLELISM),
+            subgraph_replay_threshold(0),
+            auto_trace_min_length(LEGION_DEFAULT_AUTO_TRACE_MIN_LENGTH),
+            auto_trace_max_length(LEGION_DEFAULT_AUTO_TRACE_MAX_LENGTH),
+            parallel_refinement_threshold(
+                LEGION_DEFAULT_PARALLEL_REFINEMENT_THRESHOLD),
             program_order_execution(false),
             dump_physical_traces(false),
             no_tracing(false),
             no_physical_tracing(false),
+            auto_trace(false),
             no_trace_optimization(false),
             no_fence_elision(false),
             replay_on_cpus(false),
@@ -1644,11 +1715,16 @@ namespace Legion {
         unsigned gc_epoch_size;
         unsigned max_local_fields;
         unsigned max_replay_parallelism;
+        unsigned subgraph_replay_threshold;
+        unsigned auto_trace_min_length;
+        unsigned auto_trace_max_length;
+        unsigned parallel_refinement_threshold;
       public:
         bool program_order_execution;
         bool dump_physical_traces;
         bool no_tracing;
         bool no_physical_tracing;
+        bool auto_trace;
         bool no_trace_optimization;
         bool no_fence_elision;
         bool replay_on_cpus;
@@ -1789,11 +1865,16 @@ namespace Legion {
       const unsigned gc_epoch_size;
       const unsigned max_local_fields;
       const unsigned max_replay_parallelism;
+      const unsigned subgraph_replay_threshold;
+      const unsigned auto_trace_min_length;
+      const unsigned auto_trace_max_length;
+      const unsigned parallel_refinement_threshold;
     public:
       const bool program_order_execution;
       const bool dump_physical_traces;
       const bool no_tracing;
       const bool no_physical_tracing;
+      const bool auto_trace;
       const bool no_trace_optimization;
       const bool no_fence_elision;
       const bool replay_on_cpus;
@@ -2354,6 +2435,8 @@ namespace Legion {
                                           Serializer &rez);
       void send_future_map_response_future(AddressSpaceID target,
                                            Serializer &rez);
+      void send_all_reduce_request(AddressSpaceID target, Serializer &rez);
+      void send_all_reduce_response(AddressSpaceID target, Serializer &rez);
       void send_mapper_message(AddressSpaceID target, Serializer &rez);
       void send_mapper_broadcast(AddressSpaceID target, Serializer &rez);
       void send_task_impl_semantic_request(AddressSpaceID target, 
@@ -2611,6 +2694,9 @@ namespace Legion {
       void handle_future_map_future_request(Deserializer &derez,
                                             AddressSpaceID source);
       void handle_future_map_future_response(Deserializer &derez);
+      void handle_all_reduce_request(Deserializer &derez,
+                                     AddressSpaceID source);
+      void handle_all_reduce_response(Deserializer &derez);
       void handle_mapper_message(Deserializer &derez);
       void handle_mapper_broadcast(Deserializer &derez);
       void handle_task_impl_semantic_request(Deserializer &derez,
@@ -3251,11 +3337,12 @@ namespace Legion {
       struct AllocationTracker {
       public:
         AllocationTracker(void)
-          : total_allocations(0), total_bytes(0),
+          : total_allocations(0), total_bytes(0), peak_bytes(0),
             diff_allocations(0), diff_bytes(0) { }
       public:
         unsigned total_allocations;
         size_t         total_bytes;
+        size_t          peak_bytes;
         int       diff_allocations;
         off_t           diff_bytes;
       };
@@ -1080,6 +1080,7 @@ namespace Legion {
           case Memory::LEVEL3_CACHE: return "LEVEL3_CACHE";
           case Memory::LEVEL2_CACHE: return "LEVEL2_CACHE";
           case Memory::LEVEL1_CACHE: return "LEVEL1_CACHE";
+          case Memory::FILE_MAPPED_MEM: return "FILE_MAPPED_MEM";
           default: assert(false); return "";
         }
       }
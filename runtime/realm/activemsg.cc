@@ -35,6 +35,10 @@ namespace Realm {
     // the maximum time we're willing to spend on inline message
     //  handlers
     long long max_inline_message_time = 5000 /* nanoseconds*/;
+
+    // batching of small messages is off by default
+    size_t am_batch_size = 0;
+    long long am_batch_latency = 20000 /* nanoseconds */;
   };
 
 
@@ -217,6 +221,467 @@ namespace Realm {
   /*extern*/ ActiveMessageHandlerTable activemsg_handler_table;
 
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // struct ActiveMessageBatch
+  //
+
+  /*static*/ void ActiveMessageBatch::handle_message(NodeID sender,
+						     const ActiveMessageBatch& msg,
+						     const void *data, size_t datalen)
+  {
+    assert(0);
+  }
+
+  ActiveMessageHandlerReg<ActiveMessageBatch> activemsg_batch_handler;
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class BatchedMessageImpl
+  //
+
+  // stages a message in the sender's inline storage until it is committed,
+  //  at which point it is copied into the target's current batch
+  class BatchedMessageImpl : public ActiveMessageImpl {
+  public:
+    BatchedMessageImpl(ActiveMessageBatcher *_batcher,
+		       NodeID _target,
+		       unsigned short _msgid,
+		       size_t _header_size,
+		       size_t _max_payload_size,
+		       void *_data_base);
+    virtual ~BatchedMessageImpl();
+
+    virtual void *add_local_completion(size_t size);
+    virtual void *add_remote_completion(size_t size);
+
+    virtual void commit(size_t act_payload_size);
+    virtual void cancel();
+
+  protected:
+    struct CompletionList {
+      size_t bytes;
+
+      static const size_t TOTAL_CAPACITY = 256;
+      typedef char Storage_unaligned[TOTAL_CAPACITY];
+      REALM_ALIGNED_TYPE_CONST(Storage_aligned, Storage_unaligned,
+			       CompletionCallbackBase::ALIGNMENT);
+      Storage_aligned storage;
+    };
+
+    static void *reserve_completion(CompletionList *& list, size_t size);
+    static void destroy_completions(CompletionList *& list);
+
+    ActiveMessageBatcher *batcher;
+    NodeID target;
+    unsigned short msgid;
+    size_t header_size;
+    CompletionList *local_comp, *remote_comp;
+  };
+
+  BatchedMessageImpl::BatchedMessageImpl(ActiveMessageBatcher *_batcher,
+					 NodeID _target,
+					 unsigned short _msgid,
+					 size_t _header_size,
+					 size_t _max_payload_size,
+					 void *_data_base)
+    : batcher(_batcher)
+    , target(_target)
+    , msgid(_msgid)
+    , header_size(_header_size)
+    , local_comp(0)
+    , remote_comp(0)
+  {
+    header_base = _data_base;
+    payload_base = ((_max_payload_size > 0) ?
+		      (static_cast<char *>(_data_base) +
+		       ActiveMessageBatch::padded(_header_size)) :
+		      0);
+    payload_size = _max_payload_size;
+  }
+
+  BatchedMessageImpl::~BatchedMessageImpl()
+  {}
+
+  /*static*/ void *BatchedMessageImpl::reserve_completion(CompletionList *& list,
+							  size_t size)
+  {
+    if(list == 0) {
+      list = new CompletionList;
+      list->bytes = 0;
+    }
+    size_t ofs = list->bytes;
+    list->bytes += size;
+    assert(list->bytes <= CompletionList::TOTAL_CAPACITY);
+    return (list->storage + ofs);
+  }
+
+  /*static*/ void BatchedMessageImpl::destroy_completions(CompletionList *& list)
+  {
+    if(list != 0) {
+      CompletionCallbackBase::destroy_all(list->storage, list->bytes);
+      delete list;
+      list = 0;
+    }
+  }
+
+  void *BatchedMessageImpl::add_local_completion(size_t size)
+  {
+    return reserve_completion(local_comp, size);
+  }
+
+  void *BatchedMessageImpl::add_remote_completion(size_t size)
+  {
+    return reserve_completion(remote_comp, size);
+  }
+
+  void BatchedMessageImpl::commit(size_t act_payload_size)
+  {
+    if(remote_comp == 0) {
+      batcher->append_message(target, msgid, header_base, header_size,
+			      payload_base, act_payload_size);
+      // the message has been copied, so local completion is immediate
+      if(local_comp != 0) {
+	CompletionCallbackBase::invoke_all(local_comp->storage,
+					   local_comp->bytes);
+	destroy_completions(local_comp);
+      }
+      return;
+    }
+
+    // remote completion needs the network's help, so this message has to
+    //  go on its own - send anything already batched for the target first
+    batcher->flush_for_unbatched(target);
+
+    uint64_t storage[128];
+    ActiveMessageImpl *impl = Network::create_active_message_impl(target,
+								  msgid,
+								  header_size,
+								  act_payload_size,
+								  0, 0, 0,
+								  storage,
+								  sizeof(storage));
+    memcpy(impl->header_base, header_base, header_size);
+    if(act_payload_size > 0)
+      memcpy(impl->payload_base, payload_base, act_payload_size);
+    if(local_comp != 0) {
+      void *ptr = impl->add_local_completion(local_comp->bytes);
+      CompletionCallbackBase::clone_all(ptr, local_comp->storage,
+					local_comp->bytes);
+      destroy_completions(local_comp);
+    }
+    void *ptr = impl->add_remote_completion(remote_comp->bytes);
+    CompletionCallbackBase::clone_all(ptr, remote_comp->storage,
+				      remote_comp->bytes);
+    destroy_completions(remote_comp);
+    impl->commit(act_payload_size);
+    impl->~ActiveMessageImpl();
+  }
+
+  void BatchedMessageImpl::cancel()
+  {
+    destroy_completions(local_comp);
+    destroy_completions(remote_comp);
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class ActiveMessageBatcher
+  //
+
+  /*extern*/ ActiveMessageBatcher *activemsg_batcher = 0;
+
+  ActiveMessageBatcher::TargetBatch::TargetBatch(void)
+    : sent(mutex)
+    , buffer(0)
+    , bytes(0)
+    , capacity(0)
+    , count(0)
+    , first_time(0)
+    , sending(false)
+    , batches_taken(0)
+    , batches_done(0)
+  {}
+
+  ActiveMessageBatcher::ActiveMessageBatcher(int _nodes,
+					     CoreReservationSet& crs)
+    : nodes(_nodes)
+    , batch_msgid(activemsg_handler_table.lookup_message_id<ActiveMessageBatch>())
+    , condvar(mutex)
+    , flusher_waiting(false)
+    , shutdown_requested(false)
+    , messages_batched(0)
+    , batches_sent(0)
+    , flushes(0)
+  {
+    batches = new TargetBatch[nodes];
+    for(int i = 0; i < nodes; i++)
+      batches[i].capacity = Config::am_batch_size;
+
+    // the flush thread spends nearly all of its time asleep
+    CoreReservationParameters params;
+    params.set_alu_usage(CoreReservationParameters::CORE_USAGE_MINIMAL);
+    params.set_fpu_usage(CoreReservationParameters::CORE_USAGE_NONE);
+    params.set_ldst_usage(CoreReservationParameters::CORE_USAGE_MINIMAL);
+    core_rsrv = new CoreReservation("activemsg batching", crs, params);
+    ThreadLaunchParameters tparams;
+    flush_thread = Thread::create_kernel_thread<ActiveMessageBatcher,
+						&ActiveMessageBatcher::flush_thread_loop>(this,
+											  tparams,
+											  *core_rsrv);
+  }
+
+  ActiveMessageBatcher::~ActiveMessageBatcher(void)
+  {
+    assert(flush_thread == 0);
+    log_amhandler.info() << "batched " << messages_batched.load()
+			 << " messages into " << batches_sent.load()
+			 << " network messages (" << flushes.load()
+			 << " flushes)";
+    for(int i = 0; i < nodes; i++) {
+      assert((batches[i].count == 0) && batches[i].ready.empty());
+      free(batches[i].buffer);
+    }
+    delete[] batches;
+    delete core_rsrv;
+  }
+
+  void ActiveMessageBatcher::shutdown(void)
+  {
+    {
+      AutoLock<> al(mutex);
+      shutdown_requested = true;
+      condvar.signal();
+    }
+    flush_thread->join();
+    delete flush_thread;
+    flush_thread = 0;
+  }
+
+  ActiveMessageImpl *ActiveMessageBatcher::create_active_message_impl(NodeID target,
+								      unsigned short msgid,
+								      size_t header_size,
+								      size_t max_payload_size,
+								      void *storage_base,
+								      size_t storage_size)
+  {
+    // messages to ourselves and the batches themselves go direct
+    if((target == Network::my_node_id) || (msgid == batch_msgid))
+      return 0;
+
+    // the header and payload have to fit in the caller's inline storage
+    //  behind the impl, and the whole entry has to fit in a batch
+    size_t impl_bytes = ((sizeof(BatchedMessageImpl) + 15) & ~size_t(15));
+    size_t data_bytes = (ActiveMessageBatch::padded(header_size) +
+			 ActiveMessageBatch::padded(max_payload_size));
+    if(((impl_bytes + data_bytes) > storage_size) ||
+       ((ActiveMessageBatch::padded(sizeof(ActiveMessageBatch::Entry)) +
+	 data_bytes) > Config::am_batch_size))
+      return 0;
+
+    return new(storage_base) BatchedMessageImpl(this, target, msgid,
+						header_size, max_payload_size,
+						(static_cast<char *>(storage_base) +
+						 impl_bytes));
+  }
+
+  void ActiveMessageBatcher::append_message(NodeID target,
+					    unsigned short msgid,
+					    const void *header,
+					    size_t header_size,
+					    const void *payload,
+					    size_t payload_size)
+  {
+    size_t entry_bytes = (ActiveMessageBatch::padded(sizeof(ActiveMessageBatch::Entry)) +
+			  ActiveMessageBatch::padded(header_size) +
+			  ActiveMessageBatch::padded(payload_size));
+    TargetBatch& b = batches[target];
+
+    bool newly_pending = false;
+    b.mutex.lock();
+
+    // if this message won't fit, the current batch goes out first - other
+    //  threads may refill it while we're sending, so check again after
+    while((b.bytes + entry_bytes) > b.capacity) {
+      send_current_batch(target, b, false /*!wait*/);
+      b.mutex.lock();
+    }
+    if(b.buffer == 0)
+      b.buffer = static_cast<char *>(malloc(b.capacity));
+
+    char *pos = b.buffer + b.bytes;
+    ActiveMessageBatch::Entry *entry = reinterpret_cast<ActiveMessageBatch::Entry *>(pos);
+    entry->msgid = msgid;
+    entry->header_size = header_size;
+    entry->payload_size = payload_size;
+    pos += ActiveMessageBatch::padded(sizeof(ActiveMessageBatch::Entry));
+    memcpy(pos, header, header_size);
+    pos += ActiveMessageBatch::padded(header_size);
+    if(payload_size > 0)
+      memcpy(pos, payload, payload_size);
+    b.bytes += entry_bytes;
+
+    if(b.count++ == 0) {
+      b.first_time = Clock::current_time_in_nanoseconds();
+      newly_pending = true;
+    }
+    b.mutex.unlock();
+    messages_batched.fetch_add(1);
+
+    // a batch that just became non-empty needs a deadline on the flush thread
+    if(newly_pending) {
+      AutoLock<> al(mutex);
+      pending.push_back(target);
+      if(flusher_waiting) {
+	flusher_waiting = false;
+	condvar.signal();
+      }
+    }
+  }
+
+  void ActiveMessageBatcher::flush(NodeID target)
+  {
+    TargetBatch& b = batches[target];
+    b.mutex.lock();
+    if(b.count == 0) {
+      // an earlier batch may still be on its way to the network
+      while(b.batches_done < b.batches_taken)
+	b.sent.wait();
+      b.mutex.unlock();
+      return;
+    }
+    send_current_batch(target, b, true /*wait*/);
+  }
+
+  void ActiveMessageBatcher::flush_all(void)
+  {
+    for(NodeID i = 0; i < nodes; i++)
+      flush(i);
+  }
+
+  void ActiveMessageBatcher::flush_for_unbatched(NodeID target)
+  {
+    flushes.fetch_add(1);
+    if(target == FLUSH_ALL)
+      flush_all();
+    else
+      flush(target);
+  }
+
+  void ActiveMessageBatcher::send_current_batch(NodeID target,
+						TargetBatch& b, bool wait)
+  {
+    ReadyBatch rb;
+    rb.buffer = b.buffer;
+    rb.bytes = b.bytes;
+    rb.count = b.count;
+    b.buffer = 0;
+    b.bytes = 0;
+    b.count = 0;
+    b.ready.push_back(rb);
+    size_t seq = ++b.batches_taken;
+
+    if(b.sending) {
+      // whoever is sending will get to this one too
+      if(wait)
+	while(b.batches_done < seq)
+	  b.sent.wait();
+      b.mutex.unlock();
+      return;
+    }
+
+    b.sending = true;
+    while(!b.ready.empty()) {
+      ReadyBatch next = b.ready.front();
+      b.ready.pop_front();
+      b.mutex.unlock();
+
+      send_batch(target, next);
+
+      b.mutex.lock();
+      b.batches_done++;
+      b.sent.broadcast();
+      // hand the buffer back for reuse if the target doesn't have one yet
+      if(b.buffer == 0)
+	b.buffer = next.buffer;
+      else
+	free(next.buffer);
+    }
+    b.sending = false;
+    b.mutex.unlock();
+  }
+
+  void ActiveMessageBatcher::send_batch(NodeID target, const ReadyBatch& rb)
+  {
+    // batches go straight to the network - they're never batched themselves
+    uint64_t storage[128];
+    ActiveMessageImpl *impl = Network::create_active_message_impl(target,
+								  batch_msgid,
+								  sizeof(ActiveMessageBatch),
+								  rb.bytes,
+								  0, 0, 0,
+								  storage,
+								  sizeof(storage));
+    ActiveMessageBatch *hdr = new(impl->header_base) ActiveMessageBatch;
+    hdr->count = rb.count;
+    memcpy(impl->payload_base, rb.buffer, rb.bytes);
+    impl->commit(rb.bytes);
+    impl->~ActiveMessageImpl();
+    batches_sent.fetch_add(1);
+  }
+
+  void ActiveMessageBatcher::flush_thread_loop(void)
+  {
+    // targets whose batches aren't old enough to send yet
+    std::vector<NodeID> todo;
+    long long wait_nsec = -1;  // -1 means until woken up
+    while(true) {
+      {
+	AutoLock<> al(mutex);
+	// only sleep if no batch became non-empty while we were working
+	if(pending.empty() && !shutdown_requested) {
+	  flusher_waiting = true;
+	  if(wait_nsec < 0)
+	    condvar.wait();
+	  else
+	    condvar.timedwait(wait_nsec);
+	  flusher_waiting = false;
+	}
+	if(shutdown_requested)
+	  break;
+	todo.insert(todo.end(), pending.begin(), pending.end());
+	pending.clear();
+      }
+
+      long long now = Clock::current_time_in_nanoseconds();
+      wait_nsec = -1;
+      size_t kept = 0;
+      for(size_t i = 0; i < todo.size(); i++) {
+	TargetBatch& b = batches[todo[i]];
+	b.mutex.lock();
+	if(b.count == 0) {
+	  // already sent because it filled up or was flushed
+	  b.mutex.unlock();
+	  continue;
+	}
+	long long age = now - b.first_time;
+	if(age < Config::am_batch_latency) {
+	  b.mutex.unlock();
+	  long long remaining = Config::am_batch_latency - age;
+	  if((wait_nsec < 0) || (remaining < wait_nsec))
+	    wait_nsec = remaining;
+	  todo[kept++] = todo[i];
+	  continue;
+	}
+	send_current_batch(todo[i], b, false /*!wait*/);
+      }
+      todo.resize(kept);
+    }
+  }
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class IncomingMessageManager::MessageBlock
@@ -357,6 +822,7 @@ namespace Realm {
     , num_available_blocks(0)
     , cfg_max_available_blocks(10)
     , cfg_message_block_size(1048576 - 32) // 1MB - space for heap metadata
+    , batch_msgid(activemsg_handler_table.lookup_message_id<ActiveMessageBatch>())
   {
     heads = new Message *[nodes];
     tails = new Message **[nodes];
@@ -391,24 +857,13 @@ namespace Realm {
       MessageBlock::free_block(available_blocks);
   }
 
-  bool IncomingMessageManager::add_incoming_message(NodeID sender,
-						    ActiveMessageHandlerTable::MessageID msgid,
-						    const void *hdr, size_t hdr_size,
-						    int hdr_mode,
-						    const void *payload, size_t payload_size,
-						    int payload_mode,
-						    CallbackFnptr callback_fnptr,
-						    CallbackData callback_data1,
-						    CallbackData callback_data2,
-						    TimeLimit work_until)
+  bool IncomingMessageManager::try_inline_handler(NodeID sender,
+						  ActiveMessageHandlerTable::HandlerEntry *handler,
+						  const void *hdr,
+						  const void *payload,
+						  size_t payload_size,
+						  TimeLimit work_until)
   {
-#ifdef DEBUG_INCOMING
-    printf("adding incoming message from %d\n", sender);
-#endif
-
-    // look up which message this is
-    ActiveMessageHandlerTable::HandlerEntry *handler = activemsg_handler_table.lookup_message_handler(msgid);
-
     // if we have an inline handler and enough time to run it, give it
     //  a go
     if((handler->handler_inline != 0) &&
@@ -424,21 +879,152 @@ namespace Realm {
 	  long long t_end = Clock::current_time_in_nanoseconds();
 	  handler->stats.record(t_start, t_end);
 	}
-	if(payload_mode == PAYLOAD_FREE)
-	  free(const_cast<void *>(payload));
 	return true;
       }
     }
+    return false;
+  }
+
+  bool IncomingMessageManager::add_incoming_message(NodeID sender,
+						    ActiveMessageHandlerTable::MessageID msgid,
+						    const void *hdr, size_t hdr_size,
+						    int hdr_mode,
+						    const void *payload, size_t payload_size,
+						    int payload_mode,
+						    CallbackFnptr callback_fnptr,
+						    CallbackData callback_data1,
+						    CallbackData callback_data2,
+						    TimeLimit work_until)
+  {
+#ifdef DEBUG_INCOMING
+    printf("adding incoming message from %d\n", sender);
+#endif
+
+    // a batch's contents are copied out (or handled) immediately, so the
+    //  batch always counts as handled and the callback is left to the caller
+    if(REALM_UNLIKELY(msgid == batch_msgid))
+      return add_incoming_batch(sender, hdr, hdr_mode,
+				payload, payload_size, payload_mode,
+				work_until);
+
+    // look up which message this is
+    ActiveMessageHandlerTable::HandlerEntry *handler = activemsg_handler_table.lookup_message_handler(msgid);
+
+    if(try_inline_handler(sender, handler, hdr, payload, payload_size,
+			  work_until)) {
+      if(payload_mode == PAYLOAD_FREE)
+	free(const_cast<void *>(payload));
+      return true;
+    }
 
     // can't handle inline - need to create a Message object for it
 
     mutex.lock();
 
+    Message *msg = allocate_message(((hdr_mode == PAYLOAD_COPY) ?
+				       hdr_size : 0),
+				    ((payload_mode == PAYLOAD_COPY) ?
+				       payload_size : 0));
+
+    // fill in message structure
+    // TODO: let go of lock if copying a large payload?
+    {
+      msg->next_msg = 0;
+      msg->sender = sender;
+      msg->handler = handler;
+      msg->callback_fnptr = callback_fnptr;
+      msg->callback_data1 = callback_data1;
+      msg->callback_data2 = callback_data2;
+
+      if(hdr_mode == PAYLOAD_COPY)
+	memcpy(msg->hdr, hdr, hdr_size);
+      else
+	msg->hdr = const_cast<void *>(hdr);
+      msg->hdr_size = hdr_size;
+      msg->hdr_needs_free = (hdr_mode == PAYLOAD_FREE);
+
+      if(payload_size > 0) {
+	if(payload_mode == PAYLOAD_COPY)
+	  memcpy(msg->payload, payload, payload_size);
+	else
+	  msg->payload = const_cast<void *>(payload);
+      }
+      msg->payload_size = payload_size;
+      msg->payload_needs_free = (payload_mode == PAYLOAD_FREE);
+    }
+
+    enqueue_message(sender, msg);
+    mutex.unlock();
+
+    return false;  // not handled right away
+  }
+
+  bool IncomingMessageManager::add_incoming_batch(NodeID sender,
+						  const void *hdr,
+						  int hdr_mode,
+						  const void *payload,
+						  size_t payload_size,
+						  int payload_mode,
+						  TimeLimit work_until)
+  {
+    const ActiveMessageBatch *batch = static_cast<const ActiveMessageBatch *>(hdr);
+    const char *pos = static_cast<const char *>(payload);
+    const char *end = pos + payload_size;
+
+    // messages at the front of the batch are offered to their inline
+    //  handlers, but once one has to be queued, the rest are queued behind
+    //  it (under a single acquisition of the mutex) to preserve their order
+    bool queueing = false;
+    for(unsigned i = 0; i < batch->count; i++) {
+      const ActiveMessageBatch::Entry *entry = reinterpret_cast<const ActiveMessageBatch::Entry *>(pos);
+      const char *msg_hdr = pos + ActiveMessageBatch::padded(sizeof(ActiveMessageBatch::Entry));
+      const char *msg_payload = msg_hdr + ActiveMessageBatch::padded(entry->header_size);
+      pos = msg_payload + ActiveMessageBatch::padded(entry->payload_size);
+      assert(pos <= end);
+
+      ActiveMessageHandlerTable::HandlerEntry *handler = activemsg_handler_table.lookup_message_handler(entry->msgid);
+      if(!queueing) {
+	if(try_inline_handler(sender, handler, msg_hdr,
+			      (entry->payload_size ? msg_payload : 0),
+			      entry->payload_size, work_until))
+	  continue;
+	queueing = true;
+	mutex.lock();
+      }
+
+      Message *msg = allocate_message(entry->header_size,
+				      entry->payload_size);
+      msg->next_msg = 0;
+      msg->sender = sender;
+      msg->handler = handler;
+      msg->callback_fnptr = 0;
+      msg->callback_data1 = 0;
+      msg->callback_data2 = 0;
+      memcpy(msg->hdr, msg_hdr, entry->header_size);
+      msg->hdr_size = entry->header_size;
+      msg->hdr_needs_free = false;
+      if(entry->payload_size > 0)
+	memcpy(msg->payload, msg_payload, entry->payload_size);
+      msg->payload_size = entry->payload_size;
+      msg->payload_needs_free = false;
+
+      enqueue_message(sender, msg);
+    }
+    if(queueing)
+      mutex.unlock();
+
+    // everything has been handled or copied, so the batch itself is done
+    if(hdr_mode == PAYLOAD_FREE)
+      free(const_cast<void *>(hdr));
+    if(payload_mode == PAYLOAD_FREE)
+      free(const_cast<void *>(payload));
+    return true;
+  }
+
+  IncomingMessageManager::Message *IncomingMessageManager::allocate_message(size_t hdr_bytes_needed,
+									    size_t payload_bytes_needed)
+  {
     Message *msg = 0;
-    size_t hdr_bytes_needed = ((hdr_mode == PAYLOAD_COPY) ?
-			         hdr_size : 0);
-    size_t payload_bytes_needed = ((payload_mode == PAYLOAD_COPY) ?
-				     payload_size : 0);
     while(true) {
       // try to stick this message in the current block
       msg = current_block->append_message(hdr_bytes_needed,
@@ -482,34 +1068,11 @@ namespace Realm {
       available_blocks = block;
       num_available_blocks++;
     }
+    return msg;
+  }
 
-    // fill in message structure
-    // TODO: let go of lock if copying a large payload?
-    {
-      msg->next_msg = 0;
-      msg->sender = sender;
-      msg->handler = handler;
-      msg->callback_fnptr = callback_fnptr;
-      msg->callback_data1 = callback_data1;
-      msg->callback_data2 = callback_data2;
-
-      if(hdr_mode == PAYLOAD_COPY)
-	memcpy(msg->hdr, hdr, hdr_size);
-      else
-	msg->hdr = const_cast<void *>(hdr);
-      msg->hdr_size = hdr_size;
-      msg->hdr_needs_free = (hdr_mode == PAYLOAD_FREE);
-
-      if(payload_size > 0) {
-	if(payload_mode == PAYLOAD_COPY)
-	  memcpy(msg->payload, payload, payload_size);
-	else
-	  msg->payload = const_cast<void *>(payload);
-      }
-      msg->payload_size = payload_size;
-      msg->payload_needs_free = (payload_mode == PAYLOAD_FREE);
-    }
-
+  void IncomingMessageManager::enqueue_message(NodeID sender, Message *msg)
+  {
     if(heads[sender]) {
       // tack this on to the existing list
       assert(tails[sender]);
@@ -538,9 +1101,6 @@ namespace Realm {
 	}
       }
     }
-    mutex.unlock();
-
-    return false;  // not handled right away
   }
 
   void IncomingMessageManager::start_handler_threads(size_t stack_size)
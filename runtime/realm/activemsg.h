@@ -28,6 +28,8 @@
 #include "realm/threads.h"
 #include "realm/bgwork.h"
 
+#include <deque>
+
 namespace Realm {
 
   namespace Config {
@@ -38,6 +40,14 @@ namespace Realm {
     // the maximum time we're willing to spend on inline message
     //  handlers
     extern long long max_inline_message_time;
+
+    // if non-zero, small messages headed to the same node are packed into
+    //  batches of up to this many bytes before being handed to the network
+    extern size_t am_batch_size;
+
+    // the longest (in nanoseconds) a message may sit in a partially-filled
+    //  batch before the batch is sent anyway
+    extern long long am_batch_latency;
   };
 
   enum { PAYLOAD_NONE, // no payload in packet
@@ -169,6 +179,9 @@ namespace Realm {
   protected:
     ActiveMessageImpl *impl;
     T *header;
+    // target(s) whose batched messages must be flushed before this message
+    //  is sent (see ActiveMessageBatcher)
+    NodeID unbatched_target;
     Realm::Serialization::FixedBufferSerializer fbs;
     uint64_t inline_capacity[INLINE_STORAGE / sizeof(uint64_t)];
   };
@@ -220,6 +233,125 @@ namespace Realm {
     size_t payload_size;
   };
 
+  // header for the network message that carries a batch of small active
+  //  messages packed by the ActiveMessageBatcher - the payload is a sequence
+  //  of Entry structs, each followed by the message's header and payload,
+  //  with each piece padded to ALIGNMENT bytes
+  struct ActiveMessageBatch {
+    unsigned count;
+
+    struct Entry {
+      unsigned short msgid;
+      unsigned short header_size;
+      unsigned payload_size;
+    };
+
+    static const size_t ALIGNMENT = 8;
+
+    static size_t padded(size_t bytes)
+    {
+      return ((bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1));
+    }
+
+    // never called - the IncomingMessageManager unpacks batches before
+    //  looking for a handler, but every message type needs one to get an id
+    static void handle_message(NodeID sender, const ActiveMessageBatch& msg,
+			       const void *data, size_t datalen);
+  };
+
+  // coalesces small single-target active messages into per-destination
+  //  batches - a message is eligible if its header and payload fit in the
+  //  sending ActiveMessage's inline storage and it has no RDMA destination;
+  //  a batch is sent when the next message would not fit in it or when its
+  //  oldest message has waited for Config::am_batch_latency (a dedicated
+  //  thread sleeps until the oldest pending batch is due), and any message
+  //  that isn't batched flushes its target's batch before it is sent
+  class ActiveMessageBatcher {
+  public:
+    ActiveMessageBatcher(int _nodes, CoreReservationSet& crs);
+    ~ActiveMessageBatcher(void);
+
+    // special values for ActiveMessage's record of what to flush at commit
+    enum { FLUSH_NONE = -1, FLUSH_ALL = -2 };
+
+    // returns a batching message implementation constructed in the caller's
+    //  storage, or a null pointer if the message cannot be batched
+    ActiveMessageImpl *create_active_message_impl(NodeID target,
+						  unsigned short msgid,
+						  size_t header_size,
+						  size_t max_payload_size,
+						  void *storage_base,
+						  size_t storage_size);
+
+    // adds a committed message to the target's batch
+    void append_message(NodeID target, unsigned short msgid,
+			const void *header, size_t header_size,
+			const void *payload, size_t payload_size);
+
+    // sends all partially-filled batches right away
+    void flush_all(void);
+    void flush(NodeID target);
+
+    // called before an unbatched message to 'target' (or FLUSH_ALL for a
+    //  multicast) is sent
+    void flush_for_unbatched(NodeID target);
+
+    // stops the flush thread - all batches must already be empty
+    void shutdown(void);
+
+    // messages added to batches, batches handed to the network, and flushes
+    //  requested for unbatched messages
+    size_t get_messages_batched(void) const { return messages_batched.load(); }
+    size_t get_batches_sent(void) const { return batches_sent.load(); }
+    size_t get_flushes(void) const { return flushes.load(); }
+
+  protected:
+    struct ReadyBatch {
+      char *buffer;
+      size_t bytes;
+      unsigned count;
+    };
+
+    struct TargetBatch {
+      TargetBatch(void);
+
+      Mutex mutex;
+      CondVar sent;  // broadcast each time a batch goes to the network
+      char *buffer;
+      size_t bytes, capacity;
+      unsigned count;
+      long long first_time;
+      // batches taken but not yet handed to the network, oldest first -
+      //  only the thread that finds nobody 'sending' sends them, so batches
+      //  to a target go out in order without a lock held over the network
+      std::deque<ReadyBatch> ready;
+      bool sending;
+      size_t batches_taken, batches_done;
+    };
+
+    // takes the target's current batch and queues it to be sent - caller
+    //  must hold b.mutex, which is released - if 'wait' is set, returns
+    //  only after the batch has been handed to the network
+    void send_current_batch(NodeID target, TargetBatch& b, bool wait);
+    void send_batch(NodeID target, const ReadyBatch& rb);
+
+    void flush_thread_loop(void);
+
+    int nodes;
+    TargetBatch *batches;
+    unsigned short batch_msgid;
+    Mutex mutex;
+    CondVar condvar;
+    std::vector<NodeID> pending;  // targets whose batches became non-empty
+    bool flusher_waiting, shutdown_requested;
+    CoreReservation *core_rsrv;
+    Thread *flush_thread;
+    atomic<size_t> messages_batched, batches_sent, flushes;
+  };
+
+  // non-null only when batching is enabled
+  extern ActiveMessageBatcher *activemsg_batcher;
+
   class ActiveMessageHandlerRegBase;
 
   struct ActiveMessageHandlerStats {
@@ -367,7 +499,28 @@ namespace Realm {
     void handler_thread_loop(void);
 
   protected:
+    // unpacks an ActiveMessageBatch, running inline handlers where possible
+    //  and queueing the rest under a single acquisition of the mutex
+    bool add_incoming_batch(NodeID sender,
+			    const void *hdr, int hdr_mode,
+			    const void *payload, size_t payload_size,
+			    int payload_mode,
+			    TimeLimit work_until);
+
+    // tries the inline handler for a message, if it has one and there's
+    //  time for it
+    bool try_inline_handler(NodeID sender,
+			    ActiveMessageHandlerTable::HandlerEntry *handler,
+			    const void *hdr, const void *payload,
+			    size_t payload_size, TimeLimit work_until);
+
     struct MessageBlock;
+    struct Message;
+
+    // both called with the mutex held - allocation may drop it temporarily
+    Message *allocate_message(size_t hdr_bytes_needed,
+			      size_t payload_bytes_needed);
+    void enqueue_message(NodeID sender, Message *msg);
 
     struct Message {
       MessageBlock *block;
@@ -423,6 +576,7 @@ namespace Realm {
     MessageBlock *available_blocks;
     size_t num_available_blocks;
     size_t cfg_max_available_blocks, cfg_message_block_size;
+    ActiveMessageHandlerTable::MessageID batch_msgid;
   };
 
 }; // namespace Realm
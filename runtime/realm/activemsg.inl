@@ -34,6 +34,7 @@ namespace Realm {
   ActiveMessage<T, INLINE_STORAGE>::ActiveMessage()
     : impl(0)
     , header(0)
+    , unbatched_target(ActiveMessageBatcher::FLUSH_NONE)
   {}
 
   template <typename T, size_t INLINE_STORAGE>
@@ -50,17 +51,31 @@ namespace Realm {
   {
     assert(impl == 0);
     unsigned short msgid = activemsg_handler_table.lookup_message_id<T>();
-    impl = Network::create_active_message_impl(_target,
-					       msgid,
-					       sizeof(T),
-					       _max_payload_size,
-					       0, 0, 0,
-					       &inline_capacity,
-					       sizeof(inline_capacity));
+    // small messages may be coalesced with others to the same target
+    if(REALM_UNLIKELY(activemsg_batcher != 0))
+      impl = activemsg_batcher->create_active_message_impl(_target,
+							   msgid,
+							   sizeof(T),
+							   _max_payload_size,
+							   &inline_capacity,
+							   sizeof(inline_capacity));
+    if(impl == 0) {
+      impl = Network::create_active_message_impl(_target,
+						 msgid,
+						 sizeof(T),
+						 _max_payload_size,
+						 0, 0, 0,
+						 &inline_capacity,
+						 sizeof(inline_capacity));
+      unbatched_target = ((activemsg_batcher != 0) ?
+			    _target :
+			    NodeID(ActiveMessageBatcher::FLUSH_NONE));
+    } else
+      unbatched_target = ActiveMessageBatcher::FLUSH_NONE;
     header = new(impl->header_base) T;
     fbs.reset(impl->payload_base, impl->payload_size);
   }
-    
+
   template <typename T, size_t INLINE_STORAGE>
   ActiveMessage<T, INLINE_STORAGE>::ActiveMessage(NodeID _target,
 						  size_t _max_payload_size,
@@ -85,6 +100,9 @@ namespace Realm {
 					       _dest_payload_addr,
 					       &inline_capacity,
 					       sizeof(inline_capacity));
+    unbatched_target = ((activemsg_batcher != 0) ?
+			  _target :
+			  NodeID(ActiveMessageBatcher::FLUSH_NONE));
     header = new(impl->header_base) T;
     fbs.reset(impl->payload_base, impl->payload_size);
   }
@@ -110,6 +128,9 @@ namespace Realm {
 					       0, 0, 0,
 					       &inline_capacity,
 					       sizeof(inline_capacity));
+    unbatched_target = ((activemsg_batcher != 0) ?
+			  NodeID(ActiveMessageBatcher::FLUSH_ALL) :
+			  NodeID(ActiveMessageBatcher::FLUSH_NONE));
     header = new(impl->header_base) T;
     fbs.reset(impl->payload_base, impl->payload_size);
   }
@@ -135,6 +156,9 @@ namespace Realm {
 					       _data, 0, 0,
 					       &inline_capacity,
 					       sizeof(inline_capacity));
+    unbatched_target = ((activemsg_batcher != 0) ?
+			  _target :
+			  NodeID(ActiveMessageBatcher::FLUSH_NONE));
     header = new(impl->header_base) T;
   }
     
@@ -162,6 +186,9 @@ namespace Realm {
 					       _dest_payload_addr,
 					       &inline_capacity,
 					       sizeof(inline_capacity));
+    unbatched_target = ((activemsg_batcher != 0) ?
+			  _target :
+			  NodeID(ActiveMessageBatcher::FLUSH_NONE));
     header = new(impl->header_base) T;
   }
     
@@ -186,6 +213,9 @@ namespace Realm {
 					       _data, 0, 0,
 					       &inline_capacity,
 					       sizeof(inline_capacity));
+    unbatched_target = ((activemsg_batcher != 0) ?
+			  NodeID(ActiveMessageBatcher::FLUSH_ALL) :
+			  NodeID(ActiveMessageBatcher::FLUSH_NONE));
     header = new(impl->header_base) T;
   }
 
@@ -212,6 +242,9 @@ namespace Realm {
 					       _data, _lines, _line_stride,
 					       &inline_capacity,
 					       sizeof(inline_capacity));
+    unbatched_target = ((activemsg_batcher != 0) ?
+			  _target :
+			  NodeID(ActiveMessageBatcher::FLUSH_NONE));
     header = new(impl->header_base) T;
   }
 
@@ -241,6 +274,9 @@ namespace Realm {
 					       _dest_payload_addr,
 					       &inline_capacity,
 					       sizeof(inline_capacity));
+    unbatched_target = ((activemsg_batcher != 0) ?
+			  _target :
+			  NodeID(ActiveMessageBatcher::FLUSH_NONE));
     header = new(impl->header_base) T;
   }
 
@@ -267,6 +303,9 @@ namespace Realm {
 					       _data, _lines, _line_stride,
 					       &inline_capacity,
 					       sizeof(inline_capacity));
+    unbatched_target = ((activemsg_batcher != 0) ?
+			  NodeID(ActiveMessageBatcher::FLUSH_ALL) :
+			  NodeID(ActiveMessageBatcher::FLUSH_NONE));
     header = new(impl->header_base) T;
   }
 
@@ -445,6 +484,11 @@ namespace Realm {
     else
       act_payload_len = 0;
 
+    // an unbatched message must not overtake messages already batched for
+    //  the same target(s)
+    if(REALM_UNLIKELY(unbatched_target != ActiveMessageBatcher::FLUSH_NONE))
+      activemsg_batcher->flush_for_unbatched(unbatched_target);
+
     impl->commit(act_payload_len);
 
     // now tear things down
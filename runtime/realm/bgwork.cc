@@ -343,6 +343,11 @@ namespace Realm {
     dedicated_workers.clear();
   }
 
+  size_t BackgroundWorkManager::get_num_dedicated_workers(void) const
+  {
+    return dedicated_workers.size();
+  }
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class BackgroundWorkItem
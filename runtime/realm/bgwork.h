@@ -90,6 +90,9 @@ namespace Realm {
 
     void stop_dedicated_workers(void);
 
+    // returns the number of dedicated worker threads that were started
+    size_t get_num_dedicated_workers(void) const;
+
     typedef unsigned long long BitMask;
     static const size_t MAX_WORK_ITEMS = 256;
     static const size_t BITMASK_BITS = 8 * sizeof(BitMask);
@@ -104,13 +104,14 @@ namespace Realm {
 
   template <int N, typename T, typename FT>
   template <typename BM>
-  void ByFieldMicroOp<N,T,FT>::populate_bitmasks(std::map<FT, BM *>& bitmasks)
+  void ByFieldMicroOp<N,T,FT>::populate_bitmasks(const IndexSpace<N,T>& scan_space,
+						 std::map<FT, BM *>& bitmasks)
   {
     // for now, one access for the whole instance
     AffineAccessor<FT,N,T> a_data(inst, field_offset);
 
     // double iteration - use the instance's space first, since it's probably smaller
-    for(IndexSpaceIterator<N,T> it(inst_space); it.valid; it.step()) {
+    for(IndexSpaceIterator<N,T> it(scan_space); it.valid; it.step()) {
       for(IndexSpaceIterator<N,T> it2(parent_space, it.rect); it2.valid; it2.step()) {
 	const Rect<N,T>& r = it2.rect;
 	Point<N,T> p = r.lo;
@@ -162,7 +163,7 @@ namespace Realm {
 #ifdef DEBUG_PARTITIONING
     std::map<FT, CoverageCounter<N,T> *> values_present;
 
-    populate_bitmasks(values_present);
+    populate_bitmasks(inst_space, values_present);
 
     std::cout << values_present.size() << " values present in instance " << inst << std::endl;
     for(typename std::map<FT, CoverageCounter<N,T> *>::const_iterator it = values_present.begin();
@@ -173,7 +174,10 @@ namespace Realm {
 
     std::map<FT, DenseRectangleList<N,T> *> rect_map;
 
-    populate_bitmasks(rect_map);
+    // large instances are scanned in tiles by all the partitioning workers
+    tiled_scan(this,
+	       &ByFieldMicroOp<N,T,FT>::template populate_bitmasks<DenseRectangleList<N,T> >,
+	       inst_space, rect_map);
 
 #ifdef DEBUG_PARTITIONING
     std::cout << values_present.size() << " values present in instance " << inst << std::endl;
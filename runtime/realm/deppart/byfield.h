@@ -54,7 +54,8 @@ namespace Realm {
     ByFieldMicroOp(NodeID _requestor, AsyncMicroOp *_async_microop, S& s);
 
     template <typename BM>
-    void populate_bitmasks(std::map<FT, BM *>& bitmasks);
+    void populate_bitmasks(const IndexSpace<N,T>& scan_space,
+			   std::map<FT, BM *>& bitmasks);
 
     IndexSpace<N,T> parent_space, inst_space;
     RegionInstance inst;
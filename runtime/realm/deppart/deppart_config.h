@@ -27,6 +27,8 @@ namespace Realm {
     extern int cfg_max_rects_in_approximation;
     extern size_t cfg_max_bytes_per_packet;
     extern bool cfg_worker_threads_sleep;
+    extern size_t cfg_scan_tile_size;
+    extern size_t cfg_bitmap_max_points;
 
   };
 
@@ -162,13 +162,14 @@ namespace Realm {
 
   template <int N, typename T, int N2, typename T2>
   template <typename BM>
-  void ImageMicroOp<N,T,N2,T2>::populate_bitmasks_ptrs(std::map<int, BM *>& bitmasks)
+  void ImageMicroOp<N,T,N2,T2>::populate_bitmasks_ptrs(const IndexSpace<N2,T2>& scan_space,
+						       std::map<int, BM *>& bitmasks)
   {
     // for now, one access for the whole instance
     AffineAccessor<Point<N,T>,N2,T2> a_data(inst, field_offset);
 
     // double iteration - use the instance's space first, since it's probably smaller
-    for(IndexSpaceIterator<N2,T2> it(inst_space); it.valid; it.step()) {
+    for(IndexSpaceIterator<N2,T2> it(scan_space); it.valid; it.step()) {
       for(size_t i = 0; i < sources.size(); i++) {
 	for(IndexSpaceIterator<N2,T2> it2(sources[i], it.rect); it2.valid; it2.step()) {
 	  BM **bmpp = 0;
@@ -197,13 +198,14 @@ namespace Realm {
 
   template <int N, typename T, int N2, typename T2>
   template <typename BM>
-  void ImageMicroOp<N,T,N2,T2>::populate_bitmasks_ranges(std::map<int, BM *>& bitmasks)
+  void ImageMicroOp<N,T,N2,T2>::populate_bitmasks_ranges(const IndexSpace<N2,T2>& scan_space,
+							 std::map<int, BM *>& bitmasks)
   {
     // for now, one access for the whole instance
     AffineAccessor<Rect<N,T>,N2,T2> a_data(inst, field_offset);
 
     // double iteration - use the instance's space first, since it's probably smaller
-    for(IndexSpaceIterator<N2,T2> it(inst_space); it.valid; it.step()) {
+    for(IndexSpaceIterator<N2,T2> it(scan_space); it.valid; it.step()) {
       for(size_t i = 0; i < sources.size(); i++) {
 	for(IndexSpaceIterator<N2,T2> it2(sources[i], it.rect); it2.valid; it2.step()) {
 	  BM **bmpp = 0;
@@ -296,10 +298,15 @@ namespace Realm {
       //std::map<int, DenseRectangleList<N,T> *> rect_map;
       std::map<int, HybridRectangleList<N,T> *> rect_map;
 
+      // large instances are scanned in tiles by all the partitioning workers
       if(is_ranged)
-	populate_bitmasks_ranges(rect_map);
+	tiled_scan(this,
+		   &ImageMicroOp<N,T,N2,T2>::template populate_bitmasks_ranges<HybridRectangleList<N,T> >,
+		   inst_space, rect_map);
       else
-	populate_bitmasks_ptrs(rect_map);
+	tiled_scan(this,
+		   &ImageMicroOp<N,T,N2,T2>::template populate_bitmasks_ptrs<HybridRectangleList<N,T> >,
+		   inst_space, rect_map);
 
 #ifdef DEBUG_PARTITIONING
       std::cout << rect_map.size() << " non-empty images present in instance " << inst << std::endl;
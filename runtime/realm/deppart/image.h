@@ -57,10 +57,12 @@ namespace Realm {
     ImageMicroOp(NodeID _requestor, AsyncMicroOp *_async_microop, S& s);
 
     template <typename BM>
-    void populate_bitmasks_ptrs(std::map<int, BM *>& bitmasks);
+    void populate_bitmasks_ptrs(const IndexSpace<N2,T2>& scan_space,
+				std::map<int, BM *>& bitmasks);
 
     template <typename BM>
-    void populate_bitmasks_ranges(std::map<int, BM *>& bitmasks);
+    void populate_bitmasks_ranges(const IndexSpace<N2,T2>& scan_space,
+				  std::map<int, BM *>& bitmasks);
 
     template <typename BM>
     void populate_approx_bitmask_ptrs(BM& bitmask);
@@ -45,6 +45,8 @@ namespace Realm {
     size_t cfg_max_bytes_per_packet = 2048;//32768;
     bool cfg_worker_threads_sleep = true;
     bool cfg_allow_inline_operations = false;
+    size_t cfg_scan_tile_size = 1 << 20; // points per tile, 0 disables tiling
+    size_t cfg_bitmap_max_points = 1 << 16; // per bitmap entry, 0 disables bitmaps
   };
 
   // TODO: C++11 has type_traits and std::make_unsigned
@@ -114,7 +116,10 @@ namespace Realm {
 	it != entries.end();
 	it++) {
       for(int i = 0; i < N; i++)
-	lo_volume[i] += it->bounds.intersection(lo_half[i]).volume();
+	if(it->bitmap != 0)
+	  lo_volume[i] += it->bitmap->count_bits(lo_half[i]);
+	else
+	  lo_volume[i] += it->bounds.intersection(lo_half[i]).volume();
     }
     // now compute how many subspaces would fall in each half and the 
     //  inefficiency of the split
@@ -830,6 +835,89 @@ namespace Realm {
   }
 
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class TiledScanBase
+
+  TiledScanBase::TiledScanBase(size_t _num_tiles)
+    : num_tiles(_num_tiles)
+    , next_tile(0)
+    , tiles_done(0)
+    , refcount(1)
+    , done_cond(done_mutex)
+  {}
+
+  TiledScanBase::~TiledScanBase(void)
+  {}
+
+  void TiledScanBase::add_reference(void)
+  {
+    refcount.fetch_add(1);
+  }
+
+  void TiledScanBase::remove_reference(void)
+  {
+    if(refcount.fetch_sub_acqrel(1) == 1)
+      delete this;
+  }
+
+  bool TiledScanBase::process_next_tile(void)
+  {
+    size_t index = next_tile.fetch_add(1);
+    if(index >= num_tiles)
+      return false;
+
+    scan_tile(index);
+    if((tiles_done.fetch_add_acqrel(1) + 1) == num_tiles) {
+      // the thread in run() checks the count while holding the mutex, so
+      //  it can't miss this
+      AutoLock<> al(done_mutex);
+      done_cond.signal();
+    }
+    return true;
+  }
+
+  void TiledScanBase::run(void)
+  {
+    // one helper per tile beyond the one we'll start on, but no more than
+    //  there are other workers to run them - extra helpers would only
+    //  find that all the tiles have been claimed
+    size_t num_workers = deppart_op_queue->get_num_workers();
+    size_t num_helpers = std::min(num_tiles - 1,
+				  ((num_workers > 0) ? (num_workers - 1) : 0));
+    for(size_t i = 0; i < num_helpers; i++) {
+      add_reference();
+      deppart_op_queue->enqueue_partitioning_microop(new TiledScanHelperMicroOp(this));
+    }
+
+    while(process_next_tile()) {}
+
+    // sleep until tiles that helpers are still working on are done - these
+    //  are already running, so this won't take longer than a single tile
+    AutoLock<> al(done_mutex);
+    while(tiles_done.load_acquire() < num_tiles)
+      done_cond.wait();
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class TiledScanHelperMicroOp
+
+  TiledScanHelperMicroOp::TiledScanHelperMicroOp(TiledScanBase *_scan)
+    : scan(_scan)
+  {}
+
+  TiledScanHelperMicroOp::~TiledScanHelperMicroOp(void)
+  {}
+
+  void TiledScanHelperMicroOp::execute(void)
+  {
+    while(scan->process_next_tile()) {}
+    scan->remove_reference();
+  }
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class PartitioningOpQueue
@@ -858,6 +946,8 @@ namespace Realm {
     cp.add_option_bool("-dp:noisectopt", DeppartConfig::cfg_disable_intersection_optimization);
     cp.add_option_int("-dp:sleep", DeppartConfig::cfg_worker_threads_sleep);
     cp.add_option_int("-dp:inline_ok", DeppartConfig::cfg_allow_inline_operations);
+    cp.add_option_int("-dp:tile_size", DeppartConfig::cfg_scan_tile_size);
+    cp.add_option_int("-dp:bitmap", DeppartConfig::cfg_bitmap_max_points);
 
     cp.parse_command_line(cmdline);
   }
@@ -904,6 +994,13 @@ namespace Realm {
     deppart_op_queue = 0;
   }
       
+  size_t PartitioningOpQueue::get_num_workers(void) const
+  {
+    if(!workers.empty())
+      return workers.size();
+    return (manager ? manager->get_num_dedicated_workers() : 0);
+  }
+
   void PartitioningOpQueue::enqueue_partitioning_operation(PartitioningOperation *op)
   {
     op->mark_ready();
@@ -29,6 +29,7 @@
 #include "realm/nodeset.h"
 #include "realm/interval_tree.h"
 #include "realm/dynamic_templates.h"
+#include "realm/deppart/deppart_config.h"
 #include "realm/deppart/sparsity_impl.h"
 #include "realm/deppart/inst_helper.h"
 #include "realm/bgwork.h"
@@ -202,6 +203,11 @@ namespace Realm {
     void enqueue_partitioning_operation(PartitioningOperation *op);
     void enqueue_partitioning_microop(PartitioningMicroOp *uop);
 
+    // the number of threads that execute partitioning work - the
+    //  dedicated partitioning workers if there are any, or the background
+    //  workers otherwise
+    size_t get_num_workers(void) const;
+
     void worker_thread_loop(void);
 
     // called by BackgroundWorkers
@@ -219,6 +225,81 @@ namespace Realm {
   };
 
 
+  // the scan of a single large instance can be split into tiles that are
+  //  processed by all the partitioning workers - the thread that calls run()
+  //  works on tiles as well, and then sleeps until whoever finishes the
+  //  last tile wakes it up
+  class TiledScanBase {
+  public:
+    TiledScanBase(size_t _num_tiles);
+
+    void run(void);
+
+    // claims and scans the next unclaimed tile - returns false if none remain
+    bool process_next_tile(void);
+
+    void add_reference(void);
+    void remove_reference(void);
+
+  protected:
+    virtual ~TiledScanBase(void);
+
+    virtual void scan_tile(size_t index) = 0;
+
+    size_t num_tiles;
+    atomic<size_t> next_tile, tiles_done;
+    atomic<int> refcount;
+    Mutex done_mutex;
+    CondVar done_cond;
+  };
+
+  // queued on the partitioning op queue so that idle workers help with a
+  //  tiled scan
+  class TiledScanHelperMicroOp : public PartitioningMicroOp {
+  public:
+    TiledScanHelperMicroOp(TiledScanBase *_scan);
+    virtual ~TiledScanHelperMicroOp(void);
+
+    virtual void execute(void);
+
+  protected:
+    TiledScanBase *scan;
+  };
+
+  template <typename UOP, int N, typename T, typename K, typename BM>
+  class TiledScan : public TiledScanBase {
+  public:
+    typedef void (UOP::*ScanMethod)(const IndexSpace<N,T>& scan_space,
+				    std::map<K, BM *>& bitmasks);
+
+    TiledScan(UOP *_uop, ScanMethod _method, const IndexSpace<N,T>& _space,
+	      const std::vector<Rect<N,T> >& _tiles);
+
+    // one result map per tile
+    std::vector<std::map<K, BM *> > results;
+
+  protected:
+    virtual void scan_tile(size_t index);
+
+    UOP *uop;
+    ScanMethod method;
+    IndexSpace<N,T> space;
+    std::vector<Rect<N,T> > tiles;
+  };
+
+  // splits 'bounds' into tiles of roughly -dp:tile_size points - returns
+  //  false if tiling is disabled or the bounds are too small to bother
+  template <int N, typename T>
+  bool compute_scan_tiles(const Rect<N,T>& bounds, std::vector<Rect<N,T> >& tiles);
+
+  // scans 'space' with 'method', splitting it into tiles if it is large, and
+  //  merges the per-tile rectangle lists into 'bitmasks'
+  template <typename UOP, int N, typename T, typename K, typename BM>
+  void tiled_scan(UOP *uop,
+		  void (UOP::*method)(const IndexSpace<N,T>&, std::map<K, BM *>&),
+		  const IndexSpace<N,T>& space, std::map<K, BM *>& bitmasks);
+
+
   ////////////////////////////////////////
   //
   // active messages
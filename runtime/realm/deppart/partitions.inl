@@ -52,5 +52,108 @@ namespace Realm {
   }
 
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class TiledScan<UOP,N,T,K,BM>
+  //
+
+  template <typename UOP, int N, typename T, typename K, typename BM>
+  TiledScan<UOP,N,T,K,BM>::TiledScan(UOP *_uop, ScanMethod _method,
+				     const IndexSpace<N,T>& _space,
+				     const std::vector<Rect<N,T> >& _tiles)
+    : TiledScanBase(_tiles.size())
+    , results(_tiles.size())
+    , uop(_uop)
+    , method(_method)
+    , space(_space)
+    , tiles(_tiles)
+  {}
+
+  template <typename UOP, int N, typename T, typename K, typename BM>
+  void TiledScan<UOP,N,T,K,BM>::scan_tile(size_t index)
+  {
+    // same sparsity, restricted bounds
+    IndexSpace<N,T> tile_space(space.bounds.intersection(tiles[index]),
+			       space.sparsity);
+    (uop->*method)(tile_space, results[index]);
+  }
+
+  template <int N, typename T>
+  bool compute_scan_tiles(const Rect<N,T>& bounds, std::vector<Rect<N,T> >& tiles)
+  {
+    size_t tile_size = DeppartConfig::cfg_scan_tile_size;
+    if((tile_size == 0) || bounds.empty())
+      return false;
+
+    size_t volume = bounds.volume();
+    if(volume < (2 * tile_size))
+      return false;
+
+    // split along the slowest-varying dimension that has enough extent, so
+    //  that each tile is a contiguous chunk of a row-major scan
+    size_t want = (volume + tile_size - 1) / tile_size;
+    int split_dim = -1;
+    for(int i = N - 1; i >= 0; i--)
+      if(size_t(bounds.hi[i] - bounds.lo[i]) + 1 >= want) {
+	split_dim = i;
+	break;
+      }
+    if(split_dim < 0) {
+      // no single dimension is long enough - use the longest one
+      split_dim = 0;
+      for(int i = 1; i < N; i++)
+	if((bounds.hi[i] - bounds.lo[i]) > (bounds.hi[split_dim] - bounds.lo[split_dim]))
+	  split_dim = i;
+    }
+
+    size_t extent = size_t(bounds.hi[split_dim] - bounds.lo[split_dim]) + 1;
+    size_t count = std::min(want, extent);
+    if(count < 2)
+      return false;
+    size_t step = (extent + count - 1) / count;
+
+    for(size_t i = 0; i < extent; i += step) {
+      Rect<N,T> tile = bounds;
+      tile.lo[split_dim] = bounds.lo[split_dim] + T(i);
+      tile.hi[split_dim] = bounds.lo[split_dim] + T(std::min(i + step, extent) - 1);
+      tiles.push_back(tile);
+    }
+    return true;
+  }
+
+  template <typename UOP, int N, typename T, typename K, typename BM>
+  void tiled_scan(UOP *uop,
+		  void (UOP::*method)(const IndexSpace<N,T>&, std::map<K, BM *>&),
+		  const IndexSpace<N,T>& space, std::map<K, BM *>& bitmasks)
+  {
+    std::vector<Rect<N,T> > tiles;
+    if(!compute_scan_tiles(space.bounds, tiles)) {
+      (uop->*method)(space, bitmasks);
+      return;
+    }
+
+    TiledScan<UOP,N,T,K,BM> *scan = new TiledScan<UOP,N,T,K,BM>(uop, method,
+								  space, tiles);
+    scan->run();
+
+    // merge the per-tile results in tile order
+    for(size_t i = 0; i < scan->results.size(); i++)
+      for(typename std::map<K, BM *>::iterator it = scan->results[i].begin();
+	  it != scan->results[i].end();
+	  ++it) {
+	BM *&bmp = bitmasks[it->first];
+	if(!bmp) {
+	  // first tile with this key donates its list
+	  bmp = it->second;
+	} else {
+	  absorb_rect_list(*bmp, *(it->second));
+	  delete it->second;
+	}
+      }
+
+    scan->remove_reference();
+  }
+
+
 };
 
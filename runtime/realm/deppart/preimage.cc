@@ -115,13 +115,14 @@ namespace Realm {
 
   template <int N, typename T, int N2, typename T2>
   template <typename BM>
-  void PreimageMicroOp<N,T,N2,T2>::populate_bitmasks_ptrs(std::map<int, BM *>& bitmasks)
+  void PreimageMicroOp<N,T,N2,T2>::populate_bitmasks_ptrs(const IndexSpace<N,T>& scan_space,
+							  std::map<int, BM *>& bitmasks)
   {
     // for now, one access for the whole instance
     AffineAccessor<Point<N2,T2>,N,T> a_data(inst, field_offset);
 
     // double iteration - use the instance's space first, since it's probably smaller
-    for(IndexSpaceIterator<N,T> it(inst_space); it.valid; it.step()) {
+    for(IndexSpaceIterator<N,T> it(scan_space); it.valid; it.step()) {
       for(IndexSpaceIterator<N,T> it2(parent_space, it.rect); it2.valid; it2.step()) {
 	// now iterate over each point
 	for(PointInRectIterator<N,T> pir(it2.rect); pir.valid; pir.step()) {
@@ -141,13 +142,14 @@ namespace Realm {
 
   template <int N, typename T, int N2, typename T2>
   template <typename BM>
-  void PreimageMicroOp<N,T,N2,T2>::populate_bitmasks_ranges(std::map<int, BM *>& bitmasks)
+  void PreimageMicroOp<N,T,N2,T2>::populate_bitmasks_ranges(const IndexSpace<N,T>& scan_space,
+							    std::map<int, BM *>& bitmasks)
   {
     // for now, one access for the whole instance
     AffineAccessor<Rect<N2,T2>,N,T> a_data(inst, field_offset);
 
     // double iteration - use the instance's space first, since it's probably smaller
-    for(IndexSpaceIterator<N,T> it(inst_space); it.valid; it.step()) {
+    for(IndexSpaceIterator<N,T> it(scan_space); it.valid; it.step()) {
       for(IndexSpaceIterator<N,T> it2(parent_space, it.rect); it2.valid; it2.step()) {
 	// now iterate over each point
 	for(PointInRectIterator<N,T> pir(it2.rect); pir.valid; pir.step()) {
@@ -171,10 +173,15 @@ namespace Realm {
     TimeStamp ts("PreimageMicroOp::execute", true, &log_uop_timing);
     std::map<int, DenseRectangleList<N,T> *> rect_map;
 
+    // large instances are scanned in tiles by all the partitioning workers
     if(is_ranged)
-      populate_bitmasks_ranges(rect_map);
+      tiled_scan(this,
+		 &PreimageMicroOp<N,T,N2,T2>::template populate_bitmasks_ranges<DenseRectangleList<N,T> >,
+		 inst_space, rect_map);
     else
-      populate_bitmasks_ptrs(rect_map);
+      tiled_scan(this,
+		 &PreimageMicroOp<N,T,N2,T2>::template populate_bitmasks_ptrs<DenseRectangleList<N,T> >,
+		 inst_space, rect_map);
 
 #ifdef DEBUG_PARTITIONING
     std::cout << rect_map.size() << " non-empty preimages present in instance " << inst << std::endl;
@@ -53,10 +53,12 @@ namespace Realm {
     PreimageMicroOp(NodeID _requestor, AsyncMicroOp *_async_microop, S& s);
 
     template <typename BM>
-    void populate_bitmasks_ptrs(std::map<int, BM *>& bitmasks);
+    void populate_bitmasks_ptrs(const IndexSpace<N,T>& scan_space,
+				std::map<int, BM *>& bitmasks);
 
     template <typename BM>
-    void populate_bitmasks_ranges(std::map<int, BM *>& bitmasks);
+    void populate_bitmasks_ranges(const IndexSpace<N,T>& scan_space,
+				  std::map<int, BM *>& bitmasks);
 
     IndexSpace<N,T> parent_space, inst_space;
     RegionInstance inst;
@@ -82,6 +82,14 @@ namespace Realm {
   template <int N, typename T>
   std::ostream& operator<<(std::ostream& os, const HybridRectangleList<N,T>& hrl);
 
+  // adds all of the rectangles in 'src' to 'dst' - used to combine the
+  //  results of scanning separate tiles of an instance
+  template <int N, typename T>
+  void absorb_rect_list(DenseRectangleList<N,T>& dst, DenseRectangleList<N,T>& src);
+
+  template <int N, typename T>
+  void absorb_rect_list(HybridRectangleList<N,T>& dst, HybridRectangleList<N,T>& src);
+
 };
 
 #endif // REALM_DEPPART_RECTLIST_H
@@ -654,6 +654,29 @@ namespace Realm {
     return os;
   }
     
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // absorb_rect_list
+
+  template <int N, typename T>
+  inline void absorb_rect_list(DenseRectangleList<N,T>& dst, DenseRectangleList<N,T>& src)
+  {
+    for(typename std::vector<Rect<N,T> >::const_iterator it = src.rects.begin();
+	it != src.rects.end();
+	++it)
+      dst.add_rect(*it);
+  }
+
+  template <int N, typename T>
+  inline void absorb_rect_list(HybridRectangleList<N,T>& dst, HybridRectangleList<N,T>& src)
+  {
+    const std::vector<Rect<N,T> >& rects = src.convert_to_vector();
+    for(typename std::vector<Rect<N,T> >::const_iterator it = rects.begin();
+	it != rects.end();
+	++it)
+      dst.add_rect(*it);
+  }
+
 };
 
 #endif // REALM_DEPPART_RECTLIST_INL
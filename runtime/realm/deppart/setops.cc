@@ -1001,8 +1001,15 @@ namespace Realm {
 	  if(isect.empty())
 	    continue;
 	  assert(!it2->sparsity.exists());
-	  assert(it2->bitmap == 0);
-	  bitmask.add_rect(isect);
+	  if(it2->bitmap != 0) {
+	    // add each run of set bits
+	    Rect<N,T> run;
+	    for(bool ok = it2->bitmap->first_run(isect, run);
+		ok;
+		ok = it2->bitmap->next_run(isect, run))
+	      bitmask.add_rect(run);
+	  } else
+	    bitmask.add_rect(isect);
 	}
       }
     }
@@ -1367,8 +1374,14 @@ namespace Realm {
 	if(isect.empty())
 	  continue;
 	assert(!it->sparsity.exists());
-	assert(it->bitmap == 0);
-	todo.push_back(isect);
+	if(it->bitmap != 0) {
+	  Rect<N,T> run;
+	  for(bool ok = it->bitmap->first_run(isect, run);
+	      ok;
+	      ok = it->bitmap->next_run(isect, run))
+	    todo.push_back(run);
+	} else
+	  todo.push_back(isect);
       }
     }
 
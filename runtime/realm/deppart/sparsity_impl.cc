@@ -24,6 +24,12 @@
 #include "realm/deppart/inst_helper.h"
 #include "realm/logging.h"
 
+#include <map>
+
+#ifdef REALM_ON_WINDOWS
+#include <intrin.h>
+#endif
+
 namespace Realm {
 
   extern Logger log_part;
@@ -157,6 +163,245 @@ namespace Realm {
   }
 
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class HierarchicalBitMap<N,T>
+
+  static inline unsigned bitmap_popcount(uint64_t v)
+  {
+#ifdef REALM_ON_WINDOWS
+    unsigned v_lo = v;
+    unsigned v_hi = v >> 32;
+    return __popcnt(v_lo) + __popcnt(v_hi);
+#else
+    return __builtin_popcountll(v);
+#endif
+  }
+
+  // 'v' must be non-zero
+  static inline unsigned bitmap_ctz(uint64_t v)
+  {
+#ifdef REALM_ON_WINDOWS
+    unsigned long index;
+    unsigned v_lo = v;
+    unsigned v_hi = v >> 32;
+    if(_BitScanForward(&index, v_lo))
+      return index;
+    _BitScanForward(&index, v_hi);
+    return index + 32;
+#else
+    return __builtin_ctzll(v);
+#endif
+  }
+
+  // bits [lo, hi] of a word (0 <= lo <= hi < 64)
+  static inline uint64_t bitmap_mask(size_t lo, size_t hi)
+  {
+    uint64_t upto_hi = ((hi == 63) ? ~uint64_t(0) : ((uint64_t(2) << hi) - 1));
+    return (upto_hi & ~((uint64_t(1) << lo) - 1));
+  }
+
+  template <int N, typename T>
+  static size_t bitmap_rows(const Rect<N,T>& r)
+  {
+    size_t rows = 1;
+    for(int i = 1; i < N; i++)
+      rows *= size_t(r.hi[i] - r.lo[i] + 1);
+    return rows;
+  }
+
+  // steps 'p' to the next row within 'r', returning false if there are no
+  //  more rows
+  template <int N, typename T>
+  static bool bitmap_next_row(const Rect<N,T>& r, Point<N,T>& p)
+  {
+    for(int i = 1; i < N; i++) {
+      if(p[i] < r.hi[i]) {
+	p[i]++;
+	return true;
+      }
+      p[i] = r.lo[i];
+    }
+    return false;
+  }
+
+  template <int N, typename T>
+  HierarchicalBitMap<N,T>::HierarchicalBitMap(const Rect<N,T>& _bounds)
+    : bounds(_bounds)
+  {
+    assert(!bounds.empty());
+    row_words = (size_t(bounds.hi[0] - bounds.lo[0]) >> 6) + 1;
+    words.resize(bitmap_rows(bounds) * row_words, 0);
+    summary.resize((words.size() + 63) >> 6, 0);
+  }
+
+  template <int N, typename T>
+  HierarchicalBitMap<N,T>::HierarchicalBitMap(const Rect<N,T>& _bounds,
+					      const uint64_t *_words)
+    : bounds(_bounds)
+  {
+    assert(!bounds.empty());
+    row_words = (size_t(bounds.hi[0] - bounds.lo[0]) >> 6) + 1;
+    words.assign(_words, _words + (bitmap_rows(bounds) * row_words));
+    summary.resize((words.size() + 63) >> 6, 0);
+    update_summary(0, words.size() - 1);
+  }
+
+  template <int N, typename T>
+  /*static*/ size_t HierarchicalBitMap<N,T>::storage_bytes(const Rect<N,T>& r)
+  {
+    size_t row_words = (size_t(r.hi[0] - r.lo[0]) >> 6) + 1;
+    size_t total_words = bitmap_rows(r) * row_words;
+    return ((total_words + ((total_words + 63) >> 6)) * sizeof(uint64_t));
+  }
+
+  template <int N, typename T>
+  void HierarchicalBitMap<N,T>::update_summary(size_t first_word,
+					       size_t last_word)
+  {
+    for(size_t w = first_word; w <= last_word; w++) {
+      uint64_t bit = uint64_t(1) << (w & 63);
+      if(words[w] != 0)
+	summary[w >> 6] |= bit;
+      else
+	summary[w >> 6] &= ~bit;
+    }
+  }
+
+  template <int N, typename T>
+  void HierarchicalBitMap<N,T>::set_rect(const Rect<N,T>& r)
+  {
+    assert(bounds.contains(r));
+    if(r.empty()) return;
+    size_t lo_ofs = size_t(r.lo[0] - bounds.lo[0]);
+    size_t hi_ofs = size_t(r.hi[0] - bounds.lo[0]);
+    Point<N,T> p = r.lo;
+    do {
+      size_t base = row_index(p) * row_words;
+      for(size_t w = (lo_ofs >> 6); w <= (hi_ofs >> 6); w++) {
+	size_t b_lo = ((w == (lo_ofs >> 6)) ? (lo_ofs & 63) : 0);
+	size_t b_hi = ((w == (hi_ofs >> 6)) ? (hi_ofs & 63) : 63);
+	words[base + w] |= bitmap_mask(b_lo, b_hi);
+      }
+      update_summary(base + (lo_ofs >> 6), base + (hi_ofs >> 6));
+    } while(bitmap_next_row(r, p));
+  }
+
+  template <int N, typename T>
+  size_t HierarchicalBitMap<N,T>::count_bits(const Rect<N,T>& r) const
+  {
+    Rect<N,T> isect = bounds.intersection(r);
+    if(isect.empty()) return 0;
+    size_t lo_ofs = size_t(isect.lo[0] - bounds.lo[0]);
+    size_t hi_ofs = size_t(isect.hi[0] - bounds.lo[0]);
+    size_t count = 0;
+    Point<N,T> p = isect.lo;
+    do {
+      size_t base = row_index(p) * row_words;
+      for(size_t w = (lo_ofs >> 6); w <= (hi_ofs >> 6); w++) {
+	if(words[base + w] == 0) continue;
+	size_t b_lo = ((w == (lo_ofs >> 6)) ? (lo_ofs & 63) : 0);
+	size_t b_hi = ((w == (hi_ofs >> 6)) ? (hi_ofs & 63) : 63);
+	count += bitmap_popcount(words[base + w] & bitmap_mask(b_lo, b_hi));
+      }
+    } while(bitmap_next_row(isect, p));
+    return count;
+  }
+
+  template <int N, typename T>
+  bool HierarchicalBitMap<N,T>::any_bits(const Rect<N,T>& r) const
+  {
+    Rect<N,T> isect = bounds.intersection(r);
+    if(isect.empty()) return false;
+    Rect<N,T> run;
+    return find_run(isect, isect.lo, run);
+  }
+
+  template <int N, typename T>
+  bool HierarchicalBitMap<N,T>::first_run(const Rect<N,T>& restriction,
+					  Rect<N,T>& run) const
+  {
+    Rect<N,T> isect = bounds.intersection(restriction);
+    if(isect.empty()) return false;
+    return find_run(isect, isect.lo, run);
+  }
+
+  template <int N, typename T>
+  bool HierarchicalBitMap<N,T>::next_run(const Rect<N,T>& restriction,
+					 Rect<N,T>& run) const
+  {
+    Rect<N,T> isect = bounds.intersection(restriction);
+    // a run always ends with a clear bit or the end of the restriction, so
+    //  resume two points later or on the next row
+    Point<N,T> pos = run.lo;
+    if((run.hi[0] < isect.hi[0]) && ((run.hi[0] + 1) < isect.hi[0])) {
+      pos[0] = run.hi[0] + 2;
+    } else {
+      pos[0] = isect.lo[0];
+      if(!bitmap_next_row(isect, pos))
+	return false;
+    }
+    return find_run(isect, pos, run);
+  }
+
+  // finds the first run at or after 'pos' (which must be in 'restriction',
+  //  which must be in our bounds)
+  template <int N, typename T>
+  bool HierarchicalBitMap<N,T>::find_run(const Rect<N,T>& restriction,
+					 Point<N,T> pos,
+					 Rect<N,T>& run) const
+  {
+    size_t end_ofs = size_t(restriction.hi[0] - bounds.lo[0]);
+    size_t end_word = end_ofs >> 6;
+    while(true) {
+      size_t base = row_index(pos) * row_words;
+      size_t ofs = size_t(pos[0] - bounds.lo[0]);
+      size_t w = ofs >> 6;
+      uint64_t bits = words[base + w] & bitmap_mask(ofs & 63, 63);
+      while((bits == 0) && (w < end_word)) {
+	// use the summary to skip over empty words
+	size_t abs_w = base + w + 1;
+	uint64_t s = summary[abs_w >> 6] & bitmap_mask(abs_w & 63, 63);
+	while((s == 0) && (((abs_w | 63) + 1) <= (base + end_word))) {
+	  abs_w = (abs_w | 63) + 1;
+	  s = summary[abs_w >> 6];
+	}
+	if(s == 0) {
+	  w = end_word + 1;
+	  break;
+	}
+	w = ((abs_w & ~size_t(63)) + bitmap_ctz(s)) - base;
+	if(w > end_word)
+	  break;
+	bits = words[base + w];
+      }
+      if((w <= end_word) && (bits != 0)) {
+	size_t start = (w << 6) + bitmap_ctz(bits);
+	if(start <= end_ofs) {
+	  // now find the first clear bit after the start
+	  size_t cw = start >> 6;
+	  uint64_t clear = ~words[base + cw] & bitmap_mask(start & 63, 63);
+	  while((clear == 0) && (cw < end_word))
+	    clear = ~words[base + (++cw)];
+	  size_t stop = ((clear != 0) ? ((cw << 6) + bitmap_ctz(clear)) :
+			                ((cw << 6) + 64));
+	  if(stop > (end_ofs + 1))
+	    stop = end_ofs + 1;
+	  run.lo = pos;
+	  run.hi = pos;
+	  run.lo[0] = bounds.lo[0] + T(start);
+	  run.hi[0] = bounds.lo[0] + T(stop - 1);
+	  return true;
+	}
+      }
+      // nothing left in this row
+      pos[0] = restriction.lo[0];
+      if(!bitmap_next_row(restriction, pos))
+	return false;
+    }
+  }
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class SparsityMapPublicImpl<N,T>
@@ -173,6 +418,109 @@ namespace Realm {
     return static_cast<SparsityMapImpl<N,T> *>(this)->make_valid(precise);
   }
 
+  template <int N, typename T>
+  bool SparsityMapPublicImpl<N,T>::find_entry(const Point<N,T>& p,
+					      size_t& entry_idx)
+  {
+    const std::vector<SparsityMapEntry<N,T> >& entries = get_entries();
+
+    if(N == 1) {
+      // entries are sorted, so binary search for the first entry that
+      //  doesn't end before the point
+      size_t lo = 0;
+      size_t hi = entries.size();
+      while(lo < hi) {
+	size_t mid = (lo + hi) >> 1;
+	if(entries[mid].bounds.hi[0] < p[0])
+	  lo = mid + 1;
+	else
+	  hi = mid;
+      }
+      if((lo < entries.size()) && entries[lo].bounds.contains(p)) {
+	entry_idx = lo;
+	return true;
+      }
+      return false;
+    }
+
+    const SparsityMapEntryIndex<N,T> *index = static_cast<SparsityMapImpl<N,T> *>(this)->get_entry_index();
+    if(index)
+      return index->find_entry(p, entry_idx);
+
+    for(size_t i = 0; i < entries.size(); i++)
+      if(entries[i].bounds.contains(p)) {
+	entry_idx = i;
+	return true;
+      }
+    return false;
+  }
+
+  template <int N, typename T>
+  void SparsityMapPublicImpl<N,T>::find_overlapping_entries(const Rect<N,T>& r,
+							    std::vector<size_t>& overlaps,
+							    size_t max_results /*= 0*/)
+  {
+    const std::vector<SparsityMapEntry<N,T> >& entries = get_entries();
+    if(r.empty())
+      return;
+
+    if(N == 1) {
+      size_t lo = 0;
+      size_t hi = entries.size();
+      while(lo < hi) {
+	size_t mid = (lo + hi) >> 1;
+	if(entries[mid].bounds.hi[0] < r.lo[0])
+	  lo = mid + 1;
+	else
+	  hi = mid;
+      }
+      size_t found = 0;
+      for(size_t i = lo; i < entries.size(); i++) {
+	if(entries[i].bounds.lo[0] > r.hi[0])
+	  break;
+	overlaps.push_back(i);
+	if(++found == max_results)
+	  break;
+      }
+      return;
+    }
+
+    const SparsityMapEntryIndex<N,T> *index = static_cast<SparsityMapImpl<N,T> *>(this)->get_entry_index();
+    if(index) {
+      index->find_overlapping_entries(r, overlaps, max_results);
+      return;
+    }
+
+    size_t found = 0;
+    for(size_t i = 0; i < entries.size(); i++)
+      if(entries[i].bounds.overlaps(r)) {
+	overlaps.push_back(i);
+	if(++found == max_results)
+	  break;
+      }
+  }
+
+  template <int N, typename T>
+  bool SparsityMapPublicImpl<N,T>::entries_overlap(const Rect<N,T>& r)
+  {
+    const std::vector<SparsityMapEntry<N,T> >& entries = get_entries();
+    std::vector<size_t> overlaps;
+    find_overlapping_entries(r, overlaps);
+    for(std::vector<size_t>::const_iterator it = overlaps.begin();
+	it != overlaps.end();
+	++it) {
+      const SparsityMapEntry<N,T>& e = entries[*it];
+      if(e.sparsity.exists()) {
+	assert(0);
+      } else if(e.bitmap != 0) {
+	if(e.bitmap->any_bits(r))
+	  return true;
+      } else
+	return true;
+    }
+    return false;
+  }
+
   // membership test between two (presumably-different) sparsity maps are not
   //  cheap - try bounds-based checks first (see IndexSpace::overlaps)
   template <int N, typename T>
@@ -199,22 +547,29 @@ namespace Realm {
 	}
       }
     } else {
+      // walk the entries of one map that are in bounds, and use the other
+      //  map's spatial queries to look for overlaps
+      std::vector<size_t> idxs1;
+      find_overlapping_entries(bounds, idxs1);
       const std::vector<SparsityMapEntry<N,T> >& entries1 = get_entries();
-      const std::vector<SparsityMapEntry<N,T> >& entries2 = other->get_entries();
-      for(typename std::vector<SparsityMapEntry<N,T> >::const_iterator it1 = entries1.begin();
-	  it1 != entries1.end();
-	  it1++) {
-	Rect<N,T> isect = it1->bounds.intersection(bounds);
-	if(isect.empty())
-	  continue;
-	for(typename std::vector<SparsityMapEntry<N,T> >::const_iterator it2 = entries2.begin();
-	    it2 != entries2.end();
-	    it2++) {
-	  if(!it2->bounds.overlaps(isect)) continue;
-	  // TODO: handle further sparsity in either side
-	  assert(!it1->sparsity.exists() && (it1->bitmap == 0) &&
-		 !it2->sparsity.exists() && (it2->bitmap == 0));
-	  return true;
+      for(std::vector<size_t>::const_iterator it1 = idxs1.begin();
+	  it1 != idxs1.end();
+	  ++it1) {
+	const SparsityMapEntry<N,T>& e1 = entries1[*it1];
+	Rect<N,T> isect = e1.bounds.intersection(bounds);
+	// TODO: handle further sparsity
+	assert(!e1.sparsity.exists());
+	if(e1.bitmap != 0) {
+	  // test each run of the bitmap separately
+	  Rect<N,T> run;
+	  for(bool ok = e1.bitmap->first_run(isect, run);
+	      ok;
+	      ok = e1.bitmap->next_run(isect, run))
+	    if(other->entries_overlap(run))
+	      return true;
+	} else {
+	  if(other->entries_overlap(isect))
+	    return true;
 	}
       }
     }
@@ -372,8 +727,10 @@ namespace Realm {
     //  the given bounds
     std::vector<size_t> in_bounds;
     in_bounds.reserve(entries.size());
+    // a bitmap entry is covered by its bounds, although the overhead of
+    //  doing so isn't accounted for below
     for(size_t i = 0; i < entries.size(); i++) {
-      assert(!entries[i].sparsity.exists() && (entries[i].bitmap == 0));
+      assert(!entries[i].sparsity.exists());
       if(bounds.overlaps(entries[i].bounds))
 	in_bounds.push_back(i);
     }
@@ -662,6 +1019,140 @@ namespace Realm {
   }
 
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class SparsityMapEntryIndex<N,T>
+
+  template <int N, typename T>
+  SparsityMapEntryIndex<N,T>::SparsityMapEntryIndex(const std::vector<SparsityMapEntry<N,T> >& _entries)
+    : entries(_entries)
+  {
+    assert(!entries.empty());
+    order.resize(entries.size());
+    for(size_t i = 0; i < entries.size(); i++)
+      order[i] = i;
+    // a binary tree with leaves of at least LEAF_SIZE/2 entries
+    nodes.reserve(2 * ((entries.size() * 2 / LEAF_SIZE) + 1));
+    build(0, entries.size());
+  }
+
+  template <int N, typename T>
+  class EntryLoComparator {
+  public:
+    EntryLoComparator(const std::vector<SparsityMapEntry<N,T> >& _entries,
+		      int _dim)
+      : entries(_entries), dim(_dim) {}
+    bool operator()(size_t a, size_t b) const
+    {
+      return (entries[a].bounds.lo[dim] < entries[b].bounds.lo[dim]);
+    }
+  protected:
+    const std::vector<SparsityMapEntry<N,T> >& entries;
+    int dim;
+  };
+
+  template <int N, typename T>
+  size_t SparsityMapEntryIndex<N,T>::build(size_t lo, size_t hi)
+  {
+    size_t node_idx = nodes.size();
+    nodes.resize(node_idx + 1);
+
+    Rect<N,T> bounds = entries[order[lo]].bounds;
+    for(size_t i = lo + 1; i < hi; i++)
+      bounds = bounds.union_bbox(entries[order[i]].bounds);
+    nodes[node_idx].bounds = bounds;
+
+    if((hi - lo) <= LEAF_SIZE) {
+      nodes[node_idx].first = lo;
+      nodes[node_idx].count = hi - lo;
+      return node_idx;
+    }
+
+    // split at the median along the dimension in which the entries are
+    //  most spread out (measured in doubles to avoid overflow)
+    int split_dim = 0;
+    double best_extent = -1;
+    for(int d = 0; d < N; d++) {
+      T min_lo = entries[order[lo]].bounds.lo[d];
+      T max_lo = min_lo;
+      for(size_t i = lo + 1; i < hi; i++) {
+	T v = entries[order[i]].bounds.lo[d];
+	if(v < min_lo) min_lo = v;
+	if(v > max_lo) max_lo = v;
+      }
+      double extent = double(max_lo) - double(min_lo);
+      if(extent > best_extent) {
+	best_extent = extent;
+	split_dim = d;
+      }
+    }
+    size_t mid = lo + ((hi - lo) >> 1);
+    std::nth_element(order.begin() + lo, order.begin() + mid,
+		     order.begin() + hi,
+		     EntryLoComparator<N,T>(entries, split_dim));
+
+    build(lo, mid);  // left child is always node_idx + 1
+    size_t right = build(mid, hi);
+    nodes[node_idx].first = right;
+    nodes[node_idx].count = 0;
+    return node_idx;
+  }
+
+  template <int N, typename T>
+  bool SparsityMapEntryIndex<N,T>::find_entry(const Point<N,T>& p,
+					      size_t& entry_idx) const
+  {
+    // tree depth is logarithmic in the number of entries, so a fixed-size
+    //  stack is plenty
+    size_t stack[64];
+    size_t depth = 0;
+    stack[depth++] = 0;
+    while(depth > 0) {
+      const Node& n = nodes[stack[--depth]];
+      if(!n.bounds.contains(p)) continue;
+      if(n.count > 0) {
+	for(size_t i = n.first; i < n.first + n.count; i++)
+	  if(entries[order[i]].bounds.contains(p)) {
+	    entry_idx = order[i];
+	    return true;
+	  }
+      } else {
+	assert((depth + 2) <= 64);
+	stack[depth++] = n.first;
+	stack[depth++] = (&n - &nodes[0]) + 1;
+      }
+    }
+    return false;
+  }
+
+  template <int N, typename T>
+  void SparsityMapEntryIndex<N,T>::find_overlapping_entries(const Rect<N,T>& r,
+							    std::vector<size_t>& overlaps,
+							    size_t max_results) const
+  {
+    size_t stack[64];
+    size_t depth = 0;
+    size_t found = 0;
+    stack[depth++] = 0;
+    while(depth > 0) {
+      const Node& n = nodes[stack[--depth]];
+      if(!n.bounds.overlaps(r)) continue;
+      if(n.count > 0) {
+	for(size_t i = n.first; i < n.first + n.count; i++)
+	  if(entries[order[i]].bounds.overlaps(r)) {
+	    overlaps.push_back(order[i]);
+	    if(++found == max_results)
+	      return;
+	  }
+      } else {
+	assert((depth + 2) <= 64);
+	stack[depth++] = n.first;
+	stack[depth++] = (&n - &nodes[0]) + 1;
+      }
+    }
+  }
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class SparsityMapImpl<N,T>
@@ -674,8 +1165,42 @@ namespace Realm {
     , precise_requested(false), approx_requested(false)
     , precise_ready_event(Event::NO_EVENT), approx_ready_event(Event::NO_EVENT)
     , sizeof_precise(0)
+    , entry_index(0)
   {}
 
+  template <int N, typename T>
+  SparsityMapImpl<N,T>::~SparsityMapImpl(void)
+  {
+    delete entry_index.load();
+    for(typename std::vector<SparsityMapEntry<N,T> >::iterator it = this->entries.begin();
+	it != this->entries.end();
+	++it)
+      delete it->bitmap;
+    for(typename std::vector<SparsityMapEntry<N,T> >::iterator it = remote_bitmaps.begin();
+	it != remote_bitmaps.end();
+	++it)
+      delete it->bitmap;
+  }
+
+  template <int N, typename T>
+  const SparsityMapEntryIndex<N,T> *SparsityMapImpl<N,T>::get_entry_index(void)
+  {
+    SparsityMapEntryIndex<N,T> *index = entry_index.load_acquire();
+    if(index != 0)
+      return index;
+
+    if(this->entries.size() < SparsityMapEntryIndex<N,T>::MIN_ENTRIES)
+      return 0;
+
+    // entries are immutable once valid, so concurrent builders will make
+    //  identical indices - first one to get installed wins
+    SparsityMapEntryIndex<N,T> *new_index = new SparsityMapEntryIndex<N,T>(this->entries);
+    if(entry_index.compare_exchange(index, new_index))
+      return new_index;
+    delete new_index;
+    return index;
+  }
+
   template <int N, typename T>
   inline /*static*/ SparsityMapImpl<N,T> *SparsityMapImpl<N,T>::lookup(SparsityMap<N,T> sparsity)
   {
@@ -1144,12 +1669,12 @@ namespace Realm {
       
       // scan the entry list, sending bitmaps first and making a list of rects
       std::vector<Rect<N,T> > rects;
+      size_t num_pieces = 0;
       for(typename std::vector<SparsityMapEntry<N,T> >::const_iterator it = this->entries.begin();
 	  it != this->entries.end();
 	  it++) {
 	if(it->bitmap) {
-	  // TODO: send bitmap
-	  assert(0);
+	  num_pieces += send_bitmap(requestor, *(it->bitmap));
 	}
 	else if(it->sparsity.exists()) {
 	  // TODO: ?
@@ -1162,7 +1687,6 @@ namespace Realm {
       const Rect<N,T> *rdata = &rects[0];
       size_t remaining = rects.size();
       const size_t max_to_send = DeppartConfig::cfg_max_bytes_per_packet / sizeof(Rect<N,T>);
-      size_t num_pieces = 0;
       // send partial messages first
       while(remaining > max_to_send) {
 	size_t bytes = max_to_send * sizeof(Rect<N,T>);
@@ -1187,6 +1711,95 @@ namespace Realm {
     }
   }
   
+  // a bitmap is sent as one or more pieces, each covering a range of
+  //  whole words (N=1) or a slab along the slowest-varying dimension
+  //  (N>1), so that each piece's words are contiguous in the original
+  //  bitmap - returns the number of messages sent
+  template <int N, typename T>
+  size_t SparsityMapImpl<N,T>::send_bitmap(NodeID requestor,
+					   const HierarchicalBitMap<N,T>& bitmap)
+  {
+    const Rect<N,T>& bounds = bitmap.get_bounds();
+    const uint64_t *words = bitmap.get_words();
+    const size_t max_words = std::max(DeppartConfig::cfg_max_bytes_per_packet / sizeof(uint64_t),
+				      size_t(1));
+    size_t num_pieces = 0;
+
+    if(N == 1) {
+      size_t first_word = 0;
+      Rect<N,T> piece = bounds;
+      while(true) {
+	size_t count = std::min(max_words, bitmap.num_words() - first_word);
+	piece.lo[0] = bounds.lo[0] + T(first_word << 6);
+	if((bitmap.num_words() - first_word) > count)
+	  piece.hi[0] = piece.lo[0] + T((count << 6) - 1);
+	else
+	  piece.hi[0] = bounds.hi[0];
+	if(bitmap.any_bits(piece)) {
+	  size_t bytes = count * sizeof(uint64_t);
+	  ActiveMessage<RemoteSparsityBitmap> amsg(requestor, bytes);
+	  amsg->sparsity = me;
+	  amsg->bounds = piece;
+	  amsg.add_payload(words + first_word, bytes, PAYLOAD_COPY);
+	  amsg.commit();
+	  num_pieces++;
+	}
+	first_word += count;
+	if(first_word >= bitmap.num_words()) break;
+      }
+    } else {
+      // number of words in one slice along dimension N-1
+      size_t slice_words = bitmap.words_per_row();
+      for(int i = 1; i < (N - 1); i++)
+	slice_words *= size_t(bounds.hi[i] - bounds.lo[i] + 1);
+      size_t slices_per_piece = std::max(max_words / slice_words, size_t(1));
+      Rect<N,T> piece = bounds;
+      piece.lo[N - 1] = bounds.lo[N - 1];
+      while(true) {
+	size_t slices_left = size_t(bounds.hi[N - 1] - piece.lo[N - 1]) + 1;
+	size_t count = std::min(slices_per_piece, slices_left);
+	piece.hi[N - 1] = piece.lo[N - 1] + T(count - 1);
+	if(bitmap.any_bits(piece)) {
+	  size_t bytes = count * slice_words * sizeof(uint64_t);
+	  ActiveMessage<RemoteSparsityBitmap> amsg(requestor, bytes);
+	  amsg->sparsity = me;
+	  amsg->bounds = piece;
+	  amsg.add_payload(words + (bitmap.row_index(piece.lo) *
+				    bitmap.words_per_row()),
+			   bytes, PAYLOAD_COPY);
+	  amsg.commit();
+	  num_pieces++;
+	}
+	if(count == slices_left) break;
+	piece.lo[N - 1] = piece.hi[N - 1] + 1;
+      }
+    }
+
+    return num_pieces;
+  }
+
+  // bitmaps from the owner are held aside until all pieces have arrived,
+  //  since the merging of incoming rectangles only knows about dense entries
+  template <int N, typename T>
+  void SparsityMapImpl<N,T>::contribute_bitmap(const Rect<N,T>& bounds,
+					       const uint64_t *words,
+					       size_t num_words)
+  {
+    HierarchicalBitMap<N,T> *bitmap = new HierarchicalBitMap<N,T>(bounds, words);
+    assert(bitmap->num_words() == num_words);
+    {
+      AutoLock<> al(mutex);
+      SparsityMapEntry<N,T> e;
+      e.bounds = bounds;
+      e.sparsity.id = 0; // no sparsity map
+      e.bitmap = bitmap;
+      remote_bitmaps.push_back(e);
+    }
+
+    // a bitmap is never the last piece of a contribution
+    contribute_raw_rects(0, 0, 0);
+  }
+
   template <int N, typename T>
   static inline bool non_overlapping_bounds_1d_comp(const SparsityMapEntry<N,T>& lhs,
 						    const SparsityMapEntry<N,T>& rhs)
@@ -1268,6 +1881,190 @@ namespace Realm {
     // std::cout << " ]]]\n";
   }
 
+  // sparsity maps made of many tiny rectangles are much more compact (and
+  //  faster to iterate over) as bitmaps - a group of dense entries is
+  //  replaced by one bitmap entry covering their bounding box when the
+  //  bitmap needs no more than half the storage of the entries it replaces
+  static const size_t BITMAP_MIN_ENTRIES = 16;
+
+  template <int N, typename T>
+  static bool bitmap_is_worthwhile(const Rect<N,T>& bbox, size_t count)
+  {
+    return ((count >= BITMAP_MIN_ENTRIES) &&
+	    (bbox.volume() <= DeppartConfig::cfg_bitmap_max_points) &&
+	    ((2 * HierarchicalBitMap<N,T>::storage_bytes(bbox)) <=
+	     (count * sizeof(SparsityMapEntry<N,T>))));
+  }
+
+  template <int N, typename T>
+  static SparsityMapEntry<N,T> make_bitmap_entry(const std::vector<SparsityMapEntry<N,T> >& entries,
+						 const std::vector<size_t>& idxs,
+						 const Rect<N,T>& bbox)
+  {
+    SparsityMapEntry<N,T> e;
+    e.bounds = bbox;
+    e.sparsity.id = 0; // no sparsity map
+    e.bitmap = new HierarchicalBitMap<N,T>(bbox);
+    for(std::vector<size_t>::const_iterator it = idxs.begin();
+	it != idxs.end();
+	++it)
+      e.bitmap->set_rect(entries[*it].bounds);
+    return e;
+  }
+
+  template <typename T>
+  static T floor_div(T v, T d)
+  {
+    T q = v / d;
+    if((q * d) > v)
+      q--;
+    return q;
+  }
+
+  template <int N, typename T>
+  class TileCompare {
+  public:
+    bool operator()(const Point<N,T>& a, const Point<N,T>& b) const
+    {
+      for(int i = 0; i < N; i++)
+	if(a[i] != b[i])
+	  return (a[i] < b[i]);
+      return false;
+    }
+  };
+
+  // for N > 1, dense entries are grouped by the (aligned) tile of
+  //  cfg_bitmap_max_points points that contains them - a group can only be
+  //  converted if no other entry overlaps its bounding box
+  template <int N, typename T>
+  static void convert_to_bitmaps(std::vector<SparsityMapEntry<N,T> >& entries)
+  {
+    size_t max_points = DeppartConfig::cfg_bitmap_max_points;
+    if((max_points == 0) || (entries.size() < BITMAP_MIN_ENTRIES))
+      return;
+
+    // tiles are long in dimension 0 so that bitmap rows fill whole words
+    int log2_points = 0;
+    while((size_t(2) << log2_points) <= max_points)
+      log2_points++;
+    T tile_size[N];
+    for(int i = 0; i < N; i++) {
+      int bits = (log2_points / N) + ((i == 0) ? (log2_points % N) : 0);
+      tile_size[i] = T(1) << bits;
+    }
+
+    typedef std::map<Point<N,T>, std::vector<size_t>, TileCompare<N,T> > TileMap;
+    TileMap tiles;
+    std::vector<SparsityMapEntry<N,T> > others;
+    for(size_t i = 0; i < entries.size(); i++) {
+      const SparsityMapEntry<N,T>& e = entries[i];
+      bool single_tile = (!e.sparsity.exists() && (e.bitmap == 0));
+      Point<N,T> tile;
+      for(int j = 0; (j < N) && single_tile; j++) {
+	tile[j] = floor_div(e.bounds.lo[j], tile_size[j]);
+	single_tile = (tile[j] == floor_div(e.bounds.hi[j], tile_size[j]));
+      }
+      if(single_tile)
+	tiles[tile].push_back(i);
+      else
+	others.push_back(e);
+    }
+
+    // entries that span tiles might overlap a group's bounding box
+    SparsityMapEntryIndex<N,T> *others_index = 0;
+    if(others.size() >= SparsityMapEntryIndex<N,T>::MIN_ENTRIES)
+      others_index = new SparsityMapEntryIndex<N,T>(others);
+
+    std::vector<SparsityMapEntry<N,T> > result;
+    std::vector<bool> converted(entries.size(), false);
+    size_t num_converted = 0;
+    std::vector<size_t> overlaps;
+    for(typename TileMap::const_iterator it = tiles.begin();
+	it != tiles.end();
+	++it) {
+      const std::vector<size_t>& idxs = it->second;
+      if(idxs.size() < BITMAP_MIN_ENTRIES) continue;
+      Rect<N,T> bbox = entries[idxs[0]].bounds;
+      for(size_t i = 1; i < idxs.size(); i++)
+	bbox = bbox.union_bbox(entries[idxs[i]].bounds);
+      if(!bitmap_is_worthwhile(bbox, idxs.size())) continue;
+      bool blocked = false;
+      if(others_index) {
+	overlaps.clear();
+	others_index->find_overlapping_entries(bbox, overlaps, 1);
+	blocked = !overlaps.empty();
+      } else {
+	for(size_t i = 0; (i < others.size()) && !blocked; i++)
+	  blocked = others[i].bounds.overlaps(bbox);
+      }
+      if(blocked) continue;
+
+      result.push_back(make_bitmap_entry(entries, idxs, bbox));
+      for(size_t i = 0; i < idxs.size(); i++)
+	converted[idxs[i]] = true;
+      num_converted += idxs.size();
+    }
+    delete others_index;
+
+    if(num_converted == 0)
+      return;
+
+    for(size_t i = 0; i < entries.size(); i++)
+      if(!converted[i])
+	result.push_back(entries[i]);
+    log_part.info() << "converted " << num_converted << " of "
+		    << entries.size() << " entries to bitmaps: new count="
+		    << result.size();
+    entries.swap(result);
+  }
+
+  // in 1-D, the entries are sorted, so runs of consecutive entries make
+  //  good groups, and the result stays sorted
+  template <typename T>
+  static void convert_to_bitmaps(std::vector<SparsityMapEntry<1,T> >& entries)
+  {
+    size_t max_points = DeppartConfig::cfg_bitmap_max_points;
+    size_t n = entries.size();
+    if((max_points == 0) || (n < BITMAP_MIN_ENTRIES))
+      return;
+
+    std::vector<SparsityMapEntry<1,T> > result;
+    std::vector<size_t> idxs;
+    size_t num_converted = 0;
+    size_t i = 0;
+    while(i < n) {
+      // gather consecutive dense entries that fit in one bitmap
+      size_t j = i;
+      while((j < n) &&
+	    !entries[j].sparsity.exists() && (entries[j].bitmap == 0) &&
+	    (size_t(entries[j].bounds.hi.x - entries[i].bounds.lo.x) < max_points))
+	j++;
+      if(j > i) {
+	Rect<1,T> bbox(entries[i].bounds.lo, entries[j - 1].bounds.hi);
+	if(bitmap_is_worthwhile(bbox, j - i)) {
+	  idxs.clear();
+	  for(size_t k = i; k < j; k++)
+	    idxs.push_back(k);
+	  result.push_back(make_bitmap_entry(entries, idxs, bbox));
+	  num_converted += j - i;
+	  i = j;
+	  continue;
+	}
+      } else
+	j = i + 1;
+      for(size_t k = i; k < j; k++)
+	result.push_back(entries[k]);
+      i = j;
+    }
+
+    if(num_converted == 0)
+      return;
+
+    log_part.info() << "converted " << num_converted << " of " << n
+		    << " entries to bitmaps: new count=" << result.size();
+    entries.swap(result);
+  }
+
   template <int N, typename T>
   void SparsityMapImpl<N,T>::finalize(void)
   {
@@ -1283,14 +2080,27 @@ namespace Realm {
       }
     }
 
+    // bitmaps received from the owner can join the other entries now
+    if(!remote_bitmaps.empty()) {
+      this->entries.insert(this->entries.end(),
+			   remote_bitmaps.begin(), remote_bitmaps.end());
+      remote_bitmaps.clear();
+    }
+
     // first step is to organize the data a little better - for N=1, this means sorting
     //  the entries list
     if(N == 1) {
       std::sort(this->entries.begin(), this->entries.end(), non_overlapping_bounds_1d_comp<N,T>);
+      // (pieces of a remote bitmap may abut each other)
       for(size_t i = 1; i < this->entries.size(); i++)
-	assert(this->entries[i-1].bounds.hi.x < (this->entries[i].bounds.lo.x - 1));
+	assert((this->entries[i-1].bounds.hi.x < (this->entries[i].bounds.lo.x - 1)) ||
+	       ((this->entries[i-1].bounds.hi.x < this->entries[i].bounds.lo.x) &&
+		(this->entries[i-1].bitmap != 0) && (this->entries[i].bitmap != 0)));
     }
 
+    // sparse collections of tiny rectangles are better off as bitmaps
+    convert_to_bitmaps(this->entries);
+
     // now that we've got our entries nice and tidy, build a bounded approximation of them
     if(true /*ID(me).sparsity_creator_node() == Network::my_node_id*/) {
       assert(!this->approx_valid);
@@ -1372,6 +2182,8 @@ namespace Realm {
   /*static*/ ActiveMessageHandlerReg<typename SparsityMapImpl<N,T>::RemoteSparsityContrib> SparsityMapImpl<N,T>::remote_sparsity_contrib_reg;
   template <int N, typename T>
   /*static*/ ActiveMessageHandlerReg<typename SparsityMapImpl<N,T>::SetContribCountMessage> SparsityMapImpl<N,T>::set_contrib_count_msg_reg;
+  template <int N, typename T>
+  /*static*/ ActiveMessageHandlerReg<typename SparsityMapImpl<N,T>::RemoteSparsityBitmap> SparsityMapImpl<N,T>::remote_sparsity_bitmap_reg;
 
 
   ////////////////////////////////////////////////////////////////////////
@@ -1408,6 +2220,23 @@ namespace Realm {
   }
 
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class SparsityMapImpl<N,T>::RemoteSparsityBitmap
+
+  template <int N, typename T>
+  inline /*static*/ void SparsityMapImpl<N,T>::RemoteSparsityBitmap::handle_message(NodeID sender,
+										    const SparsityMapImpl<N,T>::RemoteSparsityBitmap &msg,
+										    const void *data, size_t datalen)
+  {
+    log_part.info() << "received remote bitmap: sparsity=" << msg.sparsity << " bounds=" << msg.bounds << " len=" << datalen;
+    assert((datalen % sizeof(uint64_t)) == 0);
+    SparsityMapImpl<N,T>::lookup(msg.sparsity)->contribute_bitmap(msg.bounds,
+								  (const uint64_t *)data,
+								  datalen / sizeof(uint64_t));
+  }
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class SparsityMapImpl<N,T>::SetContribCountMessage
@@ -1422,6 +2251,7 @@ namespace Realm {
   }
 
 #define DOIT(N,T) \
+  template class HierarchicalBitMap<N,T>; \
   template class SparsityMapPublicImpl<N,T>; \
   template class SparsityMapImpl<N,T>; \
   template class SparsityMap<N,T>;
@@ -30,10 +30,45 @@ namespace Realm {
 
   class PartitioningMicroOp;
 
+  // a bounding volume hierarchy over the (disjoint) bounds of a sparsity
+  //  map's entries - used to answer point and rectangle queries on large
+  //  multi-dimensional maps without scanning every entry
+  template <int N, typename T>
+  class SparsityMapEntryIndex {
+  public:
+    // maps with fewer entries than this are just scanned
+    static const size_t MIN_ENTRIES = 64;
+    static const size_t LEAF_SIZE = 8;
+
+    SparsityMapEntryIndex(const std::vector<SparsityMapEntry<N,T> >& _entries);
+
+    bool find_entry(const Point<N,T>& p, size_t& entry_idx) const;
+    void find_overlapping_entries(const Rect<N,T>& r,
+				  std::vector<size_t>& overlaps,
+				  size_t max_results) const;
+
+  protected:
+    // returns the index of the new node
+    size_t build(size_t lo, size_t hi);
+
+    // the left child of an internal node immediately follows it, so only
+    //  the right child is recorded - leaves cover order[first, first+count)
+    struct Node {
+      Rect<N,T> bounds;
+      size_t first;  // order index for leaves, right child for internal nodes
+      size_t count;  // 0 for internal nodes
+    };
+
+    const std::vector<SparsityMapEntry<N,T> >& entries;
+    std::vector<Node> nodes;
+    std::vector<size_t> order;
+  };
+
   template <int N, typename T>
   class SparsityMapImpl : public SparsityMapPublicImpl<N,T> {
   public:
     SparsityMapImpl(SparsityMap<N,T> _me);
+    ~SparsityMapImpl(void);
 
     // actual implementation - SparsityMapPublicImpl's version just calls this one
     Event make_valid(bool precise = true);
@@ -61,6 +96,10 @@ namespace Realm {
     void remote_data_request(NodeID requestor, bool send_precise, bool send_approx);
     void remote_data_reply(NodeID requestor, bool send_precise, bool send_approx);
 
+    // returns the spatial index for the precise entries, building it on
+    //  first use - returns null if the map is too small to need one
+    const SparsityMapEntryIndex<N,T> *get_entry_index(void);
+
     SparsityMap<N,T> me;
 
     struct RemoteSparsityRequest {
@@ -82,6 +121,16 @@ namespace Realm {
 				 const void *data, size_t datalen);
     };
 
+    // one piece of a bitmap entry - the payload is the bitmap's words
+    struct RemoteSparsityBitmap {
+      SparsityMap<N,T> sparsity;
+      Rect<N,T> bounds;
+
+      static void handle_message(NodeID sender,
+				 const RemoteSparsityBitmap &msg,
+				 const void *data, size_t datalen);
+    };
+
     struct SetContribCountMessage {
       SparsityMap<N,T> sparsity;
       size_t count;
@@ -94,9 +143,14 @@ namespace Realm {
   protected:
     void finalize(void);
 
+    size_t send_bitmap(NodeID requestor, const HierarchicalBitMap<N,T>& bitmap);
+    void contribute_bitmap(const Rect<N,T>& bounds,
+			   const uint64_t *words, size_t num_words);
+
     static ActiveMessageHandlerReg<RemoteSparsityRequest> remote_sparsity_request_reg;
     static ActiveMessageHandlerReg<RemoteSparsityContrib> remote_sparsity_contrib_reg;
     static ActiveMessageHandlerReg<SetContribCountMessage> set_contrib_count_msg_reg;
+    static ActiveMessageHandlerReg<RemoteSparsityBitmap> remote_sparsity_bitmap_reg;
 
     atomic<int> remaining_contributor_count;
     atomic<int> total_piece_count, remaining_piece_count;
@@ -107,6 +161,8 @@ namespace Realm {
     NodeSet remote_precise_waiters, remote_approx_waiters;
     NodeSet remote_sharers;
     size_t sizeof_precise;
+    std::vector<SparsityMapEntry<N,T> > remote_bitmaps;
+    atomic<SparsityMapEntryIndex<N,T> *> entry_index;
   };
 
   // we need a type-erased wrapper to store in the runtime's lookup table
@@ -124,8 +124,13 @@ namespace Realm {
 
       static const Barrier NO_BARRIER;
 
+      // if 'combine_arrivals' is set, arrivals made on other nodes are merged
+      //  locally and combined up a tree of nodes (see -ll:barrier_arity)
+      //  rather than each being sent to the barrier's owner - this requires
+      //  a foldable reduction op if 'redop_id' is non-zero
       static Barrier create_barrier(unsigned expected_arrivals, ReductionOpID redop_id = 0,
-				    const void *initial_value = 0, size_t initial_value_size = 0);
+				    const void *initial_value = 0, size_t initial_value_size = 0,
+				    bool combine_arrivals = false);
       void destroy_barrier(void);
 
       static const ::realm_event_gen_t MAX_PHASES;
@@ -370,6 +370,15 @@ namespace Realm {
     // if non-zero, eagerly checks deferred user event triggers for loops up to the
     //  specified limit
     int event_loop_detection_limit = 0;
+
+    // if non-zero, updates for events with more remote subscribers than this
+    //  are sent through a tree of the subscribers with this many children
+    //  per node rather than directly from the owner
+    int event_fanout_arity = 0;
+
+    // number of children per node in the tree used to combine arrivals
+    //  for barriers created with arrival combining enabled
+    int barrier_combine_arity = 4;
   };
 
   void UserEvent::trigger(Event wait_on, bool ignore_faults) const
@@ -450,11 +459,14 @@ namespace Realm {
   /*static*/ Barrier Barrier::create_barrier(unsigned expected_arrivals,
 					     ReductionOpID redop_id /*= 0*/,
 					     const void *initial_value /*= 0*/,
-					     size_t initial_value_size /*= 0*/)
+					     size_t initial_value_size /*= 0*/,
+					     bool combine_arrivals /*= false*/)
   {
     DetailedTimer::ScopedPush sp(TIME_LOW_LEVEL);
 
-    BarrierImpl *impl = BarrierImpl::create_barrier(expected_arrivals, redop_id, initial_value, initial_value_size);
+    BarrierImpl *impl = BarrierImpl::create_barrier(expected_arrivals, redop_id,
+						    initial_value, initial_value_size,
+						    combine_arrivals);
     Barrier b = impl->current_barrier();
 
 #ifdef EVENT_GRAPH_TRACE
@@ -668,6 +680,43 @@ namespace Realm {
   /*static*/ REALM_THREAD_LOCAL EventWaiter::EventWaiterList *EventTriggerNotifier::nested_poisoned = 0;
 
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class BarrierArrivalCombiner
+  //
+
+  BarrierArrivalCombiner::BarrierArrivalCombiner()
+    : BackgroundWorkItem("barrier combining")
+  {}
+
+  void BarrierArrivalCombiner::enqueue_barrier(BarrierImpl *barrier)
+  {
+    bool was_empty;
+    {
+      AutoLock<> al(mutex);
+      was_empty = pending.empty();
+      pending.push_back(barrier);
+    }
+    if(was_empty)
+      make_active();
+  }
+
+  void BarrierArrivalCombiner::do_work(TimeLimit work_until)
+  {
+    std::vector<BarrierImpl *> todo;
+    {
+      AutoLock<> al(mutex);
+      todo.swap(pending);
+    }
+
+    // sending is cheap, so don't bother checking the time limit
+    for(std::vector<BarrierImpl *>::const_iterator it = todo.begin();
+	it != todo.end();
+	++it)
+      (*it)->flush_combined_arrivals();
+  }
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class EventImpl
@@ -1481,6 +1530,7 @@ namespace Realm {
 	int npg_cached = impl->num_poisoned_generations.load_acquire();
 	ActiveMessage<EventUpdateMessage> amsg(sender, npg_cached*sizeof(EventImpl::gen_t));
 	amsg->event = triggered;
+	amsg->forward_count = 0;
 	amsg.add_payload(impl->poisoned_generations, npg_cached*sizeof(EventImpl::gen_t), PAYLOAD_KEEP);
 	amsg.commit();
       }
@@ -1627,12 +1677,24 @@ namespace Realm {
 						       const void *data, size_t datalen,
 						       TimeLimit work_until)
     {
+      size_t forward_bytes = args.forward_count * sizeof(NodeID);
+      assert(forward_bytes <= datalen);
       const EventImpl::gen_t *new_poisoned_gens = (const EventImpl::gen_t *)data;
-      int new_poisoned_count = datalen / sizeof(EventImpl::gen_t);
-      assert((new_poisoned_count * sizeof(EventImpl::gen_t)) == datalen);  // no remainders or overflow please
+      int new_poisoned_count = (datalen - forward_bytes) / sizeof(EventImpl::gen_t);
+      assert((new_poisoned_count * sizeof(EventImpl::gen_t) + forward_bytes) == datalen);  // no remainders or overflow please
 
       log_event.debug() << "event update: event=" << args.event
-			<< " poisoned=" << ArrayOstreamHelper<EventImpl::gen_t>(new_poisoned_gens, new_poisoned_count);
+			<< " poisoned=" << ArrayOstreamHelper<EventImpl::gen_t>(new_poisoned_gens, new_poisoned_count)
+			<< " forward=" << args.forward_count;
+
+      // pass the update on to our subtree before processing it locally so
+      //  that the forwarding isn't delayed by local waiters
+      if(args.forward_count > 0) {
+	const NodeID *subtree = (const NodeID *)(((const char *)data) +
+						 (datalen - forward_bytes));
+	broadcast(args.event, new_poisoned_gens, new_poisoned_count,
+		  subtree, args.forward_count);
+      }
 
       GenEventImpl *impl = get_runtime()->get_genevent_impl(args.event);
       impl->process_update(ID(args.event).event_generation(),
@@ -1640,6 +1702,50 @@ namespace Realm {
 			   work_until);
     }
 
+    /*static*/ void EventUpdateMessage::broadcast(Event event,
+						  const EventImpl::gen_t *poisoned_gens,
+						  int poisoned_count,
+						  const NodeID *targets, size_t num_targets)
+    {
+      size_t poisoned_bytes = poisoned_count * sizeof(EventImpl::gen_t);
+      size_t arity = ((Config::event_fanout_arity > 0) ?
+		        Config::event_fanout_arity : 0);
+
+      // small enough (or no tree requested) - one multicast to everybody
+      if((arity == 0) || (num_targets <= arity)) {
+	NodeSet to_update;
+	for(size_t i = 0; i < num_targets; i++)
+	  to_update.add(targets[i]);
+	ActiveMessage<EventUpdateMessage> amsg(to_update, poisoned_bytes);
+	amsg->event = event;
+	amsg->forward_count = 0;
+	if(poisoned_bytes > 0)
+	  amsg.add_payload(poisoned_gens, poisoned_bytes);
+	amsg.commit();
+	return;
+      }
+
+      // otherwise split the targets into 'arity' contiguous subtrees - the
+      //  first node of each is sent the update along with the rest of its
+      //  subtree, which it will split in turn
+      for(size_t i = 0; i < arity; i++) {
+	size_t lo = (i * num_targets) / arity;
+	size_t hi = ((i + 1) * num_targets) / arity;
+	assert(lo < hi);
+	unsigned count = hi - lo - 1;
+	size_t forward_bytes = count * sizeof(NodeID);
+	ActiveMessage<EventUpdateMessage> amsg(targets[lo],
+					       poisoned_bytes + forward_bytes);
+	amsg->event = event;
+	amsg->forward_count = count;
+	if(poisoned_bytes > 0)
+	  amsg.add_payload(poisoned_gens, poisoned_bytes);
+	if(count > 0)
+	  amsg.add_payload(targets + lo + 1, forward_bytes);
+	amsg.commit();
+      }
+    }
+
 
   /*static*/ atomic<Barrier::timestamp_t> BarrierImpl::barrier_adjustment_timestamp(0);
 
@@ -1844,11 +1950,21 @@ namespace Realm {
 	// any remote nodes to notify?
 	if(!to_update.empty()) {
 	  int npg_cached = num_poisoned_generations.load_acquire();
-	  ActiveMessage<EventUpdateMessage> amsg(to_update,
-						 poisoned_generations,
-						 npg_cached*sizeof(EventImpl::gen_t));
-	  amsg->event = make_event(update_gen);
-	  amsg.commit();
+	  if((Config::event_fanout_arity > 0) &&
+	     (to_update.size() > size_t(Config::event_fanout_arity))) {
+	    // enough subscribers that we'll let them help with the fan-out
+	    std::vector<NodeID> targets(to_update.begin(), to_update.end());
+	    EventUpdateMessage::broadcast(make_event(update_gen),
+					  poisoned_generations, npg_cached,
+					  targets.data(), targets.size());
+	  } else {
+	    ActiveMessage<EventUpdateMessage> amsg(to_update,
+						   poisoned_generations,
+						   npg_cached*sizeof(EventImpl::gen_t));
+	    amsg->event = make_event(update_gen);
+	    amsg->forward_count = 0;
+	    amsg.commit();
+	  }
 	}
 
 	// free event?
@@ -1970,7 +2086,8 @@ namespace Realm {
     /*static*/ BarrierImpl *BarrierImpl::create_barrier(unsigned expected_arrivals,
 							ReductionOpID redopid,
 							const void *initial_value /*= 0*/,
-							size_t initial_value_size /*= 0*/)
+							size_t initial_value_size /*= 0*/,
+							bool combine_arrivals /*= false*/)
     {
       BarrierImpl *impl = get_runtime()->local_barrier_free_list->alloc_entry();
       assert(impl);
@@ -2004,11 +2121,21 @@ namespace Realm {
 	impl->final_values = 0;
       }
 
+      // combined arrivals carry folded reduction values, so the reduction
+      //  op has to support folding
+      if(combine_arrivals && impl->redop && !impl->redop->is_foldable) {
+	log_barrier.warning() << "arrival combining disabled for barrier " << impl->me
+			      << ": reduction op " << redopid << " is not foldable";
+	combine_arrivals = false;
+      }
+      impl->combine_arrivals = combine_arrivals;
+
       // and let the barrier rearm as many times as necessary without being released
       //impl->free_generation = (unsigned)-1;
 
       log_barrier.info() << "barrier created: " << impl->me << "/" << impl->generation
-			 << " base_count=" << impl->base_arrival_count << " redop=" << redopid;
+			 << " base_count=" << impl->base_arrival_count << " redop=" << redopid
+			 << " combine=" << impl->combine_arrivals;
 #ifdef EVENT_TRACING
       {
 	EventTraceItem &item = Tracer<EventTraceItem>::trace_item();
@@ -2035,6 +2162,13 @@ namespace Realm {
       initial_value = 0;
       value_capacity = 0;
       final_values = 0;
+      combine_arrivals = false;
+      combine_flush_pending = false;
+      combine_parent_node = -1;
+      combine_nodes.clear();
+      combine_parents.clear();
+      combine_informed.clear();
+      combine_informed_gen = 0;
     }
 
     BarrierImpl::~BarrierImpl(void)
@@ -2060,6 +2194,13 @@ namespace Realm {
       initial_value = 0;
       value_capacity = 0;
       final_values = 0;
+      combine_arrivals = false;
+      combine_flush_pending = false;
+      combine_parent_node = -1;
+      combine_nodes.clear();
+      combine_parents.clear();
+      combine_informed.clear();
+      combine_informed_gen = 0;
     }
 
     /*static*/ void BarrierAdjustMessage::handle_message(NodeID sender, const BarrierAdjustMessage &args,
@@ -2071,9 +2212,28 @@ namespace Realm {
 			 << " (" << args.barrier.timestamp << ")";
       BarrierImpl *impl = get_runtime()->get_barrier_impl(args.barrier);
       EventImpl::gen_t gen = ID(args.barrier).barrier_generation();
+
+      // combined arrivals stop at each node on the way up to the owner
+      //  (barriers in combining mode never migrate, so the owner is stable)
+      if(args.combined && (impl->owner != Network::my_node_id)) {
+	impl->enable_combining(args.redop_id);
+	impl->combine_arrival(gen, args.delta, args.barrier.timestamp,
+			      data, datalen);
+	return;
+      }
+
       impl->adjust_arrival(gen, args.delta, args.barrier.timestamp, args.wait_on,
 			   args.sender, args.forwarded,
 			   datalen ? data : 0, datalen, work_until);
+
+      // let nodes that arrive know they can combine (and where to send their
+      //  arrivals) - this includes nodes that only learned about combining
+      //  from a child and so send combined arrivals straight here, but not
+      //  increments, which are never combined
+      if(impl->combine_arrivals && (args.delta < 0) &&
+	 (impl->owner == Network::my_node_id) &&
+	 (args.sender != Network::my_node_id))
+	impl->inform_combining(args.sender, gen, args.combined != 0);
     }
 
     /*static*/ void BarrierAdjustMessage::send_request(NodeID target, Barrier barrier, int delta, Event wait_on,
@@ -2086,10 +2246,38 @@ namespace Realm {
       amsg->wait_on = wait_on;
       amsg->sender = sender;
       amsg->forwarded = forwarded;
+      amsg->combined = 0;
+      amsg->redop_id = 0;
       amsg.add_payload(data, datalen);
       amsg.commit();
     }
 
+    /*static*/ void BarrierAdjustMessage::send_combined(NodeID target, Barrier barrier, int delta,
+							ReductionOpID redop_id,
+							const void *data, size_t datalen)
+    {
+      ActiveMessage<BarrierAdjustMessage> amsg(target, datalen);
+      amsg->barrier = barrier;
+      amsg->delta = delta;
+      amsg->wait_on = Event::NO_EVENT;
+      amsg->sender = Network::my_node_id;
+      amsg->forwarded = false;
+      amsg->combined = 1;
+      amsg->redop_id = redop_id;
+      if(datalen > 0)
+	amsg.add_payload(data, datalen);
+      amsg.commit();
+    }
+
+    /*static*/ void BarrierCombineMessage::handle_message(NodeID sender, const BarrierCombineMessage &args,
+							  const void *data, size_t datalen)
+    {
+      log_barrier.info() << "barrier combining enabled: " << args.barrier
+			 << " redop=" << args.redop_id << " parent=" << args.parent;
+      BarrierImpl *impl = get_runtime()->get_barrier_impl(args.barrier);
+      impl->enable_combining(args.redop_id, args.parent);
+    }
+
     /*static*/ void BarrierSubscribeMessage::send_request(NodeID target, ID::IDType barrier_id, EventImpl::gen_t subscribe_gen,
 							  NodeID subscriber, bool forwarded)
     {
@@ -2302,6 +2490,7 @@ static void *bytedup(const void *data, size_t datalen)
       NodeID migration_target = (NodeID) -1;
       NodeID forward_to_node = (NodeID) -1;
       NodeID inform_migration = (NodeID) -1;
+      bool flush_combined = false;
 
       do { // so we can use 'break' from the middle
 	AutoLock<> a(mutex);
@@ -2310,6 +2499,15 @@ static void *bytedup(const void *data, size_t datalen)
 
 	// ownership can change, so check it inside the lock
 	if(owner != Network::my_node_id) {
+	  // arrivals on a combining barrier get merged with any others from
+	  //  this node (or our subtree) - increments still go straight to the
+	  //  owner, as do arrivals whose timestamp can't share a message
+	  if(combine_arrivals && (delta < 0) &&
+	     can_combine_arrival(barrier_gen, timestamp)) {
+	    flush_combined = add_combined_arrival(barrier_gen, delta, timestamp,
+						  reduce_value, reduce_value_size);
+	    break;
+	  }
 	  forward_to_node = owner;
 	  break;
 	} else {
@@ -2398,7 +2596,7 @@ static void *bytedup(const void *data, size_t datalen)
 	  // finally (hah!), do not migrate barriers using reduction ops
 	  if(local_notifications.empty() && (remote_notifications.size() == 1) &&
 	     generations.empty() && (gen_subscribed <= generation) &&
-	     (redop == 0) &&
+	     (redop == 0) && !combine_arrivals &&
              (NodeID(ID(me).barrier_creator_node()) == Network::my_node_id)) {
 	    log_barrier.info() << "barrier migration: " << me << " -> " << remote_notifications[0].node;
 	    migration_target = remote_notifications[0].node;
@@ -2450,6 +2648,11 @@ static void *bytedup(const void *data, size_t datalen)
 	}
       } while(0);
 
+      if(flush_combined) {
+	get_runtime()->barrier_combiner.enqueue_barrier(this);
+	return;
+      }
+
       if(forward_to_node != (NodeID) -1) {
 	Barrier b = make_barrier(barrier_gen, timestamp);
 	BarrierAdjustMessage::send_request(forward_to_node, b, delta, Event::NO_EVENT,
@@ -2916,6 +3119,185 @@ static void *bytedup(const void *data, size_t datalen)
       return true;
     }
 
+    void BarrierImpl::enable_combining(ReductionOpID redopid,
+				       NodeID parent /*= -1*/)
+    {
+      AutoLock<> al(mutex);
+      if(parent != -1)
+	combine_parent_node = parent;
+      if(combine_arrivals) return;
+
+      combine_arrivals = true;
+      // we need the reduction op to fold values from local arrivals
+      if((redopid != 0) && (redop == 0)) {
+	redop_id = redopid;
+	redop = get_runtime()->reduce_op_table.get(redopid, 0);
+	if(redop == 0) {
+	  log_event.fatal() << "no reduction op registered for ID " << redopid;
+	  abort();
+	}
+      }
+    }
+
+    // an arrival that waits for a positive adjustment can only share a
+    //  message with arrivals waiting on the same node's adjustments, since
+    //  the combined arrival carries a single timestamp
+    //  - must be called with the lock held
+    bool BarrierImpl::can_combine_arrival(gen_t barrier_gen,
+					  Barrier::timestamp_t timestamp) const
+    {
+      if(timestamp == 0)
+	return true;
+      std::map<gen_t, CombinedArrival>::const_iterator it =
+	combined_arrivals.find(barrier_gen);
+      if((it == combined_arrivals.end()) || (it->second.timestamp == 0))
+	return true;
+      return ((it->second.timestamp >> BARRIER_TIMESTAMP_NODEID_SHIFT) ==
+	      (timestamp >> BARRIER_TIMESTAMP_NODEID_SHIFT));
+    }
+
+    // merges an arrival into the pending combined arrival for its generation
+    //  - must be called with the lock held, and returns true if the caller
+    //  needs to schedule a flush
+    bool BarrierImpl::add_combined_arrival(gen_t barrier_gen, int delta,
+					   Barrier::timestamp_t timestamp,
+					   const void *reduce_value,
+					   size_t reduce_value_size)
+    {
+      assert(can_combine_arrival(barrier_gen, timestamp));
+      CombinedArrival& ca = combined_arrivals[barrier_gen];
+      ca.delta += delta;  // value-initialized to zero on first use
+      // waiting for the latest adjustment also covers the earlier ones
+      if(timestamp > ca.timestamp)
+	ca.timestamp = timestamp;
+      if(reduce_value_size > 0) {
+	assert(redop != 0);
+	assert(redop->sizeof_rhs == reduce_value_size);
+	if(ca.value)
+	  redop->fold(ca.value, reduce_value, 1, true /*exclusive*/);
+	else
+	  ca.value = bytedup(reduce_value, reduce_value_size);
+      }
+
+      if(combine_flush_pending)
+	return false;
+      combine_flush_pending = true;
+      return true;
+    }
+
+    void BarrierImpl::combine_arrival(gen_t barrier_gen, int delta,
+				      Barrier::timestamp_t timestamp,
+				      const void *reduce_value, size_t reduce_value_size)
+    {
+      log_barrier.info() << "combining barrier arrival: barrier="
+			 << make_barrier(barrier_gen, timestamp) << " delta=" << delta;
+      bool flush = false;
+      NodeID pass_to = -1;
+      ReductionOpID pass_redop_id = 0;
+      {
+	AutoLock<> al(mutex);
+	if(can_combine_arrival(barrier_gen, timestamp)) {
+	  flush = add_combined_arrival(barrier_gen, delta, timestamp,
+				       reduce_value, reduce_value_size);
+	} else {
+	  pass_to = combine_parent();
+	  pass_redop_id = (redop ? redop_id : 0);
+	}
+      }
+      if(flush)
+	get_runtime()->barrier_combiner.enqueue_barrier(this);
+
+      // a timestamp from a different node than the pending arrival's goes up
+      //  the tree on its own
+      if(pass_to != -1)
+	BarrierAdjustMessage::send_combined(pass_to,
+					    make_barrier(barrier_gen, timestamp),
+					    delta, pass_redop_id,
+					    reduce_value, reduce_value_size);
+    }
+
+    void BarrierImpl::flush_combined_arrivals(void)
+    {
+      std::map<gen_t, CombinedArrival> to_send;
+      NodeID parent;
+      ReductionOpID send_redop_id;
+      size_t value_size;
+      {
+	AutoLock<> al(mutex);
+	to_send.swap(combined_arrivals);
+	combine_flush_pending = false;
+	parent = combine_parent();
+	send_redop_id = (redop ? redop_id : 0);
+	value_size = (redop ? redop->sizeof_rhs : 0);
+      }
+
+      for(std::map<gen_t, CombinedArrival>::iterator it = to_send.begin();
+	  it != to_send.end();
+	  ++it) {
+	Barrier b = make_barrier(it->first, it->second.timestamp);
+	log_barrier.info() << "sending combined barrier arrival: barrier=" << b
+			   << " delta=" << it->second.delta << " parent=" << parent;
+	BarrierAdjustMessage::send_combined(parent, b, it->second.delta,
+					    send_redop_id, it->second.value,
+					    (it->second.value ? value_size : 0));
+	if(it->second.value)
+	  free(it->second.value);
+      }
+    }
+
+    // until the owner names a parent (or if this node only learned about
+    //  combining from a child), arrivals go straight to the owner
+    //  - must be called with the lock held
+    NodeID BarrierImpl::combine_parent(void) const
+    {
+      return ((combine_parent_node != -1) ? combine_parent_node : owner);
+    }
+
+    void BarrierImpl::inform_combining(NodeID node, gen_t barrier_gen,
+				       bool combined)
+    {
+      NodeID parent;
+      ReductionOpID msg_redop_id;
+      {
+	AutoLock<> al(mutex);
+	std::map<NodeID, NodeID>::const_iterator it = combine_parents.find(node);
+	if(it != combine_parents.end()) {
+	  // combined arrivals mean it already knows (or will shortly)
+	  if(combined)
+	    return;
+	  parent = it->second;
+	} else {
+	  // the combining tree is a k-ary tree over the nodes that arrive,
+	  //  rooted at the owner - the i'th node to show up (counting the
+	  //  owner as 0) gets the (i-1)/k'th as its parent, so parents always
+	  //  joined earlier and the tree has no cycles
+	  int arity = std::max(Config::barrier_combine_arity, 1);
+	  size_t parent_index = combine_nodes.size() / arity;
+	  parent = ((parent_index == 0) ? owner :
+		    combine_nodes[parent_index - 1]);
+	  combine_nodes.push_back(node);
+	  combine_parents[node] = parent;
+	}
+
+	// a node is told again (at most once) in each generation it sends
+	//  individual arrivals for
+	if(barrier_gen > combine_informed_gen) {
+	  combine_informed.clear();
+	  combine_informed_gen = barrier_gen;
+	}
+	if(combine_informed.contains(node))
+	  return;
+	combine_informed.add(node);
+	msg_redop_id = redop_id;
+      }
+
+      ActiveMessage<BarrierCombineMessage> amsg(node);
+      amsg->barrier = current_barrier();
+      amsg->redop_id = msg_redop_id;
+      amsg->parent = parent;
+      amsg.commit();
+    }
+
     /*static*/ void BarrierMigrationMessage::handle_message(NodeID sender, const BarrierMigrationMessage &args,
 							    const void *data, size_t datalen)
     {
@@ -3706,6 +4088,7 @@ static void *bytedup(const void *data, size_t datalen)
   ActiveMessageHandlerReg<BarrierSubscribeMessage> barrier_subscribe_message_handler;
   ActiveMessageHandlerReg<BarrierTriggerMessage> barrier_trigger_message_handler;
   ActiveMessageHandlerReg<BarrierMigrationMessage> barrier_migration_message_handler;
+  ActiveMessageHandlerReg<BarrierCombineMessage> barrier_combine_message_handler;
   ActiveMessageHandlerReg<CompQueueDestroyMessage> compqueue_destroy_message_handler;
   ActiveMessageHandlerReg<CompQueueAddEventMessage> compqueue_addevent_message_handler;
   ActiveMessageHandlerReg<CompQueueRemoteProgressMessage> compqueue_remoteprogress_message_handler;
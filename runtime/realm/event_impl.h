@@ -87,6 +87,24 @@ namespace Realm {
       static REALM_THREAD_LOCAL EventWaiter::EventWaiterList *nested_poisoned;
     };
 
+    class BarrierImpl;
+
+    // sends the arrivals that have been combined on this node for any
+    //  barriers in combining mode - running from a background worker lets
+    //  arrivals that come in while it waits to be scheduled share a message
+    class BarrierArrivalCombiner : public BackgroundWorkItem {
+    public:
+      BarrierArrivalCombiner();
+
+      void enqueue_barrier(BarrierImpl *barrier);
+
+      virtual void do_work(TimeLimit work_until);
+
+    protected:
+      Mutex mutex;
+      std::vector<BarrierImpl *> pending;
+    };
+
     // parent class of GenEventImpl and BarrierImpl
     class EventImpl {
     public:
@@ -302,7 +320,8 @@ namespace Realm {
       Barrier make_barrier(gen_t gen, Barrier::timestamp_t timestamp = 0) const;
 
       static BarrierImpl *create_barrier(unsigned expected_arrivals, ReductionOpID redopid,
-					 const void *initial_value = 0, size_t initial_value_size = 0);
+					 const void *initial_value = 0, size_t initial_value_size = 0,
+					 bool combine_arrivals = false);
 
       // test whether an event has triggered without waiting
       virtual bool has_triggered(gen_t needed_gen, bool& poisoned);
@@ -330,6 +349,25 @@ namespace Realm {
 
       bool get_result(gen_t result_gen, void *value, size_t value_size);
 
+      // arrival combining - a non-owner node learns that a barrier combines
+      //  arrivals either from the owner (which also names its parent in the
+      //  tree) or from a child's combined arrival
+      void enable_combining(ReductionOpID redopid, NodeID parent = -1);
+      void combine_arrival(gen_t barrier_gen, int delta,
+			   Barrier::timestamp_t timestamp,
+			   const void *reduce_value, size_t reduce_value_size);
+      bool can_combine_arrival(gen_t barrier_gen,
+			       Barrier::timestamp_t timestamp) const;
+      bool add_combined_arrival(gen_t barrier_gen, int delta,
+				Barrier::timestamp_t timestamp,
+				const void *reduce_value, size_t reduce_value_size);
+      void flush_combined_arrivals(void);
+      NodeID combine_parent(void) const;
+      // called on the owner for arrivals from other nodes - tells the node
+      //  about combining (at most once per generation) unless it is already
+      //  sending combined arrivals to the parent it was given
+      void inform_combining(NodeID node, gen_t barrier_gen, bool combined);
+
     public: //protected:
       gen_t generation, gen_subscribed;
       gen_t first_generation;
@@ -374,6 +412,25 @@ namespace Realm {
 
       unsigned value_capacity; // how many values the two allocations below can hold
       char *final_values;   // results of completed reductions
+
+      // arrivals (and folded reduction values) waiting to be sent up the
+      //  combining tree, per generation - timestamped arrivals only combine
+      //  with others from the same node and carry the latest timestamp
+      struct CombinedArrival {
+	int delta;
+	Barrier::timestamp_t timestamp;
+	void *value;
+      };
+      bool combine_arrivals;
+      bool combine_flush_pending;
+      std::map<gen_t, CombinedArrival> combined_arrivals;
+      NodeID combine_parent_node;  // from the owner, or -1 to send to the owner
+      // on the owner, the tree is built over the nodes that arrive, in the
+      //  order they were first seen, so a node's parent never changes
+      std::vector<NodeID> combine_nodes;
+      std::map<NodeID, NodeID> combine_parents;
+      NodeSet combine_informed;  // nodes told about combining in this generation
+      gen_t combine_informed_gen;
     };
 
     class CompQueueImpl {
@@ -492,11 +549,21 @@ namespace Realm {
 
   struct EventUpdateMessage {
     Event event;
+    // number of NodeIDs following the poisoned generations in the payload -
+    //  these form the subtree the receiver must forward the update to
+    unsigned forward_count;
 
     static void handle_message(NodeID sender, const EventUpdateMessage &msg,
 			       const void *data, size_t datalen,
 			       TimeLimit work_until);
 
+    // sends an update for 'event' to all 'targets', either directly or
+    //  through a k-ary tree of the targets if -ll:event_fanout is set
+    static void broadcast(Event event,
+			  const EventImpl::gen_t *poisoned_gens,
+			  int poisoned_count,
+			  const NodeID *targets, size_t num_targets);
+
   };
 
   struct BarrierAdjustMessage {
@@ -505,6 +572,8 @@ namespace Realm {
     int delta;
     Barrier barrier;
     Event wait_on;
+    int combined;  // merged arrivals from a subtree of a combining barrier
+    ReductionOpID redop_id; // only set for combined arrivals
 
     static void handle_message(NodeID sender, const BarrierAdjustMessage &msg,
 			       const void *data, size_t datalen,
@@ -512,6 +581,9 @@ namespace Realm {
     static void send_request(NodeID target, Barrier barrier, int delta, Event wait_on,
 			     NodeID sender, bool forwarded,
 			     const void *data, size_t datalen);
+    static void send_combined(NodeID target, Barrier barrier, int delta,
+			      ReductionOpID redop_id,
+			      const void *data, size_t datalen);
     };
 
   struct BarrierSubscribeMessage {
@@ -548,6 +620,15 @@ namespace Realm {
 			     const void *data, size_t datalen);
   };
 
+  struct BarrierCombineMessage {
+    Barrier barrier;
+    ReductionOpID redop_id;
+    NodeID parent;
+
+    static void handle_message(NodeID sender, const BarrierCombineMessage &msg,
+			       const void *data, size_t datalen);
+  };
+
   struct BarrierMigrationMessage {
     Barrier barrier;
     NodeID current_owner;
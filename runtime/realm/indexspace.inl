@@ -494,44 +494,20 @@ namespace Realm {
     if(dense())
       return true;
 
+    // entries are disjoint, so at most one can contain the point - the
+    //  sparsity map finds it with a binary search (1-D) or a spatial index
     SparsityMapPublicImpl<N,T> *impl = sparsity.impl();
-    const std::vector<SparsityMapEntry<N,T> >& entries = impl->get_entries();
-    if(N == 1) {
-      // binary search to find the element we want
-      size_t idx = bsearch_map_entries<N,T>(entries, p);
-      if(idx >= entries.size()) return false;
-
-      const SparsityMapEntry<N,T>& e = entries[idx];
-
-      // the search guaranteed we're below the upper bound of the returned entry,
-      //  but we might be below the lower bound
-      if(p.x < e.bounds.lo.x)
-	return false;
+    size_t idx;
+    if(!impl->find_entry(p, idx))
+      return false;
 
-      if(e.sparsity.exists()) {
-	assert(0);
-      }
-      if(e.bitmap != 0) {
-	assert(0);
-      }
-      return true;
-    } else {
-      for(typename std::vector<SparsityMapEntry<N,T> >::const_iterator it = entries.begin();
-	  it != entries.end();
-	  it++) {
-	if(!it->bounds.contains(p)) continue;
-	if(it->sparsity.exists()) {
-	  assert(0);
-	} else if(it->bitmap != 0) {
-	  assert(0);
-	} else {
-	  return true;
-	}
-      }
+    const SparsityMapEntry<N,T>& e = impl->get_entries()[idx];
+    if(e.sparsity.exists()) {
+      assert(0);
     }
-
-    // no entries matched, so the point is not contained in this space
-    return false;
+    if(e.bitmap != 0)
+      return e.bitmap->get_bit(p);
+    return true;
   }
 
   template <int N, typename T>
@@ -542,8 +518,26 @@ namespace Realm {
       return false;
 
     if(!dense()) {
-      // test against sparsity map too
-      assert(0);
+      // test against sparsity map too - entries are disjoint, so the
+      //  rectangle is covered iff the overlapping pieces add up to it
+      SparsityMapPublicImpl<N,T> *impl = sparsity.impl();
+      const std::vector<SparsityMapEntry<N,T> >& entries = impl->get_entries();
+      std::vector<size_t> overlaps;
+      impl->find_overlapping_entries(r, overlaps);
+      size_t covered = 0;
+      for(std::vector<size_t>::const_iterator it = overlaps.begin();
+	  it != overlaps.end();
+	  ++it) {
+	const SparsityMapEntry<N,T>& e = entries[*it];
+	if(e.sparsity.exists()) {
+	  assert(0);
+	} else if(e.bitmap != 0) {
+	  covered += e.bitmap->count_bits(r);
+	} else {
+	  covered += e.bounds.intersection(r).volume();
+	}
+      }
+      return (covered == r.volume());
     }
 
     return true;
@@ -559,21 +553,7 @@ namespace Realm {
     if(!dense()) {
       // test against sparsity map too
       SparsityMapPublicImpl<N,T> *impl = sparsity.impl();
-      const std::vector<SparsityMapEntry<N,T> >& entries = impl->get_entries();
-      for(typename std::vector<SparsityMapEntry<N,T> >::const_iterator it = entries.begin();
-	  it != entries.end();
-	  it++) {
-	if(!it->bounds.overlaps(r)) continue;
-	if(it->sparsity.exists()) {
-	  assert(0);
-	} else if(it->bitmap != 0) {
-	  assert(0);
-	} else {
-	  return true;
-	}
-      }
-      
-      return false;
+      return impl->entries_overlap(r);
     }
 
     return true;
@@ -621,7 +601,7 @@ namespace Realm {
       if(it->sparsity.exists()) {
 	assert(0);
       } else if(it->bitmap != 0) {
-	assert(0);
+	total += it->bitmap->count_bits(isect);
       } else {
 	total += isect.volume();
       }
@@ -1090,9 +1070,11 @@ namespace Realm {
 	rect = restriction.intersection(e.bounds);
 	if(!rect.empty()) {
 	  assert(!e.sparsity.exists());
-	  assert(e.bitmap == 0);
-	  valid = true;
-	  return;
+	  // a bitmap entry is visited one run of set bits at a time
+	  if((e.bitmap == 0) || e.bitmap->first_run(restriction, rect)) {
+	    valid = true;
+	    return;
+	  }
 	}
 	cur_entry++;
       }
@@ -1130,9 +1112,11 @@ namespace Realm {
 	rect = restriction.intersection(e.bounds);
 	if(!rect.empty()) {
 	  assert(!e.sparsity.exists());
-	  assert(e.bitmap == 0);
-	  valid = true;
-	  return;
+	  // a bitmap entry is visited one run of set bits at a time
+	  if((e.bitmap == 0) || e.bitmap->first_run(restriction, rect)) {
+	    valid = true;
+	    return;
+	  }
 	}
 	cur_entry++;
       }
@@ -1153,10 +1137,15 @@ namespace Realm {
       return false;
     }
 
-    // TODO: handle iteration within a sparsity entry
+    // a bitmap entry may have more runs within our restriction
+    const std::vector<SparsityMapEntry<N,T> >& entries = s_impl->get_entries();
+    {
+      const SparsityMapEntry<N,T>& e = entries[cur_entry];
+      if((e.bitmap != 0) && e.bitmap->next_run(restriction, rect))
+	return true;
+    }
 
     // move onto the next sparsity entry (that overlaps our restriction)
-    const std::vector<SparsityMapEntry<N,T> >& entries = s_impl->get_entries();
     for(cur_entry++; cur_entry < entries.size(); cur_entry++) {
       const SparsityMapEntry<N,T>& e = entries[cur_entry];
       rect = restriction.intersection(e.bounds);
@@ -1170,7 +1159,8 @@ namespace Realm {
       }
 
       assert(!e.sparsity.exists());
-      assert(e.bitmap == 0);
+      if((e.bitmap != 0) && !e.bitmap->first_run(restriction, rect))
+	continue;
       return true;
     }
 
@@ -1444,7 +1444,15 @@ namespace Realm {
   Memory ExternalFileResource::suggested_memory() const
   {
     // TODO: support [rank=nnn] syntax here too
+    // a mapped file memory only exists if it was requested (-ll:file_mmap),
+    //  in which case it is preferred
     Memory memory = Machine::MemoryQuery(Machine::get_machine())
+      .local_address_space()
+      .only_kind(Memory::FILE_MAPPED_MEM)
+      .first();
+    if(memory.exists())
+      return memory;
+    memory = Machine::MemoryQuery(Machine::get_machine())
       .local_address_space()
       .only_kind(Memory::FILE_MEM)
       .first();
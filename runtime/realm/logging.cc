@@ -21,6 +21,7 @@
 
 #include "realm/cmdline.h"
 #include "realm/timers.h"
+#include "realm/atomics.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -34,6 +35,11 @@
 #ifdef REALM_ON_WINDOWS
 #include <windows.h>
 #include <processthreadsapi.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
 #endif
 
 namespace Realm {
@@ -134,6 +140,525 @@ namespace Realm {
     Mutex mutex;
   };
 
+  // an asynchronous variant of LoggerFileStream - each thread formats its
+  //  messages into a private ring buffer (single producer, single consumer)
+  //  and a background thread drains the rings to the file in large writes -
+  //  a thread's ring goes back to a free pool when the thread exits, so
+  //  threads that come and go reuse rings rather than leaking them
+  class LoggerAsyncFileStream : public LoggerFileStream {
+  public:
+    LoggerAsyncFileStream(FILE *_f, bool _close_file, bool _include_timestamp,
+			  size_t _ring_size, bool _drop_when_full);
+
+    virtual ~LoggerAsyncFileStream(void);
+
+    virtual void log_msg(Logger::LoggingLevel level, const char *name, const char *msgdata, size_t msglen);
+
+    // drains every ring synchronously before flushing the file
+    virtual void flush();
+
+    // called on the way to a crash - like flush(), but gives up on the
+    //  rings if the drain lock can't be had (e.g. because the crashing
+    //  thread holds it)
+    void flush_on_error(void);
+
+    // the async stream that fatal signals should flush, if any
+    static atomic<LoggerAsyncFileStream *> error_flush_stream;
+
+  protected:
+    struct ThreadRing {
+      char *data;
+      // both are running byte counts - only the owning thread advances
+      //  'tail' and only the drainer (holding drain_mutex) advances 'head'
+      atomic<size_t> head, tail;
+      LoggerAsyncFileStream *owner;
+    };
+
+    virtual void write(const char *buffer, size_t len);
+
+    ThreadRing *get_thread_ring(void);
+
+    // thread-exit hook - returns the exiting thread's ring to the free pool
+    //  (anything still in it is drained as usual, and the next thread to
+    //  pick it up just keeps appending)
+#ifdef REALM_ON_WINDOWS
+    static VOID NTAPI release_thread_ring(PVOID data);
+#else
+    static void release_thread_ring(void *data);
+#endif
+
+    // copies everything currently in the rings to the file - caller must
+    //  hold drain_mutex
+    bool drain_rings(void);
+    void write_staged(void);
+
+    // true if no ring has anything waiting to be drained
+    bool rings_empty(void);
+    // wakes the drain thread if it is waiting for work
+    void wake_drainer(void);
+
+#ifdef REALM_ON_WINDOWS
+    static DWORD WINAPI drain_thread_entry(LPVOID data);
+#else
+    static void *drain_thread_entry(void *data);
+
+    static void install_signal_handlers(void);
+    static void restore_signal_handlers(void);
+    static void fatal_signal_handler(int signal);
+#endif
+
+    static const size_t RECORD_ALIGN = sizeof(size_t);
+    static const size_t SKIP_RECORD = ~size_t(0);
+    static const size_t STAGING_SIZE = 1 << 20;
+    // an idle drain thread checks the rings at least this often, in case
+    //  it missed a wakeup from a writer
+    static const long long IDLE_CHECK_NSEC = 100000000;  // 100 ms
+    // how long flush_on_error() waits for the drain lock
+    static const long long ERROR_LOCK_NSEC = 100000000;  // 100 ms
+
+    size_t ring_size;
+    bool drop_when_full;
+    Mutex rings_mutex;
+    std::vector<ThreadRing *> rings;
+    // rings whose threads have exited - a subset of 'rings', also guarded
+    //  by rings_mutex
+    std::vector<ThreadRing *> free_rings;
+#ifdef REALM_ON_WINDOWS
+    DWORD ring_fls_index;
+#else
+    pthread_key_t ring_key;
+#endif
+    Mutex drain_mutex;
+    char *staging;
+    size_t staged;
+    Mutex wake_mutex;
+    CondVar wake_cv;
+    atomic<bool> drainer_waiting;
+    atomic<bool> shutdown_requested;
+    atomic<size_t> messages_dropped, messages_blocked;
+#ifdef REALM_ON_WINDOWS
+    HANDLE drain_thread;
+#else
+    pthread_t drain_thread;
+#endif
+  };
+
+  // each thread remembers the ring it uses - there is at most one async
+  //  stream, but check the owner in case it is ever recreated
+  namespace {
+    REALM_THREAD_LOCAL void *tls_ring_owner = 0;
+    REALM_THREAD_LOCAL void *tls_ring = 0;
+  };
+
+  /*static*/ atomic<LoggerAsyncFileStream *> LoggerAsyncFileStream::error_flush_stream(0);
+
+  LoggerAsyncFileStream::LoggerAsyncFileStream(FILE *_f, bool _close_file,
+					       bool _include_timestamp,
+					       size_t _ring_size,
+					       bool _drop_when_full)
+    : LoggerFileStream(_f, _close_file, _include_timestamp)
+    , ring_size(_ring_size)
+    , drop_when_full(_drop_when_full)
+    , staged(0)
+    , wake_cv(wake_mutex)
+    , drainer_waiting(false)
+    , shutdown_requested(false)
+    , messages_dropped(0)
+    , messages_blocked(0)
+  {
+    // ring size must be a multiple of the record alignment
+    ring_size = (ring_size + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1);
+    assert(ring_size >= 4 * RECORD_ALIGN);
+    staging = static_cast<char *>(malloc(STAGING_SIZE));
+    assert(staging != 0);
+
+#ifdef REALM_ON_WINDOWS
+    ring_fls_index = FlsAlloc(release_thread_ring);
+    assert(ring_fls_index != FLS_OUT_OF_INDEXES);
+#else
+    {
+      int ret = pthread_key_create(&ring_key, release_thread_ring);
+      assert(ret == 0);
+    }
+#endif
+
+#ifdef REALM_ON_WINDOWS
+    drain_thread = CreateThread(NULL, 0, drain_thread_entry, this, 0, 0);
+    assert(drain_thread != NULL);
+#else
+    int ret = pthread_create(&drain_thread, 0, drain_thread_entry, this);
+    assert(ret == 0);
+#endif
+
+    // an abort (e.g. from a failed assert) or crash must not lose the
+    //  messages still sitting in the rings
+    error_flush_stream.store_release(this);
+#ifndef REALM_ON_WINDOWS
+    install_signal_handlers();
+#endif
+  }
+
+  LoggerAsyncFileStream::~LoggerAsyncFileStream(void)
+  {
+    // threads that exit from here on must not touch the pool (on Windows
+    //  this also runs the hook for every thread still holding a ring, which
+    //  is harmless since all rings are freed below)
+#ifdef REALM_ON_WINDOWS
+    FlsFree(ring_fls_index);
+#else
+    pthread_key_delete(ring_key);
+#endif
+
+    {
+      LoggerAsyncFileStream *expected = this;
+      if(error_flush_stream.compare_exchange(expected, 0)) {
+#ifndef REALM_ON_WINDOWS
+	restore_signal_handlers();
+#endif
+      }
+    }
+
+    shutdown_requested.store_release(true);
+    {
+      AutoLock<> al(wake_mutex);
+      wake_cv.signal();
+    }
+#ifdef REALM_ON_WINDOWS
+    WaitForSingleObject(drain_thread, INFINITE);
+    CloseHandle(drain_thread);
+#else
+    pthread_join(drain_thread, 0);
+#endif
+
+    flush();
+
+    size_t dropped = messages_dropped.load();
+    size_t blocked = messages_blocked.load();
+    if((dropped > 0) || (blocked > 0)) {
+      char msg[128];
+      int len = snprintf(msg, sizeof(msg),
+			 "[%d] async logging: %zd messages dropped, %zd messages blocked on a full buffer\n",
+			 Network::my_node_id, dropped, blocked);
+      LoggerFileStream::write(msg, len);
+      fflush(f);
+    }
+
+    for(std::vector<ThreadRing *>::iterator it = rings.begin();
+	it != rings.end();
+	++it) {
+      free((*it)->data);
+      delete *it;
+    }
+    free(staging);
+  }
+
+  void LoggerAsyncFileStream::log_msg(Logger::LoggingLevel level, const char *name, const char *msgdata, size_t msglen)
+  {
+    LoggerFileStream::log_msg(level, name, msgdata, msglen);
+
+    // errors (and especially fatal errors, which are generally followed by
+    //  an abort()) must make it to the file before we return
+    if(level >= Logger::LEVEL_ERROR)
+      flush();
+  }
+
+  void LoggerAsyncFileStream::flush()
+  {
+    AutoLock<> al(drain_mutex);
+    drain_rings();
+    write_staged();
+    LoggerFileStream::flush();
+  }
+
+  void LoggerAsyncFileStream::flush_on_error(void)
+  {
+    long long deadline = Clock::current_time_in_nanoseconds() + ERROR_LOCK_NSEC;
+    while(!drain_mutex.trylock()) {
+      if(Clock::current_time_in_nanoseconds() > deadline)
+	return;
+#ifdef REALM_ON_WINDOWS
+      SwitchToThread();
+#else
+      sched_yield();
+#endif
+    }
+    drain_rings();
+    write_staged();
+    fflush(f);
+    drain_mutex.unlock();
+  }
+
+#ifndef REALM_ON_WINDOWS
+  namespace {
+    const int fatal_signals[] = { SIGABRT, SIGSEGV, SIGBUS, SIGFPE, SIGILL };
+    const size_t num_fatal_signals = sizeof(fatal_signals) / sizeof(fatal_signals[0]);
+    bool fatal_signal_hooked[num_fatal_signals];
+  };
+
+  /*static*/ void LoggerAsyncFileStream::install_signal_handlers(void)
+  {
+    // only take over signals that still have their default action - an
+    //  application's (or Realm's backtrace/freeze) handler is left alone,
+    //  and those flush via Logger::flush_for_error() themselves
+    for(size_t i = 0; i < num_fatal_signals; i++) {
+      struct sigaction old_action;
+      if(sigaction(fatal_signals[i], 0, &old_action) != 0)
+	continue;
+      if(((old_action.sa_flags & SA_SIGINFO) != 0) ||
+	 (old_action.sa_handler != SIG_DFL))
+	continue;
+      // SA_RESETHAND puts the default action back before we run, so the
+      //  re-raise below (or the faulting instruction) ends the process
+      struct sigaction action;
+      action.sa_handler = fatal_signal_handler;
+      sigemptyset(&action.sa_mask);
+      action.sa_flags = SA_RESETHAND | SA_ONSTACK;
+      if(sigaction(fatal_signals[i], &action, 0) == 0)
+	fatal_signal_hooked[i] = true;
+    }
+  }
+
+  /*static*/ void LoggerAsyncFileStream::restore_signal_handlers(void)
+  {
+    for(size_t i = 0; i < num_fatal_signals; i++) {
+      if(!fatal_signal_hooked[i])
+	continue;
+      fatal_signal_hooked[i] = false;
+      struct sigaction old_action;
+      if(sigaction(fatal_signals[i], 0, &old_action) != 0)
+	continue;
+      // don't clobber anything installed after us
+      if(((old_action.sa_flags & SA_SIGINFO) != 0) ||
+	 (old_action.sa_handler != fatal_signal_handler))
+	continue;
+      struct sigaction action;
+      action.sa_handler = SIG_DFL;
+      sigemptyset(&action.sa_mask);
+      action.sa_flags = 0;
+      sigaction(fatal_signals[i], &action, 0);
+    }
+  }
+
+  /*static*/ void LoggerAsyncFileStream::fatal_signal_handler(int signal)
+  {
+    LoggerAsyncFileStream *s = error_flush_stream.load_acquire();
+    if(s != 0)
+      s->flush_on_error();
+    // the signal is blocked until we return, at which point the default
+    //  action is taken
+    raise(signal);
+  }
+#endif
+
+  LoggerAsyncFileStream::ThreadRing *LoggerAsyncFileStream::get_thread_ring(void)
+  {
+    if(tls_ring_owner == this)
+      return static_cast<ThreadRing *>(tls_ring);
+
+    ThreadRing *r = 0;
+    {
+      AutoLock<> al(rings_mutex);
+      if(!free_rings.empty()) {
+	r = free_rings.back();
+	free_rings.pop_back();
+      }
+    }
+    if(r == 0) {
+      r = new ThreadRing;
+      r->data = static_cast<char *>(malloc(ring_size));
+      assert(r->data != 0);
+      r->head.store(0);
+      r->tail.store(0);
+      r->owner = this;
+      AutoLock<> al(rings_mutex);
+      rings.push_back(r);
+    }
+#ifdef REALM_ON_WINDOWS
+    FlsSetValue(ring_fls_index, r);
+#else
+    pthread_setspecific(ring_key, r);
+#endif
+    tls_ring_owner = this;
+    tls_ring = r;
+    return r;
+  }
+
+#ifdef REALM_ON_WINDOWS
+  /*static*/ VOID NTAPI LoggerAsyncFileStream::release_thread_ring(PVOID data)
+#else
+  /*static*/ void LoggerAsyncFileStream::release_thread_ring(void *data)
+#endif
+  {
+    ThreadRing *r = static_cast<ThreadRing *>(data);
+    // a later thread-exit hook that logs must not reuse a ring that is
+    //  already back in the pool - it gets (and re-registers) a fresh one
+    if(tls_ring == r) {
+      tls_ring_owner = 0;
+      tls_ring = 0;
+    }
+    LoggerAsyncFileStream *s = r->owner;
+    AutoLock<> al(s->rings_mutex);
+    s->free_rings.push_back(r);
+  }
+
+  void LoggerAsyncFileStream::write(const char *buffer, size_t len)
+  {
+    size_t rec_len = ((sizeof(size_t) + len + RECORD_ALIGN - 1) &
+		      ~(RECORD_ALIGN - 1));
+
+    // messages that can never fit in a ring are written directly, after
+    //  draining everything older
+    if(rec_len > (ring_size / 2)) {
+      AutoLock<> al(drain_mutex);
+      drain_rings();
+      write_staged();
+      LoggerFileStream::write(buffer, len);
+      return;
+    }
+
+    ThreadRing *r = get_thread_ring();
+    size_t tail = r->tail.load();
+    size_t ofs = tail % ring_size;
+    // records never wrap - if this one doesn't fit before the end, we skip
+    //  to the start of the ring
+    size_t needed = rec_len;
+    if((ofs + rec_len) > ring_size)
+      needed += (ring_size - ofs);
+
+    if((ring_size - (tail - r->head.load_acquire())) < needed) {
+      if(drop_when_full) {
+	messages_dropped.fetch_add(1);
+	return;
+      }
+      messages_blocked.fetch_add(1);
+      wake_drainer();
+      while((ring_size - (tail - r->head.load_acquire())) < needed) {
+#ifdef REALM_ON_WINDOWS
+	SwitchToThread();
+#else
+	sched_yield();
+#endif
+      }
+    }
+
+    if(needed > rec_len) {
+      *reinterpret_cast<size_t *>(r->data + ofs) = SKIP_RECORD;
+      tail += (ring_size - ofs);
+      ofs = 0;
+    }
+    *reinterpret_cast<size_t *>(r->data + ofs) = len;
+    memcpy(r->data + ofs + sizeof(size_t), buffer, len);
+    r->tail.store_release(tail + rec_len);
+
+    wake_drainer();
+  }
+
+  bool LoggerAsyncFileStream::rings_empty(void)
+  {
+    AutoLock<> al(rings_mutex);
+    for(std::vector<ThreadRing *>::const_iterator it = rings.begin();
+	it != rings.end();
+	++it)
+      if((*it)->head.load() != (*it)->tail.load_acquire())
+	return false;
+    return true;
+  }
+
+  void LoggerAsyncFileStream::wake_drainer(void)
+  {
+    // cheap check so that writers only take the lock when the drain thread
+    //  is actually asleep
+    if(!drainer_waiting.load_acquire())
+      return;
+
+    AutoLock<> al(wake_mutex);
+    if(drainer_waiting.load()) {
+      drainer_waiting.store(false);
+      wake_cv.signal();
+    }
+  }
+
+  bool LoggerAsyncFileStream::drain_rings(void)
+  {
+    bool any = false;
+    size_t num_rings;
+    {
+      AutoLock<> al(rings_mutex);
+      num_rings = rings.size();
+    }
+    for(size_t i = 0; i < num_rings; i++) {
+      ThreadRing *r;
+      {
+	AutoLock<> al(rings_mutex);
+	r = rings[i];
+      }
+      size_t head = r->head.load();
+      size_t tail = r->tail.load_acquire();
+      while(head != tail) {
+	size_t ofs = head % ring_size;
+	size_t len = *reinterpret_cast<const size_t *>(r->data + ofs);
+	if(len == SKIP_RECORD) {
+	  head += (ring_size - ofs);
+	  continue;
+	}
+	if((staged + len) > STAGING_SIZE)
+	  write_staged();
+	if(len > STAGING_SIZE) {
+	  // a record bigger than the staging buffer (possible with large
+	  //  rings) goes straight to the file
+	  LoggerFileStream::write(r->data + ofs + sizeof(size_t), len);
+	} else {
+	  memcpy(staging + staged, r->data + ofs + sizeof(size_t), len);
+	  staged += len;
+	}
+	head += ((sizeof(size_t) + len + RECORD_ALIGN - 1) &
+		 ~(RECORD_ALIGN - 1));
+	any = true;
+      }
+      r->head.store_release(head);
+    }
+    return any;
+  }
+
+  void LoggerAsyncFileStream::write_staged(void)
+  {
+    if(staged > 0) {
+      LoggerFileStream::write(staging, staged);
+      staged = 0;
+    }
+  }
+
+#ifdef REALM_ON_WINDOWS
+  /*static*/ DWORD WINAPI LoggerAsyncFileStream::drain_thread_entry(LPVOID data)
+#else
+  /*static*/ void *LoggerAsyncFileStream::drain_thread_entry(void *data)
+#endif
+  {
+    LoggerAsyncFileStream *s = static_cast<LoggerAsyncFileStream *>(data);
+    while(!s->shutdown_requested.load_acquire()) {
+      bool any;
+      {
+	AutoLock<> al(s->drain_mutex);
+	any = s->drain_rings();
+	s->write_staged();
+	if(any)
+	  s->LoggerFileStream::flush();
+      }
+      // sleep until a writer has something for us - the flag is set before
+      //  the rings are checked again so that a writer either sees it or
+      //  has its message noticed by that check (the timeout covers a
+      //  wakeup lost to memory reordering between the two)
+      if(!any) {
+	AutoLock<> al(s->wake_mutex);
+	s->drainer_waiting.store_release(true);
+	if(!s->shutdown_requested.load_acquire() && s->rings_empty())
+	  s->wake_cv.timedwait(IDLE_CHECK_NSEC);
+	s->drainer_waiting.store(false);
+      }
+    }
+    return 0;
+  }
+
   class LoggerConfig {
   protected:
     LoggerConfig(void);
@@ -154,10 +679,13 @@ namespace Realm {
 
   protected:
     bool parse_level_argument(const std::string& s);
+    LoggerOutputStream *create_stream(FILE *f, bool close_file);
 
     bool cmdline_read;
     Logger::LoggingLevel default_level, stderr_level;
     bool include_timestamp;
+    size_t async_buffer_size;
+    bool async_drop_when_full;
     std::map<std::string, Logger::LoggingLevel> category_levels;
     std::string cats_enabled;
     std::set<Logger *> pending_configs;
@@ -170,6 +698,8 @@ namespace Realm {
     , default_level(Logger::LEVEL_PRINT)
     , stderr_level(Logger::LEVEL_ERROR)
     , include_timestamp(true)
+    , async_buffer_size(0)
+    , async_drop_when_full(false)
     , stream(0)
     , stderr_stream(0)
     , default_output(0)
@@ -299,6 +829,8 @@ namespace Realm {
       .add_option_method("-level", this, &LoggerConfig::parse_level_argument)
       .add_option_int("-errlevel", stderr_level)
       .add_option_int("-logtime", include_timestamp)
+      .add_option_int_units("-logasync", async_buffer_size, 'k')
+      .add_option_int("-logasyncdrop", async_drop_when_full)
       .parse_command_line(cmdline);
 
     if(!ok) {
@@ -310,14 +842,14 @@ namespace Realm {
     if(logname.empty()) {
       // the gasnet UDP job spawner (amudprun) seems to buffer stdout, so make stderr the default
 #ifdef GASNET_CONDUIT_UDP
-      stream = new LoggerFileStream(stderr, false, include_timestamp);
+      stream = create_stream(stderr, false);
 #else
-      stream = new LoggerFileStream(stdout, false, include_timestamp);
+      stream = create_stream(stdout, false);
 #endif
     } else if(logname == "stdout") {
-      stream = new LoggerFileStream(stdout, false, include_timestamp);
+      stream = create_stream(stdout, false);
     } else if(logname == "stderr") {
-      stream = new LoggerFileStream(stderr, false, include_timestamp);
+      stream = create_stream(stderr, false);
     } else {
       // we're going to open a file, but key off a + for appending and
       //  look for a % for node number insertion
@@ -358,9 +890,9 @@ namespace Realm {
           exit(1);
         }
       }
-      // TODO: consider buffering in some cases?
-      setbuf(f, 0); // disable output buffering
-      stream = new LoggerFileStream(f, true, include_timestamp);
+      // disable output buffering - the async stream does its own
+      setbuf(f, 0);
+      stream = create_stream(f, true);
 
       // when logging to a file, also sent critical-enough messages to stderr
       if(stderr_level < Logger::LEVEL_NONE)
@@ -379,6 +911,16 @@ namespace Realm {
     }
   }
 
+  LoggerOutputStream *LoggerConfig::create_stream(FILE *f, bool close_file)
+  {
+    if(async_buffer_size > 0)
+      return new LoggerAsyncFileStream(f, close_file, include_timestamp,
+				       async_buffer_size,
+				       async_drop_when_full);
+    else
+      return new LoggerFileStream(f, close_file, include_timestamp);
+  }
+
   void LoggerConfig::set_default_output(LoggerOutputStream *s)
   {
     // must be called before command line is parsed
@@ -519,6 +1061,13 @@ namespace Realm {
     LoggerConfig::get_config()->set_default_output(s);
   }
 
+  /*static*/ void Logger::flush_for_error(void)
+  {
+    LoggerAsyncFileStream *s = LoggerAsyncFileStream::error_flush_stream.load_acquire();
+    if(s != 0)
+      s->flush_on_error();
+  }
+
   /*static*/ void Logger::set_logger_output(const std::string& name, LoggerOutputStream *s)
   {
     LoggerConfig::get_config()->set_logger_output(name, s);
@@ -526,7 +1075,16 @@ namespace Realm {
 
   void Logger::log_msg(LoggingLevel level, const char *msgdata, size_t msglen)
   {
-    // if we're not configured yet, delay the message
+    // if we're not configured yet, delay the message - except for fatal
+    //  ones, which are followed by an abort() that would lose them (e.g.
+    //  a network module failing to start, which happens before logging
+    //  is configured)
+    if(!configured && (level >= LEVEL_FATAL)) {
+      fprintf(stderr, "{%d}{%s}: %.*s\n",
+	      (int)level, name.c_str(), (int)msglen, msgdata);
+      fflush(stderr);
+      return;
+    }
     if(!configured) {
       size_t bytes = sizeof(DelayedMessage) + msglen;
       void *ptr = malloc(bytes);
@@ -554,7 +1112,9 @@ namespace Realm {
 
       it->s->log_msg(level, name.c_str(), msgdata, msglen);
 
-      if(it->flush_each_write)
+      // a fatal message is usually followed by an abort(), which would
+      //  discard it if the stream is buffered (e.g. stdout to a pipe)
+      if(it->flush_each_write || (level >= LEVEL_FATAL))
         it->s->flush();
     }
   }
@@ -64,6 +64,10 @@ namespace Realm {
     static void configure_from_cmdline(std::vector<std::string>& cmdline);
     static void set_default_output(LoggerOutputStream *s);
     static void set_logger_output(const std::string& name, LoggerOutputStream *s);
+
+    // writes out any messages still buffered by asynchronous logging -
+    //  meant for error/signal handlers that are about to end the process
+    static void flush_for_error(void);
     
     const std::string& get_name(void) const;
     LoggingLevel get_level(void) const;
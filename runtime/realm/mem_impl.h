@@ -58,6 +58,7 @@ namespace Realm {
       MKIND_ZEROCOPY, // CPU memory, pinned for GPU access
       MKIND_DISK,    // disk memory accessible by owner node
       MKIND_FILE,    // file memory accessible by owner node
+      MKIND_MAPPED_FILE, // files mapped into the owner node's address space
 #ifdef REALM_USE_HDF5
       MKIND_HDF,     // HDF memory accessible by owner node
 #endif
@@ -197,6 +198,8 @@ namespace Realm {
 
   // manages a basic free list of ranges (using range type RT) and allocated
   //  ranges, which are tagged (tag type TT)
+  // free ranges are indexed by size, giving best-fit allocation in
+  //  O(log n) time, and are coalesced with their neighbors on deallocation
   // NOT thread-safe - must be protected from outside
   template <typename RT, typename TT>
   class BasicRangeAllocator {
@@ -206,14 +209,17 @@ namespace Realm {
 
       RT first, last;  // half-open range: [first, last)
       unsigned prev, next;  // double-linked list of all ranges (by index)
-      unsigned prev_free, next_free;  // double-linked list of just free ranges
+      bool is_free;
     };
 
     std::map<TT, unsigned> allocated;  // direct lookup of allocated ranges by tag
 #ifdef DEBUG_REALM
     std::map<RT, unsigned> by_first;   // direct lookup of all ranges by first
-    // TODO: sized-based lookup of free ranges
 #endif
+    // size-based lookup of free ranges - keyed by (size, first) so that ties
+    //  are broken by address
+    typedef std::map<std::pair<RT, RT>, unsigned> FreeRangeIndex;
+    FreeRangeIndex free_by_size;
 
     static const unsigned SENTINEL = 0;
     // TODO: small (medium?) vector opt
@@ -234,6 +240,15 @@ namespace Realm {
     unsigned first_free_range;
     unsigned alloc_range(RT first, RT last);
     void free_range(unsigned index);
+
+    void add_to_free_index(unsigned index);
+    void remove_from_free_index(unsigned index);
+    // returns the smallest free range that can hold an allocation of the
+    //  given size/alignment, or SENTINEL if there is none - if alignment
+    //  rules out the first MAX_ALIGN_SCAN candidates, this settles for the
+    //  smallest range that is big enough regardless of alignment (if any)
+    unsigned find_free_range(RT size, RT alignment, RT& offset);
+    static const unsigned MAX_ALIGN_SCAN = 16;
   };
 
     // a memory that manages its own allocations
@@ -379,6 +394,45 @@ namespace Realm {
       };
     };
 
+    // attaches files by mapping them into the address space instead of
+    //  going through file I/O - the memory itself has no storage, and an
+    //  instance's offset is the address of its mapping, so instances can be
+    //  accessed directly and copies in and out of them are just memcpy's
+    class MappedFileMemory : public MemoryImpl {
+    public:
+      MappedFileMemory(Memory _me, bool _populate, int _advice);
+
+      virtual ~MappedFileMemory(void);
+
+      virtual void get_bytes(off_t offset, void *dst, size_t size);
+      virtual void put_bytes(off_t offset, const void *src, size_t size);
+      virtual void *get_direct_ptr(off_t offset, size_t size);
+
+      virtual AllocationResult allocate_storage_immediate(RegionInstanceImpl *inst,
+							  bool need_alloc_result,
+							  bool poisoned,
+							  TimeLimit work_until);
+
+      virtual void release_storage_immediate(RegionInstanceImpl *inst,
+					     bool poisoned,
+					     TimeLimit work_until);
+
+      // converts the name of an madvise hint ("normal", "sequential",
+      //  "random", "willneed") into the value passed to madvise - returns
+      //  false if the name is not recognized
+      static bool parse_advice(const std::string& name, int& advice);
+
+      // the 'mem_specific' data for a mapped instance contains MappedFileInfo
+      struct MappedFileInfo {
+	void *base;  // start of the mapping (page-aligned)
+	size_t size;
+      };
+
+    protected:
+      bool populate;  // prefault the whole mapping (MAP_POPULATE)
+      int advice;     // madvise hint for new mappings, or -1 for none
+    };
+
     class RemoteMemory : public MemoryImpl {
     public:
       RemoteMemory(Memory _me, size_t _size, Memory::Kind k,
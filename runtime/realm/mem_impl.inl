@@ -45,7 +45,9 @@ namespace Realm {
     Range& s = ranges[SENTINEL];
     s.first = RT(-1);
     s.last = 0;
-    s.prev = s.next = s.prev_free = s.next_free = SENTINEL;
+    s.prev = s.next = SENTINEL;
+    // the sentinel is never merged with anything
+    s.is_free = false;
   }
 
   template <typename RT, typename TT>
@@ -59,6 +61,7 @@ namespace Realm {
 #ifdef DEBUG_REALM
     by_first.swap(swap_with.by_first);
 #endif
+    free_by_size.swap(swap_with.free_by_size);
     ranges.swap(swap_with.ranges);
     std::swap(first_free_range, swap_with.first_free_range);
   }
@@ -80,9 +83,9 @@ namespace Realm {
       // all block list
       newr.prev = newr.next = SENTINEL;
       sentinel.prev = sentinel.next = new_idx;
-      // free block list
-      newr.prev_free = newr.next_free = SENTINEL;
-      sentinel.prev_free = sentinel.next_free = new_idx;
+      // free block index
+      newr.is_free = true;
+      add_to_free_index(new_idx);
 
 #ifdef DEBUG_REALM
       by_first[first] = new_idx;
@@ -116,37 +119,86 @@ namespace Realm {
     ranges[index].next = first_free_range;
     first_free_range = index;
   }
-  
+
   template <typename RT, typename TT>
-  inline bool BasicRangeAllocator<RT,TT>::can_allocate(TT tag,
-						       RT size, RT alignment)
+  inline void BasicRangeAllocator<RT,TT>::add_to_free_index(unsigned index)
   {
-    // empty allocation requests are trivial
-    if(size == 0) {
-      return true;
-    }
+    const Range& r = ranges[index];
+    free_by_size[std::make_pair(r.last - r.first, r.first)] = index;
+  }
 
-    // walk free ranges and just take the first that fits
-    unsigned idx = ranges[SENTINEL].next_free;
-    while(idx != SENTINEL) {
-      Range *r = &ranges[idx];
+  template <typename RT, typename TT>
+  inline void BasicRangeAllocator<RT,TT>::remove_from_free_index(unsigned index)
+  {
+    const Range& r = ranges[index];
+#ifdef DEBUG_REALM
+    size_t count =
+#endif
+      free_by_size.erase(std::make_pair(r.last - r.first, r.first));
+#ifdef DEBUG_REALM
+    assert(count == 1);
+#endif
+  }
+
+  template <typename RT, typename TT>
+  inline unsigned BasicRangeAllocator<RT,TT>::find_free_range(RT size,
+							      RT alignment,
+							      RT& offset)
+  {
+    // start with the smallest range that's at least as big as the request -
+    //  alignment may rule out some of the ranges smaller than
+    //  (size + alignment - 1), but any range at least that big is sure to
+    //  fit, so after checking MAX_ALIGN_SCAN maybe-fits we jump straight to
+    //  the smallest sure fit, making this O(log n) in the number of free
+    //  ranges - only if there is no sure fit at all do we keep walking the
+    //  maybe-fits, which is O(n) but never misses a range that works
+    RT sure_fit = size;
+    if(alignment > 1) {
+      sure_fit = size + (alignment - 1);
+      if(sure_fit < size)
+	sure_fit = ~RT(0);  // overflow - no range can be that big anyway
+    }
+    typename FreeRangeIndex::const_iterator it = free_by_size.lower_bound(std::make_pair(size, RT(0)));
+    unsigned checked = 0;
+    while(it != free_by_size.end()) {
+      const Range& r = ranges[it->second];
 
       RT ofs = 0;
       if(alignment) {
-	RT rem = r->first % alignment;
+	RT rem = r.first % alignment;
 	if(rem > 0)
 	  ofs = alignment - rem;
       }
       // do we have enough space?
-      if((r->last - r->first) >= (size + ofs))
-	return true;
+      if((r.last - r.first) >= (size + ofs)) {
+	offset = ofs;
+	return it->second;
+      }
 
-      // no, go to next one
-      idx = r->next_free;
+      // no, try the next larger one
+      ++it;
+      if((++checked == MAX_ALIGN_SCAN) &&
+	 (it != free_by_size.end()) && (it->first.first < sure_fit)) {
+	typename FreeRangeIndex::const_iterator it2 = free_by_size.lower_bound(std::make_pair(sure_fit, RT(0)));
+	if(it2 != free_by_size.end())
+	  it = it2;
+      }
+    }
+
+    return SENTINEL;
+  }
+  
+  template <typename RT, typename TT>
+  inline bool BasicRangeAllocator<RT,TT>::can_allocate(TT tag,
+						       RT size, RT alignment)
+  {
+    // empty allocation requests are trivial
+    if(size == 0) {
+      return true;
     }
 
-    // allocation failed
-    return false;
+    RT ofs;
+    return (find_free_range(size, alignment, ofs) != SENTINEL);
   }
 
   template <typename RT, typename TT>
@@ -158,92 +210,70 @@ namespace Realm {
       return true;
     }
 
-    // walk free ranges and just take the first that fits
-    unsigned idx = ranges[SENTINEL].next_free;
-    while(idx != SENTINEL) {
-      Range *r = &ranges[idx];
+    // best fit - the smallest free range that works
+    RT ofs = 0;
+    unsigned idx = find_free_range(size, alignment, ofs);
+    if(idx == SENTINEL) {
+      // allocation failed
+      return false;
+    }
 
-      RT ofs = 0;
-      if(alignment) {
-	RT rem = r->first % alignment;
-	if(rem > 0)
-	  ofs = alignment - rem;
-      }
-      // do we have enough space?
-      if((r->last - r->first) >= (size + ofs)) {
-	// yes, but we may need to chop things up to make the exact range we want
-	alloc_first = r->first + ofs;
-	RT alloc_last = alloc_first + size;
-
-        // do we need to carve off a new (free) block before us?
-        if(alloc_first != r->first) {
-	  unsigned new_idx = alloc_range(r->first, alloc_first);
-	  Range *new_prev = &ranges[new_idx];
-	  r = &ranges[idx];  // alloc may have moved this!
-	  
-	  r->first = alloc_first;
-	  // insert into all-block dllist
-	  new_prev->prev = r->prev;
-	  new_prev->next = idx;
-	  ranges[r->prev].next = new_idx;
-	  r->prev = new_idx;
-	  // insert into free-block dllist
-	  new_prev->prev_free = r->prev_free;
-	  new_prev->next_free = idx;
-	  ranges[r->prev_free].next_free = new_idx;
-	  r->prev_free = new_idx;
+    // we may need to chop things up to make the exact range we want - any
+    //  leftover pieces go back in the free index
+    remove_from_free_index(idx);
+
+    Range *r = &ranges[idx];
+    alloc_first = r->first + ofs;
+    RT alloc_last = alloc_first + size;
+
+    // do we need to carve off a new (free) block before us?
+    if(alloc_first != r->first) {
+      unsigned new_idx = alloc_range(r->first, alloc_first);
+      Range *new_prev = &ranges[new_idx];
+      r = &ranges[idx];  // alloc may have moved this!
 
 #ifdef DEBUG_REALM
-	  // fix up by_first entries
-	  by_first[r->first] = new_idx;
-	  by_first[alloc_first] = idx;
+      // fix up by_first entries
+      by_first[r->first] = new_idx;
+      by_first[alloc_first] = idx;
 #endif
-        }
-
-	// two cases to deal with
-	if(alloc_last == r->last) {
-	  // case 1 - exact fit
-	  //
-	  // all we have to do here is remove this range from the free range dlist
-	  //  and add to the allocated lookup map
-	  ranges[r->prev_free].next_free = r->next_free;
-	  ranges[r->next_free].prev_free = r->prev_free;
-	} else {
-	  // case 2 - leftover at end - put in new range
-	  unsigned after_idx = alloc_range(alloc_last, r->last);
-	  Range *r_after = &ranges[after_idx];
-	  r = &ranges[idx];  // alloc may have moved this!
+
+      r->first = alloc_first;
+      // insert into all-block dllist
+      new_prev->prev = r->prev;
+      new_prev->next = idx;
+      ranges[r->prev].next = new_idx;
+      r->prev = new_idx;
+
+      new_prev->is_free = true;
+      add_to_free_index(new_idx);
+    }
+
+    // and after us?
+    if(alloc_last != r->last) {
+      unsigned after_idx = alloc_range(alloc_last, r->last);
+      Range *r_after = &ranges[after_idx];
+      r = &ranges[idx];  // alloc may have moved this!
 
 #ifdef DEBUG_REALM
-	  by_first[alloc_last] = after_idx;
+      by_first[alloc_last] = after_idx;
 #endif
-	  r->last = alloc_last;
-	  
-	  // r_after goes after r in all block list
-	  r_after->prev = idx;
-	  r_after->next = r->next;
-	  r->next = after_idx;
-	  ranges[r_after->next].prev = after_idx;
-
-	  // r_after replaces r in the free block list
-	  r_after->prev_free = r->prev_free;
-	  r_after->next_free = r->next_free;
-	  ranges[r_after->next_free].prev_free = after_idx;
-	  ranges[r_after->prev_free].next_free = after_idx;
-	}
-
-	// tie this off because we use it to detect allocated-ness
-	r->prev_free = r->next_free = idx;
-
-	allocated[tag] = idx;
-	return true;
-      }
+      r->last = alloc_last;
 
-      // no, go to next one
-      idx = r->next_free;
+      // r_after goes after r in all block list
+      r_after->prev = idx;
+      r_after->next = r->next;
+      r->next = after_idx;
+      ranges[r_after->next].prev = after_idx;
+
+      r_after->is_free = true;
+      add_to_free_index(after_idx);
     }
-    // allocation failed
-    return false;
+
+    r->is_free = false;
+
+    allocated[tag] = idx;
+    return true;
   }
 
   template <typename RT, typename TT>
@@ -263,87 +293,50 @@ namespace Realm {
     if(del_idx == SENTINEL)
       return;
 
-    Range& r = ranges[del_idx];
-
-    unsigned pf_idx = r.prev;
-    while((pf_idx != SENTINEL) && (ranges[pf_idx].prev_free == pf_idx)) {
-      pf_idx = ranges[pf_idx].prev;
-      assert(pf_idx != del_idx);  // wrapping around would be bad
-    }
-    unsigned nf_idx = r.next;
-    while((nf_idx != SENTINEL) && (ranges[nf_idx].next_free == nf_idx)) {
-      nf_idx = ranges[nf_idx].next;
-      assert(nf_idx != del_idx);
-    }
+    // only the immediate neighbors can be merged with (the sentinel is
+    //  never free)
+    unsigned pf_idx = ranges[del_idx].prev;
+    unsigned nf_idx = ranges[del_idx].next;
+    bool merge_prev = ranges[pf_idx].is_free;
+    bool merge_next = ranges[nf_idx].is_free;
 
-    // do we need to merge?
-    bool merge_prev = (pf_idx == r.prev) && (pf_idx != SENTINEL);
-    bool merge_next = (nf_idx == r.next) && (nf_idx != SENTINEL);
-
-    // four cases - ordered to match the allocation cases
-    if(!merge_next) {
-      if(!merge_prev) {
-	// case 1 - no merging (exact match)
-	// just add ourselves to the free list
-	r.prev_free = pf_idx;
-	r.next_free = nf_idx;
-	ranges[pf_idx].next_free = del_idx;
-	ranges[nf_idx].prev_free = del_idx;
-      } else {
-	// case 2 - merge before
-	// merge ourselves into the range before
-	Range& r_before = ranges[pf_idx];
+    unsigned free_idx = del_idx;
 
-	r_before.last = r.last;
-	r_before.next = r.next;
-	ranges[r.next].prev = pf_idx;
-	// r_before was already in free list, so no changes to that
+    if(merge_prev) {
+      // merge ourselves into the range before
+      Range& r = ranges[del_idx];
+      Range& r_before = ranges[pf_idx];
+      remove_from_free_index(pf_idx);
 
-#ifdef DEBUG_REALM
-	by_first.erase(r.first);
-#endif
-	free_range(del_idx);
-      }
-    } else {
-      if(!merge_prev) {
-	// case 3 - merge after
-	// merge ourselves into the range after
-	Range& r_after = ranges[nf_idx];
+      r_before.last = r.last;
+      r_before.next = r.next;
+      ranges[r.next].prev = pf_idx;
 
 #ifdef DEBUG_REALM
-	by_first[r.first] = nf_idx;
-	by_first.erase(r_after.first);
+      by_first.erase(r.first);
 #endif
+      free_range(del_idx);
+      free_idx = pf_idx;
+    }
 
-	r_after.first = r.first;
-	r_after.prev = r.prev;
-	ranges[r.prev].next = nf_idx;
-	// r_after was already in the free list, so no changes to that
+    if(merge_next) {
+      // merge the range after into whatever we've got so far
+      Range& r = ranges[free_idx];
+      Range& r_after = ranges[nf_idx];
+      remove_from_free_index(nf_idx);
 
-	free_range(del_idx);
-      } else {
-	// case 4 - merge both
-	// merge both ourselves and range after into range before
-	Range& r_before = ranges[pf_idx];
-	Range& r_after = ranges[nf_idx];
+      r.last = r_after.last;
+      r.next = r_after.next;
+      ranges[r_after.next].prev = free_idx;
 
-	r_before.last = r_after.last;
 #ifdef DEBUG_REALM
-	by_first.erase(r.first);
-	by_first.erase(r_after.first);
+      by_first.erase(r_after.first);
 #endif
-
-	// adjust both normal list and free list
-	r_before.next = r_after.next;
-	ranges[r_after.next].prev = pf_idx;
-
-	r_before.next_free = r_after.next_free;
-	ranges[r_after.next_free].prev_free = pf_idx;
-
-	free_range(del_idx);
-	free_range(nf_idx);
-      }
+      free_range(nf_idx);
     }
+
+    ranges[free_idx].is_free = true;
+    add_to_free_index(free_idx);
   }
   
   template <typename RT, typename TT>
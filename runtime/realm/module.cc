@@ -59,6 +59,9 @@
 #if defined REALM_USE_MPI
 #include "realm/mpi/mpi_module.h"
 #endif
+#ifdef REALM_USE_SHM
+#include "realm/shm/shm_module.h"
+#endif
 
 namespace Realm {
 
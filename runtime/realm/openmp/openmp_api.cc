@@ -19,6 +19,9 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
+
+#include <vector>
 
 namespace Realm {
   extern Logger log_omp;
@@ -107,6 +110,51 @@ extern "C" {
       log_omp.warning() << "omp_set_num_threads(" << num_threads << ") called on non-OpenMP Realm proessor - ignoring";
     }
   }
+
+  // omp_sched_t is an enum, but passed as an int
+  REALM_PUBLIC_API
+  void omp_set_schedule(int kind, int chunk_size)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info(false);
+    if(wi) {
+      // ignore the monotonic modifier bit
+      kind &= 0x7fffffff;
+      if((kind >= LoopSchedule::SCHEDULE_STATIC) &&
+	 (kind <= LoopSchedule::SCHEDULE_AUTO))
+	wi->pool->set_runtime_schedule(static_cast<LoopSchedule::ScheduleKind>(kind),
+				       chunk_size);
+      else
+	log_omp.warning() << "omp_set_schedule(" << kind << ", " << chunk_size << ") - unknown schedule kind ignored";
+    } else {
+      log_omp.warning() << "omp_set_schedule(" << kind << ", " << chunk_size << ") called on non-OpenMP Realm proessor - ignoring";
+    }
+  }
+
+  REALM_PUBLIC_API
+  void omp_get_schedule(int *kind, int *chunk_size)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info(false);
+    if(wi) {
+      LoopSchedule::ScheduleKind k;
+      int64_t chunk;
+      wi->pool->get_runtime_schedule(k, chunk);
+      *kind = k;
+      *chunk_size = chunk;
+    } else {
+      *kind = LoopSchedule::SCHEDULE_STATIC;
+      *chunk_size = 0;
+    }
+  }
+
+  REALM_PUBLIC_API
+  int omp_in_final(void)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info(false);
+    if(wi && wi->current_task && wi->current_task->final)
+      return 1;
+    else
+      return 0;
+  }
 };
 
 // runtime API calls used by compiler to interact with GOMP-style runtime
@@ -152,6 +200,9 @@ extern "C" {
     if(!wi)
       return;
 
+    // the master also helps run any tasks created in the region
+    wi->finish_implicit_task();
+
     ThreadPool::WorkItem *work = wi->pop_work_item();
     assert(work != 0);
     // make sure all workers have finished
@@ -212,7 +263,10 @@ extern "C" {
       // step 2: increment counter to enter
       c = wi->work_item->barrier_count.fetch_add(1) + 1;
       if(c == wi->num_threads) {
-	// last arriver - reset count once all others have exited
+	// last arriver - all tasks created before the barrier must be
+	//  complete before anybody leaves
+	wi->wait_for_team_tasks();
+	// reset count once all others have exited
 	//   reset "single" winner too
 	wi->work_item->single_winner.store(-1);
 	while(true) {
@@ -221,10 +275,16 @@ extern "C" {
 	    break;
 	}
       } else {
-	// step 3: observe that all threads have entered
+	// step 3: observe that all threads have entered, running tasks
+	//  while we wait
 	do {
 	  c = wi->work_item->barrier_count.load();
+	  if((c < wi->num_threads) && !wi->execute_one_task())
+	    Thread::yield();
 	} while(c < wi->num_threads);
+	// nobody outside a task can create new ones now, so once the count
+	//  of outstanding tasks drops to zero, it stays there
+	wi->wait_for_team_tasks();
 	// step 4: increment counter again to exit
 	wi->work_item->barrier_count.fetch_add(1);
       }
@@ -297,6 +357,95 @@ extern "C" {
     return more;
   }
 
+  REALM_PUBLIC_API
+  bool GOMP_loop_guided_start(long start, long end, long incr, long chunk,
+			      long *istart, long *iend)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info(true);
+    if(!wi) {
+      // give back the whole loop and hope for the best
+      *istart = start;
+      *iend = end;
+      return (start < end);
+    }
+
+    // loops must be inside work items
+    assert(wi->work_item != 0);
+
+    log_omp.debug() << "loop guided start: start=" << start
+		    << " end=" << end << " incr=" << incr
+		    << " chunk=" << chunk;
+
+    wi->work_item->schedule.start_guided(start, end, incr, chunk);
+    int64_t span_start, span_end;
+    int64_t stride = 0; // not used
+    bool more = wi->work_item->schedule.next_dynamic(span_start, span_end, stride);
+    if(more) {
+      *istart = span_start;
+      *iend = span_end;
+    }
+    return more;
+  }
+
+  REALM_PUBLIC_API
+  bool GOMP_loop_runtime_start(long start, long end, long incr,
+			       long *istart, long *iend)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info(true);
+    if(!wi) {
+      // give back the whole loop and hope for the best
+      *istart = start;
+      *iend = end;
+      return (start < end);
+    }
+
+    LoopSchedule::ScheduleKind kind;
+    int64_t chunk;
+    wi->pool->get_runtime_schedule(kind, chunk);
+    switch(kind) {
+    case LoopSchedule::SCHEDULE_STATIC:
+      return GOMP_loop_static_start(start, end, incr, chunk, istart, iend);
+    case LoopSchedule::SCHEDULE_GUIDED:
+      return GOMP_loop_guided_start(start, end, incr, chunk, istart, iend);
+    default:
+      // "auto" is our choice, and dynamic is the safe one
+      return GOMP_loop_dynamic_start(start, end, incr, chunk, istart, iend);
+    }
+  }
+
+  // the nonmonotonic variants are free to hand out chunks in any order,
+  //  so the monotonic implementations work for them too
+  REALM_PUBLIC_API
+  bool GOMP_loop_nonmonotonic_dynamic_start(long start, long end, long incr,
+					    long chunk,
+					    long *istart, long *iend)
+  {
+    return GOMP_loop_dynamic_start(start, end, incr, chunk, istart, iend);
+  }
+
+  REALM_PUBLIC_API
+  bool GOMP_loop_nonmonotonic_guided_start(long start, long end, long incr,
+					   long chunk,
+					   long *istart, long *iend)
+  {
+    return GOMP_loop_guided_start(start, end, incr, chunk, istart, iend);
+  }
+
+  REALM_PUBLIC_API
+  bool GOMP_loop_nonmonotonic_runtime_start(long start, long end, long incr,
+					    long *istart, long *iend)
+  {
+    return GOMP_loop_runtime_start(start, end, incr, istart, iend);
+  }
+
+  REALM_PUBLIC_API
+  bool GOMP_loop_maybe_nonmonotonic_runtime_start(long start, long end,
+						  long incr,
+						  long *istart, long *iend)
+  {
+    return GOMP_loop_runtime_start(start, end, incr, istart, iend);
+  }
+
   REALM_PUBLIC_API
   void GOMP_loop_end_nowait(void)
   {
@@ -337,7 +486,9 @@ extern "C" {
     // loops must be inside work items
     assert(wi->work_item != 0);
 
-    int64_t span_start, span_end;
+    // next_static steps from the previous span
+    int64_t span_start = *istart;
+    int64_t span_end = *iend;
     bool more = wi->work_item->schedule.next_static(span_start, span_end);
 
     if(more) {
@@ -379,6 +530,54 @@ extern "C" {
     return more;
   }
 
+  REALM_PUBLIC_API
+  bool GOMP_loop_guided_next(long *istart, long *iend)
+  {
+    // guided loops are continued the same way as dynamic ones
+    return GOMP_loop_dynamic_next(istart, iend);
+  }
+
+  REALM_PUBLIC_API
+  bool GOMP_loop_runtime_next(long *istart, long *iend)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info(false);
+    if(!wi)
+      return false;  // complained already above
+
+    // loops must be inside work items
+    assert(wi->work_item != 0);
+
+    // continue however the loop was started
+    if(wi->work_item->schedule.get_kind() == LoopSchedule::SCHEDULE_STATIC)
+      return GOMP_loop_static_next(istart, iend);
+    else
+      return GOMP_loop_dynamic_next(istart, iend);
+  }
+
+  REALM_PUBLIC_API
+  bool GOMP_loop_nonmonotonic_dynamic_next(long *istart, long *iend)
+  {
+    return GOMP_loop_dynamic_next(istart, iend);
+  }
+
+  REALM_PUBLIC_API
+  bool GOMP_loop_nonmonotonic_guided_next(long *istart, long *iend)
+  {
+    return GOMP_loop_dynamic_next(istart, iend);
+  }
+
+  REALM_PUBLIC_API
+  bool GOMP_loop_nonmonotonic_runtime_next(long *istart, long *iend)
+  {
+    return GOMP_loop_runtime_next(istart, iend);
+  }
+
+  REALM_PUBLIC_API
+  bool GOMP_loop_maybe_nonmonotonic_runtime_next(long *istart, long *iend)
+  {
+    return GOMP_loop_runtime_next(istart, iend);
+  }
+
   static unsigned hash_gomp_critical_name(void **pptr)
   {
     uintptr_t v = reinterpret_cast<uintptr_t>(pptr);
@@ -454,6 +653,118 @@ extern "C" {
   {
     gomp_atomic_mutex.unlock();
   }
+
+  // flags passed to GOMP_task
+  enum {
+    GOMP_TASK_FLAG_UNTIED = 1,
+    GOMP_TASK_FLAG_FINAL = 2,
+    GOMP_TASK_FLAG_MERGEABLE = 4,
+    GOMP_TASK_FLAG_DEPEND = 8,
+  };
+
+  // dependence kinds used for depobj entries
+  enum {
+    GOMP_DEPEND_IN = 1,
+  };
+
+  // converts libgomp's depend array - older compilers pass
+  //  { ndeps, nout, addrs... }, newer ones pass
+  //  { 0, ndeps, nout, nmutexinoutset, nin, addrs... } followed by any
+  //  depobj's, each of which points at an { addr, kind } pair - returns
+  //  true if the task depends on omp_all_memory
+  static bool gomp_convert_depend(void **depend,
+				  std::vector<ThreadPool::TaskDependence>& deps)
+  {
+    size_t ndeps = reinterpret_cast<uintptr_t>(depend[0]);
+    size_t nout, nin, first;
+    if(ndeps != 0) {
+      nout = reinterpret_cast<uintptr_t>(depend[1]);
+      nin = ndeps - nout;
+      first = 2;
+    } else {
+      ndeps = reinterpret_cast<uintptr_t>(depend[1]);
+      nout = (reinterpret_cast<uintptr_t>(depend[2]) +
+	      reinterpret_cast<uintptr_t>(depend[3]));
+      nin = reinterpret_cast<uintptr_t>(depend[4]);
+      first = 5;
+    }
+    bool all_memory = false;
+    deps.resize(ndeps);
+    for(size_t i = 0; i < ndeps; i++) {
+      if(i < (nout + nin)) {
+	deps[i].addr = reinterpret_cast<uintptr_t>(depend[first + i]);
+	deps[i].is_out = (i < nout);
+      } else {
+	void **obj = static_cast<void **>(depend[first + i]);
+	deps[i].addr = reinterpret_cast<uintptr_t>(obj[0]);
+	deps[i].is_out = (reinterpret_cast<uintptr_t>(obj[1]) != GOMP_DEPEND_IN);
+      }
+      // omp_all_memory is an out dependence on a null address
+      if((deps[i].addr == 0) && deps[i].is_out)
+	all_memory = true;
+    }
+    return all_memory;
+  }
+
+  REALM_PUBLIC_API
+  void GOMP_task(void (*fnptr)(void *data), void *data,
+		 void (*cpyfn)(void *dst, void *src),
+		 long arg_size, long arg_align, bool if_clause,
+		 unsigned flags, void **depend, int priority)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info(true);
+
+    // dependences only order siblings, so they don't matter outside of a
+    //  parallel region - a dependence on omp_all_memory is satisfied by
+    //  waiting for every earlier sibling and running the task right away
+    std::vector<ThreadPool::TaskDependence> deps;
+    bool all_memory = false;
+    if(wi && wi->work_item && ((flags & GOMP_TASK_FLAG_DEPEND) != 0)) {
+      all_memory = gomp_convert_depend(depend, deps);
+      if(all_memory) {
+	wi->wait_for_child_tasks();
+	deps.clear();
+      }
+    }
+
+    ThreadPool::TaskItem *task = ThreadPool::TaskItem::create(fnptr,
+							      arg_size,
+							      arg_align);
+    if(cpyfn)
+      (*cpyfn)(task->data, data);
+    else if(arg_size > 0)
+      memcpy(task->data, data, arg_size);
+    task->final = ((flags & GOMP_TASK_FLAG_FINAL) != 0);
+
+    if(!wi || !wi->work_item) {
+      // not inside a parallel region - just run the task
+      (*fnptr)(task->data);
+      task->remove_reference();
+      return;
+    }
+
+    bool deferred = (if_clause && (wi->num_threads > 1) && !all_memory);
+    wi->spawn_task(task, deferred,
+		   (deps.empty() ? 0 : &deps[0]), deps.size());
+  }
+
+  REALM_PUBLIC_API
+  void GOMP_taskwait(void)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info(false);
+    if(wi)
+      wi->wait_for_child_tasks();
+  }
+
+  REALM_PUBLIC_API
+  void GOMP_taskyield(void)
+  {
+    // the yielding task stays on this thread, but another ready task can
+    //  be run on top of it
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info(false);
+    if(wi && wi->work_item)
+      wi->yield_to_task();
+  }
 };
 #endif
 
@@ -885,6 +1196,9 @@ extern "C" {
     // in kmp version, we invoke the thunk for the master ourselves
     (*invoker)(&thunk);
 
+    // the master also helps run any tasks created in the region
+    wi->finish_implicit_task();
+
     // and then we immediately clean things up (c.f. GOMP_parallel_end)
     ThreadPool::WorkItem *work2 = wi->pop_work_item();
     assert(work == work2);
@@ -969,12 +1283,38 @@ namespace Realm {
     // kmp uses an inclusive upper bound, so add the increment to get
     //  the exclusive form
     ub += st;
-      
-    log_omp.debug() << "loop dynamic start: start=" << lb
-		    << " end=" << ub << " incr=" << st
-		    << " chunk=" << chunk;
 
-    wi->work_item->schedule.start_dynamic(lb, ub, st, chunk);
+    // strip the monotonic/nonmonotonic modifiers, which we're free to
+    //  ignore
+    schedtype &= ~((1 << 29) | (1 << 30));
+    // pick up the current schedule for "schedule(runtime)"
+    bool guided;
+    if(schedtype == 37 /* kmp_sch_runtime */) {
+      LoopSchedule::ScheduleKind kind;
+      int64_t runtime_chunk;
+      wi->pool->get_runtime_schedule(kind, runtime_chunk);
+      guided = (kind == LoopSchedule::SCHEDULE_GUIDED);
+      chunk = runtime_chunk;
+    } else
+      guided = ((schedtype == 36 /* kmp_sch_guided_chunked */) ||
+		(schedtype == 42 /* kmp_sch_guided_iterative_chunked */) ||
+		(schedtype == 43 /* kmp_sch_guided_analytical_chunked */));
+
+    // everything else (including static schedules that show up here for
+    //  ordered or runtime loops) is handed out dynamically
+    if(guided) {
+      log_omp.debug() << "loop guided start: start=" << lb
+		      << " end=" << ub << " incr=" << st
+		      << " chunk=" << chunk;
+
+      wi->work_item->schedule.start_guided(lb, ub, st, chunk);
+    } else {
+      log_omp.debug() << "loop dynamic start: start=" << lb
+		      << " end=" << ub << " incr=" << st
+		      << " chunk=" << chunk;
+
+      wi->work_item->schedule.start_dynamic(lb, ub, st, chunk);
+    }
   }
 
   // templated code for __kmpc_dispatch_init_{4,4u,8,8u}
@@ -1011,6 +1351,139 @@ namespace Realm {
       return 0;
     }
   }
+
+  // shared code for __kmpc_reduce{,_nowait} - the team combines its
+  //  private copies pairwise up a binomial tree, with thread 0 ending up
+  //  with the whole thing - it returns 1 so that the caller folds that
+  //  into the shared variables and everybody else returns 0
+  static kmp_int32 kmpc_tree_reduce(void *reduce_data,
+				    kmpc_reduce reduce_func,
+				    bool wait)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info(true);
+    if(!wi || !wi->work_item || (wi->num_threads == 1)) {
+      // single-threaded, so the caller can just do it
+      return 1;
+    }
+
+    ThreadPool::WorkItem *item = wi->work_item;
+    int tid = wi->thread_id;
+    int gen = ++(item->reduce_generation[tid]);
+    item->reduce_data[tid] = reduce_data;
+
+    for(int step = 1; step < wi->num_threads; step <<= 1) {
+      if((tid & step) != 0) {
+	// hand our partial result to (tid - step) and wait for it to be
+	//  consumed before our private copies can go away
+	item->reduce_ready[tid].store_release(gen);
+	while(item->reduce_consumed[tid].load_acquire() < gen)
+	  if(!wi->execute_one_task())
+	    Thread::yield();
+	// a blocking reduction is also a barrier, so wait for thread 0's
+	//  __kmpc_end_reduce
+	if(wait)
+	  while(item->reduce_release.load_acquire() < gen)
+	    if(!wi->execute_one_task())
+	      Thread::yield();
+	return 0;
+      }
+
+      int partner = tid + step;
+      if(partner < wi->num_threads) {
+	while(item->reduce_ready[partner].load_acquire() < gen)
+	  if(!wi->execute_one_task())
+	    Thread::yield();
+	(*reduce_func)(reduce_data, item->reduce_data[partner]);
+	item->reduce_consumed[partner].store_release(gen);
+      }
+    }
+
+    // only thread 0 makes it all the way up the tree
+    assert(tid == 0);
+    return 1;
+  }
+
+  // layout of the task descriptor the compiler fills in
+  typedef kmp_int32 (*kmp_routine_entry_t)(kmp_int32 gtid, void *task);
+  typedef union kmp_cmplrdata {
+    kmp_int32 priority;
+    kmp_routine_entry_t destructors;
+  } kmp_cmplrdata_t;
+  typedef struct kmp_task {
+    void *shareds;
+    kmp_routine_entry_t routine;
+    kmp_int32 part_id;
+    kmp_cmplrdata_t data1;
+    kmp_cmplrdata_t data2;
+  } kmp_task_t;
+
+  // one entry of a depend clause passed to __kmpc_omp_task_with_deps
+  typedef struct kmp_depend_info {
+    intptr_t base_addr;
+    size_t len;
+    uint8_t flags;  // only the low byte of the compiler's flag union is used
+  } kmp_depend_info_t;
+
+  // bits in kmp_depend_info_t::flags
+  enum {
+    KMP_DEPEND_IN = 1,
+    KMP_DEPEND_OUT = 2,
+    KMP_DEPEND_MTX = 4,
+    KMP_DEPEND_ALL = 0x80,  // omp_all_memory
+  };
+
+  // appends the entries of a kmp depend list - returns true if the task
+  //  depends on omp_all_memory
+  static bool kmp_convert_depend(kmp_int32 ndeps,
+				 const kmp_depend_info_t *dep_list,
+				 std::vector<ThreadPool::TaskDependence>& deps)
+  {
+    bool all_memory = false;
+    for(kmp_int32 i = 0; i < ndeps; i++) {
+      if((dep_list[i].flags & KMP_DEPEND_ALL) != 0)
+	all_memory = true;
+      ThreadPool::TaskDependence d;
+      d.addr = dep_list[i].base_addr;
+      d.is_out = ((dep_list[i].flags & (KMP_DEPEND_OUT | KMP_DEPEND_MTX)) != 0);
+      deps.push_back(d);
+    }
+    return all_memory;
+  }
+
+  // flags passed to __kmpc_omp_task_alloc
+  enum {
+    KMP_TASK_FLAG_TIED = 1,
+    KMP_TASK_FLAG_FINAL = 2,
+    KMP_TASK_FLAG_MERGED_IF0 = 4,
+    KMP_TASK_FLAG_DESTRUCTORS_THUNK = 8,
+  };
+
+  // a kmp task lives in the argument data of a ThreadPool::TaskItem, after
+  //  a small header that lets us find the TaskItem again
+  struct kmp_task_header {
+    ThreadPool::TaskItem *task;
+    kmp_int32 flags;
+  };
+
+  static const size_t KMP_TASK_HEADER_SIZE = 16;
+
+  static inline kmp_task_header *kmp_get_task_header(kmp_task_t *kmp_task)
+  {
+    return reinterpret_cast<kmp_task_header *>(reinterpret_cast<char *>(kmp_task) -
+					       KMP_TASK_HEADER_SIZE);
+  }
+
+  static void kmp_task_invoke(void *data)
+  {
+    kmp_task_header *hdr = static_cast<kmp_task_header *>(data);
+    kmp_task_t *kmp_task =
+      reinterpret_cast<kmp_task_t *>(static_cast<char *>(data) +
+				     KMP_TASK_HEADER_SIZE);
+    kmp_int32 gtid = omp_get_thread_num();
+    (kmp_task->routine)(gtid, kmp_task);
+    if((hdr->flags & KMP_TASK_FLAG_DESTRUCTORS_THUNK) != 0)
+      (kmp_task->data1.destructors)(gtid, kmp_task);
+  }
     
 };
 
@@ -1163,15 +1636,38 @@ extern "C" {
 				 void *reduce_data, kmpc_reduce reduce_func,
 				 kmp_critical_name *lck)
   {
-    // tell caller to just do it themselves in all cases
-    return 2;
+    return kmpc_tree_reduce(reduce_data, reduce_func, false /*!wait*/);
   }
 
   REALM_PUBLIC_API
   void __kmpc_end_reduce_nowait(ident_t *loc, kmp_int32 global_tid,
 				kmp_critical_name *lck)
   {
-    // do nothing
+    // nobody is waiting on us
+  }
+
+  REALM_PUBLIC_API
+  kmp_int32 __kmpc_reduce(ident_t *loc, kmp_int32 global_tid,
+			  kmp_int32 nvars, size_t reduce_size,
+			  void *reduce_data, kmpc_reduce reduce_func,
+			  kmp_critical_name *lck)
+  {
+    return kmpc_tree_reduce(reduce_data, reduce_func, true /*wait*/);
+  }
+
+  REALM_PUBLIC_API
+  void __kmpc_end_reduce(ident_t *loc, kmp_int32 global_tid,
+			 kmp_critical_name *lck)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info(false);
+    if(!wi || !wi->work_item || (wi->num_threads == 1))
+      return;
+
+    // this is the end of the barrier implied by the reduction, so tasks
+    //  have to be done too, then the rest of the team can be released
+    wi->wait_for_team_tasks();
+    ThreadPool::WorkItem *item = wi->work_item;
+    item->reduce_release.store_release(item->reduce_generation[wi->thread_id]);
   }
 
   REALM_PUBLIC_API
@@ -1253,7 +1749,10 @@ extern "C" {
       // step 2: increment counter to enter
       c = wi->work_item->barrier_count.fetch_add(1) + 1;
       if(c == wi->num_threads) {
-	// last arriver - reset count once all others have exited
+	// last arriver - all tasks created before the barrier must be
+	//  complete before anybody leaves
+	wi->wait_for_team_tasks();
+	// reset count once all others have exited
 	//   reset "single" winner too
 	wi->work_item->single_winner.store(-1);
 	while(true) {
@@ -1262,10 +1761,16 @@ extern "C" {
 	    break;
 	}
       } else {
-	// step 3: observe that all threads have entered
+	// step 3: observe that all threads have entered, running tasks
+	//  while we wait
 	do {
 	  c = wi->work_item->barrier_count.load();
+	  if((c < wi->num_threads) && !wi->execute_one_task())
+	    Thread::yield();
 	} while(c < wi->num_threads);
+	// nobody outside a task can create new ones now, so once the count
+	//  of outstanding tasks drops to zero, it stays there
+	wi->wait_for_team_tasks();
 	// step 4: increment counter again to exit
 	wi->work_item->barrier_count.fetch_add(1);
       }
@@ -1325,5 +1830,149 @@ extern "C" {
     assert((orig & mask) != 0);
   }
 
+  REALM_PUBLIC_API
+  kmp_task_t *__kmpc_omp_task_alloc(ident_t *loc, kmp_int32 global_tid,
+				    kmp_int32 flags,
+				    size_t sizeof_kmp_task_t,
+				    size_t sizeof_shareds,
+				    kmp_routine_entry_t task_entry)
+  {
+    // the compiler puts the task's private data at the end of what it
+    //  calls kmp_task_t, and the shared data separately
+    size_t shareds_offset = ((sizeof_kmp_task_t + sizeof(void *) - 1) /
+			     sizeof(void *)) * sizeof(void *);
+    ThreadPool::TaskItem *task =
+      ThreadPool::TaskItem::create(&kmp_task_invoke,
+				   (KMP_TASK_HEADER_SIZE +
+				    shareds_offset + sizeof_shareds),
+				   KMP_TASK_HEADER_SIZE);
+    task->final = ((flags & KMP_TASK_FLAG_FINAL) != 0);
+
+    kmp_task_header *hdr = static_cast<kmp_task_header *>(task->data);
+    hdr->task = task;
+    hdr->flags = flags;
+    kmp_task_t *kmp_task =
+      reinterpret_cast<kmp_task_t *>(static_cast<char *>(task->data) +
+				     KMP_TASK_HEADER_SIZE);
+    kmp_task->shareds = (sizeof_shareds ?
+			   (reinterpret_cast<char *>(kmp_task) + shareds_offset) :
+			   0);
+    kmp_task->routine = task_entry;
+    kmp_task->part_id = 0;
+    return kmp_task;
+  }
+
+  REALM_PUBLIC_API
+  kmp_int32 __kmpc_omp_task(ident_t *loc, kmp_int32 global_tid,
+			    kmp_task_t *new_task)
+  {
+    ThreadPool::TaskItem *task = kmp_get_task_header(new_task)->task;
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info(true);
+    if(!wi || !wi->work_item) {
+      // not inside a parallel region - just run the task
+      kmp_task_invoke(task->data);
+      task->remove_reference();
+    } else
+      wi->spawn_task(task, (wi->num_threads > 1) /*deferred*/);
+    return 0; // TASK_CURRENT_NOT_QUEUED
+  }
+
+  REALM_PUBLIC_API
+  kmp_int32 __kmpc_omp_task_with_deps(ident_t *loc, kmp_int32 global_tid,
+				      kmp_task_t *new_task,
+				      kmp_int32 ndeps,
+				      kmp_depend_info_t *dep_list,
+				      kmp_int32 ndeps_noalias,
+				      kmp_depend_info_t *noalias_dep_list)
+  {
+    ThreadPool::TaskItem *task = kmp_get_task_header(new_task)->task;
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info(true);
+    if(!wi || !wi->work_item) {
+      // not inside a parallel region - just run the task
+      kmp_task_invoke(task->data);
+      task->remove_reference();
+      return 0;
+    }
+
+    std::vector<ThreadPool::TaskDependence> deps;
+    bool all_memory = (kmp_convert_depend(ndeps, dep_list, deps) |
+		       kmp_convert_depend(ndeps_noalias, noalias_dep_list, deps));
+    if(all_memory) {
+      // wait for every earlier sibling and then run the task right away
+      wi->wait_for_child_tasks();
+      wi->spawn_task(task, false /*!deferred*/);
+    } else
+      wi->spawn_task(task, (wi->num_threads > 1) /*deferred*/,
+		     (deps.empty() ? 0 : &deps[0]), deps.size());
+    return 0; // TASK_CURRENT_NOT_QUEUED
+  }
+
+  REALM_PUBLIC_API
+  void __kmpc_omp_wait_deps(ident_t *loc, kmp_int32 global_tid,
+			    kmp_int32 ndeps, kmp_depend_info_t *dep_list,
+			    kmp_int32 ndeps_noalias,
+			    kmp_depend_info_t *noalias_dep_list)
+  {
+    // called before an undeferred task with dependences is run inline
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info(false);
+    if(!wi || !wi->work_item)
+      return;
+
+    std::vector<ThreadPool::TaskDependence> deps;
+    bool all_memory = (kmp_convert_depend(ndeps, dep_list, deps) |
+		       kmp_convert_depend(ndeps_noalias, noalias_dep_list, deps));
+    if(all_memory)
+      wi->wait_for_child_tasks();
+    else if(!deps.empty())
+      wi->wait_for_dependences(&deps[0], deps.size());
+  }
+
+  REALM_PUBLIC_API
+  void __kmpc_omp_task_begin_if0(ident_t *loc, kmp_int32 global_tid,
+				 kmp_task_t *new_task)
+  {
+    // the compiler runs the task body itself after this
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info(false);
+    if(wi && wi->work_item)
+      wi->begin_task(kmp_get_task_header(new_task)->task);
+  }
+
+  REALM_PUBLIC_API
+  void __kmpc_omp_task_complete_if0(ident_t *loc, kmp_int32 global_tid,
+				    kmp_task_t *new_task)
+  {
+    kmp_task_header *hdr = kmp_get_task_header(new_task);
+    if((hdr->flags & KMP_TASK_FLAG_DESTRUCTORS_THUNK) != 0)
+      (new_task->data1.destructors)(global_tid, new_task);
+    ThreadPool::TaskItem *task = hdr->task;
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info(false);
+    if(task->work_item) {
+      assert(wi != 0);
+      wi->end_task(task);
+    } else
+      task->remove_reference();
+  }
+
+  REALM_PUBLIC_API
+  kmp_int32 __kmpc_omp_taskwait(ident_t *loc, kmp_int32 global_tid)
+  {
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info(false);
+    if(wi)
+      wi->wait_for_child_tasks();
+    return 0;
+  }
+
+  REALM_PUBLIC_API
+  kmp_int32 __kmpc_omp_taskyield(ident_t *loc, kmp_int32 global_tid,
+				 int end_part)
+  {
+    // the yielding task stays on this thread, but another ready task can
+    //  be run on top of it
+    Realm::ThreadPool::WorkerInfo *wi = Realm::ThreadPool::get_worker_info(false);
+    if(wi && wi->work_item)
+      wi->yield_to_task();
+    return 0;
+  }
+
 };
 #endif
@@ -18,6 +18,11 @@
 
 #include "realm/logging.h"
 
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <new>
+
 namespace Realm {
 
   Logger log_pool("threadpool");
@@ -35,6 +40,7 @@ namespace Realm {
     num_workers = _num_workers;
     loop_pos.store(0);
     loop_barrier.store(0);
+    loop_kind.store(SCHEDULE_STATIC);
   }
 
   static inline uint64_t index_to_pos(int64_t index,
@@ -97,6 +103,7 @@ namespace Realm {
     loop_base.store(start);
     loop_incr.store(incr);
     loop_chunk.store(chunk);
+    loop_kind.store(SCHEDULE_STATIC);
 
     // signal that we're in the loop
     loop_barrier.fetch_add(1);
@@ -176,6 +183,44 @@ namespace Realm {
     loop_base.store(start);
     loop_incr.store(incr);
     loop_chunk.store(chunk);
+    loop_kind.store(SCHEDULE_DYNAMIC);
+
+    // signal that we're in the loop
+    loop_barrier.fetch_add(1);
+  }
+
+  void LoopSchedule::start_guided(int64_t start, int64_t end,
+				  int64_t incr, int64_t chunk)
+  {
+    // make sure nobody's still on the previous loop
+    while(loop_barrier.load() >= num_workers) Thread::yield();
+
+    // compute the loop limit, dealing with the negative stride cases
+    uint64_t limit;
+    if(incr > 0) {
+      limit = ((end >= start) ?
+	         index_to_pos(end, start, incr) :
+	         0);
+    } else {
+      limit = ((end <= start) ?
+	         index_to_pos(end, start, incr) :
+	         0);
+    }
+
+    // the chunk is only a lower bound on the size of each piece handed
+    //  out - unlike dynamic loops, guided loops never overshoot the limit
+    if(chunk <= 0)
+      chunk = 1;
+
+    // the compiler promises all threads will have the same value, so
+    //  everybody can just store knowing that either they're first or
+    //  they're writing the same thing as everybody else
+    // (loop_pos was reset to 0 at the end of the previous loop)
+    loop_limit.store(limit);
+    loop_base.store(start);
+    loop_incr.store(incr);
+    loop_chunk.store(chunk);
+    loop_kind.store(SCHEDULE_GUIDED);
 
     // signal that we're in the loop
     loop_barrier.fetch_add(1);
@@ -189,6 +234,25 @@ namespace Realm {
     int64_t incr = loop_incr.load();
     int64_t chunk = loop_chunk.load();
     uint64_t limit = loop_limit.load();
+
+    if(loop_kind.load() == SCHEDULE_GUIDED) {
+      // claim 1/num_workers of whatever is left (but at least a chunk),
+      //  retrying if somebody else claimed something first
+      uint64_t old_pos = loop_pos.load();
+      while(old_pos < limit) {
+	uint64_t remaining = limit - old_pos;
+	uint64_t count = (remaining + num_workers - 1) / num_workers;
+	if(count < (uint64_t)chunk)
+	  count = std::min((uint64_t)chunk, remaining);
+	if(loop_pos.compare_exchange(old_pos, old_pos + count)) {
+	  span_start = pos_to_index(old_pos, base, incr);
+	  span_end = pos_to_index(old_pos + count, base, incr);
+	  stride = incr;
+	  return true;
+	}
+      }
+      return false;
+    }
       
     // atomic increment to claim a new chunk
     uint64_t new_pos = loop_pos.fetch_add(chunk);
@@ -238,6 +302,79 @@ namespace Realm {
     loop_barrier.store_release(0);
   }
 
+  LoopSchedule::ScheduleKind LoopSchedule::get_kind(void) const
+  {
+    return static_cast<ScheduleKind>(loop_kind.load());
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class ThreadPool::DependenceMap
+
+  ThreadPool::DependenceMap::~DependenceMap(void)
+  {
+    clear();
+  }
+
+  void ThreadPool::DependenceMap::clear(void)
+  {
+    for(std::map<uintptr_t, Entry>::iterator it = entries.begin();
+	it != entries.end();
+	++it) {
+      if(it->second.last_out)
+	it->second.last_out->remove_reference();
+      for(std::vector<TaskItem *>::iterator it2 = it->second.last_ins.begin();
+	  it2 != it->second.last_ins.end();
+	  ++it2)
+	(*it2)->remove_reference();
+    }
+    entries.clear();
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class ThreadPool::TaskItem
+
+  /*static*/ ThreadPool::TaskItem *ThreadPool::TaskItem::create(void (*_fnptr)(void *data),
+								  size_t data_size,
+								  size_t data_align)
+  {
+    // the argument data goes after the task, with enough slack to honor
+    //  alignments larger than malloc's
+    if(data_align < 1)
+      data_align = 1;
+    void *mem = malloc(sizeof(TaskItem) + data_align - 1 + data_size);
+    assert(mem != 0);
+    TaskItem *task = new(mem) TaskItem;
+    uintptr_t data = reinterpret_cast<uintptr_t>(mem) + sizeof(TaskItem);
+    data = ((data + data_align - 1) / data_align) * data_align;
+    task->fnptr = _fnptr;
+    task->data = reinterpret_cast<void *>(data);
+    task->work_item = 0;
+    task->parent = 0;
+    task->parent_children = 0;
+    task->children.store(0);
+    task->references.store(1);
+    task->final = false;
+    task->deferred = false;
+    task->pending_deps.store(0);
+    task->completed.store(0);
+    task->child_deps = 0;
+    return task;
+  }
+
+  void ThreadPool::TaskItem::remove_reference(void)
+  {
+    if(references.fetch_sub_acqrel(1) == 1) {
+      if(child_deps)
+	delete child_deps;
+      this->~TaskItem();
+      free(this);
+    }
+  }
+
 
   ////////////////////////////////////////////////////////////////////////
   //
@@ -248,8 +385,45 @@ namespace Realm {
     , single_winner(-1)
     , barrier_count(0)
     , critical_flags(0)
+    , num_threads(_num_threads)
+    , outstanding_tasks(0)
+    , any_tasks(0)
+    , running_implicit(_num_threads)
+    , reduce_release(0)
   {
     schedule.initialize(_num_threads);
+
+    task_queues = new TaskQueue[_num_threads];
+    implicit_children = new atomic<int>[_num_threads];
+    implicit_deps = new DependenceMap *[_num_threads];
+    reduce_data = new void *[_num_threads];
+    reduce_ready = new atomic<int>[_num_threads];
+    reduce_consumed = new atomic<int>[_num_threads];
+    reduce_generation = new int[_num_threads];
+    for(int i = 0; i < _num_threads; i++) {
+      implicit_children[i].store(0);
+      implicit_deps[i] = 0;
+      reduce_data[i] = 0;
+      reduce_ready[i].store(0);
+      reduce_consumed[i].store(0);
+      reduce_generation[i] = 0;
+    }
+  }
+
+  ThreadPool::WorkItem::~WorkItem(void)
+  {
+    // all tasks must have been run before the team is torn down
+    assert(outstanding_tasks.load() == 0);
+    delete[] task_queues;
+    delete[] implicit_children;
+    for(int i = 0; i < num_threads; i++)
+      if(implicit_deps[i])
+	delete implicit_deps[i];
+    delete[] implicit_deps;
+    delete[] reduce_data;
+    delete[] reduce_ready;
+    delete[] reduce_consumed;
+    delete[] reduce_generation;
   }
 
 
@@ -261,8 +435,10 @@ namespace Realm {
   {
     new_work->prev_thread_id = thread_id;
     new_work->prev_num_threads = num_threads;
+    new_work->prev_task = current_task;
     new_work->parent_work_item = work_item;
     work_item = new_work;
+    current_task = 0;
   }
 
   ThreadPool::WorkItem *ThreadPool::WorkerInfo::pop_work_item(void)
@@ -270,10 +446,284 @@ namespace Realm {
     WorkItem *old_item = work_item;
     thread_id = old_item->prev_thread_id;
     num_threads = old_item->prev_num_threads;
+    current_task = old_item->prev_task;
     work_item = old_item->parent_work_item;
     return old_item;
   }
 
+  void ThreadPool::WorkerInfo::attach_task(TaskItem *task)
+  {
+    assert(work_item != 0);
+    task->work_item = work_item;
+    task->parent = current_task;
+    if(current_task) {
+      task->parent_children = &current_task->children;
+      // the parent can't go away until its children are done with it
+      current_task->references.fetch_add(1);
+      if(current_task->final)
+	task->final = true;
+    } else
+      task->parent_children = &work_item->implicit_children[thread_id];
+    task->parent_children->fetch_add(1);
+    work_item->outstanding_tasks.fetch_add(1);
+    if(work_item->any_tasks.load() == 0)
+      work_item->any_tasks.store(1);
+  }
+
+  ThreadPool::DependenceMap& ThreadPool::WorkerInfo::current_dependences(void)
+  {
+    DependenceMap *&dmap = (current_task ?
+			      current_task->child_deps :
+			      work_item->implicit_deps[thread_id]);
+    if(!dmap)
+      dmap = new DependenceMap;
+    return *dmap;
+  }
+
+  void ThreadPool::WorkerInfo::enqueue_task(TaskItem *task)
+  {
+    TaskQueue& q = work_item->task_queues[thread_id];
+    AutoLock<> al(q.mutex);
+    q.tasks.push_back(task);
+  }
+
+  // makes 'task' wait for 'pred' unless the predecessor is already done
+  static void add_predecessor(ThreadPool::TaskItem *task,
+			      ThreadPool::TaskItem *pred)
+  {
+    if(!pred || (pred == task))
+      return;
+    AutoLock<> al(pred->dep_mutex);
+    if(pred->completed.load() == 0) {
+      pred->successors.push_back(task);
+      task->pending_deps.fetch_add(1);
+    }
+  }
+
+  void ThreadPool::WorkerInfo::spawn_task(TaskItem *task, bool deferred,
+					  const TaskDependence *deps,
+					  size_t num_deps)
+  {
+    // tasks created by a final task are always run immediately
+    if(current_task && current_task->final)
+      deferred = false;
+
+    attach_task(task);
+    task->deferred = deferred;
+
+    if(num_deps > 0) {
+      // hold an extra count while predecessors are added so that none of
+      //  them can release the task before they've all been found
+      task->pending_deps.store(1);
+      DependenceMap& dmap = current_dependences();
+      for(size_t i = 0; i < num_deps; i++) {
+	DependenceMap::Entry& e = dmap.entries[deps[i].addr];
+	add_predecessor(task, e.last_out);
+	if(deps[i].is_out) {
+	  // a writer waits for every reader since the last writer and then
+	  //  replaces all of them
+	  for(std::vector<TaskItem *>::iterator it = e.last_ins.begin();
+	      it != e.last_ins.end();
+	      ++it) {
+	    add_predecessor(task, *it);
+	    (*it)->remove_reference();
+	  }
+	  e.last_ins.clear();
+	  if(e.last_out != task) {
+	    if(e.last_out)
+	      e.last_out->remove_reference();
+	    task->references.fetch_add(1);
+	    e.last_out = task;
+	  }
+	} else {
+	  if((e.last_out != task) &&
+	     (e.last_ins.empty() || (e.last_ins.back() != task))) {
+	    task->references.fetch_add(1);
+	    e.last_ins.push_back(task);
+	  }
+	}
+      }
+      if(task->pending_deps.fetch_sub_acqrel(1) > 1) {
+	// the last predecessor to complete will queue a deferred task
+	if(deferred)
+	  return;
+	// an undeferred one has to be run here once they're all done
+	while(task->pending_deps.load_acquire() > 0)
+	  if(!execute_one_task())
+	    Thread::yield();
+      }
+    }
+
+    if(deferred)
+      enqueue_task(task);
+    else
+      run_task(task);
+  }
+
+  void ThreadPool::WorkerInfo::wait_for_dependences(const TaskDependence *deps,
+						    size_t num_deps)
+  {
+    if(!work_item || (num_deps == 0))
+      return;
+
+    DependenceMap& dmap = current_dependences();
+    std::vector<TaskItem *> preds;
+    for(size_t i = 0; i < num_deps; i++) {
+      std::map<uintptr_t, DependenceMap::Entry>::const_iterator it =
+	dmap.entries.find(deps[i].addr);
+      if(it == dmap.entries.end())
+	continue;
+      if(it->second.last_out)
+	preds.push_back(it->second.last_out);
+      if(deps[i].is_out)
+	preds.insert(preds.end(),
+		     it->second.last_ins.begin(), it->second.last_ins.end());
+    }
+    // the map's references keep these alive while we wait
+    for(std::vector<TaskItem *>::const_iterator it = preds.begin();
+	it != preds.end();
+	++it)
+      while((*it)->completed.load_acquire() == 0)
+	if(!execute_one_task())
+	  Thread::yield();
+  }
+
+  void ThreadPool::WorkerInfo::begin_task(TaskItem *task)
+  {
+    attach_task(task);
+    current_task = task;
+  }
+
+  void ThreadPool::WorkerInfo::end_task(TaskItem *task)
+  {
+    assert(current_task == task);
+    current_task = task->parent;
+    complete_task(task);
+  }
+
+  bool ThreadPool::WorkerInfo::execute_one_task(void)
+  {
+    WorkItem *item = work_item;
+    if(!item || (item->outstanding_tasks.load() == 0))
+      return false;
+
+    TaskItem *task = 0;
+    // newest task from our own queue first...
+    {
+      TaskQueue& q = item->task_queues[thread_id];
+      AutoLock<> al(q.mutex);
+      if(!q.tasks.empty()) {
+	task = q.tasks.back();
+	q.tasks.pop_back();
+      }
+    }
+    // ... and then the oldest one from another thread's queue
+    for(int i = 1; !task && (i < item->num_threads); i++) {
+      TaskQueue& q = item->task_queues[(thread_id + i) % item->num_threads];
+      AutoLock<> al(q.mutex);
+      if(!q.tasks.empty()) {
+	task = q.tasks.front();
+	q.tasks.pop_front();
+      }
+    }
+    if(!task)
+      return false;
+
+    run_task(task);
+    return true;
+  }
+
+  void ThreadPool::WorkerInfo::wait_for_child_tasks(void)
+  {
+    if(!work_item)
+      return;
+
+    atomic<int>& children = (current_task ?
+			       current_task->children :
+			       work_item->implicit_children[thread_id]);
+    while(children.load_acquire() > 0)
+      if(!execute_one_task())
+	Thread::yield();
+
+    // every child is done, so later children can't depend on any of them
+    DependenceMap *dmap = (current_task ?
+			     current_task->child_deps :
+			     work_item->implicit_deps[thread_id]);
+    if(dmap)
+      dmap->clear();
+  }
+
+  void ThreadPool::WorkerInfo::yield_to_task(void)
+  {
+    if(!execute_one_task())
+      Thread::yield();
+  }
+
+  void ThreadPool::WorkerInfo::wait_for_team_tasks(void)
+  {
+    if(!work_item)
+      return;
+
+    while(work_item->outstanding_tasks.load_acquire() > 0)
+      if(!execute_one_task())
+	Thread::yield();
+  }
+
+  void ThreadPool::WorkerInfo::finish_implicit_task(void)
+  {
+    WorkItem *item = work_item;
+    item->running_implicit.fetch_sub(1);
+    // if nobody has created a task, don't hold this thread back
+    if(item->any_tasks.load() == 0)
+      return;
+    // otherwise help out until the rest of the team is done with the body
+    //  (and so can't create any more tasks) and all the tasks have run
+    while((item->running_implicit.load_acquire() > 0) ||
+	  (item->outstanding_tasks.load_acquire() > 0))
+      if(!execute_one_task())
+	Thread::yield();
+  }
+
+  void ThreadPool::WorkerInfo::run_task(TaskItem *task)
+  {
+    TaskItem *prev_task = current_task;
+    current_task = task;
+    (task->fnptr)(task->data);
+    current_task = prev_task;
+    complete_task(task);
+  }
+
+  void ThreadPool::WorkerInfo::complete_task(TaskItem *task)
+  {
+    // the task's own children may still be running, so the task is not
+    //  freed until they drop their references as well
+    WorkItem *item = task->work_item;
+
+    // release any later siblings that were waiting for this task - they
+    //  remain counted as outstanding, so the work item can't go away
+    std::vector<TaskItem *> ready;
+    {
+      AutoLock<> al(task->dep_mutex);
+      task->completed.store_release(1);
+      ready.swap(task->successors);
+    }
+    for(std::vector<TaskItem *>::iterator it = ready.begin();
+	it != ready.end();
+	++it)
+      if(((*it)->pending_deps.fetch_sub_acqrel(1) == 1) && (*it)->deferred) {
+	assert(work_item == item);
+	enqueue_task(*it);
+      }
+
+    task->parent_children->fetch_sub_acqrel(1);
+    if(task->parent)
+      task->parent->remove_reference();
+    task->remove_reference();
+    // this must be last - once the count reaches zero, the work item may
+    //  be deleted
+    item->outstanding_tasks.fetch_sub_acqrel(1);
+  }
+
 
   ////////////////////////////////////////////////////////////////////////
   //
@@ -284,8 +734,42 @@ namespace Realm {
 			 int _numa_node, size_t _stack_size,
 			 CoreReservationSet& crs)
     : num_workers(_num_workers)
+    , runtime_sched_kind(LoopSchedule::SCHEDULE_DYNAMIC)
+    , runtime_sched_chunk(0)
     , workers_running(false)
   {
+    // "schedule(runtime)" loops use OMP_SCHEDULE if set, which has the
+    //  form [modifier:]kind[,chunk]
+    const char *e = getenv("OMP_SCHEDULE");
+    if(e) {
+      const char *colon = strchr(e, ':');
+      if(colon)
+	e = colon + 1;
+      while(*e == ' ') e++;
+      // kind names are case-insensitive
+      char kind[8];
+      size_t len = 0;
+      while(e[len] && (e[len] != ',') && (e[len] != ' ') && (len < 7)) {
+	kind[len] = tolower(e[len]);
+	len++;
+      }
+      kind[len] = 0;
+      if(e[len] && (e[len] != ',') && (e[len] != ' '))
+	kind[0] = 0;  // too long to be valid
+      const char *comma = strchr(e, ',');
+      int64_t chunk = (comma ? strtoll(comma + 1, 0, 10) : 0);
+      if(!strcmp(kind, "static"))
+	set_runtime_schedule(LoopSchedule::SCHEDULE_STATIC, chunk);
+      else if(!strcmp(kind, "dynamic"))
+	set_runtime_schedule(LoopSchedule::SCHEDULE_DYNAMIC, chunk);
+      else if(!strcmp(kind, "guided"))
+	set_runtime_schedule(LoopSchedule::SCHEDULE_GUIDED, chunk);
+      else if(!strcmp(kind, "auto"))
+	set_runtime_schedule(LoopSchedule::SCHEDULE_AUTO, chunk);
+      else
+	log_pool.warning() << "unrecognized OMP_SCHEDULE: '" << e << "'";
+    }
+
     // create per-worker core reservations
     CoreReservationParameters params;
     params.set_num_cores(1);
@@ -314,6 +798,7 @@ namespace Realm {
       wi.fnptr = 0;
       wi.data = 0;
       wi.work_item = 0;
+      wi.current_task = 0;
     }
 
     log_pool.info() << "pool " << (void *)this << " started - " << num_workers << " workers";
@@ -384,6 +869,7 @@ namespace Realm {
 	{
 	  log_pool.info() << "worker " << wi->thread_id << "/" << wi->num_threads << " executing: " << (void *)(wi->fnptr) << "(" << wi->data << ")";
 	  (wi->fnptr)(wi->data);
+	  wi->finish_implicit_task();
 	  log_pool.info() << "worker " << wi->thread_id << "/" << wi->num_threads << " done";
 	  wi->work_item->remaining_workers.fetch_sub(1);
 	  wi->status.store(WorkerInfo::WORKER_IDLE);
@@ -489,10 +975,25 @@ namespace Realm {
     wi->fnptr = fnptr;
     wi->data = data;
     wi->work_item = work_item;
+    wi->current_task = 0;
     int expval = WorkerInfo::WORKER_CLAIMED;
     bool ok = wi->status.compare_exchange(expval,
 					  WorkerInfo::WORKER_ACTIVE);
     assert(ok);
   }
 
+  void ThreadPool::get_runtime_schedule(LoopSchedule::ScheduleKind& kind,
+					int64_t& chunk) const
+  {
+    kind = static_cast<LoopSchedule::ScheduleKind>(runtime_sched_kind.load());
+    chunk = runtime_sched_chunk.load();
+  }
+
+  void ThreadPool::set_runtime_schedule(LoopSchedule::ScheduleKind kind,
+					int64_t chunk)
+  {
+    runtime_sched_kind.store(kind);
+    runtime_sched_chunk.store(chunk);
+  }
+
 };
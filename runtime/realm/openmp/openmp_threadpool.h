@@ -19,11 +19,24 @@
 
 #include "realm/threads.h"
 #include "realm/logging.h"
+#include "realm/mutex.h"
+
+#include <deque>
+#include <map>
+#include <vector>
 
 namespace Realm {
 
   class LoopSchedule {
   public:
+    // loop kinds, numbered to match omp_sched_t
+    enum ScheduleKind {
+      SCHEDULE_STATIC = 1,
+      SCHEDULE_DYNAMIC = 2,
+      SCHEDULE_GUIDED = 3,
+      SCHEDULE_AUTO = 4,
+    };
+
     // sets the number of workers and initializes the barrier for usage
     //  by a work item
     void initialize(int _num_workers);
@@ -46,10 +59,19 @@ namespace Realm {
     void start_dynamic(int64_t start, int64_t end,
 		       int64_t incr, int64_t chunk);
 
-    // continues a dynamic loop
+    // starts a guided loop - like a dynamic loop, except that each
+    //  request is handed a share of the remaining iterations proportional
+    //  to 1/num_workers, never smaller than the requested chunk
+    void start_guided(int64_t start, int64_t end,
+		      int64_t incr, int64_t chunk);
+
+    // continues a dynamic or guided loop
     bool next_dynamic(int64_t& span_start, int64_t& span_end,
 		      int64_t& stride);
 
+    // returns the kind of the loop most recently started
+    ScheduleKind get_kind(void) const;
+
     // indicates this thread is done with the current loop - blocks
     //  if other threads haven't even entered the loop yet
     // if wait is set, blocks until all threads enter end_loop
@@ -62,6 +84,7 @@ namespace Realm {
     atomic<uint64_t> loop_pos, loop_limit;
     atomic<int64_t> loop_base, loop_incr, loop_chunk;
     atomic<int> loop_barrier;
+    atomic<int> /*ScheduleKind*/ loop_kind;
   };
 
   class ThreadPool {
@@ -81,17 +104,94 @@ namespace Realm {
     // entry point for workers - does not return until thread pool is shut down
     void worker_entry(void);
 
+    struct WorkItem;
+    struct TaskItem;
+
+    // one entry of a task's depend clause - inout and mutexinoutset are
+    //  treated as out
+    struct TaskDependence {
+      uintptr_t addr;
+      bool is_out;
+    };
+
+    // the last writer of each address named in the depend clauses of a
+    //  task's children, and the readers since then - holds a reference
+    //  on each task it names
+    struct DependenceMap {
+      struct Entry {
+	Entry(void) : last_out(0) {}
+	TaskItem *last_out;
+	std::vector<TaskItem *> last_ins;
+      };
+      ~DependenceMap(void);
+      void clear(void);
+
+      std::map<uintptr_t, Entry> entries;
+    };
+
+    // an explicit (i.e. "#pragma omp task") task - the argument data is
+    //  allocated along with the task and freed when it completes
+    struct TaskItem {
+      void (*fnptr)(void *data);
+      void *data;
+      WorkItem *work_item;
+      TaskItem *parent;  // null if created by an implicit task
+      atomic<int> *parent_children;
+      atomic<int> children;  // outstanding child tasks
+      atomic<int> references;  // self + outstanding child tasks
+      bool final;  // descendants of a final task are never deferred
+
+      // dependence state - a task is held until every earlier sibling it
+      //  depends on has completed, and the last of them to complete
+      //  queues it
+      bool deferred;
+      atomic<int> pending_deps;
+      atomic<int> completed;
+      Mutex dep_mutex;  // protects 'successors' and setting 'completed'
+      std::vector<TaskItem *> successors;
+      DependenceMap *child_deps;  // created by the first child with deps
+
+      static TaskItem *create(void (*_fnptr)(void *data),
+			      size_t data_size, size_t data_align);
+      void remove_reference(void);
+    };
+
+    // each thread in a team owns a deque of deferred tasks - the owner
+    //  pushes and pops at the back, idle threads steal from the front
+    struct TaskQueue {
+      Mutex mutex;
+      std::deque<TaskItem *> tasks;
+    };
+
     struct WorkItem {
       WorkItem(int _num_threads);
+      ~WorkItem(void);
 
       int prev_thread_id;
       int prev_num_threads;
+      TaskItem *prev_task;
       WorkItem *parent_work_item;
       atomic<int> remaining_workers;
       atomic<int> single_winner;  // worker currently assigned as the "single" one
       atomic<int> barrier_count;
       atomic<uint64_t> critical_flags;
       LoopSchedule schedule;
+
+      // tasking state
+      int num_threads;
+      TaskQueue *task_queues;
+      atomic<int> *implicit_children;  // per-thread children of implicit tasks
+      DependenceMap **implicit_deps;  // per-thread, created on first use
+      atomic<int> outstanding_tasks;
+      atomic<int> any_tasks;  // set once the first task is spawned
+      atomic<int> running_implicit;  // threads still in the parallel body
+
+      // tree reduction state for __kmpc_reduce{,_nowait}
+      void **reduce_data;
+      atomic<int> *reduce_ready;
+      atomic<int> *reduce_consumed;
+      int *reduce_generation;
+      atomic<int> reduce_release;
     };
 
     struct WorkerInfo {
@@ -112,9 +212,50 @@ namespace Realm {
       void (*fnptr)(void *data);
       void *data;
       WorkItem *work_item;
+      TaskItem *current_task;  // null while running an implicit task
 
       void push_work_item(WorkItem *new_work);
       WorkItem *pop_work_item(void);
+
+      // hands a new task to the current team - deferred tasks are queued
+      //  for any thread in the team, others are executed immediately - a
+      //  task with dependences on earlier siblings is held (or, if not
+      //  deferred, waited on) until those siblings complete
+      void spawn_task(TaskItem *task, bool deferred,
+		      const TaskDependence *deps = 0, size_t num_deps = 0);
+
+      // waits (running tasks) for the earlier siblings named by 'deps' -
+      //  used before an undeferred task body is run by the caller
+      void wait_for_dependences(const TaskDependence *deps, size_t num_deps);
+
+      // tracks an undeferred task whose body is run directly by the caller
+      void begin_task(TaskItem *task);
+      void end_task(TaskItem *task);
+
+      // runs one queued task from this thread's queue, or stolen from
+      //  another thread in the team - returns false if none was found
+      bool execute_one_task(void);
+
+      // waits (running tasks) for the children of the current task
+      void wait_for_child_tasks(void);
+
+      // runs one other ready task, if there is one, at a task
+      //  scheduling point (i.e. taskyield)
+      void yield_to_task(void);
+
+      // waits (running tasks) until all tasks in the team are complete
+      void wait_for_team_tasks(void);
+
+      // called when this thread finishes the body of a parallel region -
+      //  helps with tasks until the region's tasks are complete
+      void finish_implicit_task(void);
+
+    protected:
+      DependenceMap& current_dependences(void);
+      void enqueue_task(TaskItem *task);
+      void attach_task(TaskItem *task);
+      void run_task(TaskItem *task);
+      void complete_task(TaskItem *task);
     };
       
     // returns the WorkerInfo (if any) associated with the caller (which
@@ -137,8 +278,16 @@ namespace Realm {
 
     int get_num_workers() const { return num_workers; }
 
+    // schedule used for "schedule(runtime)" loops, initialized from
+    //  OMP_SCHEDULE and changed with omp_set_schedule
+    void get_runtime_schedule(LoopSchedule::ScheduleKind& kind,
+			      int64_t& chunk) const;
+    void set_runtime_schedule(LoopSchedule::ScheduleKind kind, int64_t chunk);
+
   protected:
     int num_workers;
+    atomic<int> /*ScheduleKind*/ runtime_sched_kind;
+    atomic<int64_t> runtime_sched_chunk;
     bool workers_running;
     std::vector<CoreReservation *> core_rsrvs;
     std::vector<Thread *> worker_threads;
@@ -258,7 +258,7 @@ namespace Realm {
 
       ProfilingMeasurements::OperationFinishEvent fevent;
       if(measurements.wants_measurement<ProfilingMeasurements::OperationFinishEvent>()) {
-        fevent.finish_event = get_finish_event();
+        fevent.finish_event = get_or_create_finish_event();
         measurements.add_measurement(fevent);
       }
 
@@ -271,16 +271,37 @@ namespace Realm {
 
   void Operation::trigger_finish_event(bool poisoned)
   {
+    // notifier-only operations were never added to the operation table
+    bool in_optable = (completion_notifier == 0);
+
     if(finish_event) {
       // don't spend a long time here triggering events
       finish_event->trigger(finish_gen, Network::my_node_id, poisoned,
 			    TimeLimit::responsive());
     }
-#ifndef REALM_USE_OPERATION_TABLE
-    // no operation table to decrement the refcount, so do it ourselves
-    // SJT: should this always be done for operations without finish events?
-    remove_reference();
+    if(completion_notifier)
+      completion_notifier->operation_completed(poisoned);
+#ifdef REALM_USE_OPERATION_TABLE
+    if(!in_optable)
 #endif
+    {
+      // no operation table to decrement the refcount, so do it ourselves
+      remove_reference();
+    }
+  }
+
+  Event Operation::get_or_create_finish_event(void)
+  {
+    if(!finish_event) {
+      // only notifier-only operations start without an event, and the
+      //  thread running the operation is the only one that can get here
+      //  before it completes
+      assert(completion_notifier != 0);
+      GenEventImpl *impl = GenEventImpl::create_genevent();
+      finish_gen = ID(impl->current_event()).event_generation();
+      finish_event = impl;
+    }
+    return finish_event->make_event(finish_gen);
   }
 
   void Operation::clear_profiling(void)
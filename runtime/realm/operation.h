@@ -93,6 +93,21 @@ namespace Realm {
     //  the operation)
     void add_async_work_item(AsyncWorkItem *item);
 
+    // an operation created without a finish event can instead report its
+    //  completion through a notifier - such operations are not tracked in
+    //  the operation table, and a finish event is only created if somebody
+    //  asks for one (see get_or_create_finish_event)
+    class CompletionNotifier {
+    public:
+      virtual ~CompletionNotifier(void) {}
+
+      // called once the operation is complete, from the completing thread
+      virtual void operation_completed(bool poisoned) = 0;
+    };
+
+    // must be called before the operation can complete
+    void set_completion_notifier(CompletionNotifier *_notifier);
+
     // used to record event wait intervals, if desired
     ProfilingMeasurements::OperationEventWaits::WaitInterval *create_wait_interval(Event e);
 
@@ -114,9 +129,15 @@ namespace Realm {
 
     GenEventImpl *finish_event;
     EventImpl::gen_t finish_gen;
+    CompletionNotifier *completion_notifier;
     atomic<int> refcount;
   public:
+    // returns NO_EVENT for an operation that only has a completion notifier
     Event get_finish_event(void) const;
+
+    // creates a finish event for a notifier-only operation if necessary -
+    //  must only be called by the thread running the operation
+    Event get_or_create_finish_event(void);
   protected:
     typedef ProfilingMeasurements::OperationStatus Status;
     atomic<Status::Result> state;
@@ -30,6 +30,7 @@ namespace Realm {
                               const ProfilingRequestSet &_requests)
     : finish_event(_finish_event)
     , finish_gen(_finish_gen)
+    , completion_notifier(0)
     , refcount(1)
     , state(ProfilingMeasurements::OperationStatus::WAITING)
     , requests(_requests)
@@ -98,7 +99,15 @@ namespace Realm {
 
   inline Event Operation::get_finish_event(void) const
   {
-    return finish_event->make_event(finish_gen);
+    if(finish_event)
+      return finish_event->make_event(finish_gen);
+    else
+      return Event::NO_EVENT;
+  }
+
+  inline void Operation::set_completion_notifier(CompletionNotifier *_notifier)
+  {
+    completion_notifier = _notifier;
   }
 
   // used to record event wait intervals, if desired
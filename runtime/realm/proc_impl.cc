@@ -140,7 +140,7 @@ namespace Realm {
     {
       Operation *op = Thread::self()->get_operation();
       assert(op != 0);
-      return op->get_finish_event();
+      return op->get_or_create_finish_event();
     }
 
     AddressSpace Processor::address_space(void) const
@@ -524,6 +524,23 @@ namespace Realm {
     }
 
     // helper function for spawn implementations
+    void ProcessorImpl::spawn_task_with_notifier(Processor::TaskFuncID func_id,
+						 const void *args, size_t arglen,
+						 const ProfilingRequestSet &reqs,
+						 Event start_event,
+						 Operation::CompletionNotifier *notifier,
+						 int priority)
+    {
+      assert(NodeID(ID(me).proc_owner_node()) == Network::my_node_id);
+
+      // no finish event, so no operation table entry either
+      Task *task = new Task(me, func_id, args, arglen, reqs,
+			    start_event, 0 /*no finish event*/, 0, priority);
+      task->set_completion_notifier(notifier);
+
+      enqueue_or_defer_task(task, start_event, 0 /*no cache*/);
+    }
+
     void ProcessorImpl::enqueue_or_defer_task(Task *task, Event start_event,
 					      DeferredSpawnCache *cache)
     {
@@ -1029,6 +1046,14 @@ namespace Realm {
     sched->remove_task_queue(&group->task_queue);
   }
 
+  void LocalTaskProcessor::steal_from(LocalTaskProcessor *victim,
+				      const std::set<Processor::TaskFuncID>& pinned_tasks)
+  {
+    assert(victim != this);
+    sched->set_pinned_tasks(pinned_tasks);
+    sched->add_steal_queue(&victim->task_queue);
+  }
+
   void LocalTaskProcessor::enqueue_task(Task *task)
   {
     task_queue.enqueue_task(task);
@@ -1096,6 +1121,9 @@ namespace Realm {
     TaskTableEntry &tte = task_table[func_id];
     tte.fnptr = fnptr;
     tte.user_data = user_data;
+
+    // once registered here, this task can also be stolen from siblings
+    sched->add_runnable_task(func_id);
   }
 
   void LocalTaskProcessor::execute_task(Processor::TaskFuncID func_id,
@@ -77,6 +77,15 @@ namespace Realm {
       // runs an internal Realm operation on this processor
       virtual void add_internal_task(InternalTask *task);
 
+      // spawns a task on this (local) processor that reports its completion
+      //  to 'notifier' instead of triggering a finish event
+      void spawn_task_with_notifier(Processor::TaskFuncID func_id,
+				    const void *args, size_t arglen,
+				    const ProfilingRequestSet &reqs,
+				    Event start_event,
+				    Operation::CompletionNotifier *notifier,
+				    int priority);
+
     protected:
       friend class Task;
 
@@ -151,6 +160,12 @@ namespace Realm {
       // runs an internal Realm operation on this processor
       virtual void add_internal_task(InternalTask *task);
 
+      // allows this processor to run ready tasks from 'victim''s queue when
+      //  it is otherwise idle - tasks with IDs in 'pinned_tasks' are left for
+      //  their original processor
+      void steal_from(LocalTaskProcessor *victim,
+		      const std::set<Processor::TaskFuncID>& pinned_tasks);
+
     protected:
       void set_scheduler(ThreadedTaskScheduler *_sched);
 
@@ -72,7 +72,8 @@ typedef enum realm_processor_kind_t {
   __op__(FILE_MEM, "file memory visible to all processors on a node") \
   __op__(LEVEL3_CACHE, "CPU L3 Visible to all processors on the node, better performance to processors on same socket") \
   __op__(LEVEL2_CACHE, "CPU L2 Visible to all processors on the node, better performance to one processor") \
-  __op__(LEVEL1_CACHE, "CPU L1 Visible to all processors on the node, better performance to one processor")
+  __op__(LEVEL1_CACHE, "CPU L1 Visible to all processors on the node, better performance to one processor") \
+  __op__(FILE_MAPPED_MEM, "file memory mapped into the address space of a node, directly accessible by its processors")
 
 typedef enum realm_memory_kind_t {
 #define C_ENUMS(name, desc) name,
@@ -48,6 +48,14 @@
 #define REALM_USE_LIBAIO
 #endif
 
+// if set, Linux's io_uring interface is used for async file I/O when the
+//  running kernel supports it, falling back to the interface above if not
+#if defined(REALM_ON_LINUX) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define REALM_USE_IO_URING
+#endif
+#endif
+
 // dynamic loading via dlfcn and a not-completely standard dladdr extension
 #ifdef REALM_USE_LIBDL
 #define REALM_USE_DLFCN
@@ -72,9 +80,21 @@ namespace Realm {
     //  specified limit
     extern int event_loop_detection_limit;
 
+    // if non-zero, remote event updates are fanned out through a tree of
+    //  the subscribers with the given arity instead of directly by the owner
+    extern int event_fanout_arity;
+
+    // number of children per node in the tree used to combine arrivals
+    //  for barriers that request it
+    extern int barrier_combine_arity;
+
     // if true, worker threads that might have used user-level thread switching
     //  fall back to kernel threading
     extern bool force_kernel_threads;
+
+    // if true, user-level thread switches use swapcontext even where the
+    //  faster register-only switch is available
+    extern bool force_ucontext_switch;
   };
 };
 #endif
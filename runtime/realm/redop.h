@@ -89,6 +89,28 @@ namespace Realm {
     };
 #endif
 
+    // bulk kernels used by ReductionOp<REDOP> for exclusive reductions over
+    //  contiguous elements - the default just applies REDOP one element at a
+    //  time, but a reduction op may specialize this to provide vectorized
+    //  implementations (Legion does so for its built-in sum/product/min/max
+    //  reductions)
+    template <class REDOP>
+    struct ReductionKernels {
+      static void apply_exclusive(typename REDOP::LHS *lhs,
+				  const typename REDOP::RHS *rhs, size_t count)
+      {
+	for(size_t i = 0; i < count; i++)
+	  REDOP::template apply<true>(lhs[i], rhs[i]);
+      }
+
+      static void fold_exclusive(typename REDOP::RHS *rhs1,
+				 const typename REDOP::RHS *rhs2, size_t count)
+      {
+	for(size_t i = 0; i < count; i++)
+	  REDOP::template fold<true>(rhs1[i], rhs2[i]);
+      }
+    };
+
     template <class REDOP>
     class ReductionOp : public ReductionOpUntyped {
     public:
@@ -114,8 +136,7 @@ namespace Realm {
 	typename REDOP::LHS *lhs = static_cast<typename REDOP::LHS *>(lhs_ptr);
 	const typename REDOP::RHS *rhs = static_cast<const typename REDOP::RHS *>(rhs_ptr);
 	if(exclusive) {
-	  for(size_t i = 0; i < count; i++)
-	    REDOP::template apply<true>(lhs[i], rhs[i]);
+	  ReductionKernels<REDOP>::apply_exclusive(lhs, rhs, count);
 	} else {
 	  for(size_t i = 0; i < count; i++)
 	    REDOP::template apply<false>(lhs[i], rhs[i]);
@@ -126,6 +147,12 @@ namespace Realm {
 				 off_t lhs_stride, off_t rhs_stride, size_t count,
 				 bool exclusive = false) const
       {
+	// dense strides can use the bulk kernels
+	if((lhs_stride == off_t(sizeof(typename REDOP::LHS))) &&
+	   (rhs_stride == off_t(sizeof(typename REDOP::RHS)))) {
+	  apply(lhs_ptr, rhs_ptr, count, exclusive);
+	  return;
+	}
 	if(exclusive) {
 	  for(size_t i = 0; i < count; i++) {
 	    REDOP::template apply<true>(*static_cast<typename REDOP::LHS *>(lhs_ptr),
@@ -149,8 +176,7 @@ namespace Realm {
 	typename REDOP::RHS *rhs1 = static_cast<typename REDOP::RHS *>(rhs1_ptr);
 	const typename REDOP::RHS *rhs2 = static_cast<const typename REDOP::RHS *>(rhs2_ptr);
 	if(exclusive) {
-	  for(size_t i = 0; i < count; i++)
-	    REDOP::template fold<true>(rhs1[i], rhs2[i]);
+	  ReductionKernels<REDOP>::fold_exclusive(rhs1, rhs2, count);
 	} else {
 	  for(size_t i = 0; i < count; i++)
 	    REDOP::template fold<false>(rhs1[i], rhs2[i]);
@@ -161,6 +187,11 @@ namespace Realm {
 				off_t lhs_stride, off_t rhs_stride, size_t count,
 				bool exclusive = false) const
       {
+	if((lhs_stride == off_t(sizeof(typename REDOP::RHS))) &&
+	   (rhs_stride == off_t(sizeof(typename REDOP::RHS)))) {
+	  fold(lhs_ptr, rhs_ptr, count, exclusive);
+	  return;
+	}
 	if(exclusive) {
 	  for(size_t i = 0; i < count; i++) {
 	    REDOP::template fold<true>(*static_cast<typename REDOP::RHS *>(lhs_ptr),
@@ -152,6 +152,7 @@ namespace Realm {
       fprintf(stderr,"Process %d on node %s is frozen!\n", 
                       process_id, hostname);
       fflush(stderr);
+      Logger::flush_for_error();
 
       // now that we've stopped, don't catch any further SIGINTs
       struct sigaction action;
@@ -521,8 +522,9 @@ namespace Realm {
       if(Thread::self()) {
 	Operation *op = Thread::self()->get_operation();
 	if(op != 0) {
-	  log_runtime.debug() << "shutdown merging finish event=" << op->get_finish_event();
-	  wait_on = Event::merge_events(wait_on, op->get_finish_event());
+	  Event op_finish = op->get_or_create_finish_event();
+	  log_runtime.debug() << "shutdown merging finish event=" << op_finish;
+	  wait_on = Event::merge_events(wait_on, op_finish);
 	}
       }
 
@@ -581,6 +583,7 @@ namespace Realm {
     , pin_util_procs(false)
     , cpu_bgwork_timeslice(0)
     , util_bgwork_timeslice(0)
+    , cpu_work_stealing(false)
   {}
 
   CoreModule::~CoreModule(void)
@@ -602,6 +605,8 @@ namespace Realm {
       .add_option_bool("-ll:pin_util", m->pin_util_procs)
       .add_option_int("-ll:cpu_bgwork", m->cpu_bgwork_timeslice)
       .add_option_int("-ll:util_bgwork", m->util_bgwork_timeslice)
+      .add_option_bool("-ll:steal", m->cpu_work_stealing)
+      .add_option_stringlist("-ll:steal_pin", m->steal_pinned_tasks)
       .parse_command_line(cmdline);
 
     return m;
@@ -647,14 +652,47 @@ namespace Realm {
       runtime->add_processor(pi);
     }
 
+    std::vector<LocalCPUProcessor *> cpu_procs;
     for(int i = 0; i < num_cpu_procs; i++) {
       Processor p = runtime->next_local_processor_id();
-      ProcessorImpl *pi = new LocalCPUProcessor(p, runtime->core_reservation_set(),
-						stack_size,
-						Config::force_kernel_threads,
-						&runtime->bgwork,
-						cpu_bgwork_timeslice);
+      LocalCPUProcessor *pi = new LocalCPUProcessor(p, runtime->core_reservation_set(),
+						    stack_size,
+						    Config::force_kernel_threads,
+						    &runtime->bgwork,
+						    cpu_bgwork_timeslice);
       runtime->add_processor(pi);
+      cpu_procs.push_back(pi);
+    }
+
+    // if requested, idle CPU processors may take ready tasks from each
+    //  other's queues
+    if(cpu_work_stealing && (cpu_procs.size() > 1)) {
+      // Realm's own per-processor tasks (init, shutdown, ...) must stay put,
+      //  as must anything the application asked to be pinned
+      std::set<Processor::TaskFuncID> pinned;
+      for(Processor::TaskFuncID id = 0; id < Processor::TASK_ID_FIRST_AVAILABLE; id++)
+	pinned.insert(id);
+      for(std::vector<std::string>::const_iterator it = steal_pinned_tasks.begin();
+	  it != steal_pinned_tasks.end();
+	  ++it) {
+	// each argument may be a comma-separated list of task IDs
+	const char *s = it->c_str();
+	while(*s) {
+	  char *pos;
+	  unsigned long id = strtoul(s, &pos, 10);
+	  if((pos == s) || ((*pos != 0) && (*pos != ','))) {
+	    log_runtime.fatal() << "malformed task ID list for -ll:steal_pin: '" << *it << "'";
+	    abort();
+	  }
+	  pinned.insert(id);
+	  s = (*pos == ',') ? (pos + 1) : pos;
+	}
+      }
+
+      for(size_t i = 0; i < cpu_procs.size(); i++)
+	for(size_t j = 0; j < cpu_procs.size(); j++)
+	  if(i != j)
+	    cpu_procs[i]->steal_from(cpu_procs[j], pinned);
     }
   }
 
@@ -966,6 +1004,9 @@ namespace Realm {
 
       size_t reg_mem_size = 0;
       size_t disk_mem_size = 0;
+      bool file_mmap = false;
+      bool file_mmap_populate = false;
+      std::string file_mmap_advice;
       // Static variable for stack size since we need to 
       // remember it when we launch threads in run 
       stack_size = 2 << 20;
@@ -997,6 +1038,9 @@ namespace Realm {
       cp.add_option_int_units("-ll:rsize", reg_mem_size, 'm')
 	.add_option_int_units("-ll:ib_rsize", reg_ib_mem_size, 'm')
 	.add_option_int_units("-ll:dsize", disk_mem_size, 'm')
+	.add_option_bool("-ll:file_mmap", file_mmap)
+	.add_option_bool("-ll:file_mmap_populate", file_mmap_populate)
+	.add_option_string("-ll:file_mmap_advice", file_mmap_advice)
 	.add_option_int_units("-ll:stacksize", stack_size, 'm')
 	.add_option_int("-ll:dma", dma_worker_threads)
         .add_option_bool("-ll:pin_dma", pin_dma_threads)
@@ -1019,14 +1063,27 @@ namespace Realm {
 #endif
 
       cp.add_option_int("-realm:eventloopcheck", Config::event_loop_detection_limit);
+      cp.add_option_int("-ll:event_fanout", Config::event_fanout_arity);
+      cp.add_option_int("-ll:barrier_arity", Config::barrier_combine_arity);
       cp.add_option_bool("-ll:force_kthreads", Config::force_kernel_threads);
+      cp.add_option_bool("-ll:ucontext_switch", Config::force_ucontext_switch);
       cp.add_option_bool("-ll:frsrv_fallback", Config::use_fast_reservation_fallback);
       cp.add_option_int("-ll:machine_query_cache", Config::use_machine_query_cache);
       cp.add_option_int("-ll:defalloc", Config::deferred_instance_allocation);
       cp.add_option_int("-ll:amprofile", Config::profile_activemsg_handlers);
       cp.add_option_int("-ll:aminline", Config::max_inline_message_time);
+      cp.add_option_int_units("-ll:ambatch", Config::am_batch_size, 'k');
+      cp.add_option_int("-ll:ambatch_latency", Config::am_batch_latency);
       cp.add_option_int("-ll:ahandlers", active_msg_handler_threads);
       cp.add_option_int("-ll:handler_bgwork", active_msg_handler_bgwork);
+      cp.add_option_int("-ll:memcpy_split", Config::memcpy_parallel_pieces);
+      cp.add_option_int_units("-ll:memcpy_split_min", Config::memcpy_parallel_min_bytes, 'k');
+      cp.add_option_int_units("-ll:memcpy_nt", Config::memcpy_nontemporal_min_bytes, 'm');
+      cp.add_option_int("-ll:redop_stripes", Config::reduce_stripe_locks);
+      cp.add_option_int_units("-ll:redop_stripe_size", Config::reduce_stripe_bytes, 'k');
+      cp.add_option_int("-ll:aio_depth", Config::aio_queue_depth);
+      cp.add_option_int("-ll:io_uring", Config::aio_use_io_uring);
+      cp.add_option_int("-ll:aio_regbufs", Config::aio_register_buffers);
 
       bool cmdline_ok = cp.parse_command_line(cmdline);
 
@@ -1081,6 +1138,7 @@ namespace Realm {
 
       bgwork.configure_from_cmdline(cmdline);
       event_triggerer.add_to_manager(&bgwork);
+      barrier_combiner.add_to_manager(&bgwork);
 
       // initialize barrier timestamp
       BarrierImpl::barrier_adjustment_timestamp.store((((Barrier::timestamp_t)(Network::my_node_id)) << BarrierImpl::BARRIER_TIMESTAMP_NODEID_SHIFT) + 1);
@@ -1167,6 +1225,12 @@ namespace Realm {
       else
 	assert(active_msg_handler_threads > 0);
 
+      // small outgoing messages are coalesced per target node if requested
+      if((Config::am_batch_size > 0) && (Network::max_node_id > 0)) {
+	activemsg_batcher = new ActiveMessageBatcher(Network::max_node_id + 1,
+						     *core_reservations);
+      }
+
       // initialize modules and create memories before we do network attach
       //  so that we have a chance to register these other memories for
       //  RDMA transfers
@@ -1256,9 +1320,6 @@ namespace Realm {
       
       bgwork.start_dedicated_workers(*core_reservations);
 
-      start_dma_worker_threads(dma_worker_threads,
-			       *core_reservations);
-
       PartitioningOpQueue::start_worker_threads(*core_reservations, &bgwork);
 
 #ifdef EVENT_TRACING
@@ -1335,6 +1396,22 @@ namespace Realm {
       filemem = new FileMemory(get_runtime()->next_local_memory_id());
       get_runtime()->add_memory(filemem);
 
+      // attached files can also be mapped into memory for direct access
+      if(file_mmap) {
+	int advice = -1;
+	if(!file_mmap_advice.empty() &&
+	   !MappedFileMemory::parse_advice(file_mmap_advice, advice)) {
+	  log_runtime.fatal() << "unknown file mapping advice '"
+			      << file_mmap_advice << "'";
+	  abort();
+	}
+	Memory m = get_runtime()->next_local_memory_id();
+	MappedFileMemory *mapmem = new MappedFileMemory(m,
+							file_mmap_populate,
+							advice);
+	get_runtime()->add_memory(mapmem);
+      }
+
       for(std::vector<Module *>::const_iterator it = modules.begin();
 	  it != modules.end();
 	  it++)
@@ -1438,6 +1515,15 @@ namespace Realm {
                   100   // high latency)
                   );
 
+	  // mapped files are directly accessible, but page faults make them
+	  //  less attractive than system memory for anything else
+	  add_proc_mem_affinities(machine,
+				  procs_by_kind[k],
+				  mems_by_kind[Memory::FILE_MAPPED_MEM],
+				  50,  // "medium" bandwidth
+				  20   // "medium" latency
+				  );
+
 	  add_proc_mem_affinities(machine,
 				  procs_by_kind[k],
 				  mems_by_kind[Memory::GLOBAL_MEM],
@@ -1467,6 +1553,13 @@ namespace Realm {
 			       50  // "high" latency
 			       );
 
+	add_mem_mem_affinities(machine,
+			       mems_by_kind[Memory::SYSTEM_MEM],
+			       mems_by_kind[Memory::FILE_MAPPED_MEM],
+			       50,  // "medium" bandwidth
+			       20  // "medium" latency
+			       );
+
 	for(std::set<Processor::Kind>::const_iterator it = local_cpu_kinds.begin();
 	    it != local_cpu_kinds.end();
 	    it++) {
@@ -2041,6 +2134,10 @@ namespace Realm {
 	  // first make sure the incoming message queue is quiescent
 	  message_manager->drain_incoming_messages();
 
+	  // handlers may have left messages sitting in partial batches
+	  if(activemsg_batcher)
+	    activemsg_batcher->flush_all();
+
 	  // then check the network for quiescence
 	  tries++;
 	  bool done = Network::check_for_quiescence();
@@ -2080,7 +2177,6 @@ namespace Realm {
 
       // threads that cause inter-node communication have to stop first
       PartitioningOpQueue::stop_worker_threads();
-      stop_dma_worker_threads();
       for(std::vector<Channel *>::iterator it = nodes[Network::my_node_id].dma_channels.begin();
 	  it != nodes[Network::my_node_id].dma_channels.end();
 	  ++it)
@@ -2095,9 +2191,16 @@ namespace Realm {
 
 #ifdef DEBUG_REALM
       event_triggerer.shutdown_work_item();
+      barrier_combiner.shutdown_work_item();
 #endif
       bgwork.stop_dedicated_workers();
 
+      if(activemsg_batcher) {
+	activemsg_batcher->shutdown();
+	delete activemsg_batcher;
+	activemsg_batcher = 0;
+      }
+
       // tear down the active message manager
       message_manager->shutdown();
       delete message_manager;
@@ -2565,6 +2668,7 @@ namespace Realm {
       free(funcname);
 #endif
       unregister_error_signal_handler();
+      Logger::flush_for_error();
       std::cerr << "Signal " << signal << " received by node " << Network::my_node_id
 #ifdef REALM_ON_WINDOWS
                 << ", process " << GetCurrentProcessId()
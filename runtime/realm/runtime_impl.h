@@ -174,6 +174,8 @@ namespace Realm {
       size_t sysmem_size, stack_size;
       bool pin_util_procs;
       long long cpu_bgwork_timeslice, util_bgwork_timeslice;
+      bool cpu_work_stealing;
+      std::vector<std::string> steal_pinned_tasks;
     };
 
     REGISTER_REALM_MODULE(CoreModule);
@@ -320,6 +322,7 @@ namespace Realm {
       BackgroundWorkManager bgwork;
       IncomingMessageManager *message_manager;
       EventTriggerNotifier event_triggerer;
+      BarrierArrivalCombiner barrier_combiner;
 
       OperationTable optable;
 
@@ -0,0 +1,1627 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// shared memory network module for multiple processes on a single host
+
+#include "realm/network.h"
+
+#include "realm/shm/shm_module.h"
+
+#include "realm/runtime_impl.h"
+#include "realm/mem_impl.h"
+#include "realm/activemsg.h"
+#include "realm/cmdline.h"
+#include "realm/logging.h"
+#include "realm/threads.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __linux__
+#include <signal.h>
+#include <sys/prctl.h>
+#endif
+
+#include <map>
+
+namespace Realm {
+
+  Logger log_shm("shm");
+
+  namespace ShmConfig {
+    // everything in the shared memory objects is aligned to this
+    static const size_t CACHE_LINE = 64;
+
+    // scratch space per rank for broadcast/gather
+    static const size_t COLLECTIVE_BYTES = 4096;
+
+    // the largest record in a queue is this fraction of the queue size -
+    //  bigger messages are sent in several fragments
+    static const size_t MAX_RECORD_FRACTION = 4;
+
+    static const size_t CONTROL_MAGIC = 0x4d48536d6c616552ULL;  // "RealmShM"
+
+    // how long ranks wait for each other to show up
+    static const long long JOIN_TIMEOUT_US = 60000000;
+  };
+
+  static size_t align_up(size_t value, size_t alignment)
+  {
+    return ((value + alignment - 1) & ~(alignment - 1));
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // shared memory layout
+  //
+
+  // everything in this section lives in shared memory and is mapped at
+  //  different addresses in each process, so there can be no pointers
+
+  // one queue per (sender, receiver) pair - only the sender moves the tail
+  //  and only the receiver moves the head, and both count bytes from the
+  //  start of time so that full and empty can be told apart
+  struct ShmQueueHeader {
+    atomic<size_t> tail;
+    char pad0[ShmConfig::CACHE_LINE - sizeof(atomic<size_t>)];
+    atomic<size_t> head;
+    char pad1[ShmConfig::CACHE_LINE - sizeof(atomic<size_t>)];
+  };
+
+  struct ShmRankInfo {
+    atomic<size_t> segment_bytes;  // size of this rank's segment object
+    atomic<size_t> sent_snapshot;  // messages sent, for quiescence checks
+    atomic<size_t> join_request;   // set by an external peer (its pid)
+    atomic<size_t> join_ack;       // rank 0's run id, once it has seen that
+    char pad[ShmConfig::CACHE_LINE - 4 * sizeof(atomic<size_t>)];
+    char scratch[ShmConfig::COLLECTIVE_BYTES];
+  };
+
+  // at the start of the control object, followed by a ShmRankInfo for each
+  //  rank and then num_ranks^2 queues (a ShmQueueHeader followed by
+  //  'queue_bytes' of data each)
+  struct ShmControl {
+    atomic<size_t> magic;  // set last by the creator
+    atomic<size_t> run_id;  // chosen by the creator, never zero
+    int num_ranks;
+    size_t queue_bytes;
+    atomic<unsigned> barrier_count;
+    atomic<unsigned> barrier_generation;
+  };
+
+  // every record in a queue starts with one of these, and all records are
+  //  padded to a multiple of 8 bytes - records never wrap around the end of
+  //  the queue: a record that wouldn't fit starts at the beginning again,
+  //  with the leftover space marked by a MSG_PAD record (or ignored if it's
+  //  too small to hold one)
+  struct ShmMessageHeader {
+    enum {
+      MSG_PAD,
+      MSG_INLINE,      // header and payload follow
+      MSG_FRAG_FIRST,  // header and first part of payload follow
+      MSG_FRAG_CONT,   // next part of payload follows
+      MSG_RDMA,        // header follows, payload already in our segment
+      MSG_COMPLETION,  // remote completion for a message we sent
+    };
+
+    unsigned bytes;  // size of the whole record
+    unsigned short type;
+    unsigned short msgid;
+    unsigned header_size;
+    unsigned payload_size;  // for fragmented messages, the total size
+    unsigned chunk_size;  // payload bytes in this record
+    unsigned reserved;
+    uintptr_t comp_ptr;  // sender's remote completion list, if any
+    size_t dest_offset;  // MSG_RDMA payload location in receiver's segment
+
+    static size_t padded(size_t bytes)
+    {
+      return ((bytes + 7) & ~size_t(7));
+    }
+  };
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class ShmInternal
+  //
+
+  class ShmInternal {
+  public:
+    ShmInternal(void);
+    ~ShmInternal(void);
+
+    // creates or opens the control object (forking peers first if asked to)
+    //  and sets up the queues - returns this process's rank
+    NodeID init(const std::string& _session, int _num_ranks, int _my_rank,
+	      size_t _queue_bytes, bool fork_peers);
+
+    void attach(RuntimeImpl *runtime, NetworkModule *network,
+		std::vector<NetworkSegment *>& segments);
+    void detach(RuntimeImpl *runtime);
+
+    void barrier(void);
+    void broadcast(NodeID root, const void *val_in, void *val_out,
+		   size_t bytes);
+    void gather(NodeID root, const void *val_in, void *vals_out,
+		size_t bytes);
+    bool check_for_quiescence(void);
+
+    // blocks until the whole message is in the target's queue (and the
+    //  payload has been copied, if it's an RDMA write)
+    void send_message(NodeID target, unsigned short msgid,
+		      const void *header, size_t header_size,
+		      const void *payload, size_t payload_size,
+		      size_t payload_lines, size_t payload_line_stride,
+		      const RemoteAddress *dest_payload_addr,
+		      uintptr_t remote_comp);
+
+    void send_completion(NodeID target, uintptr_t comp_ptr);
+
+    // largest payload that can go in a single record
+    size_t max_inline_payload(size_t header_size) const;
+
+    char *peer_segment_base(NodeID peer) const;
+
+    void poller_loop(void);
+
+    // called by the IncomingMessageManager once a message needing a remote
+    //  completion has been handled
+    static void message_handled(NodeID sender, uintptr_t comp_ptr,
+				uintptr_t /*unused*/);
+
+  protected:
+    struct OutgoingQueue {
+      Mutex mutex;
+      ShmQueueHeader *qhdr;
+      char *data;
+      size_t cached_head;  // our last view of the receiver's progress
+      size_t next_tail;
+
+      // returns space for a record of 'bytes' or null if the queue is full
+      char *reserve(size_t bytes, size_t capacity);
+      void publish(void);
+    };
+
+    struct IncomingQueue {
+      ShmQueueHeader *qhdr;
+      char *data;
+
+      // a fragmented message being reassembled
+      ShmMessageHeader frag_info;
+      char *frag_header;
+      char *frag_payload;
+      size_t frag_received;
+    };
+
+    ShmQueueHeader *queue_header(NodeID sender, NodeID receiver) const;
+    ShmRankInfo *rank_info(NodeID rank) const;
+
+    void write_record(NodeID target, OutgoingQueue& q,
+		      const ShmMessageHeader& info,
+		      const void *header, const void *payload,
+		      size_t payload_lines, size_t payload_line_stride,
+		      size_t payload_offset);
+
+    bool poll_queue(NodeID sender, IncomingQueue& q);
+    void deliver(NodeID sender, const ShmMessageHeader& info,
+		 const void *header, int hdr_mode,
+		 const void *payload, int payload_mode);
+    bool retry_deferred_completions(void);
+
+    // the join handshake for ranks started by an external launcher
+    void accept_peers(size_t run_id);
+    bool join_control(const struct stat& mapped, long long& waited);
+
+    // waits for something to change, noticing if a forked peer has died
+    void backoff(void);
+    void check_children(void);
+
+    std::string session;
+    int num_ranks;
+    NodeID my_rank;
+    size_t queue_bytes, max_record_bytes;
+    bool forked_peers;
+    std::vector<pid_t> children;
+    std::map<pid_t, int> reaped_children;
+
+    ShmControl *control;
+    size_t control_bytes;
+    char *my_segment;
+    std::vector<char *> peer_segments;
+    std::vector<size_t> peer_segment_bytes;
+
+    // not a vector because the mutexes can't be copied
+    OutgoingQueue *outgoing;
+    std::vector<IncomingQueue> incoming;
+    IncomingMessageManager *message_manager;
+
+    // only touched by the poller thread
+    std::vector<std::pair<NodeID, uintptr_t> > deferred_completions;
+
+    CoreReservation *core_rsrv;
+    Thread *poller_thread;
+    atomic<bool> shutdown_flag;
+    atomic<size_t> messages_sent;
+  };
+
+  // the remote completion callback has no context argument to spare
+  static ShmInternal *shm_internal = 0;
+
+  // the poller must never block on a full queue (the peer's poller might be
+  //  waiting for us), so it needs to know when it's the one sending
+  static REALM_THREAD_LOCAL bool in_shm_poller = false;
+
+  ShmInternal::ShmInternal(void)
+    : num_ranks(0)
+    , my_rank(0)
+    , queue_bytes(0)
+    , max_record_bytes(0)
+    , forked_peers(false)
+    , control(0)
+    , control_bytes(0)
+    , my_segment(0)
+    , outgoing(0)
+    , message_manager(0)
+    , core_rsrv(0)
+    , poller_thread(0)
+    , shutdown_flag(false)
+    , messages_sent(0)
+  {}
+
+  ShmInternal::~ShmInternal(void)
+  {
+    for(int i = 0; i < num_ranks; i++)
+      if((i != my_rank) && (peer_segments[i] != 0))
+	munmap(peer_segments[i], peer_segment_bytes[i]);
+    if(my_segment != 0)
+      munmap(my_segment, peer_segment_bytes[my_rank]);
+    if(control != 0)
+      munmap(control, control_bytes);
+    delete[] outgoing;
+  }
+
+  ShmQueueHeader *ShmInternal::queue_header(NodeID sender,
+					    NodeID receiver) const
+  {
+    size_t queue_stride = sizeof(ShmQueueHeader) + queue_bytes;
+    char *base = (reinterpret_cast<char *>(control) +
+		  align_up(sizeof(ShmControl), ShmConfig::CACHE_LINE) +
+		  (num_ranks * sizeof(ShmRankInfo)));
+    return reinterpret_cast<ShmQueueHeader *>(base +
+					      (((sender * num_ranks) + receiver) *
+					       queue_stride));
+  }
+
+  ShmRankInfo *ShmInternal::rank_info(NodeID rank) const
+  {
+    char *base = (reinterpret_cast<char *>(control) +
+		  align_up(sizeof(ShmControl), ShmConfig::CACHE_LINE));
+    return reinterpret_cast<ShmRankInfo *>(base) + rank;
+  }
+
+  char *ShmInternal::peer_segment_base(NodeID peer) const
+  {
+    return peer_segments[peer];
+  }
+
+  size_t ShmInternal::max_inline_payload(size_t header_size) const
+  {
+    return (max_record_bytes - sizeof(ShmMessageHeader) -
+	    ShmMessageHeader::padded(header_size));
+  }
+
+  NodeID ShmInternal::init(const std::string& _session, int _num_ranks,
+			 int _my_rank, size_t _queue_bytes, bool fork_peers)
+  {
+    session = _session;
+    num_ranks = _num_ranks;
+    my_rank = _my_rank;
+    queue_bytes = _queue_bytes;
+    max_record_bytes = queue_bytes / ShmConfig::MAX_RECORD_FRACTION;
+    forked_peers = fork_peers;
+
+    control_bytes = (align_up(sizeof(ShmControl), ShmConfig::CACHE_LINE) +
+		     (num_ranks * sizeof(ShmRankInfo)) +
+		     (num_ranks * num_ranks * (sizeof(ShmQueueHeader) +
+					       queue_bytes)));
+
+    if(my_rank == 0) {
+      // get rid of anything left over from a previous run with this name
+      shm_unlink(session.c_str());
+      int fd = shm_open(session.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+      if(fd < 0) {
+	log_shm.fatal() << "could not create '" << session << "': "
+			<< strerror(errno);
+	abort();
+      }
+      if(ftruncate(fd, control_bytes) < 0) {
+	log_shm.fatal() << "could not size '" << session << "' to "
+			<< control_bytes << " bytes: " << strerror(errno);
+	abort();
+      }
+      void *base = mmap(0, control_bytes, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+      if(base == MAP_FAILED) {
+	log_shm.fatal() << "could not map '" << session << "': "
+			<< strerror(errno);
+	abort();
+      }
+      close(fd);
+
+      // a new object is zero-filled, which is the right initial state for
+      //  all the atomics
+      control = static_cast<ShmControl *>(base);
+      control->num_ranks = num_ranks;
+      control->queue_bytes = queue_bytes;
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      size_t run_id = (((size_t(getpid()) << 32) ^
+			(size_t(ts.tv_sec) << 20) ^ size_t(ts.tv_nsec)) | 1);
+      control->run_id.store(run_id);
+      control->magic.store_release(ShmConfig::CONTROL_MAGIC);
+
+      if(fork_peers) {
+	// forked peers inherit the mapping, so nobody needs the name again
+	shm_unlink(session.c_str());
+
+	// this has to happen before any threads exist, and everybody's
+	//  buffered output should only come out once
+	fflush(stdout);
+	fflush(stderr);
+	for(int i = 1; i < num_ranks; i++) {
+	  pid_t pid = fork();
+	  if(pid < 0) {
+	    log_shm.fatal() << "fork failed: " << strerror(errno);
+	    abort();
+	  }
+	  if(pid == 0) {
+#ifdef __linux__
+	    // don't outlive the parent if it dies
+	    prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+	    my_rank = i;
+	    children.clear();
+	    break;
+	  }
+	  children.push_back(pid);
+	}
+      } else
+	accept_peers(run_id);
+    } else {
+      // wait for rank 0 to create and initialize the control object - an
+      //  object with our session name may also be left over from a run
+      //  that died before everybody attached, and we may find it before
+      //  rank 0 replaces it, so keep trying until rank 0 accepts us
+      long long waited = 0;
+      while(true) {
+	int fd = shm_open(session.c_str(), O_RDWR, 0600);
+	struct stat st;
+	if((fd >= 0) && ((fstat(fd, &st) != 0) ||
+			 (size_t(st.st_size) < control_bytes))) {
+	  close(fd);
+	  fd = -1;
+	}
+	if(fd >= 0) {
+	  void *base = mmap(0, control_bytes, PROT_READ | PROT_WRITE,
+			    MAP_SHARED, fd, 0);
+	  if(base == MAP_FAILED) {
+	    log_shm.fatal() << "could not map '" << session << "': "
+			    << strerror(errno);
+	    abort();
+	  }
+	  close(fd);
+	  control = static_cast<ShmControl *>(base);
+	  if(join_control(st, waited))
+	    break;
+	  // stale - the name refers to something else now
+	  munmap(control, control_bytes);
+	  control = 0;
+	}
+	if(waited > ShmConfig::JOIN_TIMEOUT_US) {
+	  log_shm.fatal() << "timed out waiting for '" << session
+			  << "' from rank 0";
+	  abort();
+	}
+	usleep(1000);
+	waited += 1000;
+      }
+      if((control->num_ranks != num_ranks) ||
+	 (control->queue_bytes != queue_bytes)) {
+	log_shm.fatal() << "configuration mismatch with rank 0: ranks="
+			<< num_ranks << "/" << control->num_ranks
+			<< " queue=" << queue_bytes << "/" << control->queue_bytes;
+	abort();
+      }
+    }
+
+    outgoing = new OutgoingQueue[num_ranks];
+    incoming.resize(num_ranks);
+    for(NodeID i = 0; i < num_ranks; i++) {
+      outgoing[i].qhdr = queue_header(my_rank, i);
+      outgoing[i].data = reinterpret_cast<char *>(outgoing[i].qhdr + 1);
+      outgoing[i].cached_head = 0;
+      outgoing[i].next_tail = 0;
+      incoming[i].qhdr = queue_header(i, my_rank);
+      incoming[i].data = reinterpret_cast<char *>(incoming[i].qhdr + 1);
+      incoming[i].frag_header = 0;
+      incoming[i].frag_payload = 0;
+      incoming[i].frag_received = 0;
+    }
+    peer_segments.resize(num_ranks, 0);
+    peer_segment_bytes.resize(num_ranks, 0);
+    return my_rank;
+  }
+
+  // rank 0 answers each peer's join request with this run's id - a peer
+  //  that has mapped a stale control object never gets that answer
+  void ShmInternal::accept_peers(size_t run_id)
+  {
+    for(NodeID i = 1; i < num_ranks; i++) {
+      ShmRankInfo *info = rank_info(i);
+      long long waited = 0;
+      while(info->join_request.load_acquire() == 0) {
+	if(waited > ShmConfig::JOIN_TIMEOUT_US) {
+	  log_shm.fatal() << "timed out waiting for rank " << i
+			  << " to join '" << session << "'";
+	  abort();
+	}
+	usleep(1000);
+	waited += 1000;
+      }
+      info->join_ack.store_release(run_id);
+    }
+  }
+
+  // asks rank 0 to accept us into the mapped control object, returning
+  //  false if our session name stops referring to it (i.e. rank 0 has
+  //  replaced a stale one) before that happens
+  bool ShmInternal::join_control(const struct stat& mapped, long long& waited)
+  {
+    ShmRankInfo *info = rank_info(my_rank);
+    bool requested = false;
+    while(waited <= ShmConfig::JOIN_TIMEOUT_US) {
+      if(!requested &&
+	 (control->magic.load_acquire() == ShmConfig::CONTROL_MAGIC)) {
+	// a stale object still has the last run's answer in it
+	info->join_ack.store(0);
+	info->join_request.store_release(size_t(getpid()));
+	requested = true;
+      }
+      if(requested) {
+	size_t ack = info->join_ack.load_acquire();
+	if((ack != 0) && (ack == control->run_id.load()))
+	  return true;
+      }
+      int fd = shm_open(session.c_str(), O_RDONLY, 0600);
+      if(fd < 0)
+	return false;
+      struct stat st;
+      bool same = ((fstat(fd, &st) == 0) && (st.st_dev == mapped.st_dev) &&
+		   (st.st_ino == mapped.st_ino));
+      close(fd);
+      if(!same)
+	return false;
+      usleep(1000);
+      waited += 1000;
+    }
+    return false;
+  }
+
+  void ShmInternal::attach(RuntimeImpl *runtime, NetworkModule *network,
+			   std::vector<NetworkSegment *>& segments)
+  {
+    message_manager = runtime->message_manager;
+    shm_internal = this;
+
+    // host memory segments that haven't been allocated yet all go in a
+    //  shared memory object that our peers will map as well
+    size_t total_bytes = 0;
+    std::vector<size_t> offsets(segments.size(), 0);
+    for(size_t i = 0; i < segments.size(); i++) {
+      NetworkSegment *seg = segments[i];
+      if((seg->bytes == 0) || (seg->base != 0) ||
+	 (seg->memtype != NetworkSegmentInfo::HostMem))
+	continue;
+      size_t align = std::max(seg->alignment, ShmConfig::CACHE_LINE);
+      offsets[i] = align_up(total_bytes, align);
+      total_bytes = offsets[i] + seg->bytes;
+    }
+
+    char seg_name[256];
+    snprintf(seg_name, sizeof(seg_name), "%s.%d", session.c_str(), my_rank);
+    if(total_bytes > 0) {
+      shm_unlink(seg_name);
+      int fd = shm_open(seg_name, O_RDWR | O_CREAT | O_EXCL, 0600);
+      if((fd < 0) || (ftruncate(fd, total_bytes) < 0)) {
+	log_shm.fatal() << "could not create " << total_bytes
+			<< "-byte segment '" << seg_name << "': "
+			<< strerror(errno);
+	abort();
+      }
+      void *base = mmap(0, total_bytes, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+      if(base == MAP_FAILED) {
+	log_shm.fatal() << "could not map segment '" << seg_name << "': "
+			<< strerror(errno);
+	abort();
+      }
+      close(fd);
+      my_segment = static_cast<char *>(base);
+
+      for(size_t i = 0; i < segments.size(); i++) {
+	NetworkSegment *seg = segments[i];
+	if((seg->bytes == 0) || (seg->base != 0) ||
+	   (seg->memtype != NetworkSegmentInfo::HostMem))
+	  continue;
+	seg->base = my_segment + offsets[i];
+	// peers name locations in the segment by offset
+	size_t offset = offsets[i];
+	seg->add_rdma_info(network, &offset, sizeof(offset));
+      }
+    }
+    peer_segments[my_rank] = my_segment;
+    peer_segment_bytes[my_rank] = total_bytes;
+    rank_info(my_rank)->segment_bytes.store(total_bytes);
+
+    // once everybody's segment exists, map all of them
+    barrier();
+    for(NodeID i = 0; i < num_ranks; i++) {
+      if(i == my_rank) continue;
+      size_t bytes = rank_info(i)->segment_bytes.load();
+      if(bytes == 0) continue;
+      char peer_name[256];
+      snprintf(peer_name, sizeof(peer_name), "%s.%d", session.c_str(), i);
+      int fd = shm_open(peer_name, O_RDWR, 0600);
+      void *base = ((fd >= 0) ?
+		      mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) :
+		      MAP_FAILED);
+      if(base == MAP_FAILED) {
+	log_shm.fatal() << "could not map segment '" << peer_name << "': "
+			<< strerror(errno);
+	abort();
+      }
+      close(fd);
+      peer_segments[i] = static_cast<char *>(base);
+      peer_segment_bytes[i] = bytes;
+    }
+
+    // after everybody has mapped everything, the names can go away so that
+    //  nothing is left behind no matter how the processes exit
+    barrier();
+    if(total_bytes > 0)
+      shm_unlink(seg_name);
+    if((my_rank == 0) && !forked_peers)
+      shm_unlink(session.c_str());
+
+    log_shm.info() << "attached: rank=" << my_rank << "/" << num_ranks
+		   << " queue=" << queue_bytes << " segment=" << total_bytes;
+
+    core_rsrv = new CoreReservation("shm polling",
+				    *(runtime->core_reservations),
+				    CoreReservationParameters());
+    ThreadLaunchParameters tlp;
+    poller_thread = Thread::create_kernel_thread<ShmInternal,
+						 &ShmInternal::poller_loop>(this,
+									    tlp,
+									    *core_rsrv);
+  }
+
+  void ShmInternal::detach(RuntimeImpl *runtime)
+  {
+    // the runtime has already confirmed quiescence, so once everybody is
+    //  here, nothing else will be sent
+    barrier();
+
+    shutdown_flag.store(true);
+    poller_thread->join();
+    delete poller_thread;
+    poller_thread = 0;
+    delete core_rsrv;
+    core_rsrv = 0;
+
+    // a forked rank 0 reports the failure of any of its peers
+    for(size_t i = 0; i < children.size(); i++) {
+      int status;
+      std::map<pid_t, int>::const_iterator it = reaped_children.find(children[i]);
+      if(it != reaped_children.end())
+	status = it->second;
+      else
+	while((waitpid(children[i], &status, 0) < 0) && (errno == EINTR)) {}
+      if(!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+	log_shm.error() << "rank " << (i + 1) << " (pid " << children[i]
+			<< ") exited abnormally: status=" << status;
+	if(runtime->shutdown_result_code == 0)
+	  runtime->shutdown_result_code = 1;
+      }
+    }
+    children.clear();
+
+    shm_internal = 0;
+  }
+
+  void ShmInternal::check_children(void)
+  {
+    // only look at our own peers - the application may have children too
+    for(size_t i = 0; i < children.size(); i++) {
+      if(reaped_children.count(children[i]) > 0) continue;
+      int status;
+      if(waitpid(children[i], &status, WNOHANG) == children[i])
+	reaped_children[children[i]] = status;
+    }
+  }
+
+  void ShmInternal::backoff(void)
+  {
+    sched_yield();
+  }
+
+  void ShmInternal::barrier(void)
+  {
+    unsigned gen = control->barrier_generation.load_acquire();
+    if(control->barrier_count.fetch_add_acqrel(1) == unsigned(num_ranks - 1)) {
+      // last one in resets the count and releases everybody else
+      control->barrier_count.store(0);
+      control->barrier_generation.store_release(gen + 1);
+      return;
+    }
+
+    while(control->barrier_generation.load_acquire() == gen) {
+      if(!children.empty()) {
+	// a peer that died will never arrive
+	check_children();
+	if(!reaped_children.empty() &&
+	   (control->barrier_generation.load_acquire() == gen)) {
+	  log_shm.fatal() << "peer process exited during a barrier";
+	  abort();
+	}
+      }
+      backoff();
+    }
+  }
+
+  void ShmInternal::broadcast(NodeID root, const void *val_in, void *val_out,
+			      size_t bytes)
+  {
+    assert(bytes <= ShmConfig::COLLECTIVE_BYTES);
+    if(my_rank == root)
+      memcpy(rank_info(root)->scratch, val_in, bytes);
+    barrier();
+    memcpy(val_out, rank_info(root)->scratch, bytes);
+    // don't let the root reuse its scratch until everybody has read it
+    barrier();
+  }
+
+  void ShmInternal::gather(NodeID root, const void *val_in, void *vals_out,
+			   size_t bytes)
+  {
+    assert(bytes <= ShmConfig::COLLECTIVE_BYTES);
+    memcpy(rank_info(my_rank)->scratch, val_in, bytes);
+    barrier();
+    if(my_rank == root)
+      for(NodeID i = 0; i < num_ranks; i++)
+	memcpy(static_cast<char *>(vals_out) + (i * bytes),
+	       rank_info(i)->scratch, bytes);
+    barrier();
+  }
+
+  bool ShmInternal::check_for_quiescence(void)
+  {
+    // add up the total messages sent by anybody since the last time we tried
+    rank_info(my_rank)->sent_snapshot.store(messages_sent.exchange(0));
+    barrier();
+    size_t total = 0;
+    for(NodeID i = 0; i < num_ranks; i++)
+      total += rank_info(i)->sent_snapshot.load();
+    barrier();
+    // if it's zero, we're quiescent
+    return (total == 0);
+  }
+
+  char *ShmInternal::OutgoingQueue::reserve(size_t bytes, size_t capacity)
+  {
+    size_t tail = qhdr->tail.load();
+    size_t ofs = tail & (capacity - 1);
+    size_t skip = (((ofs + bytes) > capacity) ? (capacity - ofs) : 0);
+    if((tail + skip + bytes - cached_head) > capacity) {
+      cached_head = qhdr->head.load_acquire();
+      if((tail + skip + bytes - cached_head) > capacity)
+	return 0;
+    }
+    if(skip >= sizeof(ShmMessageHeader)) {
+      ShmMessageHeader *pad = reinterpret_cast<ShmMessageHeader *>(data + ofs);
+      pad->bytes = skip;
+      pad->type = ShmMessageHeader::MSG_PAD;
+    }
+    next_tail = tail + skip + bytes;
+    return data + ((tail + skip) & (capacity - 1));
+  }
+
+  void ShmInternal::OutgoingQueue::publish(void)
+  {
+    qhdr->tail.store_release(next_tail);
+  }
+
+  // copies [offset, offset+bytes) of a possibly-2D payload
+  static void copy_payload_range(char *dst, const void *src,
+				 size_t total_bytes, size_t lines,
+				 size_t line_stride,
+				 size_t offset, size_t bytes)
+  {
+    if(lines <= 1) {
+      memcpy(dst, static_cast<const char *>(src) + offset, bytes);
+      return;
+    }
+    size_t line_size = total_bytes / lines;
+    while(bytes > 0) {
+      size_t line = offset / line_size;
+      size_t line_ofs = offset % line_size;
+      size_t chunk = std::min(bytes, line_size - line_ofs);
+      memcpy(dst, (static_cast<const char *>(src) +
+		   (line * line_stride) + line_ofs), chunk);
+      dst += chunk;
+      offset += chunk;
+      bytes -= chunk;
+    }
+  }
+
+  void ShmInternal::write_record(NodeID target, OutgoingQueue& q,
+				 const ShmMessageHeader& info,
+				 const void *header, const void *payload,
+				 size_t payload_lines, size_t payload_line_stride,
+				 size_t payload_offset)
+  {
+    size_t bytes = (sizeof(ShmMessageHeader) +
+		    ShmMessageHeader::padded(info.header_size) +
+		    ShmMessageHeader::padded(info.chunk_size));
+    assert(bytes <= max_record_bytes);
+
+    // the receiver's poller never blocks, so the queue will drain
+    char *ptr;
+    while((ptr = q.reserve(bytes, queue_bytes)) == 0)
+      backoff();
+
+    ShmMessageHeader *mh = reinterpret_cast<ShmMessageHeader *>(ptr);
+    *mh = info;
+    mh->bytes = bytes;
+    char *pos = ptr + sizeof(ShmMessageHeader);
+    if(info.header_size > 0)
+      memcpy(pos, header, info.header_size);
+    pos += ShmMessageHeader::padded(info.header_size);
+    if(info.chunk_size > 0)
+      copy_payload_range(pos, payload, info.payload_size,
+			 payload_lines, payload_line_stride,
+			 payload_offset, info.chunk_size);
+    q.publish();
+  }
+
+  void ShmInternal::send_message(NodeID target, unsigned short msgid,
+				 const void *header, size_t header_size,
+				 const void *payload, size_t payload_size,
+				 size_t payload_lines, size_t payload_line_stride,
+				 const RemoteAddress *dest_payload_addr,
+				 uintptr_t remote_comp)
+  {
+    assert(target != my_rank);
+    assert((sizeof(ShmMessageHeader) +
+	    ShmMessageHeader::padded(header_size)) <= (max_record_bytes / 2));
+    OutgoingQueue& q = outgoing[target];
+
+    ShmMessageHeader info;
+    memset(&info, 0, sizeof(info));
+    info.msgid = msgid;
+    info.header_size = header_size;
+    info.payload_size = payload_size;
+    info.comp_ptr = remote_comp;
+
+    if(dest_payload_addr != 0) {
+      // the payload goes straight into the target's segment, and the
+      //  message just tells it the data has arrived
+      copy_payload_range(peer_segments[target] + dest_payload_addr->ptr,
+			 payload, payload_size,
+			 payload_lines, payload_line_stride,
+			 0, payload_size);
+      info.type = ShmMessageHeader::MSG_RDMA;
+      info.dest_offset = dest_payload_addr->ptr;
+      AutoLock<> al(q.mutex);
+      write_record(target, q, info, header, 0, 0, 0, 0);
+    } else if(payload_size <= max_inline_payload(header_size)) {
+      info.type = ShmMessageHeader::MSG_INLINE;
+      info.chunk_size = payload_size;
+      AutoLock<> al(q.mutex);
+      write_record(target, q, info, header, payload,
+		   payload_lines, payload_line_stride, 0);
+    } else {
+      // the fragments of a message must be contiguous in the queue, so we
+      //  hold the lock until the last one is written
+      AutoLock<> al(q.mutex);
+      size_t offset = 0;
+      info.type = ShmMessageHeader::MSG_FRAG_FIRST;
+      info.chunk_size = (max_inline_payload(header_size) & ~size_t(7));
+      write_record(target, q, info, header, payload,
+		   payload_lines, payload_line_stride, offset);
+      offset += info.chunk_size;
+      info.type = ShmMessageHeader::MSG_FRAG_CONT;
+      info.header_size = 0;
+      size_t max_chunk = (max_inline_payload(0) & ~size_t(7));
+      while(offset < payload_size) {
+	info.chunk_size = std::min(max_chunk, payload_size - offset);
+	write_record(target, q, info, 0, payload,
+		     payload_lines, payload_line_stride, offset);
+	offset += info.chunk_size;
+      }
+    }
+
+    messages_sent.fetch_add(1);
+  }
+
+  void ShmInternal::send_completion(NodeID target, uintptr_t comp_ptr)
+  {
+    ShmMessageHeader info;
+    memset(&info, 0, sizeof(info));
+    info.type = ShmMessageHeader::MSG_COMPLETION;
+    info.comp_ptr = comp_ptr;
+
+    OutgoingQueue& q = outgoing[target];
+    if(in_shm_poller) {
+      // the poller can't wait - try once and defer if the queue is busy
+      char *ptr = 0;
+      if(q.mutex.trylock()) {
+	ptr = q.reserve(sizeof(ShmMessageHeader), queue_bytes);
+	if(ptr != 0) {
+	  info.bytes = sizeof(ShmMessageHeader);
+	  memcpy(ptr, &info, sizeof(info));
+	  q.publish();
+	}
+	q.mutex.unlock();
+      }
+      if(ptr == 0)
+	deferred_completions.push_back(std::make_pair(target, comp_ptr));
+    } else {
+      AutoLock<> al(q.mutex);
+      write_record(target, q, info, 0, 0, 0, 0, 0);
+    }
+  }
+
+  /*static*/ void ShmInternal::message_handled(NodeID sender,
+					       uintptr_t comp_ptr,
+					       uintptr_t /*unused*/)
+  {
+    shm_internal->send_completion(sender, comp_ptr);
+  }
+
+  bool ShmInternal::retry_deferred_completions(void)
+  {
+    if(deferred_completions.empty())
+      return false;
+    std::vector<std::pair<NodeID, uintptr_t> > todo;
+    todo.swap(deferred_completions);
+    for(size_t i = 0; i < todo.size(); i++)
+      send_completion(todo[i].first, todo[i].second);
+    return (deferred_completions.size() < todo.size());
+  }
+
+  struct ShmCompletionList {
+    size_t bytes;
+
+    static const size_t TOTAL_CAPACITY = 256;
+    typedef char Storage_unaligned[TOTAL_CAPACITY];
+    REALM_ALIGNED_TYPE_CONST(Storage_aligned, Storage_unaligned,
+			     CompletionCallbackBase::ALIGNMENT);
+    Storage_aligned storage;
+  };
+
+  void ShmInternal::deliver(NodeID sender, const ShmMessageHeader& info,
+			    const void *header, int hdr_mode,
+			    const void *payload, int payload_mode)
+  {
+    // an inline handler might send a message and block behind a full
+    //  queue, so the poller always leaves the handlers to other threads
+    bool handled = message_manager->add_incoming_message(sender, info.msgid,
+							 header, info.header_size,
+							 hdr_mode,
+							 payload, info.payload_size,
+							 payload_mode,
+							 ((info.comp_ptr != 0) ?
+							    message_handled :
+							    0),
+							 info.comp_ptr,
+							 0,
+							 TimeLimit::relative(0));
+    if(handled && (info.comp_ptr != 0))
+      send_completion(sender, info.comp_ptr);
+  }
+
+  bool ShmInternal::poll_queue(NodeID sender, IncomingQueue& q)
+  {
+    size_t head = q.qhdr->head.load();
+    size_t tail = q.qhdr->tail.load_acquire();
+    if(head == tail)
+      return false;
+
+    while(head != tail) {
+      size_t ofs = head & (queue_bytes - 1);
+      if((queue_bytes - ofs) < sizeof(ShmMessageHeader)) {
+	// too small for a record - the sender skipped it
+	head += (queue_bytes - ofs);
+	continue;
+      }
+
+      const ShmMessageHeader& info = *reinterpret_cast<const ShmMessageHeader *>(q.data + ofs);
+      const char *header = q.data + ofs + sizeof(ShmMessageHeader);
+      const char *chunk = header + ShmMessageHeader::padded(info.header_size);
+      switch(info.type) {
+      case ShmMessageHeader::MSG_PAD:
+	break;
+
+      case ShmMessageHeader::MSG_INLINE:
+	{
+	  deliver(sender, info, header, PAYLOAD_COPY,
+		  chunk, ((info.payload_size > 0) ? PAYLOAD_COPY : PAYLOAD_NONE));
+	  break;
+	}
+
+      case ShmMessageHeader::MSG_FRAG_FIRST:
+	{
+	  assert(q.frag_payload == 0);
+	  q.frag_info = info;
+	  q.frag_header = static_cast<char *>(malloc(info.header_size));
+	  memcpy(q.frag_header, header, info.header_size);
+	  q.frag_payload = static_cast<char *>(malloc(info.payload_size));
+	  memcpy(q.frag_payload, chunk, info.chunk_size);
+	  q.frag_received = info.chunk_size;
+	  break;
+	}
+
+      case ShmMessageHeader::MSG_FRAG_CONT:
+	{
+	  assert(q.frag_payload != 0);
+	  memcpy(q.frag_payload + q.frag_received, chunk, info.chunk_size);
+	  q.frag_received += info.chunk_size;
+	  if(q.frag_received == q.frag_info.payload_size) {
+	    deliver(sender, q.frag_info, q.frag_header, PAYLOAD_FREE,
+		    q.frag_payload, PAYLOAD_FREE);
+	    q.frag_header = 0;
+	    q.frag_payload = 0;
+	    q.frag_received = 0;
+	  }
+	  break;
+	}
+
+      case ShmMessageHeader::MSG_RDMA:
+	{
+	  // payload is already in place in our segment
+	  deliver(sender, info, header, PAYLOAD_COPY,
+		  my_segment + info.dest_offset, PAYLOAD_KEEP);
+	  break;
+	}
+
+      case ShmMessageHeader::MSG_COMPLETION:
+	{
+	  ShmCompletionList *comp = reinterpret_cast<ShmCompletionList *>(info.comp_ptr);
+	  CompletionCallbackBase::invoke_all(comp->storage, comp->bytes);
+	  CompletionCallbackBase::destroy_all(comp->storage, comp->bytes);
+	  delete comp;
+	  break;
+	}
+
+      default:
+	assert(0 && "invalid shm message type");
+      }
+
+      head += info.bytes;
+      // give the space back right away so a blocked sender can continue
+      q.qhdr->head.store_release(head);
+    }
+    return true;
+  }
+
+  void ShmInternal::poller_loop(void)
+  {
+    in_shm_poller = true;
+    while(!shutdown_flag.load()) {
+      bool progress = retry_deferred_completions();
+      for(NodeID i = 0; i < num_ranks; i++)
+	if((i != my_rank) && poll_queue(i, incoming[i]))
+	  progress = true;
+      if(!progress)
+	backoff();
+    }
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class ShmRemoteMemory
+  //
+
+  // a peer's memory that lives in its segment - we have it mapped, so
+  //  accesses are direct, but instances are still owned by the peer
+  class ShmRemoteMemory : public RemoteMemory {
+  public:
+    ShmRemoteMemory(Memory _me, size_t _size, Memory::Kind k,
+		    char *_base, size_t _seg_offset);
+
+    virtual void get_bytes(off_t offset, void *dst, size_t size);
+    virtual void put_bytes(off_t offset, const void *src, size_t size);
+
+    virtual bool get_remote_addr(off_t offset, RemoteAddress& remote_addr);
+
+  protected:
+    char *base;
+    size_t seg_offset;
+  };
+
+  ShmRemoteMemory::ShmRemoteMemory(Memory _me, size_t _size, Memory::Kind k,
+				   char *_base, size_t _seg_offset)
+    : RemoteMemory(_me, _size, k, MKIND_RDMA)
+    , base(_base)
+    , seg_offset(_seg_offset)
+  {}
+
+  void ShmRemoteMemory::get_bytes(off_t offset, void *dst, size_t size)
+  {
+    memcpy(dst, base + offset, size);
+  }
+
+  void ShmRemoteMemory::put_bytes(off_t offset, const void *src, size_t size)
+  {
+    memcpy(base + offset, src, size);
+  }
+
+  bool ShmRemoteMemory::get_remote_addr(off_t offset, RemoteAddress& remote_addr)
+  {
+    // remote addresses are offsets in the owner's segment
+    remote_addr.ptr = seg_offset + offset;
+    return true;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class ShmIBMemory
+  //
+
+  class ShmIBMemory : public IBMemory {
+  public:
+    ShmIBMemory(Memory _me, size_t _size, Memory::Kind k, size_t _seg_offset);
+
+    virtual bool get_remote_addr(off_t offset, RemoteAddress& remote_addr);
+
+  protected:
+    size_t seg_offset;
+  };
+
+  ShmIBMemory::ShmIBMemory(Memory _me, size_t _size, Memory::Kind k,
+			   size_t _seg_offset)
+    : IBMemory(_me, _size, MKIND_REMOTE, k, 0, 0)
+    , seg_offset(_seg_offset)
+  {}
+
+  bool ShmIBMemory::get_remote_addr(off_t offset, RemoteAddress& remote_addr)
+  {
+    remote_addr.ptr = seg_offset + offset;
+    return true;
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class ShmMessageImpl
+  //
+
+  class ShmMessageImpl : public ActiveMessageImpl {
+  public:
+    ShmMessageImpl(ShmInternal *_internal,
+		   NodeID _target,
+		   unsigned short _msgid,
+		   size_t _header_size,
+		   size_t _max_payload_size,
+		   const void *_src_payload_addr,
+		   size_t _src_payload_lines,
+		   size_t _src_payload_line_stride,
+		   const RemoteAddress *_dest_payload_addr);
+    ShmMessageImpl(ShmInternal *_internal,
+		   const NodeSet& _targets,
+		   unsigned short _msgid,
+		   size_t _header_size,
+		   size_t _max_payload_size,
+		   const void *_src_payload_addr,
+		   size_t _src_payload_lines,
+		   size_t _src_payload_line_stride);
+
+    virtual ~ShmMessageImpl();
+
+    // reserves space for a local/remote completion - caller will
+    //  placement-new the completion at the provided address
+    virtual void *add_local_completion(size_t size);
+    virtual void *add_remote_completion(size_t size);
+
+    virtual void commit(size_t act_payload_size);
+    virtual void cancel();
+
+  protected:
+    static void *reserve_completion(ShmCompletionList *& list, size_t size);
+
+    ShmInternal *internal;
+    NodeID target;
+    NodeSet targets;
+    bool is_multicast;
+    const void *src_payload_addr;
+    size_t src_payload_lines;
+    size_t src_payload_line_stride;
+    bool has_dest;
+    RemoteAddress dest_payload_addr;
+    size_t header_size;
+    ShmCompletionList *local_comp, *remote_comp;
+
+    unsigned short msgid;
+    unsigned long msg_header;
+    // nothing should appear after 'msg_header'
+  };
+
+  ShmMessageImpl::ShmMessageImpl(ShmInternal *_internal,
+				 NodeID _target,
+				 unsigned short _msgid,
+				 size_t _header_size,
+				 size_t _max_payload_size,
+				 const void *_src_payload_addr,
+				 size_t _src_payload_lines,
+				 size_t _src_payload_line_stride,
+				 const RemoteAddress *_dest_payload_addr)
+    : internal(_internal)
+    , target(_target)
+    , is_multicast(false)
+    , src_payload_addr(_src_payload_addr)
+    , src_payload_lines(_src_payload_lines)
+    , src_payload_line_stride(_src_payload_line_stride)
+    , has_dest(_dest_payload_addr != 0)
+    , header_size(_header_size)
+    , local_comp(0)
+    , remote_comp(0)
+    , msgid(_msgid)
+  {
+    if(has_dest)
+      dest_payload_addr = *_dest_payload_addr;
+    if(_max_payload_size && (src_payload_addr == 0)) {
+      payload_base = reinterpret_cast<char *>(malloc(_max_payload_size));
+    } else {
+      payload_base = 0;
+    }
+    payload_size = _max_payload_size;
+    header_base = &msg_header;
+  }
+
+  ShmMessageImpl::ShmMessageImpl(ShmInternal *_internal,
+				 const NodeSet& _targets,
+				 unsigned short _msgid,
+				 size_t _header_size,
+				 size_t _max_payload_size,
+				 const void *_src_payload_addr,
+				 size_t _src_payload_lines,
+				 size_t _src_payload_line_stride)
+    : internal(_internal)
+    , target(-1)
+    , targets(_targets)
+    , is_multicast(true)
+    , src_payload_addr(_src_payload_addr)
+    , src_payload_lines(_src_payload_lines)
+    , src_payload_line_stride(_src_payload_line_stride)
+    , has_dest(false)
+    , header_size(_header_size)
+    , local_comp(0)
+    , remote_comp(0)
+    , msgid(_msgid)
+  {
+    if(_max_payload_size && (src_payload_addr == 0)) {
+      payload_base = reinterpret_cast<char *>(malloc(_max_payload_size));
+    } else {
+      payload_base = 0;
+    }
+    payload_size = _max_payload_size;
+    header_base = &msg_header;
+  }
+
+  ShmMessageImpl::~ShmMessageImpl()
+  {}
+
+  /*static*/ void *ShmMessageImpl::reserve_completion(ShmCompletionList *& list,
+						      size_t size)
+  {
+    if(list == 0) {
+      list = new ShmCompletionList;
+      list->bytes = 0;
+    }
+    size_t ofs = list->bytes;
+    list->bytes += size;
+    assert(list->bytes <= ShmCompletionList::TOTAL_CAPACITY);
+    return (list->storage + ofs);
+  }
+
+  void *ShmMessageImpl::add_local_completion(size_t size)
+  {
+    return reserve_completion(local_comp, size);
+  }
+
+  void *ShmMessageImpl::add_remote_completion(size_t size)
+  {
+    return reserve_completion(remote_comp, size);
+  }
+
+  void ShmMessageImpl::commit(size_t act_payload_size)
+  {
+    const void *payload = ((src_payload_addr != 0) ? src_payload_addr :
+			                             payload_base);
+    size_t lines = ((src_payload_addr != 0) ? src_payload_lines : 0);
+    size_t stride = ((src_payload_addr != 0) ? src_payload_line_stride : 0);
+    if(is_multicast) {
+      assert(remote_comp == 0);
+      for(NodeSet::const_iterator it = targets.begin();
+	  it != targets.end();
+	  ++it)
+	internal->send_message(*it, msgid, &msg_header, header_size,
+			       payload, act_payload_size, lines, stride,
+			       0, 0);
+    } else
+      internal->send_message(target, msgid, &msg_header, header_size,
+			     payload, act_payload_size, lines, stride,
+			     (has_dest ? &dest_payload_addr : 0),
+			     reinterpret_cast<uintptr_t>(remote_comp));
+    if(payload_size && (src_payload_addr == 0))
+      free(payload_base);
+    // the data has been copied by the time send_message returns, so local
+    //  completion is immediate
+    if(local_comp != 0) {
+      CompletionCallbackBase::invoke_all(local_comp->storage,
+					 local_comp->bytes);
+      CompletionCallbackBase::destroy_all(local_comp->storage,
+					  local_comp->bytes);
+      delete local_comp;
+    }
+  }
+
+  void ShmMessageImpl::cancel()
+  {
+    if(payload_size && (src_payload_addr == 0))
+      free(payload_base);
+    if(local_comp != 0) {
+      CompletionCallbackBase::destroy_all(local_comp->storage,
+					  local_comp->bytes);
+      delete local_comp;
+    }
+    if(remote_comp != 0) {
+      CompletionCallbackBase::destroy_all(remote_comp->storage,
+					  remote_comp->bytes);
+      delete remote_comp;
+    }
+  }
+
+
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class ShmModule
+  //
+
+  ShmModule::ShmModule(ShmInternal *_internal)
+    : NetworkModule("shm")
+    , internal(_internal)
+  {}
+
+  ShmModule::~ShmModule(void)
+  {
+    delete internal;
+  }
+
+  /*static*/ NetworkModule *ShmModule::create_network_module(RuntimeImpl *runtime,
+							   int *argc,
+							   const char ***argv)
+  {
+    // these have to be known before the normal command line parsing, so
+    //  peek at them here - they're removed in parse_command_line
+    int cfg_ranks = 0;
+    size_t cfg_queue_size = 1 << 20;
+    {
+      CommandLineParser cp;
+      cp.add_option_int("-shm:ranks", cfg_ranks)
+	.add_option_int_units("-shm:queue", cfg_queue_size, 'k');
+      bool ok = cp.parse_command_line(*argc, *argv);
+      assert(ok);
+    }
+
+    // an external launcher tells us where we are in the environment,
+    //  otherwise we start the other ranks ourselves if asked to
+    int my_rank = 0;
+    bool fork_peers = false;
+    std::string session;
+    const char *e_ranks = getenv("REALM_SHM_RANKS");
+    if(e_ranks) {
+      cfg_ranks = atoi(e_ranks);
+      const char *e_rank = getenv("REALM_SHM_RANK");
+      if(!e_rank) {
+	log_shm.fatal() << "REALM_SHM_RANKS is set but REALM_SHM_RANK is not";
+	abort();
+      }
+      my_rank = atoi(e_rank);
+      const char *e_session = getenv("REALM_SHM_SESSION");
+      if(e_session) {
+	session = e_session;
+      } else {
+	// rank 0 removes any existing object with the session name, so the
+	//  default has to be unique to this job - use the launcher's job id
+	//  if we know of one, or else the launcher's pid (all ranks of a job
+	//  are children of the same process)
+	static const char *job_vars[] = { "SLURM_JOB_ID", "SLURM_STEP_ID",
+					  "PMIX_NAMESPACE",
+					  "OMPI_MCA_ess_base_jobid",
+					  "PMI_JOBID" };
+	std::string job_id;
+	for(size_t i = 0; i < sizeof(job_vars) / sizeof(job_vars[0]); i++) {
+	  const char *e = getenv(job_vars[i]);
+	  if(!e) continue;
+	  job_id += '.';
+	  // object names can't contain slashes
+	  for(const char *c = e; *c; c++)
+	    job_id += (*c == '/') ? '_' : *c;
+	}
+	char buffer[64];
+	if(job_id.empty())
+	  snprintf(buffer, sizeof(buffer), "realm_shm.%d.%d",
+		   int(getuid()), int(getppid()));
+	else
+	  snprintf(buffer, sizeof(buffer), "realm_shm.%d", int(getuid()));
+	session = buffer + job_id;
+      }
+    } else {
+      if(cfg_ranks <= 1)
+	return 0;  // not requested
+      fork_peers = true;
+      char buffer[64];
+      snprintf(buffer, sizeof(buffer), "realm_shm.%d", int(getpid()));
+      session = buffer;
+    }
+    if(session[0] != '/')
+      session = "/" + session;
+
+    if((cfg_ranks < 1) || (my_rank < 0) || (my_rank >= cfg_ranks)) {
+      log_shm.fatal() << "bad rank configuration: rank=" << my_rank
+		      << " ranks=" << cfg_ranks;
+      abort();
+    }
+
+    // queue offsets are computed by masking, so the size must be a power
+    //  of two
+    size_t queue_bytes = 64 << 10;
+    while(queue_bytes < cfg_queue_size)
+      queue_bytes <<= 1;
+
+    ShmInternal *internal = new ShmInternal;
+    // forked peers pick up their rank in init
+    Network::my_node_id = internal->init(session, cfg_ranks, my_rank,
+					 queue_bytes, fork_peers);
+    Network::max_node_id = cfg_ranks - 1;
+    return new ShmModule(internal);
+  }
+
+  // actual parsing of the command line should wait until here if at all
+  //  possible
+  void ShmModule::parse_command_line(RuntimeImpl *runtime,
+				     std::vector<std::string>& cmdline)
+  {
+    int cfg_ranks = 0;
+    size_t cfg_queue_size = 0;
+    size_t deprecated_gsize = 0;
+    CommandLineParser cp;
+    cp.add_option_int("-shm:ranks", cfg_ranks)
+      .add_option_int_units("-shm:queue", cfg_queue_size, 'k')
+      .add_option_int_units("-ll:gsize", deprecated_gsize, 'm');
+
+    bool ok = cp.parse_command_line(cmdline);
+    assert(ok);
+
+    if(deprecated_gsize > 0) {
+      log_shm.fatal() << "shm network does not provide a 'global' memory - '-ll:gsize' not permitted";
+      abort();
+    }
+  }
+
+  // "attaches" to the network, if that is meaningful - attempts to
+  //  bind/register/(pick your network-specific verb) the requested memory
+  //  segments with the network
+  void ShmModule::attach(RuntimeImpl *runtime,
+			 std::vector<NetworkSegment *>& segments)
+  {
+    internal->attach(runtime, this, segments);
+  }
+
+  // detaches from the network
+  void ShmModule::detach(RuntimeImpl *runtime,
+			 std::vector<NetworkSegment *>& segments)
+  {
+    internal->detach(runtime);
+  }
+
+  // collective communication within this network
+  void ShmModule::barrier(void)
+  {
+    internal->barrier();
+  }
+
+  void ShmModule::broadcast(NodeID root,
+			    const void *val_in, void *val_out, size_t bytes)
+  {
+    internal->broadcast(root, val_in, val_out, bytes);
+  }
+
+  void ShmModule::gather(NodeID root,
+			 const void *val_in, void *vals_out, size_t bytes)
+  {
+    internal->gather(root, val_in, vals_out, bytes);
+  }
+
+  bool ShmModule::check_for_quiescence(void)
+  {
+    return internal->check_for_quiescence();
+  }
+
+  // used to create a remote proxy for a memory
+  MemoryImpl *ShmModule::create_remote_memory(Memory m, size_t size,
+					      Memory::Kind kind,
+					      const ByteArray& rdma_info)
+  {
+    // rdma info is the memory's offset in the owner's segment
+    assert(rdma_info.size() == sizeof(size_t));
+    size_t offset;
+    memcpy(&offset, rdma_info.base(), sizeof(size_t));
+    NodeID owner = ID(m).memory_owner_node();
+    return new ShmRemoteMemory(m, size, kind,
+			       internal->peer_segment_base(owner) + offset,
+			       offset);
+  }
+
+  IBMemory *ShmModule::create_remote_ib_memory(Memory m, size_t size,
+					       Memory::Kind kind,
+					       const ByteArray& rdma_info)
+  {
+    assert(rdma_info.size() == sizeof(size_t));
+    size_t offset;
+    memcpy(&offset, rdma_info.base(), sizeof(size_t));
+    return new ShmIBMemory(m, size, kind, offset);
+  }
+
+  ActiveMessageImpl *ShmModule::create_active_message_impl(NodeID target,
+							   unsigned short msgid,
+							   size_t header_size,
+							   size_t max_payload_size,
+							   const void *src_payload_addr,
+							   size_t src_payload_lines,
+							   size_t src_payload_line_stride,
+							   void *storage_base,
+							   size_t storage_size)
+  {
+    assert(storage_size >= sizeof(ShmMessageImpl));
+    return new(storage_base) ShmMessageImpl(internal, target, msgid,
+					    header_size, max_payload_size,
+					    src_payload_addr,
+					    src_payload_lines,
+					    src_payload_line_stride,
+					    0);
+  }
+
+  ActiveMessageImpl *ShmModule::create_active_message_impl(NodeID target,
+							   unsigned short msgid,
+							   size_t header_size,
+							   size_t max_payload_size,
+							   const void *src_payload_addr,
+							   size_t src_payload_lines,
+							   size_t src_payload_line_stride,
+							   const RemoteAddress& dest_payload_addr,
+							   void *storage_base,
+							   size_t storage_size)
+  {
+    assert(storage_size >= sizeof(ShmMessageImpl));
+    return new(storage_base) ShmMessageImpl(internal, target, msgid,
+					    header_size, max_payload_size,
+					    src_payload_addr,
+					    src_payload_lines,
+					    src_payload_line_stride,
+					    &dest_payload_addr);
+  }
+
+  ActiveMessageImpl *ShmModule::create_active_message_impl(const NodeSet& targets,
+							   unsigned short msgid,
+							   size_t header_size,
+							   size_t max_payload_size,
+							   const void *src_payload_addr,
+							   size_t src_payload_lines,
+							   size_t src_payload_line_stride,
+							   void *storage_base,
+							   size_t storage_size)
+  {
+    assert(storage_size >= sizeof(ShmMessageImpl));
+    return new(storage_base) ShmMessageImpl(internal, targets, msgid,
+					    header_size, max_payload_size,
+					    src_payload_addr,
+					    src_payload_lines,
+					    src_payload_line_stride);
+  }
+
+  size_t ShmModule::recommended_max_payload(NodeID target,
+					    bool with_congestion,
+					    size_t header_size)
+  {
+    // anything bigger than this is sent in fragments
+    return internal->max_inline_payload(header_size);
+  }
+
+  size_t ShmModule::recommended_max_payload(const NodeSet& targets,
+					    bool with_congestion,
+					    size_t header_size)
+  {
+    return internal->max_inline_payload(header_size);
+  }
+
+  size_t ShmModule::recommended_max_payload(NodeID target,
+					    const RemoteAddress& dest_payload_addr,
+					    bool with_congestion,
+					    size_t header_size)
+  {
+    // it's just a memcpy, but keep individual copies from holding up the
+    //  sender for too long
+    return 4 << 20; // 4 MB
+  }
+
+  size_t ShmModule::recommended_max_payload(NodeID target,
+					    const void *data, size_t bytes_per_line,
+					    size_t lines, size_t line_stride,
+					    bool with_congestion,
+					    size_t header_size)
+  {
+    // we don't care about source data location
+    return recommended_max_payload(target, with_congestion, header_size);
+  }
+
+  size_t ShmModule::recommended_max_payload(const NodeSet& targets,
+					    const void *data, size_t bytes_per_line,
+					    size_t lines, size_t line_stride,
+					    bool with_congestion,
+					    size_t header_size)
+  {
+    // we don't care about source data location
+    return recommended_max_payload(targets, with_congestion, header_size);
+  }
+
+  size_t ShmModule::recommended_max_payload(NodeID target,
+					    const void *data, size_t bytes_per_line,
+					    size_t lines, size_t line_stride,
+					    const RemoteAddress& dest_payload_addr,
+					    bool with_congestion,
+					    size_t header_size)
+  {
+    // we don't care about source data location
+    return recommended_max_payload(target, dest_payload_addr,
+				   with_congestion, header_size);
+  }
+
+}; // namespace Realm
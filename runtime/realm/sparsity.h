@@ -83,6 +83,59 @@ namespace Realm {
   REALM_PUBLIC_API
   inline std::ostream& operator<<(std::ostream& os, SparsityMap<N,T> s) { return os << std::hex << s.id << std::dec; }
 
+  // a HierarchicalBitMap records which points of a rectangle are present in
+  //  a sparsity map entry - this is much more compact than a list of tiny
+  //  rectangles when the entry's points are scattered
+  // bits are stored a row (i.e. a line in dimension 0) at a time, with each
+  //  row starting on a new word, and a second level of bits notes which
+  //  words are non-zero so that empty regions can be skipped quickly
+  template <int N, typename T>
+  class REALM_INTERNAL_API_EXTERNAL_LINKAGE HierarchicalBitMap {
+  public:
+    // all bits start out clear
+    HierarchicalBitMap(const Rect<N,T>& _bounds);
+    // 'words' must be in the layout described by get_words()
+    HierarchicalBitMap(const Rect<N,T>& _bounds, const uint64_t *_words);
+
+    const Rect<N,T>& get_bounds(void) const;
+
+    // 'r' must be contained in the bounds of the bitmap
+    void set_rect(const Rect<N,T>& r);
+
+    // 'p' must be contained in the bounds of the bitmap
+    bool get_bit(const Point<N,T>& p) const;
+
+    // queries on the intersection of 'r' with the bounds of the bitmap
+    size_t count_bits(const Rect<N,T>& r) const;
+    bool any_bits(const Rect<N,T>& r) const;
+
+    // iteration over the maximal runs of set bits in dimension 0 within
+    //  'restriction' (a run never covers more than one row) - 'next_run'
+    //  continues from the run found by the previous call
+    bool first_run(const Rect<N,T>& restriction, Rect<N,T>& run) const;
+    bool next_run(const Rect<N,T>& restriction, Rect<N,T>& run) const;
+
+    // raw storage, for serialization - a row's words start at
+    //  (row_index(p) * words_per_row())
+    size_t words_per_row(void) const;
+    size_t row_index(const Point<N,T>& p) const;
+    size_t num_words(void) const;
+    const uint64_t *get_words(void) const;
+
+    // number of bytes needed for a bitmap covering 'r'
+    static size_t storage_bytes(const Rect<N,T>& r);
+
+  protected:
+    bool find_run(const Rect<N,T>& restriction, Point<N,T> pos,
+		  Rect<N,T>& run) const;
+    void update_summary(size_t first_word, size_t last_word);
+
+    Rect<N,T> bounds;
+    size_t row_words;
+    std::vector<uint64_t> words;
+    std::vector<uint64_t> summary;  // one bit per word, set if word != 0
+  };
+
   template <int N, typename T>
   struct SparsityMapEntry {
     Rect<N,T> bounds;
@@ -110,6 +163,18 @@ namespace Realm {
     //  dense array of bits describing the validity of each point in the rectangle
 
     const std::vector<SparsityMapEntry<N,T> >& get_entries(void);
+
+    // spatial queries on the precise entries, which must be valid - these
+    //  return indices into get_entries() of entries whose bounds contain the
+    //  point or overlap the rectangle (a 'max_results' of 0 means no limit),
+    //  and use an index built on first use for large multi-dimensional maps
+    bool find_entry(const Point<N,T>& p, size_t& entry_idx);
+    void find_overlapping_entries(const Rect<N,T>& r,
+				  std::vector<size_t>& overlaps,
+				  size_t max_results = 0);
+
+    // returns true if any point in 'r' is present in the precise entries
+    bool entries_overlap(const Rect<N,T>& r);
     
     // a sparsity map can exist in an approximate form as well - this is a bounded list of rectangles
     //  that are guaranteed to cover all actual entries
@@ -54,6 +54,53 @@ namespace Realm {
   }
 
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class HierarchicalBitMap<N,T>
+
+  template <int N, typename T>
+  inline const Rect<N,T>& HierarchicalBitMap<N,T>::get_bounds(void) const
+  {
+    return bounds;
+  }
+
+  template <int N, typename T>
+  inline size_t HierarchicalBitMap<N,T>::words_per_row(void) const
+  {
+    return row_words;
+  }
+
+  template <int N, typename T>
+  inline size_t HierarchicalBitMap<N,T>::row_index(const Point<N,T>& p) const
+  {
+    // dimension 1 varies fastest
+    size_t row = 0;
+    for(int i = N - 1; i >= 1; i--)
+      row = (row * size_t(bounds.hi[i] - bounds.lo[i] + 1)) + size_t(p[i] - bounds.lo[i]);
+    return row;
+  }
+
+  template <int N, typename T>
+  inline size_t HierarchicalBitMap<N,T>::num_words(void) const
+  {
+    return words.size();
+  }
+
+  template <int N, typename T>
+  inline const uint64_t *HierarchicalBitMap<N,T>::get_words(void) const
+  {
+    return (words.empty() ? 0 : &words[0]);
+  }
+
+  template <int N, typename T>
+  inline bool HierarchicalBitMap<N,T>::get_bit(const Point<N,T>& p) const
+  {
+    size_t ofs = size_t(p[0] - bounds.lo[0]);
+    uint64_t w = words[(row_index(p) * row_words) + (ofs >> 6)];
+    return ((w >> (ofs & 63)) & 1) != 0;
+  }
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class SparsityMapPublicImpl<N,T>
@@ -343,107 +343,121 @@ namespace Realm {
 
   bool SubgraphImpl::compile(void)
   {
-    typedef std::map<std::pair<SubgraphDefinition::OpKind, unsigned>, unsigned> TopoMap;
-    TopoMap toposort;
-
-    unsigned nextval = 0;
-    for(unsigned i = 0; i < defn->tasks.size(); i++)
-      toposort[std::make_pair(SubgraphDefinition::OPKIND_TASK, i)] = nextval++;
-    for(unsigned i = 0; i < defn->copies.size(); i++)
-      toposort[std::make_pair(SubgraphDefinition::OPKIND_COPY, i)] = nextval++;
-    for(unsigned i = 0; i < defn->arrivals.size(); i++)
-      toposort[std::make_pair(SubgraphDefinition::OPKIND_ARRIVAL, i)] = nextval++;
-    for(unsigned i = 0; i < defn->instantiations.size(); i++)
-      toposort[std::make_pair(SubgraphDefinition::OPKIND_INSTANTIATION, i)] = nextval++;
-    for(unsigned i = 0; i < defn->acquires.size(); i++)
-      toposort[std::make_pair(SubgraphDefinition::OPKIND_ACQUIRE, i)] = nextval++;
-    for(unsigned i = 0; i < defn->releases.size(); i++)
-      toposort[std::make_pair(SubgraphDefinition::OPKIND_RELEASE, i)] = nextval++;
-    unsigned total_ops = nextval;
+    // every operation gets a dense node index - operations of a given kind
+    //  occupy a contiguous range starting at op_base[kind]
+    std::vector<unsigned> op_base(SubgraphDefinition::OPKIND_EXT_PRECOND + 1, 0);
+    op_base[SubgraphDefinition::OPKIND_COPY] = (op_base[SubgraphDefinition::OPKIND_TASK] +
+						defn->tasks.size());
+    op_base[SubgraphDefinition::OPKIND_ARRIVAL] = (op_base[SubgraphDefinition::OPKIND_COPY] +
+						   defn->copies.size());
+    op_base[SubgraphDefinition::OPKIND_INSTANTIATION] = (op_base[SubgraphDefinition::OPKIND_ARRIVAL] +
+							 defn->arrivals.size());
+    op_base[SubgraphDefinition::OPKIND_ACQUIRE] = (op_base[SubgraphDefinition::OPKIND_INSTANTIATION] +
+						   defn->instantiations.size());
+    op_base[SubgraphDefinition::OPKIND_RELEASE] = (op_base[SubgraphDefinition::OPKIND_ACQUIRE] +
+						   defn->acquires.size());
+    op_base[SubgraphDefinition::OPKIND_EXT_PRECOND] = (op_base[SubgraphDefinition::OPKIND_RELEASE] +
+						       defn->releases.size());
+    unsigned total_ops = op_base[SubgraphDefinition::OPKIND_EXT_PRECOND];
+
+    std::vector<unsigned> dep_src(defn->dependencies.size());
+    std::vector<unsigned> dep_tgt(defn->dependencies.size());
 
     // for subgraph instantiations, we need to do a pass over the dependencies
-    //  to see which ports are used
+    //  to see which ports are used - this pass also counts the edges between
+    //  operations for the sort below
     std::vector<unsigned> inst_pre_max_port(defn->instantiations.size(), 0);
     std::vector<unsigned> inst_post_max_port(defn->instantiations.size(), 0);
+    std::vector<unsigned> in_degree(total_ops, 0);
+    std::vector<unsigned> succ_start(total_ops + 1, 0);
+    unsigned num_ext_postcond = 0;
 
-    for(std::vector<SubgraphDefinition::Dependency>::const_iterator it = defn->dependencies.begin();
-	it != defn->dependencies.end();
-	++it) {
-      if(it->src_op_kind == SubgraphDefinition::OPKIND_INSTANTIATION) {
-	inst_post_max_port[it->src_op_index] = std::max(inst_post_max_port[it->src_op_index],
-							it->src_op_port);
+    for(size_t i = 0; i < defn->dependencies.size(); i++) {
+      const SubgraphDefinition::Dependency& dep = defn->dependencies[i];
+
+      if(dep.src_op_kind == SubgraphDefinition::OPKIND_INSTANTIATION) {
+	inst_post_max_port[dep.src_op_index] = std::max(inst_post_max_port[dep.src_op_index],
+							dep.src_op_port);
       } else
-	assert(it->src_op_port == 0);
+	assert(dep.src_op_port == 0);
 
-      if(it->tgt_op_kind == SubgraphDefinition::OPKIND_INSTANTIATION) {
-	inst_pre_max_port[it->tgt_op_index] = std::max(inst_pre_max_port[it->tgt_op_index],
-						       it->tgt_op_port);
+      if(dep.tgt_op_kind == SubgraphDefinition::OPKIND_INSTANTIATION) {
+	inst_pre_max_port[dep.tgt_op_index] = std::max(inst_pre_max_port[dep.tgt_op_index],
+						       dep.tgt_op_port);
       } else
-	assert(it->tgt_op_port == 0);
-    }
-    
-    // sort by performing passes over dependency list...
-    // any dependency whose target is before the source is resolved by
-    //  moving the target to be after everybody
-    // takes at most depth (<= N) passes unless there are loops
-    bool converged = false;
-    for(unsigned i = 0; !converged && (i < total_ops); i++) {
-      converged = true;
-      for(std::vector<SubgraphDefinition::Dependency>::const_iterator it = defn->dependencies.begin();
-	  it != defn->dependencies.end();
-	  ++it) {
-	// external pre/post-conditions are always satisfied
-	if(it->src_op_kind == SubgraphDefinition::OPKIND_EXT_PRECOND) continue;
-	if(it->tgt_op_kind == SubgraphDefinition::OPKIND_EXT_POSTCOND) continue;
-
-	TopoMap::const_iterator src = toposort.find(std::make_pair(it->src_op_kind, it->src_op_index));
-	assert(src != toposort.end());
-
-	TopoMap::iterator tgt = toposort.find(std::make_pair(it->tgt_op_kind, it->tgt_op_index));
-	assert(tgt != toposort.end());
-
-	if(src->second > tgt->second) {
-	  tgt->second = nextval++;
-	  converged = false;
-	}
+	assert(dep.tgt_op_port == 0);
+
+      if(dep.src_op_kind == SubgraphDefinition::OPKIND_EXT_PRECOND) {
+	dep_src[i] = unsigned(-1);
+      } else {
+	assert((dep.src_op_kind > SubgraphDefinition::OPKIND_INVALID) &&
+	       (dep.src_op_kind < SubgraphDefinition::OPKIND_EXT_PRECOND));
+	dep_src[i] = op_base[dep.src_op_kind] + dep.src_op_index;
+	assert(dep_src[i] < op_base[dep.src_op_kind + 1]);
+      }
+
+      if(dep.tgt_op_kind == SubgraphDefinition::OPKIND_EXT_POSTCOND) {
+	dep_tgt[i] = unsigned(-1);
+	if(dep.tgt_op_index >= num_ext_postcond)
+	  num_ext_postcond = dep.tgt_op_index + 1;
+      } else {
+	assert((dep.tgt_op_kind > SubgraphDefinition::OPKIND_INVALID) &&
+	       (dep.tgt_op_kind < SubgraphDefinition::OPKIND_EXT_PRECOND));
+	dep_tgt[i] = op_base[dep.tgt_op_kind] + dep.tgt_op_index;
+	assert(dep_tgt[i] < op_base[dep.tgt_op_kind + 1]);
+      }
+
+      // external pre/post-conditions are always satisfied
+      if((dep_src[i] != unsigned(-1)) && (dep_tgt[i] != unsigned(-1))) {
+	succ_start[dep_src[i] + 1]++;
+	in_degree[dep_tgt[i]]++;
       }
-    }
-    if(!converged) {
-      log_subgraph.error() << "subgraph sort did not converge - has a cycle?";
-      return false;
     }
 
-    // re-compact the ordering indices
-    unsigned curval = 0;
-    while(curval < total_ops) {
-      TopoMap::iterator best = toposort.end();
-      for(TopoMap::iterator it = toposort.begin(); it != toposort.end(); ++it)
-	if((it->second >= curval) && ((best == toposort.end()) ||
-				      (best->second > it->second)))
-	  best = it;
-      assert(best != toposort.end());
-      best->second = curval++;
+    // build a compressed adjacency list of successors
+    for(unsigned i = 0; i < total_ops; i++)
+      succ_start[i + 1] += succ_start[i];
+    std::vector<unsigned> succs(succ_start[total_ops]);
+    {
+      std::vector<unsigned> fill_pos(succ_start.begin(), succ_start.end() - 1);
+      for(size_t i = 0; i < defn->dependencies.size(); i++)
+	if((dep_src[i] != unsigned(-1)) && (dep_tgt[i] != unsigned(-1)))
+	  succs[fill_pos[dep_src[i]]++] = dep_tgt[i];
     }
 
-    // if there are any external postconditions, add them to the end of the
-    //  toposort
-    unsigned num_ext_postcond = 0;
-    for(std::vector<SubgraphDefinition::Dependency>::const_iterator it = defn->dependencies.begin();
-	it != defn->dependencies.end();
-	++it) {
-      if(it->tgt_op_kind != SubgraphDefinition::OPKIND_EXT_POSTCOND) continue;
-      if(it->tgt_op_index >= num_ext_postcond)
-	num_ext_postcond = it->tgt_op_index + 1;
+    // topological sort (Kahn) - 'order' doubles as the FIFO work queue, which
+    //  keeps independent operations in their original kind/index order
+    std::vector<unsigned> order;
+    order.reserve(total_ops);
+    for(unsigned i = 0; i < total_ops; i++)
+      if(in_degree[i] == 0)
+	order.push_back(i);
+    for(size_t head = 0; head < order.size(); head++) {
+      unsigned n = order[head];
+      for(unsigned j = succ_start[n]; j < succ_start[n + 1]; j++)
+	if(--in_degree[succs[j]] == 0)
+	  order.push_back(succs[j]);
+    }
+    if(order.size() < total_ops) {
+      log_subgraph.error() << "subgraph sort did not converge - has a cycle?";
+      return false;
     }
-    for(unsigned i = 0; i < num_ext_postcond; i++)
-      toposort[std::make_pair(SubgraphDefinition::OPKIND_EXT_POSTCOND, i)] = total_ops++;
 
-    schedule.resize(total_ops);
-    for(TopoMap::const_iterator it = toposort.begin();
-	it != toposort.end();
-	++it) {
-      schedule[it->second].op_kind = it->first.first;
-      schedule[it->second].op_index = it->first.second;
+    // external postconditions go at the end of the schedule, in order
+    std::vector<unsigned> sched_pos(total_ops);
+    schedule.resize(total_ops + num_ext_postcond);
+    for(unsigned i = 0; i < total_ops; i++) {
+      unsigned n = order[i];
+      sched_pos[n] = i;
+      // find the kind whose range contains this node
+      unsigned kind = SubgraphDefinition::OPKIND_TASK;
+      while(n >= op_base[kind + 1]) kind++;
+      schedule[i].op_kind = SubgraphDefinition::OpKind(kind);
+      schedule[i].op_index = n - op_base[kind];
+    }
+    for(unsigned i = 0; i < num_ext_postcond; i++) {
+      schedule[total_ops + i].op_kind = SubgraphDefinition::OPKIND_EXT_POSTCOND;
+      schedule[total_ops + i].op_index = i;
     }
 
     // count number of intermediate events - instantiations can produce more
@@ -473,36 +487,27 @@ namespace Realm {
       num_intermediate_events += it->intermediate_event_count;
     }
 
-    for(std::vector<SubgraphDefinition::Dependency>::const_iterator it = defn->dependencies.begin();
-	it != defn->dependencies.end();
-	++it) {
-      TopoMap::const_iterator tgt = toposort.find(std::make_pair(it->tgt_op_kind, it->tgt_op_index));
-      assert(tgt != toposort.end());
-
-      switch(it->src_op_kind) {
-      case SubgraphDefinition::OPKIND_EXT_PRECOND:
-	{
-	  // external preconditions are encoded as negative indices
-	  int idx = -1 - (int)(it->src_op_index);
-	  schedule[tgt->second].preconditions.push_back(std::make_pair(it->tgt_op_port, idx));
-	  break;
-	}
+    for(size_t i = 0; i < defn->dependencies.size(); i++) {
+      const SubgraphDefinition::Dependency& dep = defn->dependencies[i];
+      unsigned tgt = ((dep_tgt[i] != unsigned(-1)) ?
+		        sched_pos[dep_tgt[i]] :
+		        (total_ops + dep.tgt_op_index));
 
-      default:
-	{
-	  TopoMap::const_iterator src = toposort.find(std::make_pair(it->src_op_kind, it->src_op_index));
-	  assert(src != toposort.end());
-	  unsigned ev_idx = schedule[src->second].intermediate_event_base + it->src_op_port;
-	  schedule[tgt->second].preconditions.push_back(std::make_pair(it->tgt_op_port, ev_idx));
-	  // if we are depending on port 0 of another node and we're not an
-	  //  external postcondition, then the preceeding node is not final
-	  if((it->src_op_port == 0) &&
-	     (it->tgt_op_kind != SubgraphDefinition::OPKIND_EXT_POSTCOND) &&
-	     (schedule[src->second].is_final_event)) {
-	    schedule[src->second].is_final_event = false;
-	    num_final_events--;
-	  }
-	  break;
+      if(dep.src_op_kind == SubgraphDefinition::OPKIND_EXT_PRECOND) {
+	// external preconditions are encoded as negative indices
+	int idx = -1 - (int)(dep.src_op_index);
+	schedule[tgt].preconditions.push_back(std::make_pair(dep.tgt_op_port, idx));
+      } else {
+	unsigned src = sched_pos[dep_src[i]];
+	unsigned ev_idx = schedule[src].intermediate_event_base + dep.src_op_port;
+	schedule[tgt].preconditions.push_back(std::make_pair(dep.tgt_op_port, ev_idx));
+	// if we are depending on port 0 of another node and we're not an
+	//  external postcondition, then the preceeding node is not final
+	if((dep.src_op_port == 0) &&
+	   (dep.tgt_op_kind != SubgraphDefinition::OPKIND_EXT_POSTCOND) &&
+	   (schedule[src].is_final_event)) {
+	  schedule[src].is_final_event = false;
+	  num_final_events--;
 	}
       }
     }
@@ -530,6 +535,103 @@ namespace Realm {
 	max_preconditions = num_unique + 1;
     }
     
+    // decide which operations can be launched from local dependency counters
+    //  instead of merged events - an operation qualifies if it depends only
+    //  on port 0 of other operations, runs on this node, and every operation
+    //  that depends on it also qualifies (so nobody ever needs its event
+    //  before it has been launched) - walking the schedule backwards means
+    //  all of an operation's consumers have been classified before it is
+    std::vector<unsigned> event_owner(num_intermediate_events);
+    for(unsigned i = 0; i < schedule.size(); i++)
+      for(unsigned j = 0; j < schedule[i].intermediate_event_count; j++)
+	event_owner[schedule[i].intermediate_event_base + j] = i;
+
+    std::vector<bool> consumers_deferred(schedule.size(), true);
+    num_deferred_ops = 0;
+    num_deferred_final = 0;
+    num_local_notifiers = 0;
+    num_task_notifiers = 0;
+    for(unsigned i = schedule.size(); i > 0; i--) {
+      SubgraphScheduleEntry& se = schedule[i - 1];
+      se.is_deferred = false;
+      se.num_local_preconds = 0;
+      se.local_notifier_index = 0;
+      se.notify_completion = false;
+      se.task_notifier_index = 0;
+
+      bool ok = consumers_deferred[i - 1] && !se.preconditions.empty();
+      switch(se.op_kind) {
+      case SubgraphDefinition::OPKIND_TASK:
+	{
+	  Processor proc = defn->tasks[se.op_index].proc;
+	  if(!ID(proc).is_processor() ||
+	     (NodeID(ID(proc).proc_owner_node()) != Network::my_node_id))
+	    ok = false;
+	  break;
+	}
+      case SubgraphDefinition::OPKIND_COPY:
+      case SubgraphDefinition::OPKIND_ARRIVAL:
+      case SubgraphDefinition::OPKIND_ACQUIRE:
+      case SubgraphDefinition::OPKIND_RELEASE:
+	break;
+      default:
+	ok = false;
+      }
+      for(size_t j = 0; ok && (j < se.preconditions.size()); j++) {
+	int ev_idx = se.preconditions[j].second;
+	if((se.preconditions[j].first != 0) || (ev_idx < 0) ||
+	   (schedule[event_owner[ev_idx]].intermediate_event_base != unsigned(ev_idx)))
+	  ok = false;
+      }
+
+      if(ok) {
+	se.is_deferred = true;
+	se.num_local_preconds = se.preconditions.size();
+	num_deferred_ops++;
+	if(se.is_final_event) {
+	  num_deferred_final++;
+	  num_final_events--;
+	}
+	for(size_t j = 0; j < se.preconditions.size(); j++)
+	  schedule[event_owner[se.preconditions[j].second]].local_successors.push_back(i - 1);
+      } else {
+	// our sources' events are needed directly
+	for(size_t j = 0; j < se.preconditions.size(); j++)
+	  if(se.preconditions[j].second >= 0)
+	    consumers_deferred[event_owner[se.preconditions[j].second]] = false;
+      }
+    }
+    for(std::vector<SubgraphScheduleEntry>::iterator it = schedule.begin();
+	it != schedule.end();
+	++it) {
+      if(it->is_deferred &&
+	 (it->op_kind == SubgraphDefinition::OPKIND_TASK)) {
+	// nobody outside the instantiation needs a deferred task's event,
+	//  so the task doesn't get one
+	it->notify_completion = true;
+	it->task_notifier_index = num_task_notifiers++;
+      } else if(!it->local_successors.empty())
+	it->local_notifier_index = num_local_notifiers++;
+    }
+    // all deferred operations contribute to the finish event through a
+    //  single merged event
+    if(num_deferred_ops > 0)
+      num_final_events++;
+
+    // if the finish event is just the completion of a single task, the task
+    //  can trigger it directly instead of having its own event merged into it
+    direct_finish_task = -1;
+    if(num_final_events == 1)
+      for(size_t i = 0; i < schedule.size(); i++)
+	if(schedule[i].is_final_event && !schedule[i].is_deferred &&
+	   (schedule[i].op_kind == SubgraphDefinition::OPKIND_TASK)) {
+	  direct_finish_task = i;
+	  break;
+	}
+
+    log_subgraph.debug() << "compiled: subgraph=" << me << " ops=" << schedule.size()
+			 << " deferred=" << num_deferred_ops;
+
     // sort the interpolations so that each operation has a compact range
     //  to iterate through
     std::sort(defn->interpolations.begin(), defn->interpolations.end(),
@@ -599,6 +701,135 @@ namespace Realm {
     return true;
   }
 
+  Event SubgraphImpl::launch_operation(const SubgraphScheduleEntry& sched,
+				       const void *args, size_t arglen,
+				       Event pre, int priority_adjust,
+				       Event finish_event /*= Event::NO_EVENT*/,
+				       Operation::CompletionNotifier *notifier /*= 0*/)
+  {
+    // scratch buffer used for interpolations
+    const size_t SCRATCH_SIZE = 1024;
+    char interp_scratch[SCRATCH_SIZE];
+
+    Event e = Event::NO_EVENT;
+
+    switch(sched.op_kind) {
+    case SubgraphDefinition::OPKIND_TASK:
+      {
+	const SubgraphDefinition::TaskDesc& td = defn->tasks[sched.op_index];
+	Processor proc = td.proc;
+	Processor::TaskFuncID task_id = td.task_id;
+	int priority = td.priority;
+
+	size_t scratch_needed = 0;
+	if(has_interpolation(defn->interpolations,
+			     sched.first_interp, sched.num_interps,
+			     SubgraphDefinition::Interpolation::TARGET_TASK_ARGS,
+			     sched.op_index))
+	  scratch_needed += td.args.size();
+
+	InterpolationScratchHelper ish(interp_scratch, scratch_needed);
+
+	const void *task_args = do_interpolation(defn->interpolations,
+						 sched.first_interp, sched.num_interps,
+						 SubgraphDefinition::Interpolation::TARGET_TASK_ARGS,
+						 sched.op_index,
+						 args, arglen,
+						 td.args.base(), td.args.size(),
+						 ish);
+
+	if(notifier) {
+	  // the task reports its completion to the notifier - no event
+	  ProcessorImpl *p = get_runtime()->get_processor_impl(proc);
+	  p->spawn_task_with_notifier(task_id, task_args, td.args.size(),
+				      td.prs,
+				      pre,
+				      notifier,
+				      priority + priority_adjust);
+	} else if(finish_event.exists()) {
+	  // the task completes the whole instantiation - no event of its own
+	  ProcessorImpl *p = get_runtime()->get_processor_impl(proc);
+	  p->spawn_task(task_id, task_args, td.args.size(),
+			td.prs,
+			pre,
+			get_genevent_impl(finish_event),
+			ID(finish_event).event_generation(),
+			priority + priority_adjust);
+	  e = finish_event;
+	} else
+	  e = proc.spawn(task_id, task_args, td.args.size(),
+			 td.prs,
+			 pre,
+			 priority + priority_adjust);
+	break;
+      }
+
+    case SubgraphDefinition::OPKIND_COPY:
+      {
+	const SubgraphDefinition::CopyDesc& cd = defn->copies[sched.op_index];
+	e = cd.space.copy(cd.srcs,
+			  cd.dsts,
+			  cd.prs,
+			  pre);
+	break;
+      }
+
+    case SubgraphDefinition::OPKIND_ARRIVAL:
+      {
+	const SubgraphDefinition::ArrivalDesc& ad = defn->arrivals[sched.op_index];
+
+	InterpolationScratchHelper ish(interp_scratch,
+				       ad.reduce_value.size());
+
+	Barrier b = do_interpolation(defn->interpolations,
+				     sched.first_interp, sched.num_interps,
+				     SubgraphDefinition::Interpolation::TARGET_ARRIVAL_BARRIER,
+				     sched.op_index,
+				     args, arglen,
+				     ad.barrier);
+	const void *red_val = do_interpolation(defn->interpolations,
+					       sched.first_interp, sched.num_interps,
+					       SubgraphDefinition::Interpolation::TARGET_ARRIVAL_VALUE,
+					       sched.op_index,
+					       args, arglen,
+					       ad.reduce_value.base(),
+					       ad.reduce_value.size(),
+					       ish);
+	unsigned count = ad.count;
+	b.arrive(count, pre, red_val, ad.reduce_value.size());
+
+	// "finish event" is precondition
+	e = pre;
+	break;
+      }
+
+    case SubgraphDefinition::OPKIND_ACQUIRE:
+      {
+	const SubgraphDefinition::AcquireDesc& ad = defn->acquires[sched.op_index];
+	Reservation rsrv = ad.rsrv;
+	unsigned mode = ad.mode;
+	bool excl = ad.exclusive;
+	e = rsrv.acquire(mode, excl, pre);
+	break;
+      }
+
+    case SubgraphDefinition::OPKIND_RELEASE:
+      {
+	const SubgraphDefinition::ReleaseDesc& rd = defn->releases[sched.op_index];
+	Reservation rsrv = rd.rsrv;
+	rsrv.release(pre);
+	// "finish event" is precondition
+	e = pre;
+	break;
+      }
+
+    default:
+      assert(0);
+    }
+
+    return e;
+  }
+
   void SubgraphImpl::instantiate(const void *args, size_t arglen,
 				 const ProfilingRequestSet& prs,
 				 span<const Event> preconditions,
@@ -607,26 +838,50 @@ namespace Realm {
 				 int priority_adjust)
   {
     // we precomputed the number of intermediate events we need, so put them
-    //  on the stack
-    Event *intermediate_events = static_cast<Event *>(alloca(num_intermediate_events *
-							     sizeof(Event)));
+    //  on the stack unless the subgraph is large enough to risk overflowing
+    //  the task's stack
+    const size_t MAX_STACK_INTERMEDIATE_EVENTS = 4096;
+    std::vector<Event> heap_intermediate_events;
+    Event *intermediate_events;
+    if(num_intermediate_events <= MAX_STACK_INTERMEDIATE_EVENTS) {
+      intermediate_events = static_cast<Event *>(alloca(num_intermediate_events *
+							sizeof(Event)));
+    } else {
+      heap_intermediate_events.resize(num_intermediate_events);
+      intermediate_events = heap_intermediate_events.data();
+    }
     size_t cur_intermediate_events = 0;
 
     // we've also computed how many events will contribute to the finish
     //  event, so we can arm the merger as we go
     GenEventImpl *event_impl = 0;
-    if(num_final_events > 0) {
+    if((num_final_events > 0) && (direct_finish_task < 0)) {
       event_impl = get_genevent_impl(finish_event);
       event_impl->merger.prepare_merger(finish_event, false /*!ignore_faults*/,
 					num_final_events);
     }
 
+    // deferred operations are launched (possibly after we return) by a
+    //  separate piece of state that contributes a single event to the merger
+    SubgraphInstantiation *inst = 0;
+    if(num_deferred_ops > 0) {
+      inst = new SubgraphInstantiation(this, args, arglen, priority_adjust);
+      event_impl->merger.add_precondition(inst->prepare_deferred_event());
+    }
+
     Event *preconds = static_cast<Event *>(alloca(max_preconditions *
 						  sizeof(Event)));
     
     for(std::vector<SubgraphScheduleEntry>::const_iterator it = schedule.begin();
 	it != schedule.end();
 	++it) {
+      // deferred operations are launched once their predecessors are done
+      if(it->is_deferred) {
+	for(unsigned i = 0; i < it->intermediate_event_count; i++)
+	  intermediate_events[cur_intermediate_events++] = Event::NO_EVENT;
+	continue;
+      }
+
       // assemble precondition
       size_t num_preconds = 0;
       bool need_global_precond = start_event.exists();
@@ -684,103 +939,26 @@ namespace Realm {
 								    num_preconds),
 					     false /*!ignore_faults*/);
 #endif
-      // scratch buffer used for interpolations
-      const size_t SCRATCH_SIZE = 1024;
-      char interp_scratch[SCRATCH_SIZE];
-
       Event e = Event::NO_EVENT;
 
       switch(it->op_kind) {
       case SubgraphDefinition::OPKIND_TASK:
-	{
-	  const SubgraphDefinition::TaskDesc& td = defn->tasks[it->op_index];
-	  Processor proc = td.proc;
-	  Processor::TaskFuncID task_id = td.task_id;
-	  int priority = td.priority;
-
-	  size_t scratch_needed = 0;
-	  if(has_interpolation(defn->interpolations,
-			       it->first_interp, it->num_interps,
-			       SubgraphDefinition::Interpolation::TARGET_TASK_ARGS,
-			       it->op_index))
-	    scratch_needed += td.args.size();
-						   
-	  InterpolationScratchHelper ish(interp_scratch, scratch_needed);
-
-	  const void *task_args = do_interpolation(defn->interpolations,
-						   it->first_interp, it->num_interps,
-						   SubgraphDefinition::Interpolation::TARGET_TASK_ARGS,
-						   it->op_index,
-						   args, arglen,
-						   td.args.base(), td.args.size(),
-						   ish);
-
-	  e = proc.spawn(task_id, task_args, td.args.size(),
-			 td.prs,
-			 pre,
-			 priority + priority_adjust);
-	  intermediate_events[cur_intermediate_events++] = e;
-	  break;
-	}
-
       case SubgraphDefinition::OPKIND_COPY:
-	{
-	  const SubgraphDefinition::CopyDesc& cd = defn->copies[it->op_index];
-	  e = cd.space.copy(cd.srcs,
-			    cd.dsts,
-			    cd.prs,
-			    pre);
-	  intermediate_events[cur_intermediate_events++] = e;
-	  break;
-	}
-
       case SubgraphDefinition::OPKIND_ARRIVAL:
-	{
-	  const SubgraphDefinition::ArrivalDesc& ad = defn->arrivals[it->op_index];
-
-	  InterpolationScratchHelper ish(interp_scratch,
-					 ad.reduce_value.size());
-
-	  Barrier b = do_interpolation(defn->interpolations,
-				       it->first_interp, it->num_interps,
-				       SubgraphDefinition::Interpolation::TARGET_ARRIVAL_BARRIER,
-				       it->op_index,
-				       args, arglen,
-				       ad.barrier);
-	  const void *red_val = do_interpolation(defn->interpolations,
-						 it->first_interp, it->num_interps,
-						 SubgraphDefinition::Interpolation::TARGET_ARRIVAL_VALUE,
-						 it->op_index,
-						 args, arglen,
-						 ad.reduce_value.base(),
-						 ad.reduce_value.size(),
-						 ish);
-	  unsigned count = ad.count;
-	  b.arrive(count, pre, red_val, ad.reduce_value.size());
-
-	  // "finish event" is precondition
-	  intermediate_events[cur_intermediate_events++] = e = pre;
-	  break;
-	}
-
       case SubgraphDefinition::OPKIND_ACQUIRE:
-	{
-	  const SubgraphDefinition::AcquireDesc& ad = defn->acquires[it->op_index];
-	  Reservation rsrv = ad.rsrv;
-	  unsigned mode = ad.mode;
-	  bool excl = ad.exclusive;
-	  e = rsrv.acquire(mode, excl, pre);
-	  intermediate_events[cur_intermediate_events++] = e;
-	  break;
-	}
-
       case SubgraphDefinition::OPKIND_RELEASE:
 	{
-	  const SubgraphDefinition::ReleaseDesc& rd = defn->releases[it->op_index];
-	  Reservation rsrv = rd.rsrv;
-	  rsrv.release(pre);
-	  // "finish event" is precondition
-	  intermediate_events[cur_intermediate_events++] = e = pre;
+	  if((it - schedule.begin()) == direct_finish_task) {
+	    e = launch_operation(*it, args, arglen, pre, priority_adjust,
+				 finish_event);
+	    intermediate_events[cur_intermediate_events++] = e;
+	    // the task triggers the finish event itself
+	    if(!it->local_successors.empty())
+	      inst->notify_successors(it - schedule.begin(), e);
+	    continue;
+	  }
+	  e = launch_operation(*it, args, arglen, pre, priority_adjust);
+	  intermediate_events[cur_intermediate_events++] = e;
 	  break;
 	}
 
@@ -797,6 +975,9 @@ namespace Realm {
 			       it->op_index))
 	    scratch_needed += id.args.size();
 
+	  // scratch buffer used for interpolations
+	  const size_t SCRATCH_SIZE = 1024;
+	  char interp_scratch[SCRATCH_SIZE];
 	  InterpolationScratchHelper ish(interp_scratch, scratch_needed);
 
 	  const void *inst_args = do_interpolation(defn->interpolations,
@@ -869,12 +1050,21 @@ namespace Realm {
       // contribute to the final event if we need to
       if(it->is_final_event)
 	event_impl->merger.add_precondition(e);
+
+      // and release any deferred operations waiting on us
+      if(!it->local_successors.empty())
+	inst->notify_successors(it - schedule.begin(), e);
     }
 
     // sanity-check that we counted right
     assert(cur_intermediate_events == num_intermediate_events);
 
-    if(num_final_events > 0) {
+    if(inst)
+      inst->remove_reference();
+
+    if(direct_finish_task >= 0) {
+      // the finish event belongs to the task we spawned
+    } else if(num_final_events > 0) {
       event_impl->merger.arm_merger();
     } else {
       GenEventImpl::trigger(finish_event, false /*!poisoned*/);
@@ -897,6 +1087,207 @@ namespace Realm {
   }
 
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // class SubgraphInstantiation
+  //
+
+  SubgraphInstantiation::SubgraphInstantiation(SubgraphImpl *_subgraph,
+					       const void *_args, size_t _arglen,
+					       int _priority_adjust)
+    : subgraph(_subgraph)
+    , arglen(_arglen)
+    , priority_adjust(_priority_adjust)
+    , refcount(1 + _subgraph->num_local_notifiers +
+	       _subgraph->num_task_notifiers)
+    , counters(_subgraph->schedule.size())
+    , notifiers(_subgraph->num_local_notifiers)
+    , task_notifiers(_subgraph->num_task_notifiers)
+    , deferred_impl(0)
+  {
+    // the arguments may live in a message buffer that goes away once
+    //  SubgraphImpl::instantiate returns
+    args = static_cast<char *>(malloc(arglen ? arglen : 1));
+    assert(args != 0);
+    if(arglen > 0)
+      memcpy(args, _args, arglen);
+
+    for(size_t i = 0; i < counters.size(); i++)
+      counters[i].store(subgraph->schedule[i].num_local_preconds);
+  }
+
+  SubgraphInstantiation::~SubgraphInstantiation()
+  {
+    free(args);
+  }
+
+  Event SubgraphInstantiation::prepare_deferred_event(void)
+  {
+    deferred_impl = GenEventImpl::create_genevent();
+    Event e = deferred_impl->current_event();
+    deferred_impl->merger.prepare_merger(e, false /*!ignore_faults*/,
+					 subgraph->num_deferred_final);
+    return e;
+  }
+
+  void SubgraphInstantiation::notify_successors(unsigned sched_idx, Event e)
+  {
+    std::vector<unsigned> ready;
+    if(check_event(sched_idx, e, ready))
+      launch_ready(ready, 1);
+  }
+
+  void SubgraphInstantiation::remove_reference(unsigned count /*= 1*/)
+  {
+    unsigned prev = refcount.fetch_sub_acqrel(count);
+    assert(prev >= count);
+    if(prev == count) {
+      // arming the merger must be the last thing we do - once the deferred
+      //  event triggers, the subgraph itself may be destroyed
+      GenEventImpl *impl = deferred_impl;
+      delete this;
+      impl->merger.arm_merger();
+    }
+  }
+
+  bool SubgraphInstantiation::check_event(unsigned sched_idx, Event e,
+					  std::vector<unsigned>& ready)
+  {
+    bool poisoned = false;
+    if(e.has_triggered_faultaware(poisoned)) {
+      release_successors(sched_idx, (poisoned ? e : Event::NO_EVENT), ready);
+      return true;
+    }
+
+    SuccessorNotifier& n = notifiers[subgraph->schedule[sched_idx].local_notifier_index];
+    n.inst = this;
+    n.sched_idx = sched_idx;
+    n.event = e;
+    EventImpl::add_waiter(e, &n);
+    return false;
+  }
+
+  void SubgraphInstantiation::release_successors(unsigned sched_idx,
+						 Event poisoned_event,
+						 std::vector<unsigned>& ready)
+  {
+    const std::vector<unsigned>& succs = subgraph->schedule[sched_idx].local_successors;
+    for(std::vector<unsigned>::const_iterator it = succs.begin();
+	it != succs.end();
+	++it) {
+      if(poisoned_event.exists()) {
+	AutoLock<> al(mutex);
+	poisoned_preconds[*it] = poisoned_event;
+      }
+      if(counters[*it].fetch_sub_acqrel(1) == 1)
+	ready.push_back(*it);
+    }
+  }
+
+  void SubgraphInstantiation::launch_ready(std::vector<unsigned>& ready,
+					   unsigned refs_done)
+  {
+    // use a work list rather than recursion - a long chain of operations
+    //  (e.g. arrivals) can all be ready immediately
+    while(!ready.empty()) {
+      unsigned idx = ready.back();
+      ready.pop_back();
+      const SubgraphScheduleEntry& sched = subgraph->schedule[idx];
+      assert(sched.is_deferred);
+
+      Event pre = Event::NO_EVENT;
+      {
+	AutoLock<> al(mutex);
+	std::map<unsigned, Event>::iterator it = poisoned_preconds.find(idx);
+	if(it != poisoned_preconds.end()) {
+	  pre = it->second;
+	  poisoned_preconds.erase(it);
+	}
+      }
+
+      if(sched.notify_completion) {
+	// each deferred task holds a reference until it completes
+	TaskNotifier& n = task_notifiers[sched.task_notifier_index];
+	n.inst = this;
+	n.sched_idx = idx;
+	n.final_precond = 0;
+	if(sched.is_final_event) {
+	  AutoLock<> al(mutex);
+	  n.final_precond = deferred_impl->merger.get_next_precondition();
+	}
+	subgraph->launch_operation(sched, args, arglen,
+				   pre, priority_adjust,
+				   Event::NO_EVENT, &n);
+	continue;
+      }
+
+      Event e = subgraph->launch_operation(sched, args, arglen,
+					   pre, priority_adjust);
+
+      if(sched.is_final_event) {
+	AutoLock<> al(mutex);
+	deferred_impl->merger.add_precondition(e);
+      }
+
+      if(!sched.local_successors.empty() && check_event(idx, e, ready))
+	refs_done++;
+    }
+
+    if(refs_done > 0)
+      remove_reference(refs_done);
+  }
+
+  void SubgraphInstantiation::task_completed(unsigned sched_idx,
+					     EventMerger::MergeEventPrecondition *final_precond,
+					     bool poisoned)
+  {
+    if(final_precond)
+      final_precond->event_triggered(poisoned, TimeLimit::responsive());
+
+    if(subgraph->schedule[sched_idx].local_successors.empty()) {
+      remove_reference();
+      return;
+    }
+
+    // successors use a poisoned predecessor's event as their precondition,
+    //  so a failed task needs an event after all
+    Event poisoned_event = Event::NO_EVENT;
+    if(poisoned) {
+      poisoned_event = GenEventImpl::create_genevent()->current_event();
+      GenEventImpl::trigger(poisoned_event, true /*poisoned*/);
+    }
+
+    std::vector<unsigned> ready;
+    release_successors(sched_idx, poisoned_event, ready);
+    launch_ready(ready, 1);
+  }
+
+  void SubgraphInstantiation::TaskNotifier::operation_completed(bool poisoned)
+  {
+    inst->task_completed(sched_idx, final_precond, poisoned);
+  }
+
+  void SubgraphInstantiation::SuccessorNotifier::event_triggered(bool poisoned,
+								 TimeLimit work_until)
+  {
+    std::vector<unsigned> ready;
+    inst->release_successors(sched_idx, (poisoned ? event : Event::NO_EVENT),
+			     ready);
+    inst->launch_ready(ready, 1);
+  }
+
+  void SubgraphInstantiation::SuccessorNotifier::print(std::ostream& os) const
+  {
+    os << "subgraph deferred launch: subgraph=" << inst->subgraph->me
+       << " op=" << sched_idx << " after=" << event;
+  }
+
+  Event SubgraphInstantiation::SuccessorNotifier::get_finish_event(void) const
+  {
+    return Event::NO_EVENT;
+  }
+
+
   ////////////////////////////////////////////////////////////////////////
   //
   // class SubgraphImpl::DeferredDestroy
@@ -21,6 +21,9 @@
 #include "realm/subgraph.h"
 #include "realm/id.h"
 #include "realm/event_impl.h"
+#include "realm/operation.h"
+#include "realm/mutex.h"
+#include "realm/atomics.h"
 
 namespace Realm {
 
@@ -31,6 +34,92 @@ namespace Realm {
     unsigned first_interp, num_interps;
     unsigned intermediate_event_base, intermediate_event_count;
     bool is_final_event;
+    // operations that depend only on other operations launched from this
+    //  node are deferred - they are launched once a local counter of their
+    //  outstanding predecessors reaches zero rather than waiting on a merged
+    //  event
+    bool is_deferred;
+    unsigned num_local_preconds;
+    // deferred operations that wait on this one, and the index of the
+    //  notifier used to wait on our event (if we have any)
+    std::vector<unsigned> local_successors;
+    unsigned local_notifier_index;
+    // deferred tasks don't get a finish event at all - they report their
+    //  completion directly to the instantiation through a task notifier
+    bool notify_completion;
+    unsigned task_notifier_index;
+  };
+
+  class SubgraphImpl;
+
+  // per-instantiation state for deferred operations - freed once every
+  //  deferred operation has been launched and every deferred task has
+  //  completed
+  class SubgraphInstantiation {
+  public:
+    SubgraphInstantiation(SubgraphImpl *_subgraph,
+			  const void *_args, size_t _arglen,
+			  int _priority_adjust);
+    ~SubgraphInstantiation();
+
+    // starts the merger for the deferred operations' contribution to the
+    //  instantiation's finish event
+    Event prepare_deferred_event(void);
+
+    // called once the event of an operation with deferred successors is known
+    void notify_successors(unsigned sched_idx, Event e);
+
+    void remove_reference(unsigned count = 1);
+
+    class SuccessorNotifier : public EventWaiter {
+    public:
+      virtual void event_triggered(bool poisoned, TimeLimit work_until);
+      virtual void print(std::ostream& os) const;
+      virtual Event get_finish_event(void) const;
+
+      SubgraphInstantiation *inst;
+      unsigned sched_idx;
+      Event event;
+    };
+
+    class TaskNotifier : public Operation::CompletionNotifier {
+    public:
+      virtual void operation_completed(bool poisoned);
+
+      SubgraphInstantiation *inst;
+      unsigned sched_idx;
+      // our slot in the deferred merger if the task is a final operation
+      EventMerger::MergeEventPrecondition *final_precond;
+    };
+
+  protected:
+    // returns true if the event had already triggered, in which case the
+    //  successors have been released (and possibly added to 'ready')
+    bool check_event(unsigned sched_idx, Event e,
+		     std::vector<unsigned>& ready);
+    void release_successors(unsigned sched_idx, Event poisoned_event,
+			    std::vector<unsigned>& ready);
+    // launches everything in 'ready' (and anything that becomes ready as
+    //  a result), and then drops 'refs_done' references
+    void launch_ready(std::vector<unsigned>& ready, unsigned refs_done);
+    // called when a deferred task (which has no event) completes
+    void task_completed(unsigned sched_idx,
+			EventMerger::MergeEventPrecondition *final_precond,
+			bool poisoned);
+
+    SubgraphImpl *subgraph;
+    char *args;
+    size_t arglen;
+    int priority_adjust;
+    atomic<unsigned> refcount;
+    std::vector<atomic<unsigned> > counters;
+    std::vector<SuccessorNotifier> notifiers;
+    std::vector<TaskNotifier> task_notifiers;
+    Mutex mutex;
+    // poisoned predecessor events are used as the launch precondition so
+    //  that poison propagates exactly as it would with merged events
+    std::map<unsigned, Event> poisoned_preconds;
+    GenEventImpl *deferred_impl;
   };
 
   class SubgraphImpl {
@@ -53,6 +142,16 @@ namespace Realm {
 
     void destroy(void);
 
+    // launches a single (non-instantiation) operation and returns its
+    //  completion event - a task may be given the event to trigger instead
+    //  of creating its own, or a notifier to report to instead of having
+    //  any event at all
+    Event launch_operation(const SubgraphScheduleEntry& sched,
+			   const void *args, size_t arglen,
+			   Event pre, int priority_adjust,
+			   Event finish_event = Event::NO_EVENT,
+			   Operation::CompletionNotifier *notifier = 0);
+
     class DeferredDestroy : public EventWaiter {
     public:
       void defer(SubgraphImpl *_subgraph, Event wait_on);
@@ -70,6 +169,11 @@ namespace Realm {
     SubgraphDefinition *defn;
     std::vector<SubgraphScheduleEntry> schedule;
     size_t num_intermediate_events, num_final_events, max_preconditions;
+    size_t num_deferred_ops, num_deferred_final, num_local_notifiers;
+    size_t num_task_notifiers;
+    // schedule index of a task whose completion is the instantiation's
+    //  finish event (or -1 if there isn't exactly one such task)
+    int direct_finish_task;
 
     DeferredDestroy deferred_destroy;
   };
@@ -505,6 +505,53 @@ namespace Realm {
     return task;
   }
 
+  /*static*/ Task *TaskQueue::steal_best_task(const std::vector<TaskQueue *>& queues,
+					      int& task_priority,
+					      const std::set<Processor::TaskFuncID>& pinned_tasks,
+					      const std::set<Processor::TaskFuncID>& runnable_tasks)
+  {
+    Task *task = 0;
+    TaskQueue *task_source = 0;
+
+    for(std::vector<TaskQueue *>::const_iterator it = queues.begin();
+	it != queues.end();
+	it++) {
+      Task *new_task;
+      {
+	AutoLock<> al((*it)->mutex);
+	new_task = (*it)->ready_task_list.pop_front(task_priority+1);
+	// a pinned task (or one we have no registration for) at the head
+	//  means the owner gets the whole queue - we don't dig past it
+	//  because that would reorder the owner's work
+	if(new_task && ((pinned_tasks.count(new_task->func_id) > 0) ||
+			(runnable_tasks.count(new_task->func_id) == 0))) {
+	  (*it)->ready_task_list.push_front(new_task);
+	  new_task = 0;
+	}
+      }
+      if(new_task) {
+	if((*it)->task_count_gauge)
+	  *((*it)->task_count_gauge) -= 1;
+
+	// if we got something better, put back the old thing (if any)
+	if(task) {
+	  {
+	    AutoLock<> al(task_source->mutex);
+	    task_source->ready_task_list.push_front(task);
+	  }
+	  if(task_source->task_count_gauge)
+	    (*task_source->task_count_gauge) += 1;
+	}
+
+	task = new_task;
+	task_source = *it;
+	task_priority = task->priority;
+      }
+    }
+
+    return task;
+  }
+
   void TaskQueue::enqueue_task(Task *task)
   {
     priority_t notify_priority = PRI_NEG_INF;
@@ -782,6 +829,30 @@ namespace Realm {
     queue->remove_subscription(&wcu_task_queues);
   }
 
+  void ThreadedTaskScheduler::add_steal_queue(TaskQueue *queue)
+  {
+    AutoLock<> al(lock);
+
+    steal_queues.push_back(queue);
+
+    // idle workers need to wake up when work shows up in the other queue too
+    queue->add_subscription(&wcu_task_queues);
+  }
+
+  void ThreadedTaskScheduler::set_pinned_tasks(const std::set<Processor::TaskFuncID>& func_ids)
+  {
+    AutoLock<> al(lock);
+
+    pinned_tasks = func_ids;
+  }
+
+  void ThreadedTaskScheduler::add_runnable_task(Processor::TaskFuncID func_id)
+  {
+    AutoLock<> al(lock);
+
+    runnable_tasks.insert(func_id);
+  }
+
   void ThreadedTaskScheduler::configure_bgworker(BackgroundWorkManager *manager,
 						 long long max_timeslice,
 						 int numa_domain)
@@ -1101,6 +1172,12 @@ namespace Realm {
 	int task_priority = resumable_priority;
 	Task *task = TaskQueue::get_best_task(task_queues, task_priority);
 
+	// with nothing of our own to do, see if another processor has a ready
+	//  task (of higher priority than anything resumable) we can take
+	if(!task && !steal_queues.empty())
+	  task = TaskQueue::steal_best_task(steal_queues, task_priority,
+					    pinned_tasks, runnable_tasks);
+
 	// did we find work to do?
 	if(task) {
 	  // we've now got some assigned work, so fire up a new idle worker if we were the last
@@ -158,6 +158,15 @@ namespace Realm {
       static Task *get_best_task(const std::vector<TaskQueue *>& queues,
 				 int& task_priority);
 
+      // like get_best_task, but for taking work from another processor's
+      //  queues - only the task at the head of each queue is considered, and
+      //  it is left in place if its task ID is in 'pinned_tasks' or is not
+      //  in 'runnable_tasks' (i.e. not registered on the thief)
+      static Task *steal_best_task(const std::vector<TaskQueue *>& queues,
+				   int& task_priority,
+				   const std::set<Processor::TaskFuncID>& pinned_tasks,
+				   const std::set<Processor::TaskFuncID>& runnable_tasks);
+
       void enqueue_task(Task *task);
       void enqueue_tasks(Task::TaskList& tasks, size_t num_tasks);
     };
@@ -193,6 +202,17 @@ namespace Realm {
 
       virtual void remove_task_queue(TaskQueue *queue);
 
+      // adds a queue (belonging to some other processor) from which ready
+      //  tasks may be stolen when this scheduler has nothing else to do
+      virtual void add_steal_queue(TaskQueue *queue);
+
+      // tasks with any of these IDs are never stolen from a steal queue
+      void set_pinned_tasks(const std::set<Processor::TaskFuncID>& func_ids);
+
+      // records that the owning processor can run this task ID - only such
+      //  tasks are stolen from other processors' queues
+      void add_runnable_task(Processor::TaskFuncID func_id);
+
       virtual void configure_bgworker(BackgroundWorkManager *manager,
 				      long long max_timeslice,
 				      int numa_domain);
@@ -231,6 +251,9 @@ namespace Realm {
 
       Mutex lock;
       std::vector<TaskQueue *> task_queues;
+      std::vector<TaskQueue *> steal_queues;
+      std::set<Processor::TaskFuncID> pinned_tasks;
+      std::set<Processor::TaskFuncID> runnable_tasks;
       std::vector<Thread *> idle_workers;
       std::set<Thread *> blocked_workers;
       // threads that block while holding a scheduler lock go here instead
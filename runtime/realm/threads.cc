@@ -20,6 +20,7 @@
 #include "realm/logging.h"
 #include "realm/faults.h"
 #include "realm/operation.h"
+#include "realm/timers.h"
 
 #ifdef DEBUG_USWITCH
 #include <stdio.h>
@@ -133,6 +134,152 @@ inline void makecontext_wrap(ucontext_t *u, void (*fn)(), int args, ...) { makec
 } while(0)
 #endif
 
+// swapcontext saves and restores the signal mask on every switch, which costs
+//  a pair of system calls - on architectures where we know the calling
+//  convention, a switch only needs to save the callee-saved registers and the
+//  floating point control state on the old stack and swap stack pointers
+#if defined(REALM_USE_USER_THREADS) && (defined(REALM_ON_LINUX) || defined(REALM_ON_FREEBSD)) && \
+    (defined(__x86_64__) || defined(__aarch64__))
+#define REALM_USE_FAST_USER_SWITCH
+
+extern "C" {
+  // saves the current context on the current stack, stores the stack pointer
+  //  in '*save_sp' and resumes the context whose stack pointer is 'new_sp'
+  void realm_fast_uswitch(void **save_sp, void *new_sp)
+    __attribute__((visibility("hidden")));
+  // first code run by a new context - calls 'fn(arg)' as set up by
+  //  fast_uswitch_init_stack (must never return)
+  void realm_fast_uswitch_start(void)
+    __attribute__((visibility("hidden")));
+};
+
+#if defined(__x86_64__)
+// frame (from saved sp): x87 cw, mxcsr, r15, r14, r13, r12, rbx, rbp, return addr
+asm(".text\n"
+    ".p2align 4\n"
+    ".globl realm_fast_uswitch\n"
+    ".hidden realm_fast_uswitch\n"
+    ".type realm_fast_uswitch,@function\n"
+    "realm_fast_uswitch:\n"
+    "  pushq %rbp\n"
+    "  pushq %rbx\n"
+    "  pushq %r12\n"
+    "  pushq %r13\n"
+    "  pushq %r14\n"
+    "  pushq %r15\n"
+    "  subq $16, %rsp\n"
+    "  stmxcsr 8(%rsp)\n"
+    "  fnstcw (%rsp)\n"
+    "  movq %rsp, (%rdi)\n"
+    "  movq %rsi, %rsp\n"
+    "  ldmxcsr 8(%rsp)\n"
+    "  fldcw (%rsp)\n"
+    "  addq $16, %rsp\n"
+    "  popq %r15\n"
+    "  popq %r14\n"
+    "  popq %r13\n"
+    "  popq %r12\n"
+    "  popq %rbx\n"
+    "  popq %rbp\n"
+    "  ret\n"
+    ".size realm_fast_uswitch,.-realm_fast_uswitch\n"
+    ".p2align 4\n"
+    ".globl realm_fast_uswitch_start\n"
+    ".hidden realm_fast_uswitch_start\n"
+    ".type realm_fast_uswitch_start,@function\n"
+    "realm_fast_uswitch_start:\n"
+    "  movq %r13, %rdi\n"
+    "  callq *%r12\n"
+    "  ud2\n"
+    ".size realm_fast_uswitch_start,.-realm_fast_uswitch_start\n");
+
+static const size_t FAST_USWITCH_FRAME_SIZE = 72;
+#endif
+
+#if defined(__aarch64__)
+// frame (from saved sp): x19-x30, d8-d15, fpcr (176 bytes to keep sp aligned)
+asm(".text\n"
+    ".p2align 4\n"
+    ".globl realm_fast_uswitch\n"
+    ".hidden realm_fast_uswitch\n"
+    ".type realm_fast_uswitch,%function\n"
+    "realm_fast_uswitch:\n"
+    "  sub sp, sp, #176\n"
+    "  stp x19, x20, [sp, #0]\n"
+    "  stp x21, x22, [sp, #16]\n"
+    "  stp x23, x24, [sp, #32]\n"
+    "  stp x25, x26, [sp, #48]\n"
+    "  stp x27, x28, [sp, #64]\n"
+    "  stp x29, x30, [sp, #80]\n"
+    "  stp d8, d9, [sp, #96]\n"
+    "  stp d10, d11, [sp, #112]\n"
+    "  stp d12, d13, [sp, #128]\n"
+    "  stp d14, d15, [sp, #144]\n"
+    "  mrs x9, fpcr\n"
+    "  str x9, [sp, #160]\n"
+    "  mov x9, sp\n"
+    "  str x9, [x0]\n"
+    "  mov sp, x1\n"
+    "  ldp x19, x20, [sp, #0]\n"
+    "  ldp x21, x22, [sp, #16]\n"
+    "  ldp x23, x24, [sp, #32]\n"
+    "  ldp x25, x26, [sp, #48]\n"
+    "  ldp x27, x28, [sp, #64]\n"
+    "  ldp x29, x30, [sp, #80]\n"
+    "  ldp d8, d9, [sp, #96]\n"
+    "  ldp d10, d11, [sp, #112]\n"
+    "  ldp d12, d13, [sp, #128]\n"
+    "  ldp d14, d15, [sp, #144]\n"
+    "  ldr x9, [sp, #160]\n"
+    "  msr fpcr, x9\n"
+    "  add sp, sp, #176\n"
+    "  ret\n"
+    ".size realm_fast_uswitch,.-realm_fast_uswitch\n"
+    ".p2align 4\n"
+    ".globl realm_fast_uswitch_start\n"
+    ".hidden realm_fast_uswitch_start\n"
+    ".type realm_fast_uswitch_start,%function\n"
+    "realm_fast_uswitch_start:\n"
+    "  mov x0, x20\n"
+    "  blr x19\n"
+    "  brk #0\n"
+    ".size realm_fast_uswitch_start,.-realm_fast_uswitch_start\n");
+
+static const size_t FAST_USWITCH_FRAME_SIZE = 176;
+#endif
+
+// builds an initial frame at the top of the given stack so that the first
+//  realm_fast_uswitch into it calls 'fn(arg)', and returns the stack pointer
+//  to switch to
+static void *fast_uswitch_init_stack(void *stack_base, size_t stack_size,
+				     void (*fn)(void *), void *arg)
+{
+  uintptr_t top = (reinterpret_cast<uintptr_t>(stack_base) + stack_size) & ~uintptr_t(15);
+#if defined(__x86_64__)
+  // leave 16 bytes of scratch above the frame so the return into the
+  //  trampoline leaves %rsp 16B-aligned for the call
+  uintptr_t *frame = reinterpret_cast<uintptr_t *>(top - 16 - FAST_USWITCH_FRAME_SIZE);
+  frame[0] = 0x037f;  // default x87 control word
+  frame[1] = 0x1f80;  // default mxcsr
+  frame[2] = 0;  // r15
+  frame[3] = 0;  // r14
+  frame[4] = reinterpret_cast<uintptr_t>(arg);  // r13
+  frame[5] = reinterpret_cast<uintptr_t>(fn);  // r12
+  frame[6] = 0;  // rbx
+  frame[7] = 0;  // rbp - terminates frame-pointer backtraces
+  frame[8] = reinterpret_cast<uintptr_t>(&realm_fast_uswitch_start);
+#endif
+#if defined(__aarch64__)
+  uintptr_t *frame = reinterpret_cast<uintptr_t *>(top - FAST_USWITCH_FRAME_SIZE);
+  memset(frame, 0, FAST_USWITCH_FRAME_SIZE);
+  frame[0] = reinterpret_cast<uintptr_t>(fn);  // x19
+  frame[1] = reinterpret_cast<uintptr_t>(arg);  // x20
+  frame[11] = reinterpret_cast<uintptr_t>(&realm_fast_uswitch_start);  // x30
+#endif
+  return frame;
+}
+#endif
+
 namespace Realm {
 
   Logger log_thread("threads");
@@ -1152,12 +1299,46 @@ namespace Realm {
   //
   // class UserThread
 
+  namespace Config {
+    // if true, user-level thread switches use swapcontext even where the
+    //  faster register-only switch is available
+    bool force_ucontext_switch = false;
+  };
+
 #ifdef REALM_USE_USER_THREADS
 
 #if defined(REALM_ON_LINUX) || defined(REALM_ON_MACOS) || defined(REALM_ON_FREEBSD)
   namespace {
     atomic<int> uswitch_test_check_flag(1);
     ucontext_t uswitch_test_ctx1, uswitch_test_ctx2;
+#ifdef REALM_USE_FAST_USER_SWITCH
+    void *uswitch_test_sp1, *uswitch_test_sp2;
+
+    void fast_uswitch_test_entry(void *arg)
+    {
+      uswitch_test_check_flag.fetch_add(static_cast<int>(reinterpret_cast<intptr_t>(arg)));
+      // never resumed
+      realm_fast_uswitch(&uswitch_test_sp2, uswitch_test_sp1);
+      assert(0);
+    }
+
+    void fast_uswitch_bench_entry(void *arg)
+    {
+      int *counter = static_cast<int *>(arg);
+      while(true) {
+	(*counter)++;
+	realm_fast_uswitch(&uswitch_test_sp2, uswitch_test_sp1);
+      }
+    }
+#endif
+
+    void uswitch_bench_entry(int arg)
+    {
+      while(true) {
+	uswitch_test_check_flag.fetch_add(arg);
+	swapcontext(&uswitch_test_ctx2, &uswitch_test_ctx1);
+      }
+    }
 
     void uswitch_test_entry(int arg)
     {
@@ -1213,15 +1394,93 @@ namespace Realm {
     }
 
     log_thread.debug() << "uswitch test: check succeeded";
+
+#ifdef REALM_USE_FAST_USER_SWITCH
+    // the register-only switch is checked the same way - a failure there
+    //  just falls back to swapcontext
+    if(!Config::force_ucontext_switch) {
+      uswitch_test_check_flag.store(1);
+      uswitch_test_sp2 = fast_uswitch_init_stack(stack_base, stack_size,
+						 fast_uswitch_test_entry,
+						 reinterpret_cast<void *>(intptr_t(66)));
+      realm_fast_uswitch(&uswitch_test_sp1, uswitch_test_sp2);
+      val = uswitch_test_check_flag.load();
+      if(val != 67) {
+	log_thread.info() << "uswitch test: fast switch val mismatch: " << val << " != 67 - using swapcontext";
+	Config::force_ucontext_switch = true;
+      }
+    }
+#endif
+
     free(stack_base);
     return true;
   }
+
+  /*static*/ double Thread::measure_user_switch_rate(bool use_ucontext,
+						     int iterations /*= 100000*/,
+						     size_t stack_size /*= 1 << 20*/)
+  {
+#ifndef REALM_USE_FAST_USER_SWITCH
+    if(!use_ucontext)
+      return 0;
+#endif
+    void *stack_base = malloc(stack_size);
+    if(!stack_base)
+      return 0;
+
+    // each iteration is a switch into the partner context and one back out
+    long long t_start, t_end;
+    if(use_ucontext) {
+      CHECK_LIBC( getcontext(&uswitch_test_ctx2) );
+      uswitch_test_ctx2.uc_link = 0;
+      uswitch_test_ctx2.uc_stack.ss_sp = stack_base;
+      uswitch_test_ctx2.uc_stack.ss_size = stack_size;
+      uswitch_test_ctx2.uc_stack.ss_flags = 0;
+      makecontext(&uswitch_test_ctx2,
+		  reinterpret_cast<void(*)()>(uswitch_bench_entry),
+		  1, 1);
+      uswitch_test_check_flag.store(0);
+      t_start = Clock::current_time_in_nanoseconds();
+      for(int i = 0; i < iterations; i++)
+	CHECK_LIBC( swapcontext(&uswitch_test_ctx1, &uswitch_test_ctx2) );
+      t_end = Clock::current_time_in_nanoseconds();
+      assert(uswitch_test_check_flag.load() == iterations);
+    } else {
+#ifdef REALM_USE_FAST_USER_SWITCH
+      int counter = 0;
+      uswitch_test_sp2 = fast_uswitch_init_stack(stack_base, stack_size,
+						 fast_uswitch_bench_entry,
+						 &counter);
+      t_start = Clock::current_time_in_nanoseconds();
+      for(int i = 0; i < iterations; i++)
+	realm_fast_uswitch(&uswitch_test_sp1, uswitch_test_sp2);
+      t_end = Clock::current_time_in_nanoseconds();
+      assert(counter == iterations);
+#endif
+    }
+
+    // the partner context is abandoned mid-loop, which is fine as it owns
+    //  nothing but its stack
+    free(stack_base);
+
+    if(t_end <= t_start)
+      return 0;
+    return (2e9 * iterations) / (t_end - t_start);
+  }
 #endif
 #ifdef REALM_ON_WINDOWS
   /*static*/ bool Thread::test_user_switch_support(size_t stack_size /*= 1 << 20*/)
   {
     return true;
   }
+
+  /*static*/ double Thread::measure_user_switch_rate(bool use_ucontext,
+						     int iterations /*= 100000*/,
+						     size_t stack_size /*= 1 << 20*/)
+  {
+    // fibers are the only implementation on Windows
+    return 0;
+  }
 #endif
 
   class UserThread : public Thread {
@@ -1242,6 +1501,9 @@ namespace Realm {
   protected:
 #if defined(REALM_ON_LINUX) || defined(REALM_ON_MACOS) || defined(REALM_ON_FREEBSD)
     REALM_ATTR_NORETURN(static void uthread_entry(void));
+#ifdef REALM_USE_FAST_USER_SWITCH
+    REALM_ATTR_NORETURN(static void fast_uthread_entry(void *));
+#endif
 #endif
 #ifdef REALM_ON_WINDOWS
     REALM_ATTR_NORETURN(static void uthread_entry(void *));
@@ -1262,6 +1524,11 @@ namespace Realm {
     int padding[512];
 #endif
     void *stack_base;
+#ifdef REALM_USE_FAST_USER_SWITCH
+    // if true, 'fast_sp' is used instead of 'ctx'
+    bool fast_switch;
+    void *fast_sp;
+#endif
 #endif
 #ifdef REALM_ON_WINDOWS
     LPVOID fiber;
@@ -1277,6 +1544,9 @@ namespace Realm {
     , magic(MAGIC_VALUE)
 #if defined(REALM_ON_LINUX) || defined(REALM_ON_MACOS) || defined(REALM_ON_FREEBSD)
     , stack_base(0)
+#ifdef REALM_USE_FAST_USER_SWITCH
+    , fast_switch(false), fast_sp(0)
+#endif
 #endif
     , stack_size(0), ok_to_delete(false)
     , running(false)
@@ -1300,6 +1570,9 @@ namespace Realm {
   namespace ThreadLocal {
 #if defined(REALM_ON_LINUX) || defined(REALM_ON_MACOS) || defined(REALM_ON_FREEBSD)
     REALM_THREAD_LOCAL ucontext_t *host_context = 0;
+#ifdef REALM_USE_FAST_USER_SWITCH
+    REALM_THREAD_LOCAL void **host_fast_sp = 0;
+#endif
 #endif
 #ifdef REALM_ON_WINDOWS
     REALM_THREAD_LOCAL LPVOID host_context = 0;
@@ -1349,6 +1622,13 @@ namespace Realm {
     }
   }
 
+#ifdef REALM_USE_FAST_USER_SWITCH
+  /*static*/ void UserThread::fast_uthread_entry(void *)
+  {
+    uthread_entry();
+  }
+#endif
+
   void UserThread::start_thread(const ThreadLaunchParameters& params,
 				const CoreReservation *rsrv)
   {
@@ -1376,6 +1656,14 @@ namespace Realm {
     stack_base = malloc(stack_size);
     assert(stack_base != 0);
 
+#ifdef REALM_USE_FAST_USER_SWITCH
+    if(!Config::force_ucontext_switch) {
+      fast_switch = true;
+      fast_sp = fast_uswitch_init_stack(stack_base, stack_size,
+					fast_uthread_entry, 0);
+    } else
+#endif
+    {
     CHECK_LIBC( getcontext(&ctx) );
 
     ctx.uc_link = 0; // we don't expect it to ever fall through
@@ -1386,6 +1674,7 @@ namespace Realm {
     // grr...  entry point takes int's, which might not hold a void *
     // we'll just fish our UserThread * out of TLS
     makecontext(&ctx, uthread_entry, 0);
+    }
 #endif
 #ifdef REALM_ON_WINDOWS
     fiber = CreateFiberEx(stack_size, stack_size,
@@ -1443,6 +1732,14 @@ namespace Realm {
 
       ThreadLocal::host_context = &host_ctx;
 
+#ifdef REALM_USE_FAST_USER_SWITCH
+      void *host_sp = 0;
+      if(switch_to->fast_switch) {
+	ThreadLocal::host_fast_sp = &host_sp;
+	realm_fast_uswitch(&host_sp, switch_to->fast_sp);
+	ThreadLocal::host_fast_sp = 0;
+      } else
+#endif
       CHECK_LIBC( swapcontext(&host_ctx, &switch_to->ctx) );
 #endif
 #ifdef REALM_ON_WINDOWS
@@ -1481,6 +1778,13 @@ namespace Realm {
 
 	// a switch between two user contexts - nice and simple
 #if defined(REALM_ON_LINUX) || defined(REALM_ON_MACOS) || defined(REALM_ON_FREEBSD)
+#ifdef REALM_USE_FAST_USER_SWITCH
+	// the switch implementation is chosen at startup, so both sides match
+	assert(switch_from->fast_switch == switch_to->fast_switch);
+	if(switch_to->fast_switch)
+	  realm_fast_uswitch(&switch_from->fast_sp, switch_to->fast_sp);
+	else
+#endif
 	CHECK_LIBC( swapcontext(&switch_from->ctx, &switch_to->ctx) );
 	switch_from->host_pthread = pthread_self();
 #endif
@@ -1498,6 +1802,12 @@ namespace Realm {
 	ThreadLocal::current_host_thread = 0;
 
 #if defined(REALM_ON_LINUX) || defined(REALM_ON_MACOS) || defined(REALM_ON_FREEBSD)
+#ifdef REALM_USE_FAST_USER_SWITCH
+	if(switch_from->fast_switch) {
+	  assert(ThreadLocal::host_fast_sp != 0);
+	  realm_fast_uswitch(&switch_from->fast_sp, *ThreadLocal::host_fast_sp);
+	} else
+#endif
 	CHECK_LIBC( swapcontext(&switch_from->ctx, ThreadLocal::host_context) );
 	switch_from->host_pthread = pthread_self();
 #endif
@@ -180,6 +180,14 @@ namespace Realm {
     // some systems do not appear to support user thread switching for
     //  reasons unknown, so allow code to test to see if it's working first
     static bool test_user_switch_support(size_t stack_size = 1 << 20);
+
+    // measures the rate (in switches per second) of back-and-forth user-level
+    //  switches using either swapcontext or the register-only switch - returns
+    //  0 if the requested implementation is not available
+    REALM_INTERNAL_API_EXTERNAL_LINKAGE
+    static double measure_user_switch_rate(bool use_ucontext,
+					   int iterations = 100000,
+					   size_t stack_size = 1 << 20);
 #endif
 
     template <typename CONDTYPE>
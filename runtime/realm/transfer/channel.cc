@@ -23,10 +23,15 @@
 #include "realm/transfer/channel.h"
 #include "realm/transfer/channel_disk.h"
 #include "realm/transfer/transfer.h"
+#include "realm/numa/numasysif.h"
 #include "realm/utils.h"
 
 #include <algorithm>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 TYPE_IS_SERIALIZABLE(Realm::XferDesKind);
 
 namespace Realm {
@@ -45,6 +50,14 @@ namespace Realm {
       // we use a single manager to organize all channels
       static ChannelManager *channel_manager = 0;
 
+  namespace Config {
+    int memcpy_parallel_pieces = 0;
+    size_t memcpy_parallel_min_bytes = 1 << 20;
+    size_t memcpy_nontemporal_min_bytes = 0;
+    int reduce_stripe_locks = 0;
+    size_t reduce_stripe_bytes = 64 << 10;
+  };
+
   // fast memcpy stuff - uses std::copy instead of memcpy to communicate
   //  alignment guarantees to the compiler
   template <typename T>
@@ -234,6 +247,195 @@ namespace Realm {
 			       bytes, lines, planes);
   }
 
+#ifdef __SSE2__
+  // streaming (non-temporal) copy - avoids polluting the caches (and the
+  //  read-for-ownership of destination lines) for copies much bigger than
+  //  the caches - caller is responsible for the final sfence
+  static void memcpy_1d_streaming(uintptr_t dst_base, uintptr_t src_base,
+				  size_t bytes)
+  {
+    // streaming stores need an aligned destination, so do any unaligned
+    //  head with a normal copy
+    size_t head = std::min(size_t(-dst_base & 15), bytes);
+    if(head > 0) {
+      memcpy_1d(dst_base, src_base, head);
+      dst_base += head;
+      src_base += head;
+      bytes -= head;
+    }
+
+    size_t body = bytes & ~size_t(63);
+    __m128i *dst = reinterpret_cast<__m128i *>(dst_base);
+    const __m128i *src = reinterpret_cast<const __m128i *>(src_base);
+    for(size_t i = 0; i < body; i += 64) {
+      __m128i v0 = _mm_loadu_si128(src + 0);
+      __m128i v1 = _mm_loadu_si128(src + 1);
+      __m128i v2 = _mm_loadu_si128(src + 2);
+      __m128i v3 = _mm_loadu_si128(src + 3);
+      _mm_stream_si128(dst + 0, v0);
+      _mm_stream_si128(dst + 1, v1);
+      _mm_stream_si128(dst + 2, v2);
+      _mm_stream_si128(dst + 3, v3);
+      src += 4;
+      dst += 4;
+    }
+
+    if(body < bytes)
+      memcpy_1d(dst_base + body, src_base + body, bytes - body);
+  }
+#endif
+
+  // chooses between the normal and streaming copy loops
+  static void memcpy_nd(uintptr_t dst_base, uintptr_t dst_lstride,
+			uintptr_t dst_pstride,
+			uintptr_t src_base, uintptr_t src_lstride,
+			uintptr_t src_pstride,
+			size_t bytes, size_t lines, size_t planes,
+			bool streaming)
+  {
+#ifdef __SSE2__
+    if(streaming) {
+      for(size_t j = 0; j < planes; j++)
+	for(size_t i = 0; i < lines; i++)
+	  memcpy_1d_streaming(dst_base + (j * dst_pstride) + (i * dst_lstride),
+			      src_base + (j * src_pstride) + (i * src_lstride),
+			      bytes);
+      _mm_sfence();
+      return;
+    }
+#endif
+    if(planes > 1)
+      memcpy_3d(dst_base, dst_lstride, dst_pstride,
+		src_base, src_lstride, src_pstride,
+		bytes, lines, planes);
+    else if(lines > 1)
+      memcpy_2d(dst_base, dst_lstride,
+		src_base, src_lstride,
+		bytes, lines);
+    else
+      memcpy_1d(dst_base, src_base, bytes);
+  }
+
+  // a large memcpy is split into pieces along its outermost dimension -
+  //  pieces are claimed by the thread that split the copy and by any
+  //  background workers that pick up the corresponding MemcpyHelper, and
+  //  whoever finishes the last piece wakes up the splitting thread
+  struct ParallelMemcpy {
+    uintptr_t dst_base, dst_lstride, dst_pstride;
+    uintptr_t src_base, src_lstride, src_pstride;
+    size_t bytes, lines, planes;
+    bool streaming;
+    size_t split_count, piece_size;
+    unsigned num_pieces;
+    atomic<unsigned> next_piece, pieces_left;
+    Mutex done_mutex;
+    CondVar done_cond;
+
+    ParallelMemcpy(uintptr_t _dst_base, uintptr_t _dst_lstride,
+		   uintptr_t _dst_pstride,
+		   uintptr_t _src_base, uintptr_t _src_lstride,
+		   uintptr_t _src_pstride,
+		   size_t _bytes, size_t _lines, size_t _planes,
+		   bool _streaming, unsigned max_pieces)
+      : dst_base(_dst_base), dst_lstride(_dst_lstride)
+      , dst_pstride(_dst_pstride)
+      , src_base(_src_base), src_lstride(_src_lstride)
+      , src_pstride(_src_pstride)
+      , bytes(_bytes), lines(_lines), planes(_planes)
+      , streaming(_streaming)
+      , next_piece(0)
+      , done_cond(done_mutex)
+    {
+      split_count = ((planes > 1) ? planes : (lines > 1) ? lines : bytes);
+      piece_size = (split_count + max_pieces - 1) / max_pieces;
+      // 1d pieces are kept to a multiple of a cache line
+      if((planes == 1) && (lines == 1))
+	piece_size = (piece_size + 63) & ~size_t(63);
+      num_pieces = (split_count + piece_size - 1) / piece_size;
+      pieces_left.store(num_pieces);
+    }
+
+    bool claim_piece(unsigned& piece)
+    {
+      piece = next_piece.fetch_add(1);
+      return (piece < num_pieces);
+    }
+
+    bool has_unclaimed_pieces() const
+    {
+      return (next_piece.load() < num_pieces);
+    }
+
+    void copy_piece(unsigned piece)
+    {
+      size_t lo = piece * piece_size;
+      size_t count = std::min(piece_size, split_count - lo);
+      if(planes > 1)
+	memcpy_nd(dst_base + (lo * dst_pstride), dst_lstride, dst_pstride,
+		  src_base + (lo * src_pstride), src_lstride, src_pstride,
+		  bytes, lines, count, streaming);
+      else if(lines > 1)
+	memcpy_nd(dst_base + (lo * dst_lstride), dst_lstride, 0,
+		  src_base + (lo * src_lstride), src_lstride, 0,
+		  bytes, count, 1, streaming);
+      else
+	memcpy_nd(dst_base + lo, 0, 0,
+		  src_base + lo, 0, 0,
+		  count, 1, 1, streaming);
+      // the count is only updated while holding the mutex, so the
+      //  splitting thread can't see it reach zero (and destroy the job)
+      //  until we're done signalling
+      AutoLock<> al(done_mutex);
+      if(pieces_left.fetch_sub_acqrel(1) == 1)
+	done_cond.signal();
+    }
+
+    void wait_for_pieces()
+    {
+      AutoLock<> al(done_mutex);
+      while(pieces_left.load() > 0)
+	done_cond.wait();
+    }
+  };
+
+  // performs a 1d/2d/3d copy, splitting it across background workers via
+  //  the helper if the copy is large enough
+  static void memcpy_maybe_parallel(MemcpyHelper *helper,
+				    uintptr_t dst_base, uintptr_t dst_lstride,
+				    uintptr_t dst_pstride,
+				    uintptr_t src_base, uintptr_t src_lstride,
+				    uintptr_t src_pstride,
+				    size_t bytes, size_t lines, size_t planes)
+  {
+    size_t total_bytes = bytes * lines * planes;
+    bool streaming = ((Config::memcpy_nontemporal_min_bytes > 0) &&
+		      (total_bytes >= Config::memcpy_nontemporal_min_bytes));
+
+    if(!helper || (Config::memcpy_parallel_pieces <= 1) ||
+       (total_bytes < Config::memcpy_parallel_min_bytes)) {
+      memcpy_nd(dst_base, dst_lstride, dst_pstride,
+		src_base, src_lstride, src_pstride,
+		bytes, lines, planes, streaming);
+      return;
+    }
+
+    ParallelMemcpy job(dst_base, dst_lstride, dst_pstride,
+		       src_base, src_lstride, src_pstride,
+		       bytes, lines, planes,
+		       streaming, Config::memcpy_parallel_pieces);
+    helper->add_job(&job);
+
+    // do as many pieces as we can ourselves, then sleep until any pieces
+    //  claimed by helpers are finished
+    unsigned piece;
+    while(job.claim_piece(piece))
+      job.copy_piece(piece);
+    job.wait_for_pieces();
+
+    helper->remove_job(&job);
+  }
+
+
 #if 0
       static inline bool cross_ib(off_t start, size_t nbytes, size_t buf_size)
       {
@@ -2471,6 +2673,13 @@ namespace Realm {
 	      uintptr_t in_base = reinterpret_cast<uintptr_t>(in_port->mem->get_direct_ptr(0, 0));
 	      uintptr_t out_base = reinterpret_cast<uintptr_t>(out_port->mem->get_direct_ptr(0, 0));
 
+	      // large copies may be split across background workers - prefer
+	      //  the ones in the destination's numa domain, if any
+	      LocalCPUMemory *out_cpumem = dynamic_cast<LocalCPUMemory *>(out_port->mem);
+	      MemcpyHelper *helper = channel->get_helper(out_cpumem ?
+							   out_cpumem->numa_node :
+							   -1);
+
 	      while(total_bytes < max_bytes) {
 		AddressListCursor& in_alc = in_port->addrcursor;
 		AddressListCursor& out_alc = out_port->addrcursor;
@@ -2487,8 +2696,12 @@ namespace Realm {
 		size_t bytes_left = max_bytes - total_bytes;
 		// memcpys don't need to be particularly big to achieve
 		//  peak efficiency, so trim to something that takes
-		//  10's of us to be responsive to the time limit
-		bytes_left = std::min(bytes_left, size_t(256 << 10));
+		//  10's of us to be responsive to the time limit - a copy
+		//  that will be split can be proportionally bigger
+		bytes_left = std::min(bytes_left,
+				      size_t(256 << 10) * (helper ?
+							     std::max(Config::memcpy_parallel_pieces, 1) :
+							     1));
 
 		if(in_dim > 0) {
 		  if(out_dim > 0) {
@@ -2504,9 +2717,10 @@ namespace Realm {
 		       ((contig_bytes == icount) && (in_dim == 1)) ||
 		       ((contig_bytes == ocount) && (out_dim == 1))) {
 		      bytes = contig_bytes;
-		      memcpy_1d(out_base + out_offset,
-				in_base + in_offset,
-				bytes);
+		      memcpy_maybe_parallel(helper,
+					    out_base + out_offset, 0, 0,
+					    in_base + in_offset, 0, 0,
+					    bytes, 1, 1);
 		      in_alc.advance(0, bytes);
 		      out_alc.advance(0, bytes);
 		    } else {
@@ -2559,9 +2773,10 @@ namespace Realm {
 			 ((lines == icount) && (id == (in_dim - 1))) ||
 			 ((lines == ocount) && (od == (out_dim - 1)))) {
 			bytes = contig_bytes * lines;
-			memcpy_2d(out_base + out_offset, out_lstride,
-				  in_base + in_offset, in_lstride,
-				  contig_bytes, lines);
+			memcpy_maybe_parallel(helper,
+					      out_base + out_offset, out_lstride, 0,
+					      in_base + in_offset, in_lstride, 0,
+					      contig_bytes, lines, 1);
 			in_alc.advance(id, lines * iscale);
 			out_alc.advance(od, lines * oscale);
 		      } else {
@@ -2602,9 +2817,10 @@ namespace Realm {
 						  (contig_bytes * lines)));
 
 			bytes = contig_bytes * lines * planes;
-			memcpy_3d(out_base + out_offset, out_lstride, out_pstride,
-				  in_base + in_offset, in_lstride, in_pstride,
-				  contig_bytes, lines, planes);
+			memcpy_maybe_parallel(helper,
+					      out_base + out_offset, out_lstride, out_pstride,
+					      in_base + in_offset, in_lstride, in_pstride,
+					      contig_bytes, lines, planes);
 			in_alc.advance(id, planes * iscale);
 			out_alc.advance(od, planes * oscale);
 		      }
@@ -2673,6 +2889,578 @@ namespace Realm {
       }
 
 
+      // helper - used by fill xds to build buffers with repeated copies of the
+      //  fill value
+      static void repeat_fill(void *dst, const void *src, size_t bytes, size_t count)
+      {
+#define SPECIALIZE_FILL(TYPE, N)                                        \
+	{								\
+	  TYPE *dsttyped = reinterpret_cast<TYPE *>(dst);		\
+	  const TYPE *srctyped = reinterpret_cast<const TYPE *>(src);	\
+	  for(size_t i = 0; i < count; i++)				\
+	    for(size_t j = 0; j < N; j++)				\
+	      *dsttyped++ = srctyped[j];				\
+	}
+
+	switch(bytes) {
+	case sizeof(uint32_t):
+	  {
+	    SPECIALIZE_FILL(uint32_t, 1);
+	    break;
+	  }
+	case sizeof(uint64_t):
+	  {
+	    SPECIALIZE_FILL(uint64_t, 1);
+	    break;
+	  }
+	case 2 * sizeof(uint64_t):
+	  {
+	    SPECIALIZE_FILL(uint64_t, 2);
+	    break;
+	  }
+	case 4 * sizeof(uint64_t):
+	  {
+	    SPECIALIZE_FILL(uint64_t, 4);
+	    break;
+	  }
+	default:
+	  {
+	    for(size_t i = 0; i < count; i++)
+	      memcpy(reinterpret_cast<char *>(dst) + (bytes * i), src, bytes);
+	    break;
+	  }
+	}
+
+#undef SPECIALIZE_FILL
+      }
+
+#ifdef REALM_USE_HDF5
+      // the fill channel runs multiple xds concurrently, but libhdf5 is not
+      //  necessarily thread-safe, so hdf5 fills are serialized
+      static Mutex hdf5_fill_mutex;
+
+      static void hdf5_fill(TransferIterator *iter,
+			    const void *fill_buffer, size_t fill_size)
+      {
+	AutoLock<> al(hdf5_fill_mutex);
+
+	hid_t file_id = -1;
+	hid_t dset_id = -1;
+	hid_t dtype_id = -1;
+	const std::string *prev_filename = 0;
+	const std::string *prev_dsetname = 0;
+	while(!iter->done()) {
+	  TransferIterator::AddressInfoHDF5 info;
+	  size_t act_bytes = iter->step_hdf5(size_t(-1), // max_bytes
+					     info);
+	  assert(act_bytes >= 0);
+
+	  // compare the pointers, not the string contents...
+	  if(info.filename != prev_filename) {
+	    // close dataset too
+	    if(dset_id != -1) {
+	      CHECK_HDF5( H5Tclose(dtype_id) );
+	      CHECK_HDF5( H5Dclose(dset_id) );
+	      prev_dsetname = 0;
+	    }
+	    if(file_id != -1)
+	      CHECK_HDF5( H5Fclose(file_id) );
+
+	    CHECK_HDF5( file_id = H5Fopen(info.filename->c_str(),
+					  H5F_ACC_RDWR, H5P_DEFAULT) );
+	    prev_filename = info.filename;
+	  }
+
+	  if(info.dsetname != prev_dsetname) {
+	    if(dset_id != -1) {
+	      CHECK_HDF5( H5Tclose(dtype_id) );
+	      CHECK_HDF5( H5Dclose(dset_id) );
+	    }
+	    CHECK_HDF5( dset_id = H5Dopen2(file_id, info.dsetname->c_str(),
+					   H5P_DEFAULT) );
+	    CHECK_HDF5( dtype_id = H5Dget_type(dset_id) );
+	    size_t dtype_size = H5Tget_size(dtype_id);
+	    assert(dtype_size == fill_size);
+	    prev_dsetname = info.dsetname;
+	  }
+
+	  // HDF5 doesn't seem to offer a way to fill a file without building
+	  //  an equivalently-sized memory buffer first, and we can't do
+	  //  point-wise because libhdf5 doesn't buffer, so try to find a
+	  //  reasonably-sized chunk to do fills with - this code is still
+	  //  limited to each dimension being all-or-nothing
+	  int dims = info.extent.size();
+	  size_t max_chunk_elems = (32 << 20) / fill_size; // 32MB
+	  size_t chunk_elems = 1;
+	  // because HDF5 uses C data ordering, we need to group from the last
+	  //  dim backwards
+	  int step_dims = dims;
+	  while(step_dims > 0) {
+	    size_t new_elems = chunk_elems * info.extent[step_dims - 1];
+	    if(new_elems > max_chunk_elems) break;
+	    chunk_elems = new_elems;
+	    step_dims--;
+	  }
+	  void *chunk_data = const_cast<void *>(fill_buffer);
+	  if(chunk_elems > 1) {
+	    chunk_data = malloc(chunk_elems * fill_size);
+	    assert(chunk_data != 0);
+	    repeat_fill(chunk_data, fill_buffer, fill_size, chunk_elems);
+	  }
+	  std::vector<hsize_t> mem_dims(dims, 1);
+	  for(int i = step_dims; i < dims; i++)
+	    mem_dims[i] = info.extent[i];
+	  hid_t mem_space_id, file_space_id;
+	  CHECK_HDF5( mem_space_id = H5Screate_simple(dims, mem_dims.data(),
+						      NULL) );
+	  CHECK_HDF5( file_space_id = H5Dget_space(dset_id) );
+
+	  std::vector<hsize_t> cur_pos(info.offset);
+	  std::vector<hsize_t> cur_size = mem_dims;
+	  while(true) {
+	    CHECK_HDF5( H5Sselect_hyperslab(file_space_id, H5S_SELECT_SET,
+					    cur_pos.data(), 0,
+					    cur_size.data(), 0) );
+	    CHECK_HDF5( H5Dwrite(dset_id, dtype_id,
+				 mem_space_id, file_space_id,
+				 H5P_DEFAULT, chunk_data) );
+	    // advance to next position
+	    int d = 0;
+	    while(d < step_dims) {
+	      if(++cur_pos[d] < (info.offset[d] + info.extent[d]))
+		break;
+	      cur_pos[d] = info.offset[d];
+	      d++;
+	    }
+	    if(d >= step_dims) break;
+	  }
+
+	  if(chunk_data != fill_buffer)
+	    free(chunk_data);
+
+	  CHECK_HDF5( H5Sclose(mem_space_id) );
+	  CHECK_HDF5( H5Sclose(file_space_id) );
+	}
+
+	// close the last dset and file we touched
+	if(dset_id != -1) {
+	  CHECK_HDF5( H5Tclose(dtype_id) );
+	  CHECK_HDF5( H5Dclose(dset_id) );
+	}
+	if(file_id != -1)
+	  CHECK_HDF5( H5Fclose(file_id) );
+      }
+#endif
+
+      FillXferDes::FillXferDes(DmaRequest *_dma_request, NodeID _launch_node, XferDesID _guid,
+			       const std::vector<XferDesPortInfo>& inputs_info,
+			       const std::vector<XferDesPortInfo>& outputs_info,
+			       bool _mark_start,
+			       uint64_t _max_req_size, long max_nr, int _priority,
+			       XferDesFence* _complete_fence,
+			       const void *_fill_data, size_t _fill_size)
+	: XferDes(_dma_request, _launch_node, _guid,
+		  inputs_info, outputs_info,
+		  _mark_start,
+		  _max_req_size, _priority,
+		  _complete_fence)
+	, fill_size(_fill_size)
+	, rep_buffer(0)
+	, rep_size(0)
+      {
+	channel = channel_manager->get_fill_channel();
+	kind = XFER_FILL;
+
+	assert(input_ports.empty() && (output_ports.size() == 1));
+
+	fill_data = malloc(fill_size);
+	assert(fill_data != 0);
+	memcpy(fill_data, _fill_data, fill_size);
+
+#ifdef REALM_USE_CUDA
+	// fills to GPU FB memory are offloaded to the GPU itself
+	if(output_ports[0].mem->lowlevel_kind == Memory::GPU_FB_MEM)
+	  dst_gpu = ((Cuda::GPUFBMemory*)(output_ports[0].mem))->gpu;
+	else
+	  dst_gpu = 0;
+	gpu_fills_issued = false;
+#endif
+      }
+
+      FillXferDes::~FillXferDes()
+      {
+	free(fill_data);
+	if(rep_buffer)
+	  free(rep_buffer);
+      }
+
+      long FillXferDes::get_requests(Request** requests, long nr)
+      {
+	// unused
+	assert(0);
+	return 0;
+      }
+
+      void FillXferDes::notify_request_read_done(Request* req)
+      {
+	// unused
+	assert(0);
+      }
+
+      void FillXferDes::notify_request_write_done(Request* req)
+      {
+	// unused
+	assert(0);
+      }
+
+      void FillXferDes::flush()
+      {
+      }
+
+      bool FillXferDes::progress_xd(FillChannel *channel,
+				    TimeLimit work_until)
+      {
+	XferPort& out_port = output_ports[0];
+	TransferIterator *iter = out_port.iter;
+	MemoryImpl *mem_impl = out_port.mem;
+
+#ifdef REALM_USE_HDF5
+	// hdf5 fills are done in a single pass
+	if(mem_impl->lowlevel_kind == Memory::HDF_MEM) {
+	  hdf5_fill(iter, fill_data, fill_size);
+	  iteration_completed.store_release(true);
+	  return true;
+	}
+#endif
+
+	bool did_work = false;
+	while(!iter->done()) {
+	  TransferIterator::AddressInfo info;
+
+	  // code below is 2D/3D-capable
+	  unsigned flags = (TransferIterator::LINES_OK |
+			    TransferIterator::PLANES_OK);
+
+#ifdef REALM_USE_CUDA
+	  if(dst_gpu != 0) {
+	    // gpu fills are asynchronous, so no need to break them up
+	    size_t act_bytes = iter->step(size_t(-1), info, flags);
+	    assert(act_bytes > 0);
+
+	    if(info.num_planes == 1) {
+	      if(info.num_lines == 1) {
+		dst_gpu->fill_within_fb(info.base_offset, info.bytes_per_chunk,
+					fill_data, fill_size);
+	      } else {
+		dst_gpu->fill_within_fb_2d(info.base_offset, info.line_stride,
+					   info.bytes_per_chunk, info.num_lines,
+					   fill_data, fill_size);
+	      }
+	    } else {
+	      dst_gpu->fill_within_fb_3d(info.base_offset, info.line_stride,
+					 info.plane_stride,
+					 info.bytes_per_chunk, info.num_lines,
+					 info.num_planes,
+					 fill_data, fill_size);
+	    }
+	    gpu_fills_issued = true;
+	    did_work = true;
+	    continue;
+	  }
+#endif
+
+	  // fills don't need to be particularly big to achieve peak
+	  //  efficiency, so trim to something that takes 10's of us to be
+	  //  responsive to the time limit
+	  size_t max_bytes = std::min(max_req_size, uint64_t(256 << 10));
+	  size_t act_bytes = iter->step(max_bytes, info, flags);
+	  assert(act_bytes > 0);
+
+	  // decide whether to use the original fill buffer or one that
+	  //  repeats the data several times
+	  const void *use_buffer = fill_data;
+	  size_t use_size = fill_size;
+	  const size_t MAX_REP_SIZE = 32768;
+	  if((info.bytes_per_chunk > fill_size) &&
+	     ((fill_size * 2) <= MAX_REP_SIZE)) {
+	    if(!rep_buffer) {
+	      size_t rep_elems = MAX_REP_SIZE / fill_size;
+	      rep_size = rep_elems * fill_size;
+	      rep_buffer = malloc(rep_size);
+	      assert(rep_buffer != 0);
+	      repeat_fill(rep_buffer, fill_data, fill_size, rep_elems);
+	    }
+	    use_buffer = rep_buffer;
+	    use_size = rep_size;
+	  }
+
+	  for(size_t p = 0; p < info.num_planes; p++)
+	    for(size_t l = 0; l < info.num_lines; l++) {
+	      size_t ofs = 0;
+	      while((ofs + use_size) < info.bytes_per_chunk) {
+		mem_impl->put_bytes(info.base_offset +
+				    (p * info.plane_stride) +
+				    (l * info.line_stride) +
+				    ofs, use_buffer, use_size);
+		ofs += use_size;
+	      }
+	      size_t bytes_left = info.bytes_per_chunk - ofs;
+	      assert((bytes_left > 0) && (bytes_left <= use_size));
+	      mem_impl->put_bytes(info.base_offset +
+				  (p * info.plane_stride) +
+				  (l * info.line_stride) +
+				  ofs, use_buffer, bytes_left);
+	    }
+
+	  did_work = true;
+	  if(work_until.is_expired())
+	    break;
+	}
+
+	if(iter->done()) {
+#ifdef REALM_USE_CUDA
+	  // if we did any asynchronous operations, insert a fence
+	  if(gpu_fills_issued)
+	    dst_gpu->fence_within_fb(dma_request);
+#endif
+	  iteration_completed.store_release(true);
+	}
+
+	return did_work;
+      }
+
+      // used to tag remote reductions so that a fence can be applied to
+      //  them at the end
+      static atomic<unsigned> rdma_sequence_no(1);
+
+      ReductionXferDes::ReductionXferDes(DmaRequest *_dma_request, NodeID _launch_node, XferDesID _guid,
+					 const std::vector<XferDesPortInfo>& inputs_info,
+					 const std::vector<XferDesPortInfo>& outputs_info,
+					 bool _mark_start,
+					 uint64_t _max_req_size, long max_nr, int _priority,
+					 XferDesFence* _complete_fence,
+					 ReductionOpID _redop_id, bool _red_fold)
+	: XferDes(_dma_request, _launch_node, _guid,
+		  inputs_info, outputs_info,
+		  _mark_start,
+		  _max_req_size, _priority,
+		  _complete_fence)
+	, redop_id(_redop_id)
+	, red_fold(_red_fold)
+	, rdma_count(0)
+	, src_scratch_buffer(0)
+	, dst_scratch_buffer(0)
+	, src_scratch_size(0)
+	, dst_scratch_size(0)
+      {
+	channel = channel_manager->get_reduce_channel();
+	kind = XFER_REDUCE;
+
+	assert((input_ports.size() == 1) && (output_ports.size() == 1));
+
+	redop = get_runtime()->reduce_op_table.get(redop_id, 0);
+	if(redop == 0) {
+	  log_new_dma.fatal() << "no reduction op registered for ID " << redop_id;
+	  abort();
+	}
+
+	MemoryImpl *dst_mem = output_ports[0].mem;
+	dst_is_remote = ((dst_mem->kind == MemoryImpl::MKIND_REMOTE) ||
+			 (dst_mem->kind == MemoryImpl::MKIND_RDMA));
+	rdma_sequence_id = (dst_is_remote ?
+			      rdma_sequence_no.fetch_add(1) :
+			      0);
+      }
+
+      ReductionXferDes::~ReductionXferDes()
+      {
+	if(src_scratch_size > 0)
+	  free(src_scratch_buffer);
+	if(dst_scratch_size > 0)
+	  free(dst_scratch_buffer);
+      }
+
+      long ReductionXferDes::get_requests(Request** requests, long nr)
+      {
+	// unused
+	assert(0);
+	return 0;
+      }
+
+      void ReductionXferDes::notify_request_read_done(Request* req)
+      {
+	// unused
+	assert(0);
+      }
+
+      void ReductionXferDes::notify_request_write_done(Request* req)
+      {
+	// unused
+	assert(0);
+      }
+
+      void ReductionXferDes::flush()
+      {
+      }
+
+      // applies a non-exclusive reduction to directly-accessible memory by
+      //  taking the stripe lock for each chunk of the destination and using
+      //  the exclusive path - an element belongs to the chunk holding its
+      //  first byte, so every reducer agrees on which lock covers it
+      void ReductionXferDes::striped_reduce(void *dst_ptr, const void *src_ptr,
+					    size_t num_elems,
+					    size_t src_elem_size)
+      {
+	static Mutex *stripe_locks = new Mutex[Config::reduce_stripe_locks];
+
+	size_t dst_elem_size = (red_fold ? redop->sizeof_rhs :
+				           redop->sizeof_lhs);
+	const uintptr_t chunk_bytes = std::max(Config::reduce_stripe_bytes,
+					       dst_elem_size);
+	char *dst = static_cast<char *>(dst_ptr);
+	const char *src = static_cast<const char *>(src_ptr);
+	while(num_elems > 0) {
+	  uintptr_t addr = reinterpret_cast<uintptr_t>(dst);
+	  uintptr_t chunk = addr / chunk_bytes;
+	  size_t count = (((chunk + 1) * chunk_bytes - addr +
+			   dst_elem_size - 1) / dst_elem_size);
+	  if(count > num_elems)
+	    count = num_elems;
+	  {
+	    AutoLock<> al(stripe_locks[chunk % Config::reduce_stripe_locks]);
+	    if(red_fold)
+	      redop->fold(dst, src, count, true /*excl*/);
+	    else
+	      redop->apply(dst, src, count, true /*excl*/);
+	  }
+	  dst += count * dst_elem_size;
+	  src += count * src_elem_size;
+	  num_elems -= count;
+	}
+      }
+
+      bool ReductionXferDes::progress_xd(ReductionChannel *channel,
+					 TimeLimit work_until)
+      {
+	TransferIterator *src_iter = input_ports[0].iter;
+	TransferIterator *dst_iter = output_ports[0].iter;
+	MemoryImpl *src_mem = input_ports[0].mem;
+	MemoryImpl *dst_mem = output_ports[0].mem;
+
+	size_t src_elem_size = red_fold ? redop->sizeof_rhs : redop->sizeof_lhs;
+
+	bool did_work = false;
+	while(!src_iter->done()) {
+	  TransferIterator::AddressInfo src_info, dst_info;
+
+	  // as with memcpys, trim each step to something that takes 10's of
+	  //  us so that we're responsive to the time limit
+	  size_t max_bytes = std::min(max_req_size, uint64_t(256 << 10));
+	  size_t src_bytes = src_iter->step(max_bytes, src_info, 0,
+					    true /*tentative*/);
+	  assert(src_bytes > 0);
+	  size_t num_elems = src_bytes / src_elem_size;
+	  size_t exp_dst_bytes = num_elems * redop->sizeof_rhs;
+	  size_t dst_bytes = dst_iter->step(exp_dst_bytes, dst_info, 0);
+	  if(dst_bytes == exp_dst_bytes) {
+	    // good, confirm the source step
+	    src_iter->confirm_step();
+	  } else {
+	    // bad, cancel the source step and try a smaller one
+	    src_iter->cancel_step();
+	    num_elems = dst_bytes / redop->sizeof_rhs;
+	    size_t exp_src_bytes = num_elems * src_elem_size;
+	    src_bytes = src_iter->step(exp_src_bytes, src_info, 0);
+	    assert(src_bytes == exp_src_bytes);
+	  }
+
+	  // can we directly access the source data?
+	  const void *src_ptr = src_mem->get_direct_ptr(src_info.base_offset,
+							src_info.bytes_per_chunk);
+	  if((src_ptr == 0) || (src_mem->kind == MemoryImpl::MKIND_GPUFB)) {
+	    // nope, make a local copy via get_bytes
+	    if(src_info.bytes_per_chunk > src_scratch_size) {
+	      if(src_scratch_size > 0)
+		free(src_scratch_buffer);
+	      // allocate 2x in case the next block is a little bigger
+	      src_scratch_size = src_info.bytes_per_chunk * 2;
+	      src_scratch_buffer = malloc(src_scratch_size);
+	    }
+	    src_mem->get_bytes(src_info.base_offset,
+			       src_scratch_buffer,
+			       src_info.bytes_per_chunk);
+	    src_ptr = src_scratch_buffer;
+	  }
+
+	  // now look at destination and deal with two fast cases
+
+	  // case 1: destination is remote (quickest to check)
+	  if(dst_is_remote) {
+	    // have to tell rdma to make a copy if we're using the temp buffer
+	    bool make_copy = (src_ptr == src_scratch_buffer);
+	    rdma_count += do_remote_reduce(dst_mem->me,
+					   dst_info.base_offset,
+					   redop_id, red_fold,
+					   src_ptr, num_elems,
+					   src_elem_size, redop->sizeof_rhs,
+					   rdma_sequence_id,
+					   make_copy);
+	  } else {
+	    // case 2: destination is directly accessible
+	    void *dst_ptr = dst_mem->get_direct_ptr(dst_info.base_offset,
+						    dst_info.bytes_per_chunk);
+	    if(dst_ptr && (dst_mem->kind != MemoryImpl::MKIND_GPUFB)) {
+	      if(Config::reduce_stripe_locks > 0)
+		striped_reduce(dst_ptr, src_ptr, num_elems, src_elem_size);
+	      else if(red_fold)
+		redop->fold(dst_ptr, src_ptr, num_elems, false /*!excl*/);
+	      else
+		redop->apply(dst_ptr, src_ptr, num_elems, false /*!excl*/);
+	    } else {
+	      // case 3: fallback - use get_bytes/put_bytes combo
+
+	      // need a buffer for destination data
+	      if(dst_info.bytes_per_chunk > dst_scratch_size) {
+		if(dst_scratch_size > 0)
+		  free(dst_scratch_buffer);
+		// allocate 2x in case the next block is a little bigger
+		dst_scratch_size = dst_info.bytes_per_chunk * 2;
+		dst_scratch_buffer = malloc(dst_scratch_size);
+	      }
+	      dst_mem->get_bytes(dst_info.base_offset,
+				 dst_scratch_buffer,
+				 dst_info.bytes_per_chunk);
+	      if(red_fold)
+		redop->fold(dst_scratch_buffer, src_ptr, num_elems, true/*excl*/);
+	      else
+		redop->apply(dst_scratch_buffer, src_ptr, num_elems, true/*excl*/);
+	      dst_mem->put_bytes(dst_info.base_offset,
+				 dst_scratch_buffer,
+				 dst_info.bytes_per_chunk);
+	    }
+	  }
+
+	  did_work = true;
+	  if(work_until.is_expired())
+	    break;
+	}
+
+	if(src_iter->done()) {
+	  assert(dst_iter->done());
+
+	  // if we did any remote reductions, the operation isn't done until
+	  //  they've all been applied
+	  if(rdma_count > 0) {
+	    RemoteWriteFence *fence = new RemoteWriteFence(dma_request);
+	    dma_request->add_async_work_item(fence);
+	    do_remote_fence(dst_mem->me, rdma_sequence_id, rdma_count, fence);
+	  }
+	  iteration_completed.store_release(true);
+	}
+
+	return did_work;
+      }
+
       GASNetXferDes::GASNetXferDes(DmaRequest *_dma_request, NodeID _launch_node, XferDesID _guid,
 				   const std::vector<XferDesPortInfo>& inputs_info,
 				   const std::vector<XferDesPortInfo>& outputs_info,
@@ -3955,6 +4743,13 @@ namespace Realm {
 	p.xd_kind = xd_kind;
       }
 
+      long Channel::submit(Request** requests, long nr)
+      {
+	log_new_dma.fatal() << "channel of kind " << kind << " does not accept requests";
+	abort();
+	return 0;
+      }
+
       long Channel::progress_xd(XferDes *xd, long max_nr)
       {
 	const long MAX_NR = 8;
@@ -4013,7 +4808,8 @@ namespace Realm {
       static const Memory::Kind cpu_mem_kinds[] = { Memory::SYSTEM_MEM,
 						    Memory::REGDMA_MEM,
 						    Memory::Z_COPY_MEM,
-                                                    Memory::SOCKET_MEM };
+                                                    Memory::SOCKET_MEM,
+						    Memory::FILE_MAPPED_MEM };
       static const size_t num_cpu_mem_kinds = sizeof(cpu_mem_kinds) / sizeof(cpu_mem_kinds[0]);
 
       MemcpyChannel::MemcpyChannel(BackgroundWorkManager *bgwork)
@@ -4024,7 +4820,7 @@ namespace Realm {
         //cbs = (MemcpyRequest**) calloc(max_nr, sizeof(MemcpyRequest*));
 	unsigned bw = 0; // TODO
 	unsigned latency = 0;
-	// any combination of SYSTEM/REGDMA/Z_COPY/SOCKET_MEM
+	// any combination of SYSTEM/REGDMA/Z_COPY/SOCKET/FILE_MAPPED_MEM
 	for(size_t i = 0; i < num_cpu_mem_kinds; i++)
 	  for(size_t j = 0; j < num_cpu_mem_kinds; j++)
 	    add_path(cpu_mem_kinds[i], false,
@@ -4032,11 +4828,109 @@ namespace Realm {
 		     bw, latency, true, true, XFER_MEM_CPY);
 
 	xdq.add_to_manager(bgwork);
+
+	if(Config::memcpy_parallel_pieces > 1) {
+	  helpers[-1] = new MemcpyHelper(bgwork, -1);
+	  std::map<int, NumaNodeCpuInfo> cpuinfo;
+	  if(numasysif_numa_available() &&
+	     numasysif_get_cpu_info(cpuinfo)) {
+	    for(std::map<int, NumaNodeCpuInfo>::const_iterator it = cpuinfo.begin();
+		it != cpuinfo.end();
+		++it)
+	      helpers[it->first] = new MemcpyHelper(bgwork, it->first);
+	  }
+	}
       }
 
       MemcpyChannel::~MemcpyChannel()
       {
         //free(cbs);
+	for(std::map<int, MemcpyHelper *>::iterator it = helpers.begin();
+	    it != helpers.end();
+	    ++it)
+	  delete it->second;
+      }
+
+      void MemcpyChannel::shutdown()
+      {
+#ifdef DEBUG_REALM
+	for(std::map<int, MemcpyHelper *>::iterator it = helpers.begin();
+	    it != helpers.end();
+	    ++it)
+	  it->second->shutdown_work_item();
+#endif
+	SingleXDQChannel<MemcpyChannel, MemcpyXferDes>::shutdown();
+      }
+
+      MemcpyHelper *MemcpyChannel::get_helper(int numa_domain)
+      {
+	if(helpers.empty())
+	  return 0;
+	std::map<int, MemcpyHelper *>::const_iterator it = helpers.find(numa_domain);
+	if(it == helpers.end())
+	  it = helpers.find(-1);
+	return it->second;
+      }
+
+      MemcpyHelper::MemcpyHelper(BackgroundWorkManager *bgwork,
+				 int _numa_domain)
+	: BackgroundWorkItem("memcpy helper")
+	, is_active(false)
+      {
+	add_to_manager(bgwork, _numa_domain);
+      }
+
+      void MemcpyHelper::add_job(ParallelMemcpy *job)
+      {
+	bool activate = false;
+	{
+	  AutoLock<> al(mutex);
+	  jobs.push_back(job);
+	  if(!is_active)
+	    activate = is_active = true;
+	}
+	if(activate)
+	  make_active();
+      }
+
+      void MemcpyHelper::remove_job(ParallelMemcpy *job)
+      {
+	AutoLock<> al(mutex);
+	std::deque<ParallelMemcpy *>::iterator it = std::find(jobs.begin(),
+							      jobs.end(),
+							      job);
+	if(it != jobs.end())
+	  jobs.erase(it);
+      }
+
+      void MemcpyHelper::do_work(TimeLimit work_until)
+      {
+	// claim a single piece of the oldest job that has any left and, if
+	//  more remain, re-mark ourselves active so other workers can help
+	ParallelMemcpy *job = 0;
+	unsigned piece = 0;
+	bool still_more = false;
+	{
+	  AutoLock<> al(mutex);
+	  is_active = false;
+	  while(!jobs.empty()) {
+	    if(jobs.front()->claim_piece(piece)) {
+	      job = jobs.front();
+	      still_more = (job->has_unclaimed_pieces() || (jobs.size() > 1));
+	      break;
+	    }
+	    // everything in this job has been claimed - the owner will wait for
+	    //  the pieces to complete
+	    jobs.pop_front();
+	  }
+	  if(still_more)
+	    is_active = true;
+	}
+	if(still_more)
+	  make_active();
+
+	if(job)
+	  job->copy_piece(piece);
       }
 
       bool MemcpyChannel::supports_path(Memory src_mem, Memory dst_mem,
@@ -4518,6 +5412,30 @@ namespace Realm {
       }
 
 
+      FillChannel::FillChannel(BackgroundWorkManager *bgwork)
+	: SingleXDQChannel<FillChannel,FillXferDes>(bgwork,
+						    XFER_FILL,
+						    "fill channel")
+      {
+	// no paths - fill xds are created directly by FillRequest
+      }
+
+      FillChannel::~FillChannel()
+      {
+      }
+
+      ReductionChannel::ReductionChannel(BackgroundWorkManager *bgwork)
+	: SingleXDQChannel<ReductionChannel,ReductionXferDes>(bgwork,
+							      XFER_REDUCE,
+							      "reduction channel")
+      {
+	// no paths - reduction xds are created directly by ReduceRequest
+      }
+
+      ReductionChannel::~ReductionChannel()
+      {
+      }
+
       GASNetChannel::GASNetChannel(BackgroundWorkManager *bgwork,
 				   XferDesKind _kind)
 	: SingleXDQChannel<GASNetChannel, GASNetXferDes>(bgwork,
@@ -5003,6 +5921,18 @@ namespace Realm {
         memcpy_channel = new MemcpyChannel(bgwork);
         return memcpy_channel;
       }
+      FillChannel* ChannelManager::create_fill_channel(BackgroundWorkManager *bgwork)
+      {
+        assert(fill_channel == NULL);
+        fill_channel = new FillChannel(bgwork);
+        return fill_channel;
+      }
+      ReductionChannel* ChannelManager::create_reduce_channel(BackgroundWorkManager *bgwork)
+      {
+        assert(reduce_channel == NULL);
+        reduce_channel = new ReductionChannel(bgwork);
+        return reduce_channel;
+      }
       GASNetChannel* ChannelManager::create_gasnet_read_channel(BackgroundWorkManager *bgwork) {
         assert(gasnet_read_channel == NULL);
         gasnet_read_channel = new GASNetChannel(bgwork, XFER_GASNET_READ);
@@ -5217,10 +6147,14 @@ namespace Realm {
 	GASNetChannel* gasnet_read_channel = channel_manager->create_gasnet_read_channel(bgwork);
 	GASNetChannel* gasnet_write_channel = channel_manager->create_gasnet_write_channel(bgwork);
 	AddressSplitChannel *addr_split_channel = channel_manager->create_addr_split_channel(bgwork);
+	FillChannel *fill_channel = channel_manager->create_fill_channel(bgwork);
+	ReductionChannel *reduce_channel = channel_manager->create_reduce_channel(bgwork);
 	r->add_dma_channel(memcpy_channel);
 	r->add_dma_channel(gasnet_read_channel);
 	r->add_dma_channel(gasnet_write_channel);
 	r->add_dma_channel(addr_split_channel);
+	r->add_dma_channel(fill_channel);
+	r->add_dma_channel(reduce_channel);
 
 	RemoteWriteChannel *remote_channel = channel_manager->create_remote_write_channel(bgwork);
 	DiskChannel *disk_channel = channel_manager->create_disk_channel(bgwork);
@@ -57,6 +57,27 @@ namespace Realm {
 
     extern Logger log_new_dma;
 
+    namespace Config {
+      // maximum number of pieces a single large memcpy may be split into
+      //  so that multiple background workers can copy in parallel
+      //  (0 or 1 disables parallel memcpys)
+      extern int memcpy_parallel_pieces;
+      // copies smaller than this are never split
+      extern size_t memcpy_parallel_min_bytes;
+      // copies at least this large use non-temporal (streaming) stores,
+      //  where supported (0 disables)
+      extern size_t memcpy_nontemporal_min_bytes;
+      // non-exclusive reductions into directly-accessible memory are
+      //  normally applied with the reduction op's per-element atomic path -
+      //  if non-zero, they are instead serialized through this many striped
+      //  locks and use the (possibly vectorized) exclusive path - this is
+      //  only safe if nothing other than reduction copies (e.g. a task's
+      //  reduction accessor) updates the destination concurrently
+      extern int reduce_stripe_locks;
+      // size of the chunks of destination memory covered by a single lock
+      extern size_t reduce_stripe_bytes;
+    };
+
     class Request {
     public:
       enum Dimension {
@@ -504,6 +525,79 @@ namespace Realm {
       //const char *src_buf_base, *dst_buf_base;
     };
 
+    class FillChannel;
+
+    // fills have no input ports - the fill value is provided at creation
+    //  time and is written repeatedly to the (single) output port
+    class FillXferDes : public XferDes {
+    public:
+      FillXferDes(DmaRequest *_dma_request, NodeID _launch_node, XferDesID _guid,
+		  const std::vector<XferDesPortInfo>& inputs_info,
+		  const std::vector<XferDesPortInfo>& outputs_info,
+		  bool _mark_start,
+		  uint64_t _max_req_size, long max_nr, int _priority,
+		  XferDesFence* _complete_fence,
+		  const void *_fill_data, size_t _fill_size);
+
+      ~FillXferDes();
+
+      long get_requests(Request** requests, long nr);
+      void notify_request_read_done(Request* req);
+      void notify_request_write_done(Request* req);
+      void flush();
+
+      bool progress_xd(FillChannel *channel, TimeLimit work_until);
+
+    private:
+      void *fill_data;
+      size_t fill_size;
+      // a buffer containing several copies of the fill data, so that we
+      //  make fewer put_bytes calls for large fills - created lazily
+      void *rep_buffer;
+      size_t rep_size;
+#ifdef REALM_USE_CUDA
+      Cuda::GPU *dst_gpu;
+      bool gpu_fills_issued;
+#endif
+    };
+
+    class ReductionChannel;
+
+    // reductions read from a single input port and apply/fold into a single
+    //  output port, which may be in a remote memory
+    class ReductionXferDes : public XferDes {
+    public:
+      ReductionXferDes(DmaRequest *_dma_request, NodeID _launch_node, XferDesID _guid,
+		       const std::vector<XferDesPortInfo>& inputs_info,
+		       const std::vector<XferDesPortInfo>& outputs_info,
+		       bool _mark_start,
+		       uint64_t _max_req_size, long max_nr, int _priority,
+		       XferDesFence* _complete_fence,
+		       ReductionOpID _redop_id, bool _red_fold);
+
+      ~ReductionXferDes();
+
+      long get_requests(Request** requests, long nr);
+      void notify_request_read_done(Request* req);
+      void notify_request_write_done(Request* req);
+      void flush();
+
+      bool progress_xd(ReductionChannel *channel, TimeLimit work_until);
+
+    protected:
+      void striped_reduce(void *dst_ptr, const void *src_ptr,
+			  size_t num_elems, size_t src_elem_size);
+
+    private:
+      ReductionOpID redop_id;
+      bool red_fold;
+      const ReductionOpUntyped *redop;
+      bool dst_is_remote;
+      unsigned rdma_sequence_id, rdma_count;
+      void *src_scratch_buffer, *dst_scratch_buffer;
+      size_t src_scratch_size, dst_scratch_size;
+    };
+
     class GASNetChannel;
 
     class GASNetXferDes : public XferDes {
@@ -681,8 +775,11 @@ namespace Realm {
        * This is supposed to be a non-blocking function call, and
        * should immediately return the number of requests that are
        * successfully submitted.
+       * Channels whose xfer descriptors do all their work in progress_xd
+       * (e.g. fill and reduction) never see requests and use the default,
+       * which reports a fatal error.
        */
-      virtual long submit(Request** requests, long nr) = 0;
+      virtual long submit(Request** requests, long nr);
 
       /*
        *
@@ -872,6 +969,26 @@ namespace Realm {
       XDQueue<CHANNEL, XD> xdq;
     };
 
+    struct ParallelMemcpy;
+
+    // a MemcpyHelper lets any available background worker (in the helper's
+    //  numa domain, if any) pick up pieces of a large memcpy that has been
+    //  split by a MemcpyXferDes
+    class MemcpyHelper : public BackgroundWorkItem {
+    public:
+      MemcpyHelper(BackgroundWorkManager *bgwork, int _numa_domain);
+
+      void add_job(ParallelMemcpy *job);
+      void remove_job(ParallelMemcpy *job);
+
+      virtual void do_work(TimeLimit work_until);
+
+    protected:
+      Mutex mutex;
+      std::deque<ParallelMemcpy *> jobs;
+      bool is_active;
+    };
+
     class MemcpyChannel : public SingleXDQChannel<MemcpyChannel, MemcpyXferDes> {
     public:
       MemcpyChannel(BackgroundWorkManager *bgwork);
@@ -881,6 +998,12 @@ namespace Realm {
 
       ~MemcpyChannel();
 
+      virtual void shutdown();
+
+      // returns the helper to use for copies into the given numa domain,
+      //  or null if parallel memcpys are disabled
+      MemcpyHelper *get_helper(int numa_domain);
+
       virtual bool supports_path(Memory src_mem, Memory dst_mem,
 				 CustomSerdezID src_serdez_id,
 				 CustomSerdezID dst_serdez_id,
@@ -892,6 +1015,31 @@ namespace Realm {
       virtual long submit(Request** requests, long nr);
 
       bool is_stopped;
+
+    protected:
+      // one helper per numa domain, plus a domain-agnostic one (key -1)
+      std::map<int, MemcpyHelper *> helpers;
+    };
+
+    // fill and reduction channels are not found by path search - FillRequest
+    //  and ReduceRequest create their xfer descriptors directly
+    class FillChannel : public SingleXDQChannel<FillChannel, FillXferDes> {
+    public:
+      FillChannel(BackgroundWorkManager *bgwork);
+      ~FillChannel();
+
+      // multiple concurrent fills ok
+      static const bool is_ordered = false;
+    };
+
+    class ReductionChannel : public SingleXDQChannel<ReductionChannel, ReductionXferDes> {
+    public:
+      ReductionChannel(BackgroundWorkManager *bgwork);
+      ~ReductionChannel();
+
+      // multiple concurrent reductions ok (exclusivity, if needed, is
+      //  provided by the instance lock taken by the ReduceRequest)
+      static const bool is_ordered = false;
     };
 
     class GASNetChannel : public SingleXDQChannel<GASNetChannel, GASNetXferDes> {
@@ -978,14 +1126,14 @@ namespace Realm {
 
       // do as many of these concurrently as we like
       static const bool is_ordered = false;
-      
-      virtual long submit(Request** requests, long nr) { assert(0); return 0; }
     };
   
     class ChannelManager {
     public:
       ChannelManager(void) {
         memcpy_channel = NULL;
+        fill_channel = NULL;
+        reduce_channel = NULL;
         gasnet_read_channel = gasnet_write_channel = NULL;
         remote_write_channel = NULL;
         disk_channel = NULL;
@@ -997,6 +1145,8 @@ namespace Realm {
       }
       ~ChannelManager(void);
       MemcpyChannel* create_memcpy_channel(BackgroundWorkManager *bgwork);
+      FillChannel* create_fill_channel(BackgroundWorkManager *bgwork);
+      ReductionChannel* create_reduce_channel(BackgroundWorkManager *bgwork);
       GASNetChannel* create_gasnet_read_channel(BackgroundWorkManager *bgwork);
       GASNetChannel* create_gasnet_write_channel(BackgroundWorkManager *bgwork);
       RemoteWriteChannel* create_remote_write_channel(BackgroundWorkManager *bgwork);
@@ -1020,6 +1170,12 @@ namespace Realm {
       MemcpyChannel* get_memcpy_channel() {
         return memcpy_channel;
       }
+      FillChannel* get_fill_channel() {
+        return fill_channel;
+      }
+      ReductionChannel* get_reduce_channel() {
+        return reduce_channel;
+      }
       GASNetChannel* get_gasnet_read_channel() {
         return gasnet_read_channel;
       }
@@ -1071,6 +1227,8 @@ namespace Realm {
 #endif
     public:
       MemcpyChannel* memcpy_channel;
+      FillChannel* fill_channel;
+      ReductionChannel* reduce_channel;
       GASNetChannel *gasnet_read_channel, *gasnet_write_channel;
       RemoteWriteChannel* remote_write_channel;
       DiskChannel *disk_channel;
@@ -27,6 +27,9 @@
 
 #if defined(REALM_ON_LINUX) || defined(REALM_ON_MACOS) || defined(REALM_ON_FREEBSD)
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define REALM_USE_FILE_MMAP
 #endif
 
 #ifdef REALM_ON_WINDOWS
@@ -244,6 +247,216 @@ namespace Realm {
       inst->notify_deallocation();
     }
 
+    MappedFileMemory::MappedFileMemory(Memory _me, bool _populate, int _advice)
+      : MemoryImpl(_me, 0 /*no memory space*/, MKIND_MAPPED_FILE,
+		   Memory::FILE_MAPPED_MEM, 0)
+      , populate(_populate)
+      , advice(_advice)
+    {
+    }
+
+    MappedFileMemory::~MappedFileMemory(void)
+    {
+    }
+
+    // an instance's offset is the address of its data, so there's no base
+    //  to add in
+
+    void MappedFileMemory::get_bytes(off_t offset, void *dst, size_t size)
+    {
+      memcpy(dst, reinterpret_cast<const void *>(offset), size);
+    }
+
+    void MappedFileMemory::put_bytes(off_t offset, const void *src, size_t size)
+    {
+      memcpy(reinterpret_cast<void *>(offset), src, size);
+    }
+
+    void *MappedFileMemory::get_direct_ptr(off_t offset, size_t size)
+    {
+      return reinterpret_cast<void *>(offset);
+    }
+
+    /*static*/ bool MappedFileMemory::parse_advice(const std::string& name,
+						   int& advice)
+    {
+#ifdef REALM_USE_FILE_MMAP
+      if(name == "normal") {
+	advice = MADV_NORMAL;
+	return true;
+      }
+      if(name == "sequential") {
+	advice = MADV_SEQUENTIAL;
+	return true;
+      }
+      if(name == "random") {
+	advice = MADV_RANDOM;
+	return true;
+      }
+      if(name == "willneed") {
+	advice = MADV_WILLNEED;
+	return true;
+      }
+#endif
+      return false;
+    }
+
+    MemoryImpl::AllocationResult MappedFileMemory::allocate_storage_immediate(RegionInstanceImpl *inst,
+									      bool need_alloc_result,
+									      bool poisoned,
+									      TimeLimit work_until)
+    {
+      // if the allocation request doesn't include an external file resource,
+      //  we fail it immediately
+      ExternalFileResource *res = dynamic_cast<ExternalFileResource *>(inst->metadata.ext_resource);
+      if(res == 0) {
+	if(inst->metadata.ext_resource)
+	  log_inst.warning() << "attempt to register non-file resource: mem=" << me << " resource=" << *(inst->metadata.ext_resource);
+	else
+	  log_inst.warning() << "attempt to allocate memory in mapped file memory: layout=" << *(inst->metadata.layout);
+	inst->notify_allocation(ALLOC_INSTANT_FAILURE, 0, work_until);
+	return ALLOC_INSTANT_FAILURE;
+      }
+
+      // poisoned preconditions cancel the allocation request
+      if(poisoned) {
+	inst->notify_allocation(ALLOC_CANCELLED, 0, work_until);
+	return ALLOC_CANCELLED;
+      }
+
+#ifdef REALM_USE_FILE_MMAP
+      size_t bytes = inst->metadata.layout->bytes_used;
+      int fd = -1;
+      int prot = PROT_READ;
+      switch(res->mode) {
+      case LEGION_FILE_READ_ONLY:
+	{
+	  fd = open(res->filename.c_str(), O_RDONLY);
+	  prot = PROT_READ;
+	  break;
+	}
+      case LEGION_FILE_READ_WRITE:
+	{
+	  fd = open(res->filename.c_str(), O_RDWR);
+	  prot = PROT_READ | PROT_WRITE;
+	  break;
+	}
+      case LEGION_FILE_CREATE:
+	{
+	  fd = open(res->filename.c_str(), O_CREAT | O_RDWR, 0777);
+	  prot = PROT_READ | PROT_WRITE;
+	  break;
+	}
+      default:
+	assert(0);
+      }
+
+      if(fd == -1) {
+	log_inst.warning() << "could not open file for mapping: resource=" << *res
+			   << " error=" << strerror(errno);
+	inst->notify_allocation(ALLOC_INSTANT_FAILURE, 0, work_until);
+	return ALLOC_INSTANT_FAILURE;
+      }
+
+      // touching a page past the end of a file is a SIGBUS instead of an
+      //  error, so make sure the file covers the whole instance - writable
+      //  files are extended, as they would be by the write-based path
+      struct stat st;
+      if(fstat(fd, &st) != 0) {
+	log_inst.warning() << "could not stat file for mapping: resource=" << *res
+			   << " error=" << strerror(errno);
+	close(fd);
+	inst->notify_allocation(ALLOC_INSTANT_FAILURE, 0, work_until);
+	return ALLOC_INSTANT_FAILURE;
+      }
+      size_t needed = res->offset + bytes;
+      if(size_t(st.st_size) < needed) {
+	if((prot & PROT_WRITE) != 0) {
+	  if(ftruncate(fd, needed) != 0) {
+	    log_inst.warning() << "could not extend file for mapping: resource=" << *res
+			       << " needed=" << needed << " error=" << strerror(errno);
+	    close(fd);
+	    inst->notify_allocation(ALLOC_INSTANT_FAILURE, 0, work_until);
+	    return ALLOC_INSTANT_FAILURE;
+	  }
+	} else {
+	  log_inst.warning() << "file too small for instance: resource=" << *res
+			     << " file_size=" << st.st_size << " needed=" << needed;
+	  close(fd);
+	  inst->notify_allocation(ALLOC_INSTANT_FAILURE, 0, work_until);
+	  return ALLOC_INSTANT_FAILURE;
+	}
+      }
+
+      MappedFileInfo *info = new MappedFileInfo;
+      info->base = 0;
+      info->size = 0;
+      size_t inst_offset = 0;
+      if(bytes > 0) {
+	// mappings must start on a page boundary
+	size_t pagesize = sysconf(_SC_PAGESIZE);
+	size_t map_offset = res->offset - (res->offset % pagesize);
+	size_t map_size = bytes + (res->offset - map_offset);
+	int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+	if(populate)
+	  flags |= MAP_POPULATE;
+#endif
+	void *base = mmap(0, map_size, prot, flags, fd, map_offset);
+	if(base == MAP_FAILED) {
+	  log_inst.warning() << "could not map file: resource=" << *res
+			     << " error=" << strerror(errno);
+	  delete info;
+	  close(fd);
+	  inst->notify_allocation(ALLOC_INSTANT_FAILURE, 0, work_until);
+	  return ALLOC_INSTANT_FAILURE;
+	}
+	if((advice >= 0) && (madvise(base, map_size, advice) != 0))
+	  log_inst.info() << "madvise failed: resource=" << *res
+			  << " error=" << strerror(errno);
+	info->base = base;
+	info->size = map_size;
+	inst_offset = (reinterpret_cast<uintptr_t>(base) +
+		       (res->offset - map_offset));
+      }
+      // the mapping keeps the file referenced
+      close(fd);
+
+      inst->metadata.mem_specific = info;
+
+      AllocationResult result = ALLOC_INSTANT_SUCCESS;
+      inst->notify_allocation(result, inst_offset, work_until);
+
+      return result;
+#else
+      log_inst.warning() << "file mapping not supported on this platform: resource=" << *res;
+      inst->notify_allocation(ALLOC_INSTANT_FAILURE, 0, work_until);
+      return ALLOC_INSTANT_FAILURE;
+#endif
+    }
+
+    // release storage associated with an instance
+    void MappedFileMemory::release_storage_immediate(RegionInstanceImpl *inst,
+						     bool poisoned,
+						     TimeLimit work_until)
+    {
+      // nothing to do for a poisoned release
+      if(poisoned)
+	return;
+
+      MappedFileInfo *info = reinterpret_cast<MappedFileInfo *>(inst->metadata.mem_specific);
+      assert(info != 0);
+#ifdef REALM_USE_FILE_MMAP
+      // dirty pages are written back by the kernel just like those from
+      //  pwrite, so there's no need to msync here
+      if(info->base != 0)
+	munmap(info->base, info->size);
+#endif
+      delete info;
+      inst->metadata.mem_specific = 0;
+
+      inst->notify_deallocation();
+    }
 
 }
 
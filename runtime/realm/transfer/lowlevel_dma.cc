@@ -33,6 +33,16 @@
 #ifdef REALM_USE_LIBAIO
 #include <aio.h>
 #endif
+#ifdef REALM_USE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+// kernel headers can be newer than the C library's syscall table
+#ifndef __NR_io_uring_setup
+#undef REALM_USE_IO_URING
+#endif
+#endif
 
 #ifdef REALM_USE_CUDA
 #include "realm/cuda/cuda_module.h"
@@ -57,6 +67,12 @@ TYPE_IS_SERIALIZABLE(Realm::OffsetsAndSize);
 
 namespace Realm {
 
+  namespace Config {
+    int aio_queue_depth = 1024;
+    bool aio_use_io_uring = true;
+    bool aio_register_buffers = true;
+  };
+
     Logger log_dma("dma");
     Logger log_ib_alloc("ib_alloc");
     //extern Logger log_new_dma;
@@ -111,30 +127,6 @@ namespace Realm {
 
     class DmaRequest;
 
-    class DmaRequestQueue {
-    public:
-      DmaRequestQueue(CoreReservationSet& crs);
-
-      void enqueue_request(DmaRequest *r);
-
-      DmaRequest *dequeue_request(bool sleep = true);
-
-      void shutdown_queue(void);
-
-      void start_workers(int count);
-
-      void worker_thread_loop(void);
-
-    protected:
-      Mutex queue_mutex;
-      CondVar queue_condvar;
-      std::map<int, std::list<DmaRequest *> *> queues;
-      int queue_sleepers;
-      bool shutdown_flag;
-      CoreReservation core_rsrv;
-      std::vector<Thread *> worker_threads;
-    };
-
   ////////////////////////////////////////////////////////////////////////
   //
   // class DmaRequest
@@ -278,103 +270,6 @@ namespace Realm {
       }
     }
 
-    DmaRequestQueue::DmaRequestQueue(CoreReservationSet& crs)
-      : queue_condvar(queue_mutex)
-      , core_rsrv("DMA request queue", crs, CoreReservationParameters())
-    {
-      queue_sleepers = 0;
-      shutdown_flag = false;
-    }
-
-    void DmaRequestQueue::shutdown_queue(void)
-    {
-      queue_mutex.lock();
-
-      assert(queues.empty());
-
-      // set the shutdown flag and wake up any sleepers
-      shutdown_flag = true;
-
-      queue_condvar.broadcast();
-      queue_mutex.unlock();
-
-      // reap all the threads
-      for(std::vector<Thread *>::iterator it = worker_threads.begin();
-	  it != worker_threads.end();
-	  it++) {
-	(*it)->join();
-	delete (*it);
-      }
-      worker_threads.clear();
-    }
-
-    void DmaRequestQueue::enqueue_request(DmaRequest *r)
-    {
-      // Record that it is ready - check for cancellation though
-      bool ok_to_run = r->mark_ready();
-      if(!ok_to_run) {
-	r->mark_finished(false /*!successful*/);
-	return;
-      }
-
-      queue_mutex.lock();
-
-      // there's a queue per priority level
-      // priorities are negated so that the highest logical priority comes first
-      int p = -r->priority;
-      std::map<int, std::list<DmaRequest *> *>::iterator it = queues.find(p);
-      if(it == queues.end()) {
-	// nothing at this priority level - make a new list
-	std::list<DmaRequest *> *l = new std::list<DmaRequest *>;
-	l->push_back(r);
-	queues[p] = l;
-      } else {
-	// push ourselves onto the back of the existing queue
-	it->second->push_back(r);
-      }
-
-      // if anybody was sleeping, wake them up
-      if(queue_sleepers > 0) {
-	queue_sleepers = 0;
-	queue_condvar.broadcast();
-      }
-
-      queue_mutex.unlock();
-    }
-
-    DmaRequest *DmaRequestQueue::dequeue_request(bool sleep /*= true*/)
-    {
-      queue_mutex.lock();
-
-      // quick check - are there any requests at all?
-      while(queues.empty()) {
-	if(!sleep || shutdown_flag) {
-	  queue_mutex.unlock();
-	  return 0;
-	}
-
-	// sleep until there are, or until shutdown
-	queue_sleepers++;
-	queue_condvar.wait();
-      }
-
-      // grab the first request from the highest-priority queue there is
-      // priorities are negated so that the highest logical priority comes first
-      std::map<int, std::list<DmaRequest *> *>::iterator it = queues.begin();
-      assert(!it->second->empty());
-      DmaRequest *r = it->second->front();
-      it->second->pop_front();
-      // if queue is empty, delete from list
-      if(it->second->empty()) {
-	delete it->second;
-	queues.erase(it);
-      }
-
-      queue_mutex.unlock();
-      
-      return r;
-    } 
-
     CopyRequest::CopyRequest(const void *data, size_t datalen,
 			     Event _before_copy,
 			     GenEventImpl *_after_copy, EventImpl::gen_t _after_gen,
@@ -1130,8 +1025,6 @@ namespace Realm {
     }
 
 
-    static atomic<unsigned> rdma_sequence_no(1);
-
     static AsyncFileIOContext *aio_context = 0;
 
 #ifdef REALM_USE_KERNEL_AIO
@@ -1335,6 +1228,393 @@ namespace Realm {
     }
 #endif
 
+#ifdef REALM_USE_IO_URING
+    inline int io_uring_setup(unsigned entries, struct io_uring_params *p)
+    {
+      return syscall(__NR_io_uring_setup, entries, p);
+    }
+
+    inline int io_uring_enter(int fd, unsigned to_submit,
+			      unsigned min_complete, unsigned flags)
+    {
+      return syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+		     flags, NULL, 0);
+    }
+
+    inline int io_uring_register(int fd, unsigned opcode,
+				 const void *arg, unsigned nr_args)
+    {
+      return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+    }
+
+    class IOUringOperation;
+
+    // a thin wrapper around the submission and completion rings - all
+    //  methods except the constructor/destructor must be called while
+    //  holding the AsyncFileIOContext's mutex
+    class IOUring {
+    public:
+      IOUring(void);
+      ~IOUring(void);
+
+      // returns false if the kernel does not support io_uring (or has it
+      //  disabled)
+      bool init(unsigned entries);
+
+      bool register_buffers(const std::vector<std::pair<void *, size_t> >& buffers);
+
+      // returns the index of the registered buffer that contains the
+      //  given range, or -1 if there is none
+      int find_buffer(const void *buffer, size_t bytes) const;
+
+      // returns a zeroed sqe that will be submitted on the next call to
+      //  submit()
+      struct io_uring_sqe *get_sqe(void);
+
+      // hands all queued sqes to the kernel in a single system call
+      void submit(void);
+
+      // processes all available completions, returns the number reaped
+      size_t reap(void);
+
+      // the kernel caps fixed buffers at 1GB, and the length of a single
+      //  read/write is 32 bits, so larger requests are split
+      static const size_t MAX_CHUNK_SIZE = size_t(1) << 30;
+
+    protected:
+      int ring_fd;
+      unsigned sq_entries, cq_entries;
+      void *sq_ring_ptr, *cq_ring_ptr;
+      size_t sq_ring_size, cq_ring_size;
+      struct io_uring_sqe *sqes;
+      unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+      unsigned *cq_head, *cq_tail, *cq_mask;
+      struct io_uring_cqe *cqes;
+      unsigned sqe_tail;   // local copy - only we write the sq tail
+      unsigned to_submit;
+      // registered buffers, sorted by base address
+      std::vector<std::pair<uintptr_t, size_t> > fixed_buffers;
+      std::vector<int> fixed_indices;
+    };
+
+    // recorded against a copy whose file I/O failed, so that the copy
+    //  completes with an error instead of taking down the process
+    class IOUringFailure : public Operation::AsyncWorkItem {
+    public:
+      IOUringFailure(Operation *_op) : Operation::AsyncWorkItem(_op) {}
+      virtual void request_cancellation(void) {}
+      virtual void print(std::ostream& os) const { os << "IOUringFailure"; }
+    };
+
+    class IOUringOperation : public AsyncFileIOContext::AIOOperation {
+    public:
+      IOUringOperation(IOUring *_ring, bool _is_write,
+		       int _fd, size_t _offset, size_t _bytes,
+		       const void *_buffer, Request *request);
+      virtual void launch(void);
+      virtual bool check_completion(void);
+
+      // called when the kernel reports a result for this operation - short
+      //  transfers (and oversized requests) are finished by relaunching,
+      //  reads past the end of the file are zero-filled, and errors fail
+      //  the copy
+      void handle_result(int res);
+
+    protected:
+      void fail_request(int error);
+
+    public:
+      IOUring *ring;
+      bool is_write;
+      int fd;
+      size_t offset, bytes, bytes_done;
+      char *buffer;
+      int buf_index;
+      struct iovec iov;
+    };
+
+    // std::min takes its arguments by reference, so this needs storage
+    /*static*/ const size_t IOUring::MAX_CHUNK_SIZE;
+
+    IOUring::IOUring(void)
+      : ring_fd(-1)
+      , sq_ring_ptr(MAP_FAILED), cq_ring_ptr(MAP_FAILED)
+      , sqes((struct io_uring_sqe *)MAP_FAILED)
+      , sqe_tail(0), to_submit(0)
+    {}
+
+    IOUring::~IOUring(void)
+    {
+      assert(to_submit == 0);
+      if(sqes != MAP_FAILED)
+	munmap(sqes, sq_entries * sizeof(struct io_uring_sqe));
+      if(cq_ring_ptr != MAP_FAILED)
+	munmap(cq_ring_ptr, cq_ring_size);
+      if(sq_ring_ptr != MAP_FAILED)
+	munmap(sq_ring_ptr, sq_ring_size);
+      if(ring_fd >= 0)
+	close(ring_fd);
+    }
+
+    bool IOUring::init(unsigned entries)
+    {
+      struct io_uring_params p;
+      memset(&p, 0, sizeof(p));
+      ring_fd = io_uring_setup(entries, &p);
+      if(ring_fd < 0) {
+	log_aio.info() << "io_uring unavailable: " << strerror(errno);
+	return false;
+      }
+      sq_entries = p.sq_entries;
+      cq_entries = p.cq_entries;
+
+      // map the rings separately - kernels that support a single mapping
+      //  are happy to do it this way too
+      sq_ring_size = p.sq_off.array + (sq_entries * sizeof(unsigned));
+      cq_ring_size = p.cq_off.cqes + (cq_entries * sizeof(struct io_uring_cqe));
+      sq_ring_ptr = mmap(0, sq_ring_size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+      cq_ring_ptr = mmap(0, cq_ring_size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+      sqes = (struct io_uring_sqe *)mmap(0,
+					 sq_entries * sizeof(struct io_uring_sqe),
+					 PROT_READ | PROT_WRITE,
+					 MAP_SHARED | MAP_POPULATE,
+					 ring_fd, IORING_OFF_SQES);
+      if((sq_ring_ptr == MAP_FAILED) || (cq_ring_ptr == MAP_FAILED) ||
+	 (sqes == MAP_FAILED)) {
+	log_aio.info() << "io_uring ring mapping failed: " << strerror(errno);
+	return false;
+      }
+
+      char *sq = (char *)sq_ring_ptr;
+      sq_head = (unsigned *)(sq + p.sq_off.head);
+      sq_tail = (unsigned *)(sq + p.sq_off.tail);
+      sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+      sq_array = (unsigned *)(sq + p.sq_off.array);
+      char *cq = (char *)cq_ring_ptr;
+      cq_head = (unsigned *)(cq + p.cq_off.head);
+      cq_tail = (unsigned *)(cq + p.cq_off.tail);
+      cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+      cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+      sqe_tail = *sq_tail;
+      log_aio.info() << "io_uring enabled: sq_entries=" << sq_entries
+		     << " cq_entries=" << cq_entries;
+      return true;
+    }
+
+    bool IOUring::register_buffers(const std::vector<std::pair<void *, size_t> >& buffers)
+    {
+      assert(fixed_buffers.empty());
+
+      // break buffers into chunks the kernel will accept, and sort them
+      //  so that lookups can binary search
+      std::vector<std::pair<uintptr_t, size_t> > chunks;
+      for(std::vector<std::pair<void *, size_t> >::const_iterator it = buffers.begin();
+	  it != buffers.end();
+	  ++it) {
+	uintptr_t base = reinterpret_cast<uintptr_t>(it->first);
+	size_t left = it->second;
+	while(left > 0) {
+	  size_t chunk = std::min(left, MAX_CHUNK_SIZE);
+	  chunks.push_back(std::make_pair(base, chunk));
+	  base += chunk;
+	  left -= chunk;
+	}
+      }
+      if(chunks.empty())
+	return true;
+      std::sort(chunks.begin(), chunks.end());
+
+      std::vector<struct iovec> iovs(chunks.size());
+      for(size_t i = 0; i < chunks.size(); i++) {
+	iovs[i].iov_base = reinterpret_cast<void *>(chunks[i].first);
+	iovs[i].iov_len = chunks[i].second;
+      }
+      int ret = io_uring_register(ring_fd, IORING_REGISTER_BUFFERS,
+				  &iovs[0], iovs.size());
+      if(ret < 0) {
+	// most often this is RLIMIT_MEMLOCK - unregistered I/O still works
+	log_aio.info() << "io_uring buffer registration failed: "
+		       << strerror(errno);
+	return false;
+      }
+
+      fixed_buffers.swap(chunks);
+      fixed_indices.resize(fixed_buffers.size());
+      for(size_t i = 0; i < fixed_indices.size(); i++)
+	fixed_indices[i] = i;
+      log_aio.info() << "io_uring registered " << fixed_buffers.size()
+		     << " fixed buffers";
+      return true;
+    }
+
+    int IOUring::find_buffer(const void *buffer, size_t bytes) const
+    {
+      if(fixed_buffers.empty())
+	return -1;
+      uintptr_t addr = reinterpret_cast<uintptr_t>(buffer);
+      // find the last chunk starting at or below the address
+      std::vector<std::pair<uintptr_t, size_t> >::const_iterator it =
+	std::upper_bound(fixed_buffers.begin(), fixed_buffers.end(),
+			 std::make_pair(addr, ~size_t(0)));
+      if(it == fixed_buffers.begin())
+	return -1;
+      --it;
+      if((addr + bytes) > (it->first + it->second))
+	return -1;
+      return fixed_indices[it - fixed_buffers.begin()];
+    }
+
+    struct io_uring_sqe *IOUring::get_sqe(void)
+    {
+      unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+      // the context never has more operations in flight than there are
+      //  entries in the ring
+      assert((sqe_tail - head) < sq_entries);
+      unsigned idx = sqe_tail & *sq_mask;
+      struct io_uring_sqe *sqe = &sqes[idx];
+      memset(sqe, 0, sizeof(*sqe));
+      sq_array[idx] = idx;
+      sqe_tail++;
+      to_submit++;
+      return sqe;
+    }
+
+    void IOUring::submit(void)
+    {
+      if(to_submit == 0)
+	return;
+      // publish the new entries before the kernel looks at them
+      __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+      int ret = io_uring_enter(ring_fd, to_submit, 0, 0);
+      if(ret < 0) {
+	// EAGAIN/EBUSY mean the kernel is temporarily out of resources -
+	//  the entries stay in the ring and we'll try again on the next poll
+	if((errno == EAGAIN) || (errno == EBUSY) || (errno == EINTR))
+	  return;
+	log_aio.fatal() << "io_uring_enter failed: " << strerror(errno);
+	abort();
+      }
+      log_aio.debug() << "io_uring submitted " << ret << " of " << to_submit;
+      assert((unsigned)ret <= to_submit);
+      to_submit -= ret;
+    }
+
+    size_t IOUring::reap(void)
+    {
+      unsigned head = *cq_head;
+      unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+      size_t count = 0;
+      while(head != tail) {
+	const struct io_uring_cqe *cqe = &cqes[head & *cq_mask];
+	IOUringOperation *op = reinterpret_cast<IOUringOperation *>(cqe->user_data);
+	int res = cqe->res;
+	head++;
+	count++;
+	// release the slot before the op possibly relaunches itself
+	__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+	op->handle_result(res);
+      }
+      return count;
+    }
+
+    IOUringOperation::IOUringOperation(IOUring *_ring, bool _is_write,
+				       int _fd, size_t _offset, size_t _bytes,
+				       const void *_buffer, Request *request)
+      : ring(_ring), is_write(_is_write), fd(_fd)
+      , offset(_offset), bytes(_bytes), bytes_done(0)
+      , buffer((char *)_buffer)
+    {
+      completed = false;
+      req = request;
+      buf_index = ring->find_buffer(buffer, bytes);
+    }
+
+    void IOUringOperation::launch(void)
+    {
+      size_t chunk = std::min(bytes - bytes_done, IOUring::MAX_CHUNK_SIZE);
+      struct io_uring_sqe *sqe = ring->get_sqe();
+      sqe->fd = fd;
+      sqe->off = offset + bytes_done;
+      sqe->user_data = reinterpret_cast<uintptr_t>(this);
+      if(buf_index >= 0) {
+	sqe->opcode = (is_write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED);
+	sqe->addr = reinterpret_cast<uintptr_t>(buffer + bytes_done);
+	sqe->len = chunk;
+	sqe->buf_index = buf_index;
+      } else {
+	// the vectored forms are supported by every kernel with io_uring
+	iov.iov_base = buffer + bytes_done;
+	iov.iov_len = chunk;
+	sqe->opcode = (is_write ? IORING_OP_WRITEV : IORING_OP_READV);
+	sqe->addr = reinterpret_cast<uintptr_t>(&iov);
+	sqe->len = 1;
+      }
+      log_aio.debug("%s queued: op=%p off=%zd bytes=%zd fixed=%d",
+		    (is_write ? "write" : "read"), this,
+		    offset + bytes_done, chunk, buf_index);
+    }
+
+    bool IOUringOperation::check_completion(void)
+    {
+      return completed;
+    }
+
+    void IOUringOperation::handle_result(int res)
+    {
+      log_aio.debug("%s returned: op=%p res=%d",
+		    (is_write ? "write" : "read"), this, res);
+      if(res == -EINTR || res == -EAGAIN) {
+	launch();
+	return;
+      }
+      if(res < 0) {
+	fail_request(-res);
+	return;
+      }
+      if(res == 0) {
+	if(is_write) {
+	  // a write that makes no progress will never finish
+	  fail_request(EIO);
+	  return;
+	}
+	// files opened read-only or read-write are not extended to the size
+	//  of the instance (only newly created ones are), so a read past the
+	//  end of the file sees zeros
+	memset(buffer + bytes_done, 0, bytes - bytes_done);
+	bytes_done = bytes;
+	completed = true;
+	return;
+      }
+      bytes_done += res;
+      assert(bytes_done <= bytes);
+      if(bytes_done < bytes)
+	launch();
+      else
+	completed = true;
+    }
+
+    void IOUringOperation::fail_request(int error)
+    {
+      log_aio.error() << (is_write ? "write" : "read")
+		      << " failed: fd=" << fd << " offset=" << (offset + bytes_done)
+		      << " error=" << strerror(error);
+      if(req) {
+	// poisons the copy's completion event - the request is still
+	//  reported as done so that the rest of the transfer drains
+	DmaRequest *dma_request = static_cast<Request *>(req)->xd->dma_request;
+	IOUringFailure *failure = new IOUringFailure(dma_request);
+	dma_request->add_async_work_item(failure);
+	failure->mark_finished(false /*!successful*/);
+      }
+      if(!is_write)
+	memset(buffer + bytes_done, 0, bytes - bytes_done);
+      completed = true;
+    }
+#endif
+
     class AIOFence : public Operation::AsyncWorkItem {
     public:
       AIOFence(Operation *_op) : Operation::AsyncWorkItem(_op) {}
@@ -1378,7 +1658,19 @@ namespace Realm {
     AsyncFileIOContext::AsyncFileIOContext(int _max_depth)
       : BackgroundWorkItem("async file IO")
       , max_depth(_max_depth)
-    {
+      , uring(0)
+    {
+#ifdef REALM_USE_IO_URING
+      // kernels older than 5.4 reject rings larger than 4096 entries
+      if(Config::aio_use_io_uring) {
+	IOUring *ring = new IOUring;
+	if(ring->init(std::min(max_depth, 4096))) {
+	  uring = ring;
+	  max_depth = std::min(max_depth, 4096);
+	} else
+	  delete ring;
+      }
+#endif
 #ifdef REALM_USE_KERNEL_AIO
       aio_ctx = 0;
 #ifndef NDEBUG
@@ -1393,6 +1685,9 @@ namespace Realm {
     {
       assert(pending_operations.empty());
       assert(launched_operations.empty());
+#ifdef REALM_USE_IO_URING
+      delete uring;
+#endif
 #ifdef REALM_USE_KERNEL_AIO
 #ifndef NDEBUG
       int ret =
@@ -1402,19 +1697,25 @@ namespace Realm {
 #endif
     }
 
-    void AsyncFileIOContext::enqueue_write(int fd, size_t offset, 
-					   size_t bytes, const void *buffer,
-                                           Request* req)
+    bool AsyncFileIOContext::register_buffers(const std::vector<std::pair<void *, size_t> >& buffers)
     {
-#ifdef REALM_USE_KERNEL_AIO
-      KernelAIOWrite *op = new KernelAIOWrite(aio_ctx,
-					      fd, offset, bytes, buffer, req);
-#elif defined(REALM_USE_LIBAIO)
-      PosixAIOWrite *op = new PosixAIOWrite(fd, offset, bytes, buffer, req);
-#else
-      AsyncFileIOContext::AIOOperation* op = 0;
-      assert(0);
+#ifdef REALM_USE_IO_URING
+      if(uring) {
+	AutoLock<> al(mutex);
+	assert(launched_operations.empty() && pending_operations.empty());
+	return uring->register_buffers(buffers);
+      }
 #endif
+      return false;
+    }
+
+    bool AsyncFileIOContext::using_io_uring(void) const
+    {
+      return (uring != 0);
+    }
+
+    void AsyncFileIOContext::enqueue_operation(AIOOperation *op)
+    {
       bool was_empty;
       {
 	AutoLock<> al(mutex);
@@ -1426,14 +1727,46 @@ namespace Realm {
 	  pending_operations.push_back(op);
 	}
       }
+      // with io_uring, launching just fills in a queue entry - the actual
+      //  submission is batched up in do_work
       if(was_empty)
 	make_active();
     }
 
+    void AsyncFileIOContext::enqueue_write(int fd, size_t offset, 
+					   size_t bytes, const void *buffer,
+                                           Request* req)
+    {
+#ifdef REALM_USE_IO_URING
+      if(uring) {
+	enqueue_operation(new IOUringOperation(uring, true /*write*/,
+					       fd, offset, bytes, buffer, req));
+	return;
+      }
+#endif
+#ifdef REALM_USE_KERNEL_AIO
+      KernelAIOWrite *op = new KernelAIOWrite(aio_ctx,
+					      fd, offset, bytes, buffer, req);
+#elif defined(REALM_USE_LIBAIO)
+      PosixAIOWrite *op = new PosixAIOWrite(fd, offset, bytes, buffer, req);
+#else
+      AsyncFileIOContext::AIOOperation* op = 0;
+      assert(0);
+#endif
+      enqueue_operation(op);
+    }
+
     void AsyncFileIOContext::enqueue_read(int fd, size_t offset, 
 					  size_t bytes, void *buffer,
                                           Request* req)
     {
+#ifdef REALM_USE_IO_URING
+      if(uring) {
+	enqueue_operation(new IOUringOperation(uring, false /*!write*/,
+					       fd, offset, bytes, buffer, req));
+	return;
+      }
+#endif
 #ifdef REALM_USE_KERNEL_AIO
       KernelAIORead *op = new KernelAIORead(aio_ctx,
 					    fd, offset, bytes, buffer, req);
@@ -1443,37 +1776,13 @@ namespace Realm {
       AsyncFileIOContext::AIOOperation* op = 0;
       assert(0);
 #endif
-      bool was_empty;
-      {
-	AutoLock<> al(mutex);
-	was_empty = launched_operations.empty();
-	if(launched_operations.size() < (size_t)max_depth) {
-	  op->launch();
-	  launched_operations.push_back(op);
-	} else {
-	  pending_operations.push_back(op);
-	}
-      }
-      if(was_empty)
-	make_active();
+      enqueue_operation(op);
     }
 
     void AsyncFileIOContext::enqueue_fence(DmaRequest *req)
     {
       AIOFenceOp *op = new AIOFenceOp(req);
-      bool was_empty;
-      {
-	AutoLock<> al(mutex);
-	was_empty = launched_operations.empty();
-	if(launched_operations.size() < (size_t)max_depth) {
-	  op->launch();
-	  launched_operations.push_back(op);
-	} else {
-	  pending_operations.push_back(op);
-	}
-      }
-      if(was_empty)
-	make_active();
+      enqueue_operation(op);
     }
 
     bool AsyncFileIOContext::empty(void)
@@ -1509,6 +1818,12 @@ namespace Realm {
 	}
       }
 #endif
+#ifdef REALM_USE_IO_URING
+      if(uring) {
+	uring->reap();
+	uring->submit();
+      }
+#endif
 
       // now actually mark events completed in oldest-first order
       while(!launched_operations.empty()) {
@@ -1534,6 +1849,10 @@ namespace Realm {
 	op->launch();
 	launched_operations.push_back(op);
       }
+#ifdef REALM_USE_IO_URING
+      if(uring)
+	uring->submit();
+#endif
     }
 
     void AsyncFileIOContext::do_work(TimeLimit work_until)
@@ -1541,7 +1860,7 @@ namespace Realm {
       // first, reap as many events as we can - oldest first
 #ifdef REALM_USE_KERNEL_AIO
       assert(!launched_operations.empty());
-      while {
+      do {
 	struct io_event events[8];
 	struct timespec ts;
 	ts.tv_sec = 0;
@@ -1565,6 +1884,16 @@ namespace Realm {
       {
 	AutoLock<> al(mutex);
 
+#ifdef REALM_USE_IO_URING
+	// submit everything queued since the last poll in one system call,
+	//  then pick up whatever has finished (resubmitting short transfers)
+	if(uring) {
+	  uring->submit();
+	  uring->reap();
+	  uring->submit();
+	}
+#endif
+
 	// now actually mark events completed in oldest-first order
 	while(!work_until.is_expired()) {
 	  AIOOperation *op = launched_operations.front();
@@ -1600,6 +1929,10 @@ namespace Realm {
 	  op->launch();
 	  launched_operations.push_back(op);
 	}
+#ifdef REALM_USE_IO_URING
+	if(uring)
+	  uring->submit();
+#endif
       }
 
       // if we fall through to here, there's still polling for either old
@@ -1660,7 +1993,7 @@ namespace Realm {
     {
       return (kind == Memory::REGDMA_MEM || kind == Memory::LEVEL3_CACHE || kind == Memory::LEVEL2_CACHE
               || kind == Memory::LEVEL1_CACHE || kind == Memory::SYSTEM_MEM || kind == Memory::SOCKET_MEM
-              || kind == Memory::Z_COPY_MEM);
+              || kind == Memory::Z_COPY_MEM || kind == Memory::FILE_MAPPED_MEM);
     }
 
     XferDesKind old_get_xfer_des(Memory src_mem, Memory dst_mem,
@@ -1687,6 +2020,7 @@ namespace Realm {
         case Memory::SYSTEM_MEM:
         case Memory::SOCKET_MEM:
         case Memory::Z_COPY_MEM:
+        case Memory::FILE_MAPPED_MEM:
           if (is_cpu_mem(dst_ll_kind)) {
 	    // can't serdez to yourself yet
 	    if((src_serdez_id != 0) && (dst_serdez_id != 0))
@@ -2331,6 +2665,28 @@ namespace Realm {
       Operation::mark_completed();
     }
 
+  ////////////////////////////////////////////////////////////////////////
+  //
+  // reductions and fills are each performed by a single xd that reads
+  //  and/or writes instances directly
+  //
+
+    static void init_inst_port_info(XferDesPortInfo& info,
+				    RegionInstance inst,
+				    TransferIterator *iter)
+    {
+      info.port_type = XferDesPortInfo::DATA_PORT;
+      info.peer_guid = XferDes::XFERDES_NO_GUID;
+      info.peer_port_idx = 0;
+      info.indirect_port_idx = -1;
+      info.mem = inst.get_location();
+      info.inst = inst;
+      info.iter = iter;
+      info.serdez_id = 0;
+      info.ib_offset = 0;
+      info.ib_size = 0;
+    }
+
     ReduceRequest::ReduceRequest(const void *data, size_t datalen,
 				 ReductionOpID _redop_id,
 				 bool _red_fold,
@@ -2340,8 +2696,7 @@ namespace Realm {
       : DmaRequest(_priority, _after_copy, _after_gen),
 	inst_lock_event(Event::NO_EVENT),
 	redop_id(_redop_id), red_fold(_red_fold),
-	before_copy(_before_copy),
-	dma_queue(0)
+	before_copy(_before_copy)
     {
       Serialization::FixedBufferDeserializer deserializer(data, datalen);
 
@@ -2379,8 +2734,7 @@ namespace Realm {
 	dst(_dst), 
 	inst_lock_needed(_inst_lock_needed), inst_lock_event(Event::NO_EVENT),
 	redop_id(_redop_id), red_fold(_red_fold),
-	before_copy(_before_copy),
-	dma_queue(0)
+	before_copy(_before_copy)
     {
       srcs.insert(srcs.end(), _srcs.begin(), _srcs.end());
 
@@ -2396,6 +2750,10 @@ namespace Realm {
 
     ReduceRequest::~ReduceRequest(void)
     {
+      for(std::vector<XferDesID>::const_iterator it = xd_guids.begin();
+	  it != xd_guids.end();
+	  ++it)
+	destroy_xfer_des(*it);
       delete domain;
     }
 
@@ -2430,11 +2788,6 @@ namespace Realm {
       clear_profiling();
     }
 
-    void ReduceRequest::set_dma_queue(DmaRequestQueue *queue)
-    {
-      dma_queue = queue;
-    }
-
     bool ReduceRequest::check_readiness(void)
     {
       if(state == STATE_INIT)
@@ -2533,25 +2886,17 @@ namespace Realm {
 	log_dma.debug("request %p ready", this);
 
 	state = STATE_QUEUED;
-#ifdef REDUCE_IN_NEW_DMA
-	// <NEWDMA>
-	mark_ready();
-	bool ok_to_run = mark_started();
-	if (ok_to_run) {
+
+	// the actual work is handed off to an xd on the background work
+	//  managers, so it's fine to do this inline
+	bool ok_to_run = mark_ready();
+	if(ok_to_run)
+	  ok_to_run = mark_started();
+	if(ok_to_run) {
 	  perform_dma();
 	  mark_finished(true/*successful*/);
-	} else {
+	} else
 	  mark_finished(false/*!successful*/);
-	}
-	return true;
-	// </NEWDMA>
-#endif
-	assert(dma_queue != 0);
-	log_dma.debug("request %p enqueued", this);
-
-	// once we're enqueued, we may be deleted at any time, so no more
-	//  references
-	dma_queue->enqueue_request(this);
 	return true;
       }
 
@@ -2562,6 +2907,16 @@ namespace Realm {
       return false;
     }
 
+    // fills and reductions are split so that each dedicated background
+    //  worker can take a piece, but no piece is smaller than a single
+    //  max-sized request
+    static size_t max_split_pieces(size_t bytes)
+    {
+      const size_t MIN_PIECE_BYTES = 16 << 20;
+      size_t workers = get_runtime()->bgwork.get_num_dedicated_workers();
+      return std::min(bytes / MIN_PIECE_BYTES, workers);
+    }
+
     void ReduceRequest::perform_dma(void)
     {
       log_dma.debug("request %p executing", this);
@@ -2571,153 +2926,57 @@ namespace Realm {
       // code assumes a single source field for now
       assert(srcs.size() == 1);
 
-      MemoryImpl *src_mem = get_runtime()->get_memory_impl(srcs[0].inst);
-      MemoryImpl *dst_mem = get_runtime()->get_memory_impl(dst.inst);
-
-      bool dst_is_remote = ((dst_mem->kind == MemoryImpl::MKIND_REMOTE) ||
-			    (dst_mem->kind == MemoryImpl::MKIND_RDMA));
-      unsigned rdma_sequence_id = (dst_is_remote ?
-				     rdma_sequence_no.fetch_add(1) :
-				     0);
-      unsigned rdma_count = 0;
-
       std::vector<FieldID> src_field(1, srcs[0].field_id);
       std::vector<FieldID> dst_field(1, dst.field_id);
       std::vector<size_t> src_field_offset(1, srcs[0].subfield_offset);
       std::vector<size_t> dst_field_offset(1, dst.subfield_offset);
       std::vector<size_t> src_field_size(1, srcs[0].size);
       std::vector<size_t> dst_field_size(1, dst.size);
-      TransferIterator *src_iter = domain->create_iterator(srcs[0].inst,
-							   dst.inst,
-							   src_field,
-							   src_field_offset,
-							   src_field_size);
-      TransferIterator *dst_iter = domain->create_iterator(dst.inst,
-							   srcs[0].inst,
-							   dst_field,
-							   dst_field_offset,
-							   dst_field_size);
-
-      const ReductionOpUntyped *redop = get_runtime()->reduce_op_table.get(redop_id, 0);
-      if(redop == 0) {
-	log_dma.fatal() << "no reduction op registered for ID " << redop_id;
-	abort();
-      }
-      size_t src_elem_size = red_fold ? redop->sizeof_rhs : redop->sizeof_lhs;
-
-      size_t total_bytes = 0;
-
-      void *src_scratch_buffer = 0;
-      void *dst_scratch_buffer = 0;
-      size_t src_scratch_size = 0;
-      size_t dst_scratch_size = 0;
-
-      while(!src_iter->done()) {
-	TransferIterator::AddressInfo src_info, dst_info;
-
-	size_t max_bytes = (size_t)-1;
-	size_t src_bytes = src_iter->step(max_bytes, src_info, 0,
-					  true /*tentative*/);
-	assert(src_bytes > 0);
-	size_t num_elems = src_bytes / src_elem_size;
-	size_t exp_dst_bytes = num_elems * redop->sizeof_rhs;
-	size_t dst_bytes = dst_iter->step(exp_dst_bytes, dst_info, 0);
-	if(dst_bytes == exp_dst_bytes) {
-	  // good, confirm the source step
-	  src_iter->confirm_step();
-	} else {
-	  // bad, cancel the source step and try a smaller one
-	  src_iter->cancel_step();
-	  num_elems = dst_bytes / redop->sizeof_rhs;
-	  size_t exp_src_bytes = num_elems * src_elem_size;
-	  src_bytes = src_iter->step(exp_src_bytes, src_info, 0);
-	  assert(src_bytes == exp_src_bytes);
-	}
-
-	total_bytes += dst_bytes;
-
-	// can we directly access the source data?
-	const void *src_ptr = src_mem->get_direct_ptr(src_info.base_offset,
-						      src_info.bytes_per_chunk);
-	if((src_ptr == 0) || (src_mem->kind == MemoryImpl::MKIND_GPUFB)) {
-	  // nope, make a local copy via get_bytes
-	  if(src_info.bytes_per_chunk > src_scratch_size) {
-	    if(src_scratch_size > 0)
-	      free(src_scratch_buffer);
-	    // allocate 2x in case the next block is a little bigger
-	    src_scratch_size = src_info.bytes_per_chunk * 2;
-	    src_scratch_buffer = malloc(src_scratch_size);
-	  }
-	  src_mem->get_bytes(src_info.base_offset,
-			     src_scratch_buffer,
-			     src_info.bytes_per_chunk);
-	  src_ptr = src_scratch_buffer;
-	}
 
-	// now look at destination and deal with two fast cases
-	  
-	// case 1: destination is remote (quickest to check)
-	if(dst_is_remote) {
-	  // have to tell rdma to make a copy if we're using the temp buffer
-	  bool make_copy = (src_ptr == src_scratch_buffer);
-	  rdma_count += do_remote_reduce(dst_mem->me,
-					 dst_info.base_offset,
-					 redop_id, red_fold,
-					 src_ptr, num_elems,
-					 src_elem_size, redop->sizeof_rhs,
-					 rdma_sequence_id,
-					 make_copy);
-	} else {
-	  // case 2: destination is directly accessible
-	  void *dst_ptr = dst_mem->get_direct_ptr(dst_info.base_offset,
-						  dst_info.bytes_per_chunk);
-	  if(dst_ptr && (dst_mem->kind != MemoryImpl::MKIND_GPUFB)) {
-	    if(red_fold)
-	      redop->fold(dst_ptr, src_ptr, num_elems, false /*!excl*/);
-	    else
-	      redop->apply(dst_ptr, src_ptr, num_elems, false /*!excl*/);
-	  } else {
-	    // case 3: fallback - use get_bytes/put_bytes combo
-
-	    // need a buffer for destination data
-	    if(dst_info.bytes_per_chunk > dst_scratch_size) {
-	      if(dst_scratch_size > 0)
-		free(dst_scratch_buffer);
-	      // allocate 2x in case the next block is a little bigger
-	      dst_scratch_size = dst_info.bytes_per_chunk * 2;
-	      dst_scratch_buffer = malloc(dst_scratch_size);
-	    }
-	    dst_mem->get_bytes(dst_info.base_offset,
-			       dst_scratch_buffer,
-			       dst_info.bytes_per_chunk);
-	    if(red_fold)
-	      redop->fold(dst_scratch_buffer, src_ptr, num_elems, true/*excl*/);
-	    else
-	      redop->apply(dst_scratch_buffer, src_ptr, num_elems, true/*excl*/);
-	    dst_mem->put_bytes(dst_info.base_offset,
-			       dst_scratch_buffer,
-			       dst_info.bytes_per_chunk);
-	  }
-	}
-      }
-      assert(dst_iter->done());
-
-      delete src_iter;
-      delete dst_iter;
+      // large reductions are broken into several xds that the background
+      //  workers can progress in parallel
+      std::vector<TransferDomain *> pieces;
+      size_t max_pieces = max_split_pieces(domain->volume() * dst.size);
+      if((max_pieces < 2) || !domain->split(max_pieces, pieces))
+	pieces.push_back(domain->clone());
+
+      // all the fences must be added before any xd can complete
+      std::vector<XferDesFence *> fences(pieces.size());
+      for(size_t i = 0; i < pieces.size(); i++) {
+	fences[i] = new XferDesFence(this);
+	add_async_work_item(fences[i]);
+      }
+
+      for(size_t i = 0; i < pieces.size(); i++) {
+	std::vector<XferDesPortInfo> inputs_info(1);
+	init_inst_port_info(inputs_info[0], srcs[0].inst,
+			    pieces[i]->create_iterator(srcs[0].inst,
+						       dst.inst,
+						       src_field,
+						       src_field_offset,
+						       src_field_size));
+
+	std::vector<XferDesPortInfo> outputs_info(1);
+	init_inst_port_info(outputs_info[0], dst.inst,
+			    pieces[i]->create_iterator(dst.inst,
+						       srcs[0].inst,
+						       dst_field,
+						       dst_field_offset,
+						       dst_field_size));
+	delete pieces[i];
 
-      if(src_scratch_size > 0)
-	free(src_scratch_buffer);
-      if(dst_scratch_size > 0)
-	free(dst_scratch_buffer);
+	XferDesID xd_guid = get_xdq_singleton()->get_guid(Network::my_node_id);
+	xd_guids.push_back(xd_guid);
 
-      // if we did any actual reductions, send a fence, otherwise trigger here
-      if(rdma_count > 0) {
-	RemoteWriteFence *fence = new RemoteWriteFence(this);
-	this->add_async_work_item(fence);
-	do_remote_fence(dst_mem->me, rdma_sequence_id, rdma_count, fence);
+	XferDes *xd = new ReductionXferDes(this, Network::my_node_id, xd_guid,
+					   inputs_info, outputs_info,
+					   false /*!mark_started*/,
+					   16 * 1024 * 1024/*max_req_size*/,
+					   100/*max_nr*/,
+					   priority, fences[i],
+					   redop_id, red_fold);
+	xd->channel->enqueue_ready_xd(xd);
       }
-
-      //printf("kinds: " IDFMT "=%d " IDFMT "=%d\n", src_mem.id, src_mem.impl()->kind, dst_mem.id, dst_mem.impl()->kind);
     }
 
     void ReduceRequest::mark_completed(void)
@@ -2737,7 +2996,6 @@ namespace Realm {
                              int _priority)
       : DmaRequest(_priority, _after_fill, _after_gen)
       , before_fill(_before_fill)
-      , dma_queue(0)
     {
       dst.inst = inst;
       dst.field_id = field_id;
@@ -2775,7 +3033,6 @@ namespace Realm {
       , domain(_domain->clone())
       , dst(_dst)
       , before_fill(_before_fill)
-      , dma_queue(0)
     {
       fill_size = _fill_size;
       fill_buffer = malloc(fill_size);
@@ -2799,6 +3056,10 @@ namespace Realm {
 
     FillRequest::~FillRequest(void)
     {
+      for(std::vector<XferDesID>::const_iterator it = xd_guids.begin();
+	  it != xd_guids.end();
+	  ++it)
+	destroy_xfer_des(*it);
       // clean up our mess
       free(fill_buffer);
       delete domain;
@@ -2832,11 +3093,6 @@ namespace Realm {
       clear_profiling();
     }
 
-    void FillRequest::set_dma_queue(DmaRequestQueue *queue)
-    {
-      dma_queue = queue;
-    }
-
     bool FillRequest::check_readiness(void)
     {
       if(state == STATE_INIT)
@@ -2899,25 +3155,17 @@ namespace Realm {
 	log_dma.debug("request %p ready", this);
 
 	state = STATE_QUEUED;
-#ifdef FILL_IN_NEW_DMA
-	// <NEWDMA>
-	mark_ready();
-	bool ok_to_run = mark_started();
-	if (ok_to_run) {
+
+	// the actual work is handed off to an xd on the background work
+	//  managers, so it's fine to do this inline
+	bool ok_to_run = mark_ready();
+	if(ok_to_run)
+	  ok_to_run = mark_started();
+	if(ok_to_run) {
 	  perform_dma();
 	  mark_finished(true/*successful*/);
-	} else {
+	} else
 	  mark_finished(false/*!successful*/);
-	}
-	return true;
-	// </NEWDMA>
-#endif
-	assert(dma_queue != 0);
-	log_dma.debug("request %p enqueued", this);
-
-	// once we're enqueued, we may be deleted at any time, so no more
-	//  references
-	dma_queue->enqueue_request(this);
 	return true;
       }
 
@@ -2928,268 +3176,53 @@ namespace Realm {
       return false;
     }
 
-    static void repeat_fill(void *dst, const void *src, size_t bytes, size_t count)
-    {
-#define SPECIALIZE_FILL(TYPE, N)                                        \
-      {									\
-	TYPE *dsttyped = reinterpret_cast<TYPE *>(dst);			\
-	const TYPE *srctyped = reinterpret_cast<const TYPE *>(src);	\
-	for(size_t i = 0; i < count; i++)				\
-	  for(size_t j = 0; j < N; j++)					\
-	    *dsttyped++ = srctyped[j];					\
-      }
-
-      switch(bytes) {
-      case sizeof(uint32_t):
-	{
-	  SPECIALIZE_FILL(uint32_t, 1);
-	  break;
-	}
-      case sizeof(uint64_t):
-	{
-	  SPECIALIZE_FILL(uint64_t, 1);
-	  break;
-	}
-      case 2 * sizeof(uint64_t):
-	{
-	  SPECIALIZE_FILL(uint64_t, 2);
-	  break;
-	}
-      case 4 * sizeof(uint64_t):
-	{
-	  SPECIALIZE_FILL(uint64_t, 4);
-	  break;
-	}
-      default:
-	{
-	  for(size_t i = 0; i < count; i++)
-	    memcpy(reinterpret_cast<char *>(dst) + (bytes * i), src, bytes);
-	  break;
-	}
-      }
-
-#undef SPECIALIZE_FILL
-    }
-
     void FillRequest::perform_dma(void)
     {
-      // if we are doing large chunks of data, we will build a buffer with
-      //  multiple copies of the same data to make fewer calls to put_bytes
-      void *rep_buffer = 0;
-      size_t rep_size = 0;
+      log_dma.debug("request %p executing", this);
 
-      MemoryImpl *mem_impl = get_runtime()->get_memory_impl(dst.inst.get_location());
+      DetailedTimer::ScopedPush sp(TIME_COPY);
 
       std::vector<FieldID> dst_field(1, dst.field_id);
       std::vector<size_t> dst_field_offset(1, dst.subfield_offset);
       std::vector<size_t> dst_field_size(1, dst.size);
-      TransferIterator *iter = domain->create_iterator(dst.inst,
+
+      // large fills are broken into several xds that the background
+      //  workers can progress in parallel
+      std::vector<TransferDomain *> pieces;
+      size_t max_pieces = max_split_pieces(domain->volume() * dst.size);
+      if((max_pieces < 2) || !domain->split(max_pieces, pieces))
+	pieces.push_back(domain->clone());
+
+      // all the fences must be added before any xd can complete
+      std::vector<XferDesFence *> fences(pieces.size());
+      for(size_t i = 0; i < pieces.size(); i++) {
+	fences[i] = new XferDesFence(this);
+	add_async_work_item(fences[i]);
+      }
+
+      for(size_t i = 0; i < pieces.size(); i++) {
+	std::vector<XferDesPortInfo> inputs_info;
+	std::vector<XferDesPortInfo> outputs_info(1);
+	init_inst_port_info(outputs_info[0], dst.inst,
+			    pieces[i]->create_iterator(dst.inst,
 						       RegionInstance::NO_INST,
 						       dst_field,
 						       dst_field_offset,
-						       dst_field_size);
-#ifdef REALM_USE_CUDA
-      // fills to GPU FB memory are offloaded to the GPU itself
-      if (mem_impl->lowlevel_kind == Memory::GPU_FB_MEM) {
-	Cuda::GPU *gpu = static_cast<Cuda::GPUFBMemory *>(mem_impl)->gpu;
-	size_t total_bytes = 0;
-	while(!iter->done()) {
-	  TransferIterator::AddressInfo info;
-
-	  size_t max_bytes = (size_t)-1;
-	  unsigned flags = (TransferIterator::LINES_OK |
-			    TransferIterator::PLANES_OK);
-	  size_t act_bytes = iter->step(max_bytes, info, flags);
-	  assert(act_bytes >= 0);
-	  total_bytes += act_bytes;
-
-	  if(info.num_planes == 1) {
-	    if(info.num_lines == 1) {
-	      gpu->fill_within_fb(info.base_offset, info.bytes_per_chunk,
-				  fill_buffer, fill_size);
-	    } else {
-	      gpu->fill_within_fb_2d(info.base_offset, info.line_stride,
-				     info.bytes_per_chunk, info.num_lines,
-				     fill_buffer, fill_size);
-	    }
-	  } else {
-	    gpu->fill_within_fb_3d(info.base_offset, info.line_stride,
-				   info.plane_stride,
-				   info.bytes_per_chunk, info.num_lines,
-				   info.num_planes,
-				   fill_buffer, fill_size);
-	  }
-	}
-
-	// if we did any asynchronous operations, insert a fence
-	if(total_bytes > 0)
-	  gpu->fence_within_fb(this);
-
-	// fall through so the clean-up is the same
-      }
-#endif
-
-#ifdef REALM_USE_HDF5
-      // fills of an HDF5 instance are also handled specially
-      if (mem_impl->lowlevel_kind == Memory::HDF_MEM) {
-	hid_t file_id = -1;
-	hid_t dset_id = -1;
-	hid_t dtype_id = -1;
-	const std::string *prev_filename = 0;
-	const std::string *prev_dsetname = 0;
-	while(!iter->done()) {
-	  TransferIterator::AddressInfoHDF5 info;
-	  size_t act_bytes = iter->step_hdf5(size_t(-1), // max_bytes
-					     info);
-	  assert(act_bytes >= 0);
-
-	  // compare the pointers, not the string contents...
-	  if(info.filename != prev_filename) {
-	    // close dataset too
-	    if(dset_id != -1) {
-	      CHECK_HDF5( H5Tclose(dtype_id) );
-	      CHECK_HDF5( H5Dclose(dset_id) );
-	      prev_dsetname = 0;
-	    }
-	    if(file_id != -1)
-	      CHECK_HDF5( H5Fclose(file_id) );
-
-	    CHECK_HDF5( file_id = H5Fopen(info.filename->c_str(),
-					  H5F_ACC_RDWR, H5P_DEFAULT) );
-	    prev_filename = info.filename;
-	  }
-
-	  if(info.dsetname != prev_dsetname) {
-	    if(dset_id != -1) {
-	      CHECK_HDF5( H5Tclose(dtype_id) );
-	      CHECK_HDF5( H5Dclose(dset_id) );
-	    }
-	    CHECK_HDF5( dset_id = H5Dopen2(file_id, info.dsetname->c_str(),
-					   H5P_DEFAULT) );
-	    CHECK_HDF5( dtype_id = H5Dget_type(dset_id) );
-	    size_t dtype_size = H5Tget_size(dtype_id);
-	    assert(dtype_size == fill_size);
-	    prev_dsetname = info.dsetname;
-	  }
-
-	  // HDF5 doesn't seem to offer a way to fill a file without building
-	  //  an equivalently-sized memory buffer first, and we can't do
-          //  point-wise because libhdf5 doesn't buffer, so try to find a 
-	  //  reasonably-sized chunk to do fills with - this code is still
-	  //  limited to each dimension being all-or-nothing
-	  int dims = info.extent.size();
-	  size_t max_chunk_elems = (32 << 20) / fill_size; // 32MB
-	  size_t chunk_elems = 1;
-	  // because HDF5 uses C data ordering, we need to group from the last
-	  //  dim backwards
-	  int step_dims = dims;
-	  while(step_dims > 0) {
-	    size_t new_elems = chunk_elems * info.extent[step_dims - 1];
-	    if(new_elems > max_chunk_elems) break;
-	    chunk_elems = new_elems;
-	    step_dims--;
-	  }
-	  void *chunk_data = fill_buffer;
-	  if(chunk_elems > 1) {
-	    chunk_data = malloc(chunk_elems * fill_size);
-	    assert(chunk_data != 0);
-	    repeat_fill(chunk_data, fill_buffer, fill_size, chunk_elems);
-	  }
-	  std::vector<hsize_t> mem_dims(dims, 1);
-	  for(int i = step_dims; i < dims; i++)
-	    mem_dims[i] = info.extent[i];
-	  hid_t mem_space_id, file_space_id;
-	  CHECK_HDF5( mem_space_id = H5Screate_simple(dims, mem_dims.data(),
-						      NULL) );
-	  CHECK_HDF5( file_space_id = H5Dget_space(dset_id) );
-
-	  std::vector<hsize_t> cur_pos(info.offset);
-	  std::vector<hsize_t> cur_size = mem_dims;
-	  while(true) {
-	    CHECK_HDF5( H5Sselect_hyperslab(file_space_id, H5S_SELECT_SET,
-					    cur_pos.data(), 0,
-					    cur_size.data(), 0) );
-	    CHECK_HDF5( H5Dwrite(dset_id, dtype_id,
-				 mem_space_id, file_space_id,
-				 H5P_DEFAULT, chunk_data) );
-	    // advance to next position
-	    int d = 0;
-	    while(d < step_dims) {
-	      if(++cur_pos[d] < (info.offset[d] + info.extent[d]))
-		break;
-	      cur_pos[d] = info.offset[d];
-	      d++;
-	    }
-	    if(d >= step_dims) break;
-	  }
+						       dst_field_size));
+	delete pieces[i];
 
-	  if(chunk_data != fill_buffer)
-	    free(chunk_data);
+	XferDesID xd_guid = get_xdq_singleton()->get_guid(Network::my_node_id);
+	xd_guids.push_back(xd_guid);
 
-	  CHECK_HDF5( H5Sclose(mem_space_id) );
-	  CHECK_HDF5( H5Sclose(file_space_id) );
-	}
-
-	// close the last dset and file we touched
-	if(dset_id != -1) {
-	  CHECK_HDF5( H5Tclose(dtype_id) );
-	  CHECK_HDF5( H5Dclose(dset_id) );
-	}
-	if(file_id != -1)
-	  CHECK_HDF5( H5Fclose(file_id) );
+	XferDes *xd = new FillXferDes(this, Network::my_node_id, xd_guid,
+				      inputs_info, outputs_info,
+				      false /*!mark_started*/,
+				      16 * 1024 * 1024/*max_req_size*/,
+				      100/*max_nr*/,
+				      priority, fences[i],
+				      fill_buffer, fill_size);
+	xd->channel->enqueue_ready_xd(xd);
       }
-#endif
-
-      while(!iter->done()) {
-	TransferIterator::AddressInfo info;
-
-	size_t max_bytes = (size_t)-1;
-	// code below is 2D/3D-capable
-	unsigned flags = (TransferIterator::LINES_OK |
-			  TransferIterator::PLANES_OK);
-	size_t act_bytes = iter->step(max_bytes, info, flags);
-	assert(act_bytes > 0);
-
-	// decide whether to use the original fill buffer or one that
-	//  repeats the data several times
-	const void *use_buffer = fill_buffer;
-	size_t use_size = fill_size;
-	const size_t MAX_REP_SIZE = 32768;
-	if((info.bytes_per_chunk > fill_size) &&
-	   ((fill_size * 2) <= MAX_REP_SIZE)) {
-	  if(!rep_buffer) {
-	    size_t rep_elems = MAX_REP_SIZE / fill_size;
-	    rep_size = rep_elems * fill_size;
-	    rep_buffer = malloc(rep_size);
-	    assert(rep_buffer != 0);
-	    repeat_fill(rep_buffer, fill_buffer, fill_size, rep_elems);
-	  }
-	  use_buffer = rep_buffer;
-	  use_size = rep_size;
-	}
-
-	for(size_t p = 0; p < info.num_planes; p++)
-	  for(size_t l = 0; l < info.num_lines; l++) {
-	    size_t ofs = 0;
-	    while((ofs + use_size) < info.bytes_per_chunk) {
-	      mem_impl->put_bytes(info.base_offset + 
-				  (p * info.plane_stride) +
-				  (l * info.line_stride) +
-				  ofs, use_buffer, use_size);
-	      ofs += use_size;
-	    }
-	    size_t bytes_left = info.bytes_per_chunk - ofs;
-	    assert((bytes_left > 0) && (bytes_left <= use_size));
-	    mem_impl->put_bytes(info.base_offset + 
-				(p * info.plane_stride) +
-				(l * info.line_stride) +
-				ofs, use_buffer, bytes_left);
-	  }
-      }
-
-      if(rep_buffer)
-	free(rep_buffer);
-      delete iter;
     }
 
     void FillRequest::mark_completed(void)
@@ -3409,69 +3442,29 @@ namespace Realm {
       }
   }
 
-    // for now we use a single queue for all (local) dmas
-    DmaRequestQueue *dma_queue = 0;
-    
-    void DmaRequestQueue::worker_thread_loop(void)
-    {
-      log_dma.info("dma worker thread created");
-
-      while(!shutdown_flag) {
-	//aio_context->make_progress();
-	//bool aio_idle = aio_context->empty();
-	bool aio_idle = true;  // not polling here anymore
-
-	// get a request, sleeping as necessary
-	DmaRequest *r = dequeue_request(aio_idle);
-
-	if(r) {
-          bool ok_to_run = r->mark_started();
-	  if(ok_to_run) {
-	    // this will automatically add any necessary AsyncWorkItem's
-	    r->perform_dma();
-
-	    r->mark_finished(true /*successful*/);
-	  } else
-	    r->mark_finished(false /*!successful*/);
-	}
-      }
-
-      log_dma.info("dma worker thread terminating");
-    }
-
-    void DmaRequestQueue::start_workers(int count)
-    {
-      ThreadLaunchParameters tlp;
-
-      for(int i = 0; i < count; i++) {
-	Thread *t = Thread::create_kernel_thread<DmaRequestQueue,
-						 &DmaRequestQueue::worker_thread_loop>(this,
-										       tlp,
-										       core_rsrv,
-										       0 /* default scheduler*/);
-	worker_threads.push_back(t);
-      }
-    }
-    
-    void start_dma_worker_threads(int count, CoreReservationSet& crs)
-    {
-      dma_queue = new DmaRequestQueue(crs);
-      dma_queue->start_workers(count);
-    }
-
-    void stop_dma_worker_threads(void)
-    {
-      dma_queue->shutdown_queue();
-      delete dma_queue;
-      dma_queue = 0;
-    }
-
     void start_dma_system(int count, bool pinned, int max_nr,
                           CoreReservationSet& crs,
 			  BackgroundWorkManager *bgwork)
     {
       //log_dma.add_stream(&std::cerr, Logger::LEVEL_DEBUG, false, false);
-      aio_context = new AsyncFileIOContext(256);
+      aio_context = new AsyncFileIOContext(Config::aio_queue_depth);
+      if(Config::aio_register_buffers && aio_context->using_io_uring()) {
+	// only memories that are already pinned are registered - registering
+	//  pageable system memory would pin (and fault in) all of it
+	std::vector<std::pair<void *, size_t> > buffers;
+	const std::vector<MemoryImpl *>& local_mems = get_runtime()->nodes[Network::my_node_id].memories;
+	for(std::vector<MemoryImpl *>::const_iterator it = local_mems.begin();
+	    it != local_mems.end();
+	    ++it) {
+	  if(((*it)->lowlevel_kind != Memory::REGDMA_MEM) &&
+	     ((*it)->lowlevel_kind != Memory::Z_COPY_MEM))
+	    continue;
+	  void *base = (*it)->get_direct_ptr(0, (*it)->size);
+	  if(base && ((*it)->size > 0))
+	    buffers.push_back(std::make_pair(base, (*it)->size));
+	}
+	aio_context->register_buffers(buffers);
+      }
       aio_context->add_to_manager(bgwork);
       start_channel_manager(bgwork);
       ib_req_queue = new PendingIBQueue();
@@ -3518,7 +3511,6 @@ namespace Realm {
 					     args.priority);
 	get_runtime()->optable.add_local_operation(args.after_copy, r);
 
-	r->set_dma_queue(dma_queue);
 	r->check_readiness();
       }
     }
@@ -3537,7 +3529,6 @@ namespace Realm {
                                        0 /* no room for args.priority */);
       get_runtime()->optable.add_local_operation(args.after_fill, r);
 
-      r->set_dma_queue(dma_queue);
       r->check_readiness();
     }
 
@@ -28,6 +28,15 @@
 namespace Realm {
   class CoreReservationSet;
 
+  namespace Config {
+    // maximum number of asynchronous file I/O operations in flight
+    extern int aio_queue_depth;
+    // use io_uring for file I/O if the kernel supports it
+    extern bool aio_use_io_uring;
+    // register pinned CPU memories with io_uring as fixed buffers
+    extern bool aio_register_buffers;
+  };
+
     struct RemoteIBAllocRequestAsync {
       Memory memory;
       void *req;
@@ -84,9 +93,6 @@ namespace Realm {
 
     extern void init_dma_handler(void);
 
-    extern void start_dma_worker_threads(int count, Realm::CoreReservationSet& crs);
-    extern void stop_dma_worker_threads(void);
-
     extern void start_dma_system(int count, bool pinned, int max_nr,
 				 CoreReservationSet& crs,
 				 BackgroundWorkManager *bgwork);
@@ -103,10 +109,6 @@ namespace Realm {
 			     Event after_copy = Event::NO_EVENT);
     */
     
-    class DmaRequestQueue;
-    // for now we use a single queue for all legacy fills/reduces
-    extern DmaRequestQueue *dma_queue;
-
     // include files are all tangled up, so some XferDes stuff here...  :(
     typedef unsigned long long XferDesID;
     class XferDesFactory;
@@ -128,7 +130,9 @@ namespace Realm {
       XFER_HDF5_WRITE,
       XFER_FILE_READ,
       XFER_FILE_WRITE,
-      XFER_ADDR_SPLIT
+      XFER_ADDR_SPLIT,
+      XFER_FILL,
+      XFER_REDUCE
     };
 
     struct MemPathInfo {
@@ -421,10 +425,10 @@ namespace Realm {
     public:
       void forward_request(NodeID target_node);
 
-      void set_dma_queue(DmaRequestQueue *queue);
-
       virtual bool check_readiness(void);
 
+      // creates a ReductionXferDes on the local reduction channel - the
+      //  actual work is done by the background workers
       virtual void perform_dma(void);
 
       virtual bool handler_safe(void) { return(false); }
@@ -439,7 +443,7 @@ namespace Realm {
       bool red_fold;
       Event before_copy;
       Waiter waiter; // if we need to wait on events
-      DmaRequestQueue *dma_queue;
+      std::vector<XferDesID> xd_guids;
     };
 
     class FillRequest : public DmaRequest {
@@ -467,17 +471,14 @@ namespace Realm {
     public:
       void forward_request(NodeID target_node);
 
-      void set_dma_queue(DmaRequestQueue *queue);
-
       virtual bool check_readiness(void);
 
+      // creates a FillXferDes on the local fill channel - the actual work
+      //  is done by the background workers
       virtual void perform_dma(void);
 
       virtual bool handler_safe(void) { return(false); }
 
-      template<int DIM>
-      void perform_dma_rect(MemoryImpl *mem_impl);
-
       TransferDomain *domain;
       //Domain domain;
       CopySrcDstField dst;
@@ -485,7 +486,7 @@ namespace Realm {
       size_t fill_size;
       Event before_fill;
       Waiter waiter;
-      DmaRequestQueue *dma_queue;
+      std::vector<XferDesID> xd_guids;
     };
 
     // each DMA "channel" implements one of these to describe (implicitly) which copies it
@@ -558,6 +559,8 @@ namespace Realm {
     virtual bool handler_safe(void) { return(false); }
   };
 
+    class IOUring;
+
     class AsyncFileIOContext : public BackgroundWorkItem {
     public:
       AsyncFileIOContext(int _max_depth);
@@ -570,6 +573,15 @@ namespace Realm {
       bool empty(void);
       long available(void);
 
+      // tells the kernel about memory that will be the source or target of
+      //  file I/O so it can be pinned once up front (io_uring only) - must
+      //  be called before any I/O is enqueued, returns false if the
+      //  buffers could not be registered (I/O still works, just slower)
+      bool register_buffers(const std::vector<std::pair<void *, size_t> >& buffers);
+
+      // returns true if the io_uring backend is in use
+      bool using_io_uring(void) const;
+
       static AsyncFileIOContext* get_singleton(void);
 
       virtual void do_work(TimeLimit work_until);
@@ -585,6 +597,7 @@ namespace Realm {
 
     protected:
       void make_progress(void);
+      void enqueue_operation(AIOOperation *op);
 
       int max_depth;
       std::deque<AIOOperation *> launched_operations, pending_operations;
@@ -592,6 +605,8 @@ namespace Realm {
 #ifdef REALM_USE_KERNEL_AIO
       aio_context_t aio_ctx;
 #endif
+      // non-null if the io_uring backend was selected at startup
+      IOUring *uring;
     };
 
 };
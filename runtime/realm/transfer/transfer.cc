@@ -1376,6 +1376,9 @@ namespace Realm {
 
     virtual size_t volume(void) const;
 
+    virtual bool split(size_t max_pieces,
+		       std::vector<TransferDomain *>& pieces) const;
+
     virtual TransferIterator *create_iterator(RegionInstance inst,
 					      RegionInstance peer,
 					      const std::vector<FieldID>& fields,
@@ -1430,6 +1433,39 @@ namespace Realm {
     return is.volume();
   }
 
+  template <int N, typename T>
+  bool TransferDomainIndexSpace<N,T>::split(size_t max_pieces,
+					    std::vector<TransferDomain *>& pieces) const
+  {
+    if(is.bounds.empty())
+      return false;
+
+    // slice along the slowest-varying (in fortran order) dimension that
+    //  has more than one point so that each piece stays contiguous in the
+    //  common layouts - the sparsity map (if any) is shared by all pieces
+    int dim = N - 1;
+    while((dim > 0) && (is.bounds.hi[dim] == is.bounds.lo[dim]))
+      dim--;
+    size_t extent = size_t(is.bounds.hi[dim] - is.bounds.lo[dim]) + 1;
+    size_t count = std::min(max_pieces, extent);
+    if(count < 2)
+      return false;
+
+    // the first 'extent % count' pieces get one extra slice
+    size_t base = extent / count;
+    size_t extra = extent % count;
+    T lo = is.bounds.lo[dim];
+    for(size_t i = 0; i < count; i++) {
+      Rect<N,T> r = is.bounds;
+      r.lo[dim] = lo;
+      r.hi[dim] = lo + T(base + ((i < extra) ? 1 : 0) - 1);
+      if((i + 1) < count)
+	lo = r.hi[dim] + 1;
+      pieces.push_back(new TransferDomainIndexSpace<N,T>(IndexSpace<N,T>(r, is.sparsity)));
+    }
+    return true;
+  }
+
   template <int N, typename T>
   TransferIterator *TransferDomainIndexSpace<N,T>::create_iterator(RegionInstance inst,
 								   RegionInstance peer,
@@ -2977,7 +3013,6 @@ namespace Realm {
       log_dma.debug("performing reduction on local node");
 
       get_runtime()->optable.add_local_operation(ev, r);
-      r->set_dma_queue(dma_queue);
       r->check_readiness();
     } else {
       r->forward_request(src_node);
@@ -3042,7 +3077,6 @@ namespace Realm {
     NodeID tgt_node = ID(inst).instance_owner_node();
     if(tgt_node == Network::my_node_id) {
       get_runtime()->optable.add_local_operation(ev, r);
-      r->set_dma_queue(dma_queue);
       r->check_readiness();
     } else {
       r->forward_request(tgt_node);
@@ -136,6 +136,12 @@ namespace Realm {
 
     virtual size_t volume(void) const = 0;
 
+    // breaks the domain into at most 'max_pieces' disjoint domains that
+    //  together cover it - returns false (with 'pieces' untouched) if the
+    //  domain can't be usefully split
+    virtual bool split(size_t max_pieces,
+		       std::vector<TransferDomain *>& pieces) const = 0;
+
     virtual TransferIterator *create_iterator(RegionInstance inst,
 					      RegionInstance peer,
 					      const std::vector<FieldID>& fields,
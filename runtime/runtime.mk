@@ -626,6 +626,11 @@ ifneq ($(findstring mpi,$(REALM_NETWORKS)),)
     USE_MPI = 1
 endif
 
+# Realm can also use shared memory between processes on a single host
+ifneq ($(findstring shm,$(REALM_NETWORKS)),)
+    REALM_CC_FLAGS        += -DREALM_USE_SHM
+endif
+
 # Realm doesn't use HDF by default
 USE_HDF ?= 0
 HDF_LIBNAME ?= hdf5
@@ -822,6 +827,9 @@ ifneq ($(findstring mpi,$(REALM_NETWORKS)),)
 REALM_SRC 	+= $(LG_RT_DIR)/realm/mpi/mpi_module.cc \
                    $(LG_RT_DIR)/realm/mpi/am_mpi.cc
 endif
+ifneq ($(findstring shm,$(REALM_NETWORKS)),)
+REALM_SRC 	+= $(LG_RT_DIR)/realm/shm/shm_module.cc
+endif
 ifeq ($(strip $(USE_OPENMP)),1)
 REALM_SRC 	+= $(LG_RT_DIR)/realm/openmp/openmp_module.cc \
 		   $(LG_RT_DIR)/realm/openmp/openmp_threadpool.cc \
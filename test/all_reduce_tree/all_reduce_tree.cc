@@ -0,0 +1,272 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Reduces future maps whose points are spread round-robin over every
+//  node with a reduction that composes affine maps, which is not
+//  commutative: a non-deterministic reduction (folded up the tree of
+//  address spaces) of maps that share a fixed point, and so commute, must
+//  still come out exact, and a deterministic reduction of maps that don't
+//  commute must match the fold in point order - then every point reads
+//  the tree's result as a future argument to check the value that was
+//  broadcast to its node
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <vector>
+
+#include "legion.h"
+#include "default_mapper.h"
+
+using namespace Legion;
+using namespace Legion::Mapping;
+
+enum TaskIDs {
+  TID_TOP_LEVEL,
+  TID_MAKE_AFFINE,
+  TID_CHECK_RESULT,
+};
+
+enum {
+  REDOP_AFFINE = 101,
+};
+
+// x -> a * x + b, modulo 2^64
+struct Affine {
+  uint64_t a, b;
+};
+
+class AffineCompose {
+public:
+  typedef Affine LHS;
+  typedef Affine RHS;
+  static const Affine identity;
+
+  template <bool EXCLUSIVE> static void apply(LHS &lhs, RHS rhs)
+    { compose(lhs, rhs); }
+  template <bool EXCLUSIVE> static void fold(RHS &rhs1, RHS rhs2)
+    { compose(rhs1, rhs2); }
+
+  // lhs becomes "lhs, then rhs"
+  static void compose(Affine &lhs, const Affine &rhs)
+  {
+    const uint64_t a = rhs.a * lhs.a;
+    const uint64_t b = rhs.a * lhs.b + rhs.b;
+    lhs.a = a;
+    lhs.b = b;
+  }
+};
+
+const Affine AffineCompose::identity = { 1, 0 };
+
+// every commuting map has this fixed point
+static const uint64_t FIXED_POINT = 0x9e3779b97f4a7c15ULL;
+
+static Affine make_affine(uint64_t point, bool commuting)
+{
+  Affine f;
+  f.a = 2 * point + 3;
+  f.b = commuting ? (FIXED_POINT - f.a * FIXED_POINT) : (point + 1);
+  return f;
+}
+
+// puts each point on the next processor of the whole machine so that
+//  every node holds some of the futures
+class RoundRobinMapper : public DefaultMapper {
+public:
+  RoundRobinMapper(MapperRuntime *rt, Machine machine, Processor local)
+    : DefaultMapper(rt, machine, local, "round_robin_mapper") { }
+public:
+  virtual void slice_task(const MapperContext ctx,
+                          const Task& task,
+                          const SliceTaskInput& input,
+                                SliceTaskOutput& output)
+  {
+    std::vector<Processor> procs;
+    Machine::ProcessorQuery query(machine);
+    query.only_kind(Processor::LOC_PROC);
+    for (Machine::ProcessorQuery::iterator it = query.begin();
+          it != query.end(); it++)
+      procs.push_back(*it);
+    assert(!procs.empty());
+    const Rect<1> bounds = input.domain;
+    for (PointInRectIterator<1> pir(bounds); pir(); pir++)
+      output.slices.push_back(TaskSlice(Domain(Rect<1>(*pir, *pir)),
+            procs[(*pir)[0] % procs.size()], false/*recurse*/,
+            false/*stealable*/));
+  }
+};
+
+void mapper_registration(Machine machine, Runtime *rt,
+                         const std::set<Processor> &local_procs)
+{
+  for (std::set<Processor>::const_iterator it = local_procs.begin();
+        it != local_procs.end(); it++)
+    rt->replace_default_mapper(
+        new RoundRobinMapper(rt->get_mapper_runtime(), machine, *it), *it);
+}
+
+Affine make_affine_task(const Task *task,
+                        const std::vector<PhysicalRegion> &regions,
+                        Context ctx, Runtime *runtime)
+{
+  assert(task->arglen == sizeof(bool));
+  const bool commuting = *static_cast<const bool*>(task->args);
+  return make_affine(task->index_point[0], commuting);
+}
+
+// returns the address space it ran in, or -1 if the future was wrong
+int check_result_task(const Task *task,
+                      const std::vector<PhysicalRegion> &regions,
+                      Context ctx, Runtime *runtime)
+{
+  assert(task->arglen == sizeof(Affine));
+  assert(task->futures.size() == 1);
+  const Affine &expected = *static_cast<const Affine*>(task->args);
+  const Affine actual = task->futures[0].get_result<Affine>();
+  if ((actual.a != expected.a) || (actual.b != expected.b))
+    return -1;
+  return runtime->get_executing_processor(ctx).address_space();
+}
+
+static int check_value(const char *name, const Affine &actual,
+                       const Affine &expected)
+{
+  if ((actual.a == expected.a) && (actual.b == expected.b))
+    return 0;
+  printf("ERROR: %s reduction = (%llx, %llx), expected (%llx, %llx)\n",
+         name, (unsigned long long)actual.a, (unsigned long long)actual.b,
+         (unsigned long long)expected.a, (unsigned long long)expected.b);
+  return 1;
+}
+
+void top_level_task(const Task *task,
+                    const std::vector<PhysicalRegion> &regions,
+                    Context ctx, Runtime *runtime)
+{
+  int num_points = 96;
+  {
+    const InputArgs &command_args = Runtime::get_input_args();
+    for (int i = 1; i < command_args.argc; i++)
+      if (!strcmp(command_args.argv[i],"-n"))
+        num_points = atoi(command_args.argv[++i]);
+  }
+
+  std::set<AddressSpace> spaces;
+  {
+    Machine::ProcessorQuery query(Machine::get_machine());
+    query.only_kind(Processor::LOC_PROC);
+    for (Machine::ProcessorQuery::iterator it = query.begin();
+          it != query.end(); it++)
+      spaces.insert((*it).address_space());
+  }
+  printf("reducing %d points over %zd address spaces\n",
+         num_points, spaces.size());
+  if (spaces.size() == 1)
+    printf("WARNING: only one address space, the tree is not used\n");
+
+  const Rect<1> bounds(0, num_points - 1);
+  Affine tree_expected = AffineCompose::identity;
+  Affine serial_expected = AffineCompose::identity;
+  for (int i = 0; i < num_points; i++)
+  {
+    AffineCompose::compose(tree_expected, make_affine(i, true/*commuting*/));
+    AffineCompose::compose(serial_expected,
+                           make_affine(i, false/*commuting*/));
+  }
+
+  bool commuting = true;
+  IndexTaskLauncher tree_launcher(TID_MAKE_AFFINE, bounds,
+      TaskArgument(&commuting, sizeof(commuting)), ArgumentMap());
+  const FutureMap tree_map = runtime->execute_index_space(ctx, tree_launcher);
+  const Future tree = runtime->reduce_future_map(ctx, tree_map, REDOP_AFFINE,
+                                                 false/*deterministic*/);
+
+  commuting = false;
+  IndexTaskLauncher serial_launcher(TID_MAKE_AFFINE, bounds,
+      TaskArgument(&commuting, sizeof(commuting)), ArgumentMap());
+  const FutureMap serial_map =
+    runtime->execute_index_space(ctx, serial_launcher);
+  const Future serial = runtime->reduce_future_map(ctx, serial_map,
+                                        REDOP_AFFINE, true/*deterministic*/);
+
+  // every point waits on the tree's result where it runs
+  IndexTaskLauncher check_launcher(TID_CHECK_RESULT, bounds,
+      TaskArgument(&tree_expected, sizeof(tree_expected)), ArgumentMap());
+  check_launcher.add_future(tree);
+  const FutureMap checks = runtime->execute_index_space(ctx, check_launcher);
+
+  int errors = 0;
+  errors += check_value("tree", tree.get_result<Affine>(), tree_expected);
+  errors += check_value("deterministic", serial.get_result<Affine>(),
+                        serial_expected);
+
+  std::set<int> check_spaces;
+  for (PointInRectIterator<1> pir(bounds); pir(); pir++)
+  {
+    const int space = checks.get_result<int>(*pir);
+    if (space < 0)
+    {
+      if (errors++ < 10)
+        printf("ERROR: point %lld read the wrong reduction result\n",
+               (long long)(*pir)[0]);
+    }
+    else
+      check_spaces.insert(space);
+  }
+  // the result has to have reached every node, not just the owner
+  if (check_spaces.size() != spaces.size())
+  {
+    printf("ERROR: checked the result in %zd of %zd address spaces\n",
+           check_spaces.size(), spaces.size());
+    errors++;
+  }
+
+  if (errors > 0)
+  {
+    printf("FAILED: %d errors\n", errors);
+    exit(1);
+  }
+  printf("SUCCESS\n");
+}
+
+int main(int argc, char **argv)
+{
+  {
+    TaskVariantRegistrar registrar(TID_TOP_LEVEL, "top_level");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    Runtime::preregister_task_variant<top_level_task>(registrar, "top_level");
+    Runtime::set_top_level_task_id(TID_TOP_LEVEL);
+  }
+  {
+    TaskVariantRegistrar registrar(TID_MAKE_AFFINE, "make_affine");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    Runtime::preregister_task_variant<Affine,make_affine_task>(registrar,
+                                                               "make_affine");
+  }
+  {
+    TaskVariantRegistrar registrar(TID_CHECK_RESULT, "check_result");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    Runtime::preregister_task_variant<int,check_result_task>(registrar,
+                                                             "check_result");
+  }
+  Runtime::register_reduction_op<AffineCompose>(REDOP_AFFINE);
+  Runtime::add_registration_callback(mapper_registration);
+  return Runtime::start(argc, argv);
+}
@@ -17,6 +17,7 @@
 #include <cstdio>
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
 #include <math.h>
 #include "legion.h"
 
@@ -40,8 +41,20 @@ void top_level_task(const Task *task,
    char input_file[64];
   //sprintf(input_file, "/scratch/sdb1_ext4/input.dat");
   sprintf(input_file, "input.dat");
+  int num_elements = 1024;
+  int num_reps = 2;
 
-  Rect<1> rect_A(0,1023);
+  const InputArgs &command_args = Runtime::get_input_args();
+  for (int i = 1; i < command_args.argc; i++) {
+    if (!strcmp(command_args.argv[i], "-n"))
+      num_elements = atoi(command_args.argv[++i]);
+    if (!strcmp(command_args.argv[i], "-r"))
+      num_reps = atoi(command_args.argv[++i]);
+    if (!strcmp(command_args.argv[i], "-f"))
+      snprintf(input_file, sizeof(input_file), "%s", command_args.argv[++i]);
+  }
+
+  Rect<1> rect_A(0,num_elements-1);
   IndexSpace is_A = runtime->create_index_space(ctx, rect_A);
   FieldSpace fs_A = runtime->create_field_space(ctx);
   {
@@ -62,7 +75,8 @@ void top_level_task(const Task *task,
   PhysicalRegion pr_A;
   std::vector<FieldID> field_vec;
   field_vec.push_back(FID_X);
-  for(int reps = 0; reps < 2; reps++) {
+  for(int reps = 0; reps < num_reps; reps++) {
+    double ts_start = Realm::Clock::current_time_in_microseconds();
     AttachLauncher alr(EXTERNAL_POSIX_FILE, lr_A, lr_A);
     alr.attach_file(input_file, field_vec, LEGION_FILE_CREATE);
     pr_A = runtime->attach_external_resource(ctx, alr);
@@ -72,7 +86,13 @@ void top_level_task(const Task *task,
 			      RegionRequirement(lr_A, READ_WRITE, EXCLUSIVE, lr_A).add_field(FID_X));
     runtime->issue_copy_operation(ctx, clr);
 
-    runtime->detach_external_resource(ctx, pr_A);
+    Future f = runtime->detach_external_resource(ctx, pr_A);
+    f.get_void_result(true /*silence warnings*/);
+    double ts_end = Realm::Clock::current_time_in_microseconds();
+    double elapsed = 1e-6 * (ts_end - ts_start);
+    printf("rep %d: wrote %zd bytes in %7.3f s = %7.3f GB/s\n",
+           reps, num_elements * sizeof(double), elapsed,
+           1e-9 * num_elements * sizeof(double) / elapsed);
   }
   runtime->destroy_logical_region(ctx, lr_A);
   runtime->destroy_field_space(ctx, fs_A);
@@ -0,0 +1,230 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Repeats a loop whose body contains a fill with a different future
+//  value every iteration alongside operations that can be traced, so
+//  that automatic tracing (run with -lg:auto_trace) picks up the loop
+//  and the results show whether each iteration used its own fill value -
+//  the mapper also counts memoization requests and calls to map the
+//  accumulate task to check that a trace was recorded and then replayed
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "legion.h"
+#include "default_mapper.h"
+
+using namespace Legion;
+using namespace Legion::Mapping;
+
+enum TaskIDs {
+  TID_TOP_LEVEL,
+  TID_MAKE_VALUE,
+  TID_ACCUMULATE,
+};
+
+enum FieldIDs {
+  FID_VALUE = 11,
+  FID_ONE = 12,
+  FID_SUM = 13,
+};
+
+static std::atomic<int> memoize_calls(0);
+static std::atomic<int> accumulate_maps(0);
+
+class AutoTraceMapper : public DefaultMapper {
+public:
+  AutoTraceMapper(MapperRuntime *rt, Machine machine, Processor local)
+    : DefaultMapper(rt, machine, local, "auto_trace_mapper") { }
+public:
+  virtual void map_task(const MapperContext ctx,
+                        const Task& task,
+                        const MapTaskInput& input,
+                              MapTaskOutput& output)
+  {
+    if (task.task_id == TID_ACCUMULATE)
+      accumulate_maps++;
+    DefaultMapper::map_task(ctx, task, input, output);
+  }
+  virtual void memoize_operation(const MapperContext ctx,
+                                 const Mappable& mappable,
+                                 const MemoizeInput& input,
+                                       MemoizeOutput& output)
+  {
+    memoize_calls++;
+    output.memoize = true;
+  }
+};
+
+void mapper_registration(Machine machine, Runtime *rt,
+                         const std::set<Processor> &local_procs)
+{
+  for (std::set<Processor>::const_iterator it = local_procs.begin();
+        it != local_procs.end(); it++)
+    rt->replace_default_mapper(
+        new AutoTraceMapper(rt->get_mapper_runtime(), machine, *it), *it);
+}
+
+double make_value_task(const Task *task,
+                       const std::vector<PhysicalRegion> &regions,
+                       Context ctx, Runtime *runtime)
+{
+  assert(task->arglen == sizeof(int));
+  return 1 + *static_cast<const int*>(task->args);
+}
+
+void accumulate_task(const Task *task,
+                     const std::vector<PhysicalRegion> &regions,
+                     Context ctx, Runtime *runtime)
+{
+  const FieldAccessor<LEGION_READ_ONLY,double,1,coord_t,
+        Realm::AffineAccessor<double,1,coord_t> > value(regions[0], FID_VALUE);
+  const FieldAccessor<LEGION_READ_ONLY,double,1,coord_t,
+        Realm::AffineAccessor<double,1,coord_t> > one(regions[0], FID_ONE);
+  const FieldAccessor<LEGION_READ_WRITE,double,1,coord_t,
+        Realm::AffineAccessor<double,1,coord_t> > sum(regions[1], FID_SUM);
+  Rect<1> bounds = runtime->get_index_space_domain(ctx,
+      task->regions[1].region.get_index_space());
+  for (PointInRectIterator<1> pir(bounds); pir(); pir++)
+    sum[*pir] = sum[*pir] + value[*pir] + one[*pir];
+}
+
+void top_level_task(const Task *task,
+                    const std::vector<PhysicalRegion> &regions,
+                    Context ctx, Runtime *runtime)
+{
+  int num_elements = 1024;
+  int num_iterations = 20;
+  {
+    const InputArgs &command_args = Runtime::get_input_args();
+    for (int i = 1; i < command_args.argc; i++)
+    {
+      if (!strcmp(command_args.argv[i],"-n"))
+        num_elements = atoi(command_args.argv[++i]);
+      if (!strcmp(command_args.argv[i],"-i"))
+        num_iterations = atoi(command_args.argv[++i]);
+    }
+  }
+
+  Rect<1> bounds(0, num_elements-1);
+  IndexSpace is = runtime->create_index_space(ctx, bounds);
+  FieldSpace fs = runtime->create_field_space(ctx);
+  {
+    FieldAllocator fsa = runtime->create_field_allocator(ctx, fs);
+    fsa.allocate_field(sizeof(double), FID_VALUE);
+    fsa.allocate_field(sizeof(double), FID_ONE);
+    fsa.allocate_field(sizeof(double), FID_SUM);
+  }
+  LogicalRegion tmp = runtime->create_logical_region(ctx, is, fs);
+  LogicalRegion acc = runtime->create_logical_region(ctx, is, fs);
+
+  runtime->fill_field<double>(ctx, acc, acc, FID_SUM, 0.0);
+
+  for (int iter = 0; iter < num_iterations; iter++)
+  {
+    Future value = runtime->execute_task(ctx,
+        TaskLauncher(TID_MAKE_VALUE, TaskArgument(&iter, sizeof(iter))));
+    runtime->fill_field(ctx, tmp, tmp, FID_VALUE, value);
+    runtime->fill_field<double>(ctx, tmp, tmp, FID_ONE, 1.0);
+    TaskLauncher launcher(TID_ACCUMULATE, TaskArgument());
+    launcher.add_region_requirement(
+        RegionRequirement(tmp, LEGION_READ_ONLY, LEGION_EXCLUSIVE, tmp)
+        .add_field(FID_VALUE).add_field(FID_ONE));
+    launcher.add_region_requirement(
+        RegionRequirement(acc, LEGION_READ_WRITE, LEGION_EXCLUSIVE, acc)
+        .add_field(FID_SUM));
+    runtime->execute_task(ctx, launcher);
+  }
+
+  // iteration i adds (i + 1) from the future-valued fill plus one
+  const double expected =
+    0.5 * num_iterations * (num_iterations + 1) + num_iterations;
+  int errors = 0;
+  {
+    InlineLauncher launcher(
+        RegionRequirement(acc, LEGION_READ_ONLY, LEGION_EXCLUSIVE, acc)
+        .add_field(FID_SUM));
+    PhysicalRegion pr = runtime->map_region(ctx, launcher);
+    pr.wait_until_valid();
+    const FieldAccessor<LEGION_READ_ONLY,double,1,coord_t,
+          Realm::AffineAccessor<double,1,coord_t> > sum(pr, FID_SUM);
+    for (PointInRectIterator<1> pir(bounds); pir(); pir++)
+      if (sum[*pir] != expected)
+      {
+        if (errors++ < 10)
+          printf("ERROR: sum[%lld] = %g, expected %g\n",
+                 (long long)(*pir)[0], sum[*pir], expected);
+      }
+    runtime->unmap_region(ctx, pr);
+  }
+
+  // the operations in the loop must have been traced, and once the
+  //  trace is replayed the accumulate task is no longer mapped
+  const int maps = accumulate_maps.load();
+  const int memoized = memoize_calls.load();
+  printf("%d memoization requests, accumulate mapped %d of %d times\n",
+         memoized, maps, num_iterations);
+  if (memoized == 0)
+  {
+    printf("ERROR: no operations were traced\n");
+    errors++;
+  }
+  if (maps >= num_iterations)
+  {
+    printf("ERROR: no trace was replayed\n");
+    errors++;
+  }
+
+  runtime->destroy_logical_region(ctx, tmp);
+  runtime->destroy_logical_region(ctx, acc);
+  runtime->destroy_field_space(ctx, fs);
+  runtime->destroy_index_space(ctx, is);
+
+  if (errors > 0)
+  {
+    printf("FAILED: %d errors\n", errors);
+    exit(1);
+  }
+  printf("SUCCESS\n");
+}
+
+int main(int argc, char **argv)
+{
+  {
+    TaskVariantRegistrar registrar(TID_TOP_LEVEL, "top_level");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    Runtime::preregister_task_variant<top_level_task>(registrar, "top_level");
+    Runtime::set_top_level_task_id(TID_TOP_LEVEL);
+  }
+  {
+    TaskVariantRegistrar registrar(TID_MAKE_VALUE, "make_value");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    Runtime::preregister_task_variant<double,make_value_task>(registrar,
+                                                              "make_value");
+  }
+  {
+    TaskVariantRegistrar registrar(TID_ACCUMULATE, "accumulate");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    Runtime::preregister_task_variant<accumulate_task>(registrar,
+                                                       "accumulate");
+  }
+  Runtime::add_registration_callback(mapper_registration);
+  return Runtime::start(argc, argv);
+}
@@ -20,6 +20,11 @@
 #include <cstring>
 
 #include <time.h>
+#include <unistd.h>
+
+#include <vector>
+#include <set>
+#include <algorithm>
 
 #include <realm.h>
 #include <realm/timers.h>
@@ -30,15 +35,25 @@ using namespace Realm;
 Logger log_app("app");
 
 #define DEFAULT_DEPTH 1024 
+#define DEFAULT_FANOUT_REPS 10
 
 // TASK IDs
 enum {
   TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
   THUNK_BUILDER  = Processor::TASK_ID_FIRST_AVAILABLE+1,
+  FANOUT_WAITER  = Processor::TASK_ID_FIRST_AVAILABLE+2,
 };
 
 struct TopLevelArgs {
   int chain_depth;
+  int max_fanout;   // if non-zero, measure trigger fan-out to up to this many nodes
+  int fanout_reps;
+};
+
+struct FanoutWaiterArgs {
+  UserEvent trigger;
+  Barrier ready;
+  Barrier done;
 };
 
 struct ThunkBuilderArgs {
@@ -104,6 +119,77 @@ Processor get_next_processor(Processor cur)
   return Processor::NO_PROC;
 }
 
+void fanout_waiter(const void *args, size_t arglen,
+                   const void *userdata, size_t userlen, Processor p)
+{
+  const FanoutWaiterArgs *wargs = static_cast<const FanoutWaiterArgs *>(args);
+
+  // make sure the owner knows about us before we say we're ready
+  wargs->trigger.subscribe();
+  wargs->ready.arrive(1);
+  wargs->trigger.wait();
+  wargs->done.arrive(1);
+}
+
+// measures the time from triggering an event on this node until waiters on
+//  'count' other nodes have all observed it, for growing values of 'count'
+void measure_fanout(const TopLevelArgs *targs, Processor p)
+{
+  // one processor on each other node
+  std::vector<Processor> remote_procs;
+  {
+    std::set<AddressSpace> seen;
+    seen.insert(p.address_space());
+    Machine::ProcessorQuery pq(Machine::get_machine());
+    pq.only_kind(Processor::LOC_PROC);
+    for(Machine::ProcessorQuery::iterator it = pq.begin(); it != pq.end(); ++it)
+      if(seen.insert(it->address_space()).second)
+        remote_procs.push_back(*it);
+  }
+  if(remote_procs.empty()) {
+    log_app.print() << "fan-out test needs more than one node - skipping";
+    return;
+  }
+
+  int max_count = std::min(targs->max_fanout, int(remote_procs.size()));
+  int count = 1;
+  while(true) {
+    Barrier ready = Barrier::create_barrier(count);
+    Barrier done = Barrier::create_barrier(count);
+    double total = 0, best = 0;
+    for(int rep = 0; rep < targs->fanout_reps; rep++) {
+      FanoutWaiterArgs wargs;
+      wargs.trigger = UserEvent::create_user_event();
+      wargs.ready = ready;
+      wargs.done = done;
+      for(int i = 0; i < count; i++)
+        remote_procs[i].spawn(FANOUT_WAITER, &wargs, sizeof(wargs));
+      ready.wait();
+      // subscriptions are sent before the arrivals, but give them a moment
+      //  to be processed by this node
+      usleep(1000);
+
+      double t1 = Clock::current_time();
+      wargs.trigger.trigger();
+      done.wait();
+      double t2 = Clock::current_time();
+      total += (t2 - t1);
+      if((rep == 0) || ((t2 - t1) < best))
+        best = t2 - t1;
+
+      ready = ready.advance_barrier();
+      done = done.advance_barrier();
+    }
+    log_app.print() << "fan-out to " << count << " nodes: avg="
+                    << (1e6 * total / targs->fanout_reps) << " us, min="
+                    << (1e6 * best) << " us";
+
+    if(count >= max_count)
+      break;
+    count = std::min(count * 2, max_count);
+  }
+}
+
 void top_level_task(const void *args, size_t arglen, 
                     const void *userdata, size_t userlen, Processor p)
 {
@@ -155,6 +241,9 @@ void top_level_task(const void *args, size_t arglen,
     double per_task = elapsed / (targs->chain_depth + 1);
     log_app.print() << "chain trigger: " << (1e6 * per_task) << " us/event, " << elapsed << " s total";
   }
+
+  if(targs->max_fanout > 0)
+    measure_fanout(targs, p);
 }
 
 void thunk_builder(const void *args, size_t arglen, 
@@ -189,13 +278,18 @@ int main(int argc, char **argv)
 
   TopLevelArgs top_args;
   top_args.chain_depth = DEFAULT_DEPTH;
+  top_args.max_fanout = 0;
+  top_args.fanout_reps = DEFAULT_FANOUT_REPS;
 
   CommandLineParser cp;
   cp.add_option_int("-d", top_args.chain_depth);
+  cp.add_option_int("-fanout", top_args.max_fanout);
+  cp.add_option_int("-fanout_reps", top_args.fanout_reps);
   ok = cp.parse_command_line(argc, (const char **)argv);
 
   r.register_task(TOP_LEVEL_TASK, top_level_task);
   r.register_task(THUNK_BUILDER, thunk_builder);
+  r.register_task(FANOUT_WAITER, fanout_waiter);
 
   r.register_reduction<UserEventAssignRedop>(REDOP_ASSIGN);
 
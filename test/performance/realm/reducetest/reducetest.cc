@@ -19,10 +19,13 @@
 #include <cassert>
 #include <cstring>
 #include <set>
+#include <vector>
 #include <time.h>
 
 #include <realm.h>
 #include <legion/accessor.h>
+#include <legion/legion_config.h>
+#include <legion/legion_redop.h>
 
 using namespace Realm;
 using namespace LegionRuntime::Accessor;
@@ -217,6 +220,82 @@ static void run_case(const char *name, int task_id,
   printf("ELAPSED(%s) = %f\n", name, (end_time - start_time)*1e-6);
 }		     
 
+// checks the bulk apply/fold kernels for one of Legion's built-in reduction
+//  ops against the scalar reduction and times them against the
+//  non-exclusive (per-element atomic) path
+template <class REDOP>
+static bool run_bulk_case(const char *name, size_t count)
+{
+  typedef typename REDOP::LHS T;
+  ReductionOpUntyped *redop = ReductionOpUntyped::create_reduction_op<REDOP>();
+
+  // pad by one element so that we also cover an unaligned start and a
+  //  count that isn't a multiple of any vector width
+  std::vector<T> lhs(count + 1), rhs(count + 1), check(count + 1);
+  for(size_t i = 0; i <= count; i++) {
+    lhs[i] = check[i] = T(1) + T((i * 7) % 5);
+    rhs[i] = T(1) + T((i * 3) % 2);
+  }
+
+  bool ok = true;
+  size_t offsets[2] = { 0, 1 };
+  for(int o = 0; o < 2; o++) {
+    size_t ofs = offsets[o];
+    size_t n = count + 1 - ofs - o;
+    redop->apply(&lhs[ofs], &rhs[ofs], n, true /*exclusive*/);
+    for(size_t i = 0; i < n; i++)
+      REDOP::template apply<true>(check[ofs + i], rhs[ofs + i]);
+    redop->fold_strided(&lhs[ofs], &rhs[ofs], sizeof(T), sizeof(T), n,
+			true /*exclusive*/);
+    for(size_t i = 0; i < n; i++)
+      REDOP::template fold<true>(check[ofs + i], rhs[ofs + i]);
+  }
+  if(memcmp(&lhs[0], &check[0], (count + 1) * sizeof(T))) {
+    log_app.error("bulk %s: mismatch with scalar reduction", name);
+    ok = false;
+  }
+
+  // reset to values that the product reduction can't overflow
+  for(size_t i = 0; i <= count; i++) {
+    lhs[i] = T(1);
+    rhs[i] = T(1);
+  }
+
+  double t1 = Realm::Clock::current_time_in_microseconds();
+  redop->apply(&lhs[0], &rhs[0], count, true /*exclusive*/);
+  double t2 = Realm::Clock::current_time_in_microseconds();
+  redop->apply(&lhs[0], &rhs[0], count, false /*!exclusive*/);
+  double t3 = Realm::Clock::current_time_in_microseconds();
+
+  printf("ELAPSED(bulk %s) = %f excl, %f nonexcl\n",
+	 name, (t2 - t1)*1e-6, (t3 - t2)*1e-6);
+
+  delete redop;
+  return ok;
+}
+
+static bool run_bulk_cases(size_t count)
+{
+  bool ok = true;
+  ok &= run_bulk_case<Legion::SumReduction<float> >("sum_f32", count);
+  ok &= run_bulk_case<Legion::SumReduction<double> >("sum_f64", count);
+  ok &= run_bulk_case<Legion::SumReduction<int32_t> >("sum_i32", count);
+  ok &= run_bulk_case<Legion::SumReduction<int64_t> >("sum_i64", count);
+  ok &= run_bulk_case<Legion::ProdReduction<float> >("prod_f32", count);
+  ok &= run_bulk_case<Legion::ProdReduction<double> >("prod_f64", count);
+  ok &= run_bulk_case<Legion::ProdReduction<int32_t> >("prod_i32", count);
+  ok &= run_bulk_case<Legion::ProdReduction<int64_t> >("prod_i64", count);
+  ok &= run_bulk_case<Legion::MaxReduction<float> >("max_f32", count);
+  ok &= run_bulk_case<Legion::MaxReduction<double> >("max_f64", count);
+  ok &= run_bulk_case<Legion::MaxReduction<int32_t> >("max_i32", count);
+  ok &= run_bulk_case<Legion::MaxReduction<int64_t> >("max_i64", count);
+  ok &= run_bulk_case<Legion::MinReduction<float> >("min_f32", count);
+  ok &= run_bulk_case<Legion::MinReduction<double> >("min_f64", count);
+  ok &= run_bulk_case<Legion::MinReduction<int32_t> >("min_i32", count);
+  ok &= run_bulk_case<Legion::MinReduction<int64_t> >("min_i64", count);
+  return ok;
+}
+
 void top_level_task(const void *args, size_t arglen, 
                     const void *userdata, size_t userlen, Processor p)
 {
@@ -226,6 +305,7 @@ void top_level_task(const void *args, size_t arglen,
   int seed1 = 12345;
   int seed2 = 54321;
   int do_slow = 0;
+  int bulk_size = 1 << 22;
 
   // Parse the input arguments
 #define INT_ARG(argname, varname) do { \
@@ -248,6 +328,7 @@ void top_level_task(const void *args, size_t arglen,
       INT_ARG("-buckets", buckets);
       INT_ARG("-batches", num_batches);
       INT_ARG("-bsize", batch_size);
+      INT_ARG("-bulk", bulk_size);
     }
   }
 #undef INT_ARG
@@ -285,6 +366,11 @@ void top_level_task(const void *args, size_t arglen,
   if(do_slow)
     run_case("redsingle", HIST_BATCH_REDSINGLE_TASK, hbargs, num_batches, false);
 
+  if(bulk_size > 0) {
+    bool ok = run_bulk_cases(bulk_size);
+    assert(ok);
+  }
+
 #if 0
   {
     RegionInstanceAccessor<BucketType,AccessorGeneric> ria = hist_inst.get_accessor();
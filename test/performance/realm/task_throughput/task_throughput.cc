@@ -36,6 +36,8 @@ namespace TestConfig {
   bool skip_launch_procs = false;
   bool use_posttriger_barrier = false;
   bool group_procs = false;
+  int imbalance = 1;    // first target gets this many times as many tasks
+  int task_work_us = 0; // busy-wait time for each middle task
 };
 
 // TASK IDs
@@ -58,6 +60,7 @@ enum TaskOrder {
 
 struct TestTaskArgs {
   int which_task;
+  int task_count;
   RegionInstance instance;
   Barrier posttrigger_barrier;
   Barrier finish_barrier;
@@ -82,7 +85,14 @@ void dummy_task_body(const void *args, size_t arglen,
   const TestTaskArgs& ta = *(const TestTaskArgs *)args;
   int task_type = ta.which_task;
   // quick out for most tasks
-  if(task_type == MIDDLE_TASK) return;
+  if(task_type == MIDDLE_TASK) {
+    if(TestConfig::task_work_us > 0) {
+      long long stop = (Clock::current_time_in_nanoseconds() +
+			1000LL * TestConfig::task_work_us);
+      while(Clock::current_time_in_nanoseconds() < stop);
+    }
+    return;
+  }
 
   if(TestConfig::use_posttriger_barrier && (task_type == FIRST_TASK)) {
 #if 0
@@ -113,8 +123,7 @@ void dummy_task_body(const void *args, size_t arglen,
     mydata.last_count++;
     if(mydata.last_count == mydata.first_count) {
       double elapsed = t - mydata.start_time;
-      double per_task = elapsed / (mydata.last_count * 
-				   TestConfig::tasks_per_processor);
+      double per_task = elapsed / (mydata.last_count * ta.task_count);
       log_app.print() << "tasks complete on " << p << ": " 
 		      << (1e6 * per_task) << " us/task, "
 		      << (1.0 / per_task) << " tasks/s";
@@ -201,15 +210,24 @@ void task_launcher(const void *args, size_t arglen,
   if(TestConfig::tasks_per_processor < 2)
     TestConfig::tasks_per_processor = 2;
 
-  for(int i = 0; i < TestConfig::tasks_per_processor; i++) {
-    int which = ((i == 0) ? FIRST_TASK :
-		 (i == (TestConfig::tasks_per_processor - 1)) ? LAST_TASK :
-		 MIDDLE_TASK);
-    tta->which_task = which;
+  // to create an imbalance, the first target gets extra tasks
+  if(TestConfig::imbalance < 1)
+    TestConfig::imbalance = 1;
+  int max_tasks = TestConfig::tasks_per_processor * TestConfig::imbalance;
+
+  for(int i = 0; i < max_tasks; i++) {
     tta->posttrigger_barrier = la.posttrigger_barrier;
     tta->finish_barrier = la.finish_barrier;
     
     for(std::vector<Processor>::const_iterator it = targets.begin(); it != targets.end(); ++it) {
+      int count = ((it == targets.begin()) ? max_tasks :
+		   TestConfig::tasks_per_processor);
+      if(i >= count) continue;
+      int which = ((i == 0) ? FIRST_TASK :
+		   (i == (count - 1)) ? LAST_TASK :
+		   MIDDLE_TASK);
+      tta->which_task = which;
+      tta->task_count = count;
       tta->instance = la.instances[*it];
       assert(tta->instance.exists());
 
@@ -341,7 +359,16 @@ void top_level_task(const void *args, size_t arglen,
   free(args_data);
 
   // all done - wait for everything to finish via the finish_barrier
+  double t_start = Clock::current_time();
   launch_args.finish_barrier.wait();
+  double t_end = Clock::current_time();
+
+  // with an imbalanced load, the total time shows how well the idle
+  //  processors were able to help out (e.g. with -ll:steal)
+  if(TestConfig::imbalance > 1)
+    log_app.print() << "all tasks complete: imbalance=" << TestConfig::imbalance
+		    << " work=" << TestConfig::task_work_us << "us elapsed="
+		    << (t_end - t_start) << " s";
 }
 
 int main(int argc, char **argv)
@@ -360,7 +387,9 @@ int main(int argc, char **argv)
     .add_option_bool("-noself", TestConfig::skip_launch_procs)
     .add_option_bool("-post", TestConfig::use_posttriger_barrier)
     .add_option_bool("-prof", TestConfig::with_profiling)
-    .add_option_bool("-group", TestConfig::group_procs);
+    .add_option_bool("-group", TestConfig::group_procs)
+    .add_option_int("-imbalance", TestConfig::imbalance)
+    .add_option_int("-work", TestConfig::task_work_us);
   ok = cp.parse_command_line(argc, (const char **)argv);
   assert(ok);
 
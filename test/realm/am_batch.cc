@@ -0,0 +1,278 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Realm test that floods every other node with small messages (remote task
+//  spawns and user event triggers) - run it with and without -ll:ambatch
+//  on several ranks to exercise active message batching - when batching is
+//  on, each sender also checks its node's batcher counters
+
+#include <realm.h>
+#include <realm/cmdline.h>
+#include <realm/timers.h>
+#include <realm/atomics.h>
+#include <realm/activemsg.h>
+
+#include <vector>
+#include <set>
+#include <string.h>
+
+#include "osdep.h"
+
+using namespace Realm;
+
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+  SENDER_TASK,
+  COUNT_TASK,
+  LARGE_TASK,
+  REPORT_TASK,
+};
+
+Logger log_app("app");
+
+namespace TestConfig {
+  int messages = 10000;  // messages sent by each remote sender task
+};
+
+struct SenderArgs {
+  Processor origin;
+  UserEvent done;
+  int messages;
+};
+
+struct CountArgs {
+  int index;
+};
+
+// too big to batch, so it flushes the batch ahead of it
+struct LargeArgs {
+  char data[16384];
+};
+
+struct ReportArgs {
+  int errors;
+};
+
+static atomic<int> total_counted(0);
+static atomic<long long> index_sum(0);
+static atomic<int> large_received(0);
+static atomic<int> sender_errors(0);
+
+void count_task(const void *args, size_t arglen,
+		const void *userdata, size_t userlen, Processor p)
+{
+  assert(arglen == sizeof(CountArgs));
+  const CountArgs& count_args = *reinterpret_cast<const CountArgs *>(args);
+  total_counted.fetch_add(1);
+  index_sum.fetch_add(count_args.index);
+}
+
+void large_task(const void *args, size_t arglen,
+		const void *userdata, size_t userlen, Processor p)
+{
+  assert(arglen == sizeof(LargeArgs));
+  large_received.fetch_add(1);
+}
+
+void report_task(const void *args, size_t arglen,
+		 const void *userdata, size_t userlen, Processor p)
+{
+  assert(arglen == sizeof(ReportArgs));
+  sender_errors.fetch_add(reinterpret_cast<const ReportArgs *>(args)->errors);
+}
+
+void sender_task(const void *args, size_t arglen,
+		 const void *userdata, size_t userlen, Processor p)
+{
+  assert(arglen == sizeof(SenderArgs));
+  const SenderArgs& sender_args = *reinterpret_cast<const SenderArgs *>(args);
+
+  // the batcher only exists when batching is enabled on this node
+  const ActiveMessageBatcher *batcher = activemsg_batcher;
+  size_t batched_before = 0, sent_before = 0, flushes_before = 0;
+  if(batcher) {
+    batched_before = batcher->get_messages_batched();
+    sent_before = batcher->get_batches_sent();
+    flushes_before = batcher->get_flushes();
+  }
+
+  // each spawn is a small message back to the origin node, and none of them
+  //  depend on each other, so they can all be in flight at once
+  std::vector<Event> events(sender_args.messages);
+  for(int i = 0; i < sender_args.messages; i++) {
+    CountArgs count_args;
+    count_args.index = i;
+    events[i] = sender_args.origin.spawn(COUNT_TASK,
+					 &count_args, sizeof(count_args));
+  }
+
+  LargeArgs large_args;
+  memset(&large_args, 0, sizeof(large_args));
+  events.push_back(sender_args.origin.spawn(LARGE_TASK,
+					    &large_args, sizeof(large_args)));
+
+  ReportArgs report_args;
+  report_args.errors = 0;
+  if(batcher) {
+    // other messages may be batched at the same time, but every spawn
+    //  above was, and far fewer network messages should have carried them
+    size_t batched = batcher->get_messages_batched() - batched_before;
+    size_t sent = batcher->get_batches_sent() - sent_before;
+    size_t flushes = batcher->get_flushes() - flushes_before;
+    log_app.info() << "sender " << p << ": batched=" << batched
+		   << " sent=" << sent << " flushes=" << flushes;
+    if(batched < size_t(sender_args.messages)) {
+      log_app.error() << "only " << batched << " of "
+		      << sender_args.messages << " messages were batched";
+      report_args.errors++;
+    }
+    if((sent == 0) || (sent >= batched)) {
+      log_app.error() << batched << " messages went in " << sent
+		      << " batches";
+      report_args.errors++;
+    }
+    if(flushes == 0) {
+      log_app.error() << "the large message did not flush its batch";
+      report_args.errors++;
+    }
+  }
+  events.push_back(sender_args.origin.spawn(REPORT_TASK,
+					    &report_args, sizeof(report_args)));
+
+  // the done event lives on the origin node, so triggering it is one more
+  //  remote message that has to arrive after the spawns complete
+  sender_args.done.trigger(Event::merge_events(events));
+}
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  log_app.print() << "active message batching test: messages="
+		  << TestConfig::messages;
+
+  // one sender per address space other than our own
+  std::vector<Processor> senders;
+  {
+    std::set<AddressSpace> seen;
+    seen.insert(p.address_space());
+    Machine::ProcessorQuery pq(Machine::get_machine());
+    pq.only_kind(p.kind());
+    for(Machine::ProcessorQuery::iterator it = pq.begin(); it != pq.end(); ++it)
+      if(seen.insert((*it).address_space()).second)
+	senders.push_back(*it);
+  }
+  // with no remote nodes, send to ourselves anyway so the test does something
+  if(senders.empty()) {
+    log_app.warning() << "no remote nodes - messages will all be local";
+    senders.push_back(p);
+  }
+
+  long long t_start = Clock::current_time_in_nanoseconds();
+  std::vector<Event> done_events;
+  for(size_t i = 0; i < senders.size(); i++) {
+    SenderArgs sender_args;
+    sender_args.origin = p;
+    sender_args.done = UserEvent::create_user_event();
+    sender_args.messages = TestConfig::messages;
+    senders[i].spawn(SENDER_TASK, &sender_args, sizeof(sender_args));
+    done_events.push_back(sender_args.done);
+  }
+  Event::merge_events(done_events).wait();
+  long long t_end = Clock::current_time_in_nanoseconds();
+
+  int expected = TestConfig::messages * senders.size();
+  long long expected_sum = (((long long)TestConfig::messages *
+			     (TestConfig::messages - 1) / 2) *
+			    senders.size());
+  double elapsed = 1e-9 * (t_end - t_start);
+  log_app.print() << "received " << total_counted.load() << " messages from "
+		  << senders.size() << " senders in " << elapsed
+		  << " s (" << (total_counted.load() / elapsed) << " msgs/s)";
+
+  int errors = 0;
+  if(large_received.load() != int(senders.size())) {
+    log_app.error() << "large message count mismatch: expected="
+		    << senders.size() << " actual=" << large_received.load();
+    errors++;
+  }
+  if(sender_errors.load() > 0) {
+    log_app.error() << sender_errors.load() << " errors on sender nodes";
+    errors++;
+  }
+  if(total_counted.load() != expected) {
+    log_app.error() << "message count mismatch: expected=" << expected
+		    << " actual=" << total_counted.load();
+    errors++;
+  }
+  if(index_sum.load() != expected_sum) {
+    log_app.error() << "message contents mismatch: expected sum="
+		    << expected_sum << " actual=" << index_sum.load();
+    errors++;
+  }
+
+  if(errors == 0)
+    log_app.info() << "completed successfully";
+
+  Runtime::get_runtime().shutdown(Event::NO_EVENT, (errors == 0) ? 0 : 1);
+}
+
+int main(int argc, const char **argv)
+{
+  Runtime rt;
+
+  rt.init(&argc, (char ***)&argv);
+
+  CommandLineParser cp;
+  cp.add_option_int("-m", TestConfig::messages);
+  bool ok = cp.parse_command_line(argc, argv);
+  assert(ok);
+
+  // try to use a cpu proc, but if that doesn't exist, take whatever we can get
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  if(!p.exists())
+    p = Machine::ProcessorQuery(Machine::get_machine()).first();
+  assert(p.exists());
+
+  Processor::register_task_by_kind(p.kind(), false /*!global*/,
+				   TOP_LEVEL_TASK,
+				   CodeDescriptor(top_level_task),
+				   ProfilingRequestSet()).external_wait();
+  Processor::register_task_by_kind(p.kind(), false /*!global*/,
+				   SENDER_TASK,
+				   CodeDescriptor(sender_task),
+				   ProfilingRequestSet()).external_wait();
+  Processor::register_task_by_kind(p.kind(), false /*!global*/,
+				   COUNT_TASK,
+				   CodeDescriptor(count_task),
+				   ProfilingRequestSet()).external_wait();
+  Processor::register_task_by_kind(p.kind(), false /*!global*/,
+				   LARGE_TASK,
+				   CodeDescriptor(large_task),
+				   ProfilingRequestSet()).external_wait();
+  Processor::register_task_by_kind(p.kind(), false /*!global*/,
+				   REPORT_TASK,
+				   CodeDescriptor(report_task),
+				   ProfilingRequestSet()).external_wait();
+
+  // collective launch of a single top level task
+  rt.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // now sleep this thread until that shutdown actually happens
+  int ret = rt.wait_for_shutdown();
+
+  return ret;
+}
@@ -7,6 +7,12 @@
 #include "osdep.h"
 
 #include "realm.h"
+#include "realm/cmdline.h"
+#include "realm/timers.h"
+
+#include <vector>
+#include <set>
+#include <algorithm>
 
 using namespace Realm;
 
@@ -15,6 +21,7 @@ enum {
   TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
   CHILD_TASK     = Processor::TASK_ID_FIRST_AVAILABLE+1,
   CHECK_TASK     = Processor::TASK_ID_FIRST_AVAILABLE+2,
+  BENCH_TASK     = Processor::TASK_ID_FIRST_AVAILABLE+3,
 };
 
 enum { REDOP_ADD = 1 };
@@ -46,6 +53,15 @@ static const int BARRIER_INITIAL_VALUE = 42;
 
 static int errors = 0;
 
+// command-line options
+static bool combine_arrivals = false;  // use arrival combining for the correctness test
+static int bench_phases = 0;  // if non-zero, run the arrival scaling benchmark
+
+struct BenchTaskArgs {
+  int num_phases;
+  Barrier b;
+};
+
 // we're going to use alarm() as a watchdog to detect deadlocks
 void sigalrm_handler(int sig)
 {
@@ -65,6 +81,13 @@ void child_task(const void *args, size_t arglen,
     // make one task slower than all the others
     if(i != 0) sleep(1);
 
+    // with combining, also add an arrival that has to wait for this
+    //  node's increment, so combined arrivals carry timestamps too
+    if(combine_arrivals) {
+      Barrier extra = b.alter_arrival_count(1);
+      extra.arrive(1);
+    }
+
     int reduce_val = (i+1)*(child_args.index+1);
     b.arrive(1, Event::NO_EVENT, &reduce_val, sizeof(reduce_val));
 
@@ -99,6 +122,78 @@ void child_task(const void *args, size_t arglen,
   printf("ending child task %zd on processor " IDFMT "\n", child_args.index, p.id);
 }
 
+// arrives once per phase with a reduction value and waits for everybody
+//  else before moving on
+void bench_task(const void *args, size_t arglen,
+		const void *userdata, size_t userlen, Processor p)
+{
+  assert(arglen == sizeof(BenchTaskArgs));
+  const BenchTaskArgs& bench_args = *(const BenchTaskArgs *)args;
+
+  Barrier b = bench_args.b;
+  for(int i = 0; i < bench_args.num_phases; i++) {
+    int reduce_val = 1;
+    b.arrive(1, Event::NO_EVENT, &reduce_val, sizeof(reduce_val));
+    b.wait();
+    b = b.advance_barrier();
+  }
+}
+
+// times barrier phases with growing numbers of arriving processors, both
+//  with every arrival sent to the owner and with arrival combining
+void run_scaling_benchmark(const std::vector<Processor>& all_cpus)
+{
+  std::set<AddressSpace> nodes;
+  for(size_t i = 0; i < all_cpus.size(); i++)
+    nodes.insert(all_cpus[i].address_space());
+  printf("barrier scaling: %zd processors on %zd nodes, %d phases\n",
+	 all_cpus.size(), nodes.size(), bench_phases);
+
+  size_t count = 1;
+  while(true) {
+    for(int combine = 0; combine < 2; combine++) {
+      Barrier b = Barrier::create_barrier(count, REDOP_ADD,
+					  &BARRIER_INITIAL_VALUE, sizeof(BARRIER_INITIAL_VALUE),
+					  combine != 0);
+
+      // spread the participants over the nodes by taking every n'th processor
+      std::set<Event> task_events;
+      size_t stride = all_cpus.size() / count;
+      long long t1 = Clock::current_time_in_nanoseconds();
+      for(size_t i = 0; i < count; i++) {
+	BenchTaskArgs args;
+	args.num_phases = bench_phases;
+	args.b = b;
+	task_events.insert(all_cpus[i * stride].spawn(BENCH_TASK, &args, sizeof(args)));
+      }
+      Event::merge_events(task_events).wait();
+      long long t2 = Clock::current_time_in_nanoseconds();
+
+      // check the result of the last phase
+      Barrier last = b;
+      for(int i = 1; i < bench_phases; i++)
+	last = last.advance_barrier();
+      int result;
+      bool ready = last.get_result(&result, sizeof(result));
+      int exp_result = BARRIER_INITIAL_VALUE + int(count);
+      if(!ready || (result != exp_result)) {
+	printf("bench: %zd arrivals, combine=%d: result = %d ERROR (expected %d)\n",
+	       count, combine, (ready ? result : -1), exp_result);
+	errors++;
+      }
+
+      printf("bench: arrivals=%zd combine=%d: %.2f us/phase\n",
+	     count, combine, 1e-3 * (t2 - t1) / bench_phases);
+
+      b.destroy_barrier();
+    }
+
+    if(count >= all_cpus.size())
+      break;
+    count = std::min(count * 2, all_cpus.size());
+  }
+}
+
 void check_task(const void *args, size_t arglen, 
 		const void *userdata, size_t userlen, Processor p)
 {
@@ -141,7 +236,8 @@ void top_level_task(const void *args, size_t arglen,
   printf("top level task - creating barrier\n");
 
   Barrier b = Barrier::create_barrier(all_cpus.size(), REDOP_ADD,
-				      &BARRIER_INITIAL_VALUE, sizeof(BARRIER_INITIAL_VALUE));
+				      &BARRIER_INITIAL_VALUE, sizeof(BARRIER_INITIAL_VALUE),
+				      combine_arrivals);
 
   std::set<Event> task_events;
 
@@ -210,13 +306,16 @@ void top_level_task(const void *args, size_t arglen,
 
   b.destroy_barrier();
 
+  alarm(0);
+
+  if(bench_phases > 0)
+    run_scaling_benchmark(all_cpus);
+
   if(errors > 0) {
     printf("Exiting with errors.\n");
     exit(1);
   }
 
-  alarm(0);
-
   printf("done!\n");
 }
 
@@ -226,9 +325,16 @@ int main(int argc, char **argv)
 
   rt.init(&argc, &argv);
 
+  CommandLineParser cp;
+  cp.add_option_bool("-combine", combine_arrivals)
+    .add_option_int("-bench", bench_phases);
+  bool ok = cp.parse_command_line(argc, (const char **)argv);
+  assert(ok);
+
   rt.register_task(TOP_LEVEL_TASK, top_level_task);
   rt.register_task(CHILD_TASK, child_task);
   rt.register_task(CHECK_TASK, check_task);
+  rt.register_task(BENCH_TASK, bench_task);
 
   rt.register_reduction(REDOP_ADD, 
 			ReductionOpUntyped::create_reduction_op<ReductionOpIntAdd>());
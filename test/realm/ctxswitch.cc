@@ -1,4 +1,5 @@
 #include "realm.h"
+#include "realm/threads.h"
 
 #include <cstdio>
 #include <cstdlib>
@@ -216,6 +217,24 @@ static int num_iterations = 100000;
 static int timeout_seconds = 10;
 static int sleep_useconds = 500000;
 static int concurrent_io = 1;
+static int uswitch_iterations = 1000000;
+
+// raw user-level switching rate for each switch implementation, independent
+//  of the processor scheduler
+static void measure_user_switch_rates(void)
+{
+#ifdef REALM_USE_USER_THREADS
+  const char *names[2] = { "fast", "ucontext" };
+  for(int i = 0; i < 2; i++) {
+    double rate = Thread::measure_user_switch_rate(i == 1, uswitch_iterations);
+    if(rate > 0)
+      printf("uswitch: impl=%s iterations=%d rate=%6.2f Mswitch/s time/switch=%6.1fns\n",
+	     names[i], uswitch_iterations, 1e-6 * rate, 1e9 / rate);
+    else
+      printf("uswitch: impl=%s not available\n", names[i]);
+  }
+#endif
+}
 
 void top_level_task(const void *args, size_t arglen, 
 		    const void *userdata, size_t userlen, Processor p)
@@ -225,6 +244,9 @@ void top_level_task(const void *args, size_t arglen,
   printf("Realm context switching test - %d children, %d iterations, %ds timeout\n",
 	 num_children, num_iterations, timeout_seconds);
 
+  if(uswitch_iterations > 0)
+    measure_user_switch_rates();
+
   // iterate over all the CPU kinds we can find - test each kind once
   Machine machine = Machine::get_machine();
   std::set<Processor::Kind> seen;
@@ -278,8 +300,8 @@ void top_level_task(const void *args, size_t arglen,
 
 	double elapsed = t_end - t_start;
 	double ns_per_switch = 1e9 * elapsed / num_iterations / num_children;
-	printf("switch: proc " IDFMT " (kind=%d) finished: elapsed=%5.2fs time/switch=%6.0fns\n",
-               pp.id, k, elapsed, ns_per_switch);
+	printf("switch: proc " IDFMT " (kind=%d) finished: elapsed=%5.2fs time/switch=%6.0fns switches/s=%8.0f\n",
+               pp.id, k, elapsed, ns_per_switch, 1e9 / ns_per_switch);
       }
 
       // now the sleep (i.e. kernel-level switching, if possible) test
@@ -367,6 +389,11 @@ int main(int argc, char **argv)
       continue;
     }
 
+    if(!strcmp(argv[i], "-u")) {
+      uswitch_iterations = atoi(argv[++i]);
+      continue;
+    }
+
     // peek at Realm configuration here...
     if(!strcmp(argv[i], "-ll:concurrent_io")) {
       concurrent_io = atoi(argv[++i]);
@@ -1,6 +1,7 @@
 #include "realm.h"
 // for WithDefault<>
 #include "realm/threads.h"
+#include "realm/deppart/deppart_config.h"
 
 #include <cstdio>
 #include <cstdlib>
@@ -115,6 +116,8 @@ namespace {
   bool wait_on_events = false;
   bool show_graph = false;
   bool skip_check = false;
+  int tile_compare_size = 0;
+  int sparse_query_size = 0;
   TestInterface *testcfg = 0;
 };
 
@@ -2117,6 +2120,195 @@ int RandomTest<N1,T1,N2,T2,FT>::check_partitioning(void)
   return 0;
 }
 
+// times a by-field partition of one large instance with untiled and tiled
+//  scans - the tile size is only read when a partitioning operation starts,
+//  so it can be changed between operations (i.e. while nothing is being
+//  partitioned) - and checks that every color got exactly its own points
+static int measure_tiling(Memory m, int num_points)
+{
+  const int num_colors = 16;
+  IndexSpace<1> is(Rect<1>(0, num_points - 1));
+
+  std::vector<size_t> fields(1, sizeof(int));
+  RegionInstance ri;
+  RegionInstance::create_instance(ri, m, is, fields,
+				  0 /*SOA*/,
+				  Realm::ProfilingRequestSet()).wait();
+  std::vector<size_t> expected_counts(num_colors, 0);
+  {
+    // runs of 1000 points with the same color
+    AffineAccessor<int,1> a_color(ri, 0 /* offset */);
+    for(int i = 0; i < num_points; i++) {
+      a_color[i] = (i / 1000) % num_colors;
+      expected_counts[(i / 1000) % num_colors]++;
+    }
+  }
+
+  std::vector<FieldDataDescriptor<IndexSpace<1>, int> > field_data(1);
+  field_data[0].index_space = is;
+  field_data[0].inst = ri;
+  field_data[0].field_offset = 0;
+
+  std::vector<int> colors(num_colors);
+  for(int i = 0; i < num_colors; i++)
+    colors[i] = i;
+
+  // the tiled run uses the configured tile size, or the default if tiling
+  //  was disabled on the command line
+  const size_t saved_tile_size = DeppartConfig::cfg_scan_tile_size;
+  const size_t tile_sizes[2] = { 0,
+				 ((saved_tile_size > 0) ? saved_tile_size :
+				                          size_t(1 << 20)) };
+  double elapsed[2];
+  std::vector<size_t> untiled_counts;
+  int errors = 0;
+
+  for(int run = 0; run < 2; run++) {
+    DeppartConfig::cfg_scan_tile_size = tile_sizes[run];
+
+    std::vector<IndexSpace<1> > subspaces;
+    double t1 = Clock::current_time();
+    is.create_subspaces_by_field(field_data, colors, subspaces,
+				 Realm::ProfilingRequestSet()).wait();
+    for(size_t i = 0; i < subspaces.size(); i++)
+      subspaces[i].make_valid().wait();
+    double t2 = Clock::current_time();
+    elapsed[run] = t2 - t1;
+
+    // every point in a subspace must have that color, and each color must
+    //  have as many points as the field (and the untiled scan) says
+    std::vector<size_t> counts(num_colors, 0);
+    for(int c = 0; c < num_colors; c++) {
+      size_t wrong = 0;
+      for(IndexSpaceIterator<1> it(subspaces[c]); it.valid; it.step())
+	for(PointInRectIterator<1> pir(it.rect); pir.valid; pir.step()) {
+	  counts[c]++;
+	  if(((pir.p[0] / 1000) % num_colors) != c)
+	    wrong++;
+	}
+      if((wrong > 0) || (counts[c] != expected_counts[c]) ||
+	 ((run > 0) && (counts[c] != untiled_counts[c]))) {
+	log_app.error() << "HELP! by-field tiling mismatch: tile_size=" << tile_sizes[run]
+			<< " color=" << c << " count=" << counts[c]
+			<< " expected=" << expected_counts[c]
+			<< " untiled=" << ((run > 0) ? untiled_counts[c] : counts[c])
+			<< " wrong_color=" << wrong;
+	errors++;
+      }
+    }
+    if(run == 0)
+      untiled_counts = counts;
+
+    for(size_t i = 0; i < subspaces.size(); i++)
+      subspaces[i].destroy();
+  }
+
+  DeppartConfig::cfg_scan_tile_size = saved_tile_size;
+  ri.destroy();
+
+  log_app.print() << "by-field tiling: points=" << num_points
+		  << " untiled=" << elapsed[0] << "s"
+		  << " tiled(" << tile_sizes[1] << ")=" << elapsed[1] << "s"
+		  << " speedup=" << (elapsed[0] / elapsed[1]) << "x";
+
+  return errors;
+}
+
+// times point and rectangle queries on a 2-D index space with a large
+//  sparsity map against a linear scan of its entries, and checks they agree
+static int measure_sparse_queries(int grid_size)
+{
+  // staggered two-point runs in each row, so nothing merges and there are
+  //  about grid_size^2/4 entries
+  std::vector<Rect<2> > rects;
+  for(int y = 0; y < grid_size; y++)
+    for(int x = 2 * (y % 2); (x + 1) < grid_size; x += 4)
+      rects.push_back(Rect<2>(Point<2>(x, y), Point<2>(x + 1, y)));
+  IndexSpace<2> is(rects);
+  is.make_valid().wait();
+
+  const int num_queries = 100000;
+  // the linear scan is much slower, so only check a subset of queries
+  const int num_checked = std::min(num_queries, 2000);
+  srand(random_seed);
+  std::vector<Point<2> > points(num_queries);
+  std::vector<Rect<2> > boxes(num_queries);
+  for(int i = 0; i < num_queries; i++) {
+    points[i] = Point<2>(rand() % grid_size, rand() % grid_size);
+    Point<2> lo(rand() % grid_size, rand() % grid_size);
+    Point<2> extent(rand() % 4, rand() % 2);
+    boxes[i] = Rect<2>(lo, lo + extent);
+  }
+
+  std::vector<bool> results(3 * num_queries);
+  double t1 = Clock::current_time();
+  for(int i = 0; i < num_queries; i++) {
+    results[3 * i] = is.contains(points[i]);
+    results[3 * i + 1] = is.contains_any(boxes[i]);
+    results[3 * i + 2] = is.contains_all(boxes[i]);
+  }
+  double t2 = Clock::current_time();
+
+  // reference answers from a scan of the original (disjoint) rectangles -
+  //  the sparsity map may have turned some of them into bitmaps
+  const std::vector<SparsityMapEntry<2,int> >& entries = is.sparsity.impl()->get_entries();
+  int errors = 0;
+  double t3 = Clock::current_time();
+  for(int i = 0; i < num_checked; i++) {
+    bool contains = false;
+    bool any = false;
+    size_t covered = 0;
+    for(size_t j = 0; j < rects.size(); j++) {
+      if(rects[j].contains(points[i]))
+	contains = true;
+      Rect<2> isect = rects[j].intersection(boxes[i]);
+      if(!isect.empty()) {
+	any = true;
+	covered += isect.volume();
+      }
+    }
+    bool all = (covered == boxes[i].volume());
+    if((contains != results[3 * i]) || (any != results[3 * i + 1]) ||
+       (all != results[3 * i + 2])) {
+      if(errors++ < 10)
+	log_app.error() << "HELP! sparse query mismatch: point=" << points[i]
+			<< " (" << results[3 * i] << " vs " << contains
+			<< ") rect=" << boxes[i]
+			<< " any=(" << results[3 * i + 1] << " vs " << any
+			<< ") all=(" << results[3 * i + 2] << " vs " << all << ")";
+    }
+  }
+  double t4 = Clock::current_time();
+
+  // iteration and volume must see exactly the original points
+  size_t expected_volume = 0;
+  for(size_t j = 0; j < rects.size(); j++)
+    expected_volume += rects[j].volume();
+  size_t iterated_volume = 0;
+  size_t bitmap_entries = 0;
+  for(IndexSpaceIterator<2> it(is); it.valid; it.step())
+    iterated_volume += it.rect.volume();
+  for(size_t j = 0; j < entries.size(); j++)
+    if(entries[j].bitmap != 0)
+      bitmap_entries++;
+  if((is.volume() != expected_volume) || (iterated_volume != expected_volume)) {
+    log_app.error() << "HELP! sparse volume mismatch: expected=" << expected_volume
+		    << " volume=" << is.volume() << " iterated=" << iterated_volume;
+    errors++;
+  }
+
+  double indexed_per_query = (t2 - t1) / num_queries;
+  double linear_per_query = (t4 - t3) / num_checked;
+  log_app.print() << "sparse queries: entries=" << entries.size()
+		  << " bitmaps=" << bitmap_entries
+		  << " indexed=" << (1e6 * indexed_per_query) << "us/query"
+		  << " linear=" << (1e6 * linear_per_query) << "us/query"
+		  << " speedup=" << (linear_per_query / indexed_per_query) << "x";
+
+  is.destroy();
+  return errors;
+}
+
 void top_level_task(const void *args, size_t arglen,
 		    const void *userdata, size_t userlen, Processor p)
 {
@@ -2187,6 +2379,12 @@ void top_level_task(const void *args, size_t arglen,
     errors += testcfg->check_partitioning();
   }
 
+  if(tile_compare_size > 0)
+    errors += measure_tiling(sysmems[0], tile_compare_size);
+
+  if(sparse_query_size > 0)
+    errors += measure_sparse_queries(sparse_query_size);
+
   if(errors > 0) {
     printf("Exiting with errors\n");
     exit(1);
@@ -2228,6 +2426,16 @@ int main(int argc, char **argv)
       continue;
     }
 
+    if(!strcmp(argv[i], "-tilecmp")) {
+      tile_compare_size = atoi(argv[++i]);
+      continue;
+    }
+
+    if(!strcmp(argv[i], "-sparsecmp")) {
+      sparse_query_size = atoi(argv[++i]);
+      continue;
+    }
+
     // test cases consume the rest of the args
     if(!strcmp(argv[i], "circuit")) {
       testcfg = new CircuitTest(argc-i, const_cast<const char **>(argv+i));
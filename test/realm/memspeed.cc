@@ -1,6 +1,7 @@
 #include "realm.h"
 #include "realm/id.h"
 #include "realm/cmdline.h"
+#include "realm/transfer/channel.h"
 
 #include <cstdio>
 #include <cstdlib>
@@ -8,6 +9,7 @@
 #include <cstring>
 #include <csignal>
 #include <cmath>
+#include <algorithm>
 
 #include <time.h>
 
@@ -60,6 +62,8 @@ namespace TestConfig {
   bool do_copies = true;  // should DMAs between memories be tested
   int copy_reps = 0;      // if nonzero, average over #reps copies
   bool slow_mems = false;  // show slow memories be tested?
+  bool copy_scaling = false;  // measure large memcpy bandwidth for each
+                              //  split count up to -ll:memcpy_split
 };
 
 void memspeed_cpu_task(const void *args, size_t arglen, 
@@ -216,6 +220,40 @@ void memspeed_gpu_task(const void *args, size_t arglen,
 
 std::set<Processor::Kind> supported_proc_kinds;
 
+// performs a copy and returns the time reported by its profiling response
+static long long time_copy(IndexSpace<1> is,
+			   const std::vector<CopySrcDstField>& src,
+			   const std::vector<CopySrcDstField>& dst,
+			   Processor p)
+{
+  long long copy_time = -1;
+  UserEvent copy_done = UserEvent::create_user_event();
+  CopyProfResult result;
+  result.nanoseconds = &copy_time;
+  result.done = copy_done;
+  ProfilingRequestSet prs;
+  prs.add_request(p, COPYPROF_TASK, &result, sizeof(CopyProfResult))
+    .add_measurement<ProfilingMeasurements::OperationTimeline>();
+  is.copy(src, dst, prs).wait();
+  copy_done.wait();
+  return copy_time;
+}
+
+// only copies between cpu-addressable memories are done by the memcpy
+//  channel
+static bool is_memcpy_mem(Memory m)
+{
+  switch(m.kind()) {
+  case Memory::SYSTEM_MEM:
+  case Memory::REGDMA_MEM:
+  case Memory::SOCKET_MEM:
+  case Memory::Z_COPY_MEM:
+    return true;
+  default:
+    return false;
+  }
+}
+
 void top_level_task(const void *args, size_t arglen, 
 		    const void *userdata, size_t userlen, Processor p)
 {
@@ -404,6 +442,121 @@ void top_level_task(const void *args, size_t arglen,
     }
   }
 
+  if(TestConfig::copy_scaling) {
+    // the runtime's helpers are set up for the -ll:memcpy_split it was
+    //  started with, but smaller split counts can be used between copies
+    //  (i.e. while nothing is being copied), so the whole curve is
+    //  measured in one run
+    const int max_split = Config::memcpy_parallel_pieces;
+    std::vector<int> splits(1, 1);
+    for(int split = 2; split < max_split; split *= 2)
+      splits.push_back(split);
+    if(max_split > 1)
+      splits.push_back(max_split);
+    else
+      log_app.warning() << "copy scaling: run with -ll:memcpy_split > 1 to measure split copies";
+
+    void *fill_value = 0;
+    std::vector<CopySrcDstField> src(1);
+    src[0].field_id = 0;
+    src[0].size = sizeof(void *);
+    std::vector<CopySrcDstField> dst(1);
+    dst[0].field_id = 0;
+    dst[0].size = sizeof(void *);
+    int errors = 0;
+
+    for(std::vector<Memory>::const_iterator it = memories.begin();
+	it != memories.end();
+	++it) {
+      Memory m1 = *it;
+      // the results are checked directly, so only local memories are used
+      if(!is_memcpy_mem(m1) || (m1.address_space() != p.address_space()))
+	continue;
+
+      RegionInstance inst1;
+      RegionInstance::create_instance(inst1, m1, d,
+				      std::vector<size_t>(1, sizeof(void *)),
+				      0 /*SOA*/,
+				      ProfilingRequestSet()).wait();
+      assert(inst1.exists());
+      src[0].inst = inst1;
+      // each element holds its own byte offset, so a piece copied to or
+      //  from the wrong place (or not at all) shows up
+      {
+	AffineAccessor<uintptr_t, 1> ra(inst1, 0);
+	for(size_t i = 0; i < elements; i++)
+	  ra[i] = i * sizeof(uintptr_t);
+      }
+
+      for(std::vector<Memory>::const_iterator it2 = memories.begin();
+	  it2 != memories.end();
+	  ++it2) {
+	Memory m2 = *it2;
+	if(!is_memcpy_mem(m2) || (m2.address_space() != p.address_space()))
+	  continue;
+
+	RegionInstance inst2;
+	RegionInstance::create_instance(inst2, m2, d,
+					std::vector<size_t>(1, sizeof(void *)),
+					0 /*SOA*/,
+					ProfilingRequestSet()).wait();
+	assert(inst2.exists());
+	dst[0].inst = inst2;
+
+	double base_bw = 0;
+	for(size_t s = 0; s < splits.size(); s++) {
+	  Config::memcpy_parallel_pieces = splits[s];
+
+	  // first copy is a warmup
+	  int reps = std::max(TestConfig::copy_reps, 1);
+	  long long total_time = 0;
+	  for(int rep = 0; rep <= reps; rep++) {
+	    d.fill(dst, ProfilingRequestSet(), &fill_value, sizeof(fill_value)).wait();
+	    long long t = time_copy(d, src, dst, p);
+	    if(rep > 0)
+	      total_time += t;
+	  }
+	  double bw = (1.0 * elements * sizeof(void *) * reps / total_time);
+	  if(s == 0)
+	    base_bw = bw;
+
+	  log_app.print() << "copy scaling " << m1 << " -> " << m2
+			  << ": split=" << splits[s] << " bw:" << bw
+			  << " speedup:" << (bw / base_bw);
+
+	  // check the last copy
+	  AffineAccessor<uintptr_t, 1> ra(inst2, 0);
+	  size_t bad = 0;
+	  for(size_t i = 0; i < elements; i++)
+	    if(ra[i] != (i * sizeof(uintptr_t))) {
+	      if(bad == 0)
+		log_app.error() << "copy scaling " << m1 << " -> " << m2
+				<< ": split=" << splits[s] << " element " << i
+				<< " = " << ra[i] << " (expected "
+				<< (i * sizeof(uintptr_t)) << ")";
+	      bad++;
+	    }
+	  if(bad > 0) {
+	    log_app.error() << "copy scaling " << m1 << " -> " << m2
+			    << ": split=" << splits[s] << " " << bad
+			    << " of " << elements << " elements wrong";
+	    errors++;
+	  }
+	}
+	Config::memcpy_parallel_pieces = max_split;
+
+	inst2.destroy();
+      }
+
+      inst1.destroy();
+    }
+
+    if(errors > 0) {
+      log_app.fatal() << "copy scaling: " << errors << " bad copies";
+      exit(1);
+    }
+  }
+
   // HACK: there's a shutdown race condition related to instance destruction
   usleep(100000);
 }
@@ -419,7 +572,8 @@ int main(int argc, char **argv)
     .add_option_int("-tasks", TestConfig::do_tasks)
     .add_option_int("-copies", TestConfig::do_copies)
     .add_option_int("-reps", TestConfig::copy_reps)
-    .add_option_int("-slowmem", TestConfig::slow_mems);
+    .add_option_int("-slowmem", TestConfig::slow_mems)
+    .add_option_int("-scaling", TestConfig::copy_scaling);
   bool ok = cp.parse_command_line(argc, const_cast<const char **>(argv));
   assert(ok);
 
@@ -0,0 +1,243 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Realm test for the OpenMP runtime provided by OpenMP processors:
+//  explicit tasks and taskwait, depend clause ordering, taskyield,
+//  guided and runtime loop schedules and reductions (which go through
+//  __kmpc_reduce when built with a kmp-style compiler)
+
+#include <realm.h>
+#include <realm/cmdline.h>
+
+#include <omp.h>
+
+#include <vector>
+
+using namespace Realm;
+
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+};
+
+Logger log_app("app");
+
+static int fib(int n)
+{
+  if(n < 2)
+    return n;
+  int a, b;
+#pragma omp task shared(a)
+  a = fib(n - 1);
+#pragma omp task shared(b)
+  b = fib(n - 2);
+#pragma omp taskwait
+  return a + b;
+}
+
+static void spin(int count)
+{
+  volatile int x = 0;
+  for(int i = 0; i < count; i++)
+    x = x + i;
+}
+
+static int test_tasks(void)
+{
+  int result = 0;
+#pragma omp parallel
+#pragma omp single
+  result = fib(20);
+
+  if(result != 6765) {
+    log_app.error() << "fib(20): expected 6765, got " << result;
+    return 1;
+  }
+  return 0;
+}
+
+static int test_depend(int count)
+{
+  int errors = 0;
+  int x = 0;
+  std::vector<int> seen(count, -1);
+
+#pragma omp parallel
+#pragma omp single
+  for(int i = 0; i < count; i++) {
+    // each writer must follow the previous writer and all its readers
+#pragma omp task depend(inout: x) shared(x, errors) firstprivate(i)
+    {
+      if(x != i) {
+#pragma omp atomic
+	errors++;
+      }
+      spin(1000);
+      x = i + 1;
+    }
+    // readers may run concurrently, but only between the writers
+    for(int j = 0; j < 3; j++) {
+#pragma omp task depend(in: x) shared(x, seen, errors) firstprivate(i)
+      {
+	spin(1000);
+	if(x != (i + 1)) {
+#pragma omp atomic
+	  errors++;
+	}
+	seen[i] = x;
+      }
+    }
+  }
+
+  for(int i = 0; i < count; i++)
+    if(seen[i] != (i + 1))
+      errors++;
+  if(errors > 0)
+    log_app.error() << "depend: " << errors << " out-of-order tasks";
+  return errors;
+}
+
+static int test_taskyield(int count)
+{
+  // every task waits until all of them have started, which is only
+  //  possible if a thread can start another task at a taskyield
+  int started = 0;
+#pragma omp parallel
+#pragma omp single
+  for(int i = 0; i < count; i++) {
+#pragma omp task shared(started)
+    {
+#pragma omp atomic
+      started++;
+      while(true) {
+	int cur;
+#pragma omp atomic read
+	cur = started;
+	if(cur >= count)
+	  break;
+#pragma omp taskyield
+      }
+    }
+  }
+
+  if(started != count) {
+    log_app.error() << "taskyield: " << started << " of " << count << " tasks started";
+    return 1;
+  }
+  return 0;
+}
+
+static int check_hits(const char *name, const std::vector<int>& hits)
+{
+  int errors = 0;
+  for(size_t i = 0; i < hits.size(); i++)
+    if(hits[i] != 1)
+      errors++;
+  if(errors > 0)
+    log_app.error() << name << " schedule: " << errors << " iterations not run exactly once";
+  return errors;
+}
+
+static int test_schedules(int count)
+{
+  int errors = 0;
+
+  std::vector<int> guided(count, 0);
+#pragma omp parallel for schedule(guided, 3)
+  for(int i = 0; i < count; i++)
+    guided[i]++;
+  errors += check_hits("guided", guided);
+
+  omp_set_schedule(omp_sched_guided, 5);
+  std::vector<int> runtime_guided(count, 0);
+#pragma omp parallel for schedule(runtime)
+  for(int i = 0; i < count; i++)
+    runtime_guided[i]++;
+  errors += check_hits("runtime(guided)", runtime_guided);
+
+  omp_set_schedule(omp_sched_dynamic, 7);
+  std::vector<int> runtime_dynamic(count, 0);
+#pragma omp parallel for schedule(runtime)
+  for(int i = 0; i < count; i++)
+    runtime_dynamic[i]++;
+  errors += check_hits("runtime(dynamic)", runtime_dynamic);
+
+  return errors;
+}
+
+static int test_reduction(int count)
+{
+  long long sum = 0;
+  double maxval = 0;
+#pragma omp parallel for reduction(+:sum) reduction(max:maxval)
+  for(int i = 0; i < count; i++) {
+    sum += i;
+    if(i > maxval)
+      maxval = i;
+  }
+
+  long long expected = (long long)count * (count - 1) / 2;
+  if((sum != expected) || (maxval != (count - 1))) {
+    log_app.error() << "reduction: expected sum=" << expected << " max=" << (count - 1)
+		    << ", got sum=" << sum << " max=" << maxval;
+    return 1;
+  }
+  return 0;
+}
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  int errors = 0;
+
+  errors += test_tasks();
+  errors += test_depend(100);
+  errors += test_taskyield(16);
+  errors += test_schedules(10000);
+  errors += test_reduction(100000);
+
+  if(errors == 0)
+    log_app.info() << "completed successfully";
+  else
+    log_app.error() << errors << " errors";
+
+  Runtime::get_runtime().shutdown(Event::NO_EVENT, (errors == 0) ? 0 : 1);
+}
+
+int main(int argc, const char **argv)
+{
+  Runtime rt;
+
+  rt.init(&argc, (char ***)&argv);
+
+  // the OpenMP runtime is only available on OpenMP processors (i.e. run
+  //  with -ll:ocpu 1)
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::OMP_PROC)
+    .first();
+  assert(p.exists());
+
+  Processor::register_task_by_kind(p.kind(), false /*!global*/,
+				   TOP_LEVEL_TASK,
+				   CodeDescriptor(top_level_task),
+				   ProfilingRequestSet()).external_wait();
+
+  // collective launch of a single top level task
+  rt.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // now sleep this thread until that shutdown actually happens
+  int ret = rt.wait_for_shutdown();
+
+  return ret;
+}
@@ -0,0 +1,340 @@
+// Copyright 2020 Stanford University
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// test/microbenchmark for Realm's range allocator - replays an allocation
+//  trace (either synthetic or read from a file) against the size-indexed
+//  BasicRangeAllocator and a simple first-fit reference allocator
+
+#include "realm/mem_impl.h"
+#include "realm/timers.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <map>
+#include <vector>
+#include <cassert>
+
+#include "osdep.h"
+
+using namespace Realm;
+
+size_t heap_size = 1 << 30;
+int num_steps = 200000;
+int max_live = 2000;
+int seed = 12345;
+const char *trace_file = 0;
+bool verbose = false;
+
+struct TraceOp {
+  bool is_alloc;
+  int tag;
+  size_t size, alignment;
+};
+
+// the allocator used before free ranges were indexed by size - walks an
+//  address-ordered list of free ranges and takes the first that fits
+class FirstFitAllocator {
+public:
+  void add_range(size_t first, size_t last)
+  {
+    free_ranges[first] = last;
+  }
+
+  bool allocate(int tag, size_t size, size_t alignment, size_t& alloc_first)
+  {
+    for(std::map<size_t, size_t>::iterator it = free_ranges.begin();
+	it != free_ranges.end();
+	++it) {
+      size_t ofs = 0;
+      if(alignment) {
+	size_t rem = it->first % alignment;
+	if(rem > 0)
+	  ofs = alignment - rem;
+      }
+      if((it->second - it->first) < (size + ofs))
+	continue;
+
+      size_t first = it->first;
+      size_t last = it->second;
+      alloc_first = first + ofs;
+      free_ranges.erase(it);
+      if(ofs > 0)
+	free_ranges[first] = alloc_first;
+      if((alloc_first + size) < last)
+	free_ranges[alloc_first + size] = last;
+      allocated[tag] = std::make_pair(alloc_first, alloc_first + size);
+      return true;
+    }
+    return false;
+  }
+
+  void deallocate(int tag)
+  {
+    std::map<int, std::pair<size_t, size_t> >::iterator it = allocated.find(tag);
+    assert(it != allocated.end());
+    size_t first = it->second.first;
+    size_t last = it->second.second;
+    allocated.erase(it);
+
+    // merge with neighbors
+    std::map<size_t, size_t>::iterator next = free_ranges.lower_bound(first);
+    if((next != free_ranges.end()) && (next->first == last)) {
+      last = next->second;
+      free_ranges.erase(next++);
+    }
+    if(next != free_ranges.begin()) {
+      std::map<size_t, size_t>::iterator prev = next;
+      --prev;
+      if(prev->second == first) {
+	first = prev->first;
+	free_ranges.erase(prev);
+      }
+    }
+    free_ranges[first] = last;
+  }
+
+protected:
+  std::map<size_t, size_t> free_ranges;
+  std::map<int, std::pair<size_t, size_t> > allocated;
+};
+
+// mimics a mapper's mix of instance sizes: lots of small instances, some
+//  medium ones, and the occasional large one
+static size_t random_size()
+{
+  int r = lrand48() % 100;
+  if(r < 70)
+    return 64 + (lrand48() % 4096);
+  if(r < 97)
+    return 4096 + (lrand48() % (1 << 20));
+  return (1 << 20) + (lrand48() % (16 << 20));
+}
+
+static void generate_trace(std::vector<TraceOp>& trace)
+{
+  std::vector<int> live;
+  int next_tag = 1;
+  for(int i = 0; i < num_steps; i++) {
+    TraceOp op;
+    // allocate until the live set is full, then mix allocations and frees
+    //  to fragment the heap
+    bool do_alloc = (live.empty() ||
+		     (i < max_live) ||
+		     ((int(live.size()) < max_live) && ((lrand48() % 2) == 0)));
+    if(do_alloc) {
+      op.is_alloc = true;
+      op.tag = next_tag++;
+      op.size = random_size();
+      op.alignment = size_t(16) << (lrand48() % 5);
+      live.push_back(op.tag);
+    } else {
+      size_t idx = lrand48() % live.size();
+      op.is_alloc = false;
+      op.tag = live[idx];
+      op.size = op.alignment = 0;
+      live[idx] = live.back();
+      live.pop_back();
+    }
+    trace.push_back(op);
+  }
+}
+
+// trace file format is one operation per line:
+//   a <tag> <size> <alignment>
+//   f <tag>
+static bool read_trace(const char *filename, std::vector<TraceOp>& trace)
+{
+  FILE *f = fopen(filename, "r");
+  if(!f) {
+    fprintf(stderr, "could not open trace file '%s'\n", filename);
+    return false;
+  }
+  char line[256];
+  while(fgets(line, sizeof(line), f)) {
+    TraceOp op;
+    unsigned long size, alignment;
+    if(sscanf(line, "a %d %lu %lu", &op.tag, &size, &alignment) == 3) {
+      op.is_alloc = true;
+      op.size = size;
+      op.alignment = alignment;
+    } else if(sscanf(line, "f %d", &op.tag) == 1) {
+      op.is_alloc = false;
+      op.size = op.alignment = 0;
+    } else
+      continue;
+    trace.push_back(op);
+  }
+  fclose(f);
+  return true;
+}
+
+// replays the trace, checking that live allocations are aligned, within
+//  the heap, and never overlap
+template <typename ALLOCATOR>
+static void replay_trace(const char *name, ALLOCATOR& alloc,
+			 const std::vector<TraceOp>& trace)
+{
+  alloc.add_range(0, heap_size);
+
+  // first -> (last, tag) for validation
+  std::map<size_t, std::pair<size_t, int> > live;
+  std::map<int, size_t> tag_to_first;
+  std::map<int, bool> failed;
+
+  int failures = 0;
+  long long total_time = 0;
+  for(size_t i = 0; i < trace.size(); i++) {
+    const TraceOp& op = trace[i];
+    if(op.is_alloc) {
+      size_t first = 0;
+      long long t1 = Clock::current_time_in_nanoseconds();
+      bool ok = alloc.allocate(op.tag, op.size, op.alignment, first);
+      long long t2 = Clock::current_time_in_nanoseconds();
+      total_time += (t2 - t1);
+      if(verbose)
+	printf("%s: ALLOC(%d, %zd, %zd) = %d/%zd\n",
+	       name, op.tag, op.size, op.alignment, ok, first);
+      if(!ok) {
+	failures++;
+	failed[op.tag] = true;
+	continue;
+      }
+
+      assert((first % op.alignment) == 0);
+      assert((first + op.size) <= heap_size);
+      std::map<size_t, std::pair<size_t, int> >::iterator it = live.lower_bound(first);
+      if(it != live.end())
+	assert(it->first >= (first + op.size));
+      if(it != live.begin()) {
+	--it;
+	assert(it->second.first <= first);
+      }
+      live[first] = std::make_pair(first + op.size, op.tag);
+      tag_to_first[op.tag] = first;
+    } else {
+      // frees of failed allocations are skipped
+      if(failed.erase(op.tag) > 0)
+	continue;
+
+      long long t1 = Clock::current_time_in_nanoseconds();
+      alloc.deallocate(op.tag);
+      long long t2 = Clock::current_time_in_nanoseconds();
+      total_time += (t2 - t1);
+      if(verbose)
+	printf("%s: FREE(%d)\n", name, op.tag);
+
+      std::map<int, size_t>::iterator it = tag_to_first.find(op.tag);
+      assert(it != tag_to_first.end());
+      live.erase(it->second);
+      tag_to_first.erase(it);
+    }
+  }
+
+  printf("%s: ops=%zd failures=%d time=%.3f ms (%.1f ns/op)\n",
+	 name, trace.size(), failures, 1e-6 * total_time,
+	 (trace.empty() ? 0.0 : (1.0 * total_time / trace.size())));
+}
+
+// leaves 'holes' free 4KB ranges whose starts are only 16B-aligned and then
+//  asks for a 4KB-aligned 4KB range - if 'fill_tail' is set, the rest of
+//  the heap is allocated, so the only ranges that work are the holes that
+//  happen to be aligned (every 256th one)
+static bool check_aligned_fit(int holes, bool fill_tail)
+{
+  const size_t hole_size = 4096;
+  BasicRangeAllocator<size_t, int> alloc;
+  alloc.add_range(0, heap_size);
+
+  size_t first;
+  int tag = 0;
+  bool ok = alloc.allocate(tag++, 16, 16, first);
+  for(int i = 0; ok && (i < holes); i++)
+    ok = (alloc.allocate(tag++, hole_size, 16, first) &&
+	  alloc.allocate(tag++, 16, 16, first));
+  if(ok && fill_tail)
+    ok = alloc.allocate(tag++, heap_size - (first + 16), 16, first);
+  if(!ok) {
+    printf("aligned fit: setup failed (heap too small?)\n");
+    return false;
+  }
+  for(int i = 0; i < holes; i++)
+    alloc.deallocate(1 + 2 * i);
+
+  long long t1 = Clock::current_time_in_nanoseconds();
+  ok = alloc.allocate(tag++, hole_size, hole_size, first);
+  long long t2 = Clock::current_time_in_nanoseconds();
+  printf("aligned fit: holes=%d fill_tail=%d ok=%d first=%zd time=%lld ns\n",
+	 holes, fill_tail, ok, first, t2 - t1);
+  return ok && ((first % hole_size) == 0);
+}
+
+int main(int argc, const char *argv[])
+{
+  // parse args
+  for(int i = 1; i < argc; i++) {
+    if(!strcmp(argv[i], "-s")) {
+      seed = atoi(argv[++i]);
+      continue;
+    }
+    if(!strcmp(argv[i], "-i")) {
+      num_steps = atoi(argv[++i]);
+      continue;
+    }
+    if(!strcmp(argv[i], "-l")) {
+      max_live = atoi(argv[++i]);
+      continue;
+    }
+    if(!strcmp(argv[i], "-m")) {
+      heap_size = size_t(atoi(argv[++i])) << 20;
+      continue;
+    }
+    if(!strcmp(argv[i], "-f")) {
+      trace_file = argv[++i];
+      continue;
+    }
+    if(!strcmp(argv[i], "-v")) {
+      verbose = true;
+      continue;
+    }
+  }
+
+  srand48(seed);
+
+  std::vector<TraceOp> trace;
+  if(trace_file) {
+    if(!read_trace(trace_file, trace))
+      return 1;
+  } else
+    generate_trace(trace);
+
+  {
+    BasicRangeAllocator<size_t, int> alloc;
+    replay_trace("best-fit", alloc, trace);
+  }
+
+  {
+    FirstFitAllocator alloc;
+    replay_trace("first-fit", alloc, trace);
+  }
+
+  // the alignment scan must stay short when a range that is sure to fit
+  //  exists, and must still find an aligned hole when none does
+  if(!check_aligned_fit(20000, false) || !check_aligned_fit(300, true))
+    return 1;
+
+  return 0;
+}
@@ -0,0 +1,188 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Realm test for restarting a shm job whose previous run died before its
+//  ranks attached: started without REALM_SHM_RANK, this process acts as
+//  the external launcher - it kills a rank 0 that is waiting for its peer
+//  (leaving the control object behind), starts rank 1 so that it finds
+//  that stale object, and only then starts a new rank 0, which has to end
+//  up with rank 1 in the same (new) object
+
+#include <realm.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <vector>
+
+using namespace Realm;
+
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+  REMOTE_TASK,
+};
+
+Logger log_app("app");
+
+void remote_task(const void *args, size_t arglen,
+		 const void *userdata, size_t userlen, Processor p)
+{
+  log_app.info() << "remote task on " << p;
+}
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  int errors = 0;
+
+  // run something on every other rank to show the queues are shared
+  std::vector<Event> events;
+  Machine::ProcessorQuery pq(Machine::get_machine());
+  pq.only_kind(p.kind());
+  for(Machine::ProcessorQuery::iterator it = pq.begin(); it != pq.end(); ++it)
+    if((*it).address_space() != p.address_space())
+      events.push_back((*it).spawn(REMOTE_TASK, 0, 0));
+  if(events.empty()) {
+    log_app.error() << "no processors on other ranks";
+    errors++;
+  }
+  Event::merge_events(events).wait();
+
+  if(errors == 0)
+    log_app.info() << "completed successfully";
+
+  Runtime::get_runtime().shutdown(Event::NO_EVENT, (errors == 0) ? 0 : 1);
+}
+
+static int run_rank(int argc, const char **argv)
+{
+  Runtime rt;
+
+  rt.init(&argc, (char ***)&argv);
+
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  assert(p.exists());
+
+  Processor::register_task_by_kind(p.kind(), false /*!global*/,
+				   TOP_LEVEL_TASK,
+				   CodeDescriptor(top_level_task),
+				   ProfilingRequestSet()).external_wait();
+  Processor::register_task_by_kind(p.kind(), false /*!global*/,
+				   REMOTE_TASK,
+				   CodeDescriptor(remote_task),
+				   ProfilingRequestSet()).external_wait();
+
+  // collective launch of a single top level task
+  rt.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // now sleep this thread until that shutdown actually happens
+  return rt.wait_for_shutdown();
+}
+
+static pid_t start_rank(int rank, int argc, const char **argv)
+{
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if(pid < 0) {
+    perror("fork");
+    exit(1);
+  }
+  if(pid == 0) {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%d", rank);
+    setenv("REALM_SHM_RANK", buffer, 1);
+    _exit(run_rank(argc, argv));
+  }
+  return pid;
+}
+
+// waits up to 'seconds' for the process to exit, killing it after that
+static bool wait_rank(pid_t pid, const char *name, int seconds)
+{
+  int status = 0;
+  for(int i = 0; i < seconds * 10; i++) {
+    if(waitpid(pid, &status, WNOHANG) == pid) {
+      if(WIFEXITED(status) && (WEXITSTATUS(status) == 0))
+	return true;
+      fprintf(stderr, "%s exited abnormally: status=%d\n", name, status);
+      return false;
+    }
+    usleep(100000);
+  }
+  fprintf(stderr, "%s did not finish in %d seconds\n", name, seconds);
+  kill(pid, SIGKILL);
+  waitpid(pid, &status, 0);
+  return false;
+}
+
+int main(int argc, const char **argv)
+{
+  if(getenv("REALM_SHM_RANK"))
+    return run_rank(argc, argv);
+
+  char session[64];
+  snprintf(session, sizeof(session), "/realm_shm_restart.%d", int(getpid()));
+  setenv("REALM_SHM_RANKS", "2", 1);
+  setenv("REALM_SHM_SESSION", session, 1);
+
+  // the first rank 0 creates the control object and waits for rank 1,
+  //  which never comes
+  pid_t dead = start_rank(0, argc, argv);
+  bool created = false;
+  for(int i = 0; (i < 600) && !created; i++) {
+    int fd = shm_open(session, O_RDONLY, 0600);
+    struct stat st;
+    if(fd >= 0) {
+      created = ((fstat(fd, &st) == 0) && (st.st_size > 0));
+      close(fd);
+    }
+    if(!created)
+      usleep(100000);
+  }
+  usleep(100000);
+  kill(dead, SIGKILL);
+  int status;
+  waitpid(dead, &status, 0);
+  if(!created) {
+    fprintf(stderr, "first rank 0 never created '%s'\n", session);
+    shm_unlink(session);
+    return 1;
+  }
+
+  // rank 1 finds the stale object before the new rank 0 replaces it
+  pid_t rank1 = start_rank(1, argc, argv);
+  usleep(500000);
+  pid_t rank0 = start_rank(0, argc, argv);
+
+  bool ok0 = wait_rank(rank0, "rank 0", 120);
+  bool ok1 = wait_rank(rank1, "rank 1", ok0 ? 30 : 1);
+
+  // nothing should be left behind, but don't leave junk if it is
+  shm_unlink(session);
+
+  if(!ok0 || !ok1)
+    return 1;
+  printf("stale shm session restarted successfully\n");
+  return 0;
+}
@@ -0,0 +1,176 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Realm test for sparsity maps whose entries have been turned into bitmaps -
+//  index spaces made of many scattered points are queried (volume, contains,
+//  contains_all, contains_any, iteration) from application code
+
+#include <realm.h>
+#include <realm/cmdline.h>
+
+#include <vector>
+#include <set>
+
+#include "osdep.h"
+
+using namespace Realm;
+
+enum {
+  TOP_LEVEL_TASK = Processor::TASK_ID_FIRST_AVAILABLE+0,
+};
+
+Logger log_app("app");
+
+namespace TestConfig {
+  int size = 256;  // extent of the index space in each dimension
+};
+
+// a point is present if this is true - about 1 in 5 points, scattered so
+//  that no two neighbors along dimension 0 merge into a larger rectangle
+template <int N>
+static bool is_present(const Point<N>& p)
+{
+  int h = 0;
+  for(int i = 0; i < N; i++)
+    h += p[i] * (7 + 4 * i);
+  return ((h % 5) == 0);
+}
+
+template <int N>
+static int test_bitmap_space(void)
+{
+  Rect<N> bounds;
+  for(int i = 0; i < N; i++) {
+    bounds.lo[i] = 0;
+    bounds.hi[i] = ((N == 1) ? (TestConfig::size * TestConfig::size) :
+		    TestConfig::size) - 1;
+  }
+
+  std::vector<Point<N> > points;
+  for(PointInRectIterator<N> pir(bounds); pir.valid; pir.step())
+    if(is_present(pir.p))
+      points.push_back(pir.p);
+
+  IndexSpace<N> is(points);
+  is.make_valid().wait();
+
+  int errors = 0;
+
+  const std::vector<SparsityMapEntry<N,int> >& entries = is.sparsity.impl()->get_entries();
+  size_t bitmap_entries = 0;
+  for(size_t i = 0; i < entries.size(); i++)
+    if(entries[i].bitmap != 0)
+      bitmap_entries++;
+  log_app.print() << "N=" << N << ": points=" << points.size()
+		  << " entries=" << entries.size()
+		  << " bitmaps=" << bitmap_entries;
+  if(bitmap_entries == 0) {
+    log_app.error() << "N=" << N << ": no bitmap entries were created";
+    errors++;
+  }
+
+  if(is.volume() != points.size()) {
+    log_app.error() << "N=" << N << ": volume mismatch: expected="
+		    << points.size() << " actual=" << is.volume();
+    errors++;
+  }
+
+  size_t iterated = 0;
+  for(IndexSpaceIterator<N> it(is); it.valid; it.step())
+    for(PointInRectIterator<N> pir(it.rect); pir.valid; pir.step()) {
+      if(!is_present(pir.p)) {
+	log_app.error() << "N=" << N << ": iterated missing point " << pir.p;
+	errors++;
+      }
+      iterated++;
+    }
+  if(iterated != points.size()) {
+    log_app.error() << "N=" << N << ": iteration mismatch: expected="
+		    << points.size() << " actual=" << iterated;
+    errors++;
+  }
+
+  // single points and small boxes, checked against the predicate
+  for(PointInRectIterator<N> pir(bounds); pir.valid; pir.step()) {
+    if(is.contains(pir.p) != is_present(pir.p)) {
+      log_app.error() << "N=" << N << ": contains mismatch at " << pir.p;
+      errors++;
+    }
+    Rect<N> box(pir.p, pir.p);
+    if(is.contains_all(box) != is_present(pir.p)) {
+      log_app.error() << "N=" << N << ": contains_all mismatch at " << box;
+      errors++;
+    }
+    box.hi[0] += 4;  // always covers at least one present point
+    if(!is.contains_any(box) && (box.hi[0] <= bounds.hi[0])) {
+      log_app.error() << "N=" << N << ": contains_any mismatch at " << box;
+      errors++;
+    }
+    if(is.contains_all(box)) {
+      log_app.error() << "N=" << N << ": contains_all true for sparse box " << box;
+      errors++;
+    }
+    if(errors > 10) break;
+  }
+
+  is.destroy();
+  return errors;
+}
+
+void top_level_task(const void *args, size_t arglen,
+		    const void *userdata, size_t userlen, Processor p)
+{
+  int errors = 0;
+  errors += test_bitmap_space<1>();
+  errors += test_bitmap_space<2>();
+
+  if(errors == 0)
+    log_app.info() << "completed successfully";
+
+  Runtime::get_runtime().shutdown(Event::NO_EVENT, (errors == 0) ? 0 : 1);
+}
+
+int main(int argc, const char **argv)
+{
+  Runtime rt;
+
+  rt.init(&argc, (char ***)&argv);
+
+  CommandLineParser cp;
+  cp.add_option_int("-s", TestConfig::size);
+  bool ok = cp.parse_command_line(argc, argv);
+  assert(ok);
+
+  // try to use a cpu proc, but if that doesn't exist, take whatever we can get
+  Processor p = Machine::ProcessorQuery(Machine::get_machine())
+    .only_kind(Processor::LOC_PROC)
+    .first();
+  if(!p.exists())
+    p = Machine::ProcessorQuery(Machine::get_machine()).first();
+  assert(p.exists());
+
+  Processor::register_task_by_kind(p.kind(), false /*!global*/,
+				   TOP_LEVEL_TASK,
+				   CodeDescriptor(top_level_task),
+				   ProfilingRequestSet()).external_wait();
+
+  // collective launch of a single top level task
+  rt.collective_spawn(p, TOP_LEVEL_TASK, 0, 0);
+
+  // now sleep this thread until that shutdown actually happens
+  int ret = rt.wait_for_shutdown();
+
+  return ret;
+}
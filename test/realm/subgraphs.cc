@@ -21,6 +21,7 @@ enum {
   WRITER_TASK,
   READER_TASK,
   CLEANUP_TASK,
+  EMPTY_TASK,
 };
 
 enum {
@@ -73,9 +74,29 @@ void writer_task(const void *args, size_t arglen,
 
 int correct = 0;
 
+// benchmark settings - graph sizes from bench_min_ops to bench_max_ops
+//  (stepping by 10x), each instantiated bench_reps times
+bool do_bench = false;
+int bench_min_ops = 1000;
+int bench_max_ops = 100000;
+int bench_reps = 5;
+int bench_width = 64;
+
+void empty_task(const void *args, size_t arglen,
+		const void *userdata, size_t userlen, Processor p)
+{
+}
+
 void reader_task(const void *args, size_t arglen, 
 		 const void *userdata, size_t userlen, Processor p)
 {
+  // tasks deferred by a subgraph only get a finish event once they ask for
+  //  one - make sure that still works
+  if(!Processor::get_current_finish_event().exists()) {
+    log_app.error() << "reader task has no finish event";
+    return;
+  }
+
   const ReaderTaskArgs& rargs = *reinterpret_cast<const ReaderTaskArgs *>(args);
   AffineAccessor<int, 1> acc(rargs.inst, FID_DATA);
   for(IndexSpaceIterator<1> it(rargs.is); it.valid; it.step())
@@ -148,11 +169,66 @@ static size_t compute_offset(U T::*field_ptr)
 #define OFFSETOF(type, field) \
   compute_offset<type>(&type::field)
 
+// builds a layered graph of 'num_ops' empty tasks, 'bench_width' tasks per
+//  layer, where each task depends on two tasks in the previous layer, and
+//  measures the time to compile it and to instantiate it
+void run_benchmark(Processor p, int num_ops)
+{
+  SubgraphDefinition sd;
+  sd.tasks.resize(num_ops);
+  for(int i = 0; i < num_ops; i++) {
+    sd.tasks[i].proc = p;
+    sd.tasks[i].task_id = EMPTY_TASK;
+  }
+  // list tasks in reverse order so that the compile has to actually sort
+  for(int i = bench_width; i < num_ops; i++) {
+    int layer_start = i - (i % bench_width);
+    int prev = layer_start - bench_width;
+    SubgraphDefinition::Dependency dep;
+    dep.src_op_kind = SubgraphDefinition::OPKIND_TASK;
+    dep.tgt_op_kind = SubgraphDefinition::OPKIND_TASK;
+    dep.tgt_op_index = num_ops - 1 - i;
+    dep.src_op_index = num_ops - 1 - (prev + (i % bench_width));
+    sd.dependencies.push_back(dep);
+    dep.src_op_index = num_ops - 1 - (prev + ((i + 1) % bench_width));
+    sd.dependencies.push_back(dep);
+  }
+
+  Subgraph sg;
+  long long t1 = Clock::current_time_in_nanoseconds();
+  Subgraph::create_subgraph(sg, sd, ProfilingRequestSet()).wait();
+  long long t2 = Clock::current_time_in_nanoseconds();
+
+  // first instantiation warms up the task launch path
+  sg.instantiate(0, 0, ProfilingRequestSet()).wait();
+
+  long long t3 = Clock::current_time_in_nanoseconds();
+  for(int i = 0; i < bench_reps; i++)
+    sg.instantiate(0, 0, ProfilingRequestSet()).wait();
+  long long t4 = Clock::current_time_in_nanoseconds();
+
+  sg.destroy();
+
+  double inst_ns = double(t4 - t3) / bench_reps;
+  log_app.print() << "subgraph bench: ops=" << num_ops
+		  << " deps=" << sd.dependencies.size()
+		  << " compile=" << (1e-6 * (t2 - t1)) << " ms"
+		  << " instantiate=" << (1e-6 * inst_ns) << " ms"
+		  << " (" << (inst_ns / num_ops) << " ns/op)";
+}
+
 void top_level_task(const void *args, size_t arglen, 
 		    const void *userdata, size_t userlen, Processor p)
 {
   log_app.print() << "Realm subgraphs test";
 
+  if(do_bench) {
+    for(int n = bench_min_ops; n <= bench_max_ops; n *= 10)
+      run_benchmark(p, n);
+    Runtime::get_runtime().shutdown(Event::NO_EVENT, 0);
+    return;
+  }
+
   // do everything on this processor - get a good memory to use
   Memory m = Machine::MemoryQuery(Machine::get_machine()).has_affinity_to(p).first();
   assert(m.exists());
@@ -396,20 +472,34 @@ int main(int argc, char **argv)
 
   rt.init(&argc, &argv);
 
-#if 0
   for(int i = 1; i < argc; i++) {
-    if(!strcmp(argv[i], "-b")) {
-      buffer_size = strtoll(argv[++i], 0, 10);
+    if(!strcmp(argv[i], "-bench")) {
+      do_bench = true;
+      continue;
+    }
+    if(!strcmp(argv[i], "-bench_min")) {
+      bench_min_ops = atoi(argv[++i]);
+      continue;
+    }
+    if(!strcmp(argv[i], "-bench_max")) {
+      bench_max_ops = atoi(argv[++i]);
+      continue;
+    }
+    if(!strcmp(argv[i], "-bench_reps")) {
+      bench_reps = atoi(argv[++i]);
+      continue;
+    }
+    if(!strcmp(argv[i], "-bench_width")) {
+      bench_width = atoi(argv[++i]);
       continue;
     }
-
   }
-#endif
 
   rt.register_task(TOP_LEVEL_TASK, top_level_task);
   rt.register_task(WRITER_TASK, writer_task);
   rt.register_task(READER_TASK, reader_task);
   rt.register_task(CLEANUP_TASK, cleanup_task);
+  rt.register_task(EMPTY_TASK, empty_task);
 
   rt.register_reduction(REDOP_INT_ADD,
 			ReductionOpUntyped::create_reduction_op<ReductionOpIntAdd>());
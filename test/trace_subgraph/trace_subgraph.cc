@@ -0,0 +1,163 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replays a physical trace made of fills, copies and reduction copies
+//  enough times that its template gets lowered into a Realm subgraph
+//  (run with -dm:memoize -lg:subgraph_replay <n>) and then checks that
+//  the data looks the same as if every operation had been issued directly
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "legion.h"
+
+using namespace Legion;
+
+enum TaskIDs {
+  TID_TOP_LEVEL,
+};
+
+enum FieldIDs {
+  FID_X = 11,
+  FID_Y = 12,
+  FID_SUM = 13,
+};
+
+enum TraceIDs {
+  TRACE_ID = 100,
+};
+
+static int check_field(Context ctx, Runtime *runtime, LogicalRegion lr,
+                       FieldID fid, double expected, const char *name)
+{
+  InlineLauncher launcher(
+      RegionRequirement(lr, LEGION_READ_ONLY, LEGION_EXCLUSIVE, lr)
+      .add_field(fid));
+  PhysicalRegion pr = runtime->map_region(ctx, launcher);
+  pr.wait_until_valid();
+  const FieldAccessor<LEGION_READ_ONLY,double,1,coord_t,
+        Realm::AffineAccessor<double,1,coord_t> > acc(pr, fid);
+  int errors = 0;
+  Rect<1> bounds = runtime->get_index_space_domain(ctx, lr.get_index_space());
+  for (PointInRectIterator<1> pir(bounds); pir(); pir++)
+    if (acc[*pir] != expected)
+    {
+      if (errors++ < 10)
+        printf("ERROR: %s[%lld] = %g, expected %g\n", name,
+               (long long)(*pir)[0], acc[*pir], expected);
+    }
+  runtime->unmap_region(ctx, pr);
+  return errors;
+}
+
+void top_level_task(const Task *task,
+                    const std::vector<PhysicalRegion> &regions,
+                    Context ctx, Runtime *runtime)
+{
+  int num_elements = 1024;
+  int num_iterations = 10;
+  {
+    const InputArgs &command_args = Runtime::get_input_args();
+    for (int i = 1; i < command_args.argc; i++)
+    {
+      if (!strcmp(command_args.argv[i],"-n"))
+        num_elements = atoi(command_args.argv[++i]);
+      if (!strcmp(command_args.argv[i],"-i"))
+        num_iterations = atoi(command_args.argv[++i]);
+    }
+  }
+
+  Rect<1> bounds(0, num_elements-1);
+  IndexSpace is = runtime->create_index_space(ctx, bounds);
+  FieldSpace fs = runtime->create_field_space(ctx);
+  {
+    FieldAllocator fsa = runtime->create_field_allocator(ctx, fs);
+    fsa.allocate_field(sizeof(double), FID_X);
+    fsa.allocate_field(sizeof(double), FID_Y);
+    fsa.allocate_field(sizeof(double), FID_SUM);
+  }
+  LogicalRegion src = runtime->create_logical_region(ctx, is, fs);
+  LogicalRegion dst = runtime->create_logical_region(ctx, is, fs);
+
+  runtime->fill_field<double>(ctx, dst, dst, FID_SUM, 0.0);
+
+  for (int iter = 0; iter < num_iterations; iter++)
+  {
+    runtime->begin_trace(ctx, TRACE_ID);
+    // two fields filled by one fill operation with the same value and
+    //  a third filled on its own with a different one
+    {
+      std::set<FieldID> fields;
+      fields.insert(FID_X);
+      fields.insert(FID_Y);
+      runtime->fill_fields<double>(ctx, src, src, fields, 1.5);
+    }
+    runtime->fill_field<double>(ctx, src, src, FID_SUM, 2.0);
+    // plain copies of both filled fields
+    {
+      CopyLauncher launcher;
+      launcher.add_copy_requirements(
+          RegionRequirement(src, LEGION_READ_ONLY, LEGION_EXCLUSIVE, src),
+          RegionRequirement(dst, LEGION_WRITE_DISCARD, LEGION_EXCLUSIVE, dst));
+      launcher.add_src_field(0, FID_X);
+      launcher.add_dst_field(0, FID_X);
+      launcher.add_src_field(0, FID_Y);
+      launcher.add_dst_field(0, FID_Y);
+      runtime->issue_copy_operation(ctx, launcher);
+    }
+    // a reduction copy that accumulates across iterations
+    {
+      CopyLauncher launcher;
+      launcher.add_copy_requirements(
+          RegionRequirement(src, LEGION_READ_ONLY, LEGION_EXCLUSIVE, src),
+          RegionRequirement(dst, LEGION_REDOP_SUM_FLOAT64,
+                            LEGION_EXCLUSIVE, dst));
+      launcher.add_src_field(0, FID_SUM);
+      launcher.add_dst_field(0, FID_SUM);
+      runtime->issue_copy_operation(ctx, launcher);
+    }
+    runtime->end_trace(ctx, TRACE_ID);
+  }
+
+  int errors = 0;
+  errors += check_field(ctx, runtime, dst, FID_X, 1.5, "x");
+  errors += check_field(ctx, runtime, dst, FID_Y, 1.5, "y");
+  errors += check_field(ctx, runtime, dst, FID_SUM, 2.0 * num_iterations,
+                        "sum");
+
+  runtime->destroy_logical_region(ctx, src);
+  runtime->destroy_logical_region(ctx, dst);
+  runtime->destroy_field_space(ctx, fs);
+  runtime->destroy_index_space(ctx, is);
+
+  if (errors > 0)
+  {
+    printf("FAILED: %d errors\n", errors);
+    exit(1);
+  }
+  printf("SUCCESS\n");
+}
+
+int main(int argc, char **argv)
+{
+  {
+    TaskVariantRegistrar registrar(TID_TOP_LEVEL, "top_level");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    Runtime::preregister_task_variant<top_level_task>(registrar, "top_level");
+    Runtime::set_top_level_task_id(TID_TOP_LEVEL);
+  }
+  return Runtime::start(argc, argv);
+}
@@ -62,6 +62,7 @@ memory_kinds = {
     9 : 'L3 Cache',
     10 : 'L2 Cache',
     11 : 'L1 Cache',
+    12 : 'Mapped File',
 }
 # Make sure this is up to date with memory_kinds
 memory_node_proc = {
@@ -77,6 +78,7 @@ memory_node_proc = {
     'L3 Cache': 'Node_id',
     'L2 Cache': 'Proc_id',
     'L1 Cache': 'Proc_id',
+    'Mapped File': 'Node_id',
 }
 
 memory_kinds_abbr = {
@@ -92,6 +94,7 @@ memory_kinds_abbr = {
     'L3 Cache': ' l3',
     'L2 Cache': ' l2',
     'L1 Cache': ' l1',
+    'Mapped File': ' mfile',
 }
 
 # Make sure this is up to date with legion_types.h
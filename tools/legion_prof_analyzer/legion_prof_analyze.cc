@@ -0,0 +1,133 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Command line front end for the streaming Legion Prof log analyzer:
+//
+//   legion_prof_analyze [-j N] [--top N] [--no-histograms]
+//                       [--no-launch-chain] prof_0.gz prof_1.gz ...
+//
+// Each input file is read by one of N worker threads and reduced to a
+// per-thread Summary; the summaries are merged at the end.  The launch
+// chain then rereads the logs to find the launchers of the last task.
+
+#include "legion_prof_summary.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+using namespace LegionProf;
+
+static void usage(const char *argv0)
+{
+  fprintf(stderr, "usage: %s [options] <binary prof logs...>\n"
+          "  -j N                 number of files to read in parallel "
+          "(default: number of cores)\n"
+          "  --top N              rows to print per table, 0 for all "
+          "(default: 20)\n"
+          "  --no-histograms      omit per-kind duration histograms\n"
+          "  --no-launch-chain    skip following provenance back from the "
+          "last task,\n"
+          "                       which rereads the logs\n",
+          argv0);
+}
+
+int main(int argc, char **argv)
+{
+  unsigned num_threads = std::thread::hardware_concurrency();
+  bool launch_chain = true;
+  Summary::ReportOptions options;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-j") && ((i+1) < argc))
+      num_threads = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--top") && ((i+1) < argc))
+      options.top = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "--no-histograms"))
+      options.histograms = false;
+    else if (!strcmp(argv[i], "--no-launch-chain"))
+      launch_chain = false;
+    else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help"))
+    {
+      usage(argv[0]);
+      return 0;
+    }
+    else if (argv[i][0] == '-')
+    {
+      usage(argv[0]);
+      return 1;
+    }
+    else
+      files.push_back(argv[i]);
+  }
+  if (files.empty())
+  {
+    usage(argv[0]);
+    return 1;
+  }
+  if (num_threads == 0)
+    num_threads = 1;
+  if (num_threads > files.size())
+    num_threads = files.size();
+
+  std::vector<Summary*> summaries(num_threads);
+  std::atomic<size_t> next_file(0);
+  std::atomic<unsigned> failures(0);
+  std::mutex error_lock;
+  std::vector<std::thread> workers;
+  for (unsigned idx = 0; idx < num_threads; idx++)
+  {
+    summaries[idx] = new Summary(launch_chain);
+    Summary *summary = summaries[idx];
+    workers.push_back(std::thread([&, summary]() {
+      while (true)
+      {
+        const size_t index = next_file.fetch_add(1);
+        if (index >= files.size())
+          break;
+        std::string error;
+        if (!summary->process_file(files[index], error))
+        {
+          failures++;
+          std::lock_guard<std::mutex> guard(error_lock);
+          fprintf(stderr, "ERROR: %s\n", error.c_str());
+        }
+      }
+    }));
+  }
+  for (unsigned idx = 0; idx < workers.size(); idx++)
+    workers[idx].join();
+  for (unsigned idx = 1; idx < num_threads; idx++)
+  {
+    summaries[0]->merge(*summaries[idx]);
+    delete summaries[idx];
+  }
+  if (failures == 0)
+  {
+    std::string error;
+    if (!summaries[0]->trace_launch_chain(files, error))
+    {
+      failures++;
+      fprintf(stderr, "ERROR: %s\n", error.c_str());
+    }
+  }
+  summaries[0]->report(stdout, options);
+  delete summaries[0];
+  return (failures > 0) ? 1 : 0;
+}
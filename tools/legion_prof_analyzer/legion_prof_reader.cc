@@ -0,0 +1,437 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "legion_prof_reader.h"
+
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef LEGION_USE_ZLIB
+#include <zlib.h>
+#endif
+
+// The kind tables come from the same X-macros that define the Realm enums
+// so that the names can never disagree with the values in the logs
+#include "realm/realm_c.h"
+
+namespace LegionProf {
+
+  // Large enough that a single read covers many records; the reader never
+  // holds more than this much of the file in memory at once
+  static const size_t READ_BUFFER_SIZE = 1 << 20;
+
+  /////////////////////////////////////////////////////////////
+  // RecordDesc
+  /////////////////////////////////////////////////////////////
+
+  //--------------------------------------------------------------------------
+  int RecordDesc::find_field(const char *field_name) const
+  //--------------------------------------------------------------------------
+  {
+    for (unsigned idx = 0; idx < fields.size(); idx++)
+      if (fields[idx].name == field_name)
+        return idx;
+    return -1;
+  }
+
+  /////////////////////////////////////////////////////////////
+  // LogReader
+  /////////////////////////////////////////////////////////////
+
+  //--------------------------------------------------------------------------
+  LogReader::LogReader(void)
+    : handle(NULL), buffer_pos(0), buffer_end(0), bytes_read(0), max_dim(0)
+  //--------------------------------------------------------------------------
+  {
+  }
+
+  //--------------------------------------------------------------------------
+  LogReader::~LogReader(void)
+  //--------------------------------------------------------------------------
+  {
+    close();
+  }
+
+  //--------------------------------------------------------------------------
+  bool LogReader::open(const std::string &name)
+  //--------------------------------------------------------------------------
+  {
+    close();
+    filename = name;
+    error.clear();
+#ifdef LEGION_USE_ZLIB
+    // gzread passes through uncompressed files unchanged
+    gzFile file = gzopen(filename.c_str(), "rb");
+    if (file == NULL)
+      return fail("unable to open file");
+    gzbuffer(file, READ_BUFFER_SIZE);
+    handle = file;
+#else
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (file == NULL)
+      return fail("unable to open file");
+    handle = file;
+#endif
+    buffer.resize(READ_BUFFER_SIZE);
+    buffer_pos = buffer_end = 0;
+    bytes_read = 0;
+    max_dim = 0;
+    return parse_preamble();
+  }
+
+  //--------------------------------------------------------------------------
+  void LogReader::close(void)
+  //--------------------------------------------------------------------------
+  {
+    if (handle != NULL)
+    {
+#ifdef LEGION_USE_ZLIB
+      gzclose((gzFile)handle);
+#else
+      fclose((FILE*)handle);
+#endif
+      handle = NULL;
+    }
+    for (std::vector<RecordDesc*>::const_iterator it =
+          records_by_id.begin(); it != records_by_id.end(); it++)
+      delete (*it);
+    records_by_id.clear();
+    records_by_name.clear();
+  }
+
+  //--------------------------------------------------------------------------
+  const RecordDesc* LogReader::find_record(const char *record_name) const
+  //--------------------------------------------------------------------------
+  {
+    std::map<std::string,RecordDesc*>::const_iterator finder =
+      records_by_name.find(record_name);
+    if (finder == records_by_name.end())
+      return NULL;
+    return finder->second;
+  }
+
+  //--------------------------------------------------------------------------
+  bool LogReader::fail(const std::string &message)
+  //--------------------------------------------------------------------------
+  {
+    if (error.empty())
+      error = filename + ": " + message;
+    return false;
+  }
+
+  //--------------------------------------------------------------------------
+  bool LogReader::fill_buffer(void)
+  //--------------------------------------------------------------------------
+  {
+    assert(buffer_pos == buffer_end);
+    if (handle == NULL)
+      return false;
+#ifdef LEGION_USE_ZLIB
+    const int result = gzread((gzFile)handle, &buffer[0], buffer.size());
+    if (result < 0)
+      return fail("error decompressing file");
+    buffer_end = result;
+#else
+    buffer_end = fread(&buffer[0], 1, buffer.size(), (FILE*)handle);
+    if ((buffer_end < buffer.size()) && ferror((FILE*)handle))
+      return fail("error reading file");
+    // Give a useful message rather than a garbled preamble
+    if ((bytes_read == 0) && (buffer_end >= 2) &&
+        ((unsigned char)buffer[0] == 0x1f) &&
+        ((unsigned char)buffer[1] == 0x8b))
+      return fail("file is gzip-compressed but zlib support is disabled");
+#endif
+    buffer_pos = 0;
+    return (buffer_end > 0);
+  }
+
+  //--------------------------------------------------------------------------
+  bool LogReader::read_bytes(void *dst, size_t size)
+  //--------------------------------------------------------------------------
+  {
+    char *ptr = (char*)dst;
+    while (size > 0)
+    {
+      if ((buffer_pos == buffer_end) && !fill_buffer())
+        return false;
+      size_t chunk = buffer_end - buffer_pos;
+      if (chunk > size)
+        chunk = size;
+      memcpy(ptr, &buffer[buffer_pos], chunk);
+      buffer_pos += chunk;
+      bytes_read += chunk;
+      ptr += chunk;
+      size -= chunk;
+    }
+    return true;
+  }
+
+  //--------------------------------------------------------------------------
+  bool LogReader::read_scalar(int bytes, uint64_t &value)
+  //--------------------------------------------------------------------------
+  {
+    // Values are written with fwrite from the host representation; the
+    // tool runs on the same class of machine so copy the low bytes
+    value = 0;
+    if ((bytes <= 0) || (bytes > int(sizeof(value))))
+      return fail("unsupported field width in preamble");
+    return read_bytes(&value, bytes);
+  }
+
+  //--------------------------------------------------------------------------
+  bool LogReader::read_line(std::string &line)
+  //--------------------------------------------------------------------------
+  {
+    line.clear();
+    while (true)
+    {
+      if ((buffer_pos == buffer_end) && !fill_buffer())
+        return false;
+      const char c = buffer[buffer_pos++];
+      bytes_read++;
+      if (c == '\n')
+        return true;
+      line.push_back(c);
+    }
+  }
+
+  //--------------------------------------------------------------------------
+  bool LogReader::parse_preamble(void)
+  //--------------------------------------------------------------------------
+  {
+    std::string line;
+    if (!read_line(line))
+      return fail("empty file");
+    static const char *const filetype = "FileType: BinaryLegionProf";
+    if (line.compare(0, strlen(filetype), filetype) != 0)
+      return fail("not a binary Legion Prof log (ASCII logs are not "
+                  "supported, run with -lg:prof_logfile)");
+    while (true)
+    {
+      if (!read_line(line))
+        return fail("truncated preamble");
+      // An empty line indicates the end of the preamble
+      if (line.empty())
+        break;
+      if (!parse_record_desc(line))
+        return false;
+    }
+    return true;
+  }
+
+  //--------------------------------------------------------------------------
+  bool LogReader::parse_record_desc(const std::string &line)
+  //--------------------------------------------------------------------------
+  {
+    // Name {id:N, field:type:bytes, field:type:bytes, ...}
+    // Provenance fields are written as just field:bytes
+    const size_t open = line.find(" {");
+    const size_t close = line.rfind('}');
+    if ((open == std::string::npos) || (close == std::string::npos) ||
+        (close < open))
+      return fail("malformed preamble line '" + line + "'");
+    RecordDesc *desc = new RecordDesc;
+    desc->name = line.substr(0, open);
+    desc->id = -1;
+    const std::string body = line.substr(open + 2, close - (open + 2));
+    size_t pos = 0;
+    while (pos < body.size())
+    {
+      size_t end = body.find(", ", pos);
+      if (end == std::string::npos)
+        end = body.size();
+      const std::string item = body.substr(pos, end - pos);
+      pos = end + 2;
+      std::vector<std::string> parts;
+      size_t start = 0;
+      while (true)
+      {
+        const size_t colon = item.find(':', start);
+        parts.push_back(item.substr(start, colon - start));
+        if (colon == std::string::npos)
+          break;
+        start = colon + 1;
+      }
+      if ((parts.size() == 2) && (parts[0] == "id"))
+      {
+        desc->id = atoi(parts[1].c_str());
+        continue;
+      }
+      FieldDesc field;
+      field.name = parts[0];
+      if (parts.size() == 2)
+      {
+        field.type = "LgEvent";
+        field.bytes = atoi(parts[1].c_str());
+      }
+      else if (parts.size() == 3)
+      {
+        field.type = parts[1];
+        field.bytes = atoi(parts[2].c_str());
+      }
+      else
+      {
+        delete desc;
+        return fail("malformed field '" + item + "' in preamble");
+      }
+      if (field.type == "string")
+        field.kind = FieldDesc::STRING_FIELD;
+      else if (field.type == "point")
+        field.kind = FieldDesc::POINT_FIELD;
+      else if (field.type == "array")
+        field.kind = FieldDesc::ARRAY_FIELD;
+      else if (field.type == "maxdim")
+        field.kind = FieldDesc::MAXDIM_FIELD;
+      else
+        field.kind = FieldDesc::SCALAR_FIELD;
+      if ((field.kind != FieldDesc::STRING_FIELD) &&
+          ((field.bytes <= 0) || (field.bytes > int(sizeof(uint64_t)))))
+      {
+        delete desc;
+        return fail("unsupported width for field '" + item + "'");
+      }
+      desc->fields.push_back(field);
+    }
+    if ((desc->id < 0) || (desc->id > 0xFFFF))
+    {
+      delete desc;
+      return fail("missing or invalid id in preamble line '" + line + "'");
+    }
+    if (records_by_id.size() <= unsigned(desc->id))
+      records_by_id.resize(desc->id + 1, NULL);
+    if (records_by_id[desc->id] != NULL)
+    {
+      delete desc;
+      return fail("duplicate record id in preamble line '" + line + "'");
+    }
+    records_by_id[desc->id] = desc;
+    records_by_name[desc->name] = desc;
+    return true;
+  }
+
+  //--------------------------------------------------------------------------
+  bool LogReader::next(Record &record)
+  //--------------------------------------------------------------------------
+  {
+    int32_t id;
+    if ((buffer_pos == buffer_end) && !fill_buffer())
+      return false;
+    if (!read_bytes(&id, sizeof(id)))
+      return fail("truncated record id");
+    if ((id < 0) || (unsigned(id) >= records_by_id.size()) ||
+        (records_by_id[id] == NULL))
+    {
+      char message[64];
+      snprintf(message, sizeof(message), "unknown record id %d", id);
+      return fail(message);
+    }
+    const RecordDesc *desc = records_by_id[id];
+    record.desc = desc;
+    record.values.resize(desc->fields.size());
+    record.strings.resize(desc->fields.size());
+    for (unsigned idx = 0; idx < desc->fields.size(); idx++)
+    {
+      const FieldDesc &field = desc->fields[idx];
+      switch (field.kind)
+      {
+        case FieldDesc::SCALAR_FIELD:
+          {
+            if (!read_scalar(field.bytes, record.values[idx]))
+              return fail("truncated " + desc->name + " record");
+            break;
+          }
+        case FieldDesc::MAXDIM_FIELD:
+          {
+            if (!read_scalar(field.bytes, record.values[idx]))
+              return fail("truncated " + desc->name + " record");
+            max_dim = record.values[idx];
+            break;
+          }
+        case FieldDesc::STRING_FIELD:
+          {
+            std::string &str = record.strings[idx];
+            str.clear();
+            while (true)
+            {
+              char c;
+              if (!read_bytes(&c, 1))
+                return fail("truncated " + desc->name + " record");
+              if (c == '\0')
+                break;
+              str.push_back(c);
+            }
+            break;
+          }
+        case FieldDesc::POINT_FIELD:
+        case FieldDesc::ARRAY_FIELD:
+          {
+            // None of the analyses need the geometry so just skip it
+            const uint64_t count =
+              (field.kind == FieldDesc::POINT_FIELD) ? max_dim : 2*max_dim;
+            for (uint64_t i = 0; i < count; i++)
+              if (!read_scalar(field.bytes, record.values[idx]))
+                return fail("truncated " + desc->name + " record");
+            record.values[idx] = 0;
+            break;
+          }
+        default:
+          assert(false);
+      }
+    }
+    return true;
+  }
+
+  /////////////////////////////////////////////////////////////
+  // Helpers
+  /////////////////////////////////////////////////////////////
+
+  //--------------------------------------------------------------------------
+  unsigned node_of_id(uint64_t id)
+  //--------------------------------------------------------------------------
+  {
+    // PROCESSOR/MEMORY: tag:8, owner_node:16, ...
+    return (id >> 40) & ((1 << 16) - 1);
+  }
+
+  //--------------------------------------------------------------------------
+  const char* processor_kind_name(unsigned kind)
+  //--------------------------------------------------------------------------
+  {
+    static const char *const names[] = {
+#define KIND_NAMES(name, desc) #name,
+      REALM_PROCESSOR_KINDS(KIND_NAMES)
+#undef KIND_NAMES
+    };
+    if (kind < (sizeof(names) / sizeof(names[0])))
+      return names[kind];
+    return "UNKNOWN_PROC";
+  }
+
+  //--------------------------------------------------------------------------
+  const char* memory_kind_name(unsigned kind)
+  //--------------------------------------------------------------------------
+  {
+    static const char *const names[] = {
+#define KIND_NAMES(name, desc) #name,
+      REALM_MEMORY_KINDS(KIND_NAMES)
+#undef KIND_NAMES
+    };
+    if (kind < (sizeof(names) / sizeof(names[0])))
+      return names[kind];
+    return "UNKNOWN_MEM";
+  }
+
+}; // namespace LegionProf
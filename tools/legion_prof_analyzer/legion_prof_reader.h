@@ -0,0 +1,126 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LEGION_PROF_READER_H__
+#define __LEGION_PROF_READER_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+
+// Streaming reader for the binary logs written by LegionProfBinarySerializer
+// (runtime/legion/legion_profiling_serializer.cc).  Record layouts are not
+// hard-coded here: every log starts with a text preamble produced by the
+// serializer itself which describes the name, id, and field sizes of each
+// record, and the reader decodes the rest of the file from that description.
+// Consumers look up the fields they need by name once per file, so adding or
+// reordering fields in the serializer only requires a change here if a
+// field that an analysis relies on is removed or changes width.
+
+namespace LegionProf {
+
+  class FieldDesc {
+  public:
+    enum Kind {
+      SCALAR_FIELD, // fixed-width integer/enum/bool in host byte order
+      STRING_FIELD, // NUL-terminated string
+      POINT_FIELD,  // max_dim fixed-width values
+      ARRAY_FIELD,  // 2*max_dim fixed-width values
+      MAXDIM_FIELD, // scalar that sets max_dim for later points/arrays
+    };
+  public:
+    std::string name;
+    std::string type;
+    Kind kind;
+    int bytes;
+  };
+
+  class RecordDesc {
+  public:
+    // Returns the index of the named field or -1 if the log does not
+    // contain it (e.g. provenance without LEGION_PROF_PROVENANCE)
+    int find_field(const char *field_name) const;
+  public:
+    std::string name;
+    int id;
+    std::vector<FieldDesc> fields;
+  };
+
+  // One decoded record; only valid until the next call to LogReader::next
+  class Record {
+  public:
+    inline uint64_t get(int field) const { return values[field]; }
+    inline const std::string& get_string(int field) const
+      { return strings[field]; }
+  public:
+    const RecordDesc *desc;
+    std::vector<uint64_t> values;
+    std::vector<std::string> strings;
+  };
+
+  class LogReader {
+  public:
+    LogReader(void);
+    ~LogReader(void);
+  private:
+    LogReader(const LogReader &rhs);
+    LogReader& operator=(const LogReader &rhs);
+  public:
+    // Opens the file (gzip-compressed or not) and parses the preamble,
+    // returns false and fills in the error message on failure
+    bool open(const std::string &filename);
+    void close(void);
+    // Decodes the next record, returns false at the end of the file or
+    // on a malformed record (check has_error to distinguish)
+    bool next(Record &record);
+    const RecordDesc* find_record(const char *record_name) const;
+  public:
+    inline bool has_error(void) const { return !error.empty(); }
+    inline const std::string& get_error(void) const { return error; }
+    inline const std::string& get_filename(void) const { return filename; }
+    inline unsigned long long get_bytes_read(void) const
+      { return bytes_read; }
+  protected:
+    bool parse_preamble(void);
+    bool parse_record_desc(const std::string &line);
+    bool read_line(std::string &line);
+    bool read_bytes(void *dst, size_t size);
+    bool read_scalar(int bytes, uint64_t &value);
+    bool fill_buffer(void);
+    bool fail(const std::string &message);
+  protected:
+    std::string filename;
+    std::string error;
+    void *handle; // gzFile or FILE*
+    std::vector<char> buffer;
+    size_t buffer_pos, buffer_end;
+    unsigned long long bytes_read;
+    // Indexed by record id; ids are small dense enum values
+    std::vector<RecordDesc*> records_by_id;
+    std::map<std::string,RecordDesc*> records_by_name;
+    uint64_t max_dim;
+  };
+
+  // Node and kind decoding shared by the analyses; these mirror the
+  // Realm ID layout and the realm_c.h kind tables
+  unsigned node_of_id(uint64_t id);
+  const char* processor_kind_name(unsigned kind);
+  const char* memory_kind_name(unsigned kind);
+
+}; // namespace LegionProf
+
+#endif // __LEGION_PROF_READER_H__
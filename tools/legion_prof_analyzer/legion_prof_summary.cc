@@ -0,0 +1,717 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "legion_prof_summary.h"
+
+#include <assert.h>
+#include <inttypes.h>
+#include <algorithm>
+
+namespace LegionProf {
+
+  /////////////////////////////////////////////////////////////
+  // ProcStats
+  /////////////////////////////////////////////////////////////
+
+  //--------------------------------------------------------------------------
+  ProcStats::ProcStats(void)
+    : kind(0), busy_ns(0), wait_ns(0), tasks(0), meta_tasks(0)
+  //--------------------------------------------------------------------------
+  {
+  }
+
+  //--------------------------------------------------------------------------
+  void ProcStats::merge(const ProcStats &rhs)
+  //--------------------------------------------------------------------------
+  {
+    if (kind == 0)
+      kind = rhs.kind;
+    busy_ns += rhs.busy_ns;
+    wait_ns += rhs.wait_ns;
+    tasks += rhs.tasks;
+    meta_tasks += rhs.meta_tasks;
+  }
+
+  /////////////////////////////////////////////////////////////
+  // KindStats
+  /////////////////////////////////////////////////////////////
+
+  //--------------------------------------------------------------------------
+  KindStats::KindStats(void)
+    : count(0), total_ns(0), queue_ns(0), min_ns(UINT64_MAX), max_ns(0)
+  //--------------------------------------------------------------------------
+  {
+    for (unsigned idx = 0; idx < NUM_BUCKETS; idx++)
+      buckets[idx] = 0;
+  }
+
+  //--------------------------------------------------------------------------
+  void KindStats::add(uint64_t run_ns, uint64_t queue)
+  //--------------------------------------------------------------------------
+  {
+    count++;
+    total_ns += run_ns;
+    queue_ns += queue;
+    if (run_ns < min_ns)
+      min_ns = run_ns;
+    if (run_ns > max_ns)
+      max_ns = run_ns;
+    uint64_t us = run_ns / 1000;
+    unsigned bucket = 0;
+    while ((us > 0) && (bucket < (NUM_BUCKETS-1)))
+    {
+      us >>= 1;
+      bucket++;
+    }
+    buckets[bucket]++;
+  }
+
+  //--------------------------------------------------------------------------
+  void KindStats::merge(const KindStats &rhs)
+  //--------------------------------------------------------------------------
+  {
+    if (name.empty())
+      name = rhs.name;
+    count += rhs.count;
+    total_ns += rhs.total_ns;
+    queue_ns += rhs.queue_ns;
+    min_ns = std::min(min_ns, rhs.min_ns);
+    max_ns = std::max(max_ns, rhs.max_ns);
+    for (unsigned idx = 0; idx < NUM_BUCKETS; idx++)
+      buckets[idx] += rhs.buckets[idx];
+  }
+
+  /////////////////////////////////////////////////////////////
+  // ChannelStats
+  /////////////////////////////////////////////////////////////
+
+  //--------------------------------------------------------------------------
+  ChannelStats::ChannelStats(void)
+    : copies(0), bytes(0), busy_ns(0)
+  //--------------------------------------------------------------------------
+  {
+  }
+
+  //--------------------------------------------------------------------------
+  void ChannelStats::merge(const ChannelStats &rhs)
+  //--------------------------------------------------------------------------
+  {
+    copies += rhs.copies;
+    bytes += rhs.bytes;
+    busy_ns += rhs.busy_ns;
+  }
+
+  /////////////////////////////////////////////////////////////
+  // Summary
+  /////////////////////////////////////////////////////////////
+
+  // Field indices for one record kind, looked up once per file
+  struct FieldMap {
+  public:
+    FieldMap(const LogReader &reader, const char *record,
+             const char *const *names, unsigned num_names,
+             const char *const *optional, unsigned num_optional,
+             std::string &error)
+      : desc(reader.find_record(record))
+    {
+      for (unsigned idx = 0; idx < num_names; idx++)
+      {
+        const int field = (desc == NULL) ? -1 : desc->find_field(names[idx]);
+        // A record missing from the preamble is fine (nothing to analyze),
+        // but one that is present without the fields we need means the
+        // serializer changed underneath us and we should say so loudly
+        if ((desc != NULL) && (field < 0) && error.empty())
+          error = std::string("record ") + record + " has no field '" +
+                  names[idx] + "', the log format is not supported";
+        fields.push_back(field);
+      }
+      for (unsigned idx = 0; idx < num_optional; idx++)
+        fields.push_back((desc == NULL) ? -1 :
+                          desc->find_field(optional[idx]));
+    }
+  public:
+    inline bool matches(const Record &record) const
+      { return (desc != NULL) && (record.desc == desc); }
+    inline bool has(unsigned idx) const { return (fields[idx] >= 0); }
+    inline uint64_t get(const Record &record, unsigned idx) const
+      { return record.get(fields[idx]); }
+    inline const std::string& get_string(const Record &record,
+                                         unsigned idx) const
+      { return record.get_string(fields[idx]); }
+  public:
+    const RecordDesc *const desc;
+    std::vector<int> fields;
+  };
+
+  // Task and meta-task fields shared by the summary pass and the launch
+  // chain passes; the provenance fields only exist in logs from runtimes
+  // built with LEGION_PROF_PROVENANCE
+  static const char *const task_info[] = { "task_id", "proc_id", "ready",
+                                           "start", "stop", "op_id" };
+  static const char *const meta_info[] = { "lg_id", "proc_id", "ready",
+                                           "start", "stop", "op_id" };
+  static const char *const provenance[] = { "provenance", "finish_event" };
+
+  // Fills in a launch chain node from a task or meta-task record whose
+  // field map includes the provenance fields
+  static inline PathNode make_path_node(const FieldMap &map,
+                                        const Record &record, bool meta)
+  {
+    PathNode node;
+    node.finish = map.get(record, 7);
+    node.provenance = map.get(record, 6);
+    node.proc_id = map.get(record, 1);
+    node.start = map.get(record, 3);
+    node.stop = std::max(node.start, map.get(record, 4));
+    node.kind = map.get(record, 0);
+    node.meta = meta;
+    return node;
+  }
+
+#define FIELD_MAP(var, record, names)                                       \
+  const FieldMap var(reader, record, names,                                 \
+                     sizeof(names)/sizeof(names[0]), NULL, 0, error)
+#define FIELD_MAP_OPTIONAL(var, record, names, optional)                    \
+  const FieldMap var(reader, record, names,                                 \
+                     sizeof(names)/sizeof(names[0]), optional,              \
+                     sizeof(optional)/sizeof(optional[0]), error)
+
+  //--------------------------------------------------------------------------
+  Summary::Summary(bool chain)
+    : launch_chain(chain), has_provenance(false), files(0), records(0),
+      bytes(0), first_time(UINT64_MAX), last_time(0), fills(0),
+      has_last_task(false)
+  //--------------------------------------------------------------------------
+  {
+  }
+
+  //--------------------------------------------------------------------------
+  bool Summary::process_file(const std::string &filename, std::string &error)
+  //--------------------------------------------------------------------------
+  {
+    LogReader reader;
+    if (!reader.open(filename))
+    {
+      error = reader.get_error();
+      return false;
+    }
+    static const char *const proc_desc[] = { "proc_id", "kind" };
+    static const char *const mem_desc[] = { "mem_id", "kind" };
+    static const char *const task_kind[] = { "task_id", "name", "overwrite" };
+    static const char *const meta_desc[] = { "kind", "name" };
+    static const char *const wait_info[] = { "op_id", "wait_start",
+                                             "wait_end" };
+    static const char *const copy_info[] = { "src", "dst", "size", "start",
+                                             "stop" };
+    static const char *const fill_info[] = { "dst", "start", "stop" };
+    FIELD_MAP(procs_map, "ProcDesc", proc_desc);
+    FIELD_MAP(mems_map, "MemDesc", mem_desc);
+    FIELD_MAP(kinds_map, "TaskKind", task_kind);
+    FIELD_MAP(metas_map, "MetaDesc", meta_desc);
+    FIELD_MAP_OPTIONAL(tasks_map, "TaskInfo", task_info, provenance);
+    FIELD_MAP_OPTIONAL(gpus_map, "GPUTaskInfo", task_info, provenance);
+    FIELD_MAP_OPTIONAL(meta_tasks_map, "MetaInfo", meta_info, provenance);
+    FIELD_MAP(task_waits_map, "TaskWaitInfo", wait_info);
+    FIELD_MAP(meta_waits_map, "MetaWaitInfo", wait_info);
+    FIELD_MAP(copies_map, "CopyInfo", copy_info);
+    FIELD_MAP(fills_map, "FillInfo", fill_info);
+    if (!error.empty())
+    {
+      error = filename + ": " + error;
+      return false;
+    }
+    // Wait records only name the operation, but the serializer always
+    // writes them immediately after the task they belong to
+    uint64_t last_task_op = 0, last_meta_op = 0;
+    ProcStats *last_task_proc = NULL, *last_meta_proc = NULL;
+    Record record;
+    while (reader.next(record))
+    {
+      records++;
+      const FieldMap *task_map = NULL;
+      if (tasks_map.matches(record))
+        task_map = &tasks_map;
+      else if (gpus_map.matches(record))
+        task_map = &gpus_map;
+      if (task_map != NULL)
+      {
+        // task_id, proc_id, ready, start, stop, op_id, provenance, finish
+        const uint64_t start = task_map->get(record, 3);
+        const uint64_t stop = std::max(start, task_map->get(record, 4));
+        const uint64_t ready = std::min(start, task_map->get(record, 2));
+        const uint64_t proc_id = task_map->get(record, 1);
+        const unsigned task_id = task_map->get(record, 0);
+        ProcStats &proc = procs[proc_id];
+        proc.busy_ns += (stop - start);
+        proc.tasks++;
+        task_kinds[task_id].add(stop - start, start - ready);
+        first_time = std::min(first_time, start);
+        last_time = std::max(last_time, stop);
+        last_task_op = task_map->get(record, 5);
+        last_task_proc = &proc;
+        if (launch_chain && task_map->has(6) && task_map->has(7))
+        {
+          has_provenance = true;
+          record_last_task(make_path_node(*task_map, record, false/*meta*/));
+        }
+      }
+      else if (meta_tasks_map.matches(record))
+      {
+        const uint64_t start = meta_tasks_map.get(record, 3);
+        const uint64_t stop = std::max(start, meta_tasks_map.get(record, 4));
+        const uint64_t ready = std::min(start, meta_tasks_map.get(record, 2));
+        const uint64_t proc_id = meta_tasks_map.get(record, 1);
+        const unsigned lg_id = meta_tasks_map.get(record, 0);
+        ProcStats &proc = procs[proc_id];
+        proc.busy_ns += (stop - start);
+        proc.meta_tasks++;
+        meta_kinds[lg_id].add(stop - start, start - ready);
+        first_time = std::min(first_time, start);
+        last_time = std::max(last_time, stop);
+        last_meta_op = meta_tasks_map.get(record, 5);
+        last_meta_proc = &proc;
+        if (launch_chain && meta_tasks_map.has(6) && meta_tasks_map.has(7))
+        {
+          has_provenance = true;
+          record_last_task(make_path_node(meta_tasks_map, record,
+                                          true/*meta*/));
+        }
+      }
+      else if (task_waits_map.matches(record) ||
+               meta_waits_map.matches(record))
+      {
+        const bool meta = meta_waits_map.matches(record);
+        const FieldMap &wait_map = meta ? meta_waits_map : task_waits_map;
+        ProcStats *proc = meta ? last_meta_proc : last_task_proc;
+        const uint64_t op = meta ? last_meta_op : last_task_op;
+        if ((proc != NULL) && (wait_map.get(record, 0) == op))
+        {
+          const uint64_t wait_start = wait_map.get(record, 1);
+          const uint64_t wait_end = wait_map.get(record, 2);
+          if (wait_end > wait_start)
+            proc->wait_ns += (wait_end - wait_start);
+        }
+      }
+      else if (copies_map.matches(record))
+      {
+        const uint64_t start = copies_map.get(record, 3);
+        const uint64_t stop = std::max(start, copies_map.get(record, 4));
+        ChannelStats &channel = channels[std::make_pair(
+              copies_map.get(record, 0), copies_map.get(record, 1))];
+        channel.copies++;
+        channel.bytes += copies_map.get(record, 2);
+        channel.busy_ns += (stop - start);
+      }
+      else if (fills_map.matches(record))
+        fills++;
+      else if (procs_map.matches(record))
+        procs[procs_map.get(record, 0)].kind = procs_map.get(record, 1);
+      else if (mems_map.matches(record))
+        memory_kinds[mems_map.get(record, 0)] = mems_map.get(record, 1);
+      else if (kinds_map.matches(record))
+      {
+        KindStats &stats = task_kinds[kinds_map.get(record, 0)];
+        if (stats.name.empty() || kinds_map.get(record, 2))
+          stats.name = kinds_map.get_string(record, 1);
+      }
+      else if (metas_map.matches(record))
+        meta_kinds[metas_map.get(record, 0)].name =
+          metas_map.get_string(record, 1);
+    }
+    bytes += reader.get_bytes_read();
+    files++;
+    if (reader.has_error())
+    {
+      error = reader.get_error();
+      return false;
+    }
+    return true;
+  }
+
+  //--------------------------------------------------------------------------
+  void Summary::record_last_task(const PathNode &node)
+  //--------------------------------------------------------------------------
+  {
+    if (!has_last_task || (node.stop > last_task.stop))
+    {
+      last_task = node;
+      has_last_task = true;
+    }
+  }
+
+  //--------------------------------------------------------------------------
+  bool Summary::extend_launch_chain(const std::string &filename,
+                                    std::string &error)
+  //--------------------------------------------------------------------------
+  {
+    LogReader reader;
+    if (!reader.open(filename))
+    {
+      error = reader.get_error();
+      return false;
+    }
+    FIELD_MAP_OPTIONAL(tasks_map, "TaskInfo", task_info, provenance);
+    FIELD_MAP_OPTIONAL(gpus_map, "GPUTaskInfo", task_info, provenance);
+    FIELD_MAP_OPTIONAL(meta_tasks_map, "MetaInfo", meta_info, provenance);
+    if (!error.empty())
+    {
+      error = filename + ": " + error;
+      return false;
+    }
+    Record record;
+    while ((chain.back().provenance != 0) && reader.next(record))
+    {
+      const FieldMap *map = NULL;
+      if (tasks_map.matches(record))
+        map = &tasks_map;
+      else if (gpus_map.matches(record))
+        map = &gpus_map;
+      else if (meta_tasks_map.matches(record))
+        map = &meta_tasks_map;
+      if ((map == NULL) || !map->has(6) || !map->has(7) ||
+          (map->get(record, 7) != chain.back().provenance))
+        continue;
+      // Keep scanning for this task's own launcher, which is often logged
+      // later in the same file since launchers tend to finish last
+      chain.push_back(make_path_node(*map, record, (map == &meta_tasks_map)));
+    }
+    if (reader.has_error())
+    {
+      error = reader.get_error();
+      return false;
+    }
+    return true;
+  }
+#undef FIELD_MAP
+#undef FIELD_MAP_OPTIONAL
+
+  //--------------------------------------------------------------------------
+  bool Summary::trace_launch_chain(const std::vector<std::string> &filenames,
+                                   std::string &error)
+  //--------------------------------------------------------------------------
+  {
+    chain.clear();
+    if (!launch_chain || !has_last_task)
+      return true;
+    chain.push_back(last_task);
+    // Each pass over the logs follows as many launchers as it finds in
+    // order, so we only need another pass if a launcher was logged before
+    // the task it launched; a pass that finds nothing means the launcher
+    // was not profiled.  Only the chain itself is kept in memory.  The
+    // length check guards against cycles in inconsistent logs.
+    while ((chain.back().provenance != 0) && (chain.size() <= records))
+    {
+      const size_t before = chain.size();
+      for (std::vector<std::string>::const_iterator it =
+            filenames.begin(); it != filenames.end(); it++)
+        if (!extend_launch_chain(*it, error))
+          return false;
+      if (chain.size() == before)
+        break;
+    }
+    return true;
+  }
+
+  //--------------------------------------------------------------------------
+  void Summary::merge(const Summary &rhs)
+  //--------------------------------------------------------------------------
+  {
+    has_provenance = has_provenance || rhs.has_provenance;
+    files += rhs.files;
+    records += rhs.records;
+    bytes += rhs.bytes;
+    first_time = std::min(first_time, rhs.first_time);
+    last_time = std::max(last_time, rhs.last_time);
+    for (std::map<uint64_t,ProcStats>::const_iterator it =
+          rhs.procs.begin(); it != rhs.procs.end(); it++)
+      procs[it->first].merge(it->second);
+    memory_kinds.insert(rhs.memory_kinds.begin(), rhs.memory_kinds.end());
+    for (std::map<unsigned,KindStats>::const_iterator it =
+          rhs.task_kinds.begin(); it != rhs.task_kinds.end(); it++)
+      task_kinds[it->first].merge(it->second);
+    for (std::map<unsigned,KindStats>::const_iterator it =
+          rhs.meta_kinds.begin(); it != rhs.meta_kinds.end(); it++)
+      meta_kinds[it->first].merge(it->second);
+    for (std::map<std::pair<uint64_t,uint64_t>,ChannelStats>::const_iterator
+          it = rhs.channels.begin(); it != rhs.channels.end(); it++)
+      channels[it->first].merge(it->second);
+    fills += rhs.fills;
+    if (rhs.has_last_task)
+      record_last_task(rhs.last_task);
+  }
+
+  static inline double to_ms(uint64_t ns) { return double(ns) * 1e-6; }
+  static inline double to_us(uint64_t ns) { return double(ns) * 1e-3; }
+
+  //--------------------------------------------------------------------------
+  void Summary::report(FILE *out, const ReportOptions &options) const
+  //--------------------------------------------------------------------------
+  {
+    fprintf(out, "Files: %u  Records: %llu  Bytes: %llu\n", files,
+            records, bytes);
+    if (first_time > last_time)
+    {
+      fprintf(out, "No task records found\n");
+      return;
+    }
+    fprintf(out, "Elapsed: %.3f ms (%.3f ms to %.3f ms)\n",
+            to_ms(last_time - first_time), to_ms(first_time),
+            to_ms(last_time));
+    report_processors(out, options);
+    report_kinds(out, "Task Kinds", task_kinds, options);
+    report_kinds(out, "Meta-Task Kinds", meta_kinds, options);
+    report_copies(out, options);
+    report_launch_chain(out, options);
+  }
+
+  //--------------------------------------------------------------------------
+  void Summary::report_processors(FILE *out,
+                                  const ReportOptions &options) const
+  //--------------------------------------------------------------------------
+  {
+    const uint64_t elapsed = last_time - first_time;
+    // Per kind totals first, then the individual processors
+    std::map<unsigned,std::pair<unsigned,uint64_t> > kinds;
+    for (std::map<uint64_t,ProcStats>::const_iterator it =
+          procs.begin(); it != procs.end(); it++)
+    {
+      std::pair<unsigned,uint64_t> &kind = kinds[it->second.kind];
+      kind.first++;
+      kind.second += it->second.busy_ns -
+        std::min(it->second.busy_ns, it->second.wait_ns);
+    }
+    fprintf(out, "\n== Processor Utilization ==\n");
+    fprintf(out, "%-12s %8s %10s\n", "Kind", "Procs", "Avg Util");
+    for (std::map<unsigned,std::pair<unsigned,uint64_t> >::const_iterator
+          it = kinds.begin(); it != kinds.end(); it++)
+      fprintf(out, "%-12s %8u %9.2f%%\n", processor_kind_name(it->first),
+              it->second.first, (elapsed == 0) ? 0.0 :
+              100.0 * double(it->second.second) /
+                (double(elapsed) * it->second.first));
+    std::vector<std::pair<uint64_t,uint64_t> > order;
+    for (std::map<uint64_t,ProcStats>::const_iterator it =
+          procs.begin(); it != procs.end(); it++)
+      order.push_back(std::make_pair(it->second.busy_ns -
+            std::min(it->second.busy_ns, it->second.wait_ns), it->first));
+    std::sort(order.rbegin(), order.rend());
+    const size_t rows = ((options.top == 0) || (options.top > order.size())) ?
+      order.size() : options.top;
+    fprintf(out, "\n%-20s %-12s %6s %10s %10s %12s %12s\n", "Processor",
+            "Kind", "Node", "Tasks", "Meta", "Busy (ms)", "Util");
+    for (size_t idx = 0; idx < rows; idx++)
+    {
+      const ProcStats &proc = procs.find(order[idx].second)->second;
+      fprintf(out, "0x%-18" PRIx64 " %-12s %6u %10" PRIu64 " %10" PRIu64
+              " %12.3f %11.2f%%\n", order[idx].second,
+              processor_kind_name(proc.kind), node_of_id(order[idx].second),
+              proc.tasks, proc.meta_tasks, to_ms(order[idx].first),
+              (elapsed == 0) ? 0.0 :
+                100.0 * double(order[idx].first) / double(elapsed));
+    }
+    if (rows < order.size())
+      fprintf(out, "... %zd more processors\n", order.size() - rows);
+  }
+
+  //--------------------------------------------------------------------------
+  void Summary::report_kinds(FILE *out, const char *title,
+                             const std::map<unsigned,KindStats> &kinds,
+                             const ReportOptions &options) const
+  //--------------------------------------------------------------------------
+  {
+    std::vector<std::pair<uint64_t,unsigned> > order;
+    for (std::map<unsigned,KindStats>::const_iterator it =
+          kinds.begin(); it != kinds.end(); it++)
+      if (it->second.count > 0)
+        order.push_back(std::make_pair(it->second.total_ns, it->first));
+    if (order.empty())
+      return;
+    std::sort(order.rbegin(), order.rend());
+    const size_t rows = ((options.top == 0) || (options.top > order.size())) ?
+      order.size() : options.top;
+    fprintf(out, "\n== %s (by total time) ==\n", title);
+    fprintf(out, "%-32s %10s %12s %10s %10s %10s %10s\n", "Name", "Count",
+            "Total (ms)", "Avg (us)", "Min (us)", "Max (us)", "Queue (us)");
+    for (size_t idx = 0; idx < rows; idx++)
+    {
+      const KindStats &stats = kinds.find(order[idx].second)->second;
+      char name[64];
+      if (stats.name.empty())
+        snprintf(name, sizeof(name), "<%u>", order[idx].second);
+      else
+        snprintf(name, sizeof(name), "%s", stats.name.c_str());
+      fprintf(out, "%-32s %10" PRIu64 " %12.3f %10.2f %10.2f %10.2f %10.2f\n",
+              name, stats.count, to_ms(stats.total_ns),
+              to_us(stats.total_ns) / stats.count, to_us(stats.min_ns),
+              to_us(stats.max_ns), to_us(stats.queue_ns) / stats.count);
+      if (!options.histograms)
+        continue;
+      fprintf(out, "  ");
+      for (unsigned b = 0; b < KindStats::NUM_BUCKETS; b++)
+      {
+        if (stats.buckets[b] == 0)
+          continue;
+        if (b == 0)
+          fprintf(out, " <1us:%" PRIu64, stats.buckets[b]);
+        else
+          fprintf(out, " %llu-%lluus:%" PRIu64, 1ULL << (b-1), 1ULL << b,
+                  stats.buckets[b]);
+      }
+      fprintf(out, "\n");
+    }
+    if (rows < order.size())
+      fprintf(out, "... %zd more kinds\n", order.size() - rows);
+  }
+
+  //--------------------------------------------------------------------------
+  void Summary::report_copies(FILE *out, const ReportOptions &options) const
+  //--------------------------------------------------------------------------
+  {
+    if (channels.empty() && (fills == 0))
+      return;
+    // Bandwidth is bytes over the summed copy durations, i.e. the average
+    // rate achieved by an individual copy on that channel
+    std::map<std::pair<unsigned,unsigned>,ChannelStats> kinds;
+    std::vector<std::pair<uint64_t,std::pair<uint64_t,uint64_t> > > order;
+    for (std::map<std::pair<uint64_t,uint64_t>,ChannelStats>::const_iterator
+          it = channels.begin(); it != channels.end(); it++)
+    {
+      std::map<uint64_t,unsigned>::const_iterator src =
+        memory_kinds.find(it->first.first);
+      std::map<uint64_t,unsigned>::const_iterator dst =
+        memory_kinds.find(it->first.second);
+      kinds[std::make_pair(
+          (src == memory_kinds.end()) ? ~0U : src->second,
+          (dst == memory_kinds.end()) ? ~0U : dst->second)].merge(it->second);
+      order.push_back(std::make_pair(it->second.bytes, it->first));
+    }
+    fprintf(out, "\n== Copy Bandwidth ==\n");
+    fprintf(out, "Fills: %" PRIu64 "\n", fills);
+    fprintf(out, "%-28s %10s %14s %12s %10s\n", "Source -> Destination",
+            "Copies", "Bytes", "Time (ms)", "GB/s");
+    for (std::map<std::pair<unsigned,unsigned>,ChannelStats>::const_iterator
+          it = kinds.begin(); it != kinds.end(); it++)
+    {
+      char name[64];
+      snprintf(name, sizeof(name), "%s -> %s",
+               memory_kind_name(it->first.first),
+               memory_kind_name(it->first.second));
+      fprintf(out, "%-28s %10" PRIu64 " %14" PRIu64 " %12.3f %10.3f\n", name,
+              it->second.copies, it->second.bytes, to_ms(it->second.busy_ns),
+              (it->second.busy_ns == 0) ? 0.0 :
+                double(it->second.bytes) / double(it->second.busy_ns));
+    }
+    std::sort(order.rbegin(), order.rend());
+    const size_t rows = ((options.top == 0) || (options.top > order.size())) ?
+      order.size() : options.top;
+    fprintf(out, "\n%-40s %10s %14s %12s %10s\n", "Memory Pair (by bytes)",
+            "Copies", "Bytes", "Time (ms)", "GB/s");
+    for (size_t idx = 0; idx < rows; idx++)
+    {
+      const ChannelStats &stats = channels.find(order[idx].second)->second;
+      char name[64];
+      snprintf(name, sizeof(name), "0x%" PRIx64 " -> 0x%" PRIx64,
+               order[idx].second.first, order[idx].second.second);
+      fprintf(out, "%-40s %10" PRIu64 " %14" PRIu64 " %12.3f %10.3f\n", name,
+              stats.copies, stats.bytes, to_ms(stats.busy_ns),
+              (stats.busy_ns == 0) ? 0.0 :
+                double(stats.bytes) / double(stats.busy_ns));
+    }
+    if (rows < order.size())
+      fprintf(out, "... %zd more memory pairs\n", order.size() - rows);
+  }
+
+  //--------------------------------------------------------------------------
+  const char* Summary::kind_name(const PathNode &node) const
+  //--------------------------------------------------------------------------
+  {
+    const std::map<unsigned,KindStats> &kinds =
+      node.meta ? meta_kinds : task_kinds;
+    std::map<unsigned,KindStats>::const_iterator finder =
+      kinds.find(node.kind);
+    if ((finder == kinds.end()) || finder->second.name.empty())
+      return node.meta ? "<meta>" : "<task>";
+    return finder->second.name.c_str();
+  }
+
+  //--------------------------------------------------------------------------
+  void Summary::report_launch_chain(FILE *out,
+                                    const ReportOptions &options) const
+  //--------------------------------------------------------------------------
+  {
+    if (!launch_chain)
+      return;
+    fprintf(out, "\n== Launch Chain ==\n");
+    if (!has_provenance || chain.empty())
+    {
+      // Without provenance the best we can say is that no schedule can
+      // finish faster than the busiest processor
+      uint64_t busiest = 0, busiest_proc = 0;
+      for (std::map<uint64_t,ProcStats>::const_iterator it =
+            procs.begin(); it != procs.end(); it++)
+      {
+        const uint64_t busy = it->second.busy_ns -
+          std::min(it->second.busy_ns, it->second.wait_ns);
+        if (busy > busiest)
+        {
+          busiest = busy;
+          busiest_proc = it->first;
+        }
+      }
+      fprintf(out, "Logs have no provenance (build with "
+              "LEGION_PROF_PROVENANCE for launch chains)\n");
+      fprintf(out, "Lower bound from busiest processor 0x%" PRIx64 ": "
+              "%.3f ms of %.3f ms elapsed\n", busiest_proc, to_ms(busiest),
+              to_ms(last_time - first_time));
+      return;
+    }
+    // The logs record which task launched each task but not the events a
+    // task waited on, so this is the chain of launches that led to the
+    // last task to finish rather than a true critical path through data
+    // dependences; gaps between links show launch and mapping latency
+    fprintf(out, "Tasks that launched the last task to finish (provenance "
+            "only, not dependences or event waits)\n");
+    const PathNode &first = chain.back(), &last = chain.front();
+    uint64_t running = 0;
+    for (std::vector<PathNode>::const_iterator it =
+          chain.begin(); it != chain.end(); it++)
+      running += it->stop - it->start;
+    const uint64_t length = last.stop - std::min(last.stop, first.start);
+    fprintf(out, "%zd tasks%s, %.3f ms from first start to last stop, "
+            "%.3f ms executing (%.2f%%)\n", chain.size(),
+            (first.provenance != 0) ? " (launcher not profiled)" : "",
+            to_ms(length), to_ms(running), (length == 0) ? 0.0 :
+              100.0 * double(running) / double(length));
+    fprintf(out, "%-32s %-20s %12s %12s %12s\n", "Name", "Processor",
+            "Start (ms)", "Run (us)", "Delay (us)");
+    const size_t rows = ((options.top == 0) || (options.top > chain.size())) ?
+      chain.size() : options.top;
+    if (rows < chain.size())
+      fprintf(out, "... %zd earlier tasks\n", chain.size() - rows);
+    // Show the tail of the chain since that is closest to the end, in
+    // launch order
+    for (size_t idx = rows; idx > 0; idx--)
+    {
+      const PathNode &node = chain[idx-1];
+      // Delay is from the launcher starting to this task starting, the
+      // launch latency seen along the chain
+      const uint64_t delay = (idx == chain.size()) ? 0 :
+        (node.start - std::min(node.start, chain[idx].start));
+      fprintf(out, "%-32.32s 0x%-18" PRIx64 " %12.3f %12.2f %12.2f\n",
+              kind_name(node), node.proc_id, to_ms(node.start),
+              to_us(node.stop - node.start), to_us(delay));
+    }
+  }
+
+}; // namespace LegionProf
@@ -0,0 +1,131 @@
+/* Copyright 2020 Stanford University, NVIDIA Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LEGION_PROF_SUMMARY_H__
+#define __LEGION_PROF_SUMMARY_H__
+
+#include "legion_prof_reader.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// Aggregate statistics computed in a single pass over one or more binary
+// Legion Prof logs.  Everything is bounded by the number of processors,
+// memories, and task kinds in the machine rather than by the number of
+// records in the logs, so a Summary can be built for each file
+// independently (e.g. on different threads) and merged afterwards.  The
+// launch chain only remembers the last task to finish during that pass and
+// finds its launchers with further passes over the logs.
+
+namespace LegionProf {
+
+  class ProcStats {
+  public:
+    ProcStats(void);
+    void merge(const ProcStats &rhs);
+  public:
+    unsigned kind;
+    uint64_t busy_ns;  // sum of task run time including waits
+    uint64_t wait_ns;  // time tasks spent blocked while on the processor
+    uint64_t tasks, meta_tasks;
+  };
+
+  class KindStats {
+  public:
+    // Buckets are powers of two in microseconds: [0,1), [1,2), [2,4), ...
+    static const unsigned NUM_BUCKETS = 32;
+  public:
+    KindStats(void);
+    void add(uint64_t run_ns, uint64_t queue_ns);
+    void merge(const KindStats &rhs);
+  public:
+    std::string name;
+    uint64_t count, total_ns, queue_ns, min_ns, max_ns;
+    uint64_t buckets[NUM_BUCKETS];
+  };
+
+  class ChannelStats {
+  public:
+    ChannelStats(void);
+    void merge(const ChannelStats &rhs);
+  public:
+    uint64_t copies, bytes, busy_ns;
+  };
+
+  // A task on the launch chain; the provenance is the finish event of the
+  // task that launched it
+  class PathNode {
+  public:
+    uint64_t finish, provenance;
+    uint64_t proc_id;
+    uint64_t start, stop;
+    unsigned kind;
+    bool meta;
+  };
+
+  class Summary {
+  public:
+    struct ReportOptions {
+      ReportOptions(void) : top(20), histograms(true) { }
+      unsigned top; // maximum rows per table, 0 for all
+      bool histograms;
+    };
+  public:
+    explicit Summary(bool launch_chain = true);
+  public:
+    // Streams one log through the analyses, returns false and fills in
+    // the error on a malformed log
+    bool process_file(const std::string &filename, std::string &error);
+    void merge(const Summary &rhs);
+    // Follows provenance back from the last task to finish through the
+    // tasks that launched it, rereading the logs as needed; call after
+    // every file has been processed and merged
+    bool trace_launch_chain(const std::vector<std::string> &filenames,
+                            std::string &error);
+    void report(FILE *out, const ReportOptions &options) const;
+  protected:
+    void report_processors(FILE *out, const ReportOptions &options) const;
+    void report_kinds(FILE *out, const char *title,
+                      const std::map<unsigned,KindStats> &kinds,
+                      const ReportOptions &options) const;
+    void report_copies(FILE *out, const ReportOptions &options) const;
+    void report_launch_chain(FILE *out, const ReportOptions &options) const;
+    const char* kind_name(const PathNode &node) const;
+    void record_last_task(const PathNode &node);
+    // Scans one log for launchers of the current head of the chain,
+    // returns false on a malformed log
+    bool extend_launch_chain(const std::string &filename,
+                             std::string &error);
+  public:
+    const bool launch_chain;
+    bool has_provenance;
+    unsigned files;
+    unsigned long long records, bytes;
+    uint64_t first_time, last_time;
+    std::map<uint64_t,ProcStats> procs;
+    std::map<uint64_t,unsigned> memory_kinds;
+    std::map<unsigned,KindStats> task_kinds, meta_kinds;
+    std::map<std::pair<uint64_t,uint64_t>,ChannelStats> channels;
+    uint64_t fills;
+    bool has_last_task;
+    PathNode last_task;
+    // Last task to finish first, then its launcher, and so on
+    std::vector<PathNode> chain;
+  };
+
+}; // namespace LegionProf
+
+#endif // __LEGION_PROF_SUMMARY_H__
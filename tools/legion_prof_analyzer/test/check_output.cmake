@@ -0,0 +1,38 @@
+#------------------------------------------------------------------------------#
+# Copyright 2020 Stanford University, NVIDIA Corporation
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#------------------------------------------------------------------------------#
+
+# Runs legion_prof_analyze on the checked-in fixture logs and compares its
+# report with the expected output
+#   cmake -DANALYZER=<exe> -DFIXTURE_DIR=<dir> -DOUTPUT=<file> -P check_output.cmake
+
+execute_process(
+  COMMAND ${ANALYZER} -j 1 prof_0.log prof_1.log
+  WORKING_DIRECTORY ${FIXTURE_DIR}
+  OUTPUT_FILE ${OUTPUT}
+  RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "legion_prof_analyze failed: ${result}")
+endif()
+
+execute_process(
+  COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT} ${FIXTURE_DIR}/expected.txt
+  RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+  file(READ ${OUTPUT} actual)
+  message(FATAL_ERROR "output differs from ${FIXTURE_DIR}/expected.txt:\n${actual}")
+endif()
@@ -212,6 +212,7 @@ function getLineColor(elem) {
     "L3 Cache Memory": "crimson",
     "L2 Cache Memory": "darkmagenta",
     "L1 Cache Memory": "olivedrab",
+    "Mapped File Memory": "darkgoldenrod",
     "Channel": "orangered"
   };
   return colorMap[kind];
@@ -357,6 +357,13 @@ AdversarialMapper::AdversarialMapper(Machine m,
                     it->id, memory_size_in_kb);
             break;
           }
+        // Files mapped into memory on a single node
+        case Memory::FILE_MAPPED_MEM:
+          {
+            printf("  Mapped File Memory ID " IDFMT " has %zd KB\n",
+                    it->id, memory_size_in_kb);
+            break;
+          }
         default:
           assert(false);
       }